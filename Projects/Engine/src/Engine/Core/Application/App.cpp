@@ -4,11 +4,14 @@
 #include "../Display/Display.h"
 #include "../Input/Input.h"
 #include "LayerManager.h"
-#include "../Threading/ThreadManager.h"
+#include "../Threading/JobSystem.h"
+#include "../Vulkan/Buffers/MemoryAllocator.h"
 #include "Engine/Core/Audio/AudioSystem.h"
 
 #include "Utils/Timer.h"
 #include "Engine/Core/Scene/ObjectManager.h"
+#include "Engine/Core/ECS/Ecs.h"
+#include "Engine/Core/ECS/Systems/SoundSourceSystem.h"
 
 ym::App::App()
 {
@@ -40,29 +43,37 @@ ym::App::App()
 	this->vulkanInstance = VulkanInstance::get();
 	this->vulkanInstance->init(VK_API_VERSION_1_2);
 
+	// All buffers and textures are sub-allocated from the memory allocator.
+	MemoryAllocator::get()->init(new VulkanMemoryDevice());
+
 	this->commandPools.init();
 
 	// Create the layer manager.
 	this->layerManager = LayerManager::get();
 	this->layerManager->setApp(this);
 
+	// Use one worker per core, the main thread will also execute jobs while waiting. The renderer needs to know the number of workers.
+	uint32_t numCores = std::thread::hardware_concurrency();
+	JobSystem::init(numCores > 1 ? numCores - 1 : 1);
+
 	// Initialize the vulkan renderer.
 	this->renderer.init();
 
-	// Allocate threads for each renderer and one for the GLTFLoader.
-	ThreadManager::init((uint32_t)Renderer::ERendererType::RENDER_TYPE_SIZE + 1);
-
 	ObjectManager::get()->init();
+	ECS::get()->init();
+	ECS::get()->addSystem(new SoundSourceSystem());
 }
 
 ym::App::~App()
 {
-	ThreadManager::destroy();
+	JobSystem::destroy();
 
 	ObjectManager::get()->destroy();
+	ECS::get()->destroy();
 
 	this->renderer.destroy();
 	this->commandPools.destroy();
+	MemoryAllocator::get()->destroy();
 	this->vulkanInstance->destroy();
 	Display::get()->destroy();
 	API::get()->destroy();
@@ -78,6 +89,10 @@ void ym::App::run()
 	// Initiate layers
 	this->layerManager->onStart(&this->renderer);
 
+	PipelineCache::Stats pipelineStats = this->vulkanInstance->getPipelineCache()->getStats();
+	YM_LOG_INFO("Created {} pipeline(s) in {:.2f} ms during startup with a {} pipeline cache.", pipelineStats.pipelineCount, pipelineStats.creationMs,
+		pipelineStats.warm ? "warm" : "cold");
+
 	YM_PROFILER_END_SESSION();
 
 #ifdef YM_DEBUG
@@ -115,6 +130,7 @@ void ym::App::run()
 			this->layerManager->onUpdate(dt);
 			AudioSystem::get()->update();
 			ObjectManager::get()->update();
+			ECS::get()->update(dt);
 		}
 		// Render
 		{
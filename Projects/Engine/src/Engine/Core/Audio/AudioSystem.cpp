@@ -19,7 +19,7 @@
 
 #include "Utils/Utils.h"
 
-ym::AudioSystem::AudioSystem() : portAudio(nullptr)
+ym::AudioSystem::AudioSystem() : portAudio(nullptr), mixer(nullptr)
 {
 }
 
@@ -33,15 +33,25 @@ ym::AudioSystem* ym::AudioSystem::get()
 	return &audioSystem;
 }
 
-void ym::AudioSystem::init()
+void ym::AudioSystem::init(bool useDevice)
 {
-	this->portAudio = new PortAudio();
-	this->portAudio->init();
+	if (useDevice)
+	{
+		this->portAudio = new PortAudio();
+		this->portAudio->init();
+	}
+
+	// All sounds are mixed to one output stream.
+	this->mixer = new Mixer();
+	this->mixer->init(this->portAudio);
 	YM_LOG_INFO("Initialized audio system.");
 }
 
 void ym::AudioSystem::destroy()
 {
+	// Close the output stream before the sounds are removed.
+	this->mixer->destroy();
+
 	// Remove all sounds create by the system.
 	for (Sound*& sound : this->sounds)
 	{
@@ -58,8 +68,12 @@ void ym::AudioSystem::destroy()
 	}
 	this->soundStreams.clear();
 
-	this->portAudio->destroy();
-	SAFE_DELETE(this->portAudio);
+	SAFE_DELETE(this->mixer);
+	if (this->portAudio != nullptr)
+	{
+		this->portAudio->destroy();
+		SAFE_DELETE(this->portAudio);
+	}
 
 	YM_LOG_INFO("Destroyed audio system.");
 }
@@ -71,22 +85,27 @@ void ym::AudioSystem::update()
 
 void ym::AudioSystem::setMasterVolume(float volume)
 {
-	this->masterVolume = volume;
+	this->mixer->setMasterVolume(volume);
 }
 
 void ym::AudioSystem::setStreamVolume(float volume)
 {
-	this->streamVolume = volume;
+	this->mixer->setBusVolume(Mixer::Bus::STREAMS, volume);
 }
 
 void ym::AudioSystem::setEffectsVolume(float volume)
 {
-	this->effectsVolume = volume;
+	this->mixer->setBusVolume(Mixer::Bus::EFFECTS, volume);
+}
+
+ym::Mixer* ym::AudioSystem::getMixer()
+{
+	return this->mixer;
 }
 
 ym::Sound* ym::AudioSystem::createSound(const std::string& filePath)
 {
-	Sound* sound = new Sound(this->portAudio);
+	Sound* sound = new Sound(this->mixer, Mixer::Bus::EFFECTS);
 	PCM::UserData* userData = new PCM::UserData();
 	userData->finished = false;
 	userData->sampleFormat = paFloat32;
@@ -106,7 +125,7 @@ void ym::AudioSystem::removeSound(Sound* sound)
 
 ym::Sound* ym::AudioSystem::createStream(const std::string& filePath)
 {
-	Sound* stream = new Sound(this->portAudio);
+	Sound* stream = new Sound(this->mixer, Mixer::Bus::STREAMS);
 	PCM::UserData* userData = new PCM::UserData();
 	userData->finished = false;
 	userData->sampleFormat = paFloat32;
@@ -201,16 +220,28 @@ void ym::AudioSystem::drawAudioSettings()
 	{
 		static bool my_tool_active = true;
 		ImGui::Begin("Audio settings", &my_tool_active, ImGuiWindowFlags_MenuBar);
-		ImGui::SliderFloat("Master volume", &this->masterVolume, 0.0f, 1.f, "%.3f");
+		float masterVolume = this->mixer->getMasterVolume();
+		ImGui::SliderFloat("Master volume", &masterVolume, 0.0f, 1.f, "%.3f");
+		setMasterVolume(masterVolume);
+
+		int maxVoices = (int)this->mixer->getMaxVoices();
+		ImGui::Text("Voices: %u", this->mixer->getVoiceCount());
+		ImGui::SliderInt("Max voices", &maxVoices, 0, 256);
+		if ((uint32_t)maxVoices != this->mixer->getMaxVoices())
+			this->mixer->setMaxVoices((uint32_t)maxVoices);
+
+		Mixer::RenderStats stats = this->mixer->getRenderStats();
+		if (stats.calls > 0)
+			ImGui::Text("Mix: %.3f ms avg, %.3f ms max per callback", stats.totalMs / (double)stats.calls, stats.maxMs);
 
 		uint32_t index = 0;
 		if (ImGui::CollapsingHeader("Effects"))
 		{
-			ImGui::SliderFloat("Effects volume", &this->effectsVolume, 0.0f, 1.f, "%.3f");
+			float effectsVolume = this->mixer->getBusVolume(Mixer::Bus::EFFECTS);
+			ImGui::SliderFloat("Effects volume", &effectsVolume, 0.0f, 1.f, "%.3f");
+			setEffectsVolume(effectsVolume);
 			for (Sound* sound : this->sounds)
 			{
-				sound->setGroupVolume(this->effectsVolume);
-				sound->setMasterVolume(this->masterVolume);
 				drawSoundSettings(sound, index);
 				index++;
 			}
@@ -218,11 +249,11 @@ void ym::AudioSystem::drawAudioSettings()
 
 		if (ImGui::CollapsingHeader("Streams"))
 		{
-			ImGui::SliderFloat("Streams Volume", &this->streamVolume, 0.0f, 1.f, "%.3f");
+			float streamVolume = this->mixer->getBusVolume(Mixer::Bus::STREAMS);
+			ImGui::SliderFloat("Streams Volume", &streamVolume, 0.0f, 1.f, "%.3f");
+			setStreamVolume(streamVolume);
 			for (Sound* sound : this->soundStreams)
 			{
-				sound->setGroupVolume(this->streamVolume);
-				sound->setMasterVolume(this->masterVolume);
 				drawSoundSettings(sound, index);
 				index++;
 			}
@@ -266,7 +297,7 @@ void ym::AudioSystem::drawSoundSettings(Sound* sound, uint32_t index)
 					ImGui::SliderFloat("Gain", &gain, 0.0f, 1.f, "%.3f");
 					echoF->setGain(gain);
 					float delay = echoF->getDelay();
-					ImGui::SliderFloat("Delay", &delay, 0.0f, (float)MAX_CIRCULAR_BUFFER_SIZE, "%.3f sec");
+					ImGui::SliderFloat("Delay", &delay, 0.0f, (float)ECHO_MAX_DELAY, "%.3f sec");
 					echoF->setDelay(delay);
 				}
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "PCMFunctions.h"
+#include "Mixer.h"
 
 namespace ym
 {
@@ -15,7 +16,10 @@ namespace ym
 
 		static AudioSystem* get();
 
-		void init();
+		/*
+			Without a device the mixer uses the null backend, and nothing is heard until Mixer::render is called.
+		*/
+		void init(bool useDevice = true);
 		void destroy();
 
 		void update();
@@ -24,6 +28,8 @@ namespace ym
 		void setStreamVolume(float volume);
 		void setEffectsVolume(float volume);
 
+		Mixer* getMixer();
+
 		// Assume the sound file is in stereo (Two channels). (This can be fixed in the PCMFunctions.h when processing the data!)
 		Sound* createSound(const std::string& filePath);
 		void removeSound(Sound* sound);
@@ -48,9 +54,6 @@ namespace ym
 		std::vector<Sound*> sounds;
 		std::vector<Sound*> soundStreams;
 		PortAudio* portAudio;
-
-		float effectsVolume{ 1.f };
-		float streamVolume{ 1.f };
-		float masterVolume{ 1.f };
+		Mixer* mixer;
 	};
 }
\ No newline at end of file
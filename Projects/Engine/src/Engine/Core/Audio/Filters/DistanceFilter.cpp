@@ -3,29 +3,69 @@
 
 #include "../SoundData.h"
 #include <glm/gtx/vector_angle.hpp>
+#include <xmmintrin.h>
 
 void ym::DistanceFilter::init(uint64_t sampleRate)
 {
+	this->hasGains = false;
 }
 
 void ym::DistanceFilter::destroy()
 {
 }
 
-void ym::DistanceFilter::begin()
+void ym::DistanceFilter::process(SoundData* data, float* samples, uint64_t frames)
 {
+	float leftGain, rightGain;
+	computeGains(data, leftGain, rightGain);
+	if (this->hasGains == false)
+	{
+		this->leftGain = leftGain;
+		this->rightGain = rightGain;
+		this->hasGains = true;
+	}
+
+	uint64_t frame = 0;
+	if (leftGain != this->leftGain || rightGain != this->rightGain)
+	{
+		// Fade over the block.
+		const float leftStep = (leftGain - this->leftGain) / (float)frames;
+		const float rightStep = (rightGain - this->rightGain) / (float)frames;
+		for (; frame < frames; frame++)
+		{
+			float* sample = samples + frame * 2;
+			sample[0] *= this->leftGain + leftStep * (float)(frame + 1);
+			sample[1] *= this->rightGain + rightStep * (float)(frame + 1);
+		}
+		this->leftGain = leftGain;
+		this->rightGain = rightGain;
+		return;
+	}
+
+	const __m128 gains = _mm_setr_ps(leftGain, rightGain, leftGain, rightGain);
+	for (; frame + 2 <= frames; frame += 2)
+	{
+		float* sample = samples + frame * 2;
+		_mm_storeu_ps(sample, _mm_mul_ps(_mm_loadu_ps(sample), gains));
+	}
+	if (frame < frames)
+	{
+		samples[frame * 2] *= leftGain;
+		samples[frame * 2 + 1] *= rightGain;
+	}
+}
+
+std::string ym::DistanceFilter::getName() const
+{
+	return "Distance Filter";
 }
 
-std::pair<float, float> ym::DistanceFilter::process(SoundData* data, float left, float right)
+void ym::DistanceFilter::computeGains(SoundData* data, float& leftGain, float& rightGain) const
 {
 	auto map = [](float x, float min, float max, float nMin, float nMax) {
 		return nMin + (x - min) * (nMax - nMin) / (max - min);
 	};
 
-	auto mix = [](float a, float b, float t) -> float {
-		return a * (1.f - t) + b * t;
-	};
-
 	glm::vec3 receiverToSource = data->sourcePos - data->receiverPos;
 	float distance = glm::length(receiverToSource);
 	float attenuation = distance * distance;
@@ -44,15 +84,6 @@ std::pair<float, float> ym::DistanceFilter::process(SoundData* data, float left,
 	// Stereo panning
 	float c = glm::cos(angle);
 	float s = glm::sin(angle);
-	float leftGain = c * c;
-	float rightGain = s * s;
-
-	float leftEar = left * attenuation * leftGain;
-	float rightEar = right * attenuation * rightGain;
-	return std::pair<float, float>(leftEar, rightEar);
-}
-
-std::string ym::DistanceFilter::getName() const
-{
-	return "Distance Filter";
+	leftGain = attenuation * c * c;
+	rightGain = attenuation * s * s;
 }
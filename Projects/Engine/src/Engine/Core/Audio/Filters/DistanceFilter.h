@@ -10,8 +10,16 @@ namespace ym
 	public:
 		void init(uint64_t sampleRate) override;
 		void destroy() override;
-		void begin() override;
-		std::pair<float, float> process(SoundData* data, float left, float right) override;
+		void process(SoundData* data, float* samples, uint64_t frames) override;
 		std::string getName() const override;
+
+	private:
+		// Attenuation and panning of each ear, from the positions at the start of the block.
+		void computeGains(SoundData* data, float& leftGain, float& rightGain) const;
+
+		// Gains of the last block, the gains are faded from these over the next block when the source or receiver moves.
+		float leftGain{ 0.f };
+		float rightGain{ 0.f };
+		bool hasGains{ false };
 	};
-}
\ No newline at end of file
+}
@@ -1,31 +1,83 @@
 #include "stdafx.h"
 #include "EchoFilter.h"
 
-void ym::EchoFilter::init(uint64_t sampleRate)
+#include <algorithm>
+#include <xmmintrin.h>
+
+ym::EchoFilter::EchoFilter() : delay(0.5f), gain(0.5f)
 {
-	this->delayBuffer.init(sampleRate);
 }
 
-void ym::EchoFilter::destroy()
+void ym::EchoFilter::init(uint64_t sampleRate)
 {
+	this->sampleRate = sampleRate;
+	this->delayBuffer.assign((size_t)(sampleRate * ECHO_MAX_DELAY * 2), 0.f);
+	this->appliedDelay = -1.f;
+	this->smoothedGain.reset(this->gain.load());
 }
 
-void ym::EchoFilter::begin()
+void ym::EchoFilter::destroy()
 {
-	this->delayBuffer.setDelay(this->delay);
+	this->delayBuffer.clear();
+	this->delayBuffer.shrink_to_fit();
 }
 
-std::pair<float, float> ym::EchoFilter::process(SoundData* data, float left, float right)
+void ym::EchoFilter::process(SoundData* data, float* samples, uint64_t frames)
 {
-	float oldLeftSampel = this->delayBuffer.get();
-	float newLeftInput = left + this->gain * oldLeftSampel;
-	this->delayBuffer.add(newLeftInput);
+	// The delay line is cleared when the delay changes, the delay is always a whole number of frames.
+	const float delay = this->delay.load(std::memory_order_relaxed);
+	if (delay != this->appliedDelay)
+	{
+		this->appliedDelay = delay;
+		uint64_t delayFrames = std::clamp((uint64_t)((double)this->sampleRate * (double)delay), (uint64_t)1, this->sampleRate * ECHO_MAX_DELAY);
+		this->delaySamples = delayFrames * 2;
+		this->position = 0;
+		std::fill(this->delayBuffer.begin(), this->delayBuffer.end(), 0.f);
+	}
+
+	const float gain = this->gain.load(std::memory_order_relaxed);
+	if (gain != this->smoothedGain.target)
+		this->smoothedGain.setTarget(gain, (uint32_t)((float)this->sampleRate * FILTER_SMOOTHING_TIME));
+
+	uint64_t sampleCount = frames * 2;
+	uint64_t sample = 0;
+	while (sample < sampleCount)
+	{
+		// Process up to the end of the delay line. Each sample reads the oldest value before it is replaced, so the values which
+		// are written in this range are never read in it.
+		const uint64_t count = std::min(sampleCount - sample, this->delaySamples - this->position);
+		float* in = samples + sample;
+		float* line = this->delayBuffer.data() + this->position;
+
+		uint64_t i = 0;
+		for (; i < count && this->smoothedGain.isSmoothing(); i += 2)
+		{
+			const float g = this->smoothedGain.next();
+			const float oldLeft = line[i];
+			const float oldRight = line[i + 1];
+			line[i] = in[i] + g * oldLeft;
+			line[i + 1] = in[i + 1] + g * oldRight;
+			in[i] = oldLeft;
+			in[i + 1] = oldRight;
+		}
 
-	float oldRightSampel = this->delayBuffer.get();
-	float newRightInput = right + this->gain * oldRightSampel;
-	this->delayBuffer.add(newRightInput);
+		const __m128 g = _mm_set1_ps(this->smoothedGain.current);
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 old = _mm_loadu_ps(line + i);
+			_mm_storeu_ps(line + i, _mm_add_ps(_mm_loadu_ps(in + i), _mm_mul_ps(g, old)));
+			_mm_storeu_ps(in + i, old);
+		}
+		for (; i < count; i++)
+		{
+			const float old = line[i];
+			line[i] = in[i] + this->smoothedGain.current * old;
+			in[i] = old;
+		}
 
-	return std::pair<float, float>(oldLeftSampel, oldRightSampel);
+		sample += count;
+		this->position = (this->position + count) % this->delaySamples;
+	}
 }
 
 std::string ym::EchoFilter::getName() const
@@ -35,22 +87,20 @@ std::string ym::EchoFilter::getName() const
 
 void ym::EchoFilter::setDelay(float delay)
 {
-	if (glm::abs(this->delay - delay) > 0.0001f)
-		this->delayBuffer.clear();
-	this->delay = delay;
+	this->delay.store(delay, std::memory_order_relaxed);
 }
 
 void ym::EchoFilter::setGain(float gain)
 {
-	this->gain = gain;
+	this->gain.store(gain, std::memory_order_relaxed);
 }
 
 float ym::EchoFilter::getDelay() const
 {
-	return this->delay;
+	return this->delay.load(std::memory_order_relaxed);
 }
 
 float ym::EchoFilter::getGain() const
 {
-	return this->gain;
+	return this->gain.load(std::memory_order_relaxed);
 }
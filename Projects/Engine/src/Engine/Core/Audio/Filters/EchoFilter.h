@@ -1,17 +1,25 @@
 #pragma once
 
 #include "Filter.h"
-#include "../CircularBuffer.h"
+
+#include <atomic>
+#include <vector>
+
+#define ECHO_MAX_DELAY 5 // In seconds
 
 namespace ym
 {
+	/*
+		Outputs the input delayed, with each echo fed back at the gain.
+	*/
 	class EchoFilter : public Filter
 	{
 	public:
+		EchoFilter();
+
 		void init(uint64_t sampleRate) override;
 		void destroy() override;
-		void begin() override;
-		std::pair<float, float> process(SoundData* data, float left, float right) override;
+		void process(SoundData* data, float* samples, uint64_t frames) override;
 		std::string getName() const override;
 
 		void setDelay(float delay);
@@ -21,9 +29,15 @@ namespace ym
 		float getGain() const;
 
 	private:
-		CircularBuffer delayBuffer;
+		// Interleaved delay line, the sample at position is the oldest and is replaced by the newest.
+		std::vector<float> delayBuffer;
+		uint64_t delaySamples{ 0 };
+		uint64_t position{ 0 };
+		uint64_t sampleRate{ 0 };
 
-		float delay{ 0.5f };
-		float gain{0.5f};
+		std::atomic<float> delay;
+		std::atomic<float> gain;
+		float appliedDelay{ -1.f };
+		SmoothedValue smoothedGain;
 	};
-}
\ No newline at end of file
+}
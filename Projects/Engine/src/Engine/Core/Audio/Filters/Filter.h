@@ -4,25 +4,68 @@
 #include <utility>
 #include <string>
 
+#define FILTER_SMOOTHING_TIME 0.02f // In seconds, parameter changes are faded in over this time to avoid clicks.
+
 namespace ym
 {
 	struct SoundData;
+
+	/*
+		A value which moves linearly to its target over a number of frames.
+	*/
+	struct SmoothedValue
+	{
+		float current{ 0.f };
+		float target{ 0.f };
+		float step{ 0.f };
+		uint32_t remaining{ 0 };
+
+		void reset(float value)
+		{
+			this->current = value;
+			this->target = value;
+			this->remaining = 0;
+		}
+
+		void setTarget(float value, uint32_t frames)
+		{
+			this->target = value;
+			this->remaining = frames;
+			if (frames == 0)
+				this->current = value;
+			else
+				this->step = (value - this->current) / (float)frames;
+		}
+
+		bool isSmoothing() const
+		{
+			return this->remaining > 0;
+		}
+
+		float next()
+		{
+			if (this->remaining > 0)
+			{
+				this->current = --this->remaining == 0 ? this->target : this->current + this->step;
+			}
+			return this->current;
+		}
+	};
+
 	class Filter
 	{
 	public:
+		virtual ~Filter() {}
+
 		virtual void init(uint64_t sampleRate) = 0;
 		virtual void destroy() = 0;
-		/*
-			Called before processing current block of data.
-		*/
 
-		virtual void begin() = 0;
 		/*
-			Called wen one pair of data should be processed.
+			Process a block of interleaved stereo frames in place. Called from the audio thread, parameters which are set from
+			other threads are read once per block.
 		*/
-
-		virtual std::pair<float, float> process(SoundData* data, float left, float right) = 0;
+		virtual void process(SoundData* data, float* samples, uint64_t frames) = 0;
 
 		virtual std::string getName() const = 0;
 	};
-}
\ No newline at end of file
+}
@@ -1,27 +1,15 @@
 #pragma once
 
-#include "Filter.h"
-#include "../CircularBuffer.h"
+#include "OnePoleFilter.h"
 
 namespace ym
 {
-	class LowpassFilter : public Filter
+	class LowpassFilter : public OnePoleFilter
 	{
 	public:
-		void init(uint64_t sampleRate) override;
-		void destroy() override;
-		void begin() override;
-		std::pair<float, float> process(SoundData* data, float left, float right) override;
 		std::string getName() const override;
 
-		void setCutoffFrequency(float cutoffFrequency);
-		float getCutoffFrequency() const;
-		float getSampleRate() const;
-
-	private:
-		CircularBuffer delayBuffer;
-
-		float cutoffFrequency{ 20000.f };
-		float sampleRate{ 0.f };
+	protected:
+		void computeCoefficients(float cutoffFrequency, float& a, float& b) const override;
 	};
-}
\ No newline at end of file
+}
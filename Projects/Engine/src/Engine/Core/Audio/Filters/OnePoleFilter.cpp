@@ -0,0 +1,107 @@
+#include "stdafx.h"
+#include "OnePoleFilter.h"
+
+#include <xmmintrin.h>
+
+ym::OnePoleFilter::OnePoleFilter() : cutoffFrequency(20000.f)
+{
+}
+
+void ym::OnePoleFilter::init(uint64_t sampleRate)
+{
+	this->sampleRate = (float)sampleRate;
+	this->cutoffFrequency = this->sampleRate * 0.25f;
+	this->appliedCutoffFrequency = this->cutoffFrequency;
+
+	float a, b;
+	computeCoefficients(this->appliedCutoffFrequency, a, b);
+	this->a.reset(a);
+	this->b.reset(b);
+	this->previous[0] = 0.f;
+	this->previous[1] = 0.f;
+}
+
+void ym::OnePoleFilter::destroy()
+{
+}
+
+void ym::OnePoleFilter::process(SoundData* data, float* samples, uint64_t frames)
+{
+	// Only recompute the coefficients when the cutoff frequency has changed.
+	const float cutoffFrequency = this->cutoffFrequency.load(std::memory_order_relaxed);
+	if (cutoffFrequency != this->appliedCutoffFrequency)
+	{
+		this->appliedCutoffFrequency = cutoffFrequency;
+		float a, b;
+		computeCoefficients(cutoffFrequency, a, b);
+		uint32_t smoothingFrames = (uint32_t)(this->sampleRate * FILTER_SMOOTHING_TIME);
+		this->a.setTarget(a, smoothingFrames);
+		this->b.setTarget(b, smoothingFrames);
+	}
+
+	uint64_t frame = 0;
+	for (; frame < frames && this->b.isSmoothing(); frame++)
+	{
+		const float a = this->a.next();
+		const float b = this->b.next();
+		float* sample = samples + frame * 2;
+		this->previous[0] = a * sample[0] - b * this->previous[0];
+		this->previous[1] = a * sample[1] - b * this->previous[1];
+		sample[0] = this->previous[0];
+		sample[1] = this->previous[1];
+	}
+
+	if (frame < frames)
+		processConstant(samples + frame * 2, frames - frame, this->a.current, this->b.current);
+}
+
+void ym::OnePoleFilter::setCutoffFrequency(float cutoffFrequency)
+{
+	this->cutoffFrequency.store(cutoffFrequency, std::memory_order_relaxed);
+}
+
+float ym::OnePoleFilter::getCutoffFrequency() const
+{
+	return this->cutoffFrequency.load(std::memory_order_relaxed);
+}
+
+float ym::OnePoleFilter::getSampleRate() const
+{
+	return this->sampleRate;
+}
+
+void ym::OnePoleFilter::processConstant(float* samples, uint64_t frames, float a, float b)
+{
+	// y(n)   = a*x(n) - b*y(n-1)
+	// y(n+1) = a*x(n+1) - b*a*x(n) + b*b*y(n-1)
+	const __m128 aa = _mm_set1_ps(a);
+	const __m128 negB = _mm_set1_ps(-b);
+	const __m128 previousCoefficients = _mm_setr_ps(-b, -b, b * b, b * b);
+	__m128 previous = _mm_setr_ps(this->previous[0], this->previous[1], this->previous[0], this->previous[1]);
+
+	uint64_t frame = 0;
+	for (; frame + 2 <= frames; frame += 2)
+	{
+		float* sample = samples + frame * 2;
+		__m128 y = _mm_mul_ps(aa, _mm_loadu_ps(sample));
+		y = _mm_add_ps(y, _mm_mul_ps(negB, _mm_movelh_ps(_mm_setzero_ps(), y)));
+		y = _mm_add_ps(y, _mm_mul_ps(previousCoefficients, previous));
+		_mm_storeu_ps(sample, y);
+		previous = _mm_movehl_ps(y, y);
+	}
+
+	float last[4];
+	_mm_storeu_ps(last, previous);
+	this->previous[0] = last[0];
+	this->previous[1] = last[1];
+
+	// Odd frame at the end.
+	if (frame < frames)
+	{
+		float* sample = samples + frame * 2;
+		this->previous[0] = a * sample[0] - b * this->previous[0];
+		this->previous[1] = a * sample[1] - b * this->previous[1];
+		sample[0] = this->previous[0];
+		sample[1] = this->previous[1];
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Filter.h"
+#include <atomic>
+
+namespace ym
+{
+	/*
+		Applies y(n) = a*x(n) - b*y(n-1) to each ear. The coefficients are computed from the cutoff frequency by the derived filter,
+		only when it changes, and are faded to their new values.
+	*/
+	class OnePoleFilter : public Filter
+	{
+	public:
+		OnePoleFilter();
+
+		void init(uint64_t sampleRate) override;
+		void destroy() override;
+		void process(SoundData* data, float* samples, uint64_t frames) override;
+
+		void setCutoffFrequency(float cutoffFrequency);
+		float getCutoffFrequency() const;
+		float getSampleRate() const;
+
+	protected:
+		virtual void computeCoefficients(float cutoffFrequency, float& a, float& b) const = 0;
+
+		float sampleRate{ 0.f };
+
+	private:
+		// Two frames at a time with SSE, the second frame is expanded to depend on the output before the first frame.
+		void processConstant(float* samples, uint64_t frames, float a, float b);
+
+		std::atomic<float> cutoffFrequency;
+		float appliedCutoffFrequency{ 0.f };
+		SmoothedValue a;
+		SmoothedValue b;
+		float previous[2]{ 0.f, 0.f }; // y(n-1) of each ear.
+	};
+}
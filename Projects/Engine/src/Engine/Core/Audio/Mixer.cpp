@@ -0,0 +1,294 @@
+#include "stdafx.h"
+#include "Mixer.h"
+
+#include "PortAudio.h"
+#include "Utils/Timer.h"
+
+ym::Mixer::Mixer() : stream(nullptr), sampleRate(MIXER_SAMPLE_RATE), maxVoices(MIXER_DEFAULT_MAX_VOICES), voiceOrder(0), masterVolume(1.f)
+{
+	for (float& volume : this->busVolumes)
+		volume = 1.f;
+}
+
+ym::Mixer::~Mixer()
+{
+}
+
+void ym::Mixer::init(PortAudio* portAudio, uint32_t sampleRate)
+{
+	this->sampleRate = sampleRate;
+	for (std::vector<float>& busBuffer : this->busBuffers)
+		busBuffer.resize(MIXER_FRAMES_PER_BLOCK * 2);
+	this->voiceBuffer.resize(MIXER_FRAMES_PER_BLOCK * 2);
+	// A block reads at most ratio source frames for each output frame, plus the frames carried from the block before. Sized here
+	// so the audio callback never allocates.
+	this->sourceBuffer.resize((MIXER_FRAMES_PER_BLOCK * MIXER_MAX_RESAMPLE_RATIO + 4) * 2);
+
+	if (portAudio != nullptr)
+	{
+		PaStreamParameters outputParameters;
+		outputParameters.device = portAudio->getDeviceIndex();
+		outputParameters.channelCount = 2;
+		outputParameters.sampleFormat = paFloat32;
+		outputParameters.suggestedLatency = portAudio->getDeviceInfo()->defaultLowOutputLatency;
+		outputParameters.hostApiSpecificStreamInfo = NULL;
+
+		PaError err = Pa_OpenStream(
+			&this->stream,
+			NULL,
+			&outputParameters,
+			this->sampleRate,
+			paFramesPerBufferUnspecified,
+			paClipOff,
+			Mixer::paCallback,
+			this);
+		PORT_AUDIO_CHECK(err, "Failed to open mixer stream!");
+		PORT_AUDIO_CHECK(Pa_StartStream(this->stream), "Failed to start mixer stream!");
+	}
+}
+
+void ym::Mixer::destroy()
+{
+	if (this->stream != nullptr)
+	{
+		PORT_AUDIO_CHECK(Pa_StopStream(this->stream), "Failed to stop mixer stream!");
+		PORT_AUDIO_CHECK(Pa_CloseStream(this->stream), "Failed to close mixer stream!");
+		this->stream = nullptr;
+	}
+
+	std::lock_guard<std::mutex> lck(this->mutex);
+	this->voices.clear();
+}
+
+void ym::Mixer::render(float* out, uint64_t frames)
+{
+	Timer timer;
+	std::lock_guard<std::mutex> lck(this->mutex);
+
+	for (uint64_t offset = 0; offset < frames; offset += MIXER_FRAMES_PER_BLOCK)
+	{
+		const uint64_t blockFrames = std::min<uint64_t>(frames - offset, MIXER_FRAMES_PER_BLOCK);
+		const uint64_t samples = blockFrames * 2;
+		for (std::vector<float>& busBuffer : this->busBuffers)
+			std::fill(busBuffer.begin(), busBuffer.begin() + samples, 0.f);
+
+		// Sum the voices on their bus.
+		for (size_t i = 0; i < this->voices.size();)
+		{
+			Voice& voice = this->voices[i];
+			bool playing = renderVoice(voice, blockFrames);
+
+			const float volume = voice.data->soundData.volume;
+			const float* src = this->voiceBuffer.data();
+			float* bus = this->busBuffers[(size_t)voice.bus].data();
+			for (uint64_t s = 0; s < samples; s++)
+				bus[s] += src[s] * volume;
+
+			if (playing)
+				i++;
+			else
+				removeVoice(i, true);
+		}
+
+		// Sum the buses to the output.
+		float* dst = out + offset * 2;
+		std::fill(dst, dst + samples, 0.f);
+		for (size_t busIndex = 0; busIndex < (size_t)Bus::COUNT; busIndex++)
+		{
+			const float volume = this->busVolumes[busIndex] * this->masterVolume;
+			const float* bus = this->busBuffers[busIndex].data();
+			for (uint64_t s = 0; s < samples; s++)
+				dst[s] += bus[s] * volume;
+		}
+	}
+
+	double ms = (double)timer.stop() * 1000.0;
+	this->stats.calls++;
+	this->stats.frames += frames;
+	this->stats.totalMs += ms;
+	this->stats.maxMs = std::max(this->stats.maxMs, ms);
+}
+
+bool ym::Mixer::play(PCM::UserData* data, Bus bus, int32_t priority)
+{
+	YM_ASSERT(data->sampleFormat == paFloat32, "The mixer only supports sounds with float samples!");
+	if ((uint64_t)data->handle.sampleRate > (uint64_t)this->sampleRate * MIXER_MAX_RESAMPLE_RATIO)
+	{
+		YM_LOG_ERROR("Sample rate {} is too high for the mixer, it is not played!", data->handle.sampleRate);
+		return false;
+	}
+	std::lock_guard<std::mutex> lck(this->mutex);
+
+	for (Voice& voice : this->voices)
+	{
+		if (voice.data == data)
+			return true;
+	}
+
+	if (this->maxVoices == 0)
+		return false;
+
+	if (this->voices.size() >= this->maxVoices)
+	{
+		size_t lowest = findLowestPriority();
+		if (this->voices[lowest].priority > priority)
+			return false;
+		removeVoice(lowest, true);
+	}
+
+	Voice voice;
+	voice.data = data;
+	voice.bus = bus;
+	voice.priority = priority;
+	voice.order = this->voiceOrder++;
+	this->voices.push_back(voice);
+	return true;
+}
+
+bool ym::Mixer::stop(PCM::UserData* data, bool rewind)
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+	for (size_t i = 0; i < this->voices.size(); i++)
+	{
+		if (this->voices[i].data == data)
+		{
+			removeVoice(i, rewind);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ym::Mixer::isPlaying(PCM::UserData* data)
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+	for (Voice& voice : this->voices)
+	{
+		if (voice.data == data)
+			return true;
+	}
+	return false;
+}
+
+void ym::Mixer::setMaxVoices(uint32_t maxVoices)
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+	this->maxVoices = maxVoices;
+	while (this->voices.size() > this->maxVoices)
+		removeVoice(findLowestPriority(), true);
+}
+
+uint32_t ym::Mixer::getMaxVoices() const
+{
+	return this->maxVoices;
+}
+
+uint32_t ym::Mixer::getVoiceCount()
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+	return (uint32_t)this->voices.size();
+}
+
+void ym::Mixer::setBusVolume(Bus bus, float volume)
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+	this->busVolumes[(size_t)bus] = volume;
+}
+
+float ym::Mixer::getBusVolume(Bus bus) const
+{
+	return this->busVolumes[(size_t)bus];
+}
+
+void ym::Mixer::setMasterVolume(float volume)
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+	this->masterVolume = volume;
+}
+
+float ym::Mixer::getMasterVolume() const
+{
+	return this->masterVolume;
+}
+
+uint32_t ym::Mixer::getSampleRate() const
+{
+	return this->sampleRate;
+}
+
+ym::Mixer::RenderStats ym::Mixer::getRenderStats()
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+	return this->stats;
+}
+
+void ym::Mixer::resetRenderStats()
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+	this->stats = RenderStats();
+}
+
+int ym::Mixer::paCallback(const void* inputBuffer, void* outputBuffer, unsigned long framesPerBuffer, const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void* userData)
+{
+	Mixer* mixer = static_cast<Mixer*>(userData);
+	mixer->render(static_cast<float*>(outputBuffer), (uint64_t)framesPerBuffer);
+	return paContinue;
+}
+
+bool ym::Mixer::renderVoice(Voice& voice, uint64_t frames)
+{
+	PCM::UserData* data = voice.data;
+	if (data->handle.sampleRate == this->sampleRate)
+		return PCM::renderVoice(data, this->voiceBuffer.data(), frames);
+
+	// Linear resampling. The source frames start with the ones carried from the last block, followed by the new frames which are
+	// needed to interpolate the last output frame.
+	const double ratio = (double)data->handle.sampleRate / (double)this->sampleRate;
+	const uint64_t required = (uint64_t)(voice.phase + (double)(frames - 1) * ratio) + 2;
+	YM_ASSERT(required * 2 <= this->sourceBuffer.size(), "Resampling needs {} frames, the buffer holds {}!", required, this->sourceBuffer.size() / 2);
+
+	float* source = this->sourceBuffer.data();
+	memcpy(source, voice.carry, voice.carryCount * 2 * sizeof(float));
+	bool playing = PCM::renderVoice(data, source + voice.carryCount * 2, required - voice.carryCount);
+
+	float* out = this->voiceBuffer.data();
+	for (uint64_t i = 0; i < frames; i++)
+	{
+		const double position = voice.phase + (double)i * ratio;
+		const uint64_t index = (uint64_t)position;
+		const float t = (float)(position - (double)index);
+		out[i * 2] = source[index * 2] * (1.f - t) + source[index * 2 + 2] * t;
+		out[i * 2 + 1] = source[index * 2 + 1] * (1.f - t) + source[index * 2 + 3] * t;
+	}
+
+	// At most two source frames are needed by the next block.
+	const double end = voice.phase + (double)frames * ratio;
+	const uint64_t consumed = std::min((uint64_t)end, required);
+	voice.carryCount = (uint32_t)(required - consumed);
+	memcpy(voice.carry, source + consumed * 2, voice.carryCount * 2 * sizeof(float));
+	voice.phase = end - (double)consumed;
+	return playing;
+}
+
+void ym::Mixer::removeVoice(size_t index, bool rewind)
+{
+	PCM::UserData* data = this->voices[index].data;
+	PCM::setPos(&data->handle, rewind ? 0 : data->handle.pos);
+	data->finished = false;
+
+	this->voices[index] = this->voices.back();
+	this->voices.pop_back();
+}
+
+size_t ym::Mixer::findLowestPriority() const
+{
+	size_t lowest = 0;
+	for (size_t i = 1; i < this->voices.size(); i++)
+	{
+		const Voice& voice = this->voices[i];
+		const Voice& current = this->voices[lowest];
+		if (voice.priority < current.priority || (voice.priority == current.priority && voice.order < current.order))
+			lowest = i;
+	}
+	return lowest;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "PCMFunctions.h"
+
+#include <mutex>
+
+#define MIXER_SAMPLE_RATE DEFAULT_SAMPLE_RATE
+#define MIXER_FRAMES_PER_BLOCK 512	// Frames which are mixed at a time, larger requests are split into blocks.
+#define MIXER_DEFAULT_MAX_VOICES 32
+#define MIXER_MAX_RESAMPLE_RATIO 8	// Highest sample rate of a sound relative to the mixer, the resampling buffer is sized for it.
+
+namespace ym
+{
+	class PortAudio;
+
+	/*
+		Mixes all playing sounds into one stereo float output stream. Each sound is a voice which belongs to a bus (effects or streams),
+		the voices are summed on their bus and the buses are scaled by their volume and the master volume.
+
+		When there are more voices than allowed, the voice with the lowest priority is stolen. If the new voice has a lower priority
+		than all of the playing voices it is not played.
+	*/
+	class Mixer
+	{
+	public:
+		enum class Bus { EFFECTS = 0, STREAMS = 1, COUNT = 2 };
+
+		// Time spent in render, in milliseconds.
+		struct RenderStats
+		{
+			uint64_t calls{ 0 };
+			uint64_t frames{ 0 };
+			double totalMs{ 0.0 };
+			double maxMs{ 0.0 };
+		};
+
+	public:
+		Mixer();
+		~Mixer();
+
+		/*
+			Opens one output stream on the device of portAudio. If portAudio is nullptr no stream is opened (null backend) and the mix
+			is only produced when render is called.
+		*/
+		void init(PortAudio* portAudio, uint32_t sampleRate = MIXER_SAMPLE_RATE);
+		void destroy();
+
+		/*
+			Mix the next frames of all playing voices to out, as interleaved stereo. Called by the output stream, or directly when
+			using the null backend.
+		*/
+		void render(float* out, uint64_t frames);
+
+		/*
+			Start a voice from the current position of the sound. Returns false if the voice could not be played because of the
+			voice limit.
+		*/
+		bool play(PCM::UserData* data, Bus bus, int32_t priority);
+
+		/*
+			Stop a voice, and rewind it if rewind is true. Returns false if it was not playing.
+		*/
+		bool stop(PCM::UserData* data, bool rewind);
+		bool isPlaying(PCM::UserData* data);
+
+		void setMaxVoices(uint32_t maxVoices);
+		uint32_t getMaxVoices() const;
+		uint32_t getVoiceCount();
+
+		void setBusVolume(Bus bus, float volume);
+		float getBusVolume(Bus bus) const;
+		void setMasterVolume(float volume);
+		float getMasterVolume() const;
+
+		uint32_t getSampleRate() const;
+
+		RenderStats getRenderStats();
+		void resetRenderStats();
+
+	private:
+		struct Voice
+		{
+			PCM::UserData* data{ nullptr };
+			Bus bus{ Bus::EFFECTS };
+			int32_t priority{ 0 };
+			uint64_t order{ 0 };		// Increases for each started voice, the oldest voice is stolen first.
+
+			// Resampling state, used if the sound does not have the sample rate of the mixer.
+			double phase{ 0.0 };		// Position of the next output frame, relative to the first carried frame.
+			uint32_t carryCount{ 0 };
+			float carry[4];				// Source frames which are needed by the next block.
+		};
+
+		static int paCallback(const void* inputBuffer, void* outputBuffer, unsigned long framesPerBuffer,
+			const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void* userData);
+
+		// Render one block of a voice to voiceBuffer. Returns false when the voice has finished.
+		bool renderVoice(Voice& voice, uint64_t frames);
+		void removeVoice(size_t index, bool rewind);
+		// Index of the voice which is stolen first.
+		size_t findLowestPriority() const;
+
+	private:
+		PaStream* stream;
+		uint32_t sampleRate;
+		uint32_t maxVoices;
+		uint64_t voiceOrder;
+
+		std::vector<Voice> voices;
+		std::mutex mutex;
+
+		float busVolumes[(size_t)Bus::COUNT];
+		float masterVolume;
+
+		std::vector<float> busBuffers[(size_t)Bus::COUNT];
+		std::vector<float> voiceBuffer;
+		std::vector<float> sourceBuffer;
+
+		RenderStats stats;
+	};
+}
@@ -23,34 +23,31 @@ void ym::PCM::setPos(SoundHandle* handle, uint64_t newPos)
 	}
 }
 
-int ym::PCM::paCallbackPCM(const void* inputBuffer, void* outputBuffer, unsigned long framesPerBuffer, const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void* userData)
+bool ym::PCM::renderVoice(UserData* data, float* out, uint64_t frames)
 {
-	UserData* data = (UserData*)userData;
-	uint64_t framesRead = readPCM(data, framesPerBuffer, outputBuffer);
-	OutputData outputData = getOutputData(data, outputBuffer);
-	
-	for (Filter* ft : data->filters)
-		ft->begin();
-	bool shouldContinue = false;
-	for (uint64_t t = 0; t < framesPerBuffer; t++)
+	uint64_t framesRead = readPCM(data, frames, out);
+	while (framesRead < frames && data->soundData.loop)
 	{
-		auto samples = getSamples(data, &outputData);
-		float leftEar = samples.first;
-		float rightEar = samples.second;
-		for (Filter* ft : data->filters)
-		{
-			auto res = ft->process(&data->soundData, leftEar, rightEar);
-			leftEar = std::get<0>(res);
-			rightEar = std::get<1>(res);
-			shouldContinue = shouldContinue && (abs(leftEar) > 0.00000001f ? true : shouldContinue);
-			shouldContinue = shouldContinue && (abs(rightEar) > 0.00000001f ? true : shouldContinue);
-		}
-
-		float volume = data->soundData.volume * data->soundData.groupVolume * data->soundData.masterVolume;
-		applyToEar(data, &outputData, { leftEar * volume, rightEar * volume });
+		setPos(&data->handle, 0);
+		uint64_t loopFramesRead = readPCM(data, frames - framesRead, out + framesRead * 2);
+		if (loopFramesRead == 0)
+			break;
+		framesRead += loopFramesRead;
 	}
+	if (framesRead < frames)
+		memset(out + framesRead * 2, 0, (size_t)(frames - framesRead) * 2 * sizeof(float));
 
-	return finish(data, framesRead, framesPerBuffer, shouldContinue);
+	for (Filter* ft : data->filters)
+		ft->process(&data->soundData, out, frames);
+
+	// Reset when the end is reached.
+	if (framesRead < frames && data->soundData.loop == false)
+	{
+		setPos(&data->handle, 0);
+		data->finished = true;
+		return false;
+	}
+	return true;
 }
 
 uint64_t ym::PCM::readPCMFrames(SoundHandle* handle, uint64_t framesToRead, PaSampleFormat format, void* outBuffer)
@@ -94,56 +91,6 @@ uint64_t ym::PCM::readPCMFramesEffect(SoundHandle* handle, uint64_t framesToRead
 	return framesRead;
 }
 
-std::pair<float, float> ym::PCM::getSamples(UserData* data, OutputData* outputData)
-{
-	float left = data->sampleFormat == paInt16 ? (float)(*(outputData->outI16)) : *(outputData->outF32);
-	float right = data->sampleFormat == paInt16 ? (float)(*(outputData->outI16+1)) : *(outputData->outF32+1);
-	return std::pair<float, float>(left, right);
-}
-
-std::pair<float, float> ym::PCM::getSamples(UserData* data, OutputData* outputData, uint32_t index)
-{
-	float left = data->sampleFormat == paInt16 ? (float)(outputData->outI16[index]) : outputData->outF32[index];
-	float right = data->sampleFormat == paInt16 ? (float)(outputData->outI16[index+1]) : outputData->outF32[index+1];
-	return std::pair<float, float>(left, right);
-}
-
-ym::PCM::OutputData ym::PCM::getOutputData(UserData* data, void* out)
-{
-	OutputData outData;
-	outData.outF32 = (float*)out;
-	outData.outI16 = (int16_t*)out;
-	return outData;
-}
-
-void ym::PCM::applyToEar(UserData* data, OutputData* outputData, float value)
-{
-	if (data->sampleFormat == paInt16)
-		*outputData->outI16++ = (int16_t)std::clamp(value, (float)INT16_MIN, (float)INT16_MAX);
-	else if (data->sampleFormat == paFloat32)
-		*outputData->outF32++ = value;
-}
-
-void ym::PCM::applyToEar(UserData* data, OutputData* outputData, float value, uint32_t index)
-{
-	if (data->sampleFormat == paInt16)
-		outputData->outI16[index] = (int16_t)std::clamp(value, (float)INT16_MIN, (float)INT16_MAX);
-	else if (data->sampleFormat == paFloat32)
-		outputData->outF32[index] = value;
-}
-
-void ym::PCM::applyToEar(UserData* data, OutputData* outputData, std::pair<float, float> values)
-{
-	applyToEar(data, outputData, values.first);
-	applyToEar(data, outputData, values.second);
-}
-
-void ym::PCM::applyToEar(UserData* data, OutputData* outputData, std::pair<float, float> values, uint32_t index)
-{
-	applyToEar(data, outputData, values.first, index);
-	applyToEar(data, outputData, values.second, index+1);
-}
-
 uint64_t ym::PCM::readPCM(UserData* data, uint64_t framesPerBuffer, void* outBuffer)
 {
 	uint64_t framesRead = 0;
@@ -153,24 +100,3 @@ uint64_t ym::PCM::readPCM(UserData* data, uint64_t framesPerBuffer, void* outBuf
 		framesRead = readPCMFrames(&data->handle, framesPerBuffer, data->sampleFormat, outBuffer);
 	return framesRead;
 }
-
-int ym::PCM::finish(UserData* data, uint64_t framesRead, uint64_t framesPerBuffer, bool continueFlag)
-{
-	if (data->soundData.loop)
-	{
-		// Reset and play again.
-		if (framesRead < framesPerBuffer && !continueFlag)
-			setPos(&data->handle, 0);
-		return paContinue;
-	}
-	else
-	{
-		// Reset and stop the stream.
-		if (framesRead < framesPerBuffer && !continueFlag)
-		{
-			setPos(&data->handle, 0);
-			data->finished = true;
-		}
-		return data->finished ? paComplete : paContinue;
-	}
-}
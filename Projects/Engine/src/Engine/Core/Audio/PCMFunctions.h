@@ -14,13 +14,6 @@ namespace ym
 {
 	class PCM
 	{
-	private:
-		struct OutputData
-		{
-			float* outF32 = nullptr;
-			int16_t* outI16 = nullptr;
-		};
-
 	public:
 
 		struct UserData
@@ -35,20 +28,15 @@ namespace ym
 
 		static void setPos(SoundHandle* handle, uint64_t newPos);
 
-		static int paCallbackPCM(const void* inputBuffer, void* outputBuffer, unsigned long framesPerBuffer,
-			const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void* userData);
+		/*
+			Read the next frames of a sound and apply its filters, as interleaved stereo. Looping sounds continue from the start
+			and frames after the end of the sound are silent. Returns false when a sound which does not loop has finished.
+		*/
+		static bool renderVoice(UserData* data, float* out, uint64_t frames);
 
 	private:
 		static uint64_t readPCMFrames(SoundHandle* handle, uint64_t framesToRead, PaSampleFormat format, void* outBuffer);
 		static uint64_t readPCMFramesEffect(SoundHandle* handle, uint64_t framesToRead, PaSampleFormat format, void* outBuffer);
-		static std::pair<float, float> getSamples(UserData* data, OutputData* outputData);
-		static std::pair<float, float> getSamples(UserData* data, OutputData* outputData, uint32_t index);
-		static OutputData getOutputData(UserData* data, void* out);
-		static void applyToEar(UserData* data, OutputData* outputData, float value);
-		static void applyToEar(UserData* data, OutputData* outputData, float value, uint32_t index);
-		static void applyToEar(UserData* data, OutputData* outputData, std::pair<float, float> values);
-		static void applyToEar(UserData* data, OutputData* outputData, std::pair<float, float> values, uint32_t index);
 		static uint64_t readPCM(UserData* data, uint64_t framesPerBuffer, void* outBuffer);
-		static int finish(UserData* data, uint64_t framesRead, uint64_t framesPerBuffer, bool continueFlag);
 	};
 }
\ No newline at end of file
@@ -1,12 +1,11 @@
 #include "stdafx.h"
 #include "Sound.h"
 
-#include "PortAudio.h"
 #include "AudioSystem.h"
 
 #include "Engine/Core/Camera.h"
 
-ym::Sound::Sound(PortAudio* portAudioPtr) : volume(0.0f), userData(nullptr), stream(nullptr), portAudioPtr(portAudioPtr), isStreamOn(false)
+ym::Sound::Sound(Mixer* mixer, Mixer::Bus bus) : volume(0.0f), priority(0), mixer(mixer), bus(bus), userData(nullptr)
 {
 }
 
@@ -18,35 +17,14 @@ ym::Sound::~Sound()
 void ym::Sound::init(PCM::UserData* userData)
 {
 	this->userData = userData;
-	//this->userData->delayBuffer.init(userData->handle.sampleRate);
-
-	PaStreamParameters outputParameters;
-	outputParameters.device = this->portAudioPtr->getDeviceIndex();
-	outputParameters.channelCount = 2;
-	outputParameters.sampleFormat = this->userData->sampleFormat;
-	outputParameters.suggestedLatency = this->portAudioPtr->getDeviceInfo()->defaultLowOutputLatency;
-	outputParameters.hostApiSpecificStreamInfo = NULL;
-
-	// Create stream
-	PaError err = Pa_OpenStream(
-		&this->stream,
-		NULL,
-		&outputParameters,
-		userData->handle.sampleRate,
-		paFramesPerBufferUnspecified,
-		paClipOff,
-		PCM::paCallbackPCM,
-		this->userData);
-	PORT_AUDIO_CHECK(err, "Failed to open default stream!");
 }
 
 void ym::Sound::destroy()
 {
 	if (isCreated())
 	{
+		// The voice is removed from the mixer before its data is deleted.
 		stop();
-		PORT_AUDIO_CHECK(Pa_CloseStream(this->stream), "Failed to close stream!");
-		this->stream = nullptr;
 
 		// Delete sound data.
 		if (this->userData->handle.asEffect)
@@ -90,36 +68,28 @@ void ym::Sound::destroy()
 void ym::Sound::play()
 {
 	stop();
-	//this->userData->delayBuffer.clear();
-	PORT_AUDIO_CHECK(Pa_StartStream(this->stream), "Failed to start stream!");
-	this->isStreamOn = true;
+	if (this->mixer->play(this->userData, this->bus, this->priority) == false)
+		YM_LOG_WARN("Sound {} was not played, all voices are used by sounds with a higher priority.", this->name.c_str());
 }
 
 void ym::Sound::pause()
 {
-	if (this->isStreamOn)
-	{
-		PORT_AUDIO_CHECK(Pa_StopStream(this->stream), "Failed to stop stream!");
-		PCM::setPos(&this->userData->handle, this->userData->handle.pos);
-		this->userData->finished = false;
-		this->isStreamOn = false;
-	}
+	this->mixer->stop(this->userData, false);
 }
 
 void ym::Sound::unpause()
 {
-	play();
+	this->mixer->play(this->userData, this->bus, this->priority);
 }
 
 void ym::Sound::stop()
 {
-	if (this->isStreamOn)
-	{
-		PORT_AUDIO_CHECK(Pa_StopStream(this->stream), "Failed to stop stream!");
-		PCM::setPos(&this->userData->handle, 0);
-		this->userData->finished = false;
-		this->isStreamOn = false;
-	}
+	this->mixer->stop(this->userData, true);
+}
+
+bool ym::Sound::isPlaying()
+{
+	return this->mixer->isPlaying(this->userData);
 }
 
 void ym::Sound::setName(const std::string& name)
@@ -157,19 +127,19 @@ void ym::Sound::setVolume(float volume)
 	}
 }
 
-void ym::Sound::setGroupVolume(float volume)
+void ym::Sound::setLoop(bool state)
 {
-	this->userData->soundData.groupVolume = volume;
+	this->userData->soundData.loop = state;
 }
 
-void ym::Sound::setMasterVolume(float volume)
+void ym::Sound::setPriority(int32_t priority)
 {
-	this->userData->soundData.masterVolume = volume;
+	this->priority = priority;
 }
 
-void ym::Sound::setLoop(bool state)
+int32_t ym::Sound::getPriority() const
 {
-	this->userData->soundData.loop = state;
+	return this->priority;
 }
 
 void ym::Sound::addFilter(Filter* filter)
@@ -241,5 +211,5 @@ void ym::Sound::setEchoData(float delay, float gain)
 
 bool ym::Sound::isCreated() const
 {
-	return this->stream != nullptr;
+	return this->userData != nullptr;
 }
@@ -1,17 +1,17 @@
 #pragma once
 
 #include "PCMFunctions.h"
+#include "Mixer.h"
 #include "Filters/Filter.h"
 
 namespace ym
 {
 	class Camera;
-	class PortAudio;
 	class ChannelGroup;
 	class Sound
 	{
 	public:
-		Sound(PortAudio* portAudioPtr);
+		Sound(Mixer* mixer, Mixer::Bus bus);
 		~Sound();
 
 		void init(PCM::UserData* userData);
@@ -21,6 +21,7 @@ namespace ym
 		void pause();
 		void unpause();
 		void stop();
+		bool isPlaying();
 
 		void setName(const std::string& name);
 		std::string getName() const;
@@ -29,10 +30,15 @@ namespace ym
 		float getVolume() const;
 		void applyVolume(float volumeChange);
 		void setVolume(float volume);
-		void setGroupVolume(float volume);
-		void setMasterVolume(float volume);
 		void setLoop(bool state);
 
+		/*
+			When the mixer has no free voices, the playing voice with the lowest priority is stopped. A sound is not played if its
+			priority is lower than all of the playing voices.
+		*/
+		void setPriority(int32_t priority);
+		int32_t getPriority() const;
+
 		void addFilter(Filter* filter);
 		std::vector<Filter*>& getFilters();
 		
@@ -58,10 +64,10 @@ namespace ym
 
 	private:
 		float volume;
-		PaStream* stream;
-		PortAudio* portAudioPtr;
+		int32_t priority;
+		Mixer* mixer;
+		Mixer::Bus bus;
 		PCM::UserData* userData;
-		bool isStreamOn;
 		std::string name{"NO_NAME"};
 	};
 }
\ No newline at end of file
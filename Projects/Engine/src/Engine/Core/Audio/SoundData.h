@@ -6,9 +6,7 @@ namespace ym
 {
 	struct SoundData
 	{
-		float masterVolume{1.f};	// Volume for all sounds
-		float groupVolume{1.f};		// Volume for effects/streams
-		float volume{ 1.f };		// Volume for this sound
+		float volume{ 1.f };		// Volume for this sound, the effects/streams and master volume are applied by the mixer.
 
 		bool loop{ false };
 		glm::vec3 sourcePos;
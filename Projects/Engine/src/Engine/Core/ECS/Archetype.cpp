@@ -0,0 +1,117 @@
+#include "stdafx.h"
+#include "Archetype.h"
+
+#include <new>
+
+ym::Chunk::Chunk(Archetype* archetype) : archetype(archetype), count(0)
+{
+	this->data = static_cast<uint8_t*>(::operator new(ECS_CHUNK_SIZE, std::align_val_t(ECS_CHUNK_ALIGNMENT)));
+}
+
+ym::Chunk::~Chunk()
+{
+	::operator delete(this->data, std::align_val_t(ECS_CHUNK_ALIGNMENT));
+}
+
+void* ym::Chunk::getComponents(ComponentID id)
+{
+	uint32_t offset = this->archetype->offsets[id];
+	return offset == ECS_INVALID_OFFSET ? nullptr : this->data + offset;
+}
+
+ym::Archetype::Archetype(const ComponentMask& mask) : mask(mask), capacity(0)
+{
+	for (uint32_t i = 0; i < ECS_MAX_COMPONENT_TYPES; i++)
+	{
+		this->offsets[i] = ECS_INVALID_OFFSET;
+		this->sizes[i] = 0;
+		if (mask.test(i))
+			this->componentIDs.push_back(i);
+	}
+
+	uint32_t entitySize = (uint32_t)sizeof(Entity);
+	for (ComponentID id : this->componentIDs)
+	{
+		ComponentInfo info = Component::getInfo(id);
+		YM_ASSERT(info.alignment <= ECS_CHUNK_ALIGNMENT, "Component {} has a larger alignment than the chunks!", info.name);
+		this->sizes[id] = info.size;
+		entitySize += info.size;
+	}
+
+	// Start with the capacity without padding and decrease it until the arrays fit.
+	this->capacity = ECS_CHUNK_SIZE / entitySize;
+	while (this->capacity > 0 && computeLayout(this->capacity) > ECS_CHUNK_SIZE)
+		this->capacity--;
+	YM_ASSERT(this->capacity > 0, "The components of an entity do not fit in one chunk!");
+	computeLayout(this->capacity);
+}
+
+ym::Archetype::~Archetype()
+{
+	for (Chunk* chunk : this->chunks)
+		delete chunk;
+	this->chunks.clear();
+}
+
+void ym::Archetype::add(Entity entity, uint32_t& chunkIndex, uint32_t& row)
+{
+	if (this->chunks.empty() || this->chunks.back()->count == this->capacity)
+		this->chunks.push_back(new Chunk(this));
+
+	Chunk* chunk = this->chunks.back();
+	chunkIndex = (uint32_t)this->chunks.size() - 1;
+	row = chunk->count++;
+	chunk->getEntities()[row] = entity;
+}
+
+ym::Entity ym::Archetype::remove(uint32_t chunkIndex, uint32_t row)
+{
+	Chunk* chunk = this->chunks[chunkIndex];
+	Chunk* last = this->chunks.back();
+	uint32_t lastRow = last->count - 1;
+
+	Entity moved;
+	if (chunk != last || row != lastRow)
+	{
+		moved = last->getEntities()[lastRow];
+		chunk->getEntities()[row] = moved;
+		for (ComponentID id : this->componentIDs)
+		{
+			uint32_t size = this->sizes[id];
+			memcpy(chunk->data + this->offsets[id] + row * size, last->data + this->offsets[id] + lastRow * size, size);
+		}
+	}
+
+	if (--last->count == 0)
+	{
+		delete last;
+		this->chunks.pop_back();
+	}
+	return moved;
+}
+
+void* ym::Archetype::getComponent(ComponentID id, uint32_t chunkIndex, uint32_t row)
+{
+	YM_ASSERT(this->offsets[id] != ECS_INVALID_OFFSET, "The archetype does not have the component!");
+	return this->chunks[chunkIndex]->data + this->offsets[id] + row * this->sizes[id];
+}
+
+uint32_t ym::Archetype::getEntityCount() const
+{
+	if (this->chunks.empty())
+		return 0;
+	return ((uint32_t)this->chunks.size() - 1) * this->capacity + this->chunks.back()->count;
+}
+
+uint32_t ym::Archetype::computeLayout(uint32_t capacity)
+{
+	uint32_t offset = (uint32_t)sizeof(Entity) * capacity;
+	for (ComponentID id : this->componentIDs)
+	{
+		uint32_t alignment = Component::getInfo(id).alignment;
+		offset = (offset + alignment - 1) / alignment * alignment;
+		this->offsets[id] = offset;
+		offset += this->sizes[id] * capacity;
+	}
+	return offset;
+}
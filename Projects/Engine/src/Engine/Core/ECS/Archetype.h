@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Component.h"
+#include "Entity.h"
+
+#define ECS_CHUNK_SIZE (16 * 1024)	// Bytes of component data in each chunk.
+#define ECS_CHUNK_ALIGNMENT 64
+#define ECS_INVALID_OFFSET UINT32_MAX
+
+namespace ym
+{
+	class Archetype;
+
+	/*
+		A memory block which holds entities of one archetype. The entity handles are stored first, followed by one packed array for
+		each component type. The entities are always packed at the start of the arrays.
+	*/
+	class Chunk
+	{
+	public:
+		Chunk(Archetype* archetype);
+		~Chunk();
+
+		Entity* getEntities() { return reinterpret_cast<Entity*>(this->data); }
+		// Array of the component type, nullptr if the archetype does not have the component.
+		void* getComponents(ComponentID id);
+
+		template<typename T>
+		T* get() { return static_cast<T*>(getComponents(Component::getID<T>())); }
+
+		uint32_t getCount() const { return this->count; }
+		Archetype* getArchetype() const { return this->archetype; }
+
+		friend class Archetype;
+	private:
+		Archetype* archetype;
+		uint8_t* data;
+		uint32_t count;
+	};
+
+	/*
+		All entities with the same set of component types. An archetype has one or more chunks, all of them are full except for the
+		last one.
+	*/
+	class Archetype
+	{
+	public:
+		Archetype(const ComponentMask& mask);
+		~Archetype();
+
+		/*
+			Add an entity at the end of the last chunk, a new chunk is created if it is full. The components are not initialized.
+		*/
+		void add(Entity entity, uint32_t& chunkIndex, uint32_t& row);
+
+		/*
+			Remove an entity by moving the last entity of the archetype to its place. Returns the entity which was moved, this is a
+			null entity if the removed entity was the last one.
+		*/
+		Entity remove(uint32_t chunkIndex, uint32_t row);
+
+		void* getComponent(ComponentID id, uint32_t chunkIndex, uint32_t row);
+
+		const ComponentMask& getMask() const { return this->mask; }
+		const std::vector<ComponentID>& getComponentIDs() const { return this->componentIDs; }
+		std::vector<Chunk*>& getChunks() { return this->chunks; }
+		uint32_t getComponentSize(ComponentID id) const { return this->sizes[id]; }
+		uint32_t getCapacity() const { return this->capacity; }
+		uint32_t getEntityCount() const;
+
+		friend class Chunk;
+	private:
+		// Size of a chunk with capacity entities, including the padding between the arrays.
+		uint32_t computeLayout(uint32_t capacity);
+
+	private:
+		ComponentMask mask;
+		std::vector<ComponentID> componentIDs;
+		uint32_t offsets[ECS_MAX_COMPONENT_TYPES];
+		uint32_t sizes[ECS_MAX_COMPONENT_TYPES];
+		uint32_t capacity;
+		std::vector<Chunk*> chunks;
+	};
+}
@@ -0,0 +1,30 @@
+#include "stdafx.h"
+#include "Component.h"
+
+std::vector<ym::ComponentInfo> ym::Component::infos;
+std::mutex ym::Component::mutex;
+
+ym::ComponentInfo ym::Component::getInfo(ComponentID id)
+{
+	std::lock_guard<std::mutex> lck(mutex);
+	return infos[id];
+}
+
+uint32_t ym::Component::getTypeCount()
+{
+	std::lock_guard<std::mutex> lck(mutex);
+	return (uint32_t)infos.size();
+}
+
+ym::ComponentID ym::Component::registerType(const char* name, uint32_t size, uint32_t alignment)
+{
+	std::lock_guard<std::mutex> lck(mutex);
+	YM_ASSERT(infos.size() < ECS_MAX_COMPONENT_TYPES, "Too many component types, increase ECS_MAX_COMPONENT_TYPES!");
+
+	ComponentInfo info;
+	info.name = name;
+	info.size = size;
+	info.alignment = alignment;
+	infos.push_back(info);
+	return (ComponentID)(infos.size() - 1);
+}
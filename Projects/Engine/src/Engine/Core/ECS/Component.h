@@ -1,9 +1,56 @@
 #pragma once
 
+#include <bitset>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <type_traits>
+#include <vector>
+
+#define ECS_MAX_COMPONENT_TYPES 64
+
 namespace ym
 {
+	using ComponentID = uint32_t;
+	using ComponentMask = std::bitset<ECS_MAX_COMPONENT_TYPES>;
+
+	struct ComponentInfo
+	{
+		std::string name;
+		uint32_t size;
+		uint32_t alignment;
+	};
+
+	/*
+		Components are plain structs, they are given an id the first time the type is used. Component data is moved between chunks
+		with memcpy and is never constructed or destructed, the types must therefore be trivially copyable.
+	*/
 	class Component
 	{
+	public:
+		template<typename T>
+		static ComponentID getID()
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Components must be trivially copyable!");
+			static const ComponentID id = registerType(typeid(T).name(), (uint32_t)sizeof(T), (uint32_t)alignof(T));
+			return id;
+		}
+
+		template<typename... Ts>
+		static ComponentMask getMask()
+		{
+			ComponentMask mask;
+			(mask.set(getID<Ts>()), ...);
+			return mask;
+		}
+
+		static ComponentInfo getInfo(ComponentID id);
+		static uint32_t getTypeCount();
+
+	private:
+		static ComponentID registerType(const char* name, uint32_t size, uint32_t alignment);
 
+		static std::vector<ComponentInfo> infos;
+		static std::mutex mutex;
 	};
 }
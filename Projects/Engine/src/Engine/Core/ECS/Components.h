@@ -0,0 +1,28 @@
+#pragma once
+
+#include "stdafx.h"
+
+namespace ym
+{
+	class Model;
+	class Sound;
+
+	// Components which are used by the engine.
+
+	struct Transform
+	{
+		glm::mat4 matrix{ 1.f };
+	};
+
+	struct ModelRef
+	{
+		Model* model{ nullptr };
+	};
+
+	// The position of the sound follows the translation of the transform.
+	struct SoundSource
+	{
+		Sound* sound{ nullptr };
+		glm::vec3 offset{ 0.f };
+	};
+}
@@ -0,0 +1,195 @@
+#include "stdafx.h"
+#include "Ecs.h"
+
+#include "Engine/Core/Threading/JobSystem.h"
+
+#include <algorithm>
+
+ym::ECS::ECS() : updating(false)
+{
+}
+
+ym::ECS::~ECS()
+{
+	destroy();
+}
+
+ym::ECS* ym::ECS::get()
+{
+	static ECS ecs;
+	return &ecs;
+}
+
+void ym::ECS::init()
+{
+}
+
+void ym::ECS::destroy()
+{
+	for (SystemEntry& entry : this->systems)
+		SAFE_DELETE(entry.system);
+	this->systems.clear();
+
+	for (Archetype* archetype : this->archetypeList)
+		SAFE_DELETE(archetype);
+	this->archetypeList.clear();
+	this->archetypes.clear();
+	this->records.clear();
+	this->freeIndices.clear();
+}
+
+void ym::ECS::update(float dt)
+{
+	for (SystemEntry& entry : this->systems)
+	{
+		System* system = entry.system;
+		system->begin(this, dt);
+
+		this->updating = true;
+		if (system->isParallel())
+			forEachChunkParallel(system->getQuery(), [system, dt](Chunk& chunk) { system->updateChunk(chunk, dt); });
+		else
+			forEachChunk(system->getQuery(), [system, dt](Chunk& chunk) { system->updateChunk(chunk, dt); });
+		this->updating = false;
+	}
+}
+
+void ym::ECS::removeEntity(Entity entity)
+{
+	YM_ASSERT(this->updating == false, "Entities can not be removed during the update of the systems!");
+	if (isAlive(entity) == false)
+		return;
+
+	EntityRecord& record = this->records[entity.index];
+	removeFromArchetype(record);
+	record.archetype = nullptr;
+	record.generation++;
+	this->freeIndices.push_back(entity.index);
+}
+
+bool ym::ECS::isAlive(Entity entity) const
+{
+	return entity.index < this->records.size() && this->records[entity.index].archetype != nullptr &&
+		this->records[entity.index].generation == entity.generation;
+}
+
+uint32_t ym::ECS::getEntityCount() const
+{
+	return (uint32_t)(this->records.size() - this->freeIndices.size());
+}
+
+void ym::ECS::forEachChunk(const EntityQuery& query, const std::function<void(Chunk&)>& func)
+{
+	for (Archetype* archetype : this->archetypeList)
+	{
+		if (query.matches(archetype->getMask()))
+		{
+			for (Chunk* chunk : archetype->getChunks())
+				func(*chunk);
+		}
+	}
+}
+
+void ym::ECS::forEachChunkParallel(const EntityQuery& query, const std::function<void(Chunk&)>& func)
+{
+	getChunks(query, this->chunkList);
+	std::vector<Chunk*>& chunks = this->chunkList;
+
+	JobCounter counter;
+	JobSystem::dispatch((uint32_t)chunks.size(), ECS_CHUNKS_PER_JOB, [&chunks, &func](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; i++)
+			func(*chunks[i]);
+	}, &counter);
+	JobSystem::wait(&counter);
+}
+
+void ym::ECS::addSystem(System* system, int32_t order)
+{
+	SystemEntry entry;
+	entry.system = system;
+	entry.order = order;
+	auto it = std::upper_bound(this->systems.begin(), this->systems.end(), entry,
+		[](const SystemEntry& a, const SystemEntry& b) { return a.order < b.order; });
+	this->systems.insert(it, entry);
+}
+
+void ym::ECS::removeSystem(System* system)
+{
+	auto it = std::find_if(this->systems.begin(), this->systems.end(), [system](const SystemEntry& entry) { return entry.system == system; });
+	if (it != this->systems.end())
+	{
+		delete it->system;
+		this->systems.erase(it);
+	}
+}
+
+ym::Archetype* ym::ECS::getArchetype(const ComponentMask& mask)
+{
+	auto it = this->archetypes.find(mask);
+	if (it != this->archetypes.end())
+		return it->second;
+
+	Archetype* archetype = new Archetype(mask);
+	this->archetypes[mask] = archetype;
+	this->archetypeList.push_back(archetype);
+	return archetype;
+}
+
+ym::Entity ym::ECS::allocateEntity(Archetype* archetype)
+{
+	Entity entity;
+	if (this->freeIndices.empty())
+	{
+		entity.index = (uint32_t)this->records.size();
+		this->records.push_back(EntityRecord());
+	}
+	else
+	{
+		entity.index = this->freeIndices.back();
+		this->freeIndices.pop_back();
+	}
+
+	EntityRecord& record = this->records[entity.index];
+	entity.generation = record.generation;
+	record.archetype = archetype;
+	archetype->add(entity, record.chunk, record.row);
+	return entity;
+}
+
+void ym::ECS::moveEntity(Entity entity, Archetype* archetype)
+{
+	YM_ASSERT(this->updating == false, "Components can not be added or removed during the update of the systems!");
+	EntityRecord& record = this->records[entity.index];
+	EntityRecord old = record;
+
+	uint32_t chunk, row;
+	archetype->add(entity, chunk, row);
+	for (ComponentID id : archetype->getComponentIDs())
+	{
+		if (old.archetype->getMask().test(id))
+			memcpy(archetype->getComponent(id, chunk, row), old.archetype->getComponent(id, old.chunk, old.row), archetype->getComponentSize(id));
+	}
+
+	removeFromArchetype(record);
+	record.archetype = archetype;
+	record.chunk = chunk;
+	record.row = row;
+}
+
+void ym::ECS::removeFromArchetype(EntityRecord& record)
+{
+	// The last entity of the archetype is moved to the removed slot.
+	Entity moved = record.archetype->remove(record.chunk, record.row);
+	if (moved.isNull() == false)
+	{
+		EntityRecord& movedRecord = this->records[moved.index];
+		movedRecord.chunk = record.chunk;
+		movedRecord.row = record.row;
+	}
+}
+
+void ym::ECS::getChunks(const EntityQuery& query, std::vector<Chunk*>& chunks)
+{
+	chunks.clear();
+	forEachChunk(query, [&chunks](Chunk& chunk) { chunks.push_back(&chunk); });
+}
@@ -2,18 +2,153 @@
 
 // https://docs.unity3d.com/Packages/com.unity.entities@0.1/manual/ecs_core.html
 
+#include "Archetype.h"
+#include "EntityQuery.h"
+#include "System.h"
+
+#include <functional>
+
+#define ECS_CHUNKS_PER_JOB 4 // Chunks which are updated by each job of a parallel system.
+
 namespace ym
 {
+	/*
+		Entities are sets of components. All entities with the same component types belong to one archetype, where the components are
+		stored in packed arrays inside chunks. An entity which gets a component added or removed is moved to a new archetype.
+	*/
 	class ECS
 	{
 	public:
-		void addEntity(/*List of components*/);
-		void removeEntity(/*Handler to entity*/);
-		void removeComponentFromEntity(/*Handler to entity and component type*/);
+		ECS();
+		~ECS();
+
+		static ECS* get();
+
+		void init();
+		void destroy();
+
+		/*
+			Update all systems.
+		*/
+		void update(float dt);
+
+		template<typename... Ts>
+		Entity createEntity(const Ts&... components);
+		void removeEntity(Entity entity);
+		bool isAlive(Entity entity) const;
+		uint32_t getEntityCount() const;
+
+		template<typename T>
+		void addComponent(Entity entity, const T& component);
+		template<typename T>
+		void removeComponent(Entity entity);
+		// Pointer to the component of the entity, nullptr if it does not have it. The pointer is invalid after a structural change.
+		template<typename T>
+		T* getComponent(Entity entity);
+		template<typename T>
+		bool hasComponent(Entity entity) const;
+
+		/*
+			Call func for each chunk which matches the query.
+		*/
+		void forEachChunk(const EntityQuery& query, const std::function<void(Chunk&)>& func);
+
+		/*
+			Call func for each chunk which matches the query, the chunks are split into jobs. Returns when all chunks are done.
+		*/
+		void forEachChunkParallel(const EntityQuery& query, const std::function<void(Chunk&)>& func);
+
+		/*
+			Add a system which is updated in ascending order. Systems with the same order are updated in the order they were added.
+			The ECS takes ownership of the system.
+		*/
+		void addSystem(System* system, int32_t order = 0);
+		void removeSystem(System* system);
+
+	private:
+		struct EntityRecord
+		{
+			Archetype* archetype{ nullptr };
+			uint32_t chunk{ 0 };
+			uint32_t row{ 0 };
+			uint32_t generation{ 0 };
+		};
+
+		struct SystemEntry
+		{
+			System* system;
+			int32_t order;
+		};
+
+		Archetype* getArchetype(const ComponentMask& mask);
+		Entity allocateEntity(Archetype* archetype);
+		// Move the entity to another archetype, the components which are in both archetypes are copied.
+		void moveEntity(Entity entity, Archetype* archetype);
+		void removeFromArchetype(EntityRecord& record);
+		void getChunks(const EntityQuery& query, std::vector<Chunk*>& chunks);
+
 	private:
-		// An entity (A set of components) can be changed and thus moved to a new archtype.
-		// Archtype (All entities with the same type of components)
-		// Archtype chunk (A memory block of archtypes, A archtype can have many archtype chunks, Always packed!)
-		// Systems can be in groups. The update order (of entities within the group or of the groups) can be changed by the programmer!
+		std::unordered_map<ComponentMask, Archetype*> archetypes;
+		std::vector<Archetype*> archetypeList;
+		std::vector<EntityRecord> records;
+		std::vector<uint32_t> freeIndices;
+		std::vector<SystemEntry> systems;
+		std::vector<Chunk*> chunkList;
+		bool updating;
 	};
-}
\ No newline at end of file
+
+	template<typename... Ts>
+	inline Entity ECS::createEntity(const Ts&... components)
+	{
+		YM_ASSERT(this->updating == false, "Entities can not be created during the update of the systems!");
+		Entity entity = allocateEntity(getArchetype(Component::getMask<Ts...>()));
+		EntityRecord& record = this->records[entity.index];
+		(memcpy(record.archetype->getComponent(Component::getID<Ts>(), record.chunk, record.row), &components, sizeof(Ts)), ...);
+		return entity;
+	}
+
+	template<typename T>
+	inline void ECS::addComponent(Entity entity, const T& component)
+	{
+		YM_ASSERT(isAlive(entity), "Tried to add a component to an entity which does not exist!");
+		ComponentID id = Component::getID<T>();
+		EntityRecord& record = this->records[entity.index];
+		if (record.archetype->getMask().test(id) == false)
+		{
+			ComponentMask mask = record.archetype->getMask();
+			moveEntity(entity, getArchetype(mask.set(id)));
+		}
+		memcpy(record.archetype->getComponent(id, record.chunk, record.row), &component, sizeof(T));
+	}
+
+	template<typename T>
+	inline void ECS::removeComponent(Entity entity)
+	{
+		YM_ASSERT(isAlive(entity), "Tried to remove a component from an entity which does not exist!");
+		ComponentID id = Component::getID<T>();
+		EntityRecord& record = this->records[entity.index];
+		if (record.archetype->getMask().test(id))
+		{
+			ComponentMask mask = record.archetype->getMask();
+			moveEntity(entity, getArchetype(mask.reset(id)));
+		}
+	}
+
+	template<typename T>
+	inline T* ECS::getComponent(Entity entity)
+	{
+		if (isAlive(entity) == false)
+			return nullptr;
+		ComponentID id = Component::getID<T>();
+		EntityRecord& record = this->records[entity.index];
+		if (record.archetype->getMask().test(id) == false)
+			return nullptr;
+		return static_cast<T*>(record.archetype->getComponent(id, record.chunk, record.row));
+	}
+
+	template<typename T>
+	inline bool ECS::hasComponent(Entity entity) const
+	{
+		return isAlive(entity) && this->records[entity.index].archetype->getMask().test(Component::getID<T>());
+	}
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+#define ECS_NULL_ENTITY UINT32_MAX
+
+namespace ym
+{
+	/*
+		Handle to an entity. The index is reused when an entity is removed, the generation is increased at the same time so that old
+		handles can be detected.
+	*/
+	struct Entity
+	{
+		uint32_t index{ ECS_NULL_ENTITY };
+		uint32_t generation{ 0 };
+
+		bool isNull() const { return this->index == ECS_NULL_ENTITY; }
+		bool operator==(const Entity& other) const { return this->index == other.index && this->generation == other.generation; }
+		bool operator!=(const Entity& other) const { return !(*this == other); }
+	};
+}
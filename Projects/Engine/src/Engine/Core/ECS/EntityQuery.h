@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Component.h"
+
+namespace ym
+{
+	/*
+		Selects archetypes by their component types.
+		* All - the archetype must contain all of the component types in the All category.
+		* Any - the archetype must contain at least one of the component types in the Any category.
+		* None - the archetype must not contain any of the component types in the None category.
+	*/
+	struct EntityQuery
+	{
+		ComponentMask all;
+		ComponentMask any;
+		ComponentMask none;
+
+		template<typename... Ts>
+		EntityQuery& withAll() { this->all |= Component::getMask<Ts...>(); return *this; }
+		template<typename... Ts>
+		EntityQuery& withAny() { this->any |= Component::getMask<Ts...>(); return *this; }
+		template<typename... Ts>
+		EntityQuery& withNone() { this->none |= Component::getMask<Ts...>(); return *this; }
+
+		bool matches(const ComponentMask& mask) const
+		{
+			return (mask & this->all) == this->all && (this->any.none() || (mask & this->any).any()) && (mask & this->none).none();
+		}
+	};
+}
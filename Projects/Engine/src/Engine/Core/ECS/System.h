@@ -1,12 +1,34 @@
 #pragma once
 
+#include "EntityQuery.h"
+#include "Archetype.h"
+
 namespace ym
 {
+	class ECS;
+
+	/*
+		Updates the chunks of all archetypes which match the query of the system. Systems are updated in the order they were added
+		to the ECS, sorted by their order.
+
+		A parallel system is given the chunks from multiple jobs at the same time, updateChunk must then only write to the chunk it is
+		given. Entities and components can not be added or removed during the update.
+	*/
 	class System
 	{
-		// Can filter which entities will be processed by:
-		// * All  the archetype must contain all of the component types in the All category.
-		// * Any  the archetype must contain at least one of the component types in the Any category.
-		// * None  the archetype must not contain any of the component types in the None category.
+	public:
+		System() : parallel(false) {}
+		virtual ~System() {}
+
+		// Called on the main thread before the chunks are updated.
+		virtual void begin(ECS* ecs, float dt) {}
+		virtual void updateChunk(Chunk& chunk, float dt) = 0;
+
+		const EntityQuery& getQuery() const { return this->query; }
+		bool isParallel() const { return this->parallel; }
+
+	protected:
+		EntityQuery query;
+		bool parallel;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,21 @@
+#include "stdafx.h"
+#include "SoundSourceSystem.h"
+
+#include "../Components.h"
+#include "Engine/Core/Audio/Sound.h"
+
+ym::SoundSourceSystem::SoundSourceSystem()
+{
+	this->query.withAll<Transform, SoundSource>();
+}
+
+void ym::SoundSourceSystem::updateChunk(Chunk& chunk, float dt)
+{
+	const Transform* transforms = chunk.get<Transform>();
+	const SoundSource* sources = chunk.get<SoundSource>();
+	for (uint32_t i = 0; i < chunk.getCount(); i++)
+	{
+		if (sources[i].sound != nullptr)
+			sources[i].sound->setSourcePosition(glm::vec3(transforms[i].matrix[3]) + sources[i].offset);
+	}
+}
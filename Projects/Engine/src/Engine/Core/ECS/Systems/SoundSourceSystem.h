@@ -0,0 +1,17 @@
+#pragma once
+
+#include "../System.h"
+
+namespace ym
+{
+	/*
+		Moves the sound of each SoundSource to the translation of its Transform.
+	*/
+	class SoundSourceSystem : public System
+	{
+	public:
+		SoundSourceSystem();
+
+		void updateChunk(Chunk& chunk, float dt) override;
+	};
+}
@@ -1,7 +1,7 @@
 #include "stdafx.h"
 #include "CubeMapRenderer.h"
 
-#include "Engine/Core/Threading/ThreadManager.h"
+#include "Engine/Core/Threading/JobSystem.h"
 #include "Engine/Core/Scene/Vertex.h"
 #include "Engine/Core/Vulkan/Pipeline/DescriptorSet.h"
 #include "Engine/Core/Scene/Model/Material.h"
@@ -166,13 +166,18 @@ void ym::CubeMapRenderer::end(uint32_t imageIndex)
 			{
 				uint32_t instanceCount = (uint32_t)drawData.second.transforms.size();
 				drawData.second.transformsBuffer.transfer(drawData.second.transforms.data(), sizeof(glm::mat4) * instanceCount, 0);
-				ThreadManager::addWork(this->threadID, [=]() {
-					recordCubeMap(drawData.second.model, imageIndex, drawData.second.descriptorSet, instanceCount, currentBuffer);
-					});
 			}
 		}
 
-		ThreadManager::wait(this->threadID);
+		// All cube maps are recorded into the same command buffer, this needs to be done by one job.
+		JobCounter counter;
+		std::map<uint64_t, DrawData>* batch = &this->drawBatch[imageIndex];
+		JobSystem::execute([this, batch, imageIndex, currentBuffer]() {
+			for (auto& drawData : *batch)
+				if (drawData.second.exists)
+					recordCubeMap(drawData.second.model, imageIndex, drawData.second.descriptorSet, (uint32_t)drawData.second.transforms.size(), currentBuffer);
+			}, &counter);
+		JobSystem::wait(&counter);
 	};
 	currentBuffer->end();
 }
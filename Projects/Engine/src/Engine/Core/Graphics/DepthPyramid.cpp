@@ -0,0 +1,142 @@
+#include "stdafx.h"
+#include "DepthPyramid.h"
+
+#include "Engine/Core/Vulkan/Factory.h"
+#include "Engine/Core/Vulkan/Pipeline/DescriptorSet.h"
+#include "Engine/Core/Application/LayerManager.h"
+
+ym::DepthPyramid::DepthPyramid() : width(0), height(0), levelCount(0), pyramid(nullptr)
+{
+}
+
+ym::DepthPyramid::~DepthPyramid()
+{
+}
+
+void ym::DepthPyramid::init(uint32_t width, uint32_t height)
+{
+	this->width = width;
+	this->height = height;
+
+	// Halve each side, rounded up, until a single texel is left.
+	this->levelSizes.clear();
+	glm::ivec2 size((int)width, (int)height);
+	do
+	{
+		size = glm::max((size + 1) / 2, glm::ivec2(1));
+		this->levelSizes.push_back(size);
+	} while (size.x > 1 || size.y > 1);
+	this->levelCount = (uint32_t)this->levelSizes.size();
+
+	TextureDesc textureDesc = {};
+	textureDesc.width = (uint32_t)this->levelSizes[0].x;
+	textureDesc.height = (uint32_t)this->levelSizes[0].y;
+	textureDesc.format = VK_FORMAT_R32_SFLOAT;
+	textureDesc.data = nullptr;
+	this->pyramid = Factory::createTexture(textureDesc, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_QUEUE_GRAPHICS_BIT, VK_IMAGE_ASPECT_COLOR_BIT, this->levelCount);
+	this->levelViews.resize(this->levelCount);
+	for (uint32_t level = 0; level < this->levelCount; level++)
+		this->levelViews[level].init(this->pyramid->image.getImage(), VK_IMAGE_VIEW_TYPE_2D, textureDesc.format, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, level);
+
+	// The levels are written as storage images and read with texelFetch, both in the general layout.
+	CommandPool* pool = &LayerManager::get()->getCommandPools()->graphicsPool;
+	CommandBuffer* cmdBuffer = pool->beginSingleTimeCommand();
+	this->pyramid->image.setLayout(cmdBuffer, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	pool->endSingleTimeCommand(cmdBuffer);
+
+	this->sampler.init(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, (float)this->levelCount);
+	Factory::applyTextureDescriptor(this->pyramid, &this->sampler);
+
+	this->layout.add(new IMG(VK_SHADER_STAGE_COMPUTE_BIT)); // Source, the depth buffer or the level before
+	this->layout.add(new StorageIMG(VK_SHADER_STAGE_COMPUTE_BIT)); // Destination level
+	this->layout.init();
+
+	VkPushConstantRange pushConstRange = {};
+	pushConstRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstRange.size = sizeof(PushData);
+	pushConstRange.offset = 0;
+	std::vector<DescriptorLayout> descriptorLayouts = { this->layout };
+
+	this->shader.addStage(Shader::Type::COMPUTE, YM_ASSETS_FILE_PATH + DEPTH_PYRAMID_SHADER);
+	this->shader.init();
+	this->pipeline.setPushConstant(pushConstRange);
+	this->pipeline.setDescriptorLayouts(descriptorLayouts);
+	this->pipeline.init(Pipeline::Type::COMPUTE, &this->shader);
+}
+
+void ym::DepthPyramid::destroy()
+{
+	this->pipeline.destroy();
+	this->shader.destroy();
+	if (this->descriptorPool.wasCreated())
+		this->descriptorPool.destroy();
+	this->layout.destroy();
+	this->sampler.destroy();
+
+	for (ImageView& view : this->levelViews)
+		view.destroy();
+	this->levelViews.clear();
+	if (this->pyramid)
+		this->pyramid->destroy();
+	SAFE_DELETE(this->pyramid);
+}
+
+void ym::DepthPyramid::setDepth(VkImageView depthView, VkImageLayout depthLayout)
+{
+	if (this->descriptorPool.wasCreated())
+		this->descriptorPool.destroy();
+
+	this->descriptorPool.addDescriptorLayout(this->layout, this->levelCount);
+	this->descriptorPool.init(this->levelCount);
+
+	this->descriptorSets.resize(this->levelCount, VK_NULL_HANDLE);
+	for (uint32_t level = 0; level < this->levelCount; level++)
+	{
+		DescriptorSet set;
+		set.init(this->layout, &this->descriptorSets[level], &this->descriptorPool);
+		if (level == 0)
+			set.setImageDesc(0, depthLayout, depthView, this->sampler.getSampler());
+		else
+			set.setImageDesc(0, VK_IMAGE_LAYOUT_GENERAL, this->levelViews[level - 1].getImageView(), this->sampler.getSampler());
+		set.setImageDesc(1, VK_IMAGE_LAYOUT_GENERAL, this->levelViews[level].getImageView(), VK_NULL_HANDLE);
+		set.update();
+	}
+}
+
+void ym::DepthPyramid::record(CommandBuffer* cmdBuffer)
+{
+	YM_ASSERT(this->descriptorSets.empty() == false, "The depth pyramid needs a depth buffer before it is built!");
+
+	// The culling of the frames before reads the pyramid which is overwritten now.
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cmdBuffer->cmdMemoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, { barrier });
+
+	cmdBuffer->cmdBindPipeline(&this->pipeline);
+	std::vector<uint32_t> offsets;
+	glm::ivec2 sourceSize((int)this->width, (int)this->height);
+	for (uint32_t level = 0; level < this->levelCount; level++)
+	{
+		PushData pushData;
+		pushData.sourceSize = sourceSize;
+		pushData.destinationSize = this->levelSizes[level];
+		std::vector<VkDescriptorSet> sets = { this->descriptorSets[level] };
+		cmdBuffer->cmdBindDescriptorSets(&this->pipeline, 0, sets, offsets);
+		cmdBuffer->cmdPushConstants(&this->pipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushData), &pushData);
+		cmdBuffer->cmdDispatch(((uint32_t)pushData.destinationSize.x + DEPTH_PYRAMID_WORKGROUP_SIZE - 1) / DEPTH_PYRAMID_WORKGROUP_SIZE,
+			((uint32_t)pushData.destinationSize.y + DEPTH_PYRAMID_WORKGROUP_SIZE - 1) / DEPTH_PYRAMID_WORKGROUP_SIZE, 1);
+
+		// The next level reads this one, the last barrier makes the pyramid visible to the culling.
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		cmdBuffer->cmdMemoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, { barrier });
+		sourceSize = pushData.destinationSize;
+	}
+}
+
+VkDescriptorImageInfo ym::DepthPyramid::getDescriptor() const
+{
+	return this->pyramid->descriptor;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Engine/Core/Vulkan/CommandBuffer.h"
+#include "Engine/Core/Vulkan/Texture.h"
+#include "Engine/Core/Vulkan/Sampler.h"
+#include "Engine/Core/Vulkan/Pipeline/Pipeline.h"
+#include "Engine/Core/Vulkan/Pipeline/Shader.h"
+#include "Engine/Core/Vulkan/Pipeline/DescriptorLayout.h"
+#include "Engine/Core/Vulkan/Pipeline/DescriptorPool.h"
+
+#define DEPTH_PYRAMID_WORKGROUP_SIZE 8 // Needs to match local_size_x and local_size_y in depthPyramidComp.glsl.
+#define DEPTH_PYRAMID_SHADER "Shaders/depthPyramidComp.spv"
+
+namespace ym
+{
+	/*
+		Hierarchical depth buffer, every texel holds the farthest depth of the texels below it. Level 0 is half the size of the depth
+		buffer, rounded up, and every level is half the size of the one before it down to a single texel. A texel of level L covers
+		the depth pixels of a square of 2 << L pixels. The pyramid stays in VK_IMAGE_LAYOUT_GENERAL and is built on the graphics queue.
+	*/
+	class DepthPyramid
+	{
+	public:
+		DepthPyramid();
+		~DepthPyramid();
+
+		/*
+			Create the pyramid for a depth buffer of width x height pixels.
+		*/
+		void init(uint32_t width, uint32_t height);
+		void destroy();
+
+		/*
+			Set the depth buffer which the pyramid is built from, it needs to be in the layout when the build is executed.
+		*/
+		void setDepth(VkImageView depthView, VkImageLayout depthLayout);
+
+		/*
+			Record the build of all levels. The writes of the depth need to be visible to compute shaders, the pyramid can be read by
+			compute shaders after it.
+		*/
+		void record(CommandBuffer* cmdBuffer);
+
+		VkDescriptorImageInfo getDescriptor() const;
+		uint32_t getWidth() const { return this->width; }
+		uint32_t getHeight() const { return this->height; }
+		uint32_t getLevelCount() const { return this->levelCount; }
+
+	private:
+		struct PushData
+		{
+			glm::ivec2 sourceSize;
+			glm::ivec2 destinationSize;
+		};
+
+	private:
+		uint32_t width;
+		uint32_t height;
+		uint32_t levelCount;
+		std::vector<glm::ivec2> levelSizes;
+
+		Texture* pyramid;
+		std::vector<ImageView> levelViews; // One view for each level, the levels are written and read one at a time.
+		Sampler sampler;
+
+		DescriptorLayout layout;
+		DescriptorPool descriptorPool;
+		std::vector<VkDescriptorSet> descriptorSets; // Set of each level, it reads the level before it or the depth buffer.
+		Pipeline pipeline;
+		Shader shader;
+	};
+}
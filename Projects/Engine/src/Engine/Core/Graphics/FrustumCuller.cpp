@@ -0,0 +1,133 @@
+#include "stdafx.h"
+#include "FrustumCuller.h"
+
+#include "Engine/Core/Threading/JobSystem.h"
+
+#include <xmmintrin.h>
+
+ym::FrustumCuller::FrustumCuller() : count(0), visibleCount(0)
+{
+	for (uint32_t p = 0; p < 6; p++)
+	{
+		this->planeX[p] = 0.f;
+		this->planeY[p] = 0.f;
+		this->planeZ[p] = 0.f;
+		this->planeDistance[p] = 0.f;
+	}
+}
+
+ym::FrustumCuller::~FrustumCuller()
+{
+}
+
+void ym::FrustumCuller::begin(const std::vector<Camera::Plane>& planes)
+{
+	YM_ASSERT(planes.size() == 6, "The frustum needs six planes! Planes: {}", planes.size());
+	for (uint32_t p = 0; p < 6; p++)
+	{
+		this->planeX[p] = planes[p].normal.x;
+		this->planeY[p] = planes[p].normal.y;
+		this->planeZ[p] = planes[p].normal.z;
+		this->planeDistance[p] = -glm::dot(planes[p].normal, planes[p].point);
+	}
+
+	this->count = 0;
+	this->visibleCount = 0;
+}
+
+uint32_t ym::FrustumCuller::add(const glm::mat4& transform, const Bounds& bounds)
+{
+	if (this->count == (uint32_t)this->x.size())
+	{
+		const size_t size = this->x.size() + 4;
+		this->x.resize(size, 0.f);
+		this->y.resize(size, 0.f);
+		this->z.resize(size, 0.f);
+		this->radius.resize(size, 0.f);
+		this->visible.resize(size, 0);
+	}
+
+	// The radius is scaled by the largest axis, which keeps the sphere conservative for non-uniform scales.
+	const glm::vec3 center = glm::vec3(transform * glm::vec4(bounds.center, 1.f));
+	const float scaleSq = std::max(glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+		std::max(glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])), glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))));
+
+	const uint32_t index = this->count++;
+	this->x[index] = center.x;
+	this->y[index] = center.y;
+	this->z[index] = center.z;
+	this->radius[index] = bounds.radius * std::sqrt(scaleSq);
+	return index;
+}
+
+void ym::FrustumCuller::cull(bool useJobs)
+{
+	YM_PROFILER_FUNCTION();
+	this->visibleCount = 0;
+	if (useJobs == false || this->count <= FRUSTUM_CULLER_GROUP_SIZE)
+	{
+		cullRange(0, this->count);
+		return;
+	}
+
+	JobCounter counter;
+	JobSystem::dispatch(this->count, FRUSTUM_CULLER_GROUP_SIZE, [this](uint32_t first, uint32_t last) { cullRange(first, last); }, &counter);
+	JobSystem::wait(&counter);
+}
+
+void ym::FrustumCuller::cullScalar()
+{
+	uint32_t visibleCount = 0;
+	for (uint32_t i = 0; i < this->count; i++)
+	{
+		bool inside = true;
+		for (uint32_t p = 0; p < 6; p++)
+		{
+			const float distance = ((this->planeX[p] * this->x[i] + this->planeY[p] * this->y[i]) + this->planeZ[p] * this->z[i]) + this->planeDistance[p];
+			inside = inside && distance > -this->radius[i];
+		}
+		this->visible[i] = inside ? 1 : 0;
+		visibleCount += inside ? 1 : 0;
+	}
+	this->visibleCount = visibleCount;
+}
+
+void ym::FrustumCuller::cullRange(uint32_t first, uint32_t last)
+{
+	__m128 planeX[6], planeY[6], planeZ[6], planeDistance[6];
+	for (uint32_t p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(this->planeX[p]);
+		planeY[p] = _mm_set1_ps(this->planeY[p]);
+		planeZ[p] = _mm_set1_ps(this->planeZ[p]);
+		planeDistance[p] = _mm_set1_ps(this->planeDistance[p]);
+	}
+
+	// The first index is always a multiple of 4, the padding lets the last group read past the count.
+	uint32_t visibleCount = 0;
+	for (uint32_t i = first; i < last; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(this->x.data() + i);
+		const __m128 y = _mm_loadu_ps(this->y.data() + i);
+		const __m128 z = _mm_loadu_ps(this->z.data() + i);
+		const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(this->radius.data() + i));
+
+		__m128 inside = _mm_cmpeq_ps(x, x); // All bits set.
+		for (uint32_t p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y));
+			distance = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(planeZ[p], z)), planeDistance[p]);
+			inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negRadius));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		const uint32_t lanes = std::min(last - i, 4u);
+		for (uint32_t lane = 0; lane < lanes; lane++)
+		{
+			const uint8_t isInside = (uint8_t)((mask >> lane) & 1);
+			this->visible[i + lane] = isInside;
+			visibleCount += isInside;
+		}
+	}
+	this->visibleCount += visibleCount;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Engine/Core/Camera.h"
+#include "Engine/Core/Scene/Model/Model.h"
+#include <atomic>
+
+#define FRUSTUM_CULLER_GROUP_SIZE 4096 // Instances which are tested by one job, needs to be a multiple of 4.
+
+namespace ym
+{
+	/*
+		Tests the bounding spheres of instances against the six planes of a camera frustum. The spheres are transformed to world space
+		when they are added and are stored as a structure of arrays, they are tested four at a time with SSE. Large sets of instances
+		are split into jobs on the job system.
+	*/
+	class FrustumCuller
+	{
+	public:
+		FrustumCuller();
+		~FrustumCuller();
+
+		/*
+			Set the planes to test against and remove all instances.
+		*/
+		void begin(const std::vector<Camera::Plane>& planes);
+
+		/*
+			Add the bounds of an instance with its transform. Returns the index of the instance.
+		*/
+		uint32_t add(const glm::mat4& transform, const Bounds& bounds);
+
+		/*
+			Test all instances. If useJobs is true, groups of FRUSTUM_CULLER_GROUP_SIZE instances are tested on the job system.
+		*/
+		void cull(bool useJobs = true);
+
+		/*
+			Test all instances one at a time without SSE, the result is the same as cull. Only used as a reference.
+		*/
+		void cullScalar();
+
+		bool isVisible(uint32_t index) const { return this->visible[index] != 0; }
+		uint32_t getCount() const { return this->count; }
+		uint32_t getVisibleCount() const { return this->visibleCount.load(); }
+
+	private:
+		void cullRange(uint32_t first, uint32_t last);
+
+		// Normals point into the frustum, a point p is inside a plane if dot(normal, p) + distance >= 0.
+		float planeX[6];
+		float planeY[6];
+		float planeZ[6];
+		float planeDistance[6];
+
+		// The arrays are padded to a multiple of 4, the padding is tested but never read.
+		uint32_t count;
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+		std::vector<float> radius;
+		std::vector<uint8_t> visible;
+		std::atomic<uint32_t> visibleCount;
+	};
+}
@@ -0,0 +1,457 @@
+#include "stdafx.h"
+#include "GpuCuller.h"
+
+#include "Engine/Core/Vulkan/VulkanInstance.h"
+#include "Engine/Core/Vulkan/Pipeline/DescriptorSet.h"
+
+ym::GpuCuller::GpuCuller() : frameCount(0), frameIndex(0), pushData(), instanceCapacity(0), groupCapacity(0), commandCapacity(0), transforms(),
+	lastInstanceCount(0), lastVisibleCount(0), lastTestedCount(0), lastOccludedCount(0), lastCommandCount(0), lastDrawCount(0), occlusion(false), depthPyramid(nullptr),
+	occlusionViewProjection(1.f), occlusionPyramidView(VK_NULL_HANDLE), shouldUpdateDescriptors(true), descriptorSet(VK_NULL_HANDLE),
+	instanceDescriptorSet(VK_NULL_HANDLE), occlusionDescriptorSet(VK_NULL_HANDLE)
+{
+}
+
+ym::GpuCuller::~GpuCuller()
+{
+}
+
+bool ym::GpuCuller::isSupported(bool occlusion, std::string* reason)
+{
+	std::string missing;
+	if (VulkanInstance::get()->supportsIndirectDraws() == false)
+		missing = "the device does not support multi draw indirect, indirect draws with a first instance or indirect count draws";
+	else if (Shader::exists(YM_ASSETS_FILE_PATH + GPU_CULLER_CULL_SHADER) == false)
+		missing = std::string(GPU_CULLER_CULL_SHADER) + " has not been compiled";
+	else if (Shader::exists(YM_ASSETS_FILE_PATH + GPU_CULLER_COMMAND_SHADER) == false)
+		missing = std::string(GPU_CULLER_COMMAND_SHADER) + " has not been compiled";
+	else if (occlusion && Shader::exists(YM_ASSETS_FILE_PATH + GPU_CULLER_OCCLUSION_SHADER) == false)
+		missing = std::string(GPU_CULLER_OCCLUSION_SHADER) + " has not been compiled";
+	else if (occlusion && Shader::exists(YM_ASSETS_FILE_PATH + DEPTH_PYRAMID_SHADER) == false)
+		missing = std::string(DEPTH_PYRAMID_SHADER) + " has not been compiled";
+
+	if (reason)
+		*reason = missing;
+	return missing.empty();
+}
+
+void ym::GpuCuller::init(uint32_t frameCount, const DescriptorLayout& instanceLayout, bool occlusion)
+{
+	this->frameCount = frameCount;
+	this->occlusion = occlusion;
+	this->instanceLayout = instanceLayout;
+	this->frameGroupCounts.resize(frameCount, 0);
+	this->frameInstanceCounts.resize(frameCount, 0);
+	this->frameCommandCounts.resize(frameCount, 0);
+	this->frameBatchCounts.resize(frameCount, 0);
+
+	// The instance buffers are created by the first begin, when the capacity of the transform buffer is known.
+	this->groupCapacity = GPU_CULLER_GROUP_START_COUNT;
+	this->commandCapacity = GPU_CULLER_COMMAND_START_COUNT;
+	this->groupBuffer.init(sizeof(Group) * this->groupCapacity, frameCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	this->visibleCountBuffer.init(sizeof(uint32_t) * this->groupCapacity, frameCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	this->commandBuffer.init(sizeof(Command) * this->commandCapacity, frameCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	this->indirectBuffer.init(GPU_CULLER_INDIRECT_STRIDE * this->commandCapacity, frameCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+	this->drawCountBuffer.init(sizeof(uint32_t) * this->commandCapacity, frameCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+	this->occlusionBuffer.init(sizeof(Occlusion), frameCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	for (uint32_t f = 0; f < frameCount; f++)
+		memset(this->occlusionBuffer.getData(f * sizeof(Occlusion)), 0, sizeof(Occlusion));
+
+	createPipelines();
+}
+
+void ym::GpuCuller::destroy()
+{
+	this->cullPipeline.destroy();
+	this->commandPipeline.destroy();
+	this->cullShader.destroy();
+	this->commandShader.destroy();
+	this->descriptorPool.destroy();
+	this->layout.destroy();
+	if (this->occlusion)
+	{
+		this->occlusionCullPipeline.destroy();
+		this->occlusionCullShader.destroy();
+		if (this->occlusionDescriptorPool.wasCreated())
+			this->occlusionDescriptorPool.destroy();
+		this->occlusionLayout.destroy();
+	}
+
+	this->instanceGroupBuffer.destroy();
+	this->groupBuffer.destroy();
+	this->commandBuffer.destroy();
+	this->visibleCountBuffer.destroy();
+	this->indirectBuffer.destroy();
+	this->drawCountBuffer.destroy();
+	this->culledTransformBuffer.destroy();
+	this->occlusionBuffer.destroy();
+}
+
+void ym::GpuCuller::setTransforms(VkDescriptorBufferInfo transforms)
+{
+	this->transforms = transforms;
+	this->shouldUpdateDescriptors = true;
+}
+
+void ym::GpuCuller::setOcclusion(const DepthPyramid* depthPyramid, const glm::mat4& viewProjection)
+{
+	YM_ASSERT(depthPyramid == nullptr || this->occlusion, "GpuCuller was initialized without occlusion culling!");
+	this->depthPyramid = depthPyramid;
+	this->occlusionViewProjection = viewProjection;
+}
+
+void ym::GpuCuller::begin(uint32_t frameIndex, const std::vector<Camera::Plane>& planes, uint32_t instanceCapacity)
+{
+	YM_ASSERT(planes.size() == 6, "The frustum needs six planes! Planes: {}", planes.size());
+	this->frameIndex = frameIndex;
+
+	// The GPU is done with this frame, count what it found visible the last time.
+	const uint32_t groupBase = (uint32_t)(this->frameIndex * this->groupCapacity);
+	const uint32_t* visibleCounts = static_cast<const uint32_t*>(this->visibleCountBuffer.getData(groupBase * sizeof(uint32_t)));
+	this->lastVisibleCount = 0;
+	for (uint32_t g = 0; g < this->frameGroupCounts[frameIndex]; g++)
+		this->lastVisibleCount += visibleCounts[g];
+	this->lastInstanceCount = this->frameInstanceCounts[frameIndex];
+
+	const Occlusion* occlusion = static_cast<const Occlusion*>(this->occlusionBuffer.getData(this->frameIndex * sizeof(Occlusion)));
+	this->lastTestedCount = occlusion->testedCount;
+	this->lastOccludedCount = occlusion->occludedCount;
+
+	// Only the commands with visible instances are counted in the draw counts of the batches.
+	const uint32_t* drawCounts = static_cast<const uint32_t*>(this->drawCountBuffer.getData(this->frameIndex * this->commandCapacity * sizeof(uint32_t)));
+	this->lastCommandCount = this->frameCommandCounts[frameIndex];
+	this->lastDrawCount = 0;
+	for (uint32_t b = 0; b < this->frameBatchCounts[frameIndex]; b++)
+		this->lastDrawCount += drawCounts[b];
+
+	// The instance buffers use the same indices as the transform buffer, they need the same capacity.
+	if (instanceCapacity != this->instanceCapacity)
+	{
+		if (this->instanceCapacity > 0)
+			vkDeviceWaitIdle(VulkanInstance::get()->getLogicalDevice());
+		this->instanceCapacity = instanceCapacity;
+		this->instanceGroupBuffer.destroy();
+		this->culledTransformBuffer.destroy();
+		this->instanceGroupBuffer.init(sizeof(uint32_t) * this->instanceCapacity, this->frameCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		this->culledTransformBuffer.init(sizeof(glm::mat4) * this->instanceCapacity, this->frameCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		this->shouldUpdateDescriptors = true;
+	}
+
+	for (uint32_t p = 0; p < 6; p++)
+		this->pushData.planes[p] = glm::vec4(planes[p].normal, -glm::dot(planes[p].normal, planes[p].point));
+	this->pushData.instanceBase = (uint32_t)(this->frameIndex * this->instanceCapacity);
+
+	this->groups.clear();
+	this->commands.clear();
+	this->batches.clear();
+	this->instanceGroups.clear();
+}
+
+uint32_t ym::GpuCuller::addGroup(const Bounds& bounds, uint32_t firstInstance, uint32_t instanceCount)
+{
+	YM_ASSERT(firstInstance >= this->pushData.instanceBase && firstInstance + instanceCount <= this->pushData.instanceBase + this->instanceCapacity,
+		"Instances are outside of the frame! First instance: {}, count: {}", firstInstance, instanceCount);
+
+	const uint32_t index = (uint32_t)this->groups.size();
+	Group group = {};
+	group.sphere = glm::vec4(bounds.center, bounds.radius);
+	group.boxMin = glm::vec4(bounds.min, 0.f);
+	group.boxMax = glm::vec4(bounds.max, 0.f);
+	group.firstInstance = firstInstance;
+	group.instanceCount = instanceCount;
+	this->groups.push_back(group);
+
+	// Instances between groups are skipped by the shader.
+	const uint32_t localFirst = firstInstance - this->pushData.instanceBase;
+	if (this->instanceGroups.size() < localFirst + instanceCount)
+		this->instanceGroups.resize(localFirst + instanceCount, GPU_CULLER_NO_GROUP);
+	std::fill(this->instanceGroups.begin() + localFirst, this->instanceGroups.begin() + localFirst + instanceCount, index);
+	return index;
+}
+
+uint32_t ym::GpuCuller::addBatch()
+{
+	Batch batch;
+	batch.firstCommand = (uint32_t)this->commands.size();
+	batch.commandCount = 0;
+	this->batches.push_back(batch);
+	return (uint32_t)this->batches.size() - 1;
+}
+
+uint32_t ym::GpuCuller::addCommand(uint32_t group, uint32_t count, uint32_t first, uint32_t vertexOffset, bool indexed)
+{
+	YM_ASSERT(this->batches.empty() == false, "Commands need to be added to a batch!");
+	Batch& batch = this->batches.back();
+	YM_ASSERT(batch.commandCount == 0 || this->commands[batch.firstCommand].indexed == (indexed ? 1u : 0u), "The commands of a batch need to be either all indexed or all non-indexed!");
+
+	Command command = {};
+	command.count = count;
+	command.first = first;
+	command.vertexOffset = vertexOffset;
+	command.group = group;
+	command.indexed = indexed ? 1 : 0;
+	command.batch = (uint32_t)this->batches.size() - 1;
+	command.batchFirst = batch.firstCommand;
+	this->commands.push_back(command);
+	batch.commandCount++;
+	return (uint32_t)this->commands.size() - 1;
+}
+
+void ym::GpuCuller::end()
+{
+	// Grow the buffers if this frame does not fit. This only happens a few times, it is fine to wait for the GPU.
+	bool resized = false;
+	uint64_t groupCapacity = this->groupCapacity;
+	if (reserve(this->groupBuffer, groupCapacity, this->groups.size(), sizeof(Group)))
+	{
+		this->visibleCountBuffer.resize(sizeof(uint32_t) * groupCapacity);
+		this->groupCapacity = groupCapacity;
+		resized = true;
+	}
+	uint64_t commandCapacity = this->commandCapacity;
+	if (reserve(this->commandBuffer, commandCapacity, this->commands.size(), sizeof(Command)))
+	{
+		this->indirectBuffer.resize(GPU_CULLER_INDIRECT_STRIDE * commandCapacity);
+		this->drawCountBuffer.resize(sizeof(uint32_t) * commandCapacity);
+		this->commandCapacity = commandCapacity;
+		resized = true;
+	}
+	if (resized)
+	{
+		// The visible counts of the other frames were lost with the old buffers.
+		std::fill(this->frameGroupCounts.begin(), this->frameGroupCounts.end(), 0);
+		std::fill(this->frameCommandCounts.begin(), this->frameCommandCounts.end(), 0);
+		std::fill(this->frameBatchCounts.begin(), this->frameBatchCounts.end(), 0);
+		this->shouldUpdateDescriptors = true;
+		YM_LOG_INFO("Resized GPU culling buffers to {} groups and {} commands per frame.", this->groupCapacity, this->commandCapacity);
+	}
+
+	if (this->shouldUpdateDescriptors)
+	{
+		createDescriptorSets();
+		this->shouldUpdateDescriptors = false;
+	}
+
+	// The counters of the occlusion test are reset for each frame, even when it is off.
+	Occlusion* occlusion = static_cast<Occlusion*>(this->occlusionBuffer.getData(this->frameIndex * sizeof(Occlusion)));
+	memset(occlusion, 0, sizeof(Occlusion));
+	this->pushData.occlusionIndex = this->frameIndex;
+	if (this->depthPyramid)
+	{
+		VkImageView pyramidView = this->depthPyramid->getDescriptor().imageView;
+		if (pyramidView != this->occlusionPyramidView)
+		{
+			createOcclusionDescriptorSet();
+			this->occlusionPyramidView = pyramidView;
+		}
+		occlusion->viewProjection = this->occlusionViewProjection;
+		occlusion->pyramid = glm::vec4((float)this->depthPyramid->getWidth(), (float)this->depthPyramid->getHeight(), (float)this->depthPyramid->getLevelCount(), 0.f);
+	}
+
+	// Copy the data into the regions of this frame, group and batch indices are made global. The batches use the draw counts
+	// with the same indices as the commands, a frame never has more batches than commands.
+	const uint32_t groupBase = (uint32_t)(this->frameIndex * this->groupCapacity);
+	this->pushData.commandBase = (uint32_t)(this->frameIndex * this->commandCapacity);
+	this->pushData.instanceCount = (uint32_t)this->instanceGroups.size();
+	this->pushData.commandCount = (uint32_t)this->commands.size();
+
+	uint32_t* instanceGroups = static_cast<uint32_t*>(this->instanceGroupBuffer.getData(this->pushData.instanceBase * sizeof(uint32_t)));
+	for (size_t i = 0; i < this->instanceGroups.size(); i++)
+		instanceGroups[i] = this->instanceGroups[i] == GPU_CULLER_NO_GROUP ? GPU_CULLER_NO_GROUP : this->instanceGroups[i] + groupBase;
+
+	Command* commands = static_cast<Command*>(this->commandBuffer.getData(this->pushData.commandBase * sizeof(Command)));
+	for (size_t i = 0; i < this->commands.size(); i++)
+	{
+		commands[i] = this->commands[i];
+		commands[i].group += groupBase;
+		commands[i].batch += this->pushData.commandBase;
+		commands[i].batchFirst += this->pushData.commandBase;
+	}
+	memset(this->drawCountBuffer.getData(this->pushData.commandBase * sizeof(uint32_t)), 0, this->batches.size() * sizeof(uint32_t));
+
+	memcpy(this->groupBuffer.getData(groupBase * sizeof(Group)), this->groups.data(), this->groups.size() * sizeof(Group));
+	memset(this->visibleCountBuffer.getData(groupBase * sizeof(uint32_t)), 0, this->groups.size() * sizeof(uint32_t));
+
+	this->frameGroupCounts[this->frameIndex] = (uint32_t)this->groups.size();
+	uint32_t instanceCount = 0;
+	for (Group& group : this->groups)
+		instanceCount += group.instanceCount;
+	this->frameInstanceCounts[this->frameIndex] = instanceCount;
+	this->frameCommandCounts[this->frameIndex] = (uint32_t)this->commands.size();
+	this->frameBatchCounts[this->frameIndex] = (uint32_t)this->batches.size();
+}
+
+void ym::GpuCuller::record(CommandBuffer* cmdBuffer)
+{
+	if (this->commands.empty())
+		return;
+
+	std::vector<VkDescriptorSet> sets = { this->descriptorSet };
+	std::vector<uint32_t> offsets;
+
+	// Cull the instances and pack the visible transforms of each group.
+	Pipeline* cullPipeline = &this->cullPipeline;
+	std::vector<VkDescriptorSet> cullSets = sets;
+	if (this->depthPyramid)
+	{
+		cullPipeline = &this->occlusionCullPipeline;
+		cullSets.push_back(this->occlusionDescriptorSet);
+	}
+	cmdBuffer->cmdBindPipeline(cullPipeline);
+	cmdBuffer->cmdBindDescriptorSets(cullPipeline, 0, cullSets, offsets);
+	cmdBuffer->cmdPushConstants(cullPipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushData), &this->pushData);
+	cmdBuffer->cmdDispatch((this->pushData.instanceCount + GPU_CULLER_WORKGROUP_SIZE - 1) / GPU_CULLER_WORKGROUP_SIZE, 1, 1);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	cmdBuffer->cmdMemoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, { barrier });
+
+	// Write the indirect commands of the draws with visible instances, packed at the start of their batch.
+	cmdBuffer->cmdBindPipeline(&this->commandPipeline);
+	cmdBuffer->cmdBindDescriptorSets(&this->commandPipeline, 0, sets, offsets);
+	cmdBuffer->cmdPushConstants(&this->commandPipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushData), &this->pushData);
+	cmdBuffer->cmdDispatch((this->pushData.commandCount + GPU_CULLER_WORKGROUP_SIZE - 1) / GPU_CULLER_WORKGROUP_SIZE, 1, 1);
+
+	// The draws read the commands and the culled transforms.
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	cmdBuffer->cmdMemoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, { barrier });
+}
+
+VkBuffer ym::GpuCuller::getIndirectBuffer() const
+{
+	return this->indirectBuffer.getDescriptor().buffer;
+}
+
+VkDeviceSize ym::GpuCuller::getIndirectOffset(uint32_t batch) const
+{
+	return (VkDeviceSize)(this->pushData.commandBase + this->batches[batch].firstCommand) * GPU_CULLER_INDIRECT_STRIDE;
+}
+
+VkBuffer ym::GpuCuller::getCountBuffer() const
+{
+	return this->drawCountBuffer.getDescriptor().buffer;
+}
+
+VkDeviceSize ym::GpuCuller::getCountOffset(uint32_t batch) const
+{
+	return (VkDeviceSize)(this->pushData.commandBase + batch) * sizeof(uint32_t);
+}
+
+uint32_t ym::GpuCuller::getBatchSize(uint32_t batch) const
+{
+	return this->batches[batch].commandCount;
+}
+
+VkDescriptorSet ym::GpuCuller::getInstanceDescriptorSet() const
+{
+	return this->instanceDescriptorSet;
+}
+
+void ym::GpuCuller::createPipelines()
+{
+	this->layout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // Transforms
+	this->layout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // Group of each instance
+	this->layout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // Groups
+	this->layout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // Commands
+	this->layout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // Visible count of each group
+	this->layout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // Indirect commands
+	this->layout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // Culled transforms
+	this->layout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // Draw count of each batch
+	this->layout.init();
+
+	// Both passes share the layout and the push constants.
+	VkPushConstantRange pushConstRange = {};
+	pushConstRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstRange.size = sizeof(PushData);
+	pushConstRange.offset = 0;
+	std::vector<DescriptorLayout> descriptorLayouts = { this->layout };
+
+	this->cullShader.addStage(Shader::Type::COMPUTE, YM_ASSETS_FILE_PATH + GPU_CULLER_CULL_SHADER);
+	this->cullShader.init();
+	this->cullPipeline.setPushConstant(pushConstRange);
+	this->cullPipeline.setDescriptorLayouts(descriptorLayouts);
+	this->cullPipeline.init(Pipeline::Type::COMPUTE, &this->cullShader);
+
+	this->commandShader.addStage(Shader::Type::COMPUTE, YM_ASSETS_FILE_PATH + GPU_CULLER_COMMAND_SHADER);
+	this->commandShader.init();
+	this->commandPipeline.setPushConstant(pushConstRange);
+	this->commandPipeline.setDescriptorLayouts(descriptorLayouts);
+	this->commandPipeline.init(Pipeline::Type::COMPUTE, &this->commandShader);
+
+	if (this->occlusion == false)
+		return;
+
+	// The occlusion pass is the cull shader compiled with OCCLUSION, it reads the depth pyramid from a second set.
+	this->occlusionLayout.add(new IMG(VK_SHADER_STAGE_COMPUTE_BIT)); // Depth pyramid
+	this->occlusionLayout.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // View projection and counters of each frame
+	this->occlusionLayout.init();
+	std::vector<DescriptorLayout> occlusionDescriptorLayouts = { this->layout, this->occlusionLayout };
+
+	this->occlusionCullShader.addStage(Shader::Type::COMPUTE, YM_ASSETS_FILE_PATH + GPU_CULLER_OCCLUSION_SHADER);
+	this->occlusionCullShader.init();
+	this->occlusionCullPipeline.setPushConstant(pushConstRange);
+	this->occlusionCullPipeline.setDescriptorLayouts(occlusionDescriptorLayouts);
+	this->occlusionCullPipeline.init(Pipeline::Type::COMPUTE, &this->occlusionCullShader);
+}
+
+void ym::GpuCuller::createDescriptorSets()
+{
+	if (this->descriptorPool.wasCreated())
+		this->descriptorPool.destroy();
+
+	this->descriptorPool.addDescriptorLayout(this->layout, 1);
+	this->descriptorPool.addDescriptorLayout(this->instanceLayout, 1);
+	this->descriptorPool.init(1);
+
+	DescriptorSet set;
+	set.init(this->layout, &this->descriptorSet, &this->descriptorPool);
+	set.setBufferDesc(0, this->transforms);
+	set.setBufferDesc(1, this->instanceGroupBuffer.getDescriptor());
+	set.setBufferDesc(2, this->groupBuffer.getDescriptor());
+	set.setBufferDesc(3, this->commandBuffer.getDescriptor());
+	set.setBufferDesc(4, this->visibleCountBuffer.getDescriptor());
+	set.setBufferDesc(5, this->indirectBuffer.getDescriptor());
+	set.setBufferDesc(6, this->culledTransformBuffer.getDescriptor());
+	set.setBufferDesc(7, this->drawCountBuffer.getDescriptor());
+	set.update();
+
+	// The vertex shader reads the culled transforms with the same indices as the transform buffer.
+	DescriptorSet instanceSet;
+	instanceSet.init(this->instanceLayout, &this->instanceDescriptorSet, &this->descriptorPool);
+	instanceSet.setBufferDesc(0, this->culledTransformBuffer.getDescriptor());
+	instanceSet.update();
+}
+
+void ym::GpuCuller::createOcclusionDescriptorSet()
+{
+	// The set of an earlier frame might still be in use.
+	if (this->occlusionDescriptorPool.wasCreated())
+	{
+		vkDeviceWaitIdle(VulkanInstance::get()->getLogicalDevice());
+		this->occlusionDescriptorPool.destroy();
+	}
+
+	this->occlusionDescriptorPool.addDescriptorLayout(this->occlusionLayout, 1);
+	this->occlusionDescriptorPool.init(1);
+
+	VkDescriptorImageInfo pyramid = this->depthPyramid->getDescriptor();
+	DescriptorSet set;
+	set.init(this->occlusionLayout, &this->occlusionDescriptorSet, &this->occlusionDescriptorPool);
+	set.setImageDesc(0, pyramid.imageLayout, pyramid.imageView, pyramid.sampler);
+	set.setBufferDesc(1, this->occlusionBuffer.getDescriptor());
+	set.update();
+}
+
+bool ym::GpuCuller::reserve(RingBuffer& buffer, uint64_t& capacity, uint64_t count, uint64_t elementSize)
+{
+	if (count <= capacity)
+		return false;
+
+	while (capacity < count)
+		capacity *= 2;
+
+	vkDeviceWaitIdle(VulkanInstance::get()->getLogicalDevice());
+	buffer.resize(elementSize * capacity);
+	return true;
+}
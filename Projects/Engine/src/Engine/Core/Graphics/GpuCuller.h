@@ -0,0 +1,249 @@
+#pragma once
+
+#include "Engine/Core/Camera.h"
+#include "Engine/Core/Scene/Model/Model.h"
+#include "Engine/Core/Vulkan/CommandBuffer.h"
+#include "Engine/Core/Vulkan/Pipeline/Pipeline.h"
+#include "Engine/Core/Vulkan/Pipeline/Shader.h"
+#include "Engine/Core/Vulkan/Pipeline/DescriptorLayout.h"
+#include "Engine/Core/Vulkan/Pipeline/DescriptorPool.h"
+#include "Engine/Core/Vulkan/Buffers/RingBuffer.h"
+#include "Engine/Core/Graphics/DepthPyramid.h"
+
+#define GPU_CULLER_WORKGROUP_SIZE 64 // Needs to match local_size_x in modelCullComp.glsl and modelDrawCommandsComp.glsl.
+#define GPU_CULLER_GROUP_START_COUNT 256 // Number of groups each frame can hold before the buffers need to grow.
+#define GPU_CULLER_COMMAND_START_COUNT 1024 // Number of commands each frame can hold before the buffers need to grow.
+#define GPU_CULLER_NO_GROUP 0xFFFFFFFF // Group of instances which are not part of any group.
+#define GPU_CULLER_INDIRECT_STRIDE (5 * sizeof(uint32_t)) // Size of a VkDrawIndexedIndirectCommand, non-indexed commands are padded to it.
+#define GPU_CULLER_CULL_SHADER "Shaders/modelCullComp.spv"
+#define GPU_CULLER_OCCLUSION_SHADER "Shaders/modelCullOcclusionComp.spv"
+#define GPU_CULLER_COMMAND_SHADER "Shaders/modelDrawCommandsComp.spv"
+
+namespace ym
+{
+	/*
+		Culls instances against the camera frustum on the GPU and writes the indirect draw commands which draw the visible instances.
+		Instances are added in groups which share bounds, a group is usually all instances of one model. The visible transforms of a
+		group are packed at the start of its range in the culled transform buffer, so a draw uses the same firstInstance as before.
+		All buffers are host visible and split into one region per frame, the caller needs to make sure the GPU is done with a region
+		before it begins the same frame again.
+
+		Commands are added in batches which are drawn with one indirect count draw. The commands of a batch which have visible
+		instances are packed at the start of the batch and the GPU writes how many there are, commands without visible instances
+		are never drawn.
+
+		With a depth pyramid the instances inside the frustum are also tested against the depth of an earlier frame, the bounding box
+		of the model is projected with the view projection of that frame. An instance which was hidden in that frame is culled until
+		a later frame shows it, a box which is not fully on the screen of that frame is never culled.
+	*/
+	class GpuCuller
+	{
+	public:
+		GpuCuller();
+		~GpuCuller();
+
+		/*
+			True if the device has the indirect draw features and the compute shaders have been compiled, with occlusion also the
+			shaders of the occlusion culling and the depth pyramid. Otherwise reason is set to what is missing, if it is not null.
+		*/
+		static bool isSupported(bool occlusion, std::string* reason = nullptr);
+
+		/*
+			The instance layout is the layout of the descriptor set which holds the culled transforms for the vertex shader. The
+			occlusion pipeline is only created if occlusion is true, setOcclusion can not be used otherwise.
+		*/
+		void init(uint32_t frameCount, const DescriptorLayout& instanceLayout, bool occlusion = false);
+		void destroy();
+
+		/*
+			Set the buffer which holds the transforms of all instances. Needs to be called again when the buffer is recreated.
+		*/
+		void setTransforms(VkDescriptorBufferInfo transforms);
+
+		/*
+			Cull the instances which are behind the depth in the pyramid, which was rendered with viewProjection. The pyramid needs to
+			be built before the culling is executed. Applies to the frame which is ended next, a null pyramid turns it off.
+		*/
+		void setOcclusion(const DepthPyramid* depthPyramid, const glm::mat4& viewProjection);
+
+		/*
+			Remove all groups and commands of the frame. instanceCapacity is the number of transforms each frame of the transform buffer holds.
+		*/
+		void begin(uint32_t frameIndex, const std::vector<Camera::Plane>& planes, uint32_t instanceCapacity);
+
+		/*
+			Add instanceCount instances, starting at firstInstance in the transform buffer, which share the same bounds. Returns the group index.
+		*/
+		uint32_t addGroup(const Bounds& bounds, uint32_t firstInstance, uint32_t instanceCount);
+
+		/*
+			Start a batch, the commands which are added until the next batch belong to it. The commands of a batch are drawn with the
+			same pipeline, descriptor sets and buffers and are either all indexed or all non-indexed. Returns the batch index.
+		*/
+		uint32_t addBatch();
+
+		/*
+			Add a draw of all visible instances of a group to the last batch. count and first are the index count and first index if
+			indexed is true, otherwise the vertex count and first vertex. vertexOffset is only used by indexed draws. Returns the
+			command index.
+		*/
+		uint32_t addCommand(uint32_t group, uint32_t count, uint32_t first, uint32_t vertexOffset, bool indexed);
+
+		/*
+			Upload the groups and commands. The buffers grow if the frame does not fit, which waits for the GPU.
+		*/
+		void end();
+
+		/*
+			Record the culling. Needs to be recorded outside of a render pass and before the draws which use the results.
+		*/
+		void record(CommandBuffer* cmdBuffer);
+
+		/*
+			Arguments of the indirect count draw of a batch. The commands start at the indirect offset and the number of commands to
+			draw is at the count offset in the count buffer, it is at most the number of commands in the batch.
+		*/
+		VkBuffer getIndirectBuffer() const;
+		VkDeviceSize getIndirectOffset(uint32_t batch) const;
+		VkBuffer getCountBuffer() const;
+		VkDeviceSize getCountOffset(uint32_t batch) const;
+		uint32_t getBatchSize(uint32_t batch) const;
+		VkDescriptorSet getInstanceDescriptorSet() const;
+
+		/*
+			Number of instances and visible instances of the last frame which used the current frame index, the GPU is done with it.
+		*/
+		uint32_t getLastInstanceCount() const { return this->lastInstanceCount; }
+		uint32_t getLastVisibleCount() const { return this->lastVisibleCount; }
+
+		/*
+			Instances of the same frame which were inside the frustum and tested against the depth pyramid, and the ones it culled.
+		*/
+		uint32_t getLastTestedCount() const { return this->lastTestedCount; }
+		uint32_t getLastOccludedCount() const { return this->lastOccludedCount; }
+
+		/*
+			Indirect commands of the same frame and the ones which drew at least one instance, which is the sum of the draw counts.
+		*/
+		uint32_t getLastCommandCount() const { return this->lastCommandCount; }
+		uint32_t getLastDrawCount() const { return this->lastDrawCount; }
+
+	private:
+		// Layouts match the std430 structs of the compute shaders.
+		struct Group
+		{
+			glm::vec4 sphere;
+			glm::vec4 boxMin;
+			glm::vec4 boxMax;
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+			uint32_t pad[2];
+		};
+
+		struct Command
+		{
+			uint32_t count;
+			uint32_t first;
+			uint32_t vertexOffset;
+			uint32_t group;
+			uint32_t indexed;
+			uint32_t batch;
+			uint32_t batchFirst; // First command of the batch, the visible commands are written from there.
+			uint32_t pad;
+		};
+
+		struct Batch
+		{
+			uint32_t firstCommand;
+			uint32_t commandCount;
+		};
+
+		struct PushData
+		{
+			glm::vec4 planes[6];
+			uint32_t instanceBase;
+			uint32_t instanceCount;
+			uint32_t commandBase;
+			uint32_t commandCount;
+			uint32_t occlusionIndex; // Occlusion record of the frame.
+		};
+
+		// One for each frame, the counters are reset when the frame is uploaded.
+		struct Occlusion
+		{
+			glm::mat4 viewProjection;
+			glm::vec4 pyramid; // Width and height of the depth buffer and the number of levels.
+			uint32_t testedCount;
+			uint32_t occludedCount;
+			uint32_t pad[2];
+		};
+
+		void createPipelines();
+		void createDescriptorSets();
+		void createOcclusionDescriptorSet();
+		bool reserve(RingBuffer& buffer, uint64_t& capacity, uint64_t count, uint64_t elementSize);
+
+	private:
+		uint32_t frameCount;
+		uint32_t frameIndex;
+
+		// Data of the current frame, group and batch indices in the commands are local until they are uploaded.
+		std::vector<Group> groups;
+		std::vector<Command> commands;
+		std::vector<Batch> batches;
+		std::vector<uint32_t> instanceGroups;
+		PushData pushData;
+
+		// Capacities of each frame region, in number of elements.
+		uint64_t instanceCapacity;
+		uint64_t groupCapacity;
+		uint64_t commandCapacity;
+
+		VkDescriptorBufferInfo transforms;
+		RingBuffer instanceGroupBuffer;
+		RingBuffer groupBuffer;
+		RingBuffer commandBuffer;
+		RingBuffer visibleCountBuffer;
+		RingBuffer indirectBuffer;
+		RingBuffer drawCountBuffer; // Draw count of each batch, a frame has room for one batch for each command.
+		RingBuffer culledTransformBuffer;
+
+		// Statistics, the visible counts of a frame are read back the next time the frame begins.
+		std::vector<uint32_t> frameGroupCounts;
+		std::vector<uint32_t> frameInstanceCounts;
+		std::vector<uint32_t> frameCommandCounts;
+		std::vector<uint32_t> frameBatchCounts;
+		uint32_t lastInstanceCount;
+		uint32_t lastVisibleCount;
+		uint32_t lastTestedCount;
+		uint32_t lastOccludedCount;
+		uint32_t lastCommandCount;
+		uint32_t lastDrawCount;
+
+		// Occlusion culling, the pyramid is owned by the caller.
+		bool occlusion;
+		const DepthPyramid* depthPyramid;
+		glm::mat4 occlusionViewProjection;
+		VkImageView occlusionPyramidView; // View the descriptor set was written with.
+		RingBuffer occlusionBuffer;
+
+		// Descriptors
+		bool shouldUpdateDescriptors;
+		DescriptorLayout layout;
+		DescriptorLayout instanceLayout;
+		DescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+		VkDescriptorSet instanceDescriptorSet;
+
+		DescriptorLayout occlusionLayout;
+		DescriptorPool occlusionDescriptorPool;
+		VkDescriptorSet occlusionDescriptorSet;
+
+		Shader cullShader;
+		Shader occlusionCullShader;
+		Shader commandShader;
+		Pipeline cullPipeline;
+		Pipeline occlusionCullPipeline;	// Same as the cull pipeline with the occlusion descriptor set.
+		Pipeline commandPipeline;
+	};
+}
@@ -0,0 +1,252 @@
+#include "stdafx.h"
+#include "IBLCache.h"
+
+#include "Engine/Core/Vulkan/Factory.h"
+#include "Utils/MappedFile.h"
+#include "Utils/FileUtils.h"
+
+#define IBL_CACHE_ALIGNMENT 16 // Alignment of each section in the file.
+
+namespace ym
+{
+	std::atomic<bool> IBLCache::enabled{ true };
+
+	bool IBLCache::load(const std::string& hdrPath, const Params& params, Textures& textures)
+	{
+		MappedFile file;
+		if (file.open(getCachePath(hdrPath)) == false)
+			return false;
+
+		const uint8_t* data = file.getData();
+		const uint64_t size = file.getSize();
+		const Header* header = reinterpret_cast<const Header*>(data);
+		if (size < sizeof(Header) || memcmp(header->magic, "YMI", 4) != 0 || header->version != IBL_CACHE_VERSION ||
+			memcmp(&header->params, &params, sizeof(Params)) != 0 || header->textureCount != IBL_CACHE_TEXTURE_COUNT)
+		{
+			YM_LOG_INFO("IBL cache is out of date. [{}]", hdrPath.c_str());
+			return false;
+		}
+
+		// A truncated file is treated as out of date.
+		auto fits = [](uint64_t offset, uint64_t sectionSize, uint64_t size) { return offset <= size && sectionSize <= size - offset; };
+		if (fits(header->textureOffset, (uint64_t)header->textureCount * sizeof(CachedTexture), size) == false ||
+			fits(header->imageOffset, header->imageSize, size) == false)
+		{
+			YM_LOG_INFO("IBL cache is out of date. [{}]", hdrPath.c_str());
+			return false;
+		}
+		const CachedTexture* cachedTextures = reinterpret_cast<const CachedTexture*>(data + header->textureOffset);
+		for (uint32_t i = 0; i < header->textureCount; i++)
+		{
+			const CachedTexture& cachedTexture = cachedTextures[i];
+			if ((cachedTexture.layers != 0 && cachedTexture.layers != 1 && cachedTexture.layers != 6) || cachedTexture.size != getTextureSize(cachedTexture) ||
+				fits(cachedTexture.offset, cachedTexture.size, header->imageSize) == false)
+			{
+				YM_LOG_INFO("IBL cache is out of date. [{}]", hdrPath.c_str());
+				return false;
+			}
+		}
+
+		if (header->sourceHash != FileUtils::hashFile(hdrPath))
+		{
+			YM_LOG_INFO("IBL cache is out of date. [{}]", hdrPath.c_str());
+			return false;
+		}
+
+		// All faces and mip levels are copied to the staging buffer at once and uploaded in one submission.
+		Buffer stagingBuffer;
+		Memory stagingMemory;
+		stagingBuffer.init(header->imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { VulkanInstance::get()->getGraphicsQueue().queueIndex });
+		stagingMemory.bindBuffer(&stagingBuffer);
+		stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryAllocator::Lifetime::TRANSIENT);
+		stagingMemory.directTransfer(&stagingBuffer, data + header->imageOffset, header->imageSize, (Offset)0);
+
+		Texture* loadedTextures[IBL_CACHE_TEXTURE_COUNT];
+		CommandPool* commandPool = &LayerManager::get()->getCommandPools()->graphicsPool;
+		CommandBuffer* commandBuffer = commandPool->beginSingleTimeCommand();
+		for (uint32_t i = 0; i < header->textureCount; i++)
+		{
+			const CachedTexture& cachedTexture = cachedTextures[i];
+			loadedTextures[i] = nullptr;
+			if (cachedTexture.layers == 0)
+				continue;
+
+			TextureDesc textureDesc;
+			textureDesc.width = cachedTexture.width;
+			textureDesc.height = cachedTexture.height;
+			textureDesc.format = (VkFormat)cachedTexture.format;
+			textureDesc.data = nullptr;
+
+			// Same usage as when the textures are generated, this allows them to be baked again.
+			VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			Texture* texture = nullptr;
+			if (cachedTexture.layers == 6)
+				texture = Factory::createCubeMapTexture(textureDesc, usage, VK_QUEUE_GRAPHICS_BIT, VK_IMAGE_ASPECT_COLOR_BIT, cachedTexture.mipLevels);
+			else
+				texture = Factory::createTexture(textureDesc, usage, VK_QUEUE_GRAPHICS_BIT, VK_IMAGE_ASPECT_COLOR_BIT, cachedTexture.mipLevels);
+
+			std::vector<VkBufferImageCopy> regions = getCopyRegions(cachedTexture, cachedTexture.offset);
+			texture->image.setLayout(commandBuffer, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+			commandBuffer->cmdCopyBufferToImage(stagingBuffer.getBuffer(), texture->image.getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+			texture->image.setLayout(commandBuffer, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			loadedTextures[i] = texture;
+		}
+		commandPool->endSingleTimeCommand(commandBuffer);
+
+		stagingBuffer.destroy();
+		stagingMemory.destroy();
+
+		textures.environment = loadedTextures[0];
+		textures.irradiance = loadedTextures[1];
+		textures.prefiltered = loadedTextures[2];
+		textures.brdfLut = loadedTextures[3];
+		return true;
+	}
+
+	bool IBLCache::bake(const std::string& hdrPath, const Params& params, const Textures& textures)
+	{
+		Texture* bakedTextures[IBL_CACHE_TEXTURE_COUNT] = { textures.environment, textures.irradiance, textures.prefiltered, textures.brdfLut };
+		std::vector<CachedTexture> cachedTextures;
+		uint64_t imageSize = 0;
+		for (Texture* texture : bakedTextures)
+		{
+			cachedTextures.push_back(getCachedTexture(texture, imageSize));
+			imageSize += cachedTextures.back().size;
+		}
+
+		// Read back all faces and mip levels in one submission.
+		Buffer stagingBuffer;
+		Memory stagingMemory;
+		stagingBuffer.init(imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, { VulkanInstance::get()->getGraphicsQueue().queueIndex });
+		stagingMemory.bindBuffer(&stagingBuffer);
+		stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryAllocator::Lifetime::TRANSIENT);
+
+		CommandPool* commandPool = &LayerManager::get()->getCommandPools()->graphicsPool;
+		CommandBuffer* commandBuffer = commandPool->beginSingleTimeCommand();
+		for (uint32_t i = 0; i < IBL_CACHE_TEXTURE_COUNT; i++)
+		{
+			Texture* texture = bakedTextures[i];
+			if (texture == nullptr)
+				continue;
+
+			std::vector<VkBufferImageCopy> regions = getCopyRegions(cachedTextures[i], cachedTextures[i].offset);
+			texture->image.setLayout(commandBuffer, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+			commandBuffer->cmdCopyImageToBuffer(texture->image.getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingBuffer.getBuffer(), (uint32_t)regions.size(), regions.data());
+			texture->image.setLayout(commandBuffer, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		}
+		commandPool->endSingleTimeCommand(commandBuffer);
+
+		Header header;
+		memset(&header, 0, sizeof(Header));
+		memcpy(header.magic, "YMI", 4);
+		header.version = IBL_CACHE_VERSION;
+		header.sourceHash = FileUtils::hashFile(hdrPath);
+		header.params = params;
+		header.textureCount = IBL_CACHE_TEXTURE_COUNT;
+
+		uint64_t offset = sizeof(Header);
+		auto place = [&offset](uint64_t size)->uint64_t {
+			offset = (offset + IBL_CACHE_ALIGNMENT - 1) & ~(uint64_t)(IBL_CACHE_ALIGNMENT - 1);
+			uint64_t sectionOffset = offset;
+			offset += size;
+			return sectionOffset;
+		};
+		header.textureOffset = place(cachedTextures.size() * sizeof(CachedTexture));
+		header.imageOffset = place(imageSize);
+		header.imageSize = imageSize;
+
+		// Written through a temporary file, so that a failed write never leaves a half written cache.
+		std::string cachePath = getCachePath(hdrPath);
+		bool written = FileUtils::writeAtomic(cachePath, [&](std::ofstream& file) {
+			uint64_t fileOffset = 0;
+			auto write = [&file, &fileOffset](uint64_t sectionOffset, const void* data, uint64_t size) {
+				static const char zeros[IBL_CACHE_ALIGNMENT] = {};
+				file.write(zeros, (std::streamsize)(sectionOffset - fileOffset));
+				file.write(static_cast<const char*>(data), (std::streamsize)size);
+				fileOffset = sectionOffset + size;
+			};
+			write(0, &header, sizeof(Header));
+			write(header.textureOffset, cachedTextures.data(), cachedTextures.size() * sizeof(CachedTexture));
+			write(header.imageOffset, stagingMemory.getMappedData(&stagingBuffer), imageSize);
+		});
+
+		stagingBuffer.destroy();
+		stagingMemory.destroy();
+
+		if (written == false)
+		{
+			YM_LOG_WARN("Could not write IBL cache. [{}]", cachePath.c_str());
+			return false;
+		}
+		YM_LOG_INFO("Baked IBL cache. [{}]", cachePath.c_str());
+		return true;
+	}
+
+	std::string IBLCache::getCachePath(const std::string& hdrPath)
+	{
+		return hdrPath + IBL_CACHE_EXTENSION;
+	}
+
+	void IBLCache::setEnabled(bool enabled)
+	{
+		IBLCache::enabled = enabled;
+	}
+
+	bool IBLCache::isEnabled()
+	{
+		return enabled;
+	}
+
+	IBLCache::CachedTexture IBLCache::getCachedTexture(const Texture* texture, uint64_t offset)
+	{
+		CachedTexture cachedTexture;
+		memset(&cachedTexture, 0, sizeof(CachedTexture));
+		if (texture == nullptr)
+			return cachedTexture;
+
+		cachedTexture.width = texture->textureDesc.width;
+		cachedTexture.height = texture->textureDesc.height;
+		cachedTexture.format = (uint32_t)texture->textureDesc.format;
+		cachedTexture.mipLevels = texture->image.getMipLevels();
+		cachedTexture.layers = texture->image.getArrayLayers();
+		cachedTexture.offset = offset;
+		cachedTexture.size = getTextureSize(cachedTexture);
+		return cachedTexture;
+	}
+
+	uint64_t IBLCache::getTextureSize(const CachedTexture& cachedTexture)
+	{
+		if (cachedTexture.layers == 0)
+			return 0;
+
+		const uint64_t texelSize = (uint64_t)getSizeFromFormat((VkFormat)cachedTexture.format);
+		uint64_t size = 0;
+		for (uint32_t level = 0; level < cachedTexture.mipLevels; level++)
+			size += (uint64_t)std::max(cachedTexture.width >> level, 1u) * (uint64_t)std::max(cachedTexture.height >> level, 1u) * texelSize;
+		return size * cachedTexture.layers;
+	}
+
+	std::vector<VkBufferImageCopy> IBLCache::getCopyRegions(const CachedTexture& cachedTexture, uint64_t bufferOffset)
+	{
+		const uint64_t texelSize = (uint64_t)getSizeFromFormat((VkFormat)cachedTexture.format);
+		std::vector<VkBufferImageCopy> regions;
+		for (uint32_t layer = 0; layer < cachedTexture.layers; layer++)
+		{
+			for (uint32_t level = 0; level < cachedTexture.mipLevels; level++)
+			{
+				VkBufferImageCopy region = {};
+				region.bufferOffset = bufferOffset;
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.mipLevel = level;
+				region.imageSubresource.baseArrayLayer = layer;
+				region.imageSubresource.layerCount = 1;
+				region.imageExtent.width = std::max(cachedTexture.width >> level, 1u);
+				region.imageExtent.height = std::max(cachedTexture.height >> level, 1u);
+				region.imageExtent.depth = 1;
+				regions.push_back(region);
+				bufferOffset += (uint64_t)region.imageExtent.width * (uint64_t)region.imageExtent.height * texelSize;
+			}
+		}
+		return regions;
+	}
+}
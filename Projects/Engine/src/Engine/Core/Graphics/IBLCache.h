@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Engine/Core/Vulkan/Texture.h"
+#include <atomic>
+
+#define IBL_CACHE_VERSION 1				// Increase when the IBL shaders change, the cached textures are out of date then.
+#define IBL_CACHE_EXTENSION ".ymibl"	// The cache file is placed next to the HDR file, with this extension added.
+#define IBL_CACHE_TEXTURE_COUNT 4
+
+namespace ym
+{
+	/*
+		Pre-computed IBL textures of an HDR environment. The environment cube, irradiance cube, prefiltered cube and BRDF LUT are read
+		back from the GPU after they have been generated and are stored with all of their faces and mip levels. When the cache is loaded
+		the textures are uploaded directly, without the equirectangular conversion and the convolution passes.
+
+		The cache is only used if the hash of the HDR file and the generation parameters are the same as when it was written.
+	*/
+	class IBLCache
+	{
+	public:
+		// Parameters which the textures were generated with.
+		struct Params
+		{
+			uint32_t environmentSize;
+			uint32_t environmentMipLevels;
+			uint32_t irradianceSize;
+			uint32_t irradianceMipLevels;
+			uint32_t prefilteredSize;
+			uint32_t prefilteredMipLevels;
+			uint32_t brdfLutSize;
+			uint32_t _padding;
+		};
+
+		// A texture which is nullptr is stored as an empty entry and is loaded as nullptr.
+		struct Textures
+		{
+			Texture* environment{ nullptr };
+			Texture* irradiance{ nullptr };
+			Texture* prefiltered{ nullptr };
+			Texture* brdfLut{ nullptr };
+		};
+
+	public:
+		/*
+			Create the textures from the cache file of the HDR. Returns false if there is no cache file or if it is out of date, no
+			textures are created in that case. The textures are in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+		*/
+		static bool load(const std::string& hdrPath, const Params& params, Textures& textures);
+
+		/*
+			Write the cache file for textures which have just been generated. The textures need VK_IMAGE_USAGE_TRANSFER_SRC_BIT and
+			need to be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, which they are in again after this function.
+		*/
+		static bool bake(const std::string& hdrPath, const Params& params, const Textures& textures);
+
+		static std::string getCachePath(const std::string& hdrPath);
+
+		/*
+			When disabled, the IBL textures are always generated and no cache files are written.
+		*/
+		static void setEnabled(bool enabled);
+		static bool isEnabled();
+
+	private:
+		struct Header
+		{
+			char magic[4];
+			uint32_t version;
+			uint64_t sourceHash;
+			Params params;
+			uint32_t textureCount;
+			uint32_t _padding;
+			uint64_t textureOffset;
+			uint64_t imageOffset;
+			uint64_t imageSize;
+		};
+
+		// The faces of a texture are stored after each other, each face with all of its mip levels starting with the largest.
+		// The offset is relative to the image data.
+		struct CachedTexture
+		{
+			uint32_t width;
+			uint32_t height;
+			uint32_t format;
+			uint32_t mipLevels;
+			uint32_t layers;
+			uint32_t _padding;
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		static CachedTexture getCachedTexture(const Texture* texture, uint64_t offset);
+		// Size of all faces and mip levels.
+		static uint64_t getTextureSize(const CachedTexture& cachedTexture);
+		// One region for each face and mip level, in the order they are stored in.
+		static std::vector<VkBufferImageCopy> getCopyRegions(const CachedTexture& cachedTexture, uint64_t bufferOffset);
+
+		static std::atomic<bool> enabled;
+	};
+}
@@ -14,6 +14,28 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtx/rotate_vector.hpp>
+#include <glTF/stb_image.h>
+
+bool ym::IBLFunctions::batched = true;
+
+ym::Texture* ym::IBLFunctions::loadEquirectangularTexture(const std::string& hdrPath)
+{
+	int widthHDR = 0, heightHDR = 0, nrComponentsHDR = 0;
+	float* dataHDR = stbi_loadf(hdrPath.c_str(), &widthHDR, &heightHDR, &nrComponentsHDR, 4);
+	if (dataHDR == nullptr)
+		return nullptr;
+
+	TextureDesc textureDesc;
+	textureDesc.width = (uint32_t)widthHDR;
+	textureDesc.height = (uint32_t)heightHDR;
+	textureDesc.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	textureDesc.data = (void*)dataHDR;
+	Texture* texture = Factory::createTexture(textureDesc, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_QUEUE_GRAPHICS_BIT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	Factory::transferData(texture, &LayerManager::get()->getCommandPools()->graphicsPool);
+	stbi_image_free(dataHDR);
+	texture->textureDesc.data = nullptr;
+	return texture;
+}
 
 ym::Texture* ym::IBLFunctions::convertEquirectangularToCubemap(uint32_t sideSize, Texture* texture, uint32_t desiredMipLevels)
 {
@@ -29,7 +51,7 @@ ym::Texture* ym::IBLFunctions::convertEquirectangularToCubemap(uint32_t sideSize
 	textureDesc.height = extent.height;
 	textureDesc.format = texture->textureDesc.format;
 	textureDesc.data = nullptr;
-	uint32_t mipLevels = desiredMipLevels == 0 ? static_cast<uint32_t>(std::floor(std::log2(std::max(textureDesc.width, textureDesc.height)))) + 1 : desiredMipLevels;
+	uint32_t mipLevels = desiredMipLevels == 0 ? getMipLevels(std::max(textureDesc.width, textureDesc.height)) : desiredMipLevels;
 	Texture* newTexture = Factory::createCubeMapTexture(textureDesc, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_QUEUE_GRAPHICS_BIT, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
 
 	textureDesc = {};
@@ -39,15 +61,6 @@ ym::Texture* ym::IBLFunctions::convertEquirectangularToCubemap(uint32_t sideSize
 	textureDesc.data = nullptr;
 	Texture* image = Factory::createTexture(textureDesc, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_QUEUE_GRAPHICS_BIT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 
-	CommandPool* commandPool = &LayerManager::get()->getCommandPools()->graphicsPool;
-	CommandBuffer* commandBuffer = commandPool->beginSingleTimeCommand();
-	image->image.setLayout(
-		commandBuffer,
-		VK_IMAGE_ASPECT_COLOR_BIT,
-		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-	commandPool->endSingleTimeCommand(commandBuffer);
-
 	Pipeline pipeline;
 	Shader shader;
 	shader.addStage(Shader::Type::VERTEX, YM_ASSETS_FILE_PATH + "Shaders/cubeVert.spv");
@@ -190,94 +203,101 @@ ym::Texture* ym::IBLFunctions::convertEquirectangularToCubemap(uint32_t sideSize
 		glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
 	};
 
-	commandBuffer = commandPool->beginSingleTimeCommand();
+	CommandPool* commandPool = &LayerManager::get()->getCommandPools()->graphicsPool;
+	CommandBuffer* commandBuffer = commandPool->beginSingleTimeCommand();
+	image->image.setLayout(
+		commandBuffer,
+		VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-	for (uint32_t i = 0; i < mipLevels; i++) {
-		VkImageSubresourceRange subresourceRange = {};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.baseMipLevel = i;
-		subresourceRange.levelCount = 1;
-		subresourceRange.layerCount = 6;
-		newTexture->image.setLayout(
+	// Only the first mip level is rendered, the others are generated from it in the same command buffer.
+	VkImageSubresourceRange subresourceRange = {};
+	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	subresourceRange.baseMipLevel = 0;
+	subresourceRange.levelCount = mipLevels;
+	subresourceRange.layerCount = 6;
+	newTexture->image.setLayout(
+		commandBuffer,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		subresourceRange);
+
+	for (uint32_t f = 0; f < 6; f++) {
+		commandBuffer->cmdBeginRenderPass(&renderPass, frameBuffer, extent, clearValues, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkBuffer buffer = cubeModel.getVertexBuffer()->getBuffer();
+
+		// Update shader push constant block
+		glm::mat4 mvp = glm::perspective((float)(3.1415f / 2.0), 1.0f, 0.1f, (float)sideSize) * matrices[f];
+		vkCmdPushConstants(commandBuffer->getCommandBuffer(), pipeline.getPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &mvp);
+
+		commandBuffer->cmdBindPipeline(&pipeline);
+		VkDeviceSize offset = 0;
+		commandBuffer->cmdBindVertexBuffers(0, 1, &buffer, &offset);
+
+		std::vector<VkDescriptorSet> sets = { descriptorSet };
+		std::vector<uint32_t> offsets;
+		commandBuffer->cmdBindDescriptorSets(&pipeline, 0, sets, offsets);
+		commandBuffer->cmdDraw(36, 1, 0, 0);
+
+		commandBuffer->cmdEndRenderPass();
+
+		image->image.setLayout(
 			commandBuffer,
-			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+		// Copy region for transfer from framebuffer to cube face
+		VkImageCopy copyRegion = {};
+		copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyRegion.srcSubresource.baseArrayLayer = 0;
+		copyRegion.srcSubresource.mipLevel = 0;
+		copyRegion.srcSubresource.layerCount = 1;
+		copyRegion.srcOffset = { 0, 0, 0 };
+		copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyRegion.dstSubresource.baseArrayLayer = f;
+		copyRegion.dstSubresource.mipLevel = 0;
+		copyRegion.dstSubresource.layerCount = 1;
+		copyRegion.dstOffset = { 0, 0, 0 };
+		copyRegion.extent.width = extent.width;
+		copyRegion.extent.height = extent.height;
+		copyRegion.extent.depth = 1;
+
+		vkCmdCopyImage(
+			commandBuffer->getCommandBuffer(),
+			image->image.getImage(),
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			newTexture->image.getImage(),
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			subresourceRange);
+			1,
+			&copyRegion);
 
-		for (uint32_t f = 0; f < 6; f++) {
-			commandBuffer->cmdBeginRenderPass(&renderPass, frameBuffer, extent, clearValues, VK_SUBPASS_CONTENTS_INLINE);
-
-			VkBuffer buffer = cubeModel.getVertexBuffer()->getBuffer();
-
-			// Update shader push constant block
-			glm::mat4 mvp = glm::perspective((float)(3.1415f / 2.0), 1.0f, 0.1f, (float)sideSize) * matrices[f];
-			vkCmdPushConstants(commandBuffer->getCommandBuffer(), pipeline.getPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &mvp);
-
-			commandBuffer->cmdBindPipeline(&pipeline);
-			VkDeviceSize offset = 0;
-			commandBuffer->cmdBindVertexBuffers(0, 1, &buffer, &offset);
-
-			std::vector<VkDescriptorSet> sets = { descriptorSet };
-			std::vector<uint32_t> offsets;
-			commandBuffer->cmdBindDescriptorSets(&pipeline, 0, sets, offsets);
-			commandBuffer->cmdDraw(36, 1, 0, 0);
-
-			commandBuffer->cmdEndRenderPass();
-
-			image->image.setLayout(
-				commandBuffer,
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-
-			// Copy region for transfer from framebuffer to cube face
-			VkImageCopy copyRegion = {};
-			copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			copyRegion.srcSubresource.baseArrayLayer = 0;
-			copyRegion.srcSubresource.mipLevel = 0;
-			copyRegion.srcSubresource.layerCount = 1;
-			copyRegion.srcOffset = { 0, 0, 0 };
-			copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			copyRegion.dstSubresource.baseArrayLayer = f;
-			copyRegion.dstSubresource.mipLevel = 0;
-			copyRegion.dstSubresource.layerCount = 1;
-			copyRegion.dstOffset = { 0, 0, 0 };
-			copyRegion.extent.width = extent.width;
-			copyRegion.extent.height = extent.height;
-			copyRegion.extent.depth = 1;
-
-			vkCmdCopyImage(
-				commandBuffer->getCommandBuffer(),
-				image->image.getImage(),
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				newTexture->image.getImage(),
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1,
-				&copyRegion);
-
-			// Transform framebuffer color attachment back (Used if more mipmaps else not necessary!)
-			image->image.setLayout(
-				commandBuffer,
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-		}
+		// Transform framebuffer color attachment back for the next face
+		image->image.setLayout(
+			commandBuffer,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-		if (mipLevels == 1)
-		{
-			newTexture->image.setLayout(
-				commandBuffer,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				subresourceRange);
-		}
+		submitPass(commandPool, commandBuffer);
 	}
 
-	commandPool->endSingleTimeCommand(commandBuffer);
+	if (mipLevels == 1)
+	{
+		newTexture->image.setLayout(
+			commandBuffer,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			subresourceRange);
+	}
+	else
+	{
+		Factory::generateMipmaps(newTexture, commandBuffer);
+	}
 
-	//texture->image.setLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	if (mipLevels > 1)
-		Factory::generateMipmaps(newTexture);
+	commandPool->endSingleTimeCommand(commandBuffer);
 
 	sampler.destroy();
 	vkDestroyFramebuffer(VulkanInstance::get()->getLogicalDevice(), frameBuffer, nullptr);
@@ -295,15 +315,29 @@ ym::Texture* ym::IBLFunctions::convertEquirectangularToCubemap(uint32_t sideSize
 	return newTexture;
 }
 
-std::pair<ym::Texture*, ym::Texture*> ym::IBLFunctions::createIrradianceAndPrefilteredMap(Texture* environmentCubeTexture)
+std::pair<ym::Texture*, ym::Texture*> ym::IBLFunctions::createIrradianceAndPrefilteredMap(Texture* environmentCubeTexture, bool createIrradiance)
 {
 	ym::Texture* irradianceTexture = nullptr;
 	ym::Texture* prefilteredEnvTexture = nullptr;
 
 	CubeMap cubeModel;
 	cubeModel.init(1.f);
-	enum Target { IRRADIANCE = 0, PREFILTEREDENV = 1 };
-	for (uint32_t target = 0; target < PREFILTEREDENV + 1; target++) {
+	enum Target { IRRADIANCE = 0, PREFILTEREDENV = 1, COUNT = 2 };
+
+	// Both targets are recorded into one command buffer, their resources are kept until it has finished.
+	const uint32_t firstTarget = createIrradiance ? IRRADIANCE : PREFILTEREDENV;
+	Pipeline pipelines[COUNT];
+	Shader shaders[COUNT];
+	DescriptorPool descPools[COUNT];
+	DescriptorLayout descLayouts[COUNT];
+	Sampler samplers[COUNT];
+	RenderPass renderPasses[COUNT];
+	VkFramebuffer frameBuffers[COUNT];
+	Texture* images[COUNT];
+
+	CommandPool* commandPool = &LayerManager::get()->getCommandPools()->graphicsPool;
+	CommandBuffer* commandBuffer = commandPool->beginSingleTimeCommand();
+	for (uint32_t target = firstTarget; target < COUNT; target++) {
 
 		uint32_t sideSize = 0;
 		VkFormat format;
@@ -311,11 +345,11 @@ std::pair<ym::Texture*, ym::Texture*> ym::IBLFunctions::createIrradianceAndPrefi
 		{
 		case IRRADIANCE:
 			format = VK_FORMAT_R32G32B32A32_SFLOAT;
-			sideSize = 64;
+			sideSize = IBL_IRRADIANCE_SIZE;
 			break;
 		case PREFILTEREDENV:
 			format = VK_FORMAT_R16G16B16A16_SFLOAT;
-			sideSize = 512;
+			sideSize = IBL_PREFILTERED_SIZE;
 			break;
 		}
 
@@ -328,7 +362,7 @@ std::pair<ym::Texture*, ym::Texture*> ym::IBLFunctions::createIrradianceAndPrefi
 		textureDesc.height = extent.height;
 		textureDesc.format = format;
 		textureDesc.data = nullptr;
-		uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(sideSize))) + 1;
+		uint32_t mipLevels = getMipLevels(sideSize);
 		Texture* newTexture = Factory::createCubeMapTexture(textureDesc, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_QUEUE_GRAPHICS_BIT, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
 		switch (target) {
 		case IRRADIANCE:
@@ -345,18 +379,15 @@ std::pair<ym::Texture*, ym::Texture*> ym::IBLFunctions::createIrradianceAndPrefi
 		textureDesc.format = format;
 		textureDesc.data = nullptr;
 		Texture* image = Factory::createTexture(textureDesc, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_QUEUE_GRAPHICS_BIT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
-
-		CommandPool* commandPool = &LayerManager::get()->getCommandPools()->graphicsPool;
-		CommandBuffer* commandBuffer = commandPool->beginSingleTimeCommand();
+		images[target] = image;
 		image->image.setLayout(
 			commandBuffer,
 			VK_IMAGE_ASPECT_COLOR_BIT,
 			VK_IMAGE_LAYOUT_UNDEFINED,
 			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-		commandPool->endSingleTimeCommand(commandBuffer);
 
-		Pipeline pipeline;
-		Shader shader;
+		Pipeline& pipeline = pipelines[target];
+		Shader& shader = shaders[target];
 		shader.addStage(Shader::Type::VERTEX, YM_ASSETS_FILE_PATH + "Shaders/cubeVert.spv");
 		switch (target)
 		{
@@ -369,14 +400,14 @@ std::pair<ym::Texture*, ym::Texture*> ym::IBLFunctions::createIrradianceAndPrefi
 		}
 		shader.init();
 
-		DescriptorPool descPool;
-		DescriptorLayout descLayout;
+		DescriptorPool& descPool = descPools[target];
+		DescriptorLayout& descLayout = descLayouts[target];
 		descLayout.add(new IMG(VK_SHADER_STAGE_FRAGMENT_BIT)); // Environment cube texture
 		descLayout.init();
 		descPool.addDescriptorLayout(descLayout, 1);
 		descPool.init(1);
 
-		Sampler sampler;
+		Sampler& sampler = samplers[target];
 		sampler.init(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 1);
 
 		VkDescriptorSet descriptorSet;
@@ -389,7 +420,7 @@ std::pair<ym::Texture*, ym::Texture*> ym::IBLFunctions::createIrradianceAndPrefi
 		modelSet.setImageDesc(0, imageInfo);
 		modelSet.update();
 
-		RenderPass renderPass;
+		RenderPass& renderPass = renderPasses[target];
 		VkAttachmentDescription colorAttachment = {};
 		colorAttachment.format = format;
 		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -508,7 +539,7 @@ std::pair<ym::Texture*, ym::Texture*> ym::IBLFunctions::createIrradianceAndPrefi
 		value.color = { 0.0f, 0.0f, 0.2f, 0.0f };
 		clearValues.push_back(value);
 
-		VkFramebuffer frameBuffer;
+		VkFramebuffer& frameBuffer = frameBuffers[target];
 		VkFramebufferCreateInfo frameBufferInfo = {};
 		frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 		frameBufferInfo.renderPass = renderPass.getRenderPass();
@@ -541,20 +572,14 @@ std::pair<ym::Texture*, ym::Texture*> ym::IBLFunctions::createIrradianceAndPrefi
 		subresourceRange.levelCount = mipLevels;
 		subresourceRange.layerCount = 6;
 		// Transfer all cube faces and mipmaps to TRANSFER_DST.
-		{
-			commandBuffer = commandPool->beginSingleTimeCommand();
-			newTexture->image.setLayout(
-				commandBuffer,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				subresourceRange);
-			commandPool->endSingleTimeCommand(commandBuffer);
-		}
-		
+		newTexture->image.setLayout(
+			commandBuffer,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			subresourceRange);
+
 		for (uint32_t mip = 0; mip < mipLevels; mip++) {
 			for (uint32_t f = 0; f < 6; f++) {
-				commandBuffer = commandPool->beginSingleTimeCommand();
-
 				viewport.width = static_cast<float>(extent.width * std::pow(0.5f, mip));
 				viewport.height = static_cast<float>(extent.height * std::pow(0.5f, mip));
 				vkCmdSetViewport(commandBuffer->getCommandBuffer(), 0, 1, &viewport);
@@ -625,34 +650,30 @@ std::pair<ym::Texture*, ym::Texture*> ym::IBLFunctions::createIrradianceAndPrefi
 					VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
 					VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-				commandPool->endSingleTimeCommand(commandBuffer);
+				submitPass(commandPool, commandBuffer);
 			}
 		}
 
 		// Transform to SHADER_READ layout.
-		{
-			commandBuffer = commandPool->beginSingleTimeCommand();
-			newTexture->image.setLayout(
-				commandBuffer,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				subresourceRange);
-			commandPool->endSingleTimeCommand(commandBuffer);
-		}
-
-		//if (mipLevels > 1)
-		//	Factory::generateMipmaps(newTexture);
-
-		sampler.destroy();
-		vkDestroyFramebuffer(VulkanInstance::get()->getLogicalDevice(), frameBuffer, nullptr);
-		descLayout.destroy();
-		descPool.destroy();
-		renderPass.destroy();
-		shader.destroy();
-		pipeline.destroy();
+		newTexture->image.setLayout(
+			commandBuffer,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			subresourceRange);
+	}
+	commandPool->endSingleTimeCommand(commandBuffer);
 
-		image->destroy();
-		SAFE_DELETE(image);
+	for (uint32_t target = firstTarget; target < COUNT; target++) {
+		samplers[target].destroy();
+		vkDestroyFramebuffer(VulkanInstance::get()->getLogicalDevice(), frameBuffers[target], nullptr);
+		descLayouts[target].destroy();
+		descPools[target].destroy();
+		renderPasses[target].destroy();
+		shaders[target].destroy();
+		pipelines[target].destroy();
+
+		images[target]->destroy();
+		SAFE_DELETE(images[target]);
 	}
 
 	cubeModel.destroy();
@@ -672,16 +693,7 @@ ym::Texture* ym::IBLFunctions::createBRDFLutTexture(uint32_t size)
 	textureDesc.height = extent.height;
 	textureDesc.format = format;
 	textureDesc.data = nullptr;
-	Texture* brdfLutTexture = Factory::createTexture(textureDesc, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_QUEUE_GRAPHICS_BIT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
-
-	CommandPool* commandPool = &LayerManager::get()->getCommandPools()->graphicsPool;
-	CommandBuffer* commandBuffer = commandPool->beginSingleTimeCommand();
-	brdfLutTexture->image.setLayout(
-		commandBuffer,
-		VK_IMAGE_ASPECT_COLOR_BIT,
-		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-	commandPool->endSingleTimeCommand(commandBuffer);
+	Texture* brdfLutTexture = Factory::createTexture(textureDesc, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_QUEUE_GRAPHICS_BIT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 
 	Pipeline pipeline;
 	Shader shader;
@@ -779,7 +791,14 @@ ym::Texture* ym::IBLFunctions::createBRDFLutTexture(uint32_t size)
 	frameBufferInfo.layers = 1;
 	vkCreateFramebuffer(VulkanInstance::get()->getLogicalDevice(), &frameBufferInfo, nullptr, &frameBuffer);
 
-	commandBuffer = commandPool->beginSingleTimeCommand();
+	CommandPool* commandPool = &LayerManager::get()->getCommandPools()->graphicsPool;
+	CommandBuffer* commandBuffer = commandPool->beginSingleTimeCommand();
+	brdfLutTexture->image.setLayout(
+		commandBuffer,
+		VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
 	commandBuffer->cmdBeginRenderPass(&renderPass, frameBuffer, extent, clearValues, VK_SUBPASS_CONTENTS_INLINE);
 
 	commandBuffer->cmdBindPipeline(&pipeline);
@@ -787,6 +806,12 @@ ym::Texture* ym::IBLFunctions::createBRDFLutTexture(uint32_t size)
 
 	commandBuffer->cmdEndRenderPass();
 
+	brdfLutTexture->image.setLayout(
+		commandBuffer,
+		VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
 	commandPool->endSingleTimeCommand(commandBuffer);
 
 	sampler.destroy();
@@ -796,13 +821,71 @@ ym::Texture* ym::IBLFunctions::createBRDFLutTexture(uint32_t size)
 	shader.destroy();
 	pipeline.destroy();
 
-	Image::TransistionDesc transitionDesc;
-	transitionDesc.format = format;
-	transitionDesc.layerCount = 1;
-	transitionDesc.pool = commandPool;
-	transitionDesc.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	transitionDesc.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	brdfLutTexture->image.transistionLayout(transitionDesc);
-
 	return brdfLutTexture;
 }
+
+std::vector<float> ym::IBLFunctions::readCubeMap(Texture* cubeMap, uint32_t mipLevel)
+{
+	YM_ASSERT(cubeMap->textureDesc.format == VK_FORMAT_R32G32B32A32_SFLOAT, "Only RGBA32F cube maps can be read back!");
+	YM_ASSERT(mipLevel < cubeMap->image.getMipLevels(), "Mip level {} is out of range!", mipLevel);
+
+	const uint32_t width = std::max(cubeMap->textureDesc.width >> mipLevel, 1u);
+	const uint32_t height = std::max(cubeMap->textureDesc.height >> mipLevel, 1u);
+	const uint64_t size = (uint64_t)width * height * 4 * sizeof(float) * 6;
+
+	Buffer stagingBuffer;
+	Memory stagingMemory;
+	stagingBuffer.init(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, { VulkanInstance::get()->getGraphicsQueue().queueIndex });
+	stagingMemory.bindBuffer(&stagingBuffer);
+	stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryAllocator::Lifetime::TRANSIENT);
+
+	// The faces are tightly packed after each other.
+	VkBufferImageCopy region = {};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = mipLevel;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 6;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { width, height, 1 };
+
+	CommandPool* commandPool = &LayerManager::get()->getCommandPools()->graphicsPool;
+	CommandBuffer* commandBuffer = commandPool->beginSingleTimeCommand();
+	cubeMap->image.setLayout(commandBuffer, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	commandBuffer->cmdCopyImageToBuffer(cubeMap->image.getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingBuffer.getBuffer(), 1, &region);
+	cubeMap->image.setLayout(commandBuffer, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	commandPool->endSingleTimeCommand(commandBuffer);
+
+	std::vector<float> data((size_t)(size / sizeof(float)));
+	memcpy(data.data(), stagingMemory.getMappedData(&stagingBuffer), (size_t)size);
+
+	stagingBuffer.destroy();
+	stagingMemory.destroy();
+	return data;
+}
+
+uint32_t ym::IBLFunctions::getMipLevels(uint32_t sideSize)
+{
+	return static_cast<uint32_t>(std::floor(std::log2(sideSize))) + 1;
+}
+
+void ym::IBLFunctions::setBatched(bool batched)
+{
+	IBLFunctions::batched = batched;
+}
+
+bool ym::IBLFunctions::isBatched()
+{
+	return batched;
+}
+
+void ym::IBLFunctions::submitPass(CommandPool* commandPool, CommandBuffer*& commandBuffer)
+{
+	if (batched == false)
+	{
+		commandPool->endSingleTimeCommand(commandBuffer);
+		commandBuffer = commandPool->beginSingleTimeCommand();
+	}
+}
@@ -2,19 +2,61 @@
 
 #include "Engine/Core/Vulkan/Texture.h"
 
+#define IBL_ENVIRONMENT_SIZE 512
+#define IBL_IRRADIANCE_SIZE 64
+#define IBL_PREFILTERED_SIZE 512
+#define IBL_BRDF_LUT_SIZE 512
+
 namespace ym
 {
+	class CommandPool;
+	class CommandBuffer;
+
+	/*
+		Each function records all of its passes into one command buffer, which is submitted once.
+	*/
 	class IBLFunctions
 	{
 	public:
+		/*
+			Load an HDR image to a RGBA32F texture in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. Returns nullptr if it could not be loaded.
+		*/
+		static Texture* loadEquirectangularTexture(const std::string& hdrPath);
+
 		/*
 			Convert a 2D texture from equirectangular form to a cubemap form with the desired mip levels.
 			If desiredMipLevels is 0, the final texture will use as many mip levels as it can.
 		*/
 		static Texture* convertEquirectangularToCubemap(uint32_t sideSize, Texture* texture, uint32_t desiredMipLevels);
 
-		static std::pair<ym::Texture*, ym::Texture*> createIrradianceAndPrefilteredMap(Texture* environmentCube);
+		/*
+			The irradiance map is only created if createIrradiance is true, it is nullptr otherwise.
+		*/
+		static std::pair<ym::Texture*, ym::Texture*> createIrradianceAndPrefilteredMap(Texture* environmentCube, bool createIrradiance = true);
 
 		static Texture* createBRDFLutTexture(uint32_t size);
+
+		/*
+			Read back all six faces of a mip level of a RGBA32F cube map, in the order +X, -X, +Y, -Y, +Z, -Z.
+			The texture needs VK_IMAGE_USAGE_TRANSFER_SRC_BIT and to be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+		*/
+		static std::vector<float> readCubeMap(Texture* cubeMap, uint32_t mipLevel);
+
+		/*
+			Number of mip levels of a full mip chain.
+		*/
+		static uint32_t getMipLevels(uint32_t sideSize);
+
+		/*
+			When disabled, every face and mip level is submitted on its own and waited for. Only used to compare the timings.
+		*/
+		static void setBatched(bool batched);
+		static bool isBatched();
+
+	private:
+		// Submit the recorded pass and begin a new command buffer if batching is disabled.
+		static void submitPass(CommandPool* commandPool, CommandBuffer*& commandBuffer);
+
+		static bool batched;
 	};
 }
\ No newline at end of file
@@ -155,7 +155,7 @@ void ym::VKImgui::initImgui()
 	init_info.Device = instance->getLogicalDevice();
 	init_info.QueueFamily = VK_QUEUE_GRAPHICS_BIT;
 	init_info.Queue = instance->getGraphicsQueue().queue;
-	init_info.PipelineCache = VK_NULL_HANDLE;
+	init_info.PipelineCache = instance->getPipelineCache()->getCache();
 	init_info.DescriptorPool = this->descPool;
 	init_info.Allocator = nullptr;
 	init_info.MinImageCount = this->swapChain->getNumImages();
@@ -0,0 +1,144 @@
+#include "stdafx.h"
+#include "MaterialTable.h"
+
+#include "Engine/Core/Vulkan/VulkanInstance.h"
+#include "Engine/Core/Vulkan/Pipeline/DescriptorSet.h"
+
+ym::MaterialTable::MaterialTable() : frameCount(0), frame(0), writeCount(0), nextMaterialSlot(0), nextTextureSlot(0), descriptorSet(VK_NULL_HANDLE)
+{
+}
+
+ym::MaterialTable::~MaterialTable()
+{
+}
+
+void ym::MaterialTable::init(uint32_t frameCount)
+{
+	this->frameCount = frameCount;
+	this->frame = 0;
+
+	// The texture array is written while sets which use it are in flight, only slots which are not in use are written.
+	this->layout.add(new SSBO(VK_SHADER_STAGE_FRAGMENT_BIT)); // Materials
+	this->layout.add(new IMG(VK_SHADER_STAGE_FRAGMENT_BIT, MATERIAL_TABLE_MAX_TEXTURES, nullptr),
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT); // Textures
+	this->layout.init();
+
+	this->descriptorPool.addDescriptorLayout(this->layout, 1);
+	this->descriptorPool.init(1);
+
+	this->materialBuffer.init(sizeof(MaterialData) * MATERIAL_TABLE_MAX_MATERIALS);
+
+	DescriptorSet set;
+	set.init(this->layout, &this->descriptorSet, &this->descriptorPool);
+	set.setBufferDesc(0, this->materialBuffer.getDescriptor());
+	set.update();
+}
+
+void ym::MaterialTable::destroy()
+{
+	this->descriptorPool.destroy();
+	this->layout.destroy();
+	this->materialBuffer.destroy();
+	this->entries.clear();
+}
+
+void ym::MaterialTable::addModel(Model* model)
+{
+	auto it = this->entries.find(model->uniqueId);
+	if (it != this->entries.end())
+	{
+		it->second.lastUsedFrame = this->frame;
+		return;
+	}
+
+	Entry& entry = this->entries[model->uniqueId];
+	entry.lastUsedFrame = this->frame;
+
+	// Materials of the same model often share textures, each pair of texture and sampler gets one slot.
+	std::map<std::pair<Texture*, Sampler*>, uint32_t> textureSlots;
+	auto getTextureSlot = [&](const Material::Tex& tex) -> uint32_t {
+		auto textureIt = textureSlots.find({ tex.texture, tex.sampler });
+		if (textureIt != textureSlots.end())
+			return textureIt->second;
+
+		const uint32_t slot = allocateSlot(this->freeTextureSlots, this->nextTextureSlot, MATERIAL_TABLE_MAX_TEXTURES);
+		VkDescriptorImageInfo imageInfo;
+		imageInfo.imageLayout = tex.texture->image.getLayout();
+		imageInfo.imageView = tex.texture->imageView.getImageView();
+		imageInfo.sampler = tex.sampler->getSampler();
+		this->pendingImages.push_back(imageInfo);
+		this->pendingSlots.push_back(slot);
+		entry.textureSlots.push_back(slot);
+		textureSlots[{ tex.texture, tex.sampler }] = slot;
+		return slot;
+	};
+
+	for (Material& material : model->materials)
+	{
+		MaterialData data = {};
+		data.factors = material.pushData;
+		data.textures[0] = getTextureSlot(material.baseColorTexture);
+		data.textures[1] = getTextureSlot(material.metallicRoughnessTexture);
+		data.textures[2] = getTextureSlot(material.normalTexture);
+		data.textures[3] = getTextureSlot(material.occlusionTexture);
+		data.textures[4] = getTextureSlot(material.emissiveTexture);
+
+		// The slot is not used by any frame in flight, it can be written directly.
+		material.tableIndex = allocateSlot(this->freeMaterialSlots, this->nextMaterialSlot, MATERIAL_TABLE_MAX_MATERIALS);
+		this->materialBuffer.transfer(&data, sizeof(MaterialData), sizeof(MaterialData) * material.tableIndex);
+		entry.materialSlots.push_back(material.tableIndex);
+	}
+}
+
+void ym::MaterialTable::update()
+{
+	// One write for each new texture, the slots are usually not contiguous.
+	this->writeCount = (uint32_t)this->pendingSlots.size();
+	if (this->pendingSlots.empty() == false)
+	{
+		std::vector<VkWriteDescriptorSet> writes(this->pendingSlots.size());
+		for (size_t i = 0; i < this->pendingSlots.size(); i++)
+		{
+			VkWriteDescriptorSet& write = writes[i];
+			write = {};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = this->descriptorSet;
+			write.dstBinding = 1;
+			write.dstArrayElement = this->pendingSlots[i];
+			write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			write.descriptorCount = 1;
+			write.pImageInfo = &this->pendingImages[i];
+		}
+		vkUpdateDescriptorSets(VulkanInstance::get()->getLogicalDevice(), (uint32_t)writes.size(), writes.data(), 0, nullptr);
+		this->pendingImages.clear();
+		this->pendingSlots.clear();
+	}
+
+	// Release the models which have not been drawn by any frame in flight.
+	for (auto it = this->entries.begin(); it != this->entries.end();)
+	{
+		if (it->second.lastUsedFrame + this->frameCount < this->frame)
+		{
+			this->freeMaterialSlots.insert(this->freeMaterialSlots.end(), it->second.materialSlots.begin(), it->second.materialSlots.end());
+			this->freeTextureSlots.insert(this->freeTextureSlots.end(), it->second.textureSlots.begin(), it->second.textureSlots.end());
+			it = this->entries.erase(it);
+		}
+		else
+			++it;
+	}
+
+	this->frame++;
+}
+
+uint32_t ym::MaterialTable::allocateSlot(std::vector<uint32_t>& freeSlots, uint32_t& nextSlot, uint32_t maxSlots)
+{
+	if (freeSlots.empty() == false)
+	{
+		const uint32_t slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+
+	YM_ASSERT(nextSlot < maxSlots, "The material table is full! Slots: {}", maxSlots);
+	return nextSlot++;
+}
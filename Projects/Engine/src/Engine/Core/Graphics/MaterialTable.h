@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Engine/Core/Scene/Model/Model.h"
+#include "Engine/Core/Vulkan/Pipeline/DescriptorLayout.h"
+#include "Engine/Core/Vulkan/Pipeline/DescriptorPool.h"
+#include "Engine/Core/Vulkan/Buffers/StorageBuffer.h"
+
+#define MATERIAL_TABLE_MAX_MATERIALS 4096 // Materials of all registered models.
+#define MATERIAL_TABLE_MAX_TEXTURES 4096 // Texture and sampler pairs of all registered models, the size of the texture array in the shader.
+#define MATERIAL_TABLE_TEXTURE_COUNT 5 // Textures of one material, in the order of the material descriptor set.
+
+namespace ym
+{
+	/*
+		Bindless materials. The materials of all drawn models are stored in one storage buffer and their textures in one array of
+		combined image samplers, both in a single descriptor set which is bound once per draw call. A draw selects its material with
+		Material::tableIndex. Models are registered the first time they are drawn, only the new materials and textures are written.
+		A model is released when it has not been drawn for frameCount frames, at that point no frame in flight uses its slots.
+	*/
+	class MaterialTable
+	{
+	public:
+		MaterialTable();
+		~MaterialTable();
+
+		void init(uint32_t frameCount);
+		void destroy();
+
+		/*
+			Register the materials of the model if it is not registered, and mark it as used this frame.
+		*/
+		void addModel(Model* model);
+
+		/*
+			Write the descriptors of the textures which were added this frame and release the models which are no longer used.
+			Needs to be called once per frame, after all models have been added.
+		*/
+		void update();
+
+		const DescriptorLayout& getLayout() const { return this->layout; }
+		VkDescriptorSet getDescriptorSet() const { return this->descriptorSet; }
+
+		/*
+			Number of descriptors which were written by the last update.
+		*/
+		uint32_t getWriteCount() const { return this->writeCount; }
+
+	private:
+		// Layout matches the std430 struct of the bindless fragment shader.
+		struct MaterialData
+		{
+			Material::PushData factors;
+			uint32_t textures[MATERIAL_TABLE_TEXTURE_COUNT];
+			uint32_t pad[3];
+		};
+
+		struct Entry
+		{
+			uint64_t lastUsedFrame{ 0 };
+			std::vector<uint32_t> materialSlots;
+			std::vector<uint32_t> textureSlots;
+		};
+
+		uint32_t allocateSlot(std::vector<uint32_t>& freeSlots, uint32_t& nextSlot, uint32_t maxSlots);
+
+	private:
+		uint32_t frameCount;
+		uint64_t frame;
+		uint32_t writeCount;
+
+		std::unordered_map<uint32_t, Entry> entries; // Keyed by the unique id of the model.
+		std::vector<uint32_t> freeMaterialSlots;
+		std::vector<uint32_t> freeTextureSlots;
+		uint32_t nextMaterialSlot;
+		uint32_t nextTextureSlot;
+
+		// Textures which have been added since the last update.
+		std::vector<VkDescriptorImageInfo> pendingImages;
+		std::vector<uint32_t> pendingSlots;
+
+		StorageBuffer materialBuffer;
+		DescriptorLayout layout;
+		DescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+	};
+}
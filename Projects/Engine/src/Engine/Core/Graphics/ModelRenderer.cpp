@@ -1,14 +1,25 @@
 #include "stdafx.h"
 #include "ModelRenderer.h"
-#include "Engine/Core/Threading/ThreadManager.h"
+#include "Engine/Core/Threading/JobSystem.h"
 #include "Engine/Core/Scene/Vertex.h"
 #include "Engine/Core/Vulkan/Pipeline/DescriptorSet.h"
 #include "Renderer.h"
+#include "../Input/Config.h"
 
 ym::ModelRenderer::ModelRenderer()
 {
 	this->threadID = 0;
 	this->swapChain = nullptr;
+	this->instanceDescriptorSet = VK_NULL_HANDLE;
+	this->gpuCulling = false;
+	this->occlusionCulling = false;
+	this->bindlessMaterials = false;
+	this->packedVertices = false;
+	this->lodSelection = false;
+	this->lodCameraPosition = glm::vec3(0.f);
+	this->lodProjectionScale = 0.f;
+	this->triangleCount = 0;
+	this->descriptorWriteCount = 0;
 }
 
 ym::ModelRenderer::~ModelRenderer()
@@ -21,107 +32,210 @@ void ym::ModelRenderer::init(SwapChain* swapChain, uint32_t threadID, RenderPass
 	this->threadID = threadID;
 	YM_LOG_INFO("Started Model renderer with thread id {}.", threadID);
 
-	this->commandPool.init(CommandPool::Queue::GRAPHICS, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
-	this->commandBuffers = this->commandPool.createCommandBuffers(this->swapChain->getNumImages(), VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+	this->recordedBuffers.resize(this->swapChain->getNumImages());
+
+	this->bindlessMaterials = Config::get()->fetch<bool>("Graphics/bindlessMaterials");
+	if (this->bindlessMaterials && VulkanInstance::get()->supportsDescriptorIndexing() == false)
+	{
+		YM_LOG_WARN("Bindless materials need descriptor indexing, which the device does not support. Using material descriptor sets.");
+		this->bindlessMaterials = false;
+	}
 
 	this->shader.addStage(Shader::Type::VERTEX, YM_ASSETS_FILE_PATH + "Shaders/pbrTestVert.spv");
-	this->shader.addStage(Shader::Type::FRAGMENT, YM_ASSETS_FILE_PATH + "Shaders/pbrFrag.spv");
+	// The SH variant reads the irradiance from the scene data instead of an irradiance cube map.
+	const bool shIrradiance = Config::get()->fetch<bool>("Graphics/shIrradiance");
+	std::string fragmentShader = std::string("Shaders/pbr") + (shIrradiance ? "Sh" : "") + (this->bindlessMaterials ? "Bindless" : "") + "Frag.spv";
+	if (this->bindlessMaterials && Shader::exists(YM_ASSETS_FILE_PATH + fragmentShader) == false)
+	{
+		YM_LOG_WARN("{} has not been compiled. Using material descriptor sets.", fragmentShader.c_str());
+		this->bindlessMaterials = false;
+		fragmentShader = std::string("Shaders/pbr") + (shIrradiance ? "Sh" : "") + "Frag.spv";
+	}
+	this->shader.addStage(Shader::Type::FRAGMENT, YM_ASSETS_FILE_PATH + fragmentShader);
 	this->shader.init();
 
+	// The GLTFLoader packs the vertices of the models it loads with the same setting.
+	this->packedVertices = Config::get()->fetch<bool>("Graphics/packedVertices");
+	if (this->packedVertices)
+	{
+		this->packedShader.addStage(Shader::Type::VERTEX, YM_ASSETS_FILE_PATH + "Shaders/pbrTestPackedVert.spv");
+		this->packedShader.addStage(Shader::Type::FRAGMENT, YM_ASSETS_FILE_PATH + fragmentShader);
+		this->packedShader.init();
+	}
+
 	this->shouldRecreateDescriptors.resize(this->swapChain->getNumImages(), false);
 	this->descriptorPools.resize(this->swapChain->getNumImages());
 	this->renderInheritanceData = renderInheritanceData;
 
 	createDescriptorLayouts();
-	std::vector<DescriptorLayout> descriptorLayouts = { this->renderInheritanceData->sceneDescriptors.layout, descriptorSetLayouts.node, descriptorSetLayouts.material, descriptorSetLayouts.model, this->renderInheritanceData->sceneDescriptors.layoutEnv };
-	VkVertexInputBindingDescription vertexBindingDescriptions = Vertex::getBindingDescriptions();
-	std::array<VkVertexInputAttributeDescription, 3> vertexAttributeDescriptions = Vertex::getAttributeDescriptions();
-	PipelineInfo pipelineInfo = {};
-	pipelineInfo.vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	pipelineInfo.vertexInputInfo.vertexBindingDescriptionCount = 1;
-	pipelineInfo.vertexInputInfo.vertexAttributeDescriptionCount = 3;
-	pipelineInfo.vertexInputInfo.pVertexBindingDescriptions = &vertexBindingDescriptions;
-	pipelineInfo.vertexInputInfo.pVertexAttributeDescriptions = vertexAttributeDescriptions.data();
 
-	VkPushConstantRange pushConstRange = {};
-	pushConstRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-	pushConstRange.size = sizeof(Material::PushData);
-	pushConstRange.offset = 0;
-	this->pipeline.setPushConstant(pushConstRange);
-	this->pipeline.setPipelineInfo(PipelineInfoFlag::VERTEX_INPUT, pipelineInfo);
-	this->pipeline.setDescriptorLayouts(descriptorLayouts);
-	this->pipeline.setGraphicsPipelineInfo(this->swapChain->getExtent(), renderPass);
-	this->pipeline.setWireframe(false);
-	this->pipeline.init(Pipeline::Type::GRAPHICS, &this->shader);
+	if (this->bindlessMaterials)
+		this->materialTable.init(this->swapChain->getNumImages());
+
+	this->lodSelection = Config::get()->fetch<bool>("Graphics/lodSelection");
+
+	this->gpuCulling = Config::get()->fetch<bool>("Graphics/gpuCulling");
+	std::string reason;
+	if (this->gpuCulling && GpuCuller::isSupported(false, &reason) == false)
+	{
+		YM_LOG_WARN("GPU culling is not available, {}. Culling the models on the CPU.", reason.c_str());
+		this->gpuCulling = false;
+	}
+	this->occlusionCulling = this->gpuCulling && Config::get()->fetch<bool>("Graphics/occlusionCulling");
+	if (this->occlusionCulling && GpuCuller::isSupported(true, &reason) == false)
+	{
+		YM_LOG_WARN("Occlusion culling is not available, {}. Culling the models against the frustum only.", reason.c_str());
+		this->occlusionCulling = false;
+	}
+	if (this->gpuCulling)
+		this->gpuCuller.init(this->swapChain->getNumImages(), this->descriptorSetLayouts.model, this->occlusionCulling);
+
+	// All instance transforms are stored in one buffer, a draw selects its transforms with firstInstance.
+	this->instanceBuffer.init(sizeof(glm::mat4) * INSTANCE_BUFFER_START_COUNT, this->swapChain->getNumImages(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	createInstanceDescriptorSet();
+
+	createPipeline(this->pipeline, this->shader, VertexFormat::FULL, renderPass);
+	if (this->packedVertices)
+		createPipeline(this->packedPipeline, this->packedShader, VertexFormat::PACKED, renderPass);
 }
 
 void ym::ModelRenderer::destroy()
 {
 	this->shader.destroy();
 	this->pipeline.destroy();
-	this->commandPool.destroy();
+	if (this->packedVertices)
+	{
+		this->packedShader.destroy();
+		this->packedPipeline.destroy();
+	}
 	for (DescriptorPool& pool : this->descriptorPools)
 		pool.destroy();
+	this->instanceDescriptorPool.destroy();
+	this->instanceBuffer.destroy();
+	if (this->gpuCulling)
+		this->gpuCuller.destroy();
+	if (this->bindlessMaterials)
+		this->materialTable.destroy();
 
 	this->descriptorSetLayouts.model.destroy();
 	this->descriptorSetLayouts.node.destroy();
 	this->descriptorSetLayouts.material.destroy();
-
-	for (auto& batch : this->drawBatch)
-		for (auto& drawData : batch)
-			drawData.second.transformsBuffer.destroy();
 }
 
 void ym::ModelRenderer::begin(uint32_t imageIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
 {
 	this->inheritanceInfo = inheritanceInfo;
 
+	// Keep the draw data, the transforms are cleared without releasing their memory.
 	if (this->drawBatch.empty() == false)
 	{
 		for (auto& drawData : this->drawBatch[imageIndex])
+		{
 			drawData.second.exists = false;
+			drawData.second.transforms.clear();
+			drawData.second.instanceIDs.clear();
+		}
 	}
+}
 
-	// Clear draw data if descriptor pool should be recreated.
-	if (this->shouldRecreateDescriptors[imageIndex])
+void ym::ModelRenderer::drawModel(uint32_t imageIndex, Model* model, const glm::mat4& transform)
+{
+	DrawData* drawData = getDrawData(imageIndex, model);
+	if (drawData)
 	{
-		for (auto& drawData : this->drawBatch[imageIndex])
-			drawData.second.transformsBuffer.destroy();
-		this->drawBatch[imageIndex].clear();
+		drawData->transforms.push_back(transform);
+		drawData->instanceIDs.push_back(MODEL_NO_INSTANCE_ID);
 	}
 }
 
-void ym::ModelRenderer::drawModel(uint32_t imageIndex, Model* model, const glm::mat4& transform)
+void ym::ModelRenderer::drawModel(uint32_t imageIndex, Model* model, const std::vector<glm::mat4>& transforms)
 {
-	DrawData drawData = {};
-	drawData.model = model;
-	drawData.transforms.push_back(transform);
-	addModelToBatch(imageIndex, drawData);
+	DrawData* drawData = getDrawData(imageIndex, model);
+	if (drawData)
+	{
+		drawData->transforms.insert(drawData->transforms.end(), transforms.begin(), transforms.end());
+		drawData->instanceIDs.resize(drawData->transforms.size(), MODEL_NO_INSTANCE_ID);
+	}
 }
 
-void ym::ModelRenderer::drawModel(uint32_t imageIndex, Model* model, const std::vector<glm::mat4>& transforms)
+void ym::ModelRenderer::drawModel(uint32_t imageIndex, Model* model, const glm::mat4* transforms, uint32_t count, const uint32_t* instanceIDs)
+{
+	DrawData* drawData = getDrawData(imageIndex, model);
+	if (drawData)
+	{
+		drawData->transforms.insert(drawData->transforms.end(), transforms, transforms + count);
+		if (instanceIDs)
+			drawData->instanceIDs.insert(drawData->instanceIDs.end(), instanceIDs, instanceIDs + count);
+		else
+			drawData->instanceIDs.resize(drawData->transforms.size(), MODEL_NO_INSTANCE_ID);
+	}
+}
+
+void ym::ModelRenderer::setFrustum(const std::vector<Camera::Plane>& planes)
+{
+	this->frustumPlanes = planes;
+}
+
+void ym::ModelRenderer::setOcclusion(const DepthPyramid* depthPyramid, const glm::mat4& viewProjection)
+{
+	if (this->gpuCulling)
+		this->gpuCuller.setOcclusion(depthPyramid, viewProjection);
+}
+
+void ym::ModelRenderer::setLodView(const glm::vec3& cameraPosition, float projectionScale)
 {
-	DrawData drawData = {};
-	drawData.model = model;
-	drawData.transforms.insert(drawData.transforms.begin(), transforms.begin(), transforms.end());
-	addModelToBatch(imageIndex, drawData);
+	this->lodCameraPosition = cameraPosition;
+	this->lodProjectionScale = projectionScale;
+}
+
+uint32_t ym::ModelRenderer::selectLod(const Model& model, const glm::mat4& transform, const glm::vec3& cameraPosition, float projectionScale, uint32_t previousLod)
+{
+	if (model.lodCount <= 1 || projectionScale <= 0.f)
+		return 0;
+
+	// The error is scaled by the largest scale of the transform and projected at the point of the bounding sphere closest to the camera.
+	const float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+	const glm::vec3 center = glm::vec3(transform * glm::vec4(model.bounds.center, 1.f));
+	const float distance = glm::length(center - cameraPosition) - model.bounds.radius * scale;
+	if (distance <= 0.f)
+		return 0;
+
+	// The errors grow with the level, the first level which is too coarse ends the search.
+	const float pixelsPerUnit = projectionScale * scale / distance;
+	uint32_t lod = 0;
+	for (uint32_t level = 1; level < model.lodCount; level++)
+	{
+		const float maxError = level > previousLod ? LOD_MAX_PIXEL_ERROR * LOD_HYSTERESIS : LOD_MAX_PIXEL_ERROR;
+		if (model.lodErrors[level] * pixelsPerUnit > maxError)
+			break;
+		lod = level;
+	}
+	return lod;
 }
 
 void ym::ModelRenderer::end(uint32_t imageIndex)
 {
+	this->descriptorWriteCount = 0;
 	if (this->shouldRecreateDescriptors[imageIndex])
 	{
-		// Fetch number of nodes and materials.
-		uint32_t modelCount = 0;
+		// Models which are no longer drawn do not need descriptors.
+		std::map<uint32_t, DrawData>& batch = this->drawBatch[imageIndex];
+		for (auto it = batch.begin(); it != batch.end();)
+		{
+			if (it->second.exists) ++it;
+			else it = batch.erase(it);
+		}
+
+		// Fetch number of nodes and materials. Bindless materials are in the material table instead.
 		uint32_t nodeCount = 0;
 		uint32_t materialCount = 0;
 		for (auto& drawData : this->drawBatch[imageIndex])
 		{
-			modelCount++;
 			nodeCount += drawData.second.model->numMeshes;
-			materialCount += static_cast<uint32_t>(drawData.second.model->materials.size());
+			if (this->bindlessMaterials == false)
+				materialCount += static_cast<uint32_t>(drawData.second.model->materials.size());
 		}
-		recreateDescriptorPool(imageIndex, materialCount, nodeCount, modelCount);
+		recreateDescriptorPool(imageIndex, materialCount, nodeCount);
 
 		// Recreate descriptor sets
 		createDescriptorsSets(imageIndex, this->drawBatch[imageIndex]);
@@ -129,80 +243,366 @@ void ym::ModelRenderer::end(uint32_t imageIndex)
 		this->shouldRecreateDescriptors[imageIndex] = false;
 	}
 	
-	// Start recording all draw commands on the thread.
-	CommandBuffer* currentBuffer = this->commandBuffers[imageIndex];
-	currentBuffer->begin(VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, &inheritanceInfo);
+	// Upload instance data and gather all draws of this frame.
+	uploadInstanceData(imageIndex);
+	this->drawCommands.clear();
+	this->triangleCount = 0;
+	if (this->gpuCulling)
+	{
+		YM_ASSERT(this->frustumPlanes.size() == 6, "GPU culling needs the frustum to be set before end!");
+		this->gpuCuller.begin(imageIndex, this->frustumPlanes, (uint32_t)(this->instanceBuffer.getFrameSize() / sizeof(glm::mat4)));
+	}
 	if (this->drawBatch.empty() == false)
 	{
-		for (auto& drawData : this->drawBatch[imageIndex])
+		// The draws are sorted by vertex format, each chunk then changes pipeline at most once.
+		for (VertexFormat format : { VertexFormat::FULL, VertexFormat::PACKED })
 		{
-			if (drawData.second.exists)
+			for (auto& drawData : this->drawBatch[imageIndex])
 			{
-				uint32_t instanceCount = (uint32_t)drawData.second.transforms.size();
-				drawData.second.transformsBuffer.transfer(drawData.second.transforms.data(), sizeof(glm::mat4) * instanceCount, 0);
-				ThreadManager::addWork(this->threadID, [=]() {
-					recordModel(drawData.second.model, imageIndex, drawData.second.descriptorSet, instanceCount, currentBuffer);
-					});
+				DrawData& data = drawData.second;
+				if (data.exists && data.model->vertexFormat == format && data.model->getVertexBuffer() != VK_NULL_HANDLE)
+				{
+					// All instances of a model are culled with the bounds of the whole model, in one group for each level of detail.
+					if (this->gpuCulling)
+					{
+						for (uint32_t lod = 0; lod < MODEL_MAX_LODS; lod++)
+						{
+							if (data.lodInstanceCount[lod] > 0)
+								data.groups[lod] = this->gpuCuller.addGroup(data.model->bounds, data.lodFirstInstance[lod], data.lodInstanceCount[lod]);
+						}
+					}
+					if (this->bindlessMaterials)
+						this->materialTable.addModel(data.model);
+					for (Model::Node& node : data.model->nodes)
+						collectDrawCommands(data, node);
+				}
 			}
 		}
+	}
+	if (this->bindlessMaterials)
+	{
+		this->materialTable.update();
+		this->descriptorWriteCount += this->materialTable.getWriteCount();
+	}
+	if (this->gpuCulling)
+		this->gpuCuller.end();
+
+	/*
+		Split the draws into one chunk per thread. Each chunk is recorded into a secondary command buffer from the thread data of the
+		same index, the command pool of a thread data is therefore only used by one job at a time.
+	*/
+	std::vector<ThreadData>& threadData = this->renderInheritanceData->threadData;
+	const uint32_t drawCount = (uint32_t)this->drawCommands.size();
+	const uint32_t maxChunks = (uint32_t)threadData.size();
+	uint32_t chunkCount = std::min(maxChunks, (drawCount + MIN_DRAWS_PER_CHUNK - 1) / MIN_DRAWS_PER_CHUNK);
+	uint32_t chunkSize = chunkCount > 0 ? (drawCount + chunkCount - 1) / chunkCount : 0;
+
+	std::vector<VkCommandBuffer>& buffers = this->recordedBuffers[imageIndex];
+	buffers.clear();
+	if (chunkCount > 0)
+	{
+		YM_PROFILER_RENDERING_SCOPE("ModelRenderer record");
+		JobCounter counter;
+		JobSystem::dispatch(drawCount, chunkSize, [this, imageIndex, chunkSize, &threadData](uint32_t first, uint32_t last) {
+			CommandBuffer* cmdBuffer = threadData[first / chunkSize].secondaryCommandBuffersGraphics[imageIndex];
+			cmdBuffer->begin(VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, &this->inheritanceInfo);
+			recordDrawCommands(imageIndex, first, last, cmdBuffer);
+			cmdBuffer->end();
+		}, &counter);
+		JobSystem::wait(&counter);
+
+		for (uint32_t first = 0; first < drawCount; first += chunkSize)
+			buffers.push_back(threadData[first / chunkSize].secondaryCommandBuffersGraphics[imageIndex]->getCommandBuffer());
+	}
+}
 
-		ThreadManager::wait(this->threadID);
-	};
-	currentBuffer->end();
+void ym::ModelRenderer::recordCulling(CommandBuffer* cmdBuffer)
+{
+	if (this->gpuCulling)
+		this->gpuCuller.record(cmdBuffer);
 }
 
-std::vector<ym::CommandBuffer*>& ym::ModelRenderer::getBuffers()
+const std::vector<VkCommandBuffer>& ym::ModelRenderer::getBuffers(uint32_t imageIndex) const
 {
-	return this->commandBuffers;
+	return this->recordedBuffers[imageIndex];
 }
 
-void ym::ModelRenderer::recordModel(Model* model, uint32_t imageIndex, VkDescriptorSet instanceDescriptorSet, uint32_t instanceCount, CommandBuffer* cmdBuffer)
+void ym::ModelRenderer::uploadInstanceData(uint32_t imageIndex)
 {
-	if (model->vertexBuffer.getBuffer() == VK_NULL_HANDLE)
+	if (this->drawBatch.empty())
 		return;
 
-	cmdBuffer->cmdBindPipeline(&this->pipeline);
+	uint64_t instanceCount = 0;
+	for (auto& drawData : this->drawBatch[imageIndex])
+		if (drawData.second.exists)
+			instanceCount += drawData.second.transforms.size();
+
+	// Grow the buffer if this frame does not fit. This only happens a few times, it is fine to wait for the GPU.
+	uint64_t requiredSize = instanceCount * sizeof(glm::mat4);
+	if (requiredSize > this->instanceBuffer.getFrameSize())
+	{
+		uint64_t newSize = this->instanceBuffer.getFrameSize();
+		while (newSize < requiredSize)
+			newSize *= 2;
+
+		vkDeviceWaitIdle(VulkanInstance::get()->getLogicalDevice());
+		this->instanceBuffer.resize(newSize);
+		createInstanceDescriptorSet();
+		YM_LOG_INFO("Resized instance buffer to {} instances per frame.", newSize / sizeof(glm::mat4));
+	}
+
+	// Copy the transforms into the region of this image, the GPU is done with it since the fence of the image has been waited on.
+	this->instanceBuffer.begin(imageIndex);
+	for (auto& drawData : this->drawBatch[imageIndex])
+	{
+		DrawData& data = drawData.second;
+		data.lodFirstInstance.fill(0);
+		data.lodInstanceCount.fill(0);
+		if (data.exists && data.transforms.empty() == false)
+		{
+			const uint32_t count = (uint32_t)data.transforms.size();
+			uint64_t size = sizeof(glm::mat4) * count;
+			uint64_t offset = this->instanceBuffer.allocate(size, sizeof(glm::mat4));
+			data.firstInstance = (uint32_t)(offset / sizeof(glm::mat4));
+			if (this->lodSelection == false || data.model->lodCount <= 1)
+			{
+				memcpy(this->instanceBuffer.getData(offset), data.transforms.data(), size);
+				data.lodFirstInstance[0] = data.firstInstance;
+				data.lodInstanceCount[0] = count;
+				continue;
+			}
+
+			// Select the level of each instance and sort the instances by level with a counting sort. The level of the previous frame
+			// only counts if it was selected for the same model, the id might have been used by another instance since then.
+			this->instanceLods.resize(count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const uint32_t id = data.instanceIDs[i];
+				PreviousLod* previous = nullptr;
+				if (id != MODEL_NO_INSTANCE_ID)
+				{
+					if (id >= this->previousLods.size())
+						this->previousLods.resize((size_t)id + 1);
+					previous = &this->previousLods[id];
+				}
+				const uint32_t previousLod = (previous && previous->model == drawData.first) ? previous->lod : MODEL_MAX_LODS;
+				const uint32_t lod = selectLod(*data.model, data.transforms[i], this->lodCameraPosition, this->lodProjectionScale, previousLod);
+				this->instanceLods[i] = (uint8_t)lod;
+				if (previous)
+				{
+					previous->model = drawData.first;
+					previous->lod = lod;
+				}
+				data.lodInstanceCount[lod]++;
+			}
+
+			std::array<uint32_t, MODEL_MAX_LODS> next;
+			uint32_t first = 0;
+			for (uint32_t lod = 0; lod < MODEL_MAX_LODS; lod++)
+			{
+				data.lodFirstInstance[lod] = data.firstInstance + first;
+				next[lod] = first;
+				first += data.lodInstanceCount[lod];
+			}
+			glm::mat4* transforms = static_cast<glm::mat4*>(this->instanceBuffer.getData(offset));
+			for (uint32_t i = 0; i < count; i++)
+				transforms[next[this->instanceLods[i]]++] = data.transforms[i];
+		}
+	}
+}
 
-	VkBuffer buffer = model->vertexBuffer.getBuffer();
-	VkDeviceSize size = 0;
-	cmdBuffer->cmdBindVertexBuffers(0, 1, &buffer, &size);
-	if (model->indices.empty() == false)
-		cmdBuffer->cmdBindIndexBuffer(model->indexBuffer.getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+void ym::ModelRenderer::createInstanceDescriptorSet()
+{
+	if (this->instanceDescriptorPool.wasCreated())
+		this->instanceDescriptorPool.destroy();
+
+	this->instanceDescriptorPool.addDescriptorLayout(this->descriptorSetLayouts.model, 1);
+	this->instanceDescriptorPool.init(1);
+
+	DescriptorSet instanceSet;
+	instanceSet.init(this->descriptorSetLayouts.model, &this->instanceDescriptorSet, &this->instanceDescriptorPool);
+	instanceSet.setBufferDesc(0, this->instanceBuffer.getDescriptor());
+	instanceSet.update();
 
-	for (Model::Node& node : model->nodes)
-		drawNode(imageIndex, instanceDescriptorSet, cmdBuffer, &this->pipeline, node, instanceCount);
+	if (this->gpuCulling)
+		this->gpuCuller.setTransforms(this->instanceBuffer.getDescriptor());
 }
 
-void ym::ModelRenderer::drawNode(uint32_t imageIndex, VkDescriptorSet instanceDescriptorSet, CommandBuffer* commandBuffer, Pipeline* pipeline, Model::Node& node, uint32_t instanceCount)
+void ym::ModelRenderer::collectDrawCommands(DrawData& drawData, Model::Node& node)
 {
 	if (node.hasMesh)
 	{
-		Mesh& mesh = node.mesh;
-		for (Primitive& primitive : mesh.primitives)
+		// One draw for each level of detail which has instances. When culling on the GPU the levels of detail of a primitive are
+		// one batch in the culler, which is drawn with a single indirect count draw.
+		for (Primitive& primitive : node.mesh.primitives)
+		{
+			bool hasBatch = false;
+			for (uint32_t lod = 0; lod < MODEL_MAX_LODS; lod++)
+			{
+				if (drawData.lodInstanceCount[lod] == 0)
+					continue;
+
+				const uint32_t count = primitive.hasIndices ? primitive.getIndexCount(lod) : primitive.vertexCount;
+				this->triangleCount += (uint64_t)(count / 3) * drawData.lodInstanceCount[lod];
+				if (this->gpuCulling)
+				{
+					if (hasBatch == false)
+					{
+						DrawCommand command;
+						command.model = drawData.model;
+						command.node = &node;
+						command.primitive = &primitive;
+						command.indirectBatch = this->gpuCuller.addBatch();
+						this->drawCommands.push_back(command);
+						hasBatch = true;
+					}
+					const uint32_t vertexOffset = drawData.model->vertexOffset + primitive.firstVertex;
+					const uint32_t first = primitive.hasIndices ? drawData.model->indexOffset + primitive.getFirstIndex(lod) : vertexOffset;
+					this->gpuCuller.addCommand(drawData.groups[lod], count, first, vertexOffset, primitive.hasIndices);
+					continue;
+				}
+
+				DrawCommand command;
+				command.model = drawData.model;
+				command.node = &node;
+				command.primitive = &primitive;
+				command.firstInstance = drawData.lodFirstInstance[lod];
+				command.instanceCount = drawData.lodInstanceCount[lod];
+				command.lod = lod;
+				this->drawCommands.push_back(command);
+			}
+		}
+	}
+
+	for (Model::Node& child : node.children)
+		collectDrawCommands(drawData, child);
+}
+
+void ym::ModelRenderer::recordDrawCommands(uint32_t imageIndex, uint32_t first, uint32_t last, CommandBuffer* cmdBuffer)
+{
+	// The pipelines have the same layout, the descriptor sets stay bound when the pipeline changes.
+	Pipeline* boundPipeline = getPipeline(this->drawCommands[first].model->vertexFormat);
+	cmdBuffer->cmdBindPipeline(boundPipeline);
+
+	// With bindless materials only the node set changes between draws, the other sets are bound once.
+	std::vector<uint32_t> offsets;
+	if (this->bindlessMaterials)
+	{
+		std::vector<VkDescriptorSet> sceneSets = { this->renderInheritanceData->sceneDescriptors.sets[imageIndex] };
+		cmdBuffer->cmdBindDescriptorSets(&this->pipeline, 0, sceneSets, offsets);
+		std::vector<VkDescriptorSet> sharedSets = {
+			this->materialTable.getDescriptorSet(),
+			this->gpuCulling ? this->gpuCuller.getInstanceDescriptorSet() : this->instanceDescriptorSet,
+			this->renderInheritanceData->sceneDescriptors.setsEnv[imageIndex]
+		};
+		cmdBuffer->cmdBindDescriptorSets(&this->pipeline, 2, sharedSets, offsets);
+	}
+
+	// Models in the geometry arena share the same buffers, the geometry is only bound again for models with their own buffers.
+	VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+	VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+	VkIndexType boundIndexType = VK_INDEX_TYPE_UINT32;
+	for (uint32_t i = first; i < last; i++)
+	{
+		DrawCommand& command = this->drawCommands[i];
+		Model* model = command.model;
+
+		Pipeline* pipeline = getPipeline(model->vertexFormat);
+		if (pipeline != boundPipeline)
+		{
+			boundPipeline = pipeline;
+			cmdBuffer->cmdBindPipeline(pipeline);
+		}
+
+		VkBuffer vertexBuffer = model->getVertexBuffer();
+		if (vertexBuffer != boundVertexBuffer)
+		{
+			boundVertexBuffer = vertexBuffer;
+			VkDeviceSize offset = 0;
+			cmdBuffer->cmdBindVertexBuffers(0, 1, &vertexBuffer, &offset);
+		}
+		if (model->indices.empty() == false)
+		{
+			VkBuffer indexBuffer = model->getIndexBuffer();
+			if (indexBuffer != boundIndexBuffer || model->indexType != boundIndexType)
+			{
+				boundIndexBuffer = indexBuffer;
+				boundIndexType = model->indexType;
+				cmdBuffer->cmdBindIndexBuffer(indexBuffer, 0, model->indexType);
+			}
+		}
+
+		Primitive& primitive = *command.primitive;
+		if (this->bindlessMaterials)
+		{
+			cmdBuffer->cmdPushConstants(&this->pipeline, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &primitive.material->tableIndex);
+
+			std::vector<VkDescriptorSet> nodeSets = { command.node->descriptorSets[imageIndex] };
+			cmdBuffer->cmdBindDescriptorSets(&this->pipeline, 1, nodeSets, offsets);
+		}
+		else
 		{
 			Material::PushData& pushData = primitive.material->pushData;
-			commandBuffer->cmdPushConstants(pipeline, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(Material::PushData), &pushData);
+			cmdBuffer->cmdPushConstants(&this->pipeline, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(Material::PushData), &pushData);
 
-			std::vector<VkDescriptorSet> sets = { 
+			std::vector<VkDescriptorSet> sets = {
 				this->renderInheritanceData->sceneDescriptors.sets[imageIndex],
-				node.descriptorSets[imageIndex], 
+				command.node->descriptorSets[imageIndex],
 				primitive.material->descriptorSets[imageIndex],
-				instanceDescriptorSet,
+				this->gpuCulling ? this->gpuCuller.getInstanceDescriptorSet() : this->instanceDescriptorSet,
 				this->renderInheritanceData->sceneDescriptors.setsEnv[imageIndex]
 			};
-			std::vector<uint32_t> offsets;
-			commandBuffer->cmdBindDescriptorSets(pipeline, 0, sets, offsets);
+			cmdBuffer->cmdBindDescriptorSets(&this->pipeline, 0, sets, offsets);
+		}
 
+		// The draws of a culled batch and their instance counts are written by the GPU, the CPU does the same work for any number of
+		// levels of detail and instances.
+		if (this->gpuCulling)
+		{
+			const uint32_t batch = command.indirectBatch;
+			VkDeviceSize offset = this->gpuCuller.getIndirectOffset(batch);
+			VkDeviceSize countOffset = this->gpuCuller.getCountOffset(batch);
 			if (primitive.hasIndices)
-				commandBuffer->cmdDrawIndexed(primitive.indexCount, instanceCount, primitive.firstIndex, 0, 0);
+				cmdBuffer->cmdDrawIndexedIndirectCount(this->gpuCuller.getIndirectBuffer(), offset, this->gpuCuller.getCountBuffer(), countOffset, this->gpuCuller.getBatchSize(batch), GPU_CULLER_INDIRECT_STRIDE);
 			else
-				commandBuffer->cmdDraw(primitive.vertexCount, instanceCount, 0, 0);
+				cmdBuffer->cmdDrawIndirectCount(this->gpuCuller.getIndirectBuffer(), offset, this->gpuCuller.getCountBuffer(), countOffset, this->gpuCuller.getBatchSize(batch), GPU_CULLER_INDIRECT_STRIDE);
 		}
+		else if (primitive.hasIndices)
+			cmdBuffer->cmdDrawIndexed(primitive.getIndexCount(command.lod), command.instanceCount, model->indexOffset + primitive.getFirstIndex(command.lod), model->vertexOffset + primitive.firstVertex, command.firstInstance);
+		else
+			cmdBuffer->cmdDraw(primitive.vertexCount, command.instanceCount, model->vertexOffset + primitive.firstVertex, command.firstInstance);
 	}
+}
 
-	// Draw child nodes
-	for (Model::Node& child : node.children)
-		drawNode(imageIndex, instanceDescriptorSet, commandBuffer, pipeline, child, instanceCount);
+void ym::ModelRenderer::createPipeline(Pipeline& pipeline, Shader& shader, VertexFormat format, RenderPass* renderPass)
+{
+	const DescriptorLayout& materialLayout = this->bindlessMaterials ? this->materialTable.getLayout() : descriptorSetLayouts.material;
+	std::vector<DescriptorLayout> descriptorLayouts = { this->renderInheritanceData->sceneDescriptors.layout, descriptorSetLayouts.node, materialLayout, descriptorSetLayouts.model, this->renderInheritanceData->sceneDescriptors.layoutEnv };
+	const bool packed = format == VertexFormat::PACKED;
+	VkVertexInputBindingDescription vertexBindingDescriptions = packed ? PackedVertex::getBindingDescriptions() : Vertex::getBindingDescriptions();
+	std::array<VkVertexInputAttributeDescription, 3> vertexAttributeDescriptions = packed ? PackedVertex::getAttributeDescriptions() : Vertex::getAttributeDescriptions();
+	PipelineInfo pipelineInfo = {};
+	pipelineInfo.vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	pipelineInfo.vertexInputInfo.vertexBindingDescriptionCount = 1;
+	pipelineInfo.vertexInputInfo.vertexAttributeDescriptionCount = 3;
+	pipelineInfo.vertexInputInfo.pVertexBindingDescriptions = &vertexBindingDescriptions;
+	pipelineInfo.vertexInputInfo.pVertexAttributeDescriptions = vertexAttributeDescriptions.data();
+
+	VkPushConstantRange pushConstRange = {};
+	pushConstRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushConstRange.size = this->bindlessMaterials ? sizeof(uint32_t) : sizeof(Material::PushData);
+	pushConstRange.offset = 0;
+	pipeline.setPushConstant(pushConstRange);
+	pipeline.setPipelineInfo(PipelineInfoFlag::VERTEX_INPUT, pipelineInfo);
+	pipeline.setDescriptorLayouts(descriptorLayouts);
+	pipeline.setGraphicsPipelineInfo(this->swapChain->getExtent(), renderPass);
+	pipeline.setWireframe(false);
+	pipeline.init(Pipeline::Type::GRAPHICS, &shader);
+}
+
+ym::Pipeline* ym::ModelRenderer::getPipeline(VertexFormat format)
+{
+	return format == VertexFormat::PACKED ? &this->packedPipeline : &this->pipeline;
 }
 
 void ym::ModelRenderer::createDescriptorLayouts()
@@ -224,44 +624,37 @@ void ym::ModelRenderer::createDescriptorLayouts()
 	descriptorSetLayouts.material.init();
 }
 
-void ym::ModelRenderer::recreateDescriptorPool(uint32_t imageIndex, uint32_t materialCount, uint32_t nodeCount, uint32_t modelCount)
+void ym::ModelRenderer::recreateDescriptorPool(uint32_t imageIndex, uint32_t materialCount, uint32_t nodeCount)
 {
 	// Destroy the descriptor pool and its descriptor sets if it should be recreated.
 	DescriptorPool& descriptorPool = this->descriptorPools[imageIndex];
 	if (descriptorPool.wasCreated())
 		descriptorPool.destroy();
 
-	// There are many models with its own data => own descriptor set, multiply with the number of models.
-	descriptorPool.addDescriptorLayout(descriptorSetLayouts.model, modelCount);
 	// There are many nodes with its own data => own descriptor set, multiply with the number of nodes.
 	descriptorPool.addDescriptorLayout(descriptorSetLayouts.node, nodeCount);
 	// Same for the material but multiply instead with the number of materials.
-	descriptorPool.addDescriptorLayout(descriptorSetLayouts.material, materialCount);
+	if (materialCount > 0)
+		descriptorPool.addDescriptorLayout(descriptorSetLayouts.material, materialCount);
 
 	descriptorPool.init(1);
 }
 
-void ym::ModelRenderer::createDescriptorsSets(uint32_t imageIndex, std::map<uint64_t, DrawData>& drawBatch)
+void ym::ModelRenderer::createDescriptorsSets(uint32_t imageIndex, std::map<uint32_t, DrawData>& drawBatch)
 {
 	VkDevice device = VulkanInstance::get()->getLogicalDevice();
 
-	// Nodes, Materials and Models
+	// Nodes and Materials, the instance transforms use the descriptor set of the instance buffer.
 	for (auto& drawData : drawBatch)
 	{
-		// Models
-		{
-			DescriptorSet modelSet;
-			modelSet.init(descriptorSetLayouts.model, &drawData.second.descriptorSet, &this->descriptorPools[imageIndex]);
-			modelSet.setBufferDesc(0, drawData.second.transformsBuffer.getDescriptor());
-			modelSet.update();
-		}
-
 		// Nodes
 		std::vector<Model::Node>& nodes = drawData.second.model->nodes;
 		for(Model::Node& node : nodes)
 			createNodeDescriptorsSets(imageIndex, node);
 
-		// Materials
+		// Materials, bindless materials do not have descriptor sets.
+		if (this->bindlessMaterials)
+			continue;
 		std::vector<Material>& materials = drawData.second.model->materials;
 		for (Material& material : materials)
 		{
@@ -293,6 +686,7 @@ void ym::ModelRenderer::createDescriptorsSets(uint32_t imageIndex, std::map<uint
 					for(uint32_t binding = 0; binding < 5; binding++)
 						materialSet.setImageDesc(binding, imageInfos[binding]);
 					materialSet.update();
+					this->descriptorWriteCount += 5;
 				}
 			}
 		}
@@ -311,6 +705,11 @@ void ym::ModelRenderer::createNodeDescriptorsSets(uint32_t imageIndex, Model::No
 		node.uniformBuffers[imageIndex].init(sizeof(Model::Node::NodeData));
 		Model::Node::NodeData data;
 		data.transform = node.matrix;
+		const VertexQuantization& quantization = node.model->quantization;
+		const bool packed = node.model->vertexFormat == VertexFormat::PACKED;
+		data.positionOffset = packed ? glm::vec4(quantization.positionMin, 0.f) : glm::vec4(0.f);
+		data.positionScale = packed ? glm::vec4(quantization.positionExtent, 1.f) : glm::vec4(1.f);
+		data.uvTransform = packed ? glm::vec4(quantization.uvMin, quantization.uvExtent) : glm::vec4(0.f, 0.f, 1.f, 1.f);
 		node.uniformBuffers[imageIndex].transfer(&data, sizeof(data), 0);
 	}
 
@@ -321,46 +720,36 @@ void ym::ModelRenderer::createNodeDescriptorsSets(uint32_t imageIndex, Model::No
 	nodeSet.init(descriptorSetLayouts.node, &node.descriptorSets[imageIndex], &this->descriptorPools[imageIndex]);
 	nodeSet.setBufferDesc(0, node.uniformBuffers[imageIndex].getDescriptor());
 	nodeSet.update();
+	this->descriptorWriteCount++;
 
 	for (Model::Node& child : node.children)
 		createNodeDescriptorsSets(imageIndex, child);
 }
 
-uint64_t ym::ModelRenderer::getUniqueId(uint32_t modelId, uint32_t instanceCount)
-{
-	uint64_t instanceCount64 = static_cast<uint64_t>(instanceCount) & 0xFFFFFFFF;
-	uint64_t modelId64 = static_cast<uint64_t>(modelId) & 0xFFFFFFFF;
-	uint64_t id = (modelId64 << 32) | instanceCount64;
-	return id;
-}
-
-void ym::ModelRenderer::addModelToBatch(uint32_t imageIndex, DrawData& drawData)
+ym::ModelRenderer::DrawData* ym::ModelRenderer::getDrawData(uint32_t imageIndex, Model* model)
 {
 	// Only draw model if it is ready.
-	if (drawData.model->hasLoaded)
+	if (model->hasLoaded == false)
+		return nullptr;
+
+	if (this->drawBatch.empty())
+		this->drawBatch.resize(this->swapChain->getNumImages());
+
+	std::map<uint32_t, DrawData>& batch = this->drawBatch[imageIndex];
+	auto it = batch.find(model->uniqueId);
+	if (it == batch.end())
 	{
-		if (this->drawBatch.empty())
-			this->drawBatch.resize(this->swapChain->getNumImages());
+		DrawData& drawData = batch[model->uniqueId];
+		drawData.model = model;
+		drawData.exists = true;
 
-		uint32_t instanceCount = (uint32_t)drawData.transforms.size();
-		uint64_t id = getUniqueId(drawData.model->uniqueId, instanceCount);
-		auto& it = this->drawBatch[imageIndex].find(id);
-		if (it == this->drawBatch[imageIndex].end())
-		{
-			// Create buffer for transformations.
-			drawData.transformsBuffer.init(sizeof(glm::mat4) * (uint64_t)instanceCount);
-			this->drawBatch[imageIndex][id] = drawData;
-			this->drawBatch[imageIndex][id].descriptorSet = VK_NULL_HANDLE;
-			this->drawBatch[imageIndex][id].exists = true;
-
-			// Tell renderer to recreate descriptors before rendering.
-			this->shouldRecreateDescriptors[imageIndex] = true;
-		}
-		else
-		{
-			it->second.exists = true;
-			it->second.model = drawData.model;
-			memcpy(it->second.transforms.data(), drawData.transforms.data(), sizeof(drawData.transforms));
-		}
+		// Tell renderer to create descriptors for the nodes and materials of the model before rendering.
+		this->shouldRecreateDescriptors[imageIndex] = true;
+		return &drawData;
 	}
-}
+
+	// The number of instances can change without any descriptor work.
+	it->second.exists = true;
+	it->second.model = model;
+	return &it->second;
+}
\ No newline at end of file
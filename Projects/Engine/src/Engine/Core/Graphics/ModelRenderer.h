@@ -10,9 +10,17 @@
 #include "Engine/Core/Vulkan/Pipeline/DescriptorLayout.h"
 #include "Engine/Core/Vulkan/Pipeline/DescriptorPool.h"
 #include "Engine/Core/Vulkan/Buffers/UniformBuffer.h"
-#include "Engine/Core/Vulkan/Buffers/StorageBuffer.h"
+#include "Engine/Core/Vulkan/Buffers/RingBuffer.h"
 #include "Engine/Core/Camera.h"
 #include "Engine/Core/Graphics/RenderInheritanceData.h"
+#include "Engine/Core/Graphics/GpuCuller.h"
+#include "Engine/Core/Graphics/MaterialTable.h"
+
+#define MIN_DRAWS_PER_CHUNK 32 // Fewer draws than this are not worth recording on another thread.
+#define INSTANCE_BUFFER_START_COUNT 1024 // Number of instance transforms each frame can hold before the buffer needs to grow.
+#define LOD_MAX_PIXEL_ERROR 1.0f // Largest error of a level of detail on the screen, in pixels.
+#define LOD_HYSTERESIS 0.75f // A coarser level than the one of the previous frame needs an error below this fraction of the largest error.
+#define MODEL_NO_INSTANCE_ID UINT32_MAX // Instance without an id, its level of detail is selected without the level of the previous frame.
 
 namespace ym
 {
@@ -41,11 +49,66 @@ namespace ym
 		void drawModel(uint32_t imageIndex, Model* model, const std::vector<glm::mat4>& transforms);
 
 		/*
-			Gather and record draw commands.
+			Draw instanced model. instanceIDs identify the instances from frame to frame for the level of detail selection, they need to
+			be unique among the instances drawn in a frame and small, the level of the previous frame is stored at each id.
+		*/
+		void drawModel(uint32_t imageIndex, Model* model, const glm::mat4* transforms, uint32_t count, const uint32_t* instanceIDs = nullptr);
+
+		/*
+			Set the planes which the instances are culled against when culling on the GPU. Needs to be set before end.
+		*/
+		void setFrustum(const std::vector<Camera::Plane>& planes);
+
+		/*
+			Cull the instances hidden behind the depth pyramid when culling on the GPU, see GpuCuller::setOcclusion. Needs to be set
+			before end, a null pyramid turns it off.
+		*/
+		void setOcclusion(const DepthPyramid* depthPyramid, const glm::mat4& viewProjection);
+
+		/*
+			Set the camera which the levels of detail are selected for. projectionScale converts a size at distance one into pixels,
+			proj[1][1] * height / 2. Needs to be set before end.
+		*/
+		void setLodView(const glm::vec3& cameraPosition, float projectionScale);
+
+		/*
+			Level of detail of an instance, the coarsest level whose error projects to at most LOD_MAX_PIXEL_ERROR pixels. Going to a
+			coarser level than previousLod needs the error to be below LOD_HYSTERESIS of that, so instances do not switch back and forth
+			at the boundary.
+		*/
+		static uint32_t selectLod(const Model& model, const glm::mat4& transform, const glm::vec3& cameraPosition, float projectionScale, uint32_t previousLod);
+
+		/*
+			Gather and record draw commands. The draws are split into chunks which are recorded in parallel.
 		*/
 		void end(uint32_t imageIndex);
 
-		std::vector<CommandBuffer*>& getBuffers();
+		/*
+			Record the GPU culling of this frame, outside of the render pass which executes the buffers from getBuffers.
+		*/
+		void recordCulling(CommandBuffer* cmdBuffer);
+
+		/*
+			Number of descriptors which were written by the last end.
+		*/
+		uint32_t getDescriptorWriteCount() const { return this->descriptorWriteCount; }
+
+		/*
+			Number of triangles submitted by the last end, before any GPU culling.
+		*/
+		uint64_t getTriangleCount() const { return this->triangleCount; }
+
+		bool isBindlessMaterials() const { return this->bindlessMaterials; }
+		bool isPackedVertices() const { return this->packedVertices; }
+		bool isGpuCulling() const { return this->gpuCulling; }
+		bool isOcclusionCulling() const { return this->occlusionCulling; }
+		bool isLodSelection() const { return this->lodSelection; }
+		const GpuCuller& getGpuCuller() const { return this->gpuCuller; }
+
+		/*
+			Secondary command buffers recorded this frame, they should be executed in this order.
+		*/
+		const std::vector<VkCommandBuffer>& getBuffers(uint32_t imageIndex) const;
 
 	private:
 		struct DrawData
@@ -53,28 +116,48 @@ namespace ym
 			bool exists{false}; // This is false when a model was removed. Will ensure that we do not recreate the descriptor pool if removing models only when adding.
 			Model* model{ nullptr };
 
-			// Instance data
+			// Instance data, the transforms are written to the instance buffer starting at firstInstance, sorted by their level of detail.
 			std::vector<glm::mat4> transforms;
-			StorageBuffer transformsBuffer;
-			VkDescriptorSet descriptorSet;
+			std::vector<uint32_t> instanceIDs; // Same size as the transforms.
+			uint32_t firstInstance{ 0 };
+			std::array<uint32_t, MODEL_MAX_LODS> lodFirstInstance{};
+			std::array<uint32_t, MODEL_MAX_LODS> lodInstanceCount{};
+			std::array<uint32_t, MODEL_MAX_LODS> groups{}; // Group in the GPU culler of each level of detail.
 		};
 
-		void recordModel(Model* model, uint32_t imageIndex, VkDescriptorSet instanceDescriptorSet, uint32_t instanceCount, CommandBuffer* cmdBuffer);
-		void drawNode(uint32_t imageIndex, VkDescriptorSet instanceDescriptorSet, CommandBuffer* commandBuffer, Pipeline* pipeline, Model::Node& node, uint32_t instanceCount);
+		// One draw call of a primitive with all of its instances.
+		struct DrawCommand
+		{
+			Model* model{ nullptr };
+			Model::Node* node{ nullptr };
+			Primitive* primitive{ nullptr };
+			uint32_t firstInstance{ 0 };
+			uint32_t instanceCount{ 0 };
+			uint32_t lod{ 0 };
+			uint32_t indirectBatch{ 0 }; // Batch in the GPU culler with the levels of detail, only used when culling on the GPU.
+		};
+
+		void collectDrawCommands(DrawData& drawData, Model::Node& node);
+		void recordDrawCommands(uint32_t imageIndex, uint32_t first, uint32_t last, CommandBuffer* cmdBuffer);
 		
+		void uploadInstanceData(uint32_t imageIndex);
+		void createInstanceDescriptorSet();
+
+		void createPipeline(Pipeline& pipeline, Shader& shader, VertexFormat format, RenderPass* renderPass);
+		Pipeline* getPipeline(VertexFormat format);
+
 		void createDescriptorLayouts();
-		void recreateDescriptorPool(uint32_t imageIndex, uint32_t materialCount, uint32_t nodeCount, uint32_t modelCount);
-		void createDescriptorsSets(uint32_t imageIndex, std::map<uint64_t, DrawData>& drawBatch);
+		void recreateDescriptorPool(uint32_t imageIndex, uint32_t materialCount, uint32_t nodeCount);
+		void createDescriptorsSets(uint32_t imageIndex, std::map<uint32_t, DrawData>& drawBatch);
 		void createNodeDescriptorsSets(uint32_t imageIndex, Model::Node& node);
 
-		uint64_t getUniqueId(uint32_t modelId, uint32_t instanceCount);
-		void addModelToBatch(uint32_t imageIndex, DrawData& drawData);
+		DrawData* getDrawData(uint32_t imageIndex, Model* model);
 
 	private:
 		SwapChain* swapChain;
 
 		std::vector<bool> shouldRecreateDescriptors;
-		std::vector<std::map<uint64_t, DrawData>> drawBatch;
+		std::vector<std::map<uint32_t, DrawData>> drawBatch; // Per image, keyed by the unique id of the model.
 		VkCommandBufferInheritanceInfo inheritanceInfo;
 
 		// Descriptors
@@ -87,11 +170,46 @@ namespace ym
 		} descriptorSetLayouts;
 		RenderInheritanceData* renderInheritanceData;
 
-		// Thread data
-		std::vector<CommandBuffer*> commandBuffers;
-		CommandPool commandPool;
+		// Instance transforms of all models, one region for each image.
+		RingBuffer instanceBuffer;
+		DescriptorPool instanceDescriptorPool;
+		VkDescriptorSet instanceDescriptorSet;
+
+		// GPU culling, the draws read their instance count from the indirect buffer and their transforms from the culled transforms.
+		bool gpuCulling;
+		bool occlusionCulling;
+		GpuCuller gpuCuller;
+		std::vector<Camera::Plane> frustumPlanes;
+
+		// Levels of detail, selected for each instance when the instance data is uploaded. The level of the previous frame is kept
+		// at the id of the instance, together with the model it was selected for.
+		struct PreviousLod
+		{
+			uint32_t model{ 0 };
+			uint32_t lod{ MODEL_MAX_LODS };
+		};
+		bool lodSelection;
+		glm::vec3 lodCameraPosition;
+		float lodProjectionScale;
+		std::vector<PreviousLod> previousLods;
+		std::vector<uint8_t> instanceLods;
+		uint64_t triangleCount;
+
+		// Bindless materials, every draw uses the same material set and selects its material with a push constant.
+		bool bindlessMaterials;
+		MaterialTable materialTable;
+		uint32_t descriptorWriteCount;
+
+		// Recording
+		std::vector<DrawCommand> drawCommands;
+		std::vector<std::vector<VkCommandBuffer>> recordedBuffers; // Per image, one for each chunk.
 		uint32_t threadID;
 		Pipeline pipeline;
 		Shader shader;
+
+		// Models with packed vertices are drawn with their own pipeline, after the models with full vertices.
+		bool packedVertices;
+		Pipeline packedPipeline;
+		Shader packedShader;
 	};
 }
\ No newline at end of file
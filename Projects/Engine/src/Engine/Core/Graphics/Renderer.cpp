@@ -4,15 +4,18 @@
 #include "../Input/Config.h"
 #include "Engine/Core/Vulkan/Factory.h"
 #include "Engine/Core/Scene/GLTFLoader.h"
+#include "Engine/Core/Scene/Model/GeometryArena.h"
 #include "Engine/Core/Application/LayerManager.h"
-#include "Engine/Core/Threading/ThreadManager.h"
+#include "Engine/Core/Threading/JobSystem.h"
 #include "Engine/Core/Vulkan/Pipeline/DescriptorSet.h"
 #include "Engine/Core/Scene/ObjectManager.h"
 #include "Engine/Core/Scene/GameObject.h"
+#include "Engine/Core/ECS/Ecs.h"
+#include "Engine/Core/ECS/Components.h"
 
 #include "Engine/Core/Graphics/IBLFunctions.h"
-
-#include <glTF/stb_image.h>
+#include "Engine/Core/Graphics/IBLCache.h"
+#include "Utils/Timer.h"
 
 ym::Renderer::Renderer()
 {
@@ -31,6 +34,8 @@ void ym::Renderer::init()
 	int width = Config::get()->fetch<int>("Display/defaultWidth");
 	int height = Config::get()->fetch<int>("Display/defaultHeight");
 	this->swapChain.init(width, height);
+	this->shIrradiance = Config::get()->fetch<bool>("Graphics/shIrradiance");
+	this->frustumCulling = Config::get()->fetch<bool>("Graphics/frustumCulling");
 
 	createDepthTexture();
 	createRenderPass();
@@ -38,13 +43,23 @@ void ym::Renderer::init()
 
 	initInheritenceData();
 
-	// Each renderer has a corresponding thread.
-	this->modelRenderer.init(&this->swapChain, (uint32_t)ERendererType::RENDER_TYPE_MODEL, &this->renderPass, &this->renderInheritanceData); // Uses thread 0.
+	// Each renderer records its own secondary command buffers, the recording is done on the job system.
+	this->modelRenderer.init(&this->swapChain, (uint32_t)ERendererType::RENDER_TYPE_MODEL, &this->renderPass, &this->renderInheritanceData);
+
+	// The model renderer turns the occlusion culling off when the device or the shaders do not support it.
+	this->occlusionCulling = this->modelRenderer.isOcclusionCulling();
+	if (this->occlusionCulling)
+	{
+		this->depthPyramid.init(this->swapChain.getExtent().width, this->swapChain.getExtent().height);
+		this->depthPyramid.setDepth(this->depthTexture->imageView.getImageView(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+	}
 
-	this->cubeMapRenderer.init(&this->swapChain, (uint32_t)ERendererType::RENDER_TYPE_CUBE_MAP, &this->renderPass, &this->renderInheritanceData); // Uses thread 1
+	this->cubeMapRenderer.init(&this->swapChain, (uint32_t)ERendererType::RENDER_TYPE_CUBE_MAP, &this->renderPass, &this->renderInheritanceData);
 
-	//this->terrainRenderer.init(&this->swapChain, (uint32_t)ERendererType::RENDER_TYPE_TERRAIN, &this->renderPass, &this->sceneDescriptors); // Uses thread 2. (Will not work, 2 is occupied by GLTFLoader)
+	this->terrainRenderer.init(&this->swapChain, (uint32_t)ERendererType::RENDER_TYPE_TERRAIN, &this->renderPass, &this->renderInheritanceData);
 
+	// The geometry of all models is uploaded to the arena.
+	GeometryArena::get()->init();
 	GLTFLoader::init();
 
 	createSyncObjects();
@@ -52,7 +67,7 @@ void ym::Renderer::init()
 	CommandPool& graphicsPool = LayerManager::get()->getCommandPools()->graphicsPool;
 	this->primaryCommandBuffersGraphics = graphicsPool.createCommandBuffers(this->swapChain.getNumImages(), VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 	CommandPool& computePool = LayerManager::get()->getCommandPools()->computePool;
-	//this->primaryCommandBuffersCompute = computePool.createCommandBuffers(this->swapChain.getNumImages(), VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	this->primaryCommandBuffersCompute = computePool.createCommandBuffers(this->swapChain.getNumImages(), VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
 	// Initialize debug gui.
 	this->imgui.init(&this->swapChain);
@@ -61,19 +76,21 @@ void ym::Renderer::init()
 void ym::Renderer::preDestroy()
 {
 	vkDeviceWaitIdle(VulkanInstance::get()->getLogicalDevice());
-	ThreadManager::destroy();
+	JobSystem::destroy();
 }
 
 void ym::Renderer::destroy()
 {
 	GLTFLoader::destroy();
+	GeometryArena::get()->destroy();
 
 	// Destroy environment maps and their smaplers.
 	this->environmentMap->destroy();
 	SAFE_DELETE(this->environmentMap);
 	this->prefilteredEnvironmentMap->destroy();
 	SAFE_DELETE(this->prefilteredEnvironmentMap);
-	this->irradianceMap->destroy();
+	if (this->irradianceMap)
+		this->irradianceMap->destroy();
 	SAFE_DELETE(this->irradianceMap);
 	this->brdfLutTexture->destroy();
 	SAFE_DELETE(this->brdfLutTexture);
@@ -87,7 +104,9 @@ void ym::Renderer::destroy()
 	// Destroy sub-renderers.
 	this->modelRenderer.destroy();
 	this->cubeMapRenderer.destroy();
-	//this->terrainRenderer.destroy();
+	this->terrainRenderer.destroy();
+	if (this->occlusionCulling)
+		this->depthPyramid.destroy();
 
 	// Destroy scene data.
 	for (UniformBuffer& ubo : this->sceneUBOs)
@@ -108,7 +127,6 @@ void ym::Renderer::destroy()
 void ym::Renderer::setActiveCamera(Camera* camera)
 {
 	this->activeCamera = camera;
-	//this->terrainRenderer.setActiveCamera(camera);
 }
 
 ym::Texture* ym::Renderer::getDefaultEnvironmentMap()
@@ -116,6 +134,11 @@ ym::Texture* ym::Renderer::getDefaultEnvironmentMap()
 	return this->environmentMap;
 }
 
+const ym::SH9& ym::Renderer::getIrradianceSH() const
+{
+	return this->irradianceSH;
+}
+
 void ym::Renderer::setScreenData(float screenExposure, float screenGamma)
 {
 	this->screenData[0] = screenExposure;
@@ -158,7 +181,7 @@ bool ym::Renderer::begin()
 
 	this->modelRenderer.begin(this->imageIndex, this->inheritanceInfo);
 	this->cubeMapRenderer.begin(this->imageIndex, this->inheritanceInfo);
-	//this->terrainRenderer.begin(this->imageIndex, this->inheritanceInfo);
+	this->terrainRenderer.begin(this->imageIndex, this->inheritanceInfo);
 
 	return true;
 }
@@ -182,6 +205,32 @@ void ym::Renderer::drawModel(Model* model, const std::vector<glm::mat4>& transfo
 void ym::Renderer::drawAllModels(ObjectManager* objectManager)
 {
 	auto& gameObjects = objectManager->getGameObjects();
+	const bool cull = this->frustumCulling && this->modelRenderer.isGpuCulling() == false && this->activeCamera != nullptr;
+	if (cull)
+	{
+		// All objects are added in the same order as they are drawn below, the index of an object is its position in that order.
+		Timer timer;
+		this->frustumCuller.begin(this->activeCamera->getPlanes());
+		for (auto& batch : gameObjects)
+		{
+			auto& objs = batch.second;
+			if (objs.empty())
+				continue;
+			Model* model = objs[0]->getModel();
+			const Bounds bounds = model->hasLoaded ? model->bounds : Bounds();
+			for (GameObject* obj : objs)
+				this->frustumCuller.add(obj->getTransform(), bounds);
+		}
+		this->frustumCuller.cull();
+		this->cullStats.instances = this->frustumCuller.getCount();
+		this->cullStats.visible = this->frustumCuller.getVisibleCount();
+		this->cullStats.cullMs = timer.stop() * 1000.f;
+	}
+
+	// The id of an object keeps its level of detail from frame to frame.
+	uint32_t index = 0;
+	std::vector<glm::mat4> transforms;
+	std::vector<uint32_t> ids;
 	for (auto& batch : gameObjects)
 	{
 		auto& objs = batch.second;
@@ -189,14 +238,120 @@ void ym::Renderer::drawAllModels(ObjectManager* objectManager)
 		if (size > 0)
 		{
 			Model* model = objs[0]->getModel();
-			std::vector<glm::mat4> transforms(objs.size());
-			for (uint32_t i = 0; i < size; i++)
-				transforms[i] = objs[i]->getTransform();
-			drawModel(model, transforms);
+			transforms.clear();
+			ids.clear();
+			for (uint32_t i = 0; i < size; i++, index++)
+			{
+				if (cull == false || this->frustumCuller.isVisible(index))
+				{
+					transforms.push_back(objs[i]->getTransform());
+					ids.push_back(objs[i]->getID());
+				}
+			}
+			if (transforms.empty() == false)
+				this->modelRenderer.drawModel(this->imageIndex, model, transforms.data(), (uint32_t)transforms.size(), ids.data());
 		}
 	}
 }
 
+void ym::Renderer::drawAllModels(ECS* ecs)
+{
+	EntityQuery query;
+	query.withAll<Transform, ModelRef>();
+
+	const bool cull = this->frustumCulling && this->modelRenderer.isGpuCulling() == false && this->activeCamera != nullptr;
+	if (cull)
+	{
+		// The chunks are visited in the same order below, the index of an entity is its position in that order.
+		Timer timer;
+		this->frustumCuller.begin(this->activeCamera->getPlanes());
+		ecs->forEachChunk(query, [this](Chunk& chunk) {
+			const Transform* transforms = chunk.get<Transform>();
+			const ModelRef* models = chunk.get<ModelRef>();
+			const uint32_t count = chunk.getCount();
+			for (uint32_t i = 0; i < count; i++)
+			{
+				Model* model = models[i].model;
+				this->frustumCuller.add(transforms[i].matrix, (model != nullptr && model->hasLoaded) ? model->bounds : Bounds());
+			}
+		});
+		this->frustumCuller.cull();
+		this->cullStats.instances = this->frustumCuller.getCount();
+		this->cullStats.visible = this->frustumCuller.getVisibleCount();
+		this->cullStats.cullMs = timer.stop() * 1000.f;
+	}
+
+	// The transforms are copied straight from the chunks. Entities of the same model are often next to each other, each run of visible
+	// entities is added with one call. The index of an entity keeps its level of detail from frame to frame.
+	uint32_t index = 0;
+	std::vector<uint32_t> ids;
+	ecs->forEachChunk(query, [this, cull, &index, &ids](Chunk& chunk) {
+		const Transform* transforms = chunk.get<Transform>();
+		const ModelRef* models = chunk.get<ModelRef>();
+		const Entity* entities = chunk.getEntities();
+		const uint32_t count = chunk.getCount();
+		const uint32_t chunkIndex = index;
+		index += count;
+		auto isVisible = [&](uint32_t i) { return cull == false || this->frustumCuller.isVisible(chunkIndex + i); };
+
+		uint32_t first = 0;
+		for (uint32_t i = 1; i <= count; i++)
+		{
+			if (i == count || models[i].model != models[first].model || isVisible(i) != isVisible(first))
+			{
+				if (models[first].model != nullptr && isVisible(first))
+				{
+					ids.clear();
+					for (uint32_t e = first; e < i; e++)
+						ids.push_back(entities[e].index);
+					this->modelRenderer.drawModel(this->imageIndex, models[first].model, &transforms[first].matrix, i - first, ids.data());
+				}
+				first = i;
+			}
+		}
+	});
+}
+
+void ym::Renderer::setFrustumCulling(bool enabled)
+{
+	this->frustumCulling = enabled;
+}
+
+bool ym::Renderer::isFrustumCulling() const
+{
+	return this->frustumCulling;
+}
+
+const ym::Renderer::CullStats& ym::Renderer::getCullStats() const
+{
+	return this->cullStats;
+}
+
+uint32_t ym::Renderer::getDescriptorWriteCount() const
+{
+	return this->modelRenderer.getDescriptorWriteCount();
+}
+
+uint64_t ym::Renderer::getTriangleCount() const
+{
+	return this->modelRenderer.getTriangleCount();
+}
+
+const ym::TerrainRenderer::Stats& ym::Renderer::getTerrainStats() const
+{
+	return this->terrainRenderer.getStats();
+}
+
+void ym::Renderer::drawTerrainStats()
+{
+	this->terrainRenderer.drawStats();
+}
+
+bool ym::Renderer::isBindlessMaterials() const
+{
+	return this->modelRenderer.isBindlessMaterials();
+}
+
 void ym::Renderer::drawSkybox(Texture* texture)
 {
 	this->cubeMapRenderer.drawSkybox(this->imageIndex, texture);
@@ -214,8 +369,7 @@ void ym::Renderer::drawCubeMap(CubeMap* cubeMap, const std::vector<glm::mat4>& t
 
 void ym::Renderer::drawTerrain(Terrain* terrain, const glm::mat4& transform)
 {
-	YM_LOG_WARN("drawTerrain() is not implemented!");
-	//this->terrainRenderer.drawTerrain(this->imageIndex, terrain, transform);
+	this->terrainRenderer.drawTerrain(this->imageIndex, terrain, transform);
 }
 
 bool ym::Renderer::end()
@@ -226,12 +380,29 @@ bool ym::Renderer::end()
 	sceneData.view = this->activeCamera->getView();
 	sceneData.cPos = this->activeCamera->getPosition();
 	sceneData.screenData = glm::vec2(this->screenData[0], this->screenData[1]);
+	sceneData.irradianceSH = this->irradianceSH;
 	this->sceneUBOs[imageIndex].transfer(&sceneData, sizeof(SceneData), 0);
 
-	// End renderers.
+	// End renderers. When culling on the GPU, the results of a frame are known when the same image is used again.
+	this->modelRenderer.setFrustum(this->activeCamera->getPlanes());
+	this->modelRenderer.setLodView(sceneData.cPos, std::abs(sceneData.proj[1][1]) * (float)this->swapChain.getExtent().height * 0.5f);
+	if (this->occlusionCulling)
+		this->modelRenderer.setOcclusion(this->depthPyramidBuilt ? &this->depthPyramid : nullptr, this->depthPyramidViewProjection);
 	this->modelRenderer.end(this->imageIndex);
+	if (this->modelRenderer.isGpuCulling())
+	{
+		const GpuCuller& gpuCuller = this->modelRenderer.getGpuCuller();
+		this->cullStats.instances = gpuCuller.getLastInstanceCount();
+		this->cullStats.visible = gpuCuller.getLastVisibleCount();
+		this->cullStats.cullMs = 0.f;
+		this->cullStats.occlusionTested = gpuCuller.getLastTestedCount();
+		this->cullStats.occluded = gpuCuller.getLastOccludedCount();
+		this->cullStats.commands = gpuCuller.getLastCommandCount();
+		this->cullStats.draws = gpuCuller.getLastDrawCount();
+	}
 	this->cubeMapRenderer.end(this->imageIndex);
-	//this->terrainRenderer.end(this->imageIndex);
+	this->terrainRenderer.setView(sceneData.cPos, this->activeCamera->getPlanes());
+	this->terrainRenderer.end(this->imageIndex);
 
 	// Render debug GUI
 	this->imgui.end();
@@ -240,6 +411,13 @@ bool ym::Renderer::end()
 	// Submit all work.
 	submit();
 
+	// The next frame is culled against the depth of this one.
+	if (this->occlusionCulling)
+	{
+		this->depthPyramidBuilt = true;
+		this->depthPyramidViewProjection = sceneData.proj * sceneData.view;
+	}
+
 	// Present new frame.
 	VkSemaphore waitSemaphores[] = { this->renderFinishedSemaphores[this->currentFrame] };
 	VkSwapchainKHR swapchain = this->swapChain.getSwapChain();
@@ -271,7 +449,11 @@ void ym::Renderer::createDepthTexture()
 	textureDesc.height = this->swapChain.getExtent().height;
 	textureDesc.format = findDepthFormat(VulkanInstance::get()->getPhysicalDevice());
 	textureDesc.data = nullptr;
-	this->depthTexture = ym::Factory::createTexture(textureDesc, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_QUEUE_GRAPHICS_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+	// The depth pyramid samples the depth of the frame after its render pass.
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	if (this->occlusionCulling)
+		usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+	this->depthTexture = ym::Factory::createTexture(textureDesc, usage, VK_QUEUE_GRAPHICS_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 
 	// Transistion image
 	Image::TransistionDesc desc;
@@ -285,7 +467,22 @@ void ym::Renderer::createDepthTexture()
 void ym::Renderer::createRenderPass()
 {
 	this->renderPass.addDefaultColorAttachment(this->swapChain.getImageFormat());
-	this->renderPass.addDefaultDepthAttachment();
+	if (this->occlusionCulling)
+	{
+		// The depth is kept for the depth pyramid, which reads it after the render pass.
+		VkAttachmentDescription depthAttachment = {};
+		depthAttachment.format = findDepthFormat(VulkanInstance::get()->getPhysicalDevice());
+		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		this->renderPass.addDepthAttachment(depthAttachment);
+	}
+	else
+		this->renderPass.addDefaultDepthAttachment();
 
 	RenderPass::SubpassInfo subpassInfo;
 	subpassInfo.colorAttachmentIndices = { 0 }; // One color attachment
@@ -300,6 +497,24 @@ void ym::Renderer::createRenderPass()
 	subpassDependency.srcAccessMask = 0;
 	subpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 	this->renderPass.addSubpassDependency(subpassDependency);
+	if (this->occlusionCulling)
+	{
+		// The depth is cleared after the depth pyramid of the frame before has read it.
+		subpassDependency.srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		subpassDependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		subpassDependency.srcAccessMask = 0;
+		subpassDependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		this->renderPass.addSubpassDependency(subpassDependency);
+
+		// The depth pyramid reads the depth after the render pass.
+		subpassDependency.srcSubpass = 0;
+		subpassDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+		subpassDependency.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		subpassDependency.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		subpassDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		subpassDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		this->renderPass.addSubpassDependency(subpassDependency);
+	}
 	this->renderPass.init();
 }
 
@@ -320,7 +535,7 @@ void ym::Renderer::createSyncObjects()
 	this->framesInFlight = this->swapChain.getNumImages()-1;
 	this->imageAvailableSemaphores.resize(this->framesInFlight);
 	this->renderFinishedSemaphores.resize(this->framesInFlight);
-	//this->computeSemaphores.resize(this->framesInFlight);
+	this->computeSemaphores.resize(this->framesInFlight);
 	this->inFlightFences.resize(this->framesInFlight);
 	this->imagesInFlight.resize(this->swapChain.getNumImages(), VK_NULL_HANDLE);
 
@@ -333,7 +548,7 @@ void ym::Renderer::createSyncObjects()
 	for (uint32_t i = 0; i < this->framesInFlight; i++) {
 		VULKAN_CHECK(vkCreateSemaphore(VulkanInstance::get()->getLogicalDevice(), &SemaCreateInfo, nullptr, &this->imageAvailableSemaphores[i]), "Failed to create image available semaphores");
 		VULKAN_CHECK(vkCreateSemaphore(VulkanInstance::get()->getLogicalDevice(), &SemaCreateInfo, nullptr, &this->renderFinishedSemaphores[i]), "Failed to create render finished semaphores");
-		//VULKAN_CHECK(vkCreateSemaphore(VulkanInstance::get()->getLogicalDevice(), &SemaCreateInfo, nullptr, &this->computeSemaphores[i]), "Failed to create compute semaphores");
+		VULKAN_CHECK(vkCreateSemaphore(VulkanInstance::get()->getLogicalDevice(), &SemaCreateInfo, nullptr, &this->computeSemaphores[i]), "Failed to create compute semaphores");
 		VULKAN_CHECK(vkCreateFence(VulkanInstance::get()->getLogicalDevice(), &fenceCreateInfo, nullptr, &this->inFlightFences[i]), "Failed to create in flight fences");
 	}
 }
@@ -343,7 +558,7 @@ void ym::Renderer::destroySyncObjects()
 	for (uint32_t i = 0; i < this->framesInFlight; i++) {
 		vkDestroySemaphore(VulkanInstance::get()->getLogicalDevice(), this->imageAvailableSemaphores[i], nullptr);
 		vkDestroySemaphore(VulkanInstance::get()->getLogicalDevice(), this->renderFinishedSemaphores[i], nullptr);
-		//vkDestroySemaphore(VulkanInstance::get()->getLogicalDevice(), this->computeSemaphores[i], nullptr);
+		vkDestroySemaphore(VulkanInstance::get()->getLogicalDevice(), this->computeSemaphores[i], nullptr);
 		vkDestroyFence(VulkanInstance::get()->getLogicalDevice(), this->inFlightFences[i], nullptr);
 	}
 }
@@ -352,50 +567,40 @@ void ym::Renderer::submit()
 {
 	VulkanInstance* instance = VulkanInstance::get();
 	// Compute
-	/*{
-		// Gather all secondary buffers.
-		std::vector<CommandBuffer*>& secondaryBuffers = this->terrainRenderer.getComputeBuffers();
-		std::vector<VkCommandBuffer> vkCommands;
-		vkCommands.push_back(secondaryBuffers[this->imageIndex]->getCommandBuffer());
-
+	const bool terrainCulling = this->terrainRenderer.isCulling();
+	if (terrainCulling)
+	{
 		CommandBuffer* buffer = this->primaryCommandBuffersCompute[this->imageIndex];
-		{
-			buffer->begin(0, nullptr);
-
-			this->terrainRenderer.preRecordCompute(this->imageIndex, buffer);
-			buffer->cmdExecuteCommands((uint32_t)vkCommands.size(), vkCommands.data());
-			this->terrainRenderer.postRecordCompute(this->imageIndex, buffer);
+		buffer->begin(0, nullptr);
+		this->terrainRenderer.recordCulling(buffer);
+		buffer->end();
 
-			buffer->end();
-		}
-
-		// Submit commands to GPU.
-		VkSubmitInfo computeSubmitInfo = { };
+		// Runs on the compute queue while the graphics queue finishes the previous frame.
+		std::vector<VkCommandBuffer> buffers = { buffer->getCommandBuffer() };
+		VkSubmitInfo computeSubmitInfo = {};
 		computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		std::vector<VkPipelineStageFlags> waitStages;
-		std::vector<VkSemaphore> waitSemaphores;
-		computeSubmitInfo.waitSemaphoreCount = waitSemaphores.size();
-		computeSubmitInfo.pWaitSemaphores = waitSemaphores.data();
-		computeSubmitInfo.pWaitDstStageMask = waitStages.data();
-
-		std::array<VkCommandBuffer, 1> buff = { buffer->getCommandBuffer() };
-		computeSubmitInfo.commandBufferCount = buff.size();
-		computeSubmitInfo.pCommandBuffers = buff.data();
+		computeSubmitInfo.waitSemaphoreCount = 0;
+		computeSubmitInfo.commandBufferCount = (uint32_t)buffers.size();
+		computeSubmitInfo.pCommandBuffers = buffers.data();
 		computeSubmitInfo.signalSemaphoreCount = 1;
 		computeSubmitInfo.pSignalSemaphores = &this->computeSemaphores[this->currentFrame];
 
-		VulkanQueue& computeQueue = instance->getComputeQueue();
+		VulkanQueue computeQueue = instance->getComputeQueue();
 		VULKAN_CHECK(vkQueueSubmit(computeQueue.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE), "Failed to submit compute queue!");
-	}*/
+	}
 
 	// Graphics
 	{
 		// Gather all secondary buffers.
 		std::vector<VkCommandBuffer> vkCommands;
 
-		// Fetch secondary buffers from the ModelRenderer.
-		std::vector<CommandBuffer*>& secondaryBuffersModel = this->modelRenderer.getBuffers();
-		vkCommands.push_back(secondaryBuffersModel[this->imageIndex]->getCommandBuffer());
+		// Fetch secondary buffers from the ModelRenderer, one for each chunk of draws.
+		const std::vector<VkCommandBuffer>& secondaryBuffersModel = this->modelRenderer.getBuffers(this->imageIndex);
+		vkCommands.insert(vkCommands.end(), secondaryBuffersModel.begin(), secondaryBuffersModel.end());
+
+		// Fetch secondary buffers from the TerrainRenderer.
+		std::vector<CommandBuffer*>& secondaryBuffersTerrain = this->terrainRenderer.getBuffers();
+		vkCommands.push_back(secondaryBuffersTerrain[this->imageIndex]->getCommandBuffer());
 
 		// Fetch secondary buffers from the CubeMapRenderer.
 		std::vector<CommandBuffer*>& secondaryBuffersCubeMap = this->cubeMapRenderer.getBuffers();
@@ -406,7 +611,9 @@ void ym::Renderer::submit()
 		{
 			buffer->begin(0, nullptr);
 
-			//this->terrainRenderer.preRecordGraphics(this->imageIndex, buffer);
+			// Compute work and copies can not be recorded in the render pass.
+			this->modelRenderer.recordCulling(buffer);
+			this->terrainRenderer.recordUploads(buffer);
 
 			std::vector<VkClearValue> clearValues = {};
 			VkClearValue value;
@@ -418,20 +625,28 @@ void ym::Renderer::submit()
 			buffer->cmdExecuteCommands((uint32_t)vkCommands.size(), vkCommands.data());
 			buffer->cmdEndRenderPass();
 
-			//this->terrainRenderer.postRecordGraphics(this->imageIndex, buffer);
+			// Reduce the depth of this frame for the occlusion culling of the next one.
+			if (this->occlusionCulling)
+				this->depthPyramid.record(buffer);
 
 			buffer->end();
 		}
 
 		// Submit commands to GPU.
-		const VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT };
+		std::vector<VkPipelineStageFlags> waitStages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 		std::vector<VkSemaphore> waitSemaphores = { this->imageAvailableSemaphores[this->currentFrame] };
+		if (terrainCulling)
+		{
+			// The terrain draws read the indirect commands and nodes written by the culling.
+			waitStages.push_back(VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+			waitSemaphores.push_back(this->computeSemaphores[this->currentFrame]);
+		}
 		VkSemaphore signalSemaphores[] = { this->renderFinishedSemaphores[this->currentFrame] };
 		std::vector<VkCommandBuffer> buffers = { buffer->getCommandBuffer(), this->imgui.getCurrentCommandBuffer() };
 
 		VkSubmitInfo submitInfo = {};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.pWaitDstStageMask = waitStages;
+		submitInfo.pWaitDstStageMask = waitStages.data();
 		submitInfo.waitSemaphoreCount = (uint32_t)waitSemaphores.size();
 		submitInfo.pWaitSemaphores = waitSemaphores.data();
 		submitInfo.signalSemaphoreCount = 1;
@@ -451,8 +666,8 @@ void ym::Renderer::initInheritenceData()
 	createDefaultEnvironmentTextures(hdrPath);
 	setupSceneDescriptors();
 
-	// Create separate command buffers for each thread.
-	this->renderInheritanceData.threadData.resize(ERendererType::RENDER_TYPE_SIZE);
+	// Create separate command buffers for each thread which can record, this is every worker and the main thread.
+	this->renderInheritanceData.threadData.resize(JobSystem::getWorkerCount() + 1);
 	for (uint32_t i = 0; i < this->renderInheritanceData.threadData.size(); i++)
 	{
 		ThreadData& td = this->renderInheritanceData.threadData[i];
@@ -480,7 +695,8 @@ void ym::Renderer::setupSceneDescriptors()
 	this->renderInheritanceData.sceneDescriptors.layout.init();
 
 	this->renderInheritanceData.sceneDescriptors.layoutEnv.add(new IMG(VK_SHADER_STAGE_FRAGMENT_BIT)); // Environment map (Cubemap)
-	this->renderInheritanceData.sceneDescriptors.layoutEnv.add(new IMG(VK_SHADER_STAGE_FRAGMENT_BIT)); // Irradiance map (Cubemap)
+	if (this->shIrradiance == false)
+		this->renderInheritanceData.sceneDescriptors.layoutEnv.add(new IMG(VK_SHADER_STAGE_FRAGMENT_BIT)); // Irradiance map (Cubemap)
 	this->renderInheritanceData.sceneDescriptors.layoutEnv.add(new IMG(VK_SHADER_STAGE_FRAGMENT_BIT)); // Prefiltered environment map (Cubemap)
 	this->renderInheritanceData.sceneDescriptors.layoutEnv.add(new IMG(VK_SHADER_STAGE_FRAGMENT_BIT)); // BRDF LUT texture (2D texture)
 	this->renderInheritanceData.sceneDescriptors.layoutEnv.init();
@@ -507,10 +723,12 @@ void ym::Renderer::setupSceneDescriptors()
 		{ // Environment maps
 			DescriptorSet sceneSet;
 			sceneSet.init(this->renderInheritanceData.sceneDescriptors.layoutEnv, &this->renderInheritanceData.sceneDescriptors.setsEnv[i], &this->descriptorPool);
-			sceneSet.setImageDesc(0, this->environmentMap->descriptor);
-			sceneSet.setImageDesc(1, this->irradianceMap->descriptor);
-			sceneSet.setImageDesc(2, this->prefilteredEnvironmentMap->descriptor);
-			sceneSet.setImageDesc(3, this->brdfLutTexture->descriptor);
+			uint32_t binding = 0;
+			sceneSet.setImageDesc(binding++, this->environmentMap->descriptor);
+			if (this->shIrradiance == false)
+				sceneSet.setImageDesc(binding++, this->irradianceMap->descriptor);
+			sceneSet.setImageDesc(binding++, this->prefilteredEnvironmentMap->descriptor);
+			sceneSet.setImageDesc(binding++, this->brdfLutTexture->descriptor);
 			sceneSet.update();
 		}
 	}
@@ -518,41 +736,70 @@ void ym::Renderer::setupSceneDescriptors()
 
 void ym::Renderer::createDefaultEnvironmentTextures(const std::string& hdrImagePath)
 {
-	int widthHDR = 0, heightHDR = 0, nrComponentsHDR = 0;
-	float* dataHDR = stbi_loadf(hdrImagePath.c_str(), &widthHDR, &heightHDR, &nrComponentsHDR, 4);
-	if (dataHDR)
+	YM_PROFILER_FUNCTION();
+
+	IBLCache::Params params = {};
+	params.environmentSize = IBL_ENVIRONMENT_SIZE;
+	params.environmentMipLevels = IBLFunctions::getMipLevels(IBL_ENVIRONMENT_SIZE);
+	params.irradianceSize = this->shIrradiance ? 0 : IBL_IRRADIANCE_SIZE;
+	params.irradianceMipLevels = this->shIrradiance ? 0 : IBLFunctions::getMipLevels(IBL_IRRADIANCE_SIZE);
+	params.prefilteredSize = IBL_PREFILTERED_SIZE;
+	params.prefilteredMipLevels = IBLFunctions::getMipLevels(IBL_PREFILTERED_SIZE);
+	params.brdfLutSize = IBL_BRDF_LUT_SIZE;
+
+	Timer timer;
+	IBLCache::Textures textures;
+	if (IBLCache::isEnabled() && IBLCache::load(hdrImagePath, params, textures))
 	{
-		ym::TextureDesc textureDesc;
-		textureDesc.width = (uint32_t)widthHDR;
-		textureDesc.height = (uint32_t)heightHDR;
-		textureDesc.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-		textureDesc.data = (void*)dataHDR;
-		ym::Texture* tmpTexture = ym::Factory::createTexture(textureDesc, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_QUEUE_GRAPHICS_BIT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
-		ym::CommandPools* commandPools = ym::LayerManager::get()->getCommandPools();
-		ym::Factory::transferData(tmpTexture, &commandPools->graphicsPool);
-		stbi_image_free(dataHDR);
-
-		this->environmentMap = IBLFunctions::convertEquirectangularToCubemap(512, tmpTexture, 0);
-		this->environmentSampler.init(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, this->environmentMap->image.getMipLevels());
-		tmpTexture->destroy();
-		SAFE_DELETE(tmpTexture);
-
-		auto irrAndPref = IBLFunctions::createIrradianceAndPrefilteredMap(this->environmentMap);
-		this->irradianceMap = irrAndPref.first;
-		this->prefilteredEnvironmentMap = irrAndPref.second;
-		this->irradianceSampler.init(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, this->irradianceMap->image.getMipLevels());
-		this->prefilteredSampler.init(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, this->prefilteredEnvironmentMap->image.getMipLevels());
+		YM_LOG_INFO("Loaded IBL textures from cache in {:.2f} ms", timer.stop() * 1000.f);
+	}
+	else
+	{
+		Texture* hdrTexture = IBLFunctions::loadEquirectangularTexture(hdrImagePath);
+		if (hdrTexture == nullptr)
+		{
+			YM_LOG_WARN("Could not load HDR! Path: {}", hdrImagePath.c_str());
+			return;
+		}
 
-		this->brdfLutTexture = IBLFunctions::createBRDFLutTexture(512);
-		this->brdfLutSampler.init(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, this->brdfLutTexture->image.getMipLevels());
+		textures.environment = IBLFunctions::convertEquirectangularToCubemap(IBL_ENVIRONMENT_SIZE, hdrTexture, params.environmentMipLevels);
+		hdrTexture->destroy();
+		SAFE_DELETE(hdrTexture);
 
-		ym::Factory::applyTextureDescriptor(this->irradianceMap, &this->irradianceSampler);
-		ym::Factory::applyTextureDescriptor(this->prefilteredEnvironmentMap, &this->prefilteredSampler);
-		ym::Factory::applyTextureDescriptor(this->environmentMap, &this->environmentSampler);
-		ym::Factory::applyTextureDescriptor(this->brdfLutTexture, &this->brdfLutSampler);
+		auto irrAndPref = IBLFunctions::createIrradianceAndPrefilteredMap(textures.environment, this->shIrradiance == false);
+		textures.irradiance = irrAndPref.first;
+		textures.prefiltered = irrAndPref.second;
+		textures.brdfLut = IBLFunctions::createBRDFLutTexture(IBL_BRDF_LUT_SIZE);
+		YM_LOG_INFO("Generated IBL textures in {:.2f} ms", timer.stop() * 1000.f);
+
+		if (IBLCache::isEnabled())
+			IBLCache::bake(hdrImagePath, params, textures);
+	}
+
+	this->environmentMap = textures.environment;
+	this->irradianceMap = textures.irradiance;
+	this->prefilteredEnvironmentMap = textures.prefiltered;
+	this->brdfLutTexture = textures.brdfLut;
+	this->environmentSampler.init(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, this->environmentMap->image.getMipLevels());
+	this->prefilteredSampler.init(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, this->prefilteredEnvironmentMap->image.getMipLevels());
+	this->brdfLutSampler.init(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, this->brdfLutTexture->image.getMipLevels());
+
+	ym::Factory::applyTextureDescriptor(this->prefilteredEnvironmentMap, &this->prefilteredSampler);
+	ym::Factory::applyTextureDescriptor(this->environmentMap, &this->environmentSampler);
+	ym::Factory::applyTextureDescriptor(this->brdfLutTexture, &this->brdfLutSampler);
+
+	if (this->shIrradiance)
+	{
+		// Project a small mip level of the environment, the irradiance has no high frequencies.
+		Timer shTimer;
+		const uint32_t mipLevel = params.environmentMipLevels - IBLFunctions::getMipLevels(SH_PROJECTION_SIZE);
+		std::vector<float> faces = IBLFunctions::readCubeMap(this->environmentMap, mipLevel);
+		this->irradianceSH = SphericalHarmonics::projectCubeMap(faces.data(), SH_PROJECTION_SIZE);
+		YM_LOG_INFO("Projected irradiance to spherical harmonics in {:.2f} ms", shTimer.stop() * 1000.f);
 	}
 	else
 	{
-		YM_LOG_WARN("Could not load HDR! Path: {}", hdrImagePath.c_str());
+		this->irradianceSampler.init(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, this->irradianceMap->image.getMipLevels());
+		ym::Factory::applyTextureDescriptor(this->irradianceMap, &this->irradianceSampler);
 	}
 }
@@ -11,10 +11,13 @@
 #include "Engine/Core/Camera.h"
 #include "Engine/Core/Graphics/RenderInheritanceData.h"
 #include "Engine/Core/Graphics/ImGUI/VKImgui.h"
+#include "Engine/Core/Graphics/FrustumCuller.h"
+#include "Engine/Core/Graphics/DepthPyramid.h"
 
 namespace ym
 {
 	class ObjectManager;
+	class ECS;
 	class Terrain;
 	class Renderer
 	{
@@ -27,6 +30,21 @@ namespace ym
 			RENDER_TYPE_SIZE
 		};
 
+		// Instances which were tested against the frustum by the last drawAllModels call, or by the GPU a few frames ago when culling on the GPU.
+		struct CullStats
+		{
+			uint32_t instances{ 0 };
+			uint32_t visible{ 0 };
+			float cullMs{ 0.f };
+
+			// Only with Graphics/occlusionCulling. Instances inside the frustum which were tested against the depth of the frame before,
+			// the ones it hid and the indirect draws which drew at least one instance.
+			uint32_t occlusionTested{ 0 };
+			uint32_t occluded{ 0 };
+			uint32_t commands{ 0 };
+			uint32_t draws{ 0 };
+		};
+
 	public:
 		Renderer();
 		virtual ~Renderer();
@@ -38,6 +56,7 @@ namespace ym
 		void setActiveCamera(Camera* camera);
 
 		Texture* getDefaultEnvironmentMap();
+		const SH9& getIrradianceSH() const;
 
 		void setScreenData(float screenExposure, float screenGamma);
 
@@ -62,10 +81,37 @@ namespace ym
 		void drawModel(Model* model, const std::vector<glm::mat4>& transforms);
 
 		/*
-			Draw all objects in the object Manager as instanced models.
+			Draw all objects in the object Manager as instanced models. Objects outside of the camera frustum are skipped, on the GPU if
+			Graphics/gpuCulling is set.
 		*/
 		void drawAllModels(ObjectManager* objectManager);
 
+		/*
+			Draw all entities with a Transform and a ModelRef as instanced models. Entities outside of the camera frustum are skipped.
+		*/
+		void drawAllModels(ECS* ecs);
+
+		void setFrustumCulling(bool enabled);
+		bool isFrustumCulling() const;
+		const CullStats& getCullStats() const;
+
+		/*
+			Number of descriptors written by the model renderer in the last frame.
+		*/
+		uint32_t getDescriptorWriteCount() const;
+
+		/*
+			Number of triangles submitted by the model renderer in the last frame, after the levels of detail were selected.
+		*/
+		uint64_t getTriangleCount() const;
+
+		/*
+			Nodes, triangles and tile streaming of the terrains drawn in the last frame. drawTerrainStats shows them in an ImGui window.
+		*/
+		const TerrainRenderer::Stats& getTerrainStats() const;
+		void drawTerrainStats();
+		bool isBindlessMaterials() const;
+
 		/*
 			Draw a skybox with the specifed cubemap texture.
 		*/
@@ -82,7 +128,7 @@ namespace ym
 		void drawCubeMap(CubeMap* cubeMap, const std::vector<glm::mat4>& transform);
 
 		/*
-			Draw a terrain object with frustum culling.
+			Draw a terrain, the nodes are selected by their distance to the camera and culled against its frustum in end.
 		*/
 		void drawTerrain(Terrain* terrain, const glm::mat4& transform);
 
@@ -116,16 +162,28 @@ namespace ym
 		RenderInheritanceData renderInheritanceData;
 		ModelRenderer modelRenderer;
 		CubeMapRenderer cubeMapRenderer;
-		//TerrainRenderer terrainRenderer;
+		TerrainRenderer terrainRenderer;
 		VKImgui imgui;
 
 		// Scene data
 		Camera* activeCamera{ nullptr };
+		FrustumCuller frustumCuller;
+		bool frustumCulling{ true };
+		CullStats cullStats;
+
+		// Occlusion culling, the depth of each frame is reduced into the pyramid after its render pass and the GPU culling of the next
+		// frame tests against it with the view projection it was rendered with.
+		bool occlusionCulling{ false };
+		bool depthPyramidBuilt{ false };
+		DepthPyramid depthPyramid;
+		glm::mat4 depthPyramidViewProjection{ 1.f };
 		std::vector<UniformBuffer> sceneUBOs;
 		DescriptorPool descriptorPool;
 		float screenData[2];
 
 		// Environment map
+		bool shIrradiance{ false }; // Evaluate the irradiance from spherical harmonics instead of sampling irradianceMap.
+		SH9 irradianceSH;
 		Texture* irradianceMap{ nullptr };
 		Texture* prefilteredEnvironmentMap{ nullptr };
 		Texture* environmentMap{ nullptr };
@@ -137,13 +195,13 @@ namespace ym
 
 		// Recording
 		std::vector<CommandBuffer*> primaryCommandBuffersGraphics;
-		//std::vector<CommandBuffer*> primaryCommandBuffersCompute;
+		std::vector<CommandBuffer*> primaryCommandBuffersCompute;
 		VkCommandBufferInheritanceInfo inheritanceInfo;
 
 		// Sync objects
 		std::vector<VkSemaphore> imageAvailableSemaphores;
 		std::vector<VkSemaphore> renderFinishedSemaphores;
-		//std::vector<VkSemaphore> computeSemaphores;
+		std::vector<VkSemaphore> computeSemaphores; // Signaled by the culling of the terrain, the graphics submit waits for it.
 		std::vector<VkFence> inFlightFences;
 		std::vector<VkFence> imagesInFlight;
 		uint32_t framesInFlight;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "glm/glm.hpp"
+#include "Engine/Core/Graphics/SphericalHarmonics.h"
 #include "Engine/Core/Vulkan/Pipeline/DescriptorLayout.h"
 #include <vulkan/vulkan.h>
 #include <vector>
@@ -13,6 +14,7 @@ namespace ym
 		glm::mat4 view;
 		alignas(16) glm::vec3 cPos;
 		alignas(16) glm::vec2 screenData;
+		SH9 irradianceSH; // Only set when the irradiance is evaluated from spherical harmonics.
 	};
 
 	struct SceneDescriptors
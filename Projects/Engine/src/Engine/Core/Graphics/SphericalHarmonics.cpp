@@ -0,0 +1,165 @@
+#include "stdafx.h"
+#include "SphericalHarmonics.h"
+
+#include <glm/gtc/constants.hpp>
+#include <xmmintrin.h>
+
+namespace
+{
+	// Constants of the real spherical harmonics basis.
+	const float Y00 = 0.282095f;
+	const float Y1 = 0.488603f;
+	const float Y2 = 1.092548f;
+	const float Y20 = 0.315392f;
+	const float Y22 = 0.546274f;
+
+	// The direction of a texel is major + s * sAxis + t * tAxis, where s and t are in [-1, 1].
+	struct FaceAxes
+	{
+		glm::vec3 major;
+		glm::vec3 sAxis;
+		glm::vec3 tAxis;
+	};
+
+	const FaceAxes faceAxes[6] = {
+		{ { 1.f, 0.f, 0.f }, { 0.f, 0.f, -1.f }, { 0.f, -1.f, 0.f } },	// +X
+		{ { -1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, -1.f, 0.f } },	// -X
+		{ { 0.f, 1.f, 0.f }, { 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f } },	// +Y
+		{ { 0.f, -1.f, 0.f }, { 1.f, 0.f, 0.f }, { 0.f, 0.f, -1.f } },	// -Y
+		{ { 0.f, 0.f, 1.f }, { 1.f, 0.f, 0.f }, { 0.f, -1.f, 0.f } },	// +Z
+		{ { 0.f, 0.f, -1.f }, { -1.f, 0.f, 0.f }, { 0.f, -1.f, 0.f } }	// -Z
+	};
+
+	float horizontalSum(__m128 v)
+	{
+		alignas(16) float lanes[4];
+		_mm_store_ps(lanes, v);
+		return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	}
+}
+
+ym::SH9 ym::SphericalHarmonics::projectCubeMap(const float* data, uint32_t size)
+{
+	YM_ASSERT(size % 4 == 0, "Cube map size needs to be a multiple of 4! Size: {}", size);
+
+	__m128 sums[SH_COEFFICIENT_COUNT][3];
+	for (uint32_t k = 0; k < SH_COEFFICIENT_COUNT; k++)
+		sums[k][0] = sums[k][1] = sums[k][2] = _mm_setzero_ps();
+	__m128 weightSum = _mm_setzero_ps();
+
+	const float texelSize = 2.f / (float)size;
+	const __m128 sOffsets = _mm_setr_ps(0.f, texelSize, 2.f * texelSize, 3.f * texelSize);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 three = _mm_set1_ps(3.f);
+	for (uint32_t face = 0; face < 6; face++)
+	{
+		const FaceAxes& axes = faceAxes[face];
+		const __m128 sAxisX = _mm_set1_ps(axes.sAxis.x);
+		const __m128 sAxisY = _mm_set1_ps(axes.sAxis.y);
+		const __m128 sAxisZ = _mm_set1_ps(axes.sAxis.z);
+		const float* faceData = data + (size_t)face * size * size * 4;
+		for (uint32_t y = 0; y < size; y++)
+		{
+			// The part of the direction which is the same for the whole row.
+			const float t = ((float)y + 0.5f) * texelSize - 1.f;
+			const __m128 tSq = _mm_set1_ps(t * t);
+			const __m128 rowX = _mm_set1_ps(axes.major.x + t * axes.tAxis.x);
+			const __m128 rowY = _mm_set1_ps(axes.major.y + t * axes.tAxis.y);
+			const __m128 rowZ = _mm_set1_ps(axes.major.z + t * axes.tAxis.z);
+
+			const float* row = faceData + (size_t)y * size * 4;
+			for (uint32_t x = 0; x < size; x += 4)
+			{
+				const __m128 s = _mm_add_ps(_mm_set1_ps(((float)x + 0.5f) * texelSize - 1.f), sOffsets);
+
+				// |direction|^2 = 1 + s^2 + t^2, the solid angle of a texel is proportional to 1 / |direction|^3.
+				const __m128 lengthSq = _mm_add_ps(_mm_add_ps(one, _mm_mul_ps(s, s)), tSq);
+				const __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+				const __m128 weight = _mm_mul_ps(_mm_mul_ps(invLength, invLength), invLength);
+				weightSum = _mm_add_ps(weightSum, weight);
+
+				const __m128 nx = _mm_mul_ps(_mm_add_ps(rowX, _mm_mul_ps(s, sAxisX)), invLength);
+				const __m128 ny = _mm_mul_ps(_mm_add_ps(rowY, _mm_mul_ps(s, sAxisY)), invLength);
+				const __m128 nz = _mm_mul_ps(_mm_add_ps(rowZ, _mm_mul_ps(s, sAxisZ)), invLength);
+
+				__m128 basis[SH_COEFFICIENT_COUNT];
+				basis[0] = _mm_set1_ps(Y00);
+				basis[1] = _mm_mul_ps(_mm_set1_ps(Y1), ny);
+				basis[2] = _mm_mul_ps(_mm_set1_ps(Y1), nz);
+				basis[3] = _mm_mul_ps(_mm_set1_ps(Y1), nx);
+				basis[4] = _mm_mul_ps(_mm_set1_ps(Y2), _mm_mul_ps(nx, ny));
+				basis[5] = _mm_mul_ps(_mm_set1_ps(Y2), _mm_mul_ps(ny, nz));
+				basis[6] = _mm_mul_ps(_mm_set1_ps(Y20), _mm_sub_ps(_mm_mul_ps(three, _mm_mul_ps(nz, nz)), one));
+				basis[7] = _mm_mul_ps(_mm_set1_ps(Y2), _mm_mul_ps(nx, nz));
+				basis[8] = _mm_mul_ps(_mm_set1_ps(Y22), _mm_sub_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)));
+
+				// Four RGBA texels to one register per channel.
+				__m128 r = _mm_loadu_ps(row + (size_t)x * 4);
+				__m128 g = _mm_loadu_ps(row + (size_t)x * 4 + 4);
+				__m128 b = _mm_loadu_ps(row + (size_t)x * 4 + 8);
+				__m128 a = _mm_loadu_ps(row + (size_t)x * 4 + 12);
+				_MM_TRANSPOSE4_PS(r, g, b, a);
+				r = _mm_mul_ps(r, weight);
+				g = _mm_mul_ps(g, weight);
+				b = _mm_mul_ps(b, weight);
+
+				for (uint32_t k = 0; k < SH_COEFFICIENT_COUNT; k++)
+				{
+					sums[k][0] = _mm_add_ps(sums[k][0], _mm_mul_ps(basis[k], r));
+					sums[k][1] = _mm_add_ps(sums[k][1], _mm_mul_ps(basis[k], g));
+					sums[k][2] = _mm_add_ps(sums[k][2], _mm_mul_ps(basis[k], b));
+				}
+			}
+		}
+	}
+
+	// Scale the weights to sum to the area of the sphere.
+	const float scale = 4.f * glm::pi<float>() / horizontalSum(weightSum);
+	SH9 sh;
+	for (uint32_t k = 0; k < SH_COEFFICIENT_COUNT; k++)
+		sh.coefficients[k] = glm::vec4(horizontalSum(sums[k][0]), horizontalSum(sums[k][1]), horizontalSum(sums[k][2]), 0.f) * scale;
+	convolveCosineLobe(sh);
+	return sh;
+}
+
+glm::vec3 ym::SphericalHarmonics::evaluate(const SH9& sh, const glm::vec3& n)
+{
+	float basis[SH_COEFFICIENT_COUNT];
+	getBasis(n, basis);
+	glm::vec3 irradiance(0.f);
+	for (uint32_t k = 0; k < SH_COEFFICIENT_COUNT; k++)
+		irradiance += glm::vec3(sh.coefficients[k]) * basis[k];
+	return glm::max(irradiance, glm::vec3(0.f));
+}
+
+glm::vec3 ym::SphericalHarmonics::getTexelDirection(uint32_t face, uint32_t x, uint32_t y, uint32_t size)
+{
+	const float s = ((float)x + 0.5f) * 2.f / (float)size - 1.f;
+	const float t = ((float)y + 0.5f) * 2.f / (float)size - 1.f;
+	const FaceAxes& axes = faceAxes[face];
+	return glm::normalize(axes.major + s * axes.sAxis + t * axes.tAxis);
+}
+
+void ym::SphericalHarmonics::getBasis(const glm::vec3& n, float basis[SH_COEFFICIENT_COUNT])
+{
+	basis[0] = Y00;
+	basis[1] = Y1 * n.y;
+	basis[2] = Y1 * n.z;
+	basis[3] = Y1 * n.x;
+	basis[4] = Y2 * n.x * n.y;
+	basis[5] = Y2 * n.y * n.z;
+	basis[6] = Y20 * (3.f * n.z * n.z - 1.f);
+	basis[7] = Y2 * n.x * n.z;
+	basis[8] = Y22 * (n.x * n.x - n.y * n.y);
+}
+
+void ym::SphericalHarmonics::convolveCosineLobe(SH9& sh)
+{
+	// The convolution scales band l by A_l = PI, 2PI/3 and PI/4, which are divided by PI to match the irradiance cube map.
+	const float bandScales[3] = { 1.f, 2.f / 3.f, 1.f / 4.f };
+	sh.coefficients[0] *= bandScales[0];
+	for (uint32_t k = 1; k < 4; k++)
+		sh.coefficients[k] *= bandScales[1];
+	for (uint32_t k = 4; k < SH_COEFFICIENT_COUNT; k++)
+		sh.coefficients[k] *= bandScales[2];
+}
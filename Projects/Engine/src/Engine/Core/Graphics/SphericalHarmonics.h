@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#define SH_COEFFICIENT_COUNT 9
+#define SH_PROJECTION_SIZE 64 // Side size of the environment mip level which is projected.
+
+namespace ym
+{
+	/*
+		Irradiance as third order (9 coefficients) spherical harmonics. The coefficients are convolved with the clamped cosine lobe
+		and divided by PI, evaluating them gives the same value as sampling the irradiance cube map. The rgb is stored in xyz, the
+		layout matches the std140 array in SceneData.
+	*/
+	struct SH9
+	{
+		glm::vec4 coefficients[SH_COEFFICIENT_COUNT];
+	};
+
+	class SphericalHarmonics
+	{
+	public:
+		/*
+			Project a cube map with RGBA32F faces, stored after each other in the order +X, -X, +Y, -Y, +Z, -Z, to irradiance.
+			Four texels of a row are processed at a time, size needs to be a multiple of 4.
+		*/
+		static SH9 projectCubeMap(const float* data, uint32_t size);
+
+		/*
+			Irradiance in the direction of the normal n.
+		*/
+		static glm::vec3 evaluate(const SH9& sh, const glm::vec3& n);
+
+		/*
+			Direction of the center of a texel, in the same orientation as Vulkan samples cube maps.
+		*/
+		static glm::vec3 getTexelDirection(uint32_t face, uint32_t x, uint32_t y, uint32_t size);
+
+		/*
+			Real spherical harmonics basis in the direction n, which needs to be normalized.
+		*/
+		static void getBasis(const glm::vec3& n, float basis[SH_COEFFICIENT_COUNT]);
+
+		/*
+			Convolve radiance coefficients with the clamped cosine lobe and divide by PI.
+		*/
+		static void convolveCosineLobe(SH9& sh);
+	};
+}
@@ -1,637 +1,706 @@
 #include "stdafx.h"
 #include "TerrainRenderer.h"
 
-#include "Engine/Core/Threading/ThreadManager.h"
 #include "Engine/Core/Vulkan/Pipeline/DescriptorSet.h"
+#include "Engine/Core/Vulkan/Pipeline/RenderPass.h"
+#include "Engine/Core/Application/LayerManager.h"
 #include "Engine/Core/Vulkan/Factory.h"
-#include "Engine/Core/Vulkan/DebugHelper.h"
+#include "Engine/Core/Input/Config.h"
+#include "Utils/Timer.h"
+#include "Utils/Imgui/imgui.h"
+
+namespace
+{
+	const uint32_t PATCH_VERTICES = TERRAIN_PATCH_SIZE + 1;
+	const uint32_t QUARTER_INDEX_COUNT = (TERRAIN_PATCH_SIZE / 2) * (TERRAIN_PATCH_SIZE / 2) * 6;
+	const uint64_t TILE_BYTES = ((uint64_t)TERRAIN_TILE_SAMPLES * TERRAIN_TILE_SAMPLES * sizeof(uint16_t) + 15) & ~15ull;
+	const float NO_MORPH_DISTANCE = 1e30f; // Morph range of the coarsest level, its vertices never morph.
+	const uint32_t DRAW_START_COUNT = 16; // Terrain draws each frame can hold before the culling buffers need to grow.
+
+	// Double the frame size of the buffer until it holds requiredSize bytes. Returns false if it already does.
+	bool grow(ym::RingBuffer& buffer, uint64_t requiredSize)
+	{
+		uint64_t newSize = buffer.getFrameSize();
+		if (requiredSize <= newSize)
+			return false;
+
+		while (newSize < requiredSize)
+			newSize *= 2;
+		buffer.resize(newSize);
+		return true;
+	}
+}
 
 ym::TerrainRenderer::TerrainRenderer()
 {
-	this->threadID = 0;
 	this->swapChain = nullptr;
+	this->inheritanceInfo = {};
+	this->renderInheritanceData = nullptr;
+	this->cameraPosition = glm::vec3(0.f);
+	this->drawCount = 0;
+	this->nodeDescriptorSet = VK_NULL_HANDLE;
+	this->gpuCulling = false;
+	this->cullDescriptorSet = VK_NULL_HANDLE;
+	this->cullPushData = {};
+	this->threadID = 0;
 }
 
 ym::TerrainRenderer::~TerrainRenderer()
 {
 }
 
-void ym::TerrainRenderer::init(SwapChain* swapChain, uint32_t threadID, RenderPass* renderPass, SceneDescriptors* sceneDescriptors)
+void ym::TerrainRenderer::init(SwapChain* swapChain, uint32_t threadID, RenderPass* renderPass, RenderInheritanceData* renderInheritanceData)
 {
 	this->swapChain = swapChain;
 	this->threadID = threadID;
-	this->sceneDescriptors = sceneDescriptors;
-	this->commandPoolGraphics.init(CommandPool::Queue::GRAPHICS, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
-	this->commandPoolCompute.init(CommandPool::Queue::COMPUTE, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
-	this->commanPoolTransfer.init(CommandPool::Queue::TRANSFER, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
-	this->commandBuffersGraphics = this->commandPoolGraphics.createCommandBuffers(this->swapChain->getNumImages(), VK_COMMAND_BUFFER_LEVEL_SECONDARY);
-	this->commandBuffersCompute = this->commandPoolCompute.createCommandBuffers(this->swapChain->getNumImages(), VK_COMMAND_BUFFER_LEVEL_SECONDARY);
-	this->shouldRecreateDescriptors.resize(this->swapChain->getNumImages(), false);
-	this->descriptorPools.resize(this->swapChain->getNumImages());
-
-	NameBinder::bindObject((uint64_t)this->commandPoolGraphics.getCommandPool(), "Graphics Command Pool [Terrain]");
-	NameBinder::bindObject((uint64_t)this->commandPoolCompute.getCommandPool(), "Compute Command Pool [Terrain]");
-	NameBinder::bindObject((uint64_t)this->commanPoolTransfer.getCommandPool(), "Transfer Command Pool [Terrain]");
-
-	for (uint32_t i = 0; i < this->swapChain->getNumImages(); i++)
-	{
-		std::string idStr = "[" + std::to_string(i) + "]";
-		CommandBuffer* graphicsBuff = this->commandBuffersGraphics[i];
-		NameBinder::bindObject((uint64_t)graphicsBuff->getCommandBuffer(), "Graphics Command Buffer [Terrain] " + idStr);
-		CommandBuffer* computeBuff = this->commandBuffersCompute[i];
-		NameBinder::bindObject((uint64_t)computeBuff->getCommandBuffer(), "Compute Command Buffer [Terrain] " + idStr);
-	}
+	this->renderInheritanceData = renderInheritanceData;
 
-	createDescriptorLayouts();
+	this->commandPool.init(CommandPool::Queue::GRAPHICS, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	this->commandBuffers = this->commandPool.createCommandBuffers(this->swapChain->getNumImages(), VK_COMMAND_BUFFER_LEVEL_SECONDARY);
 
-	// Frustum pipeline
-	{
-		this->frustumShader.addStage(Shader::Type::COMPUTE, YM_ASSETS_FILE_PATH + "Shaders/terrainComp.spv");
-		this->frustumShader.init();
+	this->shader.addStage(Shader::Type::VERTEX, YM_ASSETS_FILE_PATH + "Shaders/terrainVert.spv");
+	this->shader.addStage(Shader::Type::FRAGMENT, YM_ASSETS_FILE_PATH + "Shaders/terrainFrag.spv");
+	this->shader.init();
+
+	// Nodes
+	this->descriptorSetLayouts.nodes.add(new SSBO(VK_SHADER_STAGE_VERTEX_BIT));
+	this->descriptorSetLayouts.nodes.init();
 
-		std::vector<DescriptorLayout> descriptorLayouts = { this->descriptorSetLayouts.frustum };
-		this->frustumPipeline.setDescriptorLayouts(descriptorLayouts);
-		this->frustumPipeline.init(Pipeline::Type::COMPUTE, &this->frustumShader);
+	// Heights
+	this->descriptorSetLayouts.heights.add(new IMG(VK_SHADER_STAGE_VERTEX_BIT));
+	this->descriptorSetLayouts.heights.init();
+
+	// The culling writes the nodes on the compute queue.
+	const uint32_t numImages = this->swapChain->getNumImages();
+	this->gpuCulling = Config::get()->fetch<bool>("Terrain/gpuCulling");
+	if (this->gpuCulling && VulkanInstance::get()->supportsIndirectDraws() == false)
+	{
+		YM_LOG_WARN("The device does not support indirect draws with a first instance. Culling the terrain on the CPU.");
+		this->gpuCulling = false;
 	}
+	else if (this->gpuCulling && Shader::exists(YM_ASSETS_FILE_PATH + TERRAIN_CULL_SHADER) == false)
+	{
+		YM_LOG_WARN("{} has not been compiled. Culling the terrain on the CPU.", TERRAIN_CULL_SHADER);
+		this->gpuCulling = false;
+	}
+	VkQueueFlags nodeQueues = this->gpuCulling ? VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT : VK_QUEUE_GRAPHICS_BIT;
+	this->nodeBuffer.init(sizeof(NodeData) * TERRAIN_NODE_BUFFER_START_COUNT, numImages, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, nodeQueues);
+	this->stagingBuffer.init(TILE_BYTES * TERRAIN_MAX_UPLOADS_PER_FRAME, numImages, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+	createNodeDescriptorSet();
+	createIndexBuffer();
 
-	// Graphics pipeline
+	if (this->gpuCulling)
 	{
-		this->shader.addStage(Shader::Type::VERTEX, YM_ASSETS_FILE_PATH + "Shaders/terrainVert.spv");
-		this->shader.addStage(Shader::Type::FRAGMENT, YM_ASSETS_FILE_PATH + "Shaders/terrainFragTest.spv");
-		this->shader.init();
-
-		std::vector<DescriptorLayout> descriptorLayouts = { this->sceneDescriptors->layout, this->descriptorSetLayouts.terrain, this->descriptorSetLayouts.material };
-		VkVertexInputBindingDescription vertexBindingDescriptions = Vertex::getBindingDescriptions();
-		std::array<VkVertexInputAttributeDescription, 3> vertexAttributeDescriptions = Vertex::getAttributeDescriptions();
-		PipelineInfo pipelineInfo = {};
-		pipelineInfo.vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		pipelineInfo.vertexInputInfo.vertexBindingDescriptionCount = 1;
-		pipelineInfo.vertexInputInfo.vertexAttributeDescriptionCount = 3;
-		pipelineInfo.vertexInputInfo.pVertexBindingDescriptions = &vertexBindingDescriptions;
-		pipelineInfo.vertexInputInfo.pVertexAttributeDescriptions = vertexAttributeDescriptions.data();
-
-		this->pipeline.setPipelineInfo(PipelineInfoFlag::VERTEX_INPUT, pipelineInfo);
-		this->pipeline.setDescriptorLayouts(descriptorLayouts);
-		this->pipeline.setGraphicsPipelineInfo(swapChain->getExtent(), renderPass);
-		//this->pipeline.setWireframe(true);
-		this->pipeline.init(Pipeline::Type::GRAPHICS, &this->shader);
+		const VkQueueFlags queues = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+		this->candidateBuffer.init(sizeof(Candidate) * TERRAIN_NODE_BUFFER_START_COUNT, numImages, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queues);
+		this->viewBuffer.init(sizeof(View) * DRAW_START_COUNT, numImages, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, queues);
+		this->indirectBuffer.init(sizeof(VkDrawIndexedIndirectCommand) * DRAW_START_COUNT * 5, numImages,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, queues);
+		this->frameCommandCounts.resize(numImages, 0);
+		this->frameCandidateCounts.resize(numImages, 0);
+		createCullPipeline();
+		createCullDescriptorSet();
 	}
 
-	this->regionSize = Config::get()->fetch<int>("Terrain/regionSize");
-	this->proximityRadius = Config::get()->fetch<int>("Terrain/proximityRadius");
-	Terrain::ProximityDescription proxDesc = Terrain::createProximityDescription(0, this->regionSize, this->proximityRadius);
-	this->indiciesPerRegion = proxDesc.indiciesPerRegion;
-	this->proximityWidth = proxDesc.proximityWidth;
-	generateIndicies(regionSize, proximityRadius);
-	createBuffers();
+	// The patch has no vertex input, the vertices are generated from the vertex index.
+	std::vector<DescriptorLayout> descriptorLayouts = { this->renderInheritanceData->sceneDescriptors.layout, this->descriptorSetLayouts.nodes, this->descriptorSetLayouts.heights };
+	VkPushConstantRange pushConstRange = {};
+	pushConstRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstRange.size = sizeof(PushData);
+	pushConstRange.offset = 0;
+	this->pipeline.setPushConstant(pushConstRange);
+	this->pipeline.setDescriptorLayouts(descriptorLayouts);
+	this->pipeline.setGraphicsPipelineInfo(swapChain->getExtent(), renderPass);
+	this->pipeline.init(Pipeline::Type::GRAPHICS, &this->shader);
 }
 
 void ym::TerrainRenderer::destroy()
 {
-	if (this->drawBatch.empty() == false)
+	for (auto& terrainData : this->terrains)
 	{
-		for (uint32_t i = 0; i < this->swapChain->getNumImages(); i++)
-			clearDrawBatch(i);
+		terrainData.second.descriptorPool.destroy();
+		terrainData.second.sampler.destroy();
+		terrainData.second.heights->destroy();
+		SAFE_DELETE(terrainData.second.heights);
 	}
+	this->terrains.clear();
 
-	for (UniformBuffer& ubo : this->frustumPlanesUBOs)
-		ubo.destroy();
-
-	for (auto& pool : this->descriptorPools)
-		pool.destroy();
-
-	this->vertexBuffer1.destroy();
-	this->vertexBuffer2.destroy();
-	this->memoryDeviceLocal.destroy();
+	this->shader.destroy();
+	this->pipeline.destroy();
+	this->commandPool.destroy();
+	this->nodeDescriptorPool.destroy();
+	this->nodeBuffer.destroy();
 	this->stagingBuffer.destroy();
-	this->memoryHost.destroy();
 	this->indexBuffer.destroy();
+	this->indexMemory.destroy();
 
-	this->descriptorSetLayouts.terrain.destroy();
-	this->descriptorSetLayouts.material.destroy();
-	this->descriptorSetLayouts.frustum.destroy();
-	this->commandPoolGraphics.destroy();
-	this->commandPoolCompute.destroy();
-	this->commanPoolTransfer.destroy();
-	this->pipeline.destroy();
-	this->shader.destroy();
-	this->frustumPipeline.destroy();
-	this->frustumShader.destroy();
+	if (this->gpuCulling)
+	{
+		this->cullShader.destroy();
+		this->cullPipeline.destroy();
+		this->cullDescriptorPool.destroy();
+		this->candidateBuffer.destroy();
+		this->viewBuffer.destroy();
+		this->indirectBuffer.destroy();
+		this->descriptorSetLayouts.cull.destroy();
+	}
+
+	this->descriptorSetLayouts.nodes.destroy();
+	this->descriptorSetLayouts.heights.destroy();
 }
 
-void ym::TerrainRenderer::setActiveCamera(Camera* camera)
+void ym::TerrainRenderer::setView(const glm::vec3& cameraPosition, const std::vector<Camera::Plane>& planes)
 {
-	this->activeCamera = camera;
+	this->cameraPosition = cameraPosition;
+	this->planes = planes;
 }
 
 void ym::TerrainRenderer::begin(uint32_t imageIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
 {
 	this->inheritanceInfo = inheritanceInfo;
-
-	if (this->drawBatch.empty() == false)
-	{
-		for (auto& drawData : this->drawBatch[imageIndex])
-			drawData.second.exists = false;
-	}
-
-	// Clear draw data if descriptor pool should be recreated.
-	if (this->shouldRecreateDescriptors[imageIndex])
-		clearDrawBatch(imageIndex);
+	this->drawCount = 0;
+	for (auto& terrainData : this->terrains)
+		terrainData.second.drawn = false;
 }
 
 void ym::TerrainRenderer::drawTerrain(uint32_t imageIndex, Terrain* terrain, const glm::mat4& transform)
 {
-	DrawData drawData;
-	drawData.exists = true;
+	// A terrain which failed to load has no tiles.
+	if (terrain->getTiles().getTileCount() == 0)
+		return;
+
+	// Reuse the draws of the previous frames, the selections keep their memory.
+	if (this->drawCount == this->draws.size())
+		this->draws.emplace_back();
+
+	DrawData& drawData = this->draws[this->drawCount++];
 	drawData.terrain = terrain;
 	drawData.transform = transform;
-	addTerrainToBatch(imageIndex, drawData);
 }
 
 void ym::TerrainRenderer::end(uint32_t imageIndex)
 {
-	this->frustumPlanesUBOs[imageIndex].transfer(this->activeCamera->getPlanes().data(), sizeof(PlanesData), 0);
-
-	if (this->shouldRecreateDescriptors[imageIndex])
+	YM_PROFILER_FUNCTION();
+
+	TerrainTiles::Stats tileStats = {};
+	this->stats = {};
+	this->drawCommands.clear();
+	this->uploads.clear();
+	this->stagingBuffer.begin(imageIndex);
+	if (this->gpuCulling)
+		readCullStats(imageIndex);
+
+	// Select the nodes of each terrain in its own space. The tiles which finished loading are resident from now on, so they are
+	// staged before the selection and copied before the render pass.
+	Timer timer;
+	uint64_t nodeCount = 0;
+	for (uint32_t i = 0; i < this->drawCount; i++)
 	{
-		uint32_t terrainCount = 0;
-		for (auto& drawData : this->drawBatch[imageIndex])
-			terrainCount++;
-		recreateDescriptorPool(imageIndex, terrainCount);
-
-		// Recreate descriptor sets
-		createDescriptorsSets(imageIndex, this->drawBatch[imageIndex]);
-
-		// Update vertex buffer.
-		verticesToDevice(this->activeVertexBuffer, this->vertices);
-
-		this->shouldRecreateDescriptors[imageIndex] = false;
-	}
-
-	// Start recording all draw commands on the thread.
-	CommandBuffer* currentBufferCompute = this->commandBuffersCompute[imageIndex];
-	currentBufferCompute->begin(0, &this->inheritanceInfo);
+		DrawData& drawData = this->draws[i];
+		TerrainData& terrainData = getTerrainData(drawData.terrain);
+		if (terrainData.drawn == false)
+		{
+			stageLoadedTiles(terrainData);
+			terrainData.drawn = true;
+		}
 
-	if (this->drawBatch.empty() == false)
-	{
-		for (auto& batch : this->drawBatch[imageIndex])
+		// Planes are transformed with the inverse transpose of the inverse, which is the transpose of the transform.
+		glm::mat4 inverse = glm::inverse(drawData.transform);
+		glm::mat3 normalMatrix = glm::transpose(glm::mat3(drawData.transform));
+		drawData.planes.resize(this->planes.size());
+		for (size_t p = 0; p < this->planes.size(); p++)
 		{
-			DrawData* drawData = &batch.second;
-			if (drawData->exists)
-			{
-				ThreadManager::addWork(this->threadID, [=]() {
-					recordFrustum(drawData, imageIndex, currentBufferCompute);
-				});
-			}
+			drawData.planes[p].normal = glm::normalize(normalMatrix * this->planes[p].normal);
+			drawData.planes[p].point = glm::vec3(inverse * glm::vec4(this->planes[p].point, 1.f));
 		}
-		ThreadManager::wait(this->threadID);
-	};
-	currentBufferCompute->end();
+		drawData.cameraPosition = glm::vec3(inverse * glm::vec4(this->cameraPosition, 1.f));
+		drawData.terrain->select(drawData.cameraPosition, drawData.planes, drawData.selection, this->gpuCulling);
 
-	CommandBuffer* currentBufferGraphics = this->commandBuffersGraphics[imageIndex];
-	currentBufferGraphics->begin(VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, &this->inheritanceInfo);
-	if (this->drawBatch.empty() == false)
-	{
-		for (auto& batch : this->drawBatch[imageIndex])
+		for (const Terrain::Node& node : drawData.selection.nodes)
 		{
-			DrawData* drawData = &batch.second;
-			if (drawData->exists)
+			if (node.quarters == 0xF)
+				nodeCount++;
+			else
 			{
-				ThreadManager::addWork(this->threadID, [=]() {
-					recordTerrain(drawData, imageIndex, currentBufferGraphics);
-				});
+				for (uint32_t q = 0; q < 4; q++)
+					nodeCount += (node.quarters >> q) & 1;
 			}
 		}
+		this->stats.nodeCount += (uint32_t)drawData.selection.nodes.size();
+		this->stats.fallbackCount += drawData.selection.fallbackCount;
+		this->stats.triangleCount += drawData.selection.triangleCount;
+
+		TerrainTiles::Stats terrainStats = drawData.terrain->getTiles().getStats();
+		tileStats.residentCount += terrainStats.residentCount;
+		tileStats.pendingCount += terrainStats.pendingCount;
+		tileStats.loadCount += terrainStats.loadCount;
+		tileStats.evictionCount += terrainStats.evictionCount;
+	}
+	this->stats.selectMs = timer.stop() * 1000.f;
+	this->stats.uploadCount = (uint32_t)this->uploads.size();
+	this->stats.tiles = tileStats;
 
-		ThreadManager::wait(this->threadID);
-	};
-	currentBufferGraphics->end();
-}
+	reserveBuffers(nodeCount, this->drawCount);
+	this->nodeBuffer.begin(imageIndex);
+	if (this->gpuCulling)
+	{
+		this->candidateBuffer.begin(imageIndex);
+		this->viewBuffer.begin(imageIndex);
+		this->indirectBuffer.begin(imageIndex);
+	}
+	for (uint32_t i = 0; i < this->drawCount; i++)
+		writeNodes(getTerrainData(this->draws[i].terrain), this->draws[i]);
 
-void ym::TerrainRenderer::preRecordGraphics(uint32_t imageIndex, CommandBuffer* commandBuffer)
-{
-	if (this->drawBatch.empty() == false)
+	if (this->gpuCulling)
 	{
-		for (auto& batch : this->drawBatch[imageIndex])
-		{
-			DrawData* drawData = &batch.second;
-			if (drawData->exists)
-			{
-				commandBuffer->acquireBuffer(&drawData->indirectDrawBuffer, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
-					VulkanInstance::get()->getComputeQueue().queueIndex, VulkanInstance::get()->getGraphicsQueue().queueIndex,
-					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
-			}
-		}
-	};
-}
+		this->cullPushData.candidateBase = (uint32_t)(imageIndex * this->candidateBuffer.getFrameSize() / sizeof(Candidate));
+		this->cullPushData.candidateCount = (uint32_t)(this->candidateBuffer.getUsedSize() / sizeof(Candidate));
+		this->frameCandidateCounts[imageIndex] = this->cullPushData.candidateCount;
+		this->frameCommandCounts[imageIndex] = (uint32_t)(this->indirectBuffer.getUsedSize() / sizeof(VkDrawIndexedIndirectCommand));
+	}
 
-void ym::TerrainRenderer::postRecordGraphics(uint32_t imageIndex, CommandBuffer* commandBuffer)
-{
-	if (this->drawBatch.empty() == false)
+	// Record all terrains into the same command buffer.
+	CommandBuffer* currentBuffer = this->commandBuffers[imageIndex];
+	currentBuffer->begin(VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, &this->inheritanceInfo);
+	if (this->drawCommands.empty() == false)
 	{
-		for (auto& batch : this->drawBatch[imageIndex])
+		currentBuffer->cmdBindPipeline(&this->pipeline);
+		currentBuffer->cmdBindIndexBuffer(this->indexBuffer.getBuffer(), 0, VK_INDEX_TYPE_UINT16);
+		for (const DrawCommand& command : this->drawCommands)
 		{
-			DrawData* drawData = &batch.second;
-			if (drawData->exists)
-			{
-				commandBuffer->releaseBuffer(&drawData->indirectDrawBuffer, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
-					VulkanInstance::get()->getGraphicsQueue().queueIndex, VulkanInstance::get()->getComputeQueue().queueIndex,
-					VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-			}
+			std::vector<VkDescriptorSet> sets = {
+				this->renderInheritanceData->sceneDescriptors.sets[imageIndex],
+				this->nodeDescriptorSet,
+				command.terrainData->descriptorSet
+			};
+			std::vector<uint32_t> offsets;
+			currentBuffer->cmdBindDescriptorSets(&this->pipeline, 0, sets, offsets);
+			currentBuffer->cmdPushConstants(&this->pipeline, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushData), &command.pushData);
+			if (this->gpuCulling)
+				currentBuffer->cmdDrawIndexedIndirect(this->indirectBuffer.getDescriptor().buffer, command.indirectOffset, 1, sizeof(VkDrawIndexedIndirectCommand));
+			else
+				currentBuffer->cmdDrawIndexed(command.indexCount, command.instanceCount, command.firstIndex, 0, command.firstInstance);
 		}
-	};
+	}
+	currentBuffer->end();
 }
 
-void ym::TerrainRenderer::preRecordCompute(uint32_t imageIndex, CommandBuffer* commandBuffer)
+void ym::TerrainRenderer::recordUploads(CommandBuffer* cmdBuffer)
 {
-	if (this->drawBatch.empty() == false)
+	if (this->uploads.empty())
+		return;
+
+	// Only the layers of the uploaded slots change layout, the other slots are read while the copies are done.
+	std::vector<VkImageMemoryBarrier> barriers(this->uploads.size());
+	for (size_t i = 0; i < this->uploads.size(); i++)
 	{
-		for (auto& batch : this->drawBatch[imageIndex])
-		{
-			DrawData* drawData = &batch.second;
-			if (drawData->exists)
-			{
-				commandBuffer->acquireBuffer(&drawData->indirectDrawBuffer, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
-					VulkanInstance::get()->getGraphicsQueue().queueIndex, VulkanInstance::get()->getComputeQueue().queueIndex,
-					VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-			}
-		}
-	};
+		VkImageMemoryBarrier& barrier = barriers[i];
+		barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = this->uploads[i].heights->image.getImage();
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, this->uploads[i].slot, 1 };
+	}
+	cmdBuffer->cmdImageMemoryBarrier(VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, barriers);
+
+	VkBuffer staging = this->stagingBuffer.getDescriptor().buffer;
+	for (const Upload& upload : this->uploads)
+	{
+		VkBufferImageCopy region = {};
+		region.bufferOffset = upload.offset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = upload.slot;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { TERRAIN_TILE_SAMPLES, TERRAIN_TILE_SAMPLES, 1 };
+		cmdBuffer->cmdCopyBufferToImage(staging, upload.heights->image.getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	}
+
+	for (VkImageMemoryBarrier& barrier : barriers)
+	{
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+	cmdBuffer->cmdImageMemoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, barriers);
 }
 
-void ym::TerrainRenderer::postRecordCompute(uint32_t imageIndex, CommandBuffer* commandBuffer)
+void ym::TerrainRenderer::recordCulling(CommandBuffer* cmdBuffer)
 {
-	if (this->drawBatch.empty() == false)
-	{
-		for (auto& batch : this->drawBatch[imageIndex])
-		{
-			DrawData* drawData = &batch.second;
-			if (drawData->exists)
-			{
-				commandBuffer->releaseBuffer(&drawData->indirectDrawBuffer, VK_ACCESS_SHADER_WRITE_BIT,
-					VulkanInstance::get()->getComputeQueue().queueIndex, VulkanInstance::get()->getGraphicsQueue().queueIndex,
-					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
-			}
-		}
-	};
+	if (isCulling() == false)
+		return;
+
+	// The draws wait for the semaphore which is signaled after this, it makes the writes visible to them.
+	std::vector<VkDescriptorSet> sets = { this->cullDescriptorSet };
+	std::vector<uint32_t> offsets;
+	cmdBuffer->cmdBindPipeline(&this->cullPipeline);
+	cmdBuffer->cmdBindDescriptorSets(&this->cullPipeline, 0, sets, offsets);
+	cmdBuffer->cmdPushConstants(&this->cullPipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushData), &this->cullPushData);
+	cmdBuffer->cmdDispatch((this->cullPushData.candidateCount + TERRAIN_CULL_WORKGROUP_SIZE - 1) / TERRAIN_CULL_WORKGROUP_SIZE, 1, 1);
+
+	// The instance counts are read back for the stats when the image is used again.
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	cmdBuffer->cmdMemoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, { barrier });
 }
 
-std::vector<ym::CommandBuffer*>& ym::TerrainRenderer::getGraphicsBuffers()
+void ym::TerrainRenderer::drawStats()
 {
-	return this->commandBuffersGraphics;
+	static bool active = true;
+	ImGui::Begin("Terrain", &active);
+	ImGui::Text("Nodes: %u, %u with a coarser tile", this->stats.nodeCount, this->stats.fallbackCount);
+	ImGui::Text("Triangles: %llu", (unsigned long long)this->stats.triangleCount);
+	ImGui::Text("Selection: %.3f ms", this->stats.selectMs);
+	ImGui::Text("Tiles: %u resident, %u pending, %u uploaded", this->stats.tiles.residentCount, this->stats.tiles.pendingCount, this->stats.uploadCount);
+	if (this->gpuCulling)
+		ImGui::Text("GPU culling: %u tested, %u drawn", this->stats.gpuTestedCount, this->stats.gpuDrawnCount);
+	else
+		ImGui::Text("GPU culling: off");
+	ImGui::End();
 }
 
-std::vector<ym::CommandBuffer*>& ym::TerrainRenderer::getComputeBuffers()
+std::vector<ym::CommandBuffer*>& ym::TerrainRenderer::getBuffers()
 {
-	return this->commandBuffersCompute;
+	return this->commandBuffers;
 }
 
-void ym::TerrainRenderer::clearDrawBatch(uint32_t imageIndex)
+void ym::TerrainRenderer::createIndexBuffer()
 {
-	for (auto& drawData : this->drawBatch[imageIndex])
+	// The quarters are stored one after another, x then z, so a draw of the whole patch uses all indices and a draw of a quarter
+	// uses a quarter of them. Every quad is split along the diagonal from its first to its last vertex, the same as Terrain::getHeightAt.
+	std::vector<uint16_t> indices;
+	indices.reserve(QUARTER_INDEX_COUNT * 4);
+	const uint32_t half = TERRAIN_PATCH_SIZE / 2;
+	for (uint32_t quarter = 0; quarter < 4; quarter++)
 	{
-		drawData.second.terrainUbo.destroy();
-		drawData.second.indirectDrawBuffer.destroy();
-		drawData.second.memoryDeviceLocal.destroy();
-		drawData.second.proximityDataUBO.destroy();
+		uint32_t startX = (quarter & 1) * half;
+		uint32_t startZ = (quarter >> 1) * half;
+		for (uint32_t z = startZ; z < startZ + half; z++)
+		{
+			for (uint32_t x = startX; x < startX + half; x++)
+			{
+				uint16_t i00 = (uint16_t)(x + z * PATCH_VERTICES);
+				uint16_t i10 = (uint16_t)(x + 1 + z * PATCH_VERTICES);
+				uint16_t i01 = (uint16_t)(x + (z + 1) * PATCH_VERTICES);
+				uint16_t i11 = (uint16_t)(x + 1 + (z + 1) * PATCH_VERTICES);
+				indices.insert(indices.end(), { i00, i01, i11, i00, i11, i10 });
+			}
+		}
 	}
-	this->drawBatch[imageIndex].clear();
+
+	uint64_t size = indices.size() * sizeof(uint16_t);
+	Buffer stagingBuffer;
+	Memory stagingMemory;
+	stagingBuffer.init(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { VulkanInstance::get()->getGraphicsQueue().queueIndex });
+	stagingMemory.bindBuffer(&stagingBuffer);
+	stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryAllocator::Lifetime::TRANSIENT);
+	stagingMemory.directTransfer(&stagingBuffer, indices.data(), size, 0);
+
+	this->indexBuffer.init(size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, { VulkanInstance::get()->getGraphicsQueue().queueIndex });
+	this->indexMemory.bindBuffer(&this->indexBuffer);
+	this->indexMemory.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	CommandPool* pool = &LayerManager::get()->getCommandPools()->graphicsPool;
+	CommandBuffer* cmdBuffer = pool->beginSingleTimeCommand();
+	VkBufferCopy region = {};
+	region.srcOffset = 0;
+	region.dstOffset = 0;
+	region.size = size;
+	cmdBuffer->cmdCopyBuffer(stagingBuffer.getBuffer(), this->indexBuffer.getBuffer(), 1, &region);
+	pool->endSingleTimeCommand(cmdBuffer);
+
+	stagingBuffer.destroy();
+	stagingMemory.destroy();
 }
 
-void ym::TerrainRenderer::recordTerrain(DrawData* drawData, uint32_t imageIndex, CommandBuffer* cmdBuffer)
+void ym::TerrainRenderer::createNodeDescriptorSet()
 {
-	VkDescriptorSet& descriptorSet = drawData->terrain->getDescriptorSet();
-	cmdBuffer->cmdBindPipeline(&this->pipeline);
-	// TODO: Add material!
-	std::vector<VkDescriptorSet> sets = { this->sceneDescriptors->sets[imageIndex], descriptorSet };
-	std::vector<uint32_t> offsets;
-	cmdBuffer->cmdBindDescriptorSets(&this->pipeline, 0, sets, offsets);
-	VkBuffer vertexBuffer = this->activeVertexBuffer->getBuffer();
-	VkDeviceSize offset = 0;
-	cmdBuffer->cmdBindIndexBuffer(this->indexBuffer.getBuffer(), 0, VK_INDEX_TYPE_UINT32);
-	cmdBuffer->cmdBindVertexBuffers(0, 1, &vertexBuffer, &offset);
-	cmdBuffer->cmdDrawIndexedIndirect(drawData->indirectDrawBuffer.getBuffer(), 0, (uint32_t)drawData->terrain->getRegionCount(), sizeof(VkDrawIndexedIndirectCommand));
+	if (this->nodeDescriptorPool.wasCreated())
+		this->nodeDescriptorPool.destroy();
+
+	this->nodeDescriptorPool.addDescriptorLayout(this->descriptorSetLayouts.nodes, 1);
+	this->nodeDescriptorPool.init(1);
+
+	DescriptorSet nodeSet;
+	nodeSet.init(this->descriptorSetLayouts.nodes, &this->nodeDescriptorSet, &this->nodeDescriptorPool);
+	nodeSet.setBufferDesc(0, this->nodeBuffer.getDescriptor());
+	nodeSet.update();
 }
 
-void ym::TerrainRenderer::recordFrustum(DrawData* drawData, uint32_t imageIndex, CommandBuffer* comdBuffer)
+void ym::TerrainRenderer::createCullPipeline()
 {
-	comdBuffer->cmdBindPipeline(&this->frustumPipeline);
-	std::vector<VkDescriptorSet> sets = { drawData->frustumDescriptorSet };
-	std::vector<uint32_t> offsets;
-	comdBuffer->cmdBindDescriptorSets(&this->frustumPipeline, 0, sets, offsets);
-	comdBuffer->cmdDispatch((uint32_t)ceilf((float)drawData->terrain->getRegionCount() / 16), 1, 1);
+	this->descriptorSetLayouts.cull.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // Candidates
+	this->descriptorSetLayouts.cull.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // Views
+	this->descriptorSetLayouts.cull.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // Indirect commands
+	this->descriptorSetLayouts.cull.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // Nodes
+	this->descriptorSetLayouts.cull.init();
+
+	VkPushConstantRange pushConstRange = {};
+	pushConstRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstRange.size = sizeof(CullPushData);
+	pushConstRange.offset = 0;
+	std::vector<DescriptorLayout> descriptorLayouts = { this->descriptorSetLayouts.cull };
+
+	this->cullShader.addStage(Shader::Type::COMPUTE, YM_ASSETS_FILE_PATH + TERRAIN_CULL_SHADER);
+	this->cullShader.init();
+	this->cullPipeline.setPushConstant(pushConstRange);
+	this->cullPipeline.setDescriptorLayouts(descriptorLayouts);
+	this->cullPipeline.init(Pipeline::Type::COMPUTE, &this->cullShader);
 }
 
-void ym::TerrainRenderer::addTerrainToBatch(uint32_t imageIndex, DrawData& drawData)
+void ym::TerrainRenderer::createCullDescriptorSet()
 {
-	if (this->drawBatch.empty())
-		this->drawBatch.resize(this->swapChain->getNumImages());
+	if (this->cullDescriptorPool.wasCreated())
+		this->cullDescriptorPool.destroy();
+
+	this->cullDescriptorPool.addDescriptorLayout(this->descriptorSetLayouts.cull, 1);
+	this->cullDescriptorPool.init(1);
+
+	DescriptorSet cullSet;
+	cullSet.init(this->descriptorSetLayouts.cull, &this->cullDescriptorSet, &this->cullDescriptorPool);
+	cullSet.setBufferDesc(0, this->candidateBuffer.getDescriptor());
+	cullSet.setBufferDesc(1, this->viewBuffer.getDescriptor());
+	cullSet.setBufferDesc(2, this->indirectBuffer.getDescriptor());
+	cullSet.setBufferDesc(3, this->nodeBuffer.getDescriptor());
+	cullSet.update();
+}
 
-	uint64_t id = drawData.terrain->getUniqueID();
-	auto& it = this->drawBatch[imageIndex].find(id);
-	if (it == this->drawBatch[imageIndex].end())
+void ym::TerrainRenderer::reserveBuffers(uint64_t nodeCount, uint32_t drawCount)
+{
+	// Every drawn part is a candidate, and each draw has at most one command for the whole patch and one for each quarter.
+	const uint64_t nodeSize = nodeCount * sizeof(NodeData);
+	const uint64_t candidateSize = nodeCount * sizeof(Candidate);
+	const uint64_t viewSize = (uint64_t)drawCount * sizeof(View);
+	const uint64_t indirectSize = (uint64_t)drawCount * 5 * sizeof(VkDrawIndexedIndirectCommand);
+	bool fits = nodeSize <= this->nodeBuffer.getFrameSize();
+	if (this->gpuCulling)
 	{
-		// Create buffer for transformations.
-		this->drawBatch[imageIndex][id] = drawData;
-		this->drawBatch[imageIndex][id].exists = true;
-
-		// Indirect draw data
-		DrawData& data = this->drawBatch[imageIndex][id];
-		initializeTerrain(data);
+		fits = fits && candidateSize <= this->candidateBuffer.getFrameSize() && viewSize <= this->viewBuffer.getFrameSize()
+			&& indirectSize <= this->indirectBuffer.getFrameSize();
+	}
+	if (fits)
+		return;
 
-		// Tell renderer to recreate descriptors before rendering.
-		this->shouldRecreateDescriptors[imageIndex] = true;
+	// This only happens a few times, it is fine to wait for the GPU.
+	vkDeviceWaitIdle(VulkanInstance::get()->getLogicalDevice());
+	if (grow(this->nodeBuffer, nodeSize))
+	{
+		createNodeDescriptorSet();
+		YM_LOG_INFO("Resized terrain node buffer to {} nodes per frame.", this->nodeBuffer.getFrameSize() / sizeof(NodeData));
 	}
-	else
+	if (this->gpuCulling)
 	{
-		it->second.exists = true;
-		it->second.terrain = drawData.terrain;
+		grow(this->candidateBuffer, candidateSize);
+		grow(this->viewBuffer, viewSize);
+		grow(this->indirectBuffer, indirectSize);
+		createCullDescriptorSet();
+
+		// The commands of the other images were lost with the old buffers.
+		std::fill(this->frameCommandCounts.begin(), this->frameCommandCounts.end(), 0);
+		std::fill(this->frameCandidateCounts.begin(), this->frameCandidateCounts.end(), 0);
 	}
 }
 
-void ym::TerrainRenderer::initializeTerrain(DrawData& drawData)
+void ym::TerrainRenderer::readCullStats(uint32_t imageIndex)
 {
-	// Create and populate indirect draw command buffer.
-	createIndirectDrawBuffer(drawData);
-
-	// Ubos for terrain transformation.
-	drawData.terrainUbo.init(sizeof(TerrainData));
-	drawData.terrainUbo.transfer(&drawData.transform, sizeof(TerrainData), 0);
-
-	// Add initial data to the active buffer.
-	drawData.terrain->fetchVertices(this->proximityWidth, drawData.terrain->getOrigin(), this->vertices);
-	drawData.proximityVertices = this->activeVertexBuffer;
-
-	// Ubo for frustum culling.
-	drawData.proximityDataUBO.init(sizeof(ProximityData));
-	ProximityData proxData = {};
-	proxData.loadedWidth = this->proximityWidth;
-	proxData.numIndicesPerReg = this->indiciesPerRegion;
-	proxData.regionCount = drawData.terrain->getRegionCount();
-	proxData.regWidth = this->regionSize;
-	drawData.proximityDataUBO.transfer(&proxData, sizeof(ProximityData), 0);
+	// The GPU is done with the image, its commands hold the number of parts which passed the culling.
+	const VkDrawIndexedIndirectCommand* commands = static_cast<const VkDrawIndexedIndirectCommand*>(this->indirectBuffer.getData(imageIndex * this->indirectBuffer.getFrameSize()));
+	for (uint32_t c = 0; c < this->frameCommandCounts[imageIndex]; c++)
+		this->stats.gpuDrawnCount += commands[c].instanceCount;
+	this->stats.gpuTestedCount = this->frameCandidateCounts[imageIndex];
 }
 
-void ym::TerrainRenderer::createBuffers()
+ym::TerrainRenderer::TerrainData& ym::TerrainRenderer::getTerrainData(Terrain* terrain)
 {
-	this->vertices.resize((size_t)this->proximityWidth * (size_t)this->proximityWidth);
-
-	// Index buffer
-	std::vector<uint32_t> queueIndices = { VulkanInstance::get()->getComputeQueue().queueIndex, VulkanInstance::get()->getGraphicsQueue().queueIndex, VulkanInstance::get()->getTransferQueue().queueIndex };
-	uint32_t indexBufferSize = sizeof(unsigned) * getProximityIndiciesSize(this->regionSize, this->proximityWidth);
-	this->indexBuffer.init(indexBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
-	this->memoryDeviceLocal.bindBuffer(&this->indexBuffer);
-
-	// Vertex buffers
-	queueIndices = { VulkanInstance::get()->getComputeQueue().queueIndex };
-	this->vertexBuffer1.init(sizeof(Vertex) * this->vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
-	this->vertexBuffer2.init(sizeof(Vertex) * this->vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
-	this->memoryDeviceLocal.bindBuffer(&this->vertexBuffer1);
-	this->memoryDeviceLocal.bindBuffer(&this->vertexBuffer2);
-	this->memoryDeviceLocal.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	// Set inactive and active buffers.
-	this->activeVertexBuffer = &this->vertexBuffer1;
-	this->inactiveVertexBuffer = &this->vertexBuffer2;
-
-	// Staging buffer for vertices and indices.
-	uint64_t stagingBufferSize = glm::max(sizeof(Vertex) * this->vertices.size(), (uint64_t)indexBufferSize);
-	this->stagingBuffer.init(stagingBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { VulkanInstance::get()->getTransferQueue().queueIndex });
-	this->memoryHost.bindBuffer(&this->stagingBuffer);
-	this->memoryHost.init(VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-	// Transfer indices data to device.
-	transferToDevice(&this->indexBuffer, &this->stagingBuffer, &this->memoryHost, this->indices.data(), this->indices.size());
-
-	// Create UBOs for compute shader.
-	this->frustumPlanesUBOs.resize(this->swapChain->getNumImages());
-	for (UniformBuffer& ubo : this->frustumPlanesUBOs)
-		ubo.init(sizeof(PlanesData));
-}
+	auto it = this->terrains.find(terrain->getUniqueID());
+	if (it != this->terrains.end())
+	{
+		it->second.terrain = terrain;
+		return it->second;
+	}
 
-void ym::TerrainRenderer::createDescriptorLayouts()
-{
-	// Frustum
-	this->descriptorSetLayouts.frustum.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // Indirect command draw buffer.
-	this->descriptorSetLayouts.frustum.add(new SSBO(VK_SHADER_STAGE_COMPUTE_BIT)); // Proximity vertices.
-	this->descriptorSetLayouts.frustum.add(new UBO(VK_SHADER_STAGE_COMPUTE_BIT));  // Proximity data. 
-	this->descriptorSetLayouts.frustum.add(new UBO(VK_SHADER_STAGE_COMPUTE_BIT));  // Frustum planes 
-	this->descriptorSetLayouts.frustum.init();
-
-	// Terrain
-	this->descriptorSetLayouts.terrain.add(new UBO(VK_SHADER_STAGE_VERTEX_BIT)); // Transform.
-	this->descriptorSetLayouts.terrain.init();
-
-	// Material
-	this->descriptorSetLayouts.material.add(new IMG(VK_SHADER_STAGE_FRAGMENT_BIT)); // BaseColor
-	this->descriptorSetLayouts.material.add(new IMG(VK_SHADER_STAGE_FRAGMENT_BIT)); // MetallicRoughness
-	this->descriptorSetLayouts.material.add(new IMG(VK_SHADER_STAGE_FRAGMENT_BIT)); // NormalTexture
-	this->descriptorSetLayouts.material.add(new IMG(VK_SHADER_STAGE_FRAGMENT_BIT)); // OcclusionTexture
-	this->descriptorSetLayouts.material.add(new IMG(VK_SHADER_STAGE_FRAGMENT_BIT)); // EmissiveTexture
-	this->descriptorSetLayouts.material.init();
+	TerrainData& terrainData = this->terrains[terrain->getUniqueID()];
+	terrainData.terrain = terrain;
+
+	// The tile cache, the heights are 16 bit integers which are read with texelFetch and filtered in the shader.
+	uint32_t slotCount = terrain->getTiles().getSlotCount();
+	TextureDesc textureDesc = {};
+	textureDesc.width = TERRAIN_TILE_SAMPLES;
+	textureDesc.height = TERRAIN_TILE_SAMPLES;
+	textureDesc.format = VK_FORMAT_R16_UINT;
+	textureDesc.data = nullptr;
+	Texture* texture = new Texture();
+	texture->textureDesc = textureDesc;
+	texture->image.init(textureDesc.width, textureDesc.height, textureDesc.format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, Factory::getQueueIndices(VK_QUEUE_GRAPHICS_BIT), 0, slotCount, 1);
+	texture->memory = new Memory();
+	texture->memory->bindTexture(texture);
+	texture->memory->init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	texture->imageView.init(texture->image.getImage(), VK_IMAGE_VIEW_TYPE_2D_ARRAY, textureDesc.format, VK_IMAGE_ASPECT_COLOR_BIT, slotCount, 1);
+
+	// The slots are only read after a tile has been copied into them, all layers start in the layout they are read in.
+	Image::TransistionDesc desc;
+	desc.format = textureDesc.format;
+	desc.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	desc.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	desc.pool = &LayerManager::get()->getCommandPools()->graphicsPool;
+	desc.layerCount = slotCount;
+	texture->image.transistionLayout(desc);
+	desc.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	desc.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	texture->image.transistionLayout(desc);
+
+	terrainData.sampler.init(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 1);
+	Factory::applyTextureDescriptor(texture, &terrainData.sampler);
+	terrainData.heights = texture;
+
+	terrainData.descriptorPool.addDescriptorLayout(this->descriptorSetLayouts.heights, 1);
+	terrainData.descriptorPool.init(1);
+	DescriptorSet heightSet;
+	heightSet.init(this->descriptorSetLayouts.heights, &terrainData.descriptorSet, &terrainData.descriptorPool);
+	heightSet.setImageDesc(0, texture->descriptor);
+	heightSet.update();
+
+	YM_LOG_INFO("Created tile cache for terrain {} with {} slots.", terrain->getUniqueID(), slotCount);
+	return terrainData;
 }
 
-void ym::TerrainRenderer::recreateDescriptorPool(uint32_t imageIndex, uint32_t terrainCount)
+void ym::TerrainRenderer::stageLoadedTiles(TerrainData& terrainData)
 {
-	// Destroy the descriptor pool and its descriptor sets if it should be recreated.
-	DescriptorPool& descriptorPool = this->descriptorPools[imageIndex];
-	if (descriptorPool.wasCreated())
-		descriptorPool.destroy();
+	uint32_t remaining = TERRAIN_MAX_UPLOADS_PER_FRAME - (uint32_t)this->uploads.size();
+	if (remaining == 0)
+		return;
 
-	// There are many terrains with its own data => own descriptor set, multiply with the number of terrains.
-	descriptorPool.addDescriptorLayout(this->descriptorSetLayouts.terrain, terrainCount);
-	descriptorPool.addDescriptorLayout(this->descriptorSetLayouts.frustum, terrainCount);
-	descriptorPool.addDescriptorLayout(this->descriptorSetLayouts.material, 1);
-
-	descriptorPool.init(1);
+	this->loadedTiles.clear();
+	terrainData.terrain->getTiles().takeLoadedTiles(remaining, this->loadedTiles);
+	for (TerrainTiles::LoadedTile& loadedTile : this->loadedTiles)
+	{
+		// The staging region holds TERRAIN_MAX_UPLOADS_PER_FRAME tiles, this can not fail.
+		uint64_t offset = this->stagingBuffer.allocate(TILE_BYTES, 16);
+		memcpy(this->stagingBuffer.getData(offset), loadedTile.samples.data(), loadedTile.samples.size() * sizeof(uint16_t));
+
+		Upload upload;
+		upload.heights = terrainData.heights;
+		upload.slot = loadedTile.slot;
+		upload.offset = offset;
+		this->uploads.push_back(upload);
+	}
 }
 
-void ym::TerrainRenderer::createDescriptorsSets(uint32_t imageIndex, std::map<uint64_t, DrawData>& drawBatch)
+void ym::TerrainRenderer::writeNodes(TerrainData& terrainData, const DrawData& drawData)
 {
-	VkDevice device = VulkanInstance::get()->getLogicalDevice();
+	Terrain* terrain = drawData.terrain;
+	TerrainTiles& tiles = terrain->getTiles();
+	const Terrain::Description& desc = terrain->getDescription();
+	const std::vector<Terrain::Node>& nodes = drawData.selection.nodes;
+
+	DrawCommand command;
+	command.terrainData = &terrainData;
+	command.pushData.transform = drawData.transform;
+	command.pushData.terrain = glm::vec4(desc.vertDist, desc.origin.y + desc.minZ, desc.maxZ - desc.minZ, 0.f);
+	command.pushData.originExtent = glm::vec4(desc.origin.x, desc.origin.z, (float)(tiles.getWidth() - 1), (float)(tiles.getHeight() - 1));
+	command.pushData.camera = glm::vec4(drawData.cameraPosition, 0.f);
+
+	// The culling tests the parts against the frustum in the space of the terrain, the same planes as the selection.
+	uint32_t viewIndex = 0;
+	if (this->gpuCulling)
+	{
+		YM_ASSERT(drawData.planes.size() == 6, "The frustum needs six planes! Planes: {}", drawData.planes.size());
+		uint64_t viewOffset = this->viewBuffer.allocate(sizeof(View), sizeof(View));
+		View* view = static_cast<View*>(this->viewBuffer.getData(viewOffset));
+		for (uint32_t p = 0; p < 6; p++)
+			view->planes[p] = glm::vec4(drawData.planes[p].normal, -glm::dot(drawData.planes[p].normal, drawData.planes[p].point));
+		viewIndex = (uint32_t)(viewOffset / sizeof(View));
+	}
 
-	// Nodes, Materials and Models
-	for (auto& drawData : drawBatch)
+	// One draw of the whole patch and one for each quarter, the nodes of a draw are consecutive instances.
+	const uint32_t topLod = tiles.getLodCount() - 1;
+	for (uint32_t group = 0; group < 5; group++)
 	{
-		// Terrain
+		const uint32_t mask = group == 0 ? 0xF : 1u << (group - 1);
+		uint32_t count = 0;
+		for (const Terrain::Node& node : nodes)
 		{
-			VkDescriptorSet& descriptorSet = drawData.second.terrain->getDescriptorSet();
-
-			DescriptorSet terrainSet;
-			terrainSet.init(this->descriptorSetLayouts.terrain, &descriptorSet, &this->descriptorPools[imageIndex]);
-			terrainSet.setBufferDesc(0, drawData.second.terrainUbo.getDescriptor());
-			terrainSet.update();
+			bool inGroup = group == 0 ? node.quarters == 0xF : (node.quarters != 0xF && (node.quarters & mask) != 0);
+			if (inGroup && tiles.isResident(node.tile))
+				count++;
 		}
-
-		// Frustum
+		if (count == 0)
+			continue;
+
+		command.firstIndex = group == 0 ? 0 : (group - 1) * QUARTER_INDEX_COUNT;
+		command.indexCount = group == 0 ? QUARTER_INDEX_COUNT * 4 : QUARTER_INDEX_COUNT;
+		uint64_t offset = this->nodeBuffer.allocate(count * sizeof(NodeData), sizeof(NodeData));
+		command.firstInstance = (uint32_t)(offset / sizeof(NodeData));
+		command.instanceCount = count;
+
+		// With GPU culling the nodes become candidates, the shader packs the visible ones at the start of the range of the draw
+		// and counts them in its indirect command.
+		NodeData* nodeData = static_cast<NodeData*>(this->nodeBuffer.getData(offset));
+		Candidate* candidate = nullptr;
+		uint32_t commandIndex = 0;
+		if (this->gpuCulling)
 		{
-			VkDescriptorSet& descriptorSet = drawData.second.frustumDescriptorSet;
-
-			DescriptorSet frustumSet;
-			frustumSet.init(this->descriptorSetLayouts.frustum, &descriptorSet, &this->descriptorPools[imageIndex]);
-			frustumSet.setBufferDesc(0, drawData.second.indirectDrawBuffer.getBuffer(), 0, drawData.second.indirectDrawBuffer.getSize());
-			frustumSet.setBufferDesc(1, drawData.second.proximityVertices->getBuffer(), 0, drawData.second.proximityVertices->getSize());
-			frustumSet.setBufferDesc(2, drawData.second.proximityDataUBO.getDescriptor());
-			frustumSet.setBufferDesc(3, this->frustumPlanesUBOs[imageIndex].getDescriptor());
-			frustumSet.update();
+			command.indirectOffset = this->indirectBuffer.allocate(sizeof(VkDrawIndexedIndirectCommand), sizeof(VkDrawIndexedIndirectCommand));
+			VkDrawIndexedIndirectCommand* indirect = static_cast<VkDrawIndexedIndirectCommand*>(this->indirectBuffer.getData(command.indirectOffset));
+			indirect->indexCount = command.indexCount;
+			indirect->instanceCount = 0;
+			indirect->firstIndex = command.firstIndex;
+			indirect->vertexOffset = 0;
+			indirect->firstInstance = command.firstInstance;
+			commandIndex = (uint32_t)(command.indirectOffset / sizeof(VkDrawIndexedIndirectCommand));
+
+			uint64_t candidateOffset = this->candidateBuffer.allocate(count * sizeof(Candidate), sizeof(Candidate));
+			candidate = static_cast<Candidate*>(this->candidateBuffer.getData(candidateOffset));
 		}
 
-		// Materials
-		/*std::vector<Material> & materials = drawData.second.model->materials;
-		for (Material& material : materials)
+		for (const Terrain::Node& node : nodes)
 		{
-			if (material.descriptorSets.empty())
-				material.descriptorSets.resize(this->swapChain->getNumImages(), VK_NULL_HANDLE);
-
+			bool inGroup = group == 0 ? node.quarters == 0xF : (node.quarters != 0xF && (node.quarters & mask) != 0);
+			uint32_t slot = tiles.getSlot(node.tile);
+			if (inGroup == false || slot == TERRAIN_TILE_NOT_RESIDENT)
+				continue;
+
+			NodeData data;
+			glm::uvec2 tileOrigin = tiles.getTileOrigin(node.tile);
+			data.node = glm::vec4((float)node.x, (float)node.z, (float)(1u << node.lod), 0.f);
+			if (node.lod == topLod)
+				data.morph = glm::vec4(NO_MORPH_DISTANCE, NO_MORPH_DISTANCE * 2.f, 0.f, 0.f);
+			else
+				data.morph = glm::vec4(terrain->getMorphStart(node.lod), terrain->getLodRange(node.lod), 0.f, 0.f);
+			data.tile = glm::vec4((float)tileOrigin.x, (float)tileOrigin.y, (float)(1u << tiles.getTileLod(node.tile)), (float)slot);
+
+			if (candidate == nullptr)
 			{
-				// Create descriptor sets for each material.
-				std::vector<Material::Tex> textures = {
-						material.baseColorTexture,
-						material.metallicRoughnessTexture,
-						material.normalTexture,
-						material.occlusionTexture,
-						material.emissiveTexture
-				};
-
-				std::array<VkDescriptorImageInfo, 5> imageInfos;
-				for (size_t j = 0; j < textures.size(); j++)
-				{
-					Material::Tex& tex = textures[j];
-					imageInfos[j].imageLayout = tex.texture->image.getLayout();
-					imageInfos[j].imageView = tex.texture->imageView.getImageView();
-					imageInfos[j].sampler = tex.sampler->getSampler();
-				}
-
-				{
-					DescriptorSet materialSet;
-					materialSet.init(descriptorSetLayouts.material, &material.descriptorSets[imageIndex], &this->descriptorPools[imageIndex]);
-					for (uint32_t binding = 0; binding < 5; binding++)
-						materialSet.setImageDesc(binding, imageInfos[binding]);
-					materialSet.update();
-				}
+				*nodeData = data;
+				nodeData++;
+				continue;
 			}
-		}*/
-	}
-}
-
-uint32_t ym::TerrainRenderer::getProximityIndiciesSize(int32_t regionSize, int32_t proximityWidth)
-{
-	const uint32_t numQuads = regionSize - 1;
-	uint32_t regionCount = static_cast<uint32_t>(ceilf((proximityWidth - 1) / (float)(regionSize - 1)));
-	uint32_t size = regionCount * regionCount * numQuads * numQuads * 6;
-	return size;
-}
 
-void ym::TerrainRenderer::generateIndicies(int32_t regionSize, int32_t proximityRadius)
-{	
-	const int numQuads = regionSize - 1;
-
-	int regionCount = static_cast<int>(ceilf(((proximityRadius - 1) / (float)(regionSize - 1))));
-
-	int vertOffsetX = 0;
-	int vertOffsetZ = 0;
-
-	int index = 0;
-	uint32_t size = regionCount * regionCount * numQuads * numQuads * 6;
-	this->indices.resize(size, 0);
-	for (int j = 0; j < regionCount; j++)
-	{
-		for (int i = 0; i < regionCount; i++)
-		{
-			for (int z = vertOffsetZ; z < vertOffsetZ + numQuads; z++)
+			// A quarter has the bounds of the child node it replaces.
+			Terrain::Bounds bounds;
+			if (group == 0)
+				bounds = terrain->getNodeBounds(node.x, node.z, node.lod);
+			else
 			{
-				for (int x = vertOffsetX; x < vertOffsetX + numQuads; x++)
-				{
-					// First triangle
-					this->indices[index++] = (z * proximityRadius + x);
-					this->indices[index++] = ((z + 1) * proximityRadius + x);
-					this->indices[index++] = ((z + 1) * proximityRadius + x + 1);
-					// Second triangle
-					this->indices[index++] = (z * proximityRadius + x);
-					this->indices[index++] = ((z + 1) * proximityRadius + x + 1);
-					this->indices[index++] = (z * proximityRadius + x + 1);
-				}
+				const uint32_t quarter = group - 1;
+				const uint32_t half = TERRAIN_PATCH_SIZE << (node.lod - 1);
+				bounds = terrain->getNodeBounds(node.x + (quarter & 1) * half, node.z + (quarter >> 1) * half, node.lod - 1);
 			}
-			vertOffsetX = (vertOffsetX + numQuads) % (proximityRadius - 1);
+			candidate->node = data;
+			candidate->boundsMin = glm::vec4(bounds.min, 0.f);
+			candidate->boundsMax = glm::vec4(bounds.max, 0.f);
+			candidate->view = viewIndex;
+			candidate->command = commandIndex;
+			candidate++;
 		}
-		vertOffsetZ += numQuads;
-	}
-}
-
-void ym::TerrainRenderer::createIndirectDrawBuffer(DrawData& drawData)
-{
-	uint32_t regionCount = (uint32_t)drawData.terrain->getRegionCount();
-
-	drawData.indirectDrawBuffer.init(sizeof(VkDrawIndexedIndirectCommand) * regionCount, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		{ VulkanInstance::get()->getGraphicsQueue().queueIndex });
-	drawData.memoryDeviceLocal.bindBuffer(&drawData.indirectDrawBuffer);
-	drawData.memoryDeviceLocal.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	Buffer stagingBuffer;
-	Memory stagingMemory;
-	stagingBuffer.init(sizeof(VkDrawIndexedIndirectCommand) * regionCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { VulkanInstance::get()->getTransferQueue().queueIndex });
-	stagingMemory.bindBuffer(&stagingBuffer);
-	stagingMemory.init(VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-	std::vector<VkDrawIndexedIndirectCommand> indirectData(regionCount);
-
-	for (size_t i = 0; i < indirectData.size(); i++) {
-		indirectData[i].instanceCount = 1;
-		indirectData[i].firstInstance = (uint32_t)i;
-	}
-
-	stagingMemory.directTransfer(&stagingBuffer, indirectData.data(), indirectData.size(), 0);
-
-	CommandBuffer* cbuff = this->commandPoolGraphics.beginSingleTimeCommand();
-	NameBinder::bindObject((uint64_t)cbuff->getCommandBuffer(), "Single Time Command Buffer for initial transfer of indirect command buffer [Terrain]");
-
-	// Copy indirect command buffer data.
-	VkBufferCopy region = {};
-	region.srcOffset = 0;
-	region.dstOffset = 0;
-	region.size = indirectData.size();
-	cbuff->cmdCopyBuffer(stagingBuffer.getBuffer(), drawData.indirectDrawBuffer.getBuffer(), 1, &region);
-
-	cbuff->releaseBuffer(&drawData.indirectDrawBuffer, VK_ACCESS_TRANSFER_READ_BIT, VulkanInstance::get()->getGraphicsQueue().queueIndex, VulkanInstance::get()->getComputeQueue().queueIndex,
-		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
-
-	this->commandPoolGraphics.endSingleTimeCommand(cbuff);
-
-	stagingBuffer.destroy();
-	stagingMemory.destroy();
-}
-
-void ym::TerrainRenderer::verticesToDevice(Buffer* device, std::vector<Vertex>& vertices)
-{
-	transferToDevice(device, &this->stagingBuffer, &this->memoryHost, vertices.data(), sizeof(Vertex) * vertices.size());
-}
-
-void ym::TerrainRenderer::transferToDevice(Buffer* buffer, Buffer* stagingBuffer, Memory* stagingMemory, void* data, uint64_t size)
-{
-	stagingMemory->directTransfer(stagingBuffer, data, size, 0);
-
-	CommandBuffer* cbuff = this->commanPoolTransfer.beginSingleTimeCommand();
-	NameBinder::bindObject((uint64_t)cbuff->getCommandBuffer(), "Single Time Command Buffer for function \"transferToDevice\" [Terrain]");
-
-	// Copy vertex data.
-	VkBufferCopy region = {};
-	region.srcOffset = 0;
-	region.dstOffset = 0;
-	region.size = size;
-	cbuff->cmdCopyBuffer(stagingBuffer->getBuffer(), buffer->getBuffer(), 1, &region);
-
-	this->commanPoolTransfer.endSingleTimeCommand(cbuff);
-}
-
-void ym::TerrainRenderer::swapActiveBuffers()
-{
-	if (this->activeVertexBuffer == &this->vertexBuffer1)
-	{
-		this->activeVertexBuffer = &this->vertexBuffer2;
-		this->inactiveVertexBuffer = &this->vertexBuffer1;
-	}
-	else
-	{
-		this->activeVertexBuffer = &this->vertexBuffer1;
-		this->inactiveVertexBuffer = &this->vertexBuffer2;
+		this->drawCommands.push_back(command);
 	}
 }
@@ -7,28 +7,60 @@
 #include "Engine/Core/Vulkan/CommandPool.h"
 #include "Engine/Core/Vulkan/Pipeline/Shader.h"
 #include "Engine/Core/Vulkan/Pipeline/Pipeline.h"
-#include "Engine/Core/Camera.h"
-#include "Engine/Core/Graphics/SceneData.h"
+#include "Engine/Core/Vulkan/Pipeline/DescriptorLayout.h"
 #include "Engine/Core/Vulkan/Pipeline/DescriptorPool.h"
 #include "Engine/Core/Vulkan/Buffers/Buffer.h"
 #include "Engine/Core/Vulkan/Buffers/Memory.h"
-#include "Engine/Core/Vulkan/Buffers/UniformBuffer.h"
+#include "Engine/Core/Vulkan/Buffers/RingBuffer.h"
+#include "Engine/Core/Vulkan/Texture.h"
+#include "Engine/Core/Vulkan/Sampler.h"
+#include "Engine/Core/Camera.h"
+#include "Engine/Core/Graphics/RenderInheritanceData.h"
+
+#define TERRAIN_MAX_UPLOADS_PER_FRAME 8			// Tiles copied into their slots each frame, the rest wait for the next frame.
+#define TERRAIN_NODE_BUFFER_START_COUNT 1024	// Number of nodes each frame can hold before the buffer needs to grow.
+#define TERRAIN_CULL_WORKGROUP_SIZE 64			// Needs to match local_size_x in terrainCullComp.glsl.
+#define TERRAIN_CULL_SHADER "Shaders/terrainCullComp.spv"
 
 namespace ym
 {
+	/*
+		Draws CDLOD terrains. Every node is an instance of the same grid patch, the vertices are generated from the vertex index and
+		their heights are read from the tile cache of the terrain, a texture array with one layer for each slot of its tiles.
+
+		With Terrain/gpuCulling the selection only culls the first levels, every whole node and quarter below them is culled against
+		the frustum by a compute shader on the compute queue. It packs the visible nodes of each draw and counts them in the indirect
+		draw commands, the graphics submit waits for it with a semaphore. The terrain is culled on the CPU if the device does not
+		support indirect draws with a first instance or the cull shader has not been compiled.
+	*/
 	class TerrainRenderer
 	{
+	public:
+		struct Stats
+		{
+			uint32_t nodeCount{ 0 };
+			uint32_t fallbackCount{ 0 };	// Nodes drawn with a coarser tile while their own tile is loading.
+			uint64_t triangleCount{ 0 };
+			uint32_t uploadCount{ 0 };		// Tiles copied into their slots this frame.
+			float selectMs{ 0.f };
+			TerrainTiles::Stats tiles;
+
+			// Whole nodes and quarters culled on the GPU by the last frame which used this image, read back when it is used again.
+			uint32_t gpuTestedCount{ 0 };
+			uint32_t gpuDrawnCount{ 0 };
+		};
+
 	public:
 		TerrainRenderer();
 		~TerrainRenderer();
 
-		void init(SwapChain* swapChain, uint32_t threadID, RenderPass* renderPass, SceneDescriptors* sceneDescriptors);
+		void init(SwapChain* swapChain, uint32_t threadID, RenderPass* renderPass, RenderInheritanceData* renderInheritanceData);
 		void destroy();
 
 		/*
-			Set the active camera which will be used when drawing.
+			Set the camera which the nodes are selected for. Needs to be set before end.
 		*/
-		void setActiveCamera(Camera* camera);
+		void setView(const glm::vec3& cameraPosition, const std::vector<Camera::Plane>& planes);
 
 		/*
 			Prepare to draw.
@@ -36,127 +68,176 @@ namespace ym
 		void begin(uint32_t imageIndex, VkCommandBufferInheritanceInfo inheritanceInfo);
 
 		/*
-			Draw the specified terrrain.
+			Draw the specified terrain.
 		*/
 		void drawTerrain(uint32_t imageIndex, Terrain* terrain, const glm::mat4& transform);
 
 		/*
-			Gather and record draw commands.
+			Select the nodes of the terrains, stage the tiles which finished loading and record the draw commands.
 		*/
 		void end(uint32_t imageIndex);
 
-		void preRecordGraphics(uint32_t imageIndex, CommandBuffer* commandBuffer);
-		void postRecordGraphics(uint32_t imageIndex, CommandBuffer* commandBuffer);
+		/*
+			Record the copies of the staged tiles into their slots, outside of the render pass which executes the buffers from getBuffers.
+		*/
+		void recordUploads(CommandBuffer* cmdBuffer);
+
+		/*
+			Record the culling of the nodes into a command buffer of the compute queue, the buffers from getBuffers need to wait for
+			it. Only needs to be submitted if isCulling is true.
+		*/
+		void recordCulling(CommandBuffer* cmdBuffer);
+		bool isCulling() const { return this->gpuCulling && this->cullPushData.candidateCount > 0; }
 
-		void preRecordCompute(uint32_t imageIndex, CommandBuffer* commandBuffer);
-		void postRecordCompute(uint32_t imageIndex, CommandBuffer* commandBuffer);
+		const Stats& getStats() const { return this->stats; }
+		bool isGpuCulling() const { return this->gpuCulling; }
 
-		std::vector<CommandBuffer*>& getGraphicsBuffers();
-		std::vector<CommandBuffer*>& getComputeBuffers();
+		/*
+			Draw the stats in an ImGui window, with the nodes which were tested and drawn by the GPU culling.
+		*/
+		void drawStats();
+		std::vector<CommandBuffer*>& getBuffers();
 
 	private:
-		struct TerrainData
+		// Per node data read by the vertex shader, matches Node in terrainVert.glsl.
+		struct NodeData
+		{
+			glm::vec4 node;
+			glm::vec4 morph;
+			glm::vec4 tile;
+		};
+
+		struct PushData
 		{
 			glm::mat4 transform;
+			glm::vec4 terrain;
+			glm::vec4 originExtent;
+			glm::vec4 camera;
 		};
 
-		struct ProximityData
+		// Layouts match the std430 structs of terrainCullComp.glsl.
+		struct Candidate
 		{
-			uint32_t regWidth;           // Region width in number of vertices.
-			uint32_t numIndicesPerReg;   // Number of indices per region.
-			uint32_t loadedWidth;        // Loaded world width in verticies
-			uint32_t regionCount;
+			NodeData node;
+			glm::vec4 boundsMin;
+			glm::vec4 boundsMax;
+			uint32_t view;
+			uint32_t command;
+			uint32_t pad[2];
 		};
 
-		struct PlanesData
+		struct View
 		{
-			Camera::Plane planes[6];  // Combination of normal (Pointing inwards) and position.
+			glm::vec4 planes[6];
+		};
+
+		struct CullPushData
+		{
+			uint32_t candidateBase;
+			uint32_t candidateCount;
+		};
+
+		// Resources of a terrain, created the first time it is drawn.
+		struct TerrainData
+		{
+			Terrain* terrain{ nullptr };
+			Texture* heights{ nullptr };	// One layer for each slot.
+			Sampler sampler;
+			DescriptorPool descriptorPool;
+			VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+			bool drawn{ false }; // The loaded tiles are only staged once per frame, even if the terrain is drawn several times.
 		};
 
 		struct DrawData
 		{
-			bool exists{ false }; // This is false when a terrain was removed. Will ensure that we do not recreate the descriptor pool if removing terrains only when adding.
 			Terrain* terrain{ nullptr };
 			glm::mat4 transform;
-
-			Buffer indirectDrawBuffer;
-			Buffer* proximityVertices{nullptr};
-			Memory memoryDeviceLocal;
-			UniformBuffer terrainUbo;
-
-			UniformBuffer proximityDataUBO;
-			VkDescriptorSet frustumDescriptorSet;
+			glm::vec3 cameraPosition; // In the space of the terrain.
+			std::vector<Camera::Plane> planes;
+			Terrain::Selection selection;
 		};
 
-		void clearDrawBatch(uint32_t imageIndex);
-
-		void recordTerrain(DrawData* drawData, uint32_t imageIndex, CommandBuffer* cmdBuffer);
-		void recordFrustum(DrawData* drawData, uint32_t imageIndex, CommandBuffer* comdBuffer);
-
-		void addTerrainToBatch(uint32_t imageIndex, DrawData& drawData);
-		void initializeTerrain(DrawData& drawData);
-
-		void createBuffers();
-
-		void createDescriptorLayouts();
-		void recreateDescriptorPool(uint32_t imageIndex, uint32_t terrainCount);
-		void createDescriptorsSets(uint32_t imageIndex, std::map<uint64_t, DrawData>& drawBatch);
-
-		uint32_t getProximityIndiciesSize(int32_t regionSize, int32_t proximityWidth);
-		void generateIndicies(int32_t regionSize, int32_t proximityRadius);
+		// Instanced draw of the whole patch or of one of its quarters.
+		struct DrawCommand
+		{
+			TerrainData* terrainData{ nullptr };
+			PushData pushData;
+			uint32_t firstIndex{ 0 };
+			uint32_t indexCount{ 0 };
+			uint32_t firstInstance{ 0 };
+			uint32_t instanceCount{ 0 };
+			VkDeviceSize indirectOffset{ 0 }; // Offset of the indirect command when the nodes are culled on the GPU.
+		};
 
-		void createIndirectDrawBuffer(DrawData& drawData);
-		void verticesToDevice(Buffer* device, std::vector<Vertex>& vertices);
-		void transferToDevice(Buffer* buffer, Buffer* stagingBuffer, Memory* stagingMemory, void* data, uint64_t size);
+		void createIndexBuffer();
+		void createNodeDescriptorSet();
+		void createCullPipeline();
+		void createCullDescriptorSet();
+		void reserveBuffers(uint64_t nodeCount, uint32_t drawCount);
+		void readCullStats(uint32_t imageIndex);
+		TerrainData& getTerrainData(Terrain* terrain);
 
-		void swapActiveBuffers();
+		void stageLoadedTiles(TerrainData& terrainData);
+		void writeNodes(TerrainData& terrainData, const DrawData& drawData);
 
 	private:
 		SwapChain* swapChain;
 		VkCommandBufferInheritanceInfo inheritanceInfo;
-		Camera* activeCamera{ nullptr };
-		SceneDescriptors* sceneDescriptors{ nullptr };
+		RenderInheritanceData* renderInheritanceData;
 
-		std::vector<bool> shouldRecreateDescriptors;
-		std::vector<std::map<uint64_t, DrawData>> drawBatch;
+		glm::vec3 cameraPosition;
+		std::vector<Camera::Plane> planes;
 
-		// Terrain descriptors
-		std::vector<DescriptorPool> descriptorPools;
+		std::vector<DrawData> draws; // Draws of this frame are the first drawCount, the rest keep their memory for the next frame.
+		uint32_t drawCount;
+		std::map<uint64_t, TerrainData> terrains; // Keyed by the unique id of the terrain.
+		std::vector<DrawCommand> drawCommands;
+		Stats stats;
+
+		// Descriptors
 		struct DescriptorSetLayouts
 		{
-			DescriptorLayout frustum;	// Holds indirect command buffer, vertices, frustum planes, and proximity data.
-			DescriptorLayout terrain;   // Holds instance transformations.
-			DescriptorLayout material;	// Holds data of a specific material.
+			DescriptorLayout nodes;		// Holds the nodes of all terrains.
+			DescriptorLayout heights;	// Holds the tile cache of a terrain.
+			DescriptorLayout cull;		// Holds the buffers of the culling.
 		} descriptorSetLayouts;
+		DescriptorPool nodeDescriptorPool;
+		VkDescriptorSet nodeDescriptorSet;
 
-		// Terrain data
-		Buffer* activeVertexBuffer{nullptr};
-		Buffer* inactiveVertexBuffer{ nullptr };
-		Buffer vertexBuffer1;
-		Buffer vertexBuffer2;
+		// Index buffer of the patch, the indices of each quarter are stored one after another.
 		Buffer indexBuffer;
-		Memory memoryDeviceLocal;
-		Memory memoryHost;
-		Buffer stagingBuffer;
-		std::vector<Vertex> vertices;
-		std::vector<uint32_t> indices;
-
-		int32_t regionSize;
-		int32_t proximityRadius;
-		int32_t proximityWidth;
-		int32_t indiciesPerRegion;
-		std::vector<UniformBuffer> frustumPlanesUBOs;
+		Memory indexMemory;
+
+		// Nodes of all terrains and the staged tiles, one region for each image.
+		RingBuffer nodeBuffer;
+		RingBuffer stagingBuffer;
+		struct Upload
+		{
+			Texture* heights;
+			uint32_t slot;
+			uint64_t offset;
+		};
+		std::vector<Upload> uploads;
+		std::vector<TerrainTiles::LoadedTile> loadedTiles;
+
+		// GPU culling, the candidates are culled into the node buffer. All buffers are shared with the compute queue.
+		bool gpuCulling;
+		RingBuffer candidateBuffer;
+		RingBuffer viewBuffer;
+		RingBuffer indirectBuffer;
+		DescriptorPool cullDescriptorPool;
+		VkDescriptorSet cullDescriptorSet;
+		CullPushData cullPushData;
+		std::vector<uint32_t> frameCommandCounts; // Indirect commands and candidates of each image, for the stats.
+		std::vector<uint32_t> frameCandidateCounts;
+		Pipeline cullPipeline;
+		Shader cullShader;
 
 		// Thread data
-		std::vector<CommandBuffer*> commandBuffersGraphics;
-		std::vector<CommandBuffer*> commandBuffersCompute;
-		CommandPool commandPoolGraphics;
-		CommandPool commandPoolCompute;
-		CommandPool commanPoolTransfer;
+		std::vector<CommandBuffer*> commandBuffers;
+		CommandPool commandPool;
 		uint32_t threadID;
 		Pipeline pipeline;
 		Shader shader;
-		Pipeline frustumPipeline;
-		Shader frustumShader;
 	};
 }
@@ -7,6 +7,10 @@
 #define TINYGLTF_NO_INCLUDE_JSON
 
 #include "GLTFLoader.h"
+#include "ModelCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Model/GeometryArena.h"
 #include "Engine/Core/Vulkan/VulkanInstance.h"
 #include "Engine/Core/Vulkan/SwapChain.h"
 #include "Engine/Core/Vulkan/CommandPool.h"
@@ -18,53 +22,126 @@
 #include <glm/gtx/quaternion.hpp>		// toMat4()
 #include <glm/gtx/rotate_vector.hpp>
 #include <glm/gtc/type_ptr.hpp>			// make_vec3(), make_mat4()
+#include <cfloat>
 
 #include "Engine/Core/Vulkan/Factory.h"
 #include "Engine/Core/Application/LayerManager.h"
 
-#include "Engine/Core/Threading/ThreadManager.h"
-#include "Engine/Core/Threading/ThreadIndices.h"
+#include "Engine/Core/Threading/JobSystem.h"
+#include "Engine/Core/Input/Config.h"
+#include "Utils/Timer.h"
 
 #include "Engine/Core/Vulkan/CommandPool.h"
 
 namespace ym
 {
+	namespace
+	{
+		template<typename Function>
+		void forEachPrimitive(std::vector<Model::Node>& nodes, Function function)
+		{
+			for (Model::Node& node : nodes)
+			{
+				for (Primitive& primitive : node.mesh.primitives)
+					function(primitive);
+				forEachPrimitive(node.children, function);
+			}
+		}
+	}
+
 	Model GLTFLoader::model = Model();
-	tinygltf::TinyGLTF GLTFLoader::loader = tinygltf::TinyGLTF();
+	bool GLTFLoader::packVertices = false;
 	GLTFLoader::DefaultData GLTFLoader::defaultData;
 	CommandPool* GLTFLoader::commandPool = nullptr;
+	CommandPool* GLTFLoader::transferPool = nullptr;
 
 	std::queue<GLTFLoader::ThreadData> GLTFLoader::modelQueue;
+	std::vector<GLTFLoader::Upload> GLTFLoader::uploads;
+	VkSemaphore GLTFLoader::transferSemaphore = VK_NULL_HANDLE;
+	VkSemaphore GLTFLoader::graphicsSemaphore = VK_NULL_HANDLE;
+	uint64_t GLTFLoader::transferValue = 0;
+	uint64_t GLTFLoader::graphicsValue = 0;
 	std::mutex GLTFLoader::mutex;
 	std::set<Model*> GLTFLoader::modelSet; // Used for debugging to check if trying to load to the same model from a thread.
+	std::vector<GLTFLoader::AssetTiming> GLTFLoader::assetTimings;
+
+	uint32_t GLTFLoader::decodesInFlight = 0;
+	std::mutex GLTFLoader::decodeMutex;
+	std::condition_variable GLTFLoader::decodeCondition;
 
 	void GLTFLoader::init()
 	{
 		commandPool = new CommandPool();
 		commandPool->init(CommandPool::Queue::GRAPHICS, 0);
+		transferPool = new CommandPool();
+		transferPool->init(CommandPool::Queue::TRANSFER, 0);
 		initDefaultData(commandPool);
+		packVertices = Config::get()->fetch<bool>("Graphics/packedVertices");
+
+		VkSemaphoreTypeCreateInfo typeCreateInfo = {};
+		typeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeCreateInfo.initialValue = 0;
+		VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+		semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreCreateInfo.pNext = &typeCreateInfo;
+		VkDevice device = VulkanInstance::get()->getLogicalDevice();
+		VULKAN_CHECK(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &transferSemaphore), "Failed to create upload semaphore!");
+		VULKAN_CHECK(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &graphicsSemaphore), "Failed to create upload semaphore!");
+		transferValue = 0;
+		graphicsValue = 0;
 	}
 
 	void GLTFLoader::destroy()
 	{
+		// Wait for the models which are still uploading.
+		VkDevice device = VulkanInstance::get()->getLogicalDevice();
+		VkSemaphore semaphores[2] = { transferSemaphore, graphicsSemaphore };
+		uint64_t values[2] = { transferValue, graphicsValue };
+		VkSemaphoreWaitInfo waitInfo = {};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 2;
+		waitInfo.pSemaphores = semaphores;
+		waitInfo.pValues = values;
+		vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+		for (Upload& upload : uploads)
+			finishUpload(upload);
+		uploads.clear();
+		vkDestroySemaphore(device, transferSemaphore, nullptr);
+		vkDestroySemaphore(device, graphicsSemaphore, nullptr);
+
 		destroyDefaultData();
 		commandPool->destroy();
 		SAFE_DELETE(commandPool);
+		transferPool->destroy();
+		SAFE_DELETE(transferPool);
 	}
 
 	void GLTFLoader::update()
 	{
-		CommandPool* graphicsPool = &LayerManager::get()->getCommandPools()->graphicsPool;
-		std::lock_guard<std::mutex> lck(mutex);
-		while (modelQueue.empty() == false)
+		// Finish the uploads which the GPU has completed.
+		for (auto it = uploads.begin(); it != uploads.end();)
 		{
-			ThreadData& data = modelQueue.front();
-			data.stagingBuffers->initMemory();
-			transferToGPU(graphicsPool, data.model, data.stagingBuffers);
-			data.stagingBuffers->destroy();
-			SAFE_DELETE(data.stagingBuffers);
-			modelQueue.pop();
-			modelSet.erase(data.model);
+			if (isUploadDone(*it))
+			{
+				finishUpload(*it);
+				it = uploads.erase(it);
+			}
+			else
+				it++;
+		}
+
+		// Submit the models which have been loaded to RAM. The staging data was written on the thread, this only records commands.
+		std::queue<ThreadData> loadedModels;
+		{
+			std::lock_guard<std::mutex> lck(mutex);
+			std::swap(loadedModels, modelQueue);
+		}
+		while (loadedModels.empty() == false)
+		{
+			ThreadData& data = loadedModels.front();
+			submitUpload(data.model, data.stagingBuffers);
+			loadedModels.pop();
 		}
 	}
 
@@ -72,11 +149,12 @@ namespace ym
 	{
 		if (modelSet.insert(model).second)
 		{
-			ThreadManager::addWork((uint32_t)ThreadIndices::GLTF_LOADER, [=]() {
+			JobSystem::execute([=]() {
 				ThreadData threadData;
 				threadData.model = model;
 				threadData.stagingBuffers = new StagingBuffers();
 				loadToRAM(filePath, model, threadData.stagingBuffers);
+				writeStagingData(model, threadData.stagingBuffers);
 
 				{
 					std::lock_guard<std::mutex> lck(mutex);
@@ -90,15 +168,30 @@ namespace ym
 		}
 	}
 
+	uint32_t GLTFLoader::getPendingUploadCount()
+	{
+		return (uint32_t)uploads.size();
+	}
+
+	std::vector<GLTFLoader::AssetTiming> GLTFLoader::getAssetTimings()
+	{
+		std::lock_guard<std::mutex> lck(mutex);
+		return assetTimings;
+	}
+
+	void GLTFLoader::clearAssetTimings()
+	{
+		std::lock_guard<std::mutex> lck(mutex);
+		assetTimings.clear();
+	}
+
 	void GLTFLoader::load(const std::string& filePath, Model* model)
 	{
 		if (model->vertices.empty())
 		{
-			CommandPool* graphicsPool = &LayerManager::get()->getCommandPools()->graphicsPool;
 			StagingBuffers stagingBuffers;
 			loadToRAM(filePath, model, &stagingBuffers);
-			stagingBuffers.initMemory();
-			transferToGPU(graphicsPool, model, &stagingBuffers);
+			transferToGPU(model, &stagingBuffers);
 			stagingBuffers.destroy();
 		}
 		else
@@ -112,72 +205,73 @@ namespace ym
 		loadModel(*model, filePath, stagingBuffers);
 	}
 
-	void GLTFLoader::transferToGPU(CommandPool * transferCommandPool, Model * model, StagingBuffers * stagingBuffers)
+	void GLTFLoader::transferToGPU(Model * model, StagingBuffers * stagingBuffers)
 	{
-		// Transfer all images their coresponding textures
-		uint64_t totalTextureSize = 0;
-		for (uint32_t textureIndex = 0; textureIndex < model->textures.size(); textureIndex++)
-		{
-			Texture& texture = model->textures[textureIndex];
-			const uint32_t wh = texture.textureDesc.width * texture.textureDesc.height;
-			const uint64_t size = wh * 4;
-			totalTextureSize += size;
-
-			// Transfer the data to the buffer.
-			std::vector<uint8_t> data = model->imageData[textureIndex];
-			uint8_t* img = data.data();
-			stagingBuffers->imageMemory.directTransfer(&stagingBuffers->imageBuffer, (void*)img, size, textureIndex * size);
-
-			// Setup a buffer copy region for the transfer.
-			std::vector<VkBufferImageCopy> bufferCopyRegions;
-			VkBufferImageCopy bufferCopyRegion = {};
-			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			bufferCopyRegion.imageSubresource.mipLevel = 0;
-			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-			bufferCopyRegion.imageSubresource.layerCount = 1;
-			bufferCopyRegion.imageExtent.width = texture.textureDesc.width;
-			bufferCopyRegion.imageExtent.height = texture.textureDesc.height;
-			bufferCopyRegion.imageExtent.depth = 1;
-			bufferCopyRegion.bufferOffset = textureIndex * size;
-			bufferCopyRegions.push_back(bufferCopyRegion);
-
-
-			// Transfer data to texture memory.
-			Image::TransistionDesc desc;
-			desc.format = texture.textureDesc.format;
-			desc.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			desc.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			desc.pool = transferCommandPool;
-			desc.layerCount = 1;
-			
+		writeStagingData(model, stagingBuffers);
 
-			texture.image.transistionLayout(desc);
-			texture.image.copyBufferToImage(&stagingBuffers->imageBuffer, transferCommandPool, bufferCopyRegions);
+		CommandBuffer* cbuff = transferPool->beginSingleTimeCommand();
+		recordTransfer(cbuff, model, stagingBuffers);
+		transferPool->endSingleTimeCommand(cbuff);
 
-			uint32_t mipLevels = texture.image.getMipLevels();
-			if (mipLevels == 1)
-			{
-				desc.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				desc.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				texture.image.transistionLayout(desc);
-			}
-			else
-			{
-				Factory::generateMipmaps(&texture);
-			}
+		if (model->textures.empty() == false && stagingBuffers->hasMipLevels == false)
+		{
+			cbuff = commandPool->beginSingleTimeCommand();
+			recordGraphics(cbuff, model);
+			commandPool->endSingleTimeCommand(cbuff);
 		}
-		model->imageData.clear();
 
+		model->hasLoaded = true;
+		YM_LOG_INFO("Transfered model to GPU.");
+	}
 
-		// Transfer data to buffers
-		uint32_t indicesSize = (uint32_t)(model->indices.size() * sizeof(uint32_t));
-		uint32_t verticesSize = (uint32_t)(model->vertices.size() * sizeof(Vertex));
+	void GLTFLoader::writeStagingData(Model * model, StagingBuffers * stagingBuffers)
+	{
+		// The images were decoded to the staging buffer when they were loaded.
+		stagingBuffers->initMemory();
+
+		const uint64_t indicesSize = getIndicesSize(*model);
+		const uint64_t verticesSize = getVerticesSize(*model);
+		uint8_t* stagingData = static_cast<uint8_t*>(stagingBuffers->geometryMemory.getMappedData(&stagingBuffers->geometryBuffer));
+
+		// The indices of each primitive and its levels of detail are made relative to its first vertex, which the draw adds back as the vertex offset.
 		if (indicesSize > 0)
-			stagingBuffers->geometryMemory.directTransfer(&stagingBuffers->geometryBuffer, (const void*)model->indices.data(), indicesSize, (Offset)0);
-		stagingBuffers->geometryMemory.directTransfer(&stagingBuffers->imageBuffer, (const void*)model->vertices.data(), verticesSize, (Offset)indicesSize);
+		{
+			uint16_t* indices16 = reinterpret_cast<uint16_t*>(stagingData);
+			uint32_t* indices32 = reinterpret_cast<uint32_t*>(stagingData);
+			auto writeIndices = [&](uint32_t firstIndex, uint32_t indexCount, uint32_t firstVertex) {
+				for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++)
+				{
+					const uint32_t index = model->indices[i] - firstVertex;
+					if (model->indexType == VK_INDEX_TYPE_UINT16)
+						indices16[i] = (uint16_t)index;
+					else
+						indices32[i] = index;
+				}
+			};
+			forEachPrimitive(model->nodes, [&](Primitive& primitive) {
+				if (primitive.hasIndices == false)
+					return;
+				writeIndices(primitive.firstIndex, primitive.indexCount, primitive.firstVertex);
+				for (Primitive::Lod& lod : primitive.lods)
+					writeIndices(lod.firstIndex, lod.indexCount, primitive.firstVertex);
+			});
+		}
+
+		if (model->vertexFormat == VertexFormat::PACKED)
+		{
+			PackedVertex* vertices = reinterpret_cast<PackedVertex*>(stagingData + indicesSize);
+			for (size_t i = 0; i < model->vertices.size(); i++)
+				vertices[i] = PackedVertex::pack(model->vertices[i], model->quantization);
+		}
+		else
+			memcpy(stagingData + indicesSize, model->vertices.data(), (size_t)verticesSize);
+
+		// The geometry is placed in the arena, a model which does not fit gets its own memory and buffers.
+		if (GeometryArena::get()->add(model))
+			return;
+		YM_LOG_WARN("  Geometry arena is full, the model uses its own buffers.");
 
-		// Create memory and buffers.
-		std::vector<uint32_t> queueIndices = { findQueueIndex(VK_QUEUE_TRANSFER_BIT, VulkanInstance::get()->getPhysicalDevice()) };
+		std::vector<uint32_t> queueIndices = getUploadQueueIndices();
 		if (indicesSize > 0)
 		{
 			model->indexBuffer.init(indicesSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
@@ -189,30 +283,203 @@ namespace ym
 
 		// Create memory with the binded buffers
 		model->bufferMemory.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+
+	void GLTFLoader::recordTransfer(CommandBuffer * commandBuffer, Model * model, StagingBuffers * stagingBuffers)
+	{
+		// Transition all images with one barrier.
+		std::vector<VkImageMemoryBarrier> barriers(model->textures.size());
+		for (uint32_t textureIndex = 0; textureIndex < model->textures.size(); textureIndex++)
+		{
+			VkImageMemoryBarrier& barrier = barriers[textureIndex];
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = model->textures[textureIndex].image.getImage();
+			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = model->textures[textureIndex].image.getMipLevels();
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = 1;
+		}
+		if (barriers.empty() == false)
+			commandBuffer->cmdImageMemoryBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, barriers);
+
+		// Copy the images to the first mip level, or to every mip level if they were loaded from the model cache.
+		Offset offset = 0;
+		for (Texture& texture : model->textures)
+		{
+			uint32_t levelCount = stagingBuffers->hasMipLevels ? texture.image.getMipLevels() : 1;
+			std::vector<VkBufferImageCopy> regions(levelCount);
+			uint32_t width = texture.textureDesc.width;
+			uint32_t height = texture.textureDesc.height;
+			for (uint32_t level = 0; level < levelCount; level++)
+			{
+				VkBufferImageCopy& bufferCopyRegion = regions[level];
+				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				bufferCopyRegion.imageSubresource.mipLevel = level;
+				bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+				bufferCopyRegion.imageSubresource.layerCount = 1;
+				bufferCopyRegion.imageExtent.width = width;
+				bufferCopyRegion.imageExtent.height = height;
+				bufferCopyRegion.imageExtent.depth = 1;
+				bufferCopyRegion.bufferOffset = offset;
+				offset += (uint64_t)width * (uint64_t)height * 4;
+				width = width > 1 ? width / 2 : 1;
+				height = height > 1 ? height / 2 : 1;
+			}
+			commandBuffer->cmdCopyBufferToImage(stagingBuffers->imageBuffer.getBuffer(), texture.image.getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, regions.data());
+			texture.image.setLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		}
 
-		// Copy data to the new buffers.
-		CommandBuffer* cbuff = transferCommandPool->beginSingleTimeCommand();
+		// Nothing is left for the graphics queue when all mip levels were copied, the images are made readable here.
+		if (stagingBuffers->hasMipLevels && barriers.empty() == false)
+		{
+			for (VkImageMemoryBarrier& barrier : barriers)
+			{
+				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = 0;
+			}
+			commandBuffer->cmdImageMemoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, barriers);
+			for (Texture& texture : model->textures)
+			{
+				texture.image.setLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				texture.descriptor.imageLayout = texture.image.getLayout();
+			}
+		}
 
 		// Copy indices data.
+		const uint64_t indicesSize = getIndicesSize(*model);
+		const uint64_t verticesSize = getVerticesSize(*model);
 		if (indicesSize > 0)
 		{
 			VkBufferCopy region = {};
 			region.srcOffset = 0;
-			region.dstOffset = 0;
+			region.dstOffset = (VkDeviceSize)model->indexOffset * model->getIndexSize();
 			region.size = indicesSize;
-			cbuff->cmdCopyBuffer(stagingBuffers->geometryBuffer.getBuffer(), model->indexBuffer.getBuffer(), 1, &region);
+			commandBuffer->cmdCopyBuffer(stagingBuffers->geometryBuffer.getBuffer(), model->getIndexBuffer(), 1, &region);
 		}
 
 		// Copy vertex data.
 		VkBufferCopy region = {};
 		region.srcOffset = indicesSize;
-		region.dstOffset = 0;
+		region.dstOffset = (VkDeviceSize)model->vertexOffset * model->getVertexStride();
 		region.size = verticesSize;
-		cbuff->cmdCopyBuffer(stagingBuffers->geometryBuffer.getBuffer(), model->vertexBuffer.getBuffer(), 1, &region);
+		commandBuffer->cmdCopyBuffer(stagingBuffers->geometryBuffer.getBuffer(), model->getVertexBuffer(), 1, &region);
+	}
 
-		transferCommandPool->endSingleTimeCommand(cbuff);
+	void GLTFLoader::recordGraphics(CommandBuffer * commandBuffer, Model * model)
+	{
+		// Blits are not supported on the transfer queue, the mipmaps are generated on the graphics queue.
+		for (Texture& texture : model->textures)
+		{
+			if (texture.image.getMipLevels() == 1)
+				texture.image.setLayout(commandBuffer, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			else
+				Factory::generateMipmaps(&texture, commandBuffer);
+			texture.descriptor.imageLayout = texture.image.getLayout();
+		}
+	}
 
-		model->hasLoaded = true;
+	std::vector<uint32_t> GLTFLoader::getUploadQueueIndices()
+	{
+		uint32_t graphicsIndex = VulkanInstance::get()->getGraphicsQueue().queueIndex;
+		uint32_t transferIndex = VulkanInstance::get()->getTransferQueue().queueIndex;
+		if (graphicsIndex == transferIndex)
+			return { graphicsIndex };
+		return { graphicsIndex, transferIndex };
+	}
+
+	void GLTFLoader::submitUpload(Model * model, StagingBuffers * stagingBuffers)
+	{
+		Upload upload;
+		upload.model = model;
+		upload.stagingBuffers = stagingBuffers;
+
+		// All copies and barriers of the model are in one command buffer on the transfer queue.
+		upload.transferBuffer = transferPool->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		upload.transferBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr);
+		recordTransfer(upload.transferBuffer, model, stagingBuffers);
+		upload.transferBuffer->end();
+
+		upload.transferValue = ++transferValue;
+		VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &upload.transferValue;
+
+		VkCommandBuffer transferBuffer = upload.transferBuffer->getCommandBuffer();
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &transferBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &transferSemaphore;
+		VULKAN_CHECK(vkQueueSubmit(VulkanInstance::get()->getTransferQueue().queue, 1, &submitInfo, VK_NULL_HANDLE), "Failed to submit upload!");
+
+		if (model->textures.empty() == false && stagingBuffers->hasMipLevels == false)
+		{
+			// The mipmaps are generated when the copies have finished.
+			upload.graphicsBuffer = commandPool->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+			upload.graphicsBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr);
+			recordGraphics(upload.graphicsBuffer, model);
+			upload.graphicsBuffer->end();
+
+			upload.graphicsValue = ++graphicsValue;
+			VkTimelineSemaphoreSubmitInfo graphicsTimelineInfo = {};
+			graphicsTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+			graphicsTimelineInfo.waitSemaphoreValueCount = 1;
+			graphicsTimelineInfo.pWaitSemaphoreValues = &upload.transferValue;
+			graphicsTimelineInfo.signalSemaphoreValueCount = 1;
+			graphicsTimelineInfo.pSignalSemaphoreValues = &upload.graphicsValue;
+
+			VkCommandBuffer graphicsBuffer = upload.graphicsBuffer->getCommandBuffer();
+			VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			VkSubmitInfo graphicsSubmitInfo = {};
+			graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			graphicsSubmitInfo.pNext = &graphicsTimelineInfo;
+			graphicsSubmitInfo.waitSemaphoreCount = 1;
+			graphicsSubmitInfo.pWaitSemaphores = &transferSemaphore;
+			graphicsSubmitInfo.pWaitDstStageMask = &waitStage;
+			graphicsSubmitInfo.commandBufferCount = 1;
+			graphicsSubmitInfo.pCommandBuffers = &graphicsBuffer;
+			graphicsSubmitInfo.signalSemaphoreCount = 1;
+			graphicsSubmitInfo.pSignalSemaphores = &graphicsSemaphore;
+			VULKAN_CHECK(vkQueueSubmit(VulkanInstance::get()->getGraphicsQueue().queue, 1, &graphicsSubmitInfo, VK_NULL_HANDLE), "Failed to submit upload!");
+		}
+
+		uploads.push_back(upload);
+	}
+
+	bool GLTFLoader::isUploadDone(const Upload & upload)
+	{
+		VkDevice device = VulkanInstance::get()->getLogicalDevice();
+		uint64_t value = 0;
+		vkGetSemaphoreCounterValue(device, transferSemaphore, &value);
+		if (value < upload.transferValue)
+			return false;
+		vkGetSemaphoreCounterValue(device, graphicsSemaphore, &value);
+		return value >= upload.graphicsValue;
+	}
+
+	void GLTFLoader::finishUpload(Upload & upload)
+	{
+		transferPool->freeCommandBuffer(upload.transferBuffer);
+		if (upload.graphicsBuffer != nullptr)
+			commandPool->freeCommandBuffer(upload.graphicsBuffer);
+
+		upload.stagingBuffers->destroy();
+		SAFE_DELETE(upload.stagingBuffers);
+
+		upload.model->hasLoaded = true;
+		modelSet.erase(upload.model);
 		YM_LOG_INFO("Transfered model to GPU.");
 	}
 
@@ -243,7 +510,7 @@ namespace ym
 		defaultData.sampler.destroy();
 	}
 
-	void GLTFLoader::loadTextures(std::string & folderPath, Model & model, tinygltf::Model & gltfModel, StagingBuffers * stagingBuffers)
+	void GLTFLoader::loadTextures(Model & model, tinygltf::Model & gltfModel, StagingBuffers * stagingBuffers, AssetTiming & timing)
 	{
 		//YM_LOG_INFO("Textures:");
 		if (gltfModel.textures.empty()) 
@@ -253,7 +520,6 @@ namespace ym
 		}
 		else model.hasImageMemory = true;
 
-		model.imageData.resize(gltfModel.textures.size());
 		model.textures.resize(gltfModel.textures.size());
 		VkFormat format = VK_FORMAT_R8G8B8A8_UNORM; // Assume all have the same layout. (loadImageData will force them to have 4 components, each being one byte)
 		for (size_t textureIndex = 0; textureIndex < gltfModel.textures.size(); textureIndex++)
@@ -261,12 +527,10 @@ namespace ym
 
 			tinygltf::Texture& textureGltf = gltfModel.textures[textureIndex];
 			tinygltf::Image& image = gltfModel.images[textureGltf.source];
-			
-			loadImageData(folderPath, image, gltfModel, model.imageData[textureIndex]);
 
 			uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(image.width, image.height)))) + 1;
 			Texture& texture = model.textures[textureIndex];
-			texture.image.init(image.width, image.height, format, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, { VulkanInstance::get()->getGraphicsQueue().queueIndex }, 0, 1, mipLevels);
+			texture.image.init(image.width, image.height, format, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, getUploadQueueIndices(), 0, 1, mipLevels);
 			model.imageMemory.bindTexture(&texture);
 			texture.textureDesc.width = (uint32_t)image.width;
 			texture.textureDesc.height = (uint32_t)image.height;
@@ -291,9 +555,27 @@ namespace ym
 
 		uint64_t textureSize = 0;
 		for (Texture& texture : model.textures)
-			textureSize += texture.textureDesc.width * texture.textureDesc.height * 4;
-		stagingBuffers->imageBuffer.init(textureSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { VulkanInstance::get()->getGraphicsQueue().queueIndex });
+			textureSize += (uint64_t)texture.textureDesc.width * (uint64_t)texture.textureDesc.height * 4;
+		stagingBuffers->imageBuffer.init(textureSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { VulkanInstance::get()->getTransferQueue().queueIndex });
 		stagingBuffers->imageMemory.bindBuffer(&stagingBuffers->imageBuffer);
+		stagingBuffers->imageMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryAllocator::Lifetime::TRANSIENT);
+
+		// Decode each image as a separate job, directly to its place in the staging buffer. The images are placed after each other
+		// in the same order as the copies are recorded.
+		Timer decodeTimer;
+		uint8_t* stagingData = static_cast<uint8_t*>(stagingBuffers->imageMemory.getMappedData(&stagingBuffers->imageBuffer));
+		JobCounter counter;
+		Offset offset = 0;
+		for (size_t textureIndex = 0; textureIndex < gltfModel.textures.size(); textureIndex++)
+		{
+			tinygltf::Image* image = &gltfModel.images[gltfModel.textures[textureIndex].source];
+			uint8_t* dst = stagingData + offset;
+			JobSystem::execute([image, dst]() { loadImageData(*image, dst); }, &counter);
+			offset += (uint64_t)model.textures[textureIndex].textureDesc.width * (uint64_t)model.textures[textureIndex].textureDesc.height * 4;
+		}
+		JobSystem::wait(&counter);
+		timing.decodeMs = decodeTimer.stop() * 1000.f;
+		timing.textureCount = (uint32_t)model.textures.size();
 		YM_LOG_INFO("  Loaded {} texture(s).", gltfModel.textures.size());
 
 		model.samplers.resize(gltfModel.samplers.size());
@@ -307,51 +589,54 @@ namespace ym
 		YM_LOG_INFO("  Loaded {} sampler(s).", gltfModel.samplers.size());
 	}
 
-	void GLTFLoader::loadImageData(std::string & folderPath, tinygltf::Image & image, tinygltf::Model & gltfModel, std::vector<uint8_t> & data)
+	bool GLTFLoader::loadImageInfo(tinygltf::Image * image, const int imageIndex, std::string * err, std::string * warn, int reqWidth, int reqHeight, const unsigned char * bytes, int size, void * userData)
+	{
+		int width, height, channels;
+		if (stbi_info_from_memory(bytes, size, &width, &height, &channels) == 0)
+		{
+			if (err)
+				(*err) += "Unknown image format for image[" + std::to_string(imageIndex) + "] name = \"" + image->name + "\"\n";
+			return false;
+		}
+
+		// The image is always decoded to four components of one byte each.
+		image->width = width;
+		image->height = height;
+		image->component = 4;
+		image->bits = 8;
+		image->pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+		image->image.assign(bytes, bytes + size);
+		return true;
+	}
+
+	void GLTFLoader::loadImageData(tinygltf::Image & image, uint8_t * dst)
 	{
 		const int numComponents = 4;
-		const int size = image.width * image.height * numComponents;
-		if (!image.uri.empty())
-		{
-			// Fetch data from a file.
-			int width, height;
-			int channels;
-			std::string path = folderPath + image.uri;
-			uint8_t* imgData = static_cast<uint8_t*>(stbi_load(path.c_str(), &width, &height, &channels, numComponents));
-			if (imgData == nullptr)
-				YM_LOG_ERROR("  Failed to load texture! could not find file, path: {}", path.c_str());
-			else {
-				if (width == image.width && height == image.height && image.bits == 8)
-				{
-					YM_LOG_INFO("  Loaded texture: {} successfully!", path.c_str());
-					data.insert(data.end(), imgData, imgData + size);
-				}
-				else YM_LOG_ERROR("  Failed to load texture! Dimension or bit-depth do not match the specified values! Path: {}", path.c_str());
-				delete[] imgData;
-			}
+		const size_t size = (size_t)image.width * (size_t)image.height * numComponents;
+
+		{
+			std::unique_lock<std::mutex> lck(decodeMutex);
+			decodeCondition.wait(lck, []() { return decodesInFlight < GLTF_MAX_DECODES_IN_FLIGHT; });
+			decodesInFlight++;
+		}
+
+		int width, height;
+		int channels;
+		uint8_t* imgData = static_cast<uint8_t*>(stbi_load_from_memory(image.image.data(), (int)image.image.size(), &width, &height, &channels, numComponents));
+		if (imgData == nullptr || width != image.width || height != image.height)
+		{
+			YM_LOG_ERROR("  Failed to load texture! [{}]", image.uri.empty() ? image.name.c_str() : image.uri.c_str());
+			memset(dst, 0xFF, size);
 		}
 		else
+			memcpy(dst, imgData, size);
+		stbi_image_free(imgData);
+
 		{
-			// Fetch data from a buffer.
-			tinygltf::BufferView& view = gltfModel.bufferViews[image.bufferView];
-			tinygltf::Buffer& buffer = gltfModel.buffers[view.buffer];
-			uint8_t* dataPtr = &buffer.data.at(0) + view.byteOffset;
-
-			int width, height;
-			int channels;
-			uint8_t* imgData = static_cast<uint8_t*>(stbi_load_from_memory(dataPtr, (int)view.byteLength, &width, &height, &channels, numComponents));
-			if (imgData == nullptr)
-				YM_LOG_ERROR("  Failed to load embedded texture! could not find file!");
-			else {
-				if (width == image.width && height == image.height && image.bits == 8)
-				{
-					YM_LOG_INFO("  Loaded embedded texture successfully!");
-					data.insert(data.end(), imgData, imgData + size);
-				}
-				else YM_LOG_ERROR("  Failed to load embedded texture! Dimension or bit-depth do not match the specified values!");
-				delete[] imgData;
-			}
+			std::lock_guard<std::mutex> lck(decodeMutex);
+			decodesInFlight--;
 		}
+		decodeCondition.notify_one();
 	}
 
 	void GLTFLoader::loadSamplerData(tinygltf::Sampler & samplerGltf, Sampler & sampler, uint32_t mipLevels)
@@ -651,6 +936,27 @@ namespace ym
 	void GLTFLoader::loadModel(Model & model, const std::string & filePath, StagingBuffers * stagingBuffers)
 	{
 		YM_LOG_INFO("Loading model... [{}]", filePath.c_str());
+		Timer timer;
+		AssetTiming timing;
+		timing.filePath = filePath;
+
+		if (ModelCache::isEnabled() && ModelCache::load(filePath, &model, stagingBuffers))
+		{
+			computeBounds(model);
+			timing.fromCache = true;
+			timing.textureCount = (uint32_t)model.textures.size();
+			timing.totalMs = timer.stop() * 1000.f;
+			YM_LOG_INFO("  Loaded model from cache in {:.1f} ms [{}]", timing.totalMs, filePath.c_str());
+			{
+				std::lock_guard<std::mutex> lck(mutex);
+				assetTimings.push_back(timing);
+			}
+			return;
+		}
+
+		// The loader keeps state while parsing, use one per model to be able to load several models in parallel.
+		tinygltf::TinyGLTF loader;
+		loader.SetImageLoader(&GLTFLoader::loadImageInfo, nullptr);
 		tinygltf::Model gltfModel;
 		bool ret = false;
 		size_t pos = filePath.rfind('.');
@@ -670,14 +976,25 @@ namespace ym
 		}
 
 		YM_ASSERT(ret, "  Failed to parse glTF\n");
+		timing.parseMs = timer.stop() * 1000.f;
 
-		pos = filePath.find_last_of("/\\");
-		std::string folderPath = filePath.substr(0, pos + 1);
-
-		loadTextures(folderPath, model, gltfModel, stagingBuffers);
+		loadTextures(model, gltfModel, stagingBuffers, timing);
 		loadMaterials(model, gltfModel);
 		loadScenes(model, gltfModel, stagingBuffers);
-		YM_LOG_INFO("  Loaded model! [{}]", filePath.c_str());
+		computeBounds(model);
+
+		timing.totalMs = timer.stop() * 1000.f;
+		if (ModelCache::isEnabled())
+		{
+			Timer bakeTimer;
+			ModelCache::bake(filePath, &model, gltfModel, stagingBuffers);
+			timing.bakeMs = bakeTimer.stop() * 1000.f;
+		}
+		YM_LOG_INFO("  Loaded model in {:.1f} ms (parse {:.1f} ms, decode {} texture(s) {:.1f} ms) [{}]", timing.totalMs, timing.parseMs, timing.textureCount, timing.decodeMs, filePath.c_str());
+		{
+			std::lock_guard<std::mutex> lck(mutex);
+			assetTimings.push_back(timing);
+		}
 	}
 
 	void GLTFLoader::loadScenes(Model & model, tinygltf::Model & gltfModel, StagingBuffers * stagingBuffers)
@@ -696,14 +1013,104 @@ namespace ym
 			}
 		}
 
-		// Create vertex, index and texture buffer for staging. 
-		std::vector<uint32_t> queueIndices = { findQueueIndex(VK_QUEUE_TRANSFER_BIT, VulkanInstance::get()->getPhysicalDevice()) };
-		uint32_t indicesSize = (uint32_t)(model.indices.size() * sizeof(uint32_t));
-		uint32_t verticesSize = (uint32_t)(model.vertices.size() * sizeof(Vertex));
+		// The primitives are optimized on the job system, the calling thread helps while it waits.
+		if (MeshOptimizer::isEnabled())
+			MeshOptimizer::optimizeModel(model);
 
-		stagingBuffers->geometryBuffer.init(verticesSize + indicesSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, queueIndices);
+		// The levels of detail use the optimized vertices, so they are generated after them.
+		if (MeshSimplifier::isEnabled())
+			MeshSimplifier::generateLods(model);
+
+		// Create vertex, index and texture buffer for staging. 
+		std::vector<uint32_t> queueIndices = { VulkanInstance::get()->getTransferQueue().queueIndex };
+		selectGeometryFormat(model, packVertices);
+		stagingBuffers->geometryBuffer.init(getIndicesSize(model) + getVerticesSize(model), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, queueIndices);
 		stagingBuffers->geometryMemory.bindBuffer(&stagingBuffers->geometryBuffer);
 
 		YM_LOG_INFO("  Loaded scene nodes!");
 	}
+
+	void GLTFLoader::computeBounds(Model& model)
+	{
+		glm::vec3 modelMin(FLT_MAX);
+		glm::vec3 modelMax(-FLT_MAX);
+		for (Model::Node& node : model.nodes)
+			computeNodeBounds(model, node, modelMin, modelMax);
+
+		// A model without any indexed vertices gets empty bounds at the origin.
+		if (modelMin.x > modelMax.x)
+			modelMin = modelMax = glm::vec3(0.f);
+		model.bounds.min = modelMin;
+		model.bounds.max = modelMax;
+		model.bounds.center = (modelMin + modelMax) * 0.5f;
+		model.bounds.radius = glm::length(modelMax - modelMin) * 0.5f;
+	}
+
+	void GLTFLoader::computeNodeBounds(Model& model, Model::Node& node, glm::vec3& modelMin, glm::vec3& modelMax)
+	{
+		if (node.hasMesh)
+		{
+			// The renderer draws a node with its own matrix, the bounds use the same transform.
+			glm::vec3 nodeMin(FLT_MAX);
+			glm::vec3 nodeMax(-FLT_MAX);
+			for (Primitive& primitive : node.mesh.primitives)
+			{
+				if (primitive.hasIndices == false)
+					continue;
+				for (uint32_t i = primitive.firstIndex; i < primitive.firstIndex + primitive.indexCount; i++)
+				{
+					const glm::vec3 position = glm::vec3(node.matrix * glm::vec4(model.vertices[model.indices[i]].pos, 1.f));
+					nodeMin = glm::min(nodeMin, position);
+					nodeMax = glm::max(nodeMax, position);
+				}
+			}
+
+			if (nodeMin.x <= nodeMax.x)
+			{
+				node.bounds.min = nodeMin;
+				node.bounds.max = nodeMax;
+				node.bounds.center = (nodeMin + nodeMax) * 0.5f;
+				node.bounds.radius = glm::length(nodeMax - nodeMin) * 0.5f;
+				modelMin = glm::min(modelMin, nodeMin);
+				modelMax = glm::max(modelMax, nodeMax);
+			}
+		}
+
+		for (Model::Node& child : node.children)
+			computeNodeBounds(model, child, modelMin, modelMax);
+	}
+
+	void GLTFLoader::selectGeometryFormat(Model& model, bool packVertices)
+	{
+		bool fitsUint16 = true;
+		forEachPrimitive(model.nodes, [&](Primitive& primitive) {
+			primitive.firstVertex = 0;
+			if (primitive.hasIndices == false || primitive.indexCount == 0)
+				return;
+
+			uint32_t minIndex = UINT32_MAX;
+			uint32_t maxIndex = 0;
+			for (uint32_t i = primitive.firstIndex; i < primitive.firstIndex + primitive.indexCount; i++)
+			{
+				minIndex = std::min(minIndex, model.indices[i]);
+				maxIndex = std::max(maxIndex, model.indices[i]);
+			}
+			primitive.firstVertex = minIndex;
+			fitsUint16 = fitsUint16 && maxIndex - minIndex <= UINT16_MAX;
+		});
+
+		model.indexType = fitsUint16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+		model.vertexFormat = packVertices ? VertexFormat::PACKED : VertexFormat::FULL;
+		model.quantization = packVertices ? VertexQuantization::compute(model.vertices) : VertexQuantization();
+	}
+
+	uint64_t GLTFLoader::getIndicesSize(const Model& model)
+	{
+		return (uint64_t)model.indices.size() * model.getIndexSize();
+	}
+
+	uint64_t GLTFLoader::getVerticesSize(const Model& model)
+	{
+		return (uint64_t)model.vertices.size() * model.getVertexStride();
+	}
 }
@@ -12,6 +12,9 @@
 #include <queue>
 #include <mutex>
 #include <set>
+#include <condition_variable>
+
+#define GLTF_MAX_DECODES_IN_FLIGHT 8 // Images which are decoded at the same time, each holds a decoded copy of the image until it is written to the staging buffer.
 
 namespace ym
 {
@@ -21,6 +24,8 @@ namespace ym
 
 	class GLTFLoader
 	{
+		friend class ModelCache;
+
 	public:
 		struct StagingBuffers
 		{
@@ -28,11 +33,12 @@ namespace ym
 			Buffer imageBuffer;
 			Memory geometryMemory;
 			Memory imageMemory;
+			bool hasMipLevels{ false }; // True if the image buffer holds every mip level of the textures, they are then not generated on the GPU.
 
+			// The image memory is initialized when the textures are loaded, the images are decoded directly into it.
 			void initMemory()
 			{
-				this->geometryMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-				this->imageMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+				this->geometryMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryAllocator::Lifetime::TRANSIENT);
 			}
 
 			void destroy()
@@ -44,6 +50,18 @@ namespace ym
 			}
 		};
 
+		// Time spent loading a model to RAM, in milliseconds.
+		struct AssetTiming
+		{
+			std::string filePath;
+			uint32_t textureCount{ 0 };
+			float parseMs{ 0.f };
+			float decodeMs{ 0.f };
+			float totalMs{ 0.f };
+			float bakeMs{ 0.f };	// Time spent writing the model cache, not included in the total.
+			bool fromCache{ false };
+		};
+
 	public:
 		/*
 			Initialize default data.
@@ -57,16 +75,29 @@ namespace ym
 
 		/*
 			[This is only needed if loadOnThread is used]
-			Transfer data to GPU if it has finished loading on the thread.
+			Submit the uploads of models which have finished loading on the thread, and mark the models whose uploads the GPU has
+			finished as loaded. Never waits for the GPU.
 		*/
 		static void update();
 
 		/*
 			[Only works if update is called each frame]
-			Load a model from a thread to the GPU. This will perform staging.
+			Load a model from a thread to the GPU. This will perform staging. The data is copied on the transfer queue and
+			Model::hasLoaded is set by update when the GPU has finished.
 		*/
 		static void loadOnThread(const std::string& filePath, Model* model);
 
+		/*
+			Number of models which have been submitted to the GPU but have not finished uploading.
+		*/
+		static uint32_t getPendingUploadCount();
+
+		/*
+			Timings of all models which have been loaded to RAM since the last clear.
+		*/
+		static std::vector<AssetTiming> getAssetTimings();
+		static void clearAssetTimings();
+
 		/*
 			Load a model to the GPU. This will perform staging.
 		*/
@@ -78,9 +109,22 @@ namespace ym
 		static void loadToRAM(const std::string& filePath, Model* model, StagingBuffers* stagingBuffers);
 
 		/*
-			Transfer model data from RAM to the GPU.
+			Transfer model data from RAM to the GPU and wait for it to finish.
 		*/
-		static void transferToGPU(CommandPool* transferCommandPool, Model* model, StagingBuffers* stagingBuffers);
+		static void transferToGPU(Model* model, StagingBuffers* stagingBuffers);
+
+		/*
+			Choose the vertex format and index type of the model on the GPU, and set the first vertex of each indexed primitive.
+			16 bit indices are used when the indices of every primitive span at most 65536 vertices, they are stored relative to the
+			first vertex of the primitive. The vertices are packed if packVertices is true.
+		*/
+		static void selectGeometryFormat(Model& model, bool packVertices);
+
+		/*
+			Size of the indices and vertices of the model on the GPU, in bytes. The indices are placed before the vertices.
+		*/
+		static uint64_t getIndicesSize(const Model& model);
+		static uint64_t getVerticesSize(const Model& model);
 
 	private:
 		/*
@@ -93,18 +137,55 @@ namespace ym
 		*/
 		static void destroyDefaultData();
 
-		static void loadTextures(std::string& folderPath, Model& model, tinygltf::Model& gltfModel, StagingBuffers* stagingBuffers);
-		static void loadImageData(std::string& folderPath, tinygltf::Image& image, tinygltf::Model& gltfModel, std::vector<uint8_t>& data);
+		/*
+			Place the geometry of the model in the GeometryArena, or create its own device local buffers if the arena is full, and write
+			all data to the staging buffers. Does not use any queue, and can therefore be called from a thread.
+		*/
+		static void writeStagingData(Model* model, StagingBuffers* stagingBuffers);
+
+		/*
+			Record the copies from the staging buffers, for a command buffer on the transfer queue. The textures are left in
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
+		*/
+		static void recordTransfer(CommandBuffer* commandBuffer, Model* model, StagingBuffers* stagingBuffers);
+
+		/*
+			Record the mipmap generation and the transitions to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, for a command buffer on the
+			graphics queue.
+		*/
+		static void recordGraphics(CommandBuffer* commandBuffer, Model* model);
+
+		/*
+			Queue families of the resources written by an upload, the resources are shared between the transfer and graphics queue.
+		*/
+		static std::vector<uint32_t> getUploadQueueIndices();
+
+		static void submitUpload(Model* model, StagingBuffers* stagingBuffers);
+
+		/*
+			Image callback for tinygltf. Only reads the size of the image and keeps the encoded data, the images are decoded in parallel
+			by loadTextures.
+		*/
+		static bool loadImageInfo(tinygltf::Image* image, const int imageIndex, std::string* err, std::string* warn, int reqWidth, int reqHeight, const unsigned char* bytes, int size, void* userData);
+
+		static void loadTextures(Model& model, tinygltf::Model& gltfModel, StagingBuffers* stagingBuffers, AssetTiming& timing);
+		// Decode the image to RGBA8 at the destination. Blocks while GLTF_MAX_DECODES_IN_FLIGHT images are being decoded.
+		static void loadImageData(tinygltf::Image& image, uint8_t* dst);
 		static void loadSamplerData(tinygltf::Sampler& samplerGltf, Sampler& sampler, uint32_t mipLevels);
 		static void loadMaterials(Model& model, tinygltf::Model& gltfModel);
 		static void loadNode(Model& model, Model::Node* node, tinygltf::Model& gltfModel, tinygltf::Node& gltfNode, std::string indents);
 
 		static void loadModel(Model& model, const std::string& filePath, StagingBuffers* stagingBuffers);
+		/*
+			Compute the bounds of each node with a mesh and of the whole model from the vertices which are referenced by the indices.
+		*/
+		static void computeBounds(Model& model);
+		static void computeNodeBounds(Model& model, Model::Node& node, glm::vec3& modelMin, glm::vec3& modelMax);
 		static void loadScenes(Model& model, tinygltf::Model& gltfModel, StagingBuffers* stagingBuffers);
 
 	private:
 		static Model model;
-		static tinygltf::TinyGLTF loader;
+		static bool packVertices; // Graphics/packedVertices in the config.
 
 		struct DefaultData
 		{
@@ -113,6 +194,7 @@ namespace ym
 		};
 		static DefaultData defaultData;
 		static CommandPool* commandPool;
+		static CommandPool* transferPool;
 
 		struct ThreadData
 		{
@@ -120,7 +202,34 @@ namespace ym
 			StagingBuffers* stagingBuffers{ nullptr };
 		};
 		static std::queue<ThreadData> modelQueue;
+
+		// A model which is being copied to the GPU. It is done when the timeline semaphore of each queue it was submitted to has
+		// reached its value, the graphics commands wait on the value of the transfer commands. A value of 0 means no submit.
+		struct Upload
+		{
+			Model* model{ nullptr };
+			StagingBuffers* stagingBuffers{ nullptr };
+			CommandBuffer* transferBuffer{ nullptr };
+			CommandBuffer* graphicsBuffer{ nullptr };
+			uint64_t transferValue{ 0 };
+			uint64_t graphicsValue{ 0 };
+		};
+		static std::vector<Upload> uploads;
+		static void finishUpload(Upload& upload);
+		static bool isUploadDone(const Upload& upload);
+
+		// One timeline semaphore for each queue, the values of a queue increase in the order of its submits.
+		static VkSemaphore transferSemaphore;
+		static VkSemaphore graphicsSemaphore;
+		static uint64_t transferValue;
+		static uint64_t graphicsValue;
+
 		static std::set<Model*> modelSet;
 		static std::mutex mutex;
+		static std::vector<AssetTiming> assetTimings;
+
+		static uint32_t decodesInFlight;
+		static std::mutex decodeMutex;
+		static std::condition_variable decodeCondition;
 	};
 }
\ No newline at end of file
@@ -1,7 +1,7 @@
 #include "stdafx.h"
 #include "GameObject.h"
 
-ym::GameObject::GameObject() : pos(0.f, 0.f, 0.f), modelPtr(nullptr), transform(1.f)
+ym::GameObject::GameObject() : id(0), pos(0.f, 0.f, 0.f), modelPtr(nullptr), transform(1.f)
 {
 }
 
@@ -23,7 +23,14 @@ namespace ym
 
 		Model* getModel();
 
+		/*
+			Unique among the live objects of the ObjectManager, it is reused after the object is removed.
+		*/
+		uint32_t getID() const { return this->id; }
+		void setID(uint32_t id) { this->id = id; }
+
 	private:
+		uint32_t id;
 		glm::vec3 pos;
 		glm::mat4 transform;
 		Model* modelPtr;
@@ -0,0 +1,391 @@
+#include "stdafx.h"
+#include "MeshOptimizer.h"
+
+#include "Engine/Core/Threading/JobSystem.h"
+
+#include <unordered_map>
+
+namespace ym
+{
+	namespace
+	{
+		// Vertices are compared by the bits of their attributes, the padding of the vertex is not part of the key.
+		struct VertexKey
+		{
+			std::array<uint32_t, 8> bits;
+
+			bool operator==(const VertexKey& other) const { return this->bits == other.bits; }
+		};
+
+		struct VertexKeyHash
+		{
+			size_t operator()(const VertexKey& key) const
+			{
+				size_t hash = 0;
+				for (uint32_t bits : key.bits)
+					hash ^= std::hash<uint32_t>()(bits) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+				return hash;
+			}
+		};
+
+		VertexKey getKey(const Vertex& vertex)
+		{
+			const float values[8] = { vertex.pos.x, vertex.pos.y, vertex.pos.z, vertex.nor.x, vertex.nor.y, vertex.nor.z, vertex.uv0.x, vertex.uv0.y };
+			VertexKey key;
+			memcpy(key.bits.data(), values, sizeof(values));
+			return key;
+		}
+
+		void collectPrimitives(std::vector<Model::Node>& nodes, std::vector<std::pair<Mesh*, Primitive*>>& primitives)
+		{
+			for (Model::Node& node : nodes)
+			{
+				if (node.hasMesh)
+				{
+					for (Primitive& primitive : node.mesh.primitives)
+						primitives.push_back({ &node.mesh, &primitive });
+				}
+				collectPrimitives(node.children, primitives);
+			}
+		}
+	}
+
+	std::atomic<bool> MeshOptimizer::enabled{ true };
+
+	void MeshOptimizer::optimizeModel(Model& model)
+	{
+		YM_PROFILER_FUNCTION();
+		std::vector<std::pair<Mesh*, Primitive*>> primitives;
+		collectPrimitives(model.nodes, primitives);
+		for (auto& primitive : primitives)
+		{
+			if (primitive.second->hasIndices == false)
+			{
+				YM_LOG_WARN("  Mesh {} has a primitive without indices, the model is not optimized.", primitive.first->name.c_str());
+				return;
+			}
+		}
+
+		// The vertices of each primitive were added after each other, the indices of a primitive only reference its own range.
+		struct Job
+		{
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			Stats before;
+			Stats after;
+		};
+		std::vector<Job> jobs(primitives.size());
+		JobCounter counter;
+		for (size_t i = 0; i < primitives.size(); i++)
+		{
+			Job* job = &jobs[i];
+			const Primitive* primitive = primitives[i].second;
+			JobSystem::execute([&model, job, primitive]() {
+				if (primitive->indexCount == 0)
+					return;
+
+				const uint32_t* indices = model.indices.data() + primitive->firstIndex;
+				const uint32_t minIndex = *std::min_element(indices, indices + primitive->indexCount);
+				const uint32_t maxIndex = *std::max_element(indices, indices + primitive->indexCount);
+				job->vertices.assign(model.vertices.begin() + minIndex, model.vertices.begin() + maxIndex + 1);
+				job->indices.resize(primitive->indexCount);
+				for (uint32_t i = 0; i < primitive->indexCount; i++)
+					job->indices[i] = indices[i] - minIndex;
+
+				job->before = analyze(job->indices, (uint32_t)job->vertices.size());
+				if (primitive->indexCount % 3 == 0)
+					optimize(job->vertices, job->indices);
+				job->after = analyze(job->indices, (uint32_t)job->vertices.size());
+			}, &counter);
+		}
+		JobSystem::wait(&counter);
+
+		// Rebuild the geometry of the model from the optimized primitives, in the same order.
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		vertices.reserve(model.vertices.size());
+		indices.reserve(model.indices.size());
+		for (size_t i = 0; i < primitives.size(); i++)
+		{
+			Primitive& primitive = *primitives[i].second;
+			const uint32_t vertexStart = (uint32_t)vertices.size();
+			primitive.firstIndex = (uint32_t)indices.size();
+			primitive.vertexCount = (uint32_t)jobs[i].vertices.size();
+			vertices.insert(vertices.end(), jobs[i].vertices.begin(), jobs[i].vertices.end());
+			for (uint32_t index : jobs[i].indices)
+				indices.push_back(index + vertexStart);
+		}
+		const size_t vertexCountBefore = model.vertices.size();
+		model.vertices.swap(vertices);
+		model.indices.swap(indices);
+
+		// The statistics of the primitives of each mesh are added together.
+		for (size_t first = 0; first < primitives.size();)
+		{
+			Stats before;
+			Stats after;
+			size_t last = first;
+			for (; last < primitives.size() && primitives[last].first == primitives[first].first; last++)
+			{
+				before.vertexCount += jobs[last].before.vertexCount;
+				before.triangleCount += jobs[last].before.triangleCount;
+				before.transformedCount += jobs[last].before.transformedCount;
+				after.vertexCount += jobs[last].after.vertexCount;
+				after.triangleCount += jobs[last].after.triangleCount;
+				after.transformedCount += jobs[last].after.transformedCount;
+			}
+			YM_LOG_INFO("  Mesh {}: {} -> {} vertices, ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", primitives[first].first->name.c_str(),
+				before.vertexCount, after.vertexCount, before.getAcmr(), after.getAcmr(), before.getAtvr(), after.getAtvr());
+			first = last;
+		}
+		YM_LOG_INFO("  Optimized {} primitive(s), {} -> {} vertices.", primitives.size(), vertexCountBefore, model.vertices.size());
+	}
+
+	void MeshOptimizer::optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		const uint32_t vertexCount = deduplicateVertices(vertices, indices);
+		optimizeVertexCache(indices, vertexCount);
+		optimizeOverdraw(indices, vertices);
+		optimizeVertexFetch(vertices, indices);
+	}
+
+	uint32_t MeshOptimizer::deduplicateVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::unordered_map<VertexKey, uint32_t, VertexKeyHash> uniqueVertices;
+		uniqueVertices.reserve(vertices.size());
+		std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+		std::vector<Vertex> result;
+		result.reserve(vertices.size());
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == UINT32_MAX)
+			{
+				auto it = uniqueVertices.insert({ getKey(vertices[index]), (uint32_t)result.size() });
+				if (it.second)
+					result.push_back(vertices[index]);
+				remap[index] = it.first->second;
+			}
+			index = remap[index];
+		}
+		vertices.swap(result);
+		return (uint32_t)vertices.size();
+	}
+
+	void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		const uint32_t triangleCount = (uint32_t)indices.size() / 3;
+		if (triangleCount == 0 || vertexCount == 0)
+			return;
+
+		// Triangles which use each vertex, and the number of those which have not been emitted yet.
+		std::vector<uint32_t> liveCount(vertexCount, 0);
+		for (uint32_t index : indices)
+			liveCount[index]++;
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (uint32_t v = 0; v < vertexCount; v++)
+			adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveCount[v];
+		std::vector<uint32_t> adjacency(indices.size());
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+			adjacency[fill[indices[i]]++] = i / 3;
+
+		// A vertex is in the cache if fewer than cacheSize vertices have been added since it was added.
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		uint32_t time = cacheSize + 1;
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnd;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> result;
+		result.reserve(triangleCount * 3);
+		uint32_t cursor = 0;
+
+		int64_t fanning = 0;
+		while (fanning >= 0)
+		{
+			// Emit all remaining triangles around the fanning vertex.
+			candidates.clear();
+			for (uint32_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++)
+			{
+				const uint32_t triangle = adjacency[a];
+				if (emitted[triangle])
+					continue;
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const uint32_t v = indices[triangle * 3 + k];
+					result.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					liveCount[v]--;
+					if (time - cacheTime[v] > cacheSize)
+						cacheTime[v] = time++;
+				}
+				emitted[triangle] = true;
+			}
+
+			// Continue with the candidate which stays longest in the cache while its remaining triangles are emitted.
+			int64_t next = -1;
+			int64_t bestPriority = -1;
+			for (uint32_t v : candidates)
+			{
+				if (liveCount[v] == 0)
+					continue;
+				int64_t priority = 0;
+				if (time - cacheTime[v] + 2 * liveCount[v] <= cacheSize)
+					priority = time - cacheTime[v];
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					next = v;
+				}
+			}
+
+			// Dead end, use a recently used vertex with triangles left, or the next vertex in order.
+			while (next == -1 && deadEnd.empty() == false)
+			{
+				const uint32_t v = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveCount[v] > 0)
+					next = v;
+			}
+			while (next == -1 && cursor < vertexCount)
+			{
+				if (liveCount[cursor] > 0)
+					next = cursor;
+				cursor++;
+			}
+			fanning = next;
+		}
+		indices.swap(result);
+	}
+
+	void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold)
+	{
+		const uint32_t triangleCount = (uint32_t)indices.size() / 3;
+		if (triangleCount < 2)
+			return;
+
+		// A cluster starts where a triangle misses the cache with all of its vertices, the order within a cluster is kept.
+		std::vector<uint32_t> clusterStarts;
+		std::vector<uint32_t> cacheTime(vertices.size(), 0);
+		uint32_t time = MESH_OPTIMIZER_CACHE_SIZE + 1;
+		for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+		{
+			uint32_t misses = 0;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				const uint32_t v = indices[triangle * 3 + k];
+				if (time - cacheTime[v] > MESH_OPTIMIZER_CACHE_SIZE)
+				{
+					cacheTime[v] = time++;
+					misses++;
+				}
+			}
+			if (misses == 3)
+				clusterStarts.push_back(triangle);
+		}
+		if (clusterStarts.size() < 2)
+			return;
+		clusterStarts.push_back(triangleCount);
+
+		// Clusters which face away from the center are in front of the others more often, they are drawn first.
+		struct Cluster
+		{
+			uint32_t first;
+			uint32_t last;
+			float sortKey;
+		};
+		std::vector<Cluster> clusters(clusterStarts.size() - 1);
+		std::vector<glm::vec3> centroids(clusters.size(), glm::vec3(0.f));
+		std::vector<glm::vec3> normals(clusters.size(), glm::vec3(0.f));
+		glm::vec3 meshCentroid(0.f);
+		float meshArea = 0.f;
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			float area = 0.f;
+			for (uint32_t triangle = clusterStarts[c]; triangle < clusterStarts[c + 1]; triangle++)
+			{
+				const glm::vec3& p0 = vertices[indices[triangle * 3 + 0]].pos;
+				const glm::vec3& p1 = vertices[indices[triangle * 3 + 1]].pos;
+				const glm::vec3& p2 = vertices[indices[triangle * 3 + 2]].pos;
+				const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+				const float triangleArea = glm::length(normal);
+				centroids[c] += (p0 + p1 + p2) * (triangleArea / 3.f);
+				normals[c] += normal;
+				area += triangleArea;
+			}
+			meshCentroid += centroids[c];
+			meshArea += area;
+			centroids[c] = area > 0.f ? centroids[c] / area : vertices[indices[clusterStarts[c] * 3]].pos;
+			clusters[c].first = clusterStarts[c];
+			clusters[c].last = clusterStarts[c + 1];
+		}
+		meshCentroid = meshArea > 0.f ? meshCentroid / meshArea : glm::vec3(0.f);
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			const float length = glm::length(normals[c]);
+			clusters[c].sortKey = length > 0.f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.f;
+		}
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+		for (const Cluster& cluster : clusters)
+			result.insert(result.end(), indices.begin() + cluster.first * 3, indices.begin() + cluster.last * 3);
+
+		// Keep the cache order if the new order costs too many vertex transforms.
+		const float acmrBefore = analyze(indices, (uint32_t)vertices.size()).getAcmr();
+		const float acmrAfter = analyze(result, (uint32_t)vertices.size()).getAcmr();
+		if (acmrAfter <= acmrBefore * threshold)
+			indices.swap(result);
+	}
+
+	void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+		std::vector<Vertex> result;
+		result.reserve(vertices.size());
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == UINT32_MAX)
+			{
+				remap[index] = (uint32_t)result.size();
+				result.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices.swap(result);
+	}
+
+	MeshOptimizer::Stats MeshOptimizer::analyze(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		Stats stats;
+		stats.triangleCount = (uint32_t)indices.size() / 3;
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		std::vector<bool> used(vertexCount, false);
+		uint32_t time = cacheSize + 1;
+		for (uint32_t index : indices)
+		{
+			if (used[index] == false)
+			{
+				used[index] = true;
+				stats.vertexCount++;
+			}
+			if (time - cacheTime[index] > cacheSize)
+			{
+				cacheTime[index] = time++;
+				stats.transformedCount++;
+			}
+		}
+		return stats;
+	}
+
+	void MeshOptimizer::setEnabled(bool enabled)
+	{
+		MeshOptimizer::enabled = enabled;
+	}
+
+	bool MeshOptimizer::isEnabled()
+	{
+		return enabled;
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Model/Model.h"
+#include <atomic>
+
+#define MESH_OPTIMIZER_CACHE_SIZE 16			// Entries of the FIFO post-transform cache which the triangles are ordered for.
+#define MESH_OPTIMIZER_OVERDRAW_THRESHOLD 1.05f	// The overdraw order is only kept if the ACMR grows less than this factor.
+
+namespace ym
+{
+	/*
+		Import stage which prepares the geometry of a model for the GPU. The vertices of each primitive are welded, the triangles are
+		reordered for the post-transform vertex cache (Tipsify) and then for overdraw, and the vertices are reordered in the order
+		they are first used by the indices. The functions on a single mesh work on local indices and do not need a model.
+	*/
+	class MeshOptimizer
+	{
+	public:
+		// Post-transform cache statistics of a triangle list, simulated with a FIFO cache.
+		struct Stats
+		{
+			uint32_t vertexCount{ 0 };
+			uint32_t triangleCount{ 0 };
+			uint32_t transformedCount{ 0 }; // Vertices which missed the cache.
+
+			// Average cache miss ratio, transformed vertices per triangle. 0.5 is the best possible, 3 is no reuse at all.
+			float getAcmr() const { return this->triangleCount > 0 ? (float)this->transformedCount / (float)this->triangleCount : 0.f; }
+			// Average transform to vertex ratio, 1 means that each vertex is transformed once.
+			float getAtvr() const { return this->vertexCount > 0 ? (float)this->transformedCount / (float)this->vertexCount : 0.f; }
+		};
+
+	public:
+		/*
+			Optimize every indexed primitive of the model, each primitive as a separate job. The vertices of the model are rebuilt and
+			the ranges of the primitives are updated. Logs the statistics of each mesh. Models with primitives without indices are
+			left as they are.
+		*/
+		static void optimizeModel(Model& model);
+
+		/*
+			Run all steps on one triangle list.
+		*/
+		static void optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		/*
+			Merge vertices with identical attributes and remove vertices which are not used. Returns the new vertex count.
+		*/
+		static uint32_t deduplicateVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		/*
+			Reorder the triangles for the post-transform cache with Tipsify [Sander et al. 2007].
+		*/
+		static void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+		/*
+			Split cache optimized triangles into clusters where the cache starts over, and sort the clusters so the ones facing away
+			from the center of the mesh are drawn first. The order is kept only if the ACMR grows less than the threshold.
+		*/
+		static void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = MESH_OPTIMIZER_OVERDRAW_THRESHOLD);
+
+		/*
+			Reorder the vertices in the order they are first used by the indices, vertices which are not used are removed.
+		*/
+		static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		static Stats analyze(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+		/*
+			When disabled, models are loaded with their vertices in the order of the source file.
+		*/
+		static void setEnabled(bool enabled);
+		static bool isEnabled();
+
+	private:
+		MeshOptimizer() = delete;
+
+		static std::atomic<bool> enabled;
+	};
+}
@@ -0,0 +1,441 @@
+#include "stdafx.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include "Engine/Core/Threading/JobSystem.h"
+
+#include <unordered_map>
+
+namespace ym
+{
+	namespace
+	{
+		// Symmetric 4x4 matrix of the squared distances to a set of planes, evaluated as p^T A p + 2 b.p + c.
+		struct Quadric
+		{
+			double a00{ 0 }, a01{ 0 }, a02{ 0 }, a11{ 0 }, a12{ 0 }, a22{ 0 };
+			double b0{ 0 }, b1{ 0 }, b2{ 0 };
+			double c{ 0 };
+
+			void addPlane(const glm::dvec3& n, double d, double weight)
+			{
+				a00 += weight * n.x * n.x; a01 += weight * n.x * n.y; a02 += weight * n.x * n.z;
+				a11 += weight * n.y * n.y; a12 += weight * n.y * n.z; a22 += weight * n.z * n.z;
+				b0 += weight * n.x * d; b1 += weight * n.y * d; b2 += weight * n.z * d;
+				c += weight * d * d;
+			}
+
+			void add(const Quadric& q)
+			{
+				a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+				b0 += q.b0; b1 += q.b1; b2 += q.b2;
+				c += q.c;
+			}
+
+			double evaluate(const glm::vec3& p) const
+			{
+				const double x = p.x, y = p.y, z = p.z;
+				const double result = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+					+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+				return std::max(result, 0.0);
+			}
+		};
+
+		struct Collapse
+		{
+			double cost;
+			uint32_t from;
+			uint32_t to;
+		};
+
+		struct PositionHash
+		{
+			size_t operator()(const glm::vec3& p) const
+			{
+				uint32_t bits[3];
+				memcpy(bits, &p.x, sizeof(bits));
+				return std::hash<uint32_t>()(bits[0]) ^ (std::hash<uint32_t>()(bits[1]) * 31) ^ (std::hash<uint32_t>()(bits[2]) * 131);
+			}
+		};
+
+		// Give the vertices which share a position the same id. Returns the number of positions.
+		uint32_t findPositions(const std::vector<Vertex>& vertices, std::vector<uint32_t>& positionIds)
+		{
+			std::unordered_map<glm::vec3, uint32_t, PositionHash> ids;
+			positionIds.resize(vertices.size());
+			for (size_t v = 0; v < vertices.size(); v++)
+				positionIds[v] = ids.insert({ vertices[v].pos, (uint32_t)ids.size() }).first->second;
+			return (uint32_t)ids.size();
+		}
+
+		/*
+			Lock the positions on edges which are not shared by exactly two triangles (borders and non-manifold edges). The edges are
+			compared by position, so UV and normal seams are not borders.
+		*/
+		std::vector<bool> findLockedPositions(const std::vector<uint32_t>& positionIds, uint32_t positionCount, const std::vector<uint32_t>& indices)
+		{
+			std::unordered_map<uint64_t, uint32_t> edgeCount;
+			edgeCount.reserve(indices.size());
+			for (size_t t = 0; t + 2 < indices.size(); t += 3)
+			{
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const uint64_t a = positionIds[indices[t + k]];
+					const uint64_t b = positionIds[indices[t + (k + 1) % 3]];
+					edgeCount[std::min(a, b) << 32 | std::max(a, b)]++;
+				}
+			}
+
+			std::vector<bool> locked(positionCount, false);
+			for (auto& edge : edgeCount)
+			{
+				if (edge.second != 2)
+				{
+					locked[(uint32_t)(edge.first >> 32)] = true;
+					locked[(uint32_t)(edge.first & 0xFFFFFFFF)] = true;
+				}
+			}
+			return locked;
+		}
+
+		void collectPrimitives(std::vector<Model::Node>& nodes, std::vector<Primitive*>& primitives)
+		{
+			for (Model::Node& node : nodes)
+			{
+				if (node.hasMesh)
+				{
+					for (Primitive& primitive : node.mesh.primitives)
+						primitives.push_back(&primitive);
+				}
+				collectPrimitives(node.children, primitives);
+			}
+		}
+	}
+
+	std::atomic<bool> MeshSimplifier::enabled{ true };
+
+	void MeshSimplifier::generateLods(Model& model)
+	{
+		YM_PROFILER_FUNCTION();
+		std::vector<Primitive*> primitives;
+		collectPrimitives(model.nodes, primitives);
+
+		// Each job writes the levels of one primitive with indices relative to the first vertex of the primitive.
+		struct Job
+		{
+			uint32_t minIndex{ 0 };
+			std::vector<std::vector<uint32_t>> lodIndices;
+			std::vector<float> lodErrors;
+		};
+		std::vector<Job> jobs(primitives.size());
+		JobCounter counter;
+		for (size_t i = 0; i < primitives.size(); i++)
+		{
+			Job* job = &jobs[i];
+			const Primitive* primitive = primitives[i];
+			if (primitive->hasIndices == false || primitive->indexCount < 3 || primitive->indexCount % 3 != 0)
+				continue;
+
+			JobSystem::execute([&model, job, primitive]() {
+				const uint32_t* indices = model.indices.data() + primitive->firstIndex;
+				job->minIndex = *std::min_element(indices, indices + primitive->indexCount);
+				const uint32_t maxIndex = *std::max_element(indices, indices + primitive->indexCount);
+				std::vector<Vertex> vertices(model.vertices.begin() + job->minIndex, model.vertices.begin() + maxIndex + 1);
+				std::vector<uint32_t> current(primitive->indexCount);
+				for (uint32_t i = 0; i < primitive->indexCount; i++)
+					current[i] = indices[i] - job->minIndex;
+
+				glm::vec3 min = vertices[0].pos;
+				glm::vec3 max = vertices[0].pos;
+				for (const Vertex& vertex : vertices)
+				{
+					min = glm::min(min, vertex.pos);
+					max = glm::max(max, vertex.pos);
+				}
+				const float size = glm::length(max - min);
+
+				// Each level is simplified from the previous one and may have twice the error, the errors of the steps are added.
+				float error = 0.f;
+				float maxError = MESH_SIMPLIFIER_MAX_ERROR * size;
+				for (uint32_t lod = 1; lod < MODEL_MAX_LODS; lod++, maxError *= 2.f)
+				{
+					const size_t target = (size_t)((float)current.size() * MESH_SIMPLIFIER_LOD_RATIO) / 3 * 3;
+					float stepError = 0.f;
+					std::vector<uint32_t> simplified = simplify(vertices, current, target, maxError, stepError);
+					if (simplified.empty() || (float)simplified.size() > (float)current.size() * MESH_SIMPLIFIER_MIN_REDUCTION)
+						break;
+
+					MeshOptimizer::optimizeVertexCache(simplified, (uint32_t)vertices.size());
+					error += stepError;
+					job->lodErrors.push_back(error);
+					job->lodIndices.push_back(simplified);
+					current.swap(simplified);
+				}
+			}, &counter);
+		}
+		JobSystem::wait(&counter);
+
+		for (size_t i = 0; i < primitives.size(); i++)
+		{
+			Primitive& primitive = *primitives[i];
+			primitive.lods.clear();
+			for (size_t lod = 0; lod < jobs[i].lodIndices.size(); lod++)
+			{
+				Primitive::Lod level;
+				level.firstIndex = (uint32_t)model.indices.size();
+				level.indexCount = (uint32_t)jobs[i].lodIndices[lod].size();
+				level.error = jobs[i].lodErrors[lod];
+				for (uint32_t index : jobs[i].lodIndices[lod])
+					model.indices.push_back(index + jobs[i].minIndex);
+				primitive.lods.push_back(level);
+			}
+		}
+		updateModelLods(model);
+	}
+
+	void MeshSimplifier::updateModelLods(Model& model)
+	{
+		std::vector<Primitive*> primitives;
+		collectPrimitives(model.nodes, primitives);
+
+		model.lodCount = 1;
+		model.lodErrors.fill(0.f);
+		for (Primitive* primitive : primitives)
+		{
+			model.lodCount = std::max(model.lodCount, (uint32_t)primitive->lods.size() + 1);
+			for (uint32_t lod = 1; lod < MODEL_MAX_LODS && primitive->lods.empty() == false; lod++)
+			{
+				const float error = primitive->lods[std::min(lod, (uint32_t)primitive->lods.size()) - 1].error;
+				model.lodErrors[lod] = std::max(model.lodErrors[lod], error);
+			}
+		}
+	}
+
+	std::vector<uint32_t> MeshSimplifier::simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, float& error)
+	{
+		std::vector<uint32_t> result(indices.begin(), indices.end());
+		error = 0.f;
+		if (indices.size() <= targetIndexCount)
+			return result;
+
+		// The collapses work on positions, all vertices at a position are moved together. The vertices of each position are
+		// stored after each other.
+		std::vector<uint32_t> positionIds;
+		const uint32_t positionCount = findPositions(vertices, positionIds);
+		const std::vector<bool> locked = findLockedPositions(positionIds, positionCount, indices);
+		std::vector<glm::vec3> positions(positionCount);
+		std::vector<uint32_t> positionOffsets(positionCount + 1, 0);
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			positions[positionIds[v]] = vertices[v].pos;
+			positionOffsets[positionIds[v] + 1]++;
+		}
+		for (uint32_t p = 0; p < positionCount; p++)
+			positionOffsets[p + 1] += positionOffsets[p];
+		std::vector<uint32_t> positionVertices(vertices.size());
+		std::vector<uint32_t> positionFill(positionOffsets.begin(), positionOffsets.end() - 1);
+		for (uint32_t v = 0; v < (uint32_t)vertices.size(); v++)
+			positionVertices[positionFill[positionIds[v]]++] = v;
+
+		// The quadric of a position holds the planes of its triangles. They are not weighted, so the cost of a collapse is never smaller
+		// than the squared distance to any of the planes, which makes the error a bound rather than an average.
+		std::vector<Quadric> quadrics(positionCount);
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			const glm::dvec3 p0 = vertices[indices[t]].pos;
+			const glm::dvec3 p1 = vertices[indices[t + 1]].pos;
+			const glm::dvec3 p2 = vertices[indices[t + 2]].pos;
+			glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const double area = glm::length(normal);
+			if (area <= 0.0)
+				continue;
+			normal /= area;
+			Quadric quadric;
+			quadric.addPlane(normal, -glm::dot(normal, p0), 1.0);
+			for (uint32_t k = 0; k < 3; k++)
+				quadrics[positionIds[indices[t + k]]].add(quadric);
+		}
+
+		/*
+			Collapse in passes. Each pass sorts all possible collapses by their cost and applies the cheapest ones, a position which
+			has been moved or is next to a moved position is not used again in the same pass, so the triangles of the pass stay valid.
+		*/
+		const double maxCost = (double)maxError * (double)maxError;
+		std::vector<uint32_t> remap(vertices.size());
+		std::vector<uint32_t> targets(vertices.size());
+		std::vector<bool> neighbours(vertices.size());
+		std::vector<bool> touched(positionCount);
+		std::vector<uint32_t> adjacencyOffsets(vertices.size() + 1);
+		std::vector<uint32_t> adjacency;
+		std::vector<Collapse> collapses;
+		bool done = false;
+		while (done == false && result.size() > targetIndexCount)
+		{
+			// Triangles around each vertex.
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (uint32_t index : result)
+				adjacencyOffsets[index + 1]++;
+			for (size_t v = 0; v < vertices.size(); v++)
+				adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+			adjacency.resize(result.size());
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32_t i = 0; i < (uint32_t)result.size(); i++)
+				adjacency[fill[result[i]]++] = i / 3;
+
+			collapses.clear();
+			for (size_t t = 0; t < result.size(); t += 3)
+			{
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const uint32_t from = positionIds[result[t + k]];
+					const uint32_t to = positionIds[result[t + (k + 1) % 3]];
+					if (locked[from] == false && from != to)
+					{
+						Quadric quadric = quadrics[from];
+						quadric.add(quadrics[to]);
+						collapses.push_back({ quadric.evaluate(positions[to]), from, to });
+					}
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+			for (size_t v = 0; v < vertices.size(); v++)
+				remap[v] = (uint32_t)v;
+			std::fill(touched.begin(), touched.end(), false);
+			size_t triangleCount = result.size() / 3;
+			const size_t targetTriangles = targetIndexCount / 3;
+			uint32_t collapseCount = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (collapse.cost > maxCost)
+				{
+					done = true;
+					break;
+				}
+				if (triangleCount <= targetTriangles)
+					break;
+				if (touched[collapse.from] || touched[collapse.to])
+					continue;
+
+				// Each vertex at the position moves onto a vertex at the target which shares one of its triangles, so the attributes on
+				// each side of a seam stay on their side. A vertex without such a neighbour (its triangles only touch the position, as in
+				// meshes without welded vertices) follows the vertex at the position with the closest attributes, if they are close
+				// enough to be on the same side of any seam.
+				for (uint32_t i = positionOffsets[collapse.from]; i < positionOffsets[collapse.from + 1]; i++)
+				{
+					const uint32_t v = positionVertices[i];
+					targets[v] = adjacencyOffsets[v] == adjacencyOffsets[v + 1] ? v : UINT32_MAX;
+					neighbours[v] = false;
+					for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1] && targets[v] == UINT32_MAX; a++)
+					{
+						const uint32_t t = adjacency[a] * 3;
+						for (uint32_t k = 0; k < 3; k++)
+						{
+							if (positionIds[result[t + k]] == collapse.to)
+								targets[v] = result[t + k];
+						}
+					}
+					neighbours[v] = targets[v] != UINT32_MAX;
+				}
+				bool valid = true;
+				for (uint32_t i = positionOffsets[collapse.from]; i < positionOffsets[collapse.from + 1] && valid; i++)
+				{
+					const uint32_t v = positionVertices[i];
+					float closest = FLT_MAX;
+					for (uint32_t j = positionOffsets[collapse.from]; j < positionOffsets[collapse.from + 1] && neighbours[v] == false; j++)
+					{
+						const uint32_t u = positionVertices[j];
+						const float uvDistance = glm::length(vertices[u].uv0 - vertices[v].uv0);
+						const float normalDistance = glm::length(vertices[u].nor - vertices[v].nor);
+						if (neighbours[u] && uvDistance <= MESH_SIMPLIFIER_SEAM_UV && normalDistance <= MESH_SIMPLIFIER_SEAM_NORMAL && uvDistance + normalDistance < closest)
+						{
+							closest = uvDistance + normalDistance;
+							targets[v] = targets[u];
+						}
+					}
+					valid = targets[v] != UINT32_MAX;
+				}
+				if (valid == false)
+					continue;
+
+				// Moving the position must not flip any of the triangles which are kept.
+				bool flips = false;
+				uint32_t removed = 0;
+				for (uint32_t i = positionOffsets[collapse.from]; i < positionOffsets[collapse.from + 1] && flips == false; i++)
+				{
+					const uint32_t v = positionVertices[i];
+					for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1] && flips == false; a++)
+					{
+						const uint32_t t = adjacency[a] * 3;
+						glm::vec3 before[3];
+						glm::vec3 after[3];
+						bool collapsed = false;
+						for (uint32_t k = 0; k < 3; k++)
+						{
+							const uint32_t position = positionIds[result[t + k]];
+							collapsed = collapsed || position == collapse.to;
+							before[k] = positions[position];
+							after[k] = position == collapse.from ? positions[collapse.to] : before[k];
+						}
+						if (collapsed)
+						{
+							removed++;
+							continue;
+						}
+						const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+						const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+						flips = glm::dot(normalBefore, normalAfter) <= 0.f;
+					}
+				}
+				if (flips)
+					continue;
+
+				quadrics[collapse.to].add(quadrics[collapse.from]);
+				for (uint32_t i = positionOffsets[collapse.from]; i < positionOffsets[collapse.from + 1]; i++)
+				{
+					const uint32_t v = positionVertices[i];
+					remap[v] = targets[v];
+					for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++)
+					{
+						const uint32_t t = adjacency[a] * 3;
+						touched[positionIds[result[t]]] = true;
+						touched[positionIds[result[t + 1]]] = true;
+						touched[positionIds[result[t + 2]]] = true;
+					}
+				}
+				error = std::max(error, (float)std::sqrt(collapse.cost));
+				triangleCount -= std::min((size_t)removed, triangleCount);
+				collapseCount++;
+			}
+			if (collapseCount == 0)
+				break;
+
+			// Move the collapsed vertices and remove the triangles which became degenerate.
+			size_t write = 0;
+			for (size_t t = 0; t < result.size(); t += 3)
+			{
+				const uint32_t a = remap[result[t]];
+				const uint32_t b = remap[result[t + 1]];
+				const uint32_t c = remap[result[t + 2]];
+				if (positionIds[a] != positionIds[b] && positionIds[b] != positionIds[c] && positionIds[a] != positionIds[c])
+				{
+					result[write++] = a;
+					result[write++] = b;
+					result[write++] = c;
+				}
+			}
+			result.resize(write);
+		}
+		return result;
+	}
+
+	void MeshSimplifier::setEnabled(bool enabled)
+	{
+		MeshSimplifier::enabled = enabled;
+	}
+
+	bool MeshSimplifier::isEnabled()
+	{
+		return enabled;
+	}
+}
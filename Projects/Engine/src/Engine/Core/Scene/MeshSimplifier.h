@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Model/Model.h"
+#include <atomic>
+
+#define MESH_SIMPLIFIER_LOD_RATIO 0.5f		// Each level of detail targets this fraction of the indices of the previous level.
+#define MESH_SIMPLIFIER_MAX_ERROR 0.02f		// Largest error of a level, relative to the size of the primitive.
+#define MESH_SIMPLIFIER_MIN_REDUCTION 0.9f	// A level which keeps more than this fraction of the indices is not worth storing.
+#define MESH_SIMPLIFIER_SEAM_NORMAL 0.75f	// Largest normal distance between two vertices at a position which are treated as one side of a seam.
+#define MESH_SIMPLIFIER_SEAM_UV 0.01f		// Largest UV distance between two vertices at a position which are treated as one side of a seam.
+
+namespace ym
+{
+	/*
+		Generates levels of detail with quadric error edge collapse [Garland and Heckbert 1997]. A position is collapsed onto one of
+		its neighbours, so the simplified meshes reuse the vertices of the full mesh and only need their own indices. The vertices
+		which share a position (UV and normal seams) move together, each onto the vertex of the target on its side of the seam, so
+		seams can only move along themselves. A vertex whose triangles do not reach the target takes the vertex of the target with
+		the closest attributes, which lets meshes without welded vertices be simplified. Positions on open borders are never moved.
+	*/
+	class MeshSimplifier
+	{
+	public:
+		/*
+			Generate up to MODEL_MAX_LODS - 1 simplified levels for every indexed primitive of the model, each primitive as a separate
+			job. The indices of the levels are added after the indices of the model, and the model errors are updated.
+		*/
+		static void generateLods(Model& model);
+
+		/*
+			Set Model::lodCount and Model::lodErrors from the levels of the primitives.
+		*/
+		static void updateModelLods(Model& model);
+
+		/*
+			Collapse edges until the triangle list has at most targetIndexCount indices or the next collapse has a larger error than
+			maxError. Returns the new indices, error is set to the largest distance of a collapse, in the units of the positions.
+		*/
+		static std::vector<uint32_t> simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, float& error);
+
+		/*
+			When disabled, models are loaded without levels of detail.
+		*/
+		static void setEnabled(bool enabled);
+		static bool isEnabled();
+
+	private:
+		MeshSimplifier() = delete;
+
+		static std::atomic<bool> enabled;
+	};
+}
@@ -74,7 +74,7 @@ void ym::CubeMap::init(float scale, const std::string& texturePath)
 		Memory stagingMemory;
 		stagingBuffer.init(sizeof(this->cube), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { VulkanInstance::get()->getTransferQueue().queueIndex });
 		stagingMemory.bindBuffer(&stagingBuffer);
-		stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryAllocator::Lifetime::TRANSIENT);
 		stagingMemory.directTransfer(&stagingBuffer, this->cube, sizeof(this->cube), 0);
 
 		this->cubeBuffer.init(sizeof(this->cube), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, { VulkanInstance::get()->getGraphicsQueue().queueIndex, VulkanInstance::get()->getTransferQueue().queueIndex });
@@ -119,7 +119,7 @@ void ym::CubeMap::init(float scale)
 		Memory stagingMemory;
 		stagingBuffer.init(sizeof(this->cube), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { VulkanInstance::get()->getTransferQueue().queueIndex });
 		stagingMemory.bindBuffer(&stagingBuffer);
-		stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryAllocator::Lifetime::TRANSIENT);
 		stagingMemory.directTransfer(&stagingBuffer, this->cube, sizeof(this->cube), 0);
 
 		this->cubeBuffer.init(sizeof(this->cube), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, { VulkanInstance::get()->getGraphicsQueue().queueIndex, VulkanInstance::get()->getTransferQueue().queueIndex });
@@ -0,0 +1,225 @@
+#include "stdafx.h"
+#include "GeometryArena.h"
+
+#include "Model.h"
+#include "Engine/Core/Vulkan/VulkanInstance.h"
+#include "Engine/Core/Vulkan/CommandPool.h"
+#include "Engine/Core/Vulkan/CommandBuffer.h"
+#include "Engine/Core/Application/LayerManager.h"
+#include "Utils/Imgui/imgui.h"
+
+ym::GeometryArena::GeometryArena() : buffers(nullptr), defragmentCount(0)
+{
+}
+
+ym::GeometryArena::~GeometryArena()
+{
+}
+
+ym::GeometryArena* ym::GeometryArena::get()
+{
+	static GeometryArena arena;
+	return &arena;
+}
+
+void ym::GeometryArena::init(uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+	YM_ASSERT(this->buffers == nullptr, "GeometryArena has already been initialized!");
+	this->vertexAllocator.init(vertexCapacity);
+	this->indexAllocator.init(indexCapacity);
+	this->buffers = createBuffers();
+	this->defragmentCount = 0;
+}
+
+void ym::GeometryArena::destroy()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->buffers == nullptr)
+		return;
+
+	if (this->models.empty() == false)
+		YM_LOG_WARN("GeometryArena destroyed with {} model(s)!", this->models.size());
+	for (Model* model : this->models)
+	{
+		model->isInArena = false;
+		model->vertexOffset = 0;
+		model->indexOffset = 0;
+	}
+	this->models.clear();
+
+	destroyBuffers(this->buffers);
+	this->buffers = nullptr;
+	this->vertexAllocator.destroy();
+	this->indexAllocator.destroy();
+}
+
+bool ym::GeometryArena::add(Model* model)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->buffers == nullptr || model->vertices.empty())
+		return false;
+
+	const uint32_t stride = model->getVertexStride();
+	const uint32_t indexSize = model->getIndexSize();
+	uint64_t vertexOffset = this->vertexAllocator.allocate((uint64_t)model->vertices.size() * stride, stride);
+	if (vertexOffset == RANGE_ALLOCATOR_INVALID)
+		return false;
+
+	uint64_t indexOffset = 0;
+	if (model->indices.empty() == false)
+	{
+		indexOffset = this->indexAllocator.allocate((uint64_t)model->indices.size() * indexSize, indexSize);
+		if (indexOffset == RANGE_ALLOCATOR_INVALID)
+		{
+			this->vertexAllocator.free(vertexOffset);
+			return false;
+		}
+	}
+
+	model->isInArena = true;
+	model->vertexOffset = (uint32_t)(vertexOffset / stride);
+	model->indexOffset = (uint32_t)(indexOffset / indexSize);
+	this->models.insert(model);
+	return true;
+}
+
+void ym::GeometryArena::remove(Model* model)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->models.erase(model) == 0)
+		return;
+
+	this->vertexAllocator.free((uint64_t)model->vertexOffset * model->getVertexStride());
+	if (model->indices.empty() == false)
+		this->indexAllocator.free((uint64_t)model->indexOffset * model->getIndexSize());
+
+	model->isInArena = false;
+	model->vertexOffset = 0;
+	model->indexOffset = 0;
+}
+
+void ym::GeometryArena::defragment()
+{
+	YM_PROFILER_FUNCTION();
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->buffers == nullptr)
+		return;
+
+	std::vector<RangeAllocator::Move> vertexMoves = this->vertexAllocator.defragment();
+	std::vector<RangeAllocator::Move> indexMoves = this->indexAllocator.defragment();
+
+	// The regions of one copy are not allowed to overlap, the ranges are copied into new buffers instead of within the old ones.
+	std::vector<VkBufferCopy> vertexRegions(vertexMoves.size());
+	for (size_t i = 0; i < vertexMoves.size(); i++)
+	{
+		vertexRegions[i].srcOffset = vertexMoves[i].srcOffset;
+		vertexRegions[i].dstOffset = vertexMoves[i].dstOffset;
+		vertexRegions[i].size = vertexMoves[i].size;
+	}
+	std::vector<VkBufferCopy> indexRegions(indexMoves.size());
+	for (size_t i = 0; i < indexMoves.size(); i++)
+	{
+		indexRegions[i].srcOffset = indexMoves[i].srcOffset;
+		indexRegions[i].dstOffset = indexMoves[i].dstOffset;
+		indexRegions[i].size = indexMoves[i].size;
+	}
+
+	// Uploads which are in flight write to the old buffers, they finish before the copy.
+	vkDeviceWaitIdle(VulkanInstance::get()->getLogicalDevice());
+	Buffers* buffers = createBuffers();
+	CommandPool* commandPool = &LayerManager::get()->getCommandPools()->graphicsPool;
+	CommandBuffer* cmdBuffer = commandPool->beginSingleTimeCommand();
+	if (vertexRegions.empty() == false)
+		cmdBuffer->cmdCopyBuffer(this->buffers->vertexBuffer.getBuffer(), buffers->vertexBuffer.getBuffer(), (uint32_t)vertexRegions.size(), vertexRegions.data());
+	if (indexRegions.empty() == false)
+		cmdBuffer->cmdCopyBuffer(this->buffers->indexBuffer.getBuffer(), buffers->indexBuffer.getBuffer(), (uint32_t)indexRegions.size(), indexRegions.data());
+	commandPool->endSingleTimeCommand(cmdBuffer);
+
+	destroyBuffers(this->buffers);
+	this->buffers = buffers;
+
+	// Models which have not been uploaded yet copy their data to the new offsets when they are submitted.
+	std::unordered_map<uint64_t, uint64_t> vertexOffsets;
+	for (RangeAllocator::Move& move : vertexMoves)
+		vertexOffsets[move.srcOffset] = move.dstOffset;
+	std::unordered_map<uint64_t, uint64_t> indexOffsets;
+	for (RangeAllocator::Move& move : indexMoves)
+		indexOffsets[move.srcOffset] = move.dstOffset;
+	for (Model* model : this->models)
+	{
+		const uint32_t stride = model->getVertexStride();
+		const uint32_t indexSize = model->getIndexSize();
+		model->vertexOffset = (uint32_t)(vertexOffsets[(uint64_t)model->vertexOffset * stride] / stride);
+		if (model->indices.empty() == false)
+			model->indexOffset = (uint32_t)(indexOffsets[(uint64_t)model->indexOffset * indexSize] / indexSize);
+	}
+
+	this->defragmentCount++;
+	YM_LOG_INFO("Defragmented geometry arena, moved {} vertex range(s) and {} index range(s).", vertexMoves.size(), indexMoves.size());
+}
+
+VkBuffer ym::GeometryArena::getVertexBuffer() const
+{
+	return this->buffers ? this->buffers->vertexBuffer.getBuffer() : VK_NULL_HANDLE;
+}
+
+VkBuffer ym::GeometryArena::getIndexBuffer() const
+{
+	return this->buffers ? this->buffers->indexBuffer.getBuffer() : VK_NULL_HANDLE;
+}
+
+ym::GeometryArena::Stats ym::GeometryArena::getStats()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Stats stats;
+	stats.vertices = this->vertexAllocator.getStats();
+	stats.indices = this->indexAllocator.getStats();
+	stats.modelCount = (uint32_t)this->models.size();
+	stats.defragmentCount = this->defragmentCount;
+	return stats;
+}
+
+void ym::GeometryArena::drawStats()
+{
+	Stats stats = getStats();
+	const float mb = 1.f / (1024.f * 1024.f);
+
+	static bool active = true;
+	ImGui::Begin("Geometry arena", &active);
+	ImGui::Text("Models: %u", stats.modelCount);
+	ImGui::Text("Vertices: %.2f / %.2f MB", (float)stats.vertices.usedSize * mb, (float)stats.vertices.capacity * mb);
+	ImGui::Text("Indices: %.2f / %.2f MB", (float)stats.indices.usedSize * mb, (float)stats.indices.capacity * mb);
+	ImGui::Text("Free ranges: %u vertex, %u index", stats.vertices.freeRangeCount, stats.indices.freeRangeCount);
+	ImGui::Text("Fragmentation: %.1f%% vertex, %.1f%% index", stats.vertices.fragmentation * 100.f, stats.indices.fragmentation * 100.f);
+	if (ImGui::Button("Defragment"))
+		defragment();
+	ImGui::SameLine();
+	ImGui::Text("Defragmented %u time(s)", stats.defragmentCount);
+	ImGui::End();
+}
+
+ym::GeometryArena::Buffers* ym::GeometryArena::createBuffers()
+{
+	// The buffers are written by uploads on the transfer queue and read on the graphics queue.
+	uint32_t graphicsIndex = VulkanInstance::get()->getGraphicsQueue().queueIndex;
+	uint32_t transferIndex = VulkanInstance::get()->getTransferQueue().queueIndex;
+	std::vector<uint32_t> queueIndices = { graphicsIndex };
+	if (transferIndex != graphicsIndex)
+		queueIndices.push_back(transferIndex);
+
+	Buffers* buffers = new Buffers();
+	buffers->vertexBuffer.init(this->vertexAllocator.getCapacity(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
+	buffers->memory.bindBuffer(&buffers->vertexBuffer);
+	buffers->indexBuffer.init(this->indexAllocator.getCapacity(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, queueIndices);
+	buffers->memory.bindBuffer(&buffers->indexBuffer);
+	buffers->memory.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	return buffers;
+}
+
+void ym::GeometryArena::destroyBuffers(Buffers* buffers)
+{
+	buffers->vertexBuffer.destroy();
+	buffers->indexBuffer.destroy();
+	buffers->memory.destroy();
+	delete buffers;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "../../Vulkan/Buffers/Buffer.h"
+#include "../../Vulkan/Buffers/Memory.h"
+#include "../../Vulkan/Buffers/RangeAllocator.h"
+
+#include <mutex>
+#include <set>
+
+#define GEOMETRY_ARENA_VERTEX_CAPACITY (48u * 1024u * 1024u)	// Bytes of the vertices of all models in the arena.
+#define GEOMETRY_ARENA_INDEX_CAPACITY (16u * 1024u * 1024u)		// Bytes of the indices of all models in the arena.
+
+namespace ym
+{
+	class Model;
+
+	/*
+		One vertex buffer and one index buffer which hold the geometry of all loaded models, so the renderer can bind the geometry
+		once instead of once per model. Each model gets one range of vertices and one range of indices, a draw uses
+		Model::vertexOffset plus Primitive::firstVertex as its vertex offset and adds Model::indexOffset to the first index of the primitive.
+		The ranges are allocated in bytes and aligned to the vertex stride and index size of the model, so models with packed
+		vertices or 16 bit indices can share the buffers with the others. The offsets of a model are in its own vertices and indices.
+		A model which does not fit keeps its own buffers. Ranges are freed when the model is destroyed, defragment packs the
+		remaining models at the start of the buffers.
+	*/
+	class GeometryArena
+	{
+	public:
+		struct Stats
+		{
+			RangeAllocator::Stats vertices;
+			RangeAllocator::Stats indices;
+			uint32_t modelCount{ 0 };
+			uint32_t defragmentCount{ 0 };
+		};
+
+	public:
+		GeometryArena();
+		~GeometryArena();
+
+		static GeometryArena* get();
+
+		void init(uint32_t vertexCapacity = GEOMETRY_ARENA_VERTEX_CAPACITY, uint32_t indexCapacity = GEOMETRY_ARENA_INDEX_CAPACITY);
+		void destroy();
+
+		/*
+			Allocate the ranges of the vertices and indices of the model and set its offsets. Returns false if the arena is full,
+			the model then needs to use its own buffers. Thread safe, the data is not copied.
+		*/
+		bool add(Model* model);
+
+		/*
+			Free the ranges of the model. The caller needs to make sure the GPU no longer uses them.
+		*/
+		void remove(Model* model);
+
+		/*
+			Pack all models at the start of the buffers. The ranges are copied into new buffers and the offsets of the models are
+			updated. Waits for the GPU, draws need to be recorded again afterwards.
+		*/
+		void defragment();
+
+		VkBuffer getVertexBuffer() const;
+		VkBuffer getIndexBuffer() const;
+
+		Stats getStats();
+
+		/*
+			Draw the stats in an ImGui window, with a button which defragments the arena.
+		*/
+		void drawStats();
+
+	private:
+		struct Buffers
+		{
+			Buffer vertexBuffer;
+			Buffer indexBuffer;
+			Memory memory;
+		};
+
+		Buffers* createBuffers();
+		void destroyBuffers(Buffers* buffers);
+
+	private:
+		Buffers* buffers;
+		RangeAllocator vertexAllocator;
+		RangeAllocator indexAllocator;
+		std::set<Model*> models;
+		uint32_t defragmentCount;
+		std::mutex mutex;
+	};
+}
@@ -20,6 +20,7 @@ namespace ym
 		Material();
 
 		uint32_t index = -1;
+		uint32_t tableIndex = -1; // Index in the material table of the renderer, only set when the materials are bindless.
 		Tex baseColorTexture;
 		Tex metallicRoughnessTexture;
 		Tex normalTexture;
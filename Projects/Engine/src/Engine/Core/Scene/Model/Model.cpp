@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "Model.h"
+#include "GeometryArena.h"
 
 namespace ym
 {
@@ -19,13 +20,18 @@ namespace ym
 		for (Node& node : this->nodes)
 			destroyNode(node);
 
-		if (this->indices.empty() == false)
-			this->indexBuffer.destroy();
-		if (this->vertices.empty() == false)
-			this->vertexBuffer.destroy();
+		if (this->isInArena)
+			GeometryArena::get()->remove(this);
+		else
+		{
+			if (this->indices.empty() == false)
+				this->indexBuffer.destroy();
+			if (this->vertices.empty() == false)
+				this->vertexBuffer.destroy();
 
-		if (this->indices.empty() == false && this->vertices.empty() == false)
-			this->bufferMemory.destroy();
+			if (this->indices.empty() == false && this->vertices.empty() == false)
+				this->bufferMemory.destroy();
+		}
 
 		if (hasImageMemory)
 			this->imageMemory.destroy();
@@ -34,7 +40,6 @@ namespace ym
 
 		for (Texture& texture : this->textures)
 			texture.destroy();
-		imageData.clear();
 
 		for (Sampler& sampler : this->samplers)
 			sampler.destroy();
@@ -42,6 +47,26 @@ namespace ym
 		this->hasLoaded = false;
 	}
 
+	VkBuffer Model::getVertexBuffer() const
+	{
+		return this->isInArena ? GeometryArena::get()->getVertexBuffer() : this->vertexBuffer.getBuffer();
+	}
+
+	VkBuffer Model::getIndexBuffer() const
+	{
+		return this->isInArena ? GeometryArena::get()->getIndexBuffer() : this->indexBuffer.getBuffer();
+	}
+
+	uint32_t Model::getVertexStride() const
+	{
+		return this->vertexFormat == VertexFormat::PACKED ? (uint32_t)sizeof(PackedVertex) : (uint32_t)sizeof(Vertex);
+	}
+
+	uint32_t Model::getIndexSize() const
+	{
+		return this->indexType == VK_INDEX_TYPE_UINT16 ? (uint32_t)sizeof(uint16_t) : (uint32_t)sizeof(uint32_t);
+	}
+
 	void Model::destroyNode(Node& node)
 	{
 		for (UniformBuffer& ub : node.uniformBuffers)
@@ -11,15 +11,40 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 
+#define MODEL_MAX_LODS 4 // Levels of detail of a model, including the full resolution mesh.
+
 namespace ym
 {
+	// Axis aligned box and the sphere around it.
+	struct Bounds
+	{
+		glm::vec3 min{ 0.f };
+		glm::vec3 max{ 0.f };
+		glm::vec3 center{ 0.f };
+		float radius{ 0.f };
+	};
+
 	struct Primitive
 	{
 		uint32_t firstIndex{ 0 };
 		uint32_t indexCount{ 0 };
+		uint32_t firstVertex{ 0 }; // Smallest index of the primitive, the indices on the GPU are relative to it.
 		uint32_t vertexCount{ 0 };
 		bool hasIndices{ false };
 		Material* material{ nullptr };
+
+		// Simplified versions of the primitive, LOD 1 and up. They use the same vertices as the primitive with fewer indices.
+		struct Lod
+		{
+			uint32_t firstIndex{ 0 };
+			uint32_t indexCount{ 0 };
+			float error{ 0.f }; // Largest distance to the full resolution mesh, in the space of the model.
+		};
+		std::vector<Lod> lods;
+
+		// Index range of a level of detail, a primitive with fewer levels uses its most simplified one.
+		uint32_t getFirstIndex(uint32_t lod) const { return (lod == 0 || this->lods.empty()) ? this->firstIndex : this->lods[std::min(lod, (uint32_t)this->lods.size()) - 1].firstIndex; }
+		uint32_t getIndexCount(uint32_t lod) const { return (lod == 0 || this->lods.empty()) ? this->indexCount : this->lods[std::min(lod, (uint32_t)this->lods.size()) - 1].indexCount; }
 	};
 
 	class Mesh
@@ -37,10 +62,15 @@ namespace ym
 			struct NodeData
 			{
 				glm::mat4 transform;
+				// Decodes the packed vertices of the model, identity if the vertices are not packed.
+				glm::vec4 positionOffset;
+				glm::vec4 positionScale;
+				glm::vec4 uvTransform; // xy: offset, zw: scale
 			};
 
 			bool hasMesh{ false };
 			Mesh mesh;
+			Bounds bounds; // Bounds of the mesh transformed by the matrix, only set if the node has a mesh.
 			glm::vec3 translation;
 			glm::quat rotation;
 			glm::vec3 scale;
@@ -58,12 +88,27 @@ namespace ym
 
 		void destroy();
 
+		/*
+			Buffers which hold the geometry, the buffers of the GeometryArena if the model is in it.
+		*/
+		VkBuffer getVertexBuffer() const;
+		VkBuffer getIndexBuffer() const;
+
+		/*
+			Size of one vertex and one index on the GPU, depends on the vertex format and index type.
+		*/
+		uint32_t getVertexStride() const;
+		uint32_t getIndexSize() const;
+
 		uint32_t uniqueId;
 		bool hasLoaded{ false };
 
 		// Layout
 		std::vector<Node> nodes;
 		uint32_t numMeshes;
+		Bounds bounds; // Bounds of all nodes, in the space of the model.
+		uint32_t lodCount{ 1 };
+		std::array<float, MODEL_MAX_LODS> lodErrors{}; // Largest error of all primitives at each level of detail.
 
 		// Data
 		std::vector<uint32_t> indices;
@@ -72,8 +117,17 @@ namespace ym
 		Buffer vertexBuffer;
 		Memory bufferMemory;
 
+		// Format of the geometry on the GPU. The vectors above always hold full vertices and 32 bit indices, they are converted when uploaded.
+		VertexFormat vertexFormat{ VertexFormat::FULL };
+		VkIndexType indexType{ VK_INDEX_TYPE_UINT32 };
+		VertexQuantization quantization;
+
+		// Offsets of the geometry in the GeometryArena, in vertices and indices. Both are zero if the model has its own buffers.
+		bool isInArena{ false };
+		uint32_t vertexOffset{ 0 };
+		uint32_t indexOffset{ 0 };
+
 		bool hasImageMemory{ false };
-		std::vector<std::vector<uint8_t>> imageData;
 		std::vector<Texture> textures;
 		Memory imageMemory;
 
@@ -0,0 +1,489 @@
+#include "stdafx.h"
+#include "ModelCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+#include "Engine/Core/Vulkan/VulkanInstance.h"
+#include "Utils/MappedFile.h"
+#include "Utils/FileUtils.h"
+
+#include <filesystem>
+#include <set>
+
+#define MODEL_CACHE_ALIGNMENT 16 // Alignment of each section in the file.
+
+namespace ym
+{
+	std::atomic<bool> ModelCache::enabled{ true };
+
+	bool ModelCache::load(const std::string& filePath, Model* model, GLTFLoader::StagingBuffers* stagingBuffers)
+	{
+		MappedFile file;
+		if (file.open(getCachePath(filePath)) == false)
+			return false;
+
+		const uint8_t* data = file.getData();
+		if (isUpToDate(filePath, data, file.getSize()) == false)
+		{
+			YM_LOG_INFO("  Model cache is out of date. [{}]", filePath.c_str());
+			return false;
+		}
+		const Header* header = reinterpret_cast<const Header*>(data);
+
+		// Geometry
+		const Vertex* vertices = reinterpret_cast<const Vertex*>(data + header->vertexOffset);
+		const uint32_t* indices = reinterpret_cast<const uint32_t*>(data + header->indexOffset);
+		model->vertices.assign(vertices, vertices + header->vertexCount);
+		model->indices.assign(indices, indices + header->indexCount);
+		model->numMeshes = header->numMeshes;
+
+		// Textures
+		VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+		const CachedTexture* cachedTextures = reinterpret_cast<const CachedTexture*>(data + header->textureOffset);
+		model->textures.resize(header->textureCount);
+		model->hasImageMemory = header->textureCount > 0;
+		for (uint32_t textureIndex = 0; textureIndex < header->textureCount; textureIndex++)
+		{
+			const CachedTexture& cachedTexture = cachedTextures[textureIndex];
+			Texture& texture = model->textures[textureIndex];
+			texture.image.init(cachedTexture.width, cachedTexture.height, format, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, GLTFLoader::getUploadQueueIndices(), 0, 1, cachedTexture.mipLevels);
+			model->imageMemory.bindTexture(&texture);
+			texture.textureDesc.width = cachedTexture.width;
+			texture.textureDesc.height = cachedTexture.height;
+			texture.textureDesc.format = format;
+		}
+		if (model->hasImageMemory)
+		{
+			model->imageMemory.init(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			for (Texture& texture : model->textures)
+			{
+				texture.imageView.init(texture.image.getImage(), VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, 1, texture.image.getMipLevels());
+				texture.descriptor.imageView = texture.imageView.getImageView();
+				texture.descriptor.imageLayout = texture.image.getLayout();
+			}
+		}
+
+		// Samplers
+		const CachedSampler* cachedSamplers = reinterpret_cast<const CachedSampler*>(data + header->samplerOffset);
+		model->samplers.resize(header->samplerCount);
+		for (uint32_t samplerIndex = 0; samplerIndex < header->samplerCount; samplerIndex++)
+		{
+			const CachedSampler& cachedSampler = cachedSamplers[samplerIndex];
+			tinygltf::Sampler samplerGltf;
+			samplerGltf.minFilter = cachedSampler.minFilter;
+			samplerGltf.magFilter = cachedSampler.magFilter;
+			samplerGltf.wrapS = cachedSampler.wrapS;
+			samplerGltf.wrapT = cachedSampler.wrapT;
+			model->samplerMipLevelMap[samplerIndex] = cachedSampler.mipLevels;
+			GLTFLoader::loadSamplerData(samplerGltf, model->samplers[samplerIndex], cachedSampler.mipLevels);
+		}
+
+		// Materials
+		const CachedMaterial* cachedMaterials = reinterpret_cast<const CachedMaterial*>(data + header->materialOffset);
+		model->materials.resize(header->materialCount);
+		model->hasMaterialMemory = header->materialCount > 0;
+		auto getTex = [&](int32_t index)->Material::Tex {
+			Texture* texture = index != -1 ? &model->textures[index] : GLTFLoader::defaultData.texture;
+			Sampler* sampler = (index != -1 && cachedTextures[index].sampler != -1) ? &model->samplers[cachedTextures[index].sampler] : &GLTFLoader::defaultData.sampler;
+			return { texture, sampler };
+		};
+		for (uint32_t materialIndex = 0; materialIndex < header->materialCount; materialIndex++)
+		{
+			const CachedMaterial& cachedMaterial = cachedMaterials[materialIndex];
+			Material& material = model->materials[materialIndex];
+			material.index = materialIndex;
+			material.baseColorTexture = getTex(cachedMaterial.baseColorTexture);
+			material.metallicRoughnessTexture = getTex(cachedMaterial.metallicRoughnessTexture);
+			material.normalTexture = getTex(cachedMaterial.normalTexture);
+			material.occlusionTexture = getTex(cachedMaterial.occlusionTexture);
+			material.emissiveTexture = getTex(cachedMaterial.emissiveTexture);
+			material.pushData = cachedMaterial.pushData;
+		}
+
+		// Nodes
+		const CachedNode* cachedNode = reinterpret_cast<const CachedNode*>(data + header->nodeOffset);
+		const CachedPrimitive* cachedPrimitives = reinterpret_cast<const CachedPrimitive*>(data + header->primitiveOffset);
+		model->nodes.resize(header->rootNodeCount);
+		for (Model::Node& node : model->nodes)
+			cachedNode = readNode(cachedNode, cachedPrimitives, *model, node);
+		MeshSimplifier::updateModelLods(*model);
+
+		// Staging, the images already have all of their mip levels and are copied as they are.
+		if (header->imageSize > 0)
+		{
+			stagingBuffers->imageBuffer.init(header->imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { VulkanInstance::get()->getTransferQueue().queueIndex });
+			stagingBuffers->imageMemory.bindBuffer(&stagingBuffers->imageBuffer);
+			stagingBuffers->imageMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryAllocator::Lifetime::TRANSIENT);
+			stagingBuffers->imageMemory.directTransfer(&stagingBuffers->imageBuffer, data + header->imageOffset, header->imageSize, (Offset)0);
+		}
+		stagingBuffers->hasMipLevels = true;
+
+		GLTFLoader::selectGeometryFormat(*model, GLTFLoader::packVertices);
+		stagingBuffers->geometryBuffer.init(GLTFLoader::getIndicesSize(*model) + GLTFLoader::getVerticesSize(*model), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { VulkanInstance::get()->getTransferQueue().queueIndex });
+		stagingBuffers->geometryMemory.bindBuffer(&stagingBuffers->geometryBuffer);
+		return true;
+	}
+
+	bool ModelCache::bake(const std::string& filePath, Model* model, tinygltf::Model& gltfModel, GLTFLoader::StagingBuffers* stagingBuffers)
+	{
+		std::string folderPath = filePath.substr(0, filePath.find_last_of("/\\") + 1);
+
+		// Files which the model was loaded from, embedded data does not need to be checked.
+		std::set<std::string> dependencyPaths;
+		for (tinygltf::Buffer& buffer : gltfModel.buffers)
+		{
+			if (buffer.uri.empty() == false && buffer.uri.rfind("data:", 0) != 0)
+				dependencyPaths.insert(buffer.uri);
+		}
+		for (tinygltf::Image& image : gltfModel.images)
+		{
+			if (image.uri.empty() == false && image.uri.rfind("data:", 0) != 0)
+				dependencyPaths.insert(image.uri);
+		}
+
+		std::vector<uint8_t> dependencies;
+		for (const std::string& path : dependencyPaths)
+		{
+			CachedDependency dependency = {};
+			if (getFileInfo(folderPath + path, dependency.size, dependency.writeTime) == false)
+				return false;
+			dependency.pathLength = (uint32_t)path.size();
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&dependency);
+			dependencies.insert(dependencies.end(), bytes, bytes + sizeof(CachedDependency));
+			dependencies.insert(dependencies.end(), path.begin(), path.end());
+			dependencies.resize((dependencies.size() + 7) & ~(size_t)7, 0);
+		}
+
+		std::vector<CachedNode> nodes;
+		std::vector<CachedPrimitive> primitives;
+		for (Model::Node& node : model->nodes)
+			writeNode(nodes, primitives, *model, node);
+
+		auto textureIndex = [&](Texture* texture)->int32_t {
+			if (model->textures.empty() || texture < model->textures.data() || texture >= model->textures.data() + model->textures.size())
+				return -1;
+			return (int32_t)(texture - model->textures.data());
+		};
+		std::vector<CachedMaterial> materials(model->materials.size());
+		for (size_t materialIndex = 0; materialIndex < model->materials.size(); materialIndex++)
+		{
+			Material& material = model->materials[materialIndex];
+			CachedMaterial& cachedMaterial = materials[materialIndex];
+			cachedMaterial.baseColorTexture = textureIndex(material.baseColorTexture.texture);
+			cachedMaterial.metallicRoughnessTexture = textureIndex(material.metallicRoughnessTexture.texture);
+			cachedMaterial.normalTexture = textureIndex(material.normalTexture.texture);
+			cachedMaterial.occlusionTexture = textureIndex(material.occlusionTexture.texture);
+			cachedMaterial.emissiveTexture = textureIndex(material.emissiveTexture.texture);
+			cachedMaterial.pushData = material.pushData;
+		}
+
+		uint64_t imageSize = 0;
+		std::vector<CachedTexture> textures(model->textures.size());
+		for (size_t i = 0; i < model->textures.size(); i++)
+		{
+			Texture& texture = model->textures[i];
+			CachedTexture& cachedTexture = textures[i];
+			cachedTexture.width = texture.textureDesc.width;
+			cachedTexture.height = texture.textureDesc.height;
+			cachedTexture.mipLevels = texture.image.getMipLevels();
+			cachedTexture.sampler = gltfModel.textures[i].sampler;
+			cachedTexture.offset = imageSize;
+			cachedTexture.size = getTextureSize(cachedTexture.width, cachedTexture.height, cachedTexture.mipLevels);
+			imageSize += cachedTexture.size;
+		}
+
+		std::vector<CachedSampler> samplers(gltfModel.samplers.size());
+		for (size_t i = 0; i < gltfModel.samplers.size(); i++)
+		{
+			samplers[i].minFilter = gltfModel.samplers[i].minFilter;
+			samplers[i].magFilter = gltfModel.samplers[i].magFilter;
+			samplers[i].wrapS = gltfModel.samplers[i].wrapS;
+			samplers[i].wrapT = gltfModel.samplers[i].wrapT;
+			samplers[i].mipLevels = model->samplerMipLevelMap[(uint32_t)i];
+		}
+
+		// Place the sections after each other.
+		Header header;
+		memset(&header, 0, sizeof(Header));
+		memcpy(header.magic, "YMC", 4);
+		header.version = MODEL_CACHE_VERSION;
+		header.sourceHash = FileUtils::hashFile(filePath);
+		if (getFileInfo(filePath, header.sourceSize, header.sourceWriteTime) == false)
+			return false;
+		header.vertexSize = (uint32_t)sizeof(Vertex);
+		header.numMeshes = model->numMeshes;
+		header.rootNodeCount = (uint32_t)model->nodes.size();
+		header.dependencyCount = (uint32_t)dependencyPaths.size();
+		header.nodeCount = (uint32_t)nodes.size();
+		header.primitiveCount = (uint32_t)primitives.size();
+		header.materialCount = (uint32_t)materials.size();
+		header.textureCount = (uint32_t)textures.size();
+		header.samplerCount = (uint32_t)samplers.size();
+		header.vertexCount = (uint32_t)model->vertices.size();
+		header.indexCount = (uint32_t)model->indices.size();
+		header.flags = (MeshOptimizer::isEnabled() ? MODEL_CACHE_FLAG_OPTIMIZED : 0) | (MeshSimplifier::isEnabled() ? MODEL_CACHE_FLAG_LODS : 0);
+
+		uint64_t offset = sizeof(Header);
+		auto place = [&offset](uint64_t size)->uint64_t {
+			offset = (offset + MODEL_CACHE_ALIGNMENT - 1) & ~(uint64_t)(MODEL_CACHE_ALIGNMENT - 1);
+			uint64_t sectionOffset = offset;
+			offset += size;
+			return sectionOffset;
+		};
+		header.dependencyOffset = place(dependencies.size());
+		header.nodeOffset = place(nodes.size() * sizeof(CachedNode));
+		header.primitiveOffset = place(primitives.size() * sizeof(CachedPrimitive));
+		header.materialOffset = place(materials.size() * sizeof(CachedMaterial));
+		header.textureOffset = place(textures.size() * sizeof(CachedTexture));
+		header.samplerOffset = place(samplers.size() * sizeof(CachedSampler));
+		header.vertexOffset = place(model->vertices.size() * sizeof(Vertex));
+		header.indexOffset = place(model->indices.size() * sizeof(uint32_t));
+		header.imageOffset = place(imageSize);
+		header.imageSize = imageSize;
+
+		// Written through a temporary file, a model which is loaded at the same time should never see a half written cache.
+		std::string cachePath = getCachePath(filePath);
+		bool written = FileUtils::writeAtomic(cachePath, [&](std::ofstream& file) {
+			uint64_t fileOffset = 0;
+			auto write = [&file, &fileOffset](uint64_t sectionOffset, const void* data, uint64_t size) {
+				static const char zeros[MODEL_CACHE_ALIGNMENT] = {};
+				file.write(zeros, (std::streamsize)(sectionOffset - fileOffset));
+				file.write(static_cast<const char*>(data), (std::streamsize)size);
+				fileOffset = sectionOffset + size;
+			};
+			write(0, &header, sizeof(Header));
+			write(header.dependencyOffset, dependencies.data(), dependencies.size());
+			write(header.nodeOffset, nodes.data(), nodes.size() * sizeof(CachedNode));
+			write(header.primitiveOffset, primitives.data(), primitives.size() * sizeof(CachedPrimitive));
+			write(header.materialOffset, materials.data(), materials.size() * sizeof(CachedMaterial));
+			write(header.textureOffset, textures.data(), textures.size() * sizeof(CachedTexture));
+			write(header.samplerOffset, samplers.data(), samplers.size() * sizeof(CachedSampler));
+			write(header.vertexOffset, model->vertices.data(), model->vertices.size() * sizeof(Vertex));
+			write(header.indexOffset, model->indices.data(), model->indices.size() * sizeof(uint32_t));
+
+			// The first level of each image is in the staging buffer, in the same order as the textures.
+			const uint8_t* stagingData = static_cast<const uint8_t*>(stagingBuffers->imageMemory.getMappedData(&stagingBuffers->imageBuffer));
+			uint64_t stagingOffset = 0;
+			std::vector<uint8_t> levels;
+			for (CachedTexture& cachedTexture : textures)
+			{
+				const uint64_t firstLevelSize = (uint64_t)cachedTexture.width * (uint64_t)cachedTexture.height * 4;
+				levels.resize(cachedTexture.size);
+				memcpy(levels.data(), stagingData + stagingOffset, firstLevelSize);
+				generateMipLevels(levels, cachedTexture.width, cachedTexture.height, cachedTexture.mipLevels);
+				write(header.imageOffset + cachedTexture.offset, levels.data(), cachedTexture.size);
+				stagingOffset += firstLevelSize;
+			}
+		});
+		if (written == false)
+		{
+			YM_LOG_WARN("  Could not write model cache. [{}]", cachePath.c_str());
+			return false;
+		}
+		YM_LOG_INFO("  Baked model cache. [{}]", cachePath.c_str());
+		return true;
+	}
+
+	std::string ModelCache::getCachePath(const std::string& filePath)
+	{
+		return filePath + MODEL_CACHE_EXTENSION;
+	}
+
+	void ModelCache::setEnabled(bool enabled)
+	{
+		ModelCache::enabled = enabled;
+	}
+
+	bool ModelCache::isEnabled()
+	{
+		return enabled;
+	}
+
+	bool ModelCache::getFileInfo(const std::string& filePath, uint64_t& size, int64_t& writeTime)
+	{
+		std::error_code error;
+		size = (uint64_t)std::filesystem::file_size(filePath, error);
+		if (error)
+			return false;
+		writeTime = (int64_t)std::filesystem::last_write_time(filePath, error).time_since_epoch().count();
+		return !error;
+	}
+
+	bool ModelCache::isUpToDate(const std::string& filePath, const uint8_t* data, uint64_t size)
+	{
+		if (size < sizeof(Header))
+			return false;
+
+		const Header* header = reinterpret_cast<const Header*>(data);
+		if (memcmp(header->magic, "YMC", 4) != 0 || header->version != MODEL_CACHE_VERSION || header->vertexSize != (uint32_t)sizeof(Vertex))
+			return false;
+
+		// A cache written with the other optimizer setting has its vertices in a different order.
+		if (((header->flags & MODEL_CACHE_FLAG_OPTIMIZED) != 0) != MeshOptimizer::isEnabled())
+			return false;
+		if (((header->flags & MODEL_CACHE_FLAG_LODS) != 0) != MeshSimplifier::isEnabled())
+			return false;
+
+		// A truncated file is treated as out of date.
+		auto fits = [size](uint64_t offset, uint64_t sectionSize) { return offset <= size && sectionSize <= size - offset; };
+		if (fits(header->nodeOffset, (uint64_t)header->nodeCount * sizeof(CachedNode)) == false ||
+			fits(header->primitiveOffset, (uint64_t)header->primitiveCount * sizeof(CachedPrimitive)) == false ||
+			fits(header->materialOffset, (uint64_t)header->materialCount * sizeof(CachedMaterial)) == false ||
+			fits(header->textureOffset, (uint64_t)header->textureCount * sizeof(CachedTexture)) == false ||
+			fits(header->samplerOffset, (uint64_t)header->samplerCount * sizeof(CachedSampler)) == false ||
+			fits(header->vertexOffset, (uint64_t)header->vertexCount * sizeof(Vertex)) == false ||
+			fits(header->indexOffset, (uint64_t)header->indexCount * sizeof(uint32_t)) == false ||
+			fits(header->imageOffset, header->imageSize) == false)
+			return false;
+
+		// Hashing the source is only needed when its write time changed, a different size always means different content.
+		uint64_t sourceSize = 0;
+		int64_t sourceWriteTime = 0;
+		if (getFileInfo(filePath, sourceSize, sourceWriteTime) == false || sourceSize != header->sourceSize)
+			return false;
+		if (sourceWriteTime != header->sourceWriteTime && header->sourceHash != FileUtils::hashFile(filePath))
+			return false;
+
+		std::string folderPath = filePath.substr(0, filePath.find_last_of("/\\") + 1);
+		uint64_t offset = header->dependencyOffset;
+		for (uint32_t i = 0; i < header->dependencyCount; i++)
+		{
+			if (fits(offset, sizeof(CachedDependency)) == false)
+				return false;
+			const CachedDependency* dependency = reinterpret_cast<const CachedDependency*>(data + offset);
+			offset += sizeof(CachedDependency);
+			if (fits(offset, dependency->pathLength) == false)
+				return false;
+
+			std::string path(reinterpret_cast<const char*>(data + offset), dependency->pathLength);
+			uint64_t fileSize = 0;
+			int64_t writeTime = 0;
+			if (getFileInfo(folderPath + path, fileSize, writeTime) == false || fileSize != dependency->size || writeTime != dependency->writeTime)
+				return false;
+			offset = (offset + dependency->pathLength + 7) & ~(uint64_t)7;
+		}
+		return true;
+	}
+
+	void ModelCache::writeNode(std::vector<CachedNode>& nodes, std::vector<CachedPrimitive>& primitives, Model& model, Model::Node& node)
+	{
+		CachedNode cachedNode = {};
+		cachedNode.matrix = node.matrix;
+		cachedNode.rotation = node.rotation;
+		cachedNode.translation = node.translation;
+		cachedNode.scale = node.scale;
+		cachedNode.childCount = (uint32_t)node.children.size();
+		cachedNode.hasMesh = node.hasMesh ? 1 : 0;
+		cachedNode.firstPrimitive = (uint32_t)primitives.size();
+		cachedNode.primitiveCount = node.hasMesh ? (uint32_t)node.mesh.primitives.size() : 0;
+		nodes.push_back(cachedNode);
+
+		for (uint32_t i = 0; i < cachedNode.primitiveCount; i++)
+		{
+			Primitive& primitive = node.mesh.primitives[i];
+			CachedPrimitive cachedPrimitive = {};
+			cachedPrimitive.firstIndex = primitive.firstIndex;
+			cachedPrimitive.indexCount = primitive.indexCount;
+			cachedPrimitive.vertexCount = primitive.vertexCount;
+			cachedPrimitive.hasIndices = primitive.hasIndices ? 1 : 0;
+			bool hasMaterial = model.materials.empty() == false && primitive.material >= model.materials.data() && primitive.material < model.materials.data() + model.materials.size();
+			cachedPrimitive.material = hasMaterial ? (int32_t)(primitive.material - model.materials.data()) : -1;
+			cachedPrimitive.lodCount = (uint32_t)std::min(primitive.lods.size(), (size_t)MODEL_MAX_LODS - 1);
+			for (uint32_t lod = 0; lod < cachedPrimitive.lodCount; lod++)
+			{
+				cachedPrimitive.lods[lod].firstIndex = primitive.lods[lod].firstIndex;
+				cachedPrimitive.lods[lod].indexCount = primitive.lods[lod].indexCount;
+				cachedPrimitive.lods[lod].error = primitive.lods[lod].error;
+			}
+			primitives.push_back(cachedPrimitive);
+		}
+
+		for (Model::Node& child : node.children)
+			writeNode(nodes, primitives, model, child);
+	}
+
+	const ModelCache::CachedNode* ModelCache::readNode(const CachedNode* cachedNode, const CachedPrimitive* primitives, Model& model, Model::Node& node)
+	{
+		node.model = &model;
+		node.matrix = cachedNode->matrix;
+		node.rotation = cachedNode->rotation;
+		node.translation = cachedNode->translation;
+		node.scale = cachedNode->scale;
+		node.hasMesh = cachedNode->hasMesh != 0;
+
+		node.mesh.primitives.resize(cachedNode->primitiveCount);
+		for (uint32_t i = 0; i < cachedNode->primitiveCount; i++)
+		{
+			const CachedPrimitive& cachedPrimitive = primitives[cachedNode->firstPrimitive + i];
+			Primitive& primitive = node.mesh.primitives[i];
+			primitive.firstIndex = cachedPrimitive.firstIndex;
+			primitive.indexCount = cachedPrimitive.indexCount;
+			primitive.vertexCount = cachedPrimitive.vertexCount;
+			primitive.hasIndices = cachedPrimitive.hasIndices != 0;
+			primitive.material = cachedPrimitive.material != -1 ? &model.materials[cachedPrimitive.material] : nullptr;
+			primitive.lods.resize(std::min(cachedPrimitive.lodCount, (uint32_t)MODEL_MAX_LODS - 1));
+			for (uint32_t lod = 0; lod < (uint32_t)primitive.lods.size(); lod++)
+			{
+				primitive.lods[lod].firstIndex = cachedPrimitive.lods[lod].firstIndex;
+				primitive.lods[lod].indexCount = cachedPrimitive.lods[lod].indexCount;
+				primitive.lods[lod].error = cachedPrimitive.lods[lod].error;
+			}
+		}
+
+		const CachedNode* next = cachedNode + 1;
+		node.children.resize(cachedNode->childCount);
+		for (Model::Node& child : node.children)
+		{
+			child.parent = &node;
+			next = readNode(next, primitives, model, child);
+		}
+		return next;
+	}
+
+	uint64_t ModelCache::getTextureSize(uint32_t width, uint32_t height, uint32_t mipLevels)
+	{
+		uint64_t size = 0;
+		for (uint32_t level = 0; level < mipLevels; level++)
+		{
+			size += (uint64_t)width * (uint64_t)height * 4;
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+		return size;
+	}
+
+	void ModelCache::generateMipLevels(std::vector<uint8_t>& data, uint32_t width, uint32_t height, uint32_t mipLevels)
+	{
+		uint64_t srcOffset = 0;
+		for (uint32_t level = 1; level < mipLevels; level++)
+		{
+			const uint32_t dstWidth = width > 1 ? width / 2 : 1;
+			const uint32_t dstHeight = height > 1 ? height / 2 : 1;
+			const uint64_t dstOffset = srcOffset + (uint64_t)width * (uint64_t)height * 4;
+			const uint8_t* src = data.data() + srcOffset;
+			uint8_t* dst = data.data() + dstOffset;
+
+			for (uint32_t y = 0; y < dstHeight; y++)
+			{
+				// Odd sizes repeat the last row or column.
+				const uint32_t y0 = std::min(y * 2, height - 1);
+				const uint32_t y1 = std::min(y * 2 + 1, height - 1);
+				for (uint32_t x = 0; x < dstWidth; x++)
+				{
+					const uint32_t x0 = std::min(x * 2, width - 1);
+					const uint32_t x1 = std::min(x * 2 + 1, width - 1);
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						uint32_t sum = (uint32_t)src[((uint64_t)y0 * width + x0) * 4 + c] + (uint32_t)src[((uint64_t)y0 * width + x1) * 4 + c] +
+							(uint32_t)src[((uint64_t)y1 * width + x0) * 4 + c] + (uint32_t)src[((uint64_t)y1 * width + x1) * 4 + c];
+						dst[((uint64_t)y * dstWidth + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+					}
+				}
+			}
+
+			srcOffset = dstOffset;
+			width = dstWidth;
+			height = dstHeight;
+		}
+	}
+}
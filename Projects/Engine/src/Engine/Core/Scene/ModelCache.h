@@ -0,0 +1,161 @@
+#pragma once
+
+#include "GLTFLoader.h"
+#include <atomic>
+
+#define MODEL_CACHE_VERSION 3
+#define MODEL_CACHE_EXTENSION ".ymc"	// The cache file is placed next to the source file, with this extension added.
+#define MODEL_CACHE_FLAG_OPTIMIZED 1u	// The geometry went through the MeshOptimizer.
+#define MODEL_CACHE_FLAG_LODS 2u		// The primitives have levels of detail from the MeshSimplifier.
+
+namespace ym
+{
+	/*
+		Pre-baked binary version of a glTF model. The file holds the vertices, indices, node tree, materials, samplers and the textures
+		with all of their mip levels, decoded to RGBA8. The sections are plain structs which are read from a memory mapped file, and the
+		image data is copied to the staging buffer with a single memcpy.
+
+		The cache is written the first time a model is loaded from glTF. It is only used if the size and write time of the source file
+		and of every file it references (buffers and images) are the same as when it was written. The source file is only hashed when
+		its write time changed, a file which was touched or copied without changes can still use the cache.
+	*/
+	class ModelCache
+	{
+	public:
+		/*
+			Load the model from its cache file. Returns false if there is no cache file or if it is out of date, the model is not
+			changed in that case.
+		*/
+		static bool load(const std::string& filePath, Model* model, GLTFLoader::StagingBuffers* stagingBuffers);
+
+		/*
+			Write the cache file for a model which has just been loaded from glTF. The decoded images are read back from the staging
+			buffer and their mip levels are generated on the CPU.
+		*/
+		static bool bake(const std::string& filePath, Model* model, tinygltf::Model& gltfModel, GLTFLoader::StagingBuffers* stagingBuffers);
+
+		static std::string getCachePath(const std::string& filePath);
+
+		/*
+			When disabled, models are always loaded from glTF and no cache files are written.
+		*/
+		static void setEnabled(bool enabled);
+		static bool isEnabled();
+
+	private:
+		struct Header
+		{
+			char magic[4];
+			uint32_t version;
+			uint64_t sourceHash;
+			uint64_t sourceSize;
+			int64_t sourceWriteTime;
+			uint32_t vertexSize;		// sizeof(Vertex) when the file was written.
+			uint32_t numMeshes;
+			uint32_t rootNodeCount;
+			uint32_t dependencyCount;
+			uint32_t nodeCount;
+			uint32_t primitiveCount;
+			uint32_t materialCount;
+			uint32_t textureCount;
+			uint32_t samplerCount;
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			uint32_t flags;				// MODEL_CACHE_FLAG_*
+			uint64_t dependencyOffset;
+			uint64_t nodeOffset;
+			uint64_t primitiveOffset;
+			uint64_t materialOffset;
+			uint64_t textureOffset;
+			uint64_t samplerOffset;
+			uint64_t vertexOffset;
+			uint64_t indexOffset;
+			uint64_t imageOffset;
+			uint64_t imageSize;
+		};
+
+		// A file which the model was loaded from. The path is stored directly after the struct and is relative to the source file.
+		struct CachedDependency
+		{
+			uint64_t size;
+			int64_t writeTime;
+			uint32_t pathLength;
+			uint32_t _padding;
+		};
+
+		// Nodes are stored depth first, the children of a node follow directly after it.
+		struct CachedNode
+		{
+			glm::mat4 matrix;
+			glm::quat rotation;
+			glm::vec3 translation;
+			glm::vec3 scale;
+			uint32_t childCount;
+			uint32_t hasMesh;
+			uint32_t firstPrimitive;
+			uint32_t primitiveCount;
+		};
+
+		struct CachedLod
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float error;
+		};
+
+		struct CachedPrimitive
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			uint32_t vertexCount;
+			uint32_t hasIndices;
+			int32_t material;
+			uint32_t lodCount;			// Levels of detail after the full resolution one.
+			CachedLod lods[MODEL_MAX_LODS - 1];
+		};
+
+		// Texture indices are -1 if the default texture is used.
+		struct CachedMaterial
+		{
+			int32_t baseColorTexture;
+			int32_t metallicRoughnessTexture;
+			int32_t normalTexture;
+			int32_t occlusionTexture;
+			int32_t emissiveTexture;
+			Material::PushData pushData;
+		};
+
+		// The mip levels of a texture are stored after each other, starting with the largest. The offset is relative to the image data.
+		struct CachedTexture
+		{
+			uint32_t width;
+			uint32_t height;
+			uint32_t mipLevels;
+			int32_t sampler;
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		struct CachedSampler
+		{
+			int32_t minFilter;
+			int32_t magFilter;
+			int32_t wrapS;
+			int32_t wrapT;
+			uint32_t mipLevels;
+		};
+
+		static bool getFileInfo(const std::string& filePath, uint64_t& size, int64_t& writeTime);
+		static bool isUpToDate(const std::string& filePath, const uint8_t* data, uint64_t size);
+
+		static void writeNode(std::vector<CachedNode>& nodes, std::vector<CachedPrimitive>& primitives, Model& model, Model::Node& node);
+		static const CachedNode* readNode(const CachedNode* cachedNode, const CachedPrimitive* primitives, Model& model, Model::Node& node);
+
+		// Size of a texture with all of its mip levels in RGBA8.
+		static uint64_t getTextureSize(uint32_t width, uint32_t height, uint32_t mipLevels);
+		// Box filter each level from the one above it. The first level is already in data.
+		static void generateMipLevels(std::vector<uint8_t>& data, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+		static std::atomic<bool> enabled;
+	};
+}
@@ -30,21 +30,29 @@ void ym::ObjectManager::destroy()
 		objs.clear();
 	}
 	this->gameObjects.clear();
+	this->freeIDs.clear();
+	this->nextID = 0;
 }
 
 void ym::ObjectManager::update()
 {
 	if (this->shouldRemove.empty() == false)
 	{
+		// The same object can be removed more than once before the update, it should only be deleted once.
+		std::sort(this->shouldRemove.begin(), this->shouldRemove.end());
+		this->shouldRemove.erase(std::unique(this->shouldRemove.begin(), this->shouldRemove.end()), this->shouldRemove.end());
+
 		for (GameObject*& gameObject : this->shouldRemove)
 		{
 			auto it = this->gameObjects.find(gameObject->getModel());
 			if (it != this->gameObjects.end())
 			{
-				gameObject->destroy();
 				it->second.erase(std::remove(it->second.begin(), it->second.end(), gameObject), it->second.end());
 				if (it->second.empty())
-					this->gameObjects.erase(gameObject->getModel());
+					this->gameObjects.erase(it);
+				this->freeIDs.push_back(gameObject->getID());
+				gameObject->destroy();
+				SAFE_DELETE(gameObject);
 			}
 		}
 		this->shouldRemove.clear();
@@ -55,6 +63,7 @@ ym::GameObject* ym::ObjectManager::createGameObject(const glm::vec3& pos, Model*
 {
 	GameObject* gameObject = new GameObject();
 	gameObject->init(pos, model);
+	gameObject->setID(allocateID());
 
 	auto it = this->gameObjects.find(model);
 	if (it != this->gameObjects.end())
@@ -72,6 +81,7 @@ ym::GameObject* ym::ObjectManager::createGameObject(const glm::mat4& transform,
 {
 	GameObject* gameObject = new GameObject();
 	gameObject->init(transform, model);
+	gameObject->setID(allocateID());
 
 	auto it = this->gameObjects.find(model);
 	if (it != this->gameObjects.end())
@@ -100,3 +110,12 @@ std::unordered_map<ym::Model*, std::vector<ym::GameObject*>>& ym::ObjectManager:
 {
 	return this->gameObjects;
 }
+
+uint32_t ym::ObjectManager::allocateID()
+{
+	if (this->freeIDs.empty())
+		return this->nextID++;
+	uint32_t id = this->freeIDs.back();
+	this->freeIDs.pop_back();
+	return id;
+}
@@ -24,8 +24,13 @@ namespace ym
 
 		std::unordered_map<Model*, std::vector<GameObject*>>& getGameObjects();
 
+	private:
+		uint32_t allocateID();
+
 	private:
 		std::unordered_map<Model*, std::vector<GameObject*>> gameObjects;
 		std::vector<GameObject*> shouldRemove;
+		std::vector<uint32_t> freeIDs; // IDs of removed objects, reused before new ones are handed out.
+		uint32_t nextID{ 0 };
 	};
 }
\ No newline at end of file
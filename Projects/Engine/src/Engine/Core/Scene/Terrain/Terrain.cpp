@@ -1,233 +1,548 @@
 #include "stdafx.h"
 #include "Terrain.h"
-#include "Engine/Core/Vulkan/Factory.h"
 #include "Engine/Core/Input/Config.h"
 
-void ym::Terrain::init(uint32_t dataWidth, uint32_t dataHeight, uint8_t* data, Description description)
+#include <emmintrin.h>
+
+ym::Terrain::Terrain() : uniqueId(0), desc(), lodRanges(), splitLod(0), cullLod(0)
+{
+}
+
+ym::Terrain::~Terrain()
+{
+}
+
+void ym::Terrain::init(uint32_t dataWidth, uint32_t dataHeight, const uint8_t* data, Description description)
+{
+	std::vector<uint16_t> samples((size_t)dataWidth * (size_t)dataHeight);
+	for (size_t i = 0; i < samples.size(); i++)
+		samples[i] = (uint16_t)(data[i] * 257);
+	init(dataWidth, dataHeight, samples.data(), description);
+}
+
+void ym::Terrain::init(uint32_t dataWidth, uint32_t dataHeight, const uint16_t* data, Description description)
+{
+	this->desc = description;
+
+	uint32_t tileBudget = (uint32_t)Config::get()->fetch<int>("Terrain/tileBudget");
+	this->tiles.init(dataWidth, dataHeight, data, tileBudget);
+	initLodRanges();
+
+	static uint64_t idGenerator = 0;
+	this->uniqueId = idGenerator++;
+}
+
+bool ym::Terrain::init(const std::string& tilePath, Description description)
 {
-	int32_t regionSize = Config::get()->fetch<int>("Terrain/regionSize");
-	int32_t proximityRadius = Config::get()->fetch<int>("Terrain/proximityRadius");
-	this->proximityDescription = Terrain::createProximityDescription(dataWidth, regionSize, proximityRadius);
-	
 	this->desc = description;
-	
-	int32_t padding = this->proximityDescription.regionWidthCount * (this->proximityDescription.regionSize - 1) + 1 - dataWidth;
 
-	this->width = dataWidth + padding;
-	this->height = dataHeight + padding;
-	
-	generateVertices(dataWidth, dataHeight, data);
-	generateNormals();
+	uint32_t tileBudget = (uint32_t)Config::get()->fetch<int>("Terrain/tileBudget");
+	if (this->tiles.init(tilePath, tileBudget) == false)
+		return false;
+	initLodRanges();
 
 	static uint64_t idGenerator = 0;
 	this->uniqueId = idGenerator++;
+	return true;
 }
 
 void ym::Terrain::destroy()
 {
+	this->tiles.destroy();
+	this->subtrees.clear();
+	this->subtreeNodes.clear();
 }
 
 float ym::Terrain::getHeightAt(const glm::vec3& pos) const
 {
-	auto toOffest = [&](glm::ivec2 v)->uint32_t {
-		v = glm::clamp(v, 0, this->width - 1);
-		return v.x + v.y * this->height;
-	};
+	uint32_t width = this->tiles.getWidth();
+	uint32_t height = this->tiles.getHeight();
+
+	// Position in samples, clamped to the heightmap.
+	float x = glm::clamp((pos.x - this->desc.origin.x) / this->desc.vertDist, 0.f, (float)(width - 1));
+	float z = glm::clamp((pos.z - this->desc.origin.z) / this->desc.vertDist, 0.f, (float)(height - 1));
+	uint32_t ix = glm::min((uint32_t)x, width - 2);
+	uint32_t iz = glm::min((uint32_t)z, height - 2);
+	float fx = x - (float)ix;
+	float fz = z - (float)iz;
+
+	float h00, h10, h01, h11;
+	getQuadHeights(ix, iz, h00, h10, h01, h11);
+
+	// The quad is split along the diagonal from (0, 0) to (1, 1), the same as the indices of the patch.
+	if (fz >= fx)
+		return h00 + fz * (h01 - h00) + fx * (h11 - h01);
+	return h00 + fx * (h10 - h00) + fz * (h11 - h10);
+}
 
-	float xDist = pos.x - this->desc.origin.x;
-	float zDist = pos.z - this->desc.origin.z;
-
-	// This is the bottom left corner in the quad x and z is in.
-	glm::ivec2 blIdx;
-	blIdx.x = static_cast<int>(xDist / this->desc.vertDist);
-	blIdx.y = static_cast<int>(zDist / this->desc.vertDist);
-
-	// Get the other corner indices.
-	glm::ivec2 tlIdx(blIdx.x, blIdx.y - 1);
-	glm::ivec2 trIdx(blIdx.x + 1, blIdx.y - 1);
-	glm::ivec2 brIdx(blIdx.x + 1, blIdx.y);
-
-	// Fetch each vertices height
-	float bl = this->vertices[toOffest(blIdx)].pos.y;
-	float tl = this->vertices[toOffest(tlIdx)].pos.y;
-	float br = this->vertices[toOffest(brIdx)].pos.y;
-	float tr = this->vertices[toOffest(trIdx)].pos.y;
-
-	// Check which triangle it is in.
-	glm::vec2 point;
-	point.x = fmod(xDist, this->desc.vertDist) / this->desc.vertDist;
-	point.y = fmod(zDist, this->desc.vertDist) / this->desc.vertDist;
-	bool isLeft = point.x <= (1.0f - point.y);
-
-	float height = 0.0f;
-	if (isLeft)
-	{
-		// Top left triangle
-		height = barryCentricHeight({ 0, tl, 0 }, { 1, tr, 0 }, { 0, bl, 1 }, point);
-	}
-	else
+void ym::Terrain::getHeightsAt(const glm::vec3* positions, uint32_t count, float* heights) const
+{
+	const uint16_t* samples = this->tiles.getSamples();
+	const uint32_t stride = this->tiles.getSampleStride();
+	const float width = (float)this->tiles.getWidth();
+	const float height = (float)this->tiles.getHeight();
+
+	const __m128 originX = _mm_set1_ps(this->desc.origin.x);
+	const __m128 originZ = _mm_set1_ps(this->desc.origin.z);
+	const __m128 invVertDist = _mm_set1_ps(1.f / this->desc.vertDist);
+	const __m128 lastX = _mm_set1_ps(width - 1.f);
+	const __m128 lastZ = _mm_set1_ps(height - 1.f);
+	const __m128 lastQuadX = _mm_set1_ps(width - 2.f);
+	const __m128 lastQuadZ = _mm_set1_ps(height - 2.f);
+	const __m128 base = _mm_set1_ps(this->desc.origin.y + this->desc.minZ);
+	const __m128 scale = _mm_set1_ps((this->desc.maxZ - this->desc.minZ) / 65535.f);
+
+	alignas(16) int32_t quadX[4], quadZ[4];
+	alignas(16) float h00[4], h10[4], h01[4], h11[4];
+	uint32_t i = 0;
+	for (; i + 4 <= count; i += 4)
 	{
-		// Bottom right triangle
-		height = barryCentricHeight({ 1, tr, 0 }, { 1, br, 1 }, { 0, bl, 1 }, point);
+		// Position in samples, clamped to the heightmap. A NaN position becomes 0, max returns its second operand.
+		const glm::vec3* p = positions + i;
+		__m128 x = _mm_mul_ps(_mm_sub_ps(_mm_set_ps(p[3].x, p[2].x, p[1].x, p[0].x), originX), invVertDist);
+		__m128 z = _mm_mul_ps(_mm_sub_ps(_mm_set_ps(p[3].z, p[2].z, p[1].z, p[0].z), originZ), invVertDist);
+		x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), lastX);
+		z = _mm_min_ps(_mm_max_ps(z, _mm_setzero_ps()), lastZ);
+		const __m128i ix = _mm_cvttps_epi32(_mm_min_ps(x, lastQuadX));
+		const __m128i iz = _mm_cvttps_epi32(_mm_min_ps(z, lastQuadZ));
+		const __m128 fx = _mm_sub_ps(x, _mm_cvtepi32_ps(ix));
+		const __m128 fz = _mm_sub_ps(z, _mm_cvtepi32_ps(iz));
+
+		// There is no gather in SSE, the corners are read one position at a time.
+		_mm_store_si128(reinterpret_cast<__m128i*>(quadX), ix);
+		_mm_store_si128(reinterpret_cast<__m128i*>(quadZ), iz);
+		for (uint32_t j = 0; j < 4; j++)
+		{
+			const uint16_t* s = samples + this->tiles.getSampleOffset((uint32_t)quadX[j], (uint32_t)quadZ[j]);
+			h00[j] = s[0];
+			h10[j] = s[1];
+			h01[j] = s[stride];
+			h11[j] = s[stride + 1];
+		}
+		const __m128 a = _mm_load_ps(h00);
+		const __m128 b = _mm_load_ps(h10);
+		const __m128 c = _mm_load_ps(h01);
+		const __m128 d = _mm_load_ps(h11);
+
+		// Both triangles of the quad are interpolated and the one which holds the position is kept.
+		const __m128 upper = _mm_add_ps(a, _mm_add_ps(_mm_mul_ps(fz, _mm_sub_ps(c, a)), _mm_mul_ps(fx, _mm_sub_ps(d, c))));
+		const __m128 lower = _mm_add_ps(a, _mm_add_ps(_mm_mul_ps(fx, _mm_sub_ps(b, a)), _mm_mul_ps(fz, _mm_sub_ps(d, b))));
+		const __m128 isUpper = _mm_cmpge_ps(fz, fx);
+		const __m128 h = _mm_or_ps(_mm_and_ps(isUpper, upper), _mm_andnot_ps(isUpper, lower));
+		_mm_storeu_ps(heights + i, _mm_add_ps(base, _mm_mul_ps(h, scale)));
 	}
 
-	return height;
+	for (; i < count; i++)
+		heights[i] = getHeightAt(positions[i]);
+}
+
+glm::vec3 ym::Terrain::getNormalAt(const glm::vec3& pos) const
+{
+	const float vertDist = this->desc.vertDist;
+	float hl = getHeightAt(pos - glm::vec3(vertDist, 0.f, 0.f));
+	float hr = getHeightAt(pos + glm::vec3(vertDist, 0.f, 0.f));
+	float hd = getHeightAt(pos - glm::vec3(0.f, 0.f, vertDist));
+	float hu = getHeightAt(pos + glm::vec3(0.f, 0.f, vertDist));
+	return glm::normalize(glm::vec3(hl - hr, 2.f * vertDist, hd - hu));
 }
 
-glm::ivec2 ym::Terrain::getRegionFromPos(const glm::vec3& pos, int32_t regionSize) const
+bool ym::Terrain::rayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const
 {
-	float regionWorldSize = (regionSize - 1) * this->desc.vertDist;
+	// The ray is cast in samples in xz and in the heights of the terrain in y, the distance along it is the same in both spaces.
+	const float invVertDist = 1.f / this->desc.vertDist;
+	const glm::vec3 o((origin.x - this->desc.origin.x) * invVertDist, origin.y, (origin.z - this->desc.origin.z) * invVertDist);
+	const glm::vec3 d(direction.x * invVertDist, direction.y, direction.z * invVertDist);
+
+	struct Cell
+	{
+		uint32_t x;
+		uint32_t z;
+		uint32_t level;
+		float tMin;
+		float tMax;
+	};
+
+	// Cells are visited front to back, the children of a cell are pushed furthest first. Every level adds at most three cells.
+	const TerrainHeightPyramid& pyramid = this->tiles.getPyramid();
+	std::array<Cell, TERRAIN_PYRAMID_MAX_LEVELS * 3 + 1> stack;
+	uint32_t stackSize = 0;
 
-	float xDistance = pos.x - this->desc.origin.x;
-	float zDistance = pos.z - this->desc.origin.z;
+	Cell root = { 0, 0, pyramid.getLevelCount() - 1, 0.f, maxDistance };
+	if (intersectBox(o, d, getCellBounds(root.level, 0, 0), root.tMin, root.tMax))
+		stack[stackSize++] = root;
 
-	// Calculate region index from position
-	glm::vec2 index(0);
-	index.x = (float)static_cast<int>(xDistance / regionWorldSize);
-	index.y = (float)static_cast<int>(zDistance / regionWorldSize);
+	while (stackSize > 0)
+	{
+		const Cell cell = stack[--stackSize];
+		if (cell.level == 0)
+		{
+			if (rayCastCell(o, d, cell.x, cell.z, cell.tMin, cell.tMax, distance))
+				return true;
+			continue;
+		}
 
-	return index;
+		Cell children[4];
+		uint32_t childCount = 0;
+		const uint32_t level = cell.level - 1;
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			Cell child = { cell.x * 2 + (i & 1), cell.z * 2 + (i >> 1), level, cell.tMin, cell.tMax };
+			if (child.x >= pyramid.getCellCountX(level) || child.z >= pyramid.getCellCountZ(level))
+				continue;
+			if (intersectBox(o, d, getCellBounds(level, child.x, child.z), child.tMin, child.tMax) == false)
+				continue;
+
+			// Sorted by the distance where the ray enters them, furthest first.
+			uint32_t j = childCount++;
+			for (; j > 0 && children[j - 1].tMin < child.tMin; j--)
+				children[j] = children[j - 1];
+			children[j] = child;
+		}
+		for (uint32_t i = 0; i < childCount; i++)
+			stack[stackSize++] = children[i];
+	}
+	return false;
 }
 
-void ym::Terrain::fetchVertices(int32_t proximityWidth, const glm::vec3& pos, std::vector<Vertex>& verticesOut) const
+void ym::Terrain::select(const glm::vec3& cameraPosition, const std::vector<Camera::Plane>& planes, Selection& selection, bool gpuCulling)
 {
-	float xDistance = pos.x - this->desc.origin.x;
-	float zDistance = pos.z - this->desc.origin.z;
+	YM_PROFILER_FUNCTION();
 
-	// Calculate vertex index from position
-	int xIndex = static_cast<int>(xDistance / this->desc.vertDist);
-	int zIndex = static_cast<int>(zDistance / this->desc.vertDist);
+	this->cullLod = gpuCulling ? this->splitLod : 0;
+	selection.nodes.clear();
+	selection.fallbackCount = 0;
+	selection.triangleCount = 0;
+	this->subtrees.clear();
 
-	// Handle both odd and even vertex count on height map
-	if (proximityWidth % 2 != 0) {
-		// Odd
-		xIndex -= proximityWidth / 2;
-		zIndex -= proximityWidth / 2;
-	}
-	else {
-		// Even
-		xIndex -= (proximityWidth / 2) - 1;
-		zIndex -= (proximityWidth / 2) - 1;
+	// Select the top levels on this thread, the subtrees below the split level are collected and selected as separate jobs.
+	uint32_t topLod = this->tiles.getLodCount() - 1;
+	std::vector<glm::uvec3>* subtreesPtr = this->splitLod > 0 ? &this->subtrees : nullptr;
+	selectNode(0, 0, topLod, cameraPosition, planes, selection.nodes, subtreesPtr);
+
+	if (this->subtrees.empty() == false)
+	{
+		if (this->subtreeNodes.size() < this->subtrees.size())
+			this->subtreeNodes.resize(this->subtrees.size());
+
+		JobCounter counter;
+		JobSystem::dispatch((uint32_t)this->subtrees.size(), 1, [&](uint32_t first, uint32_t last) {
+			for (uint32_t i = first; i < last; i++)
+			{
+				const glm::uvec3& subtree = this->subtrees[i];
+				this->subtreeNodes[i].clear();
+				selectNode(subtree.x, subtree.y, subtree.z, cameraPosition, planes, this->subtreeNodes[i], nullptr);
+			}
+		}, &counter);
+		JobSystem::wait(&counter);
+
+		for (size_t i = 0; i < this->subtrees.size(); i++)
+			selection.nodes.insert(selection.nodes.end(), this->subtreeNodes[i].begin(), this->subtreeNodes[i].end());
 	}
 
-	// Return vertices within proximity off position. {PADDED VERSION}
-	for (int j = 0; j < proximityWidth; j++)
+	// Mark the tiles as used and fall back to the closest coarser tile which is resident. The coarser tiles are requested as well,
+	// they are loaded first, so the terrain fills in from coarse to fine when the camera moves quickly.
+	const uint64_t patchTriangles = TERRAIN_PATCH_SIZE * TERRAIN_PATCH_SIZE * 2;
+	for (Node& node : selection.nodes)
 	{
-		int zTemp = zIndex + j;
-		for (int i = 0; i < proximityWidth; i++)
+		uint32_t lod = node.lod;
+		uint32_t tile = this->tiles.getTileIndex(lod, node.x, node.z);
+		this->tiles.touch(tile);
+		while (this->tiles.isResident(tile) == false && lod < topLod)
 		{
-			int xTemp = xIndex + i;
-			if ((xTemp >= 0 && xTemp < this->width) && (zTemp >= 0 && zTemp < this->height)) {
-				int offset = xTemp + zTemp * this->width;
-				verticesOut[(size_t)i + (size_t)j * (size_t)proximityWidth] = this->vertices[offset];
-			}
-			else {
-				Vertex padVertex;
-				padVertex.pos = glm::vec3(xTemp, 0.f, zTemp) * this->desc.vertDist + this->desc.origin;
-				padVertex.nor = glm::vec3(0.f, 1.f, 0.f);
-				padVertex.uv0 = glm::vec2(xTemp, zTemp);
-				verticesOut[(size_t)i + (size_t)j * (size_t)proximityWidth] = padVertex;
-			}
+			lod++;
+			tile = this->tiles.getTileIndex(lod, node.x, node.z);
+			this->tiles.touch(tile);
+		}
+		node.tile = tile;
+
+		if (lod != node.lod)
+			selection.fallbackCount++;
+
+		if (node.quarters == 0xF)
+			selection.triangleCount += patchTriangles;
+		else
+		{
+			for (uint32_t i = 0; i < 4; i++)
+				selection.triangleCount += (node.quarters >> i) & 1 ? patchTriangles / 4 : 0;
 		}
 	}
+
+	this->tiles.update();
 }
 
-uint64_t ym::Terrain::getUniqueID() const
+float ym::Terrain::getLodRange(uint32_t lod) const
 {
-	return this->uniqueId;
+	return this->lodRanges[lod];
 }
 
-VkDescriptorSet& ym::Terrain::getDescriptorSet()
+float ym::Terrain::getMorphStart(uint32_t lod) const
 {
-	return this->descriptorSet;
+	return this->lodRanges[lod] * TERRAIN_MORPH_START;
 }
 
-int32_t ym::Terrain::getRegionCount() const
+const ym::Terrain::Description& ym::Terrain::getDescription() const
 {
-	return this->proximityDescription.regionCount;
+	return this->desc;
 }
 
-glm::vec3 ym::Terrain::getOrigin() const
+ym::TerrainTiles& ym::Terrain::getTiles()
 {
-	return this->desc.origin;
+	return this->tiles;
 }
 
-ym::Terrain::ProximityDescription ym::Terrain::createProximityDescription(int32_t dataWidth, int32_t regionSize, int32_t proximityRadius)
+uint64_t ym::Terrain::getUniqueID() const
 {
-	Terrain::ProximityDescription desc;
-	desc.regionSize = regionSize;
-	desc.proximityRadius = proximityRadius;
+	return this->uniqueId;
+}
 
-	const int quads = desc.regionSize - 1;
-	desc.indiciesPerRegion = (quads * quads) * 6;
+glm::vec3 ym::Terrain::getOrigin() const
+{
+	return this->desc.origin;
+}
 
-	int regionCountWidth = 1 + desc.proximityRadius * 2;
-	desc.proximityWidth = desc.regionSize * regionCountWidth - regionCountWidth + 1;
+void ym::Terrain::initLodRanges()
+{
+	// Each level covers twice the distance of the previous level, the coarsest level covers everything.
+	float lodRange = Config::get()->fetch<float>("Terrain/lodRange");
+	uint32_t lodCount = this->tiles.getLodCount();
+	for (uint32_t lod = 0; lod < lodCount; lod++)
+		this->lodRanges[lod] = lodRange * (float)(TERRAIN_PATCH_SIZE << lod) * this->desc.vertDist;
+	this->lodRanges[lodCount - 1] = FLT_MAX;
+
+	this->splitLod = lodCount - 1 > TERRAIN_SELECT_SPLIT ? lodCount - 1 - TERRAIN_SELECT_SPLIT : 0;
+}
 
-	desc.regionWidthCount = static_cast<int32_t>(ceilf((dataWidth - 1) / (float)(desc.regionSize - 1)));
-	desc.regionCount = desc.regionWidthCount * desc.regionWidthCount;
-	return desc;
+ym::Terrain::Bounds ym::Terrain::getNodeBounds(uint32_t x, uint32_t z, uint32_t lod) const
+{
+	// The cell of the height pyramid with the size of the node holds the heights of exactly the samples of the node.
+	uint32_t size = TERRAIN_PATCH_SIZE << lod;
+	const TerrainHeightPyramid::MinMax& cell = this->tiles.getPyramid().getCell(lod + TERRAIN_PYRAMID_NODE_LEVEL, x, z);
+	float heightScale = (this->desc.maxZ - this->desc.minZ) / 65535.f;
+
+	Bounds bounds;
+	bounds.min.x = (float)x * this->desc.vertDist;
+	bounds.min.y = this->desc.minZ + (float)cell.min * heightScale;
+	bounds.min.z = (float)z * this->desc.vertDist;
+	bounds.max.x = (float)glm::min(x + size, this->tiles.getWidth() - 1) * this->desc.vertDist;
+	bounds.max.y = this->desc.minZ + (float)cell.max * heightScale;
+	bounds.max.z = (float)glm::min(z + size, this->tiles.getHeight() - 1) * this->desc.vertDist;
+	bounds.min += this->desc.origin;
+	bounds.max += this->desc.origin;
+	return bounds;
 }
 
-void ym::Terrain::generateVertices(uint32_t dataWidth, uint32_t dataHeight, uint8_t* data)
+ym::Terrain::Bounds ym::Terrain::getCellBounds(uint32_t level, uint32_t cellX, uint32_t cellZ) const
 {
-	const unsigned maxValue = 0xFF;
-	float zDist = abs(this->desc.maxZ - this->desc.minZ);
-	this->vertices.resize((size_t)this->width * (size_t)this->height);
+	// In the space of rayCast, samples in xz and the heights of the terrain in y.
+	const uint32_t size = TERRAIN_PYRAMID_CELL_SIZE << level;
+	const uint32_t x = cellX * size;
+	const uint32_t z = cellZ * size;
+	const TerrainHeightPyramid::MinMax& cell = this->tiles.getPyramid().getCell(level, x, z);
+	const float base = this->desc.origin.y + this->desc.minZ;
+	const float heightScale = (this->desc.maxZ - this->desc.minZ) / 65535.f;
+
+	Bounds bounds;
+	bounds.min = glm::vec3((float)x, base + (float)cell.min * heightScale, (float)z);
+	bounds.max.x = (float)glm::min(x + size, this->tiles.getWidth() - 1);
+	bounds.max.y = base + (float)cell.max * heightScale;
+	bounds.max.z = (float)glm::min(z + size, this->tiles.getHeight() - 1);
+	return bounds;
+}
 
-	for (int32_t z = 0; z < this->height; z++)
+bool ym::Terrain::rayCastCell(const glm::vec3& origin, const glm::vec3& direction, uint32_t cellX, uint32_t cellZ, float tMin, float tMax, float& distance) const
+{
+	// Walk the quads of the cell which the ray passes over [Amanatides and Woo 1987], in the order the ray enters them.
+	const int32_t firstX = (int32_t)(cellX * TERRAIN_PYRAMID_CELL_SIZE);
+	const int32_t firstZ = (int32_t)(cellZ * TERRAIN_PYRAMID_CELL_SIZE);
+	const int32_t lastX = glm::min(firstX + TERRAIN_PYRAMID_CELL_SIZE, (int32_t)this->tiles.getWidth() - 1) - 1;
+	const int32_t lastZ = glm::min(firstZ + TERRAIN_PYRAMID_CELL_SIZE, (int32_t)this->tiles.getHeight() - 1) - 1;
+
+	const glm::vec3 entry = origin + direction * tMin;
+	int32_t x = glm::clamp((int32_t)glm::floor(entry.x), firstX, lastX);
+	int32_t z = glm::clamp((int32_t)glm::floor(entry.z), firstZ, lastZ);
+	const int32_t stepX = direction.x > 0.f ? 1 : -1;
+	const int32_t stepZ = direction.z > 0.f ? 1 : -1;
+	const float deltaX = direction.x != 0.f ? glm::abs(1.f / direction.x) : FLT_MAX;
+	const float deltaZ = direction.z != 0.f ? glm::abs(1.f / direction.z) : FLT_MAX;
+	float nextX = direction.x != 0.f ? ((float)(x + (stepX > 0 ? 1 : 0)) - origin.x) / direction.x : FLT_MAX;
+	float nextZ = direction.z != 0.f ? ((float)(z + (stepZ > 0 ? 1 : 0)) - origin.z) / direction.z : FLT_MAX;
+
+	while (true)
 	{
-		for (int32_t x = 0; x < this->width; x++)
+		// The triangles are the same as in getHeightAt, the quad is split along the diagonal from (0, 0) to (1, 1).
+		float h00, h10, h01, h11;
+		getQuadHeights((uint32_t)x, (uint32_t)z, h00, h10, h01, h11);
+		const glm::vec3 v00((float)x, h00, (float)z);
+		const glm::vec3 v10((float)x + 1.f, h10, (float)z);
+		const glm::vec3 v01((float)x, h01, (float)z + 1.f);
+		const glm::vec3 v11((float)x + 1.f, h11, (float)z + 1.f);
+
+		float t = FLT_MAX;
+		float triangleT;
+		if (intersectTriangle(origin, direction, v00, v01, v11, triangleT) && triangleT >= 0.f)
+			t = triangleT;
+		if (intersectTriangle(origin, direction, v00, v11, v10, triangleT) && triangleT >= 0.f)
+			t = glm::min(t, triangleT);
+		if (t <= tMax)
 		{
-			float height = 0;
-			if (z < (int32_t)dataHeight && x < (int32_t)dataWidth)
-				height = this->desc.minZ + ((float)data[x + z * (int32_t)dataWidth] / maxValue) * zDist;
-
-			float xPos = this->desc.origin.x + x * this->desc.vertDist;
-			float zPos = this->desc.origin.z + z * this->desc.vertDist;
+			distance = t;
+			return true;
+		}
 
-			Vertex& vertex = this->vertices[(size_t)x + (size_t)z * (size_t)this->height];
-			vertex.pos = glm::vec4(xPos, height, zPos, 1.0);
-			vertex.uv0 = glm::vec2(x, z);
+		if (nextX < nextZ)
+		{
+			if (nextX > tMax)
+				return false;
+			x += stepX;
+			nextX += deltaX;
 		}
+		else
+		{
+			if (nextZ > tMax)
+				return false;
+			z += stepZ;
+			nextZ += deltaZ;
+		}
+		if (x < firstX || x > lastX || z < firstZ || z > lastZ)
+			return false;
 	}
 }
 
-void ym::Terrain::generateNormals()
+void ym::Terrain::getQuadHeights(uint32_t x, uint32_t z, float& h00, float& h10, float& h01, float& h11) const
 {
-	auto getIndex = [&](int32_t x, int32_t z)->size_t {
-		return (size_t)x + (size_t)z * (size_t)this->height;
-	};
+	// The quad at x, z is never on the last row or column, its corners are next to each other in the samples.
+	const uint16_t* s = this->tiles.getSamples() + this->tiles.getSampleOffset(x, z);
+	const uint32_t stride = this->tiles.getSampleStride();
+	const float base = this->desc.origin.y + this->desc.minZ;
+	const float heightScale = (this->desc.maxZ - this->desc.minZ) / 65535.f;
+	h00 = base + (float)s[0] * heightScale;
+	h10 = base + (float)s[1] * heightScale;
+	h01 = base + (float)s[stride] * heightScale;
+	h11 = base + (float)s[stride + 1] * heightScale;
+}
+
+bool ym::Terrain::isInRange(const Bounds& bounds, const glm::vec3& cameraPosition, uint32_t lod) const
+{
+	float range = this->lodRanges[lod];
+	if (range == FLT_MAX)
+		return true;
+
+	glm::vec3 closest = glm::clamp(cameraPosition, bounds.min, bounds.max);
+	glm::vec3 d = closest - cameraPosition;
+	return glm::dot(d, d) <= range * range;
+}
+
+bool ym::Terrain::selectNode(uint32_t x, uint32_t z, uint32_t lod, const glm::vec3& cameraPosition, const std::vector<Camera::Plane>& planes, std::vector<Node>& nodes, std::vector<glm::uvec3>* subtrees) const
+{
+	// Returns false if the node is out of the range of its level, then the parent draws this area.
+	Bounds bounds = getNodeBounds(x, z, lod);
+	if (isInRange(bounds, cameraPosition, lod) == false)
+		return false;
+
+	// Outside of the frustum, handled but nothing is drawn.
+	if (lod >= this->cullLod && isInFrustum(bounds, planes) == false)
+		return true;
+
+	Node node;
+	node.x = x;
+	node.z = z;
+	node.lod = lod;
 
-	for (int32_t z = 0; z < this->height; z++)
+	if (lod == 0 || isInRange(bounds, cameraPosition, lod - 1) == false)
 	{
-		for (int32_t x = 0; x < this->width; x++)
-		{
-			float west, east, north, south;
+		node.quarters = 0xF;
+		nodes.push_back(node);
+		return true;
+	}
 
-			//Get adjacent vertex height from heightmap image then calculate normals with the height
-			int32_t offset = std::max((z - 1), 0);
-			west = this->vertices[getIndex(x, offset)].pos.y;
+	// Children which are out of their range are drawn as quarters of this node.
+	uint32_t half = TERRAIN_PATCH_SIZE << (lod - 1);
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		uint32_t childX = x + (i & 1) * half;
+		uint32_t childZ = z + (i >> 1) * half;
+		if (childX >= this->tiles.getWidth() - 1 || childZ >= this->tiles.getHeight() - 1)
+			continue;
 
-			offset = glm::min((z + 1), this->width - 1);
-			east = this->vertices[getIndex(x, offset)].pos.y;
+		if (subtrees && lod - 1 == this->splitLod)
+		{
+			// The range is tested here, it decides if the quarter is drawn by this node. The rest is done by a job.
+			Bounds childBounds = getNodeBounds(childX, childZ, lod - 1);
+			if (isInRange(childBounds, cameraPosition, lod - 1) == false)
+				node.quarters |= 1 << i;
+			else
+				subtrees->push_back(glm::uvec3(childX, childZ, lod - 1));
+		}
+		else if (selectNode(childX, childZ, lod - 1, cameraPosition, planes, nodes, subtrees) == false)
+			node.quarters |= 1 << i;
+	}
 
-			offset = glm::max((x - 1), 0);
-			north = this->vertices[getIndex(offset, z)].pos.y;
+	if (node.quarters != 0)
+		nodes.push_back(node);
+	return true;
+}
 
-			offset = glm::min((x + 1), this->height - 1);
-			south = this->vertices[getIndex(offset, z)].pos.y;
+bool ym::Terrain::isInFrustum(const Bounds& bounds, const std::vector<Camera::Plane>& planes)
+{
+	// The box is outside if its corner furthest along the normal is behind any plane.
+	for (const Camera::Plane& plane : planes)
+	{
+		glm::vec3 p;
+		p.x = plane.normal.x >= 0.f ? bounds.max.x : bounds.min.x;
+		p.y = plane.normal.y >= 0.f ? bounds.max.y : bounds.min.y;
+		p.z = plane.normal.z >= 0.f ? bounds.max.z : bounds.min.z;
+		if (glm::dot(plane.normal, p - plane.point) < 0.f)
+			return false;
+	}
+	return true;
+}
 
-			this->vertices[getIndex(x, z)].nor = glm::normalize(glm::vec3(west - east, 2.f, south - north));
+bool ym::Terrain::intersectBox(const glm::vec3& origin, const glm::vec3& direction, const Bounds& bounds, float& tMin, float& tMax)
+{
+	// Slab test, clips the range of the ray which is passed in.
+	for (int i = 0; i < 3; i++)
+	{
+		if (direction[i] == 0.f)
+		{
+			if (origin[i] < bounds.min[i] || origin[i] > bounds.max[i])
+				return false;
+			continue;
 		}
+
+		const float invDirection = 1.f / direction[i];
+		float t0 = (bounds.min[i] - origin[i]) * invDirection;
+		float t1 = (bounds.max[i] - origin[i]) * invDirection;
+		if (t0 > t1)
+			std::swap(t0, t1);
+		tMin = glm::max(tMin, t0);
+		tMax = glm::min(tMax, t1);
+		if (tMin > tMax)
+			return false;
 	}
+	return true;
 }
 
-float ym::Terrain::barryCentricHeight(glm::vec3 v1, glm::vec3 v2, glm::vec3 v3, glm::vec2 xz)
+bool ym::Terrain::intersectTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float& t)
 {
-	float det = (v2.z - v3.z) * (v1.x - v3.x) - (v2.x - v3.x) * (v1.z - v3.z);
-	float l1 = abs(((v2.z - v3.z) * (xz.x - v3.x) - (v2.x - v3.x) * (xz.y - v3.z)) / det);
-	float l2 = abs(((v1.z - v3.z) * (xz.x - v3.x) - (v1.x - v3.x) * (xz.y - v3.z)) / det);
-	float l3 = 1.0f - l1 - l2;
-	return l1 * v1.y + l2 * v2.y + l3 * v3.y;
+	// [Moller and Trumbore 1997], both sides of the triangle are hit. The edges are widened slightly, a ray through the diagonal
+	// of a quad should not pass between its two triangles.
+	const float epsilon = 1e-5f;
+	const glm::vec3 edge1 = v1 - v0;
+	const glm::vec3 edge2 = v2 - v0;
+	const glm::vec3 p = glm::cross(direction, edge2);
+	const float determinant = glm::dot(edge1, p);
+	if (glm::abs(determinant) < 1e-12f)
+		return false;
+
+	const float invDeterminant = 1.f / determinant;
+	const glm::vec3 s = origin - v0;
+	const float u = glm::dot(s, p) * invDeterminant;
+	if (u < -epsilon || u > 1.f + epsilon)
+		return false;
+	const glm::vec3 q = glm::cross(s, edge1);
+	const float v = glm::dot(direction, q) * invDeterminant;
+	if (v < -epsilon || u + v > 1.f + epsilon)
+		return false;
+	t = glm::dot(edge2, q) * invDeterminant;
+	return true;
 }
@@ -1,10 +1,22 @@
 #pragma once
 
-#include "../Vertex.h"
+#include "TerrainTiles.h"
+#include "Engine/Core/Camera.h"
 #include <vector>
 
+#define TERRAIN_MORPH_START 0.7f	// Fraction of the range of a level where its vertices start to morph into the next coarser level.
+#define TERRAIN_SELECT_SPLIT 3		// Levels below the root which are selected on one thread, the subtrees below are selected as separate jobs.
+
 namespace ym
 {
+	/*
+		Continuous distance-dependent level of detail terrain [Strugar 2009]. The heightmap is covered by a quadtree, every node is
+		drawn with the same grid patch of TERRAIN_PATCH_SIZE quads, a node of level L has (1 << L) samples between its vertices. Each
+		level is used up to a distance of TERRAIN_PATCH_SIZE << L samples times Terrain/lodRange, and the vertices morph into the
+		grid of the next coarser level before that distance is reached, so neighbouring nodes of different levels meet without cracks.
+		The heights are read from the tiles of the level, the vertex shader samples them from the resident tiles. Height queries and
+		ray casts on the CPU read the full resolution samples and the height pyramid of the tiles, which also bounds the nodes.
+	*/
 	class Terrain
 	{
 	public:
@@ -16,50 +28,116 @@ namespace ym
 			glm::vec3 origin;
 		};
 
-		struct ProximityDescription
+		// A node which is drawn, either whole or only some of its quarters when the other quarters are drawn by its children.
+		struct Node
+		{
+			uint32_t x{ 0 };		// First sample, in samples of the full heightmap.
+			uint32_t z{ 0 };
+			uint32_t lod{ 0 };
+			uint32_t quarters{ 0 };	// One bit for each quarter, x then z.
+			uint32_t tile{ 0 };		// Tile which the heights are sampled from, a coarser level than the node while its own tile is loading.
+		};
+
+		struct Selection
 		{
-			int32_t regionSize;
-			int32_t proximityRadius;
-			// Can be calculated from the two above.
-			int32_t proximityWidth;
-			int32_t indiciesPerRegion;
-			// Need to know the dataWidth to calculate these.
-			int32_t regionCount;
-			int32_t regionWidthCount;
+			std::vector<Node> nodes;
+			uint32_t fallbackCount{ 0 };	// Nodes drawn with the tile of a coarser level.
+			uint64_t triangleCount{ 0 };
+		};
+
+		// Axis aligned box in the space of the terrain.
+		struct Bounds
+		{
+			glm::vec3 min;
+			glm::vec3 max;
 		};
 
 	public:
-		void init(uint32_t dataWidth, uint32_t dataHeight, uint8_t* data, Description description);
+		Terrain();
+		~Terrain();
+
+		/*
+			Create a terrain from a heightmap in memory, the data is copied.
+		*/
+		void init(uint32_t dataWidth, uint32_t dataHeight, const uint8_t* data, Description description);
+		void init(uint32_t dataWidth, uint32_t dataHeight, const uint16_t* data, Description description);
+
+		/*
+			Create a terrain which streams its tiles from a file baked with TerrainTiles::bake. Returns false if the file could not be used.
+		*/
+		bool init(const std::string& tilePath, Description description);
 		void destroy();
 
+		/*
+			Height of the surface at the xz position, interpolated over the triangle of the full resolution grid.
+		*/
 		float getHeightAt(const glm::vec3& pos) const;
-		glm::ivec2 getRegionFromPos(const glm::vec3& pos, int32_t regionSize) const;
 
-		void fetchVertices(int32_t proximityWidth, const glm::vec3& pos, std::vector<Vertex>& verticesOut) const;
+		/*
+			Heights of many xz positions at once, the same as getHeightAt for each of them. Four positions are interpolated at a time
+			with SSE, only the samples are read one position at a time.
+		*/
+		void getHeightsAt(const glm::vec3* positions, uint32_t count, float* heights) const;
+
+		/*
+			Normal of the surface at the xz position, from the heights one sample away on each side, the same as the vertex shader.
+		*/
+		glm::vec3 getNormalAt(const glm::vec3& pos) const;
+
+		/*
+			Distance along the ray to the first triangle of the full resolution grid it hits, the direction needs to be normalized.
+			The ray walks down the height pyramid and skips every cell it passes above or below, only the quads of the finest cells
+			it enters are tested. Returns false if nothing is hit within maxDistance.
+		*/
+		bool rayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const;
+
+		/*
+			Select the nodes to draw for a camera, the position and planes are in the space of the terrain. The subtrees below the first
+			TERRAIN_SELECT_SPLIT levels are selected in parallel on the job system. Used tiles are marked and missing tiles are
+			requested, a node which tile is not resident is drawn with the closest coarser tile which is. If gpuCulling is true only the
+			first levels are culled against the frustum, the nodes of the subtrees are left for the caller to cull on the GPU.
+		*/
+		void select(const glm::vec3& cameraPosition, const std::vector<Camera::Plane>& planes, Selection& selection, bool gpuCulling = false);
 
+		/*
+			Bounds of the node of the level which first sample is at x, z, the heights are the lowest and highest of its samples.
+		*/
+		Bounds getNodeBounds(uint32_t x, uint32_t z, uint32_t lod) const;
+
+		/*
+			Distance up to which the level is used, the vertices morph into the next level between getMorphStart and this.
+		*/
+		float getLodRange(uint32_t lod) const;
+		float getMorphStart(uint32_t lod) const;
+
+		const Description& getDescription() const;
+		TerrainTiles& getTiles();
 		uint64_t getUniqueID() const;
-		VkDescriptorSet& getDescriptorSet();
-		int32_t getRegionCount() const;
 		glm::vec3 getOrigin() const;
 
-		static Terrain::ProximityDescription createProximityDescription(int32_t dataWidth, int32_t regionSize, int32_t proximityRadius);
-
 	private:
-		void generateVertices(uint32_t dataWidth, uint32_t dataHeight, uint8_t* data);
-		void generateNormals();
+		void initLodRanges();
+		Bounds getCellBounds(uint32_t level, uint32_t cellX, uint32_t cellZ) const;
+		bool rayCastCell(const glm::vec3& origin, const glm::vec3& direction, uint32_t cellX, uint32_t cellZ, float tMin, float tMax, float& distance) const;
+		void getQuadHeights(uint32_t x, uint32_t z, float& h00, float& h10, float& h01, float& h11) const;
+		bool isInRange(const Bounds& bounds, const glm::vec3& cameraPosition, uint32_t lod) const;
+		bool selectNode(uint32_t x, uint32_t z, uint32_t lod, const glm::vec3& cameraPosition, const std::vector<Camera::Plane>& planes, std::vector<Node>& nodes, std::vector<glm::uvec3>* subtrees) const;
 
-		static float barryCentricHeight(glm::vec3 v1, glm::vec3 v2, glm::vec3 v3, glm::vec2 xz);
+		static bool isInFrustum(const Bounds& bounds, const std::vector<Camera::Plane>& planes);
+		static bool intersectBox(const glm::vec3& origin, const glm::vec3& direction, const Bounds& bounds, float& tMin, float& tMax);
+		static bool intersectTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float& t);
 
 	private:
 		uint64_t uniqueId;
 
 		Description desc;
-		std::vector<Vertex> vertices;
-		VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
-		VkDescriptorBufferInfo bufferInfo;
-		ProximityDescription proximityDescription;
+		TerrainTiles tiles;
+		std::array<float, TERRAIN_MAX_LODS> lodRanges;
+		uint32_t splitLod;
+		uint32_t cullLod; // Lowest level which is culled against the frustum by the selection.
 
-		int32_t width;
-		int32_t height;
+		// Subtrees of the last selection, each selected into its own list of nodes.
+		std::vector<glm::uvec3> subtrees;
+		std::vector<std::vector<Node>> subtreeNodes;
 	};
-}
\ No newline at end of file
+}
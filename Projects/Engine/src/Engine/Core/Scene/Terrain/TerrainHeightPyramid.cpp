@@ -0,0 +1,103 @@
+#include "stdafx.h"
+#include "TerrainHeightPyramid.h"
+
+#include <algorithm>
+
+namespace ym
+{
+	TerrainHeightPyramid::TerrainHeightPyramid() : width(0), height(0), levelCount(0)
+	{
+		this->firstCell.fill(0);
+		this->cellCountX.fill(0);
+		this->cellCountZ.fill(0);
+	}
+
+	TerrainHeightPyramid::~TerrainHeightPyramid()
+	{
+	}
+
+	void TerrainHeightPyramid::create(uint32_t width, uint32_t height, uint32_t levelCount)
+	{
+		YM_ASSERT(levelCount > 0 && levelCount <= TERRAIN_PYRAMID_MAX_LEVELS, "Terrain height pyramid has too many levels!");
+		this->width = width;
+		this->height = height;
+		this->levelCount = levelCount;
+
+		uint32_t cellCount = 0;
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			const uint64_t cellSize = (uint64_t)TERRAIN_PYRAMID_CELL_SIZE << level;
+			this->cellCountX[level] = (uint32_t)std::max<uint64_t>(1, (width - 1 + cellSize - 1) / cellSize);
+			this->cellCountZ[level] = (uint32_t)std::max<uint64_t>(1, (height - 1 + cellSize - 1) / cellSize);
+			this->firstCell[level] = cellCount;
+			cellCount += this->cellCountX[level] * this->cellCountZ[level];
+		}
+		YM_ASSERT(this->cellCountX[levelCount - 1] == 1 && this->cellCountZ[levelCount - 1] == 1, "Terrain height pyramid does not cover the heightmap!");
+		this->cells.assign(cellCount, MinMax());
+	}
+
+	void TerrainHeightPyramid::destroy()
+	{
+		this->cells.clear();
+		this->cells.shrink_to_fit();
+		this->width = 0;
+		this->height = 0;
+		this->levelCount = 0;
+	}
+
+	void TerrainHeightPyramid::addRow(uint32_t z, const uint16_t* row)
+	{
+		// A row on the edge between two rows of cells belongs to both of them, the same as the column on the edge of two cells.
+		const uint32_t countX = this->cellCountX[0];
+		const uint32_t countZ = this->cellCountZ[0];
+		const uint32_t firstCellZ = z > 0 ? (z - 1) / TERRAIN_PYRAMID_CELL_SIZE : 0;
+		const uint32_t lastCellZ = std::min(z / TERRAIN_PYRAMID_CELL_SIZE, countZ - 1);
+
+		for (uint32_t cellX = 0; cellX < countX; cellX++)
+		{
+			const uint32_t firstX = cellX * TERRAIN_PYRAMID_CELL_SIZE;
+			const uint32_t lastX = std::min(firstX + TERRAIN_PYRAMID_CELL_SIZE, this->width - 1);
+			auto range = std::minmax_element(row + firstX, row + lastX + 1);
+			for (uint32_t cellZ = firstCellZ; cellZ <= lastCellZ; cellZ++)
+			{
+				MinMax& cell = this->cells[cellZ * countX + cellX];
+				cell.min = std::min(cell.min, *range.first);
+				cell.max = std::max(cell.max, *range.second);
+			}
+		}
+	}
+
+	void TerrainHeightPyramid::build()
+	{
+		YM_PROFILER_FUNCTION();
+
+		for (uint32_t level = 1; level < this->levelCount; level++)
+		{
+			const MinMax* children = this->cells.data() + this->firstCell[level - 1];
+			const uint32_t childCountX = this->cellCountX[level - 1];
+			const uint32_t childCountZ = this->cellCountZ[level - 1];
+			MinMax* cell = this->cells.data() + this->firstCell[level];
+			for (uint32_t z = 0; z < this->cellCountZ[level]; z++)
+			{
+				for (uint32_t x = 0; x < this->cellCountX[level]; x++, cell++)
+				{
+					MinMax minMax;
+					for (uint32_t i = 0; i < 4; i++)
+					{
+						const uint32_t childX = std::min(x * 2 + (i & 1), childCountX - 1);
+						const uint32_t childZ = std::min(z * 2 + (i >> 1), childCountZ - 1);
+						const MinMax& child = children[childZ * childCountX + childX];
+						minMax.min = std::min(minMax.min, child.min);
+						minMax.max = std::max(minMax.max, child.max);
+					}
+					*cell = minMax;
+				}
+			}
+		}
+	}
+
+	void TerrainHeightPyramid::load(const MinMax* data)
+	{
+		this->cells.assign(data, data + this->cells.size());
+	}
+}
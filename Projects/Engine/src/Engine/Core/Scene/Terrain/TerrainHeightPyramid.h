@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <array>
+
+#define TERRAIN_PYRAMID_CELL_SIZE 8		// Quads along each side of a cell of the finest level.
+#define TERRAIN_PYRAMID_NODE_LEVEL 2	// Level which cells are the size of a node of level 0, TERRAIN_PATCH_SIZE is TERRAIN_PYRAMID_CELL_SIZE << this.
+#define TERRAIN_PYRAMID_MAX_LEVELS 18	// TERRAIN_MAX_LODS + TERRAIN_PYRAMID_NODE_LEVEL.
+
+namespace ym
+{
+	/*
+		Lowest and highest height of square cells of the full resolution heightmap, a quadtree with one level for each cell size.
+		Level L has cells of TERRAIN_PYRAMID_CELL_SIZE << L quads, a cell includes the samples on all its edges, and each cell is the
+		union of its four children. Used for the bounds of the quadtree nodes and to skip empty space when casting rays.
+	*/
+	class TerrainHeightPyramid
+	{
+	public:
+		struct MinMax
+		{
+			uint16_t min{ UINT16_MAX };
+			uint16_t max{ 0 };
+		};
+
+	public:
+		TerrainHeightPyramid();
+		~TerrainHeightPyramid();
+
+		/*
+			Create the cells for a heightmap, one cell of the coarsest level needs to cover it. The cells are empty until the rows of
+			the heightmap are added and build is called, or until they are read with load.
+		*/
+		void create(uint32_t width, uint32_t height, uint32_t levelCount);
+		void destroy();
+
+		/*
+			Add a row of the heightmap, width samples, to the cells of the finest level it touches. Adding a row twice has no effect.
+		*/
+		void addRow(uint32_t z, const uint16_t* row);
+
+		/*
+			Compute the coarser levels from the finest level, after all rows have been added.
+		*/
+		void build();
+
+		/*
+			Copy the cells of all levels from data, which was written from getCells of a pyramid with the same layout.
+		*/
+		void load(const MinMax* data);
+
+		uint32_t getLevelCount() const { return this->levelCount; }
+		uint32_t getCellCountX(uint32_t level) const { return this->cellCountX[level]; }
+		uint32_t getCellCountZ(uint32_t level) const { return this->cellCountZ[level]; }
+
+		/*
+			Cell of the level which holds the sample at x, z. The position is in samples of the full heightmap.
+		*/
+		const MinMax& getCell(uint32_t level, uint32_t x, uint32_t z) const
+		{
+			const uint32_t cellX = std::min(x / (TERRAIN_PYRAMID_CELL_SIZE << level), this->cellCountX[level] - 1);
+			const uint32_t cellZ = std::min(z / (TERRAIN_PYRAMID_CELL_SIZE << level), this->cellCountZ[level] - 1);
+			return this->cells[this->firstCell[level] + cellZ * this->cellCountX[level] + cellX];
+		}
+
+		/*
+			Cells of all levels, finest level first and each level in rows.
+		*/
+		const std::vector<MinMax>& getCells() const { return this->cells; }
+		size_t getMemorySize() const { return this->cells.size() * sizeof(MinMax); }
+
+	private:
+		uint32_t width;
+		uint32_t height;
+		uint32_t levelCount;
+		std::array<uint32_t, TERRAIN_PYRAMID_MAX_LEVELS> firstCell;
+		std::array<uint32_t, TERRAIN_PYRAMID_MAX_LEVELS> cellCountX;
+		std::array<uint32_t, TERRAIN_PYRAMID_MAX_LEVELS> cellCountZ;
+		std::vector<MinMax> cells;
+	};
+}
@@ -0,0 +1,471 @@
+#include "stdafx.h"
+#include "TerrainTiles.h"
+
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+
+static_assert(TERRAIN_PATCH_SIZE == TERRAIN_PYRAMID_CELL_SIZE << TERRAIN_PYRAMID_NODE_LEVEL, "A node of level 0 needs to be one cell of the height pyramid!");
+static_assert(TERRAIN_PYRAMID_MAX_LEVELS == TERRAIN_MAX_LODS + TERRAIN_PYRAMID_NODE_LEVEL, "The height pyramid needs a level for each level of the tiles!");
+
+namespace ym
+{
+	TerrainTiles::TerrainTiles() : width(0), height(0), lodCount(0), fileSamples(nullptr), frame(0), loadsInFlight(0), loadCount(0), evictionCount(0)
+	{
+		this->firstTile.fill(0);
+		this->tileCountX.fill(0);
+		this->tileCountZ.fill(0);
+	}
+
+	TerrainTiles::~TerrainTiles()
+	{
+	}
+
+	void TerrainTiles::init(uint32_t width, uint32_t height, const uint8_t* data, uint32_t slotCount)
+	{
+		std::vector<uint16_t> samples((size_t)width * (size_t)height);
+		for (size_t i = 0; i < samples.size(); i++)
+			samples[i] = (uint16_t)(data[i] * 257);
+		init(width, height, samples.data(), slotCount);
+	}
+
+	void TerrainTiles::init(uint32_t width, uint32_t height, const uint16_t* data, uint32_t slotCount)
+	{
+		destroy();
+		createLayout(width, height);
+		this->data.assign(data, data + (size_t)width * (size_t)height);
+		computeMinMax();
+		for (uint32_t z = 0; z < height; z++)
+			this->pyramid.addRow(z, this->data.data() + (size_t)z * width);
+		this->pyramid.build();
+		createSlots(slotCount);
+	}
+
+	bool TerrainTiles::init(const std::string& filePath, uint32_t slotCount)
+	{
+		destroy();
+		if (this->file.open(filePath) == false)
+			return false;
+
+		const uint8_t* fileData = this->file.getData();
+		const Header* header = reinterpret_cast<const Header*>(fileData);
+		if (this->file.getSize() < sizeof(Header) || memcmp(header->magic, "YMT", 4) != 0 || header->version != TERRAIN_TILE_VERSION || header->tileSize != TERRAIN_TILE_SIZE)
+		{
+			YM_LOG_WARN("Terrain tile file is not valid or was baked with another version. [{}]", filePath.c_str());
+			this->file.close();
+			return false;
+		}
+
+		createLayout(header->width, header->height);
+		const uint64_t tileCount = this->tiles.size();
+		const uint64_t pyramidSize = this->pyramid.getMemorySize();
+		if (header->lodCount != this->lodCount || header->tileCount != tileCount || this->file.getSize() < header->minMaxOffset + tileCount * 2 * sizeof(uint16_t)
+			|| this->file.getSize() < header->pyramidOffset + pyramidSize)
+		{
+			YM_LOG_WARN("Terrain tile file does not match its layout. [{}]", filePath.c_str());
+			this->file.close();
+			this->tiles.clear();
+			this->pyramid.destroy();
+			return false;
+		}
+
+		this->fileSamples = reinterpret_cast<const uint16_t*>(fileData + header->tileOffset);
+		const uint16_t* minMax = reinterpret_cast<const uint16_t*>(fileData + header->minMaxOffset);
+		for (size_t i = 0; i < this->tiles.size(); i++)
+		{
+			this->tiles[i].minHeight = minMax[i * 2];
+			this->tiles[i].maxHeight = minMax[i * 2 + 1];
+		}
+		this->pyramid.load(reinterpret_cast<const TerrainHeightPyramid::MinMax*>(fileData + header->pyramidOffset));
+		createSlots(slotCount);
+		return true;
+	}
+
+	void TerrainTiles::destroy()
+	{
+		waitForLoads();
+		this->loadedTiles.clear();
+		this->tiles.clear();
+		this->slots.clear();
+		this->freeSlots.clear();
+		this->requests.clear();
+		this->data.clear();
+		this->data.shrink_to_fit();
+		this->file.close();
+		this->fileSamples = nullptr;
+		this->pyramid.destroy();
+		this->width = 0;
+		this->height = 0;
+		this->lodCount = 0;
+		this->loadsInFlight = 0;
+	}
+
+	bool TerrainTiles::bake(const std::string& filePath, uint32_t width, uint32_t height, const RowReader& readRow)
+	{
+		TerrainTiles layout;
+		layout.createLayout(width, height);
+		const uint64_t tileCount = layout.tiles.size();
+
+		Header header = {};
+		memcpy(header.magic, "YMT", 4);
+		header.version = TERRAIN_TILE_VERSION;
+		header.width = width;
+		header.height = height;
+		header.tileSize = TERRAIN_TILE_SIZE;
+		header.lodCount = layout.lodCount;
+		header.tileCount = (uint32_t)tileCount;
+		header.tileOffset = sizeof(Header);
+		header.minMaxOffset = header.tileOffset + tileCount * TERRAIN_TILE_SAMPLE_COUNT * sizeof(uint16_t);
+		header.pyramidOffset = header.minMaxOffset + tileCount * 2 * sizeof(uint16_t);
+
+		// Write to a temporary file first, a terrain which is loaded at the same time should never see a half written file.
+		std::string tempPath = filePath + ".tmp";
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (file.is_open() == false)
+		{
+			YM_LOG_WARN("Could not write terrain tile file. [{}]", filePath.c_str());
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+		// One row of tiles is built at a time. Coarse levels read the same clamped row several times at the bottom edge, it is
+		// only read once. Level 0 reads every row, the finest cells of the pyramid are built from them.
+		std::vector<uint16_t> row(width);
+		std::vector<uint16_t> tileRow;
+		std::vector<uint16_t> minMax(tileCount * 2);
+		uint32_t tile = 0;
+		for (uint32_t lod = 0; lod < layout.lodCount; lod++)
+		{
+			const uint32_t countX = layout.tileCountX[lod];
+			tileRow.resize((size_t)countX * TERRAIN_TILE_SAMPLE_COUNT);
+			for (uint32_t tileZ = 0; tileZ < layout.tileCountZ[lod]; tileZ++)
+			{
+				uint32_t readZ = UINT32_MAX;
+				for (uint32_t z = 0; z < TERRAIN_TILE_SAMPLES; z++)
+				{
+					const uint32_t sourceZ = (uint32_t)std::min<uint64_t>(((uint64_t)tileZ * TERRAIN_TILE_SIZE + z) << lod, height - 1);
+					if (sourceZ != readZ)
+					{
+						readRow(sourceZ, row.data());
+						readZ = sourceZ;
+						if (lod == 0)
+							layout.pyramid.addRow(sourceZ, row.data());
+					}
+					copyTileRow(row.data(), width, lod, countX, z, tileRow);
+				}
+
+				for (uint32_t tileX = 0; tileX < countX; tileX++, tile++)
+				{
+					const uint16_t* samples = tileRow.data() + (size_t)tileX * TERRAIN_TILE_SAMPLE_COUNT;
+					auto range = std::minmax_element(samples, samples + TERRAIN_TILE_SAMPLE_COUNT);
+					minMax[(size_t)tile * 2] = *range.first;
+					minMax[(size_t)tile * 2 + 1] = *range.second;
+					file.write(reinterpret_cast<const char*>(samples), TERRAIN_TILE_SAMPLE_COUNT * sizeof(uint16_t));
+				}
+			}
+		}
+		file.write(reinterpret_cast<const char*>(minMax.data()), (std::streamsize)(minMax.size() * sizeof(uint16_t)));
+		layout.pyramid.build();
+		file.write(reinterpret_cast<const char*>(layout.pyramid.getCells().data()), (std::streamsize)layout.pyramid.getMemorySize());
+
+		file.close();
+		std::error_code error;
+		if (file.fail())
+		{
+			YM_LOG_WARN("Could not write terrain tile file. [{}]", filePath.c_str());
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		std::filesystem::rename(tempPath, filePath, error);
+		if (error)
+		{
+			YM_LOG_WARN("Could not write terrain tile file. [{}]", filePath.c_str());
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		YM_LOG_INFO("Baked terrain tile file with {} tiles in {} levels. [{}]", tileCount, layout.lodCount, filePath.c_str());
+		return true;
+	}
+
+	bool TerrainTiles::bake(const std::string& filePath, uint32_t width, uint32_t height, const uint8_t* data)
+	{
+		return bake(filePath, width, height, [data, width](uint32_t z, uint16_t* row) {
+			const uint8_t* source = data + (size_t)z * width;
+			for (uint32_t x = 0; x < width; x++)
+				row[x] = (uint16_t)(source[x] * 257);
+		});
+	}
+
+	uint32_t TerrainTiles::getTileIndex(uint32_t lod, uint32_t x, uint32_t z) const
+	{
+		const uint32_t tileX = std::min(x / (TERRAIN_TILE_SIZE << lod), this->tileCountX[lod] - 1);
+		const uint32_t tileZ = std::min(z / (TERRAIN_TILE_SIZE << lod), this->tileCountZ[lod] - 1);
+		return this->firstTile[lod] + tileZ * this->tileCountX[lod] + tileX;
+	}
+
+	glm::uvec2 TerrainTiles::getTileOrigin(uint32_t tile) const
+	{
+		const Tile& t = this->tiles[tile];
+		return glm::uvec2((uint32_t)t.x * TERRAIN_TILE_SIZE, (uint32_t)t.z * TERRAIN_TILE_SIZE) << (uint32_t)t.lod;
+	}
+
+	float TerrainTiles::getSample(uint32_t x, uint32_t z) const
+	{
+		x = std::min(x, this->width - 1);
+		z = std::min(z, this->height - 1);
+		return getSamples()[getSampleOffset(x, z)] / 65535.f;
+	}
+
+	void TerrainTiles::touch(uint32_t tile)
+	{
+		Tile& t = this->tiles[tile];
+		if (t.state == State::RESIDENT)
+			this->slots[t.slot].lastUsedFrame = this->frame;
+		else if (t.state == State::NONE)
+		{
+			t.state = State::REQUESTED;
+			this->requests.push_back(tile);
+		}
+	}
+
+	void TerrainTiles::update()
+	{
+		YM_PROFILER_FUNCTION();
+		this->frame++;
+		if (this->requests.empty())
+			return;
+
+		// Coarser levels cover more of the terrain and are the fallback of the finer levels, they are loaded first.
+		std::stable_sort(this->requests.begin(), this->requests.end(), [this](uint32_t a, uint32_t b) { return this->tiles[a].lod > this->tiles[b].lod; });
+		for (uint32_t tile : this->requests)
+		{
+			Tile& t = this->tiles[tile];
+			const uint32_t slot = this->loadsInFlight < TERRAIN_MAX_LOADS_IN_FLIGHT ? allocateSlot() : TERRAIN_TILE_NOT_RESIDENT;
+			if (slot == TERRAIN_TILE_NOT_RESIDENT)
+			{
+				// Tiles which are still needed are requested again next frame.
+				t.state = State::NONE;
+				continue;
+			}
+
+			t.state = State::LOADING;
+			t.slot = slot;
+			this->slots[slot].tile = tile;
+			this->slots[slot].lastUsedFrame = this->frame;
+			this->loadsInFlight++;
+			this->loadCount++;
+			JobSystem::execute([this, tile, slot]() {
+				LoadedTile loadedTile;
+				loadedTile.tile = tile;
+				loadedTile.slot = slot;
+				loadTile(tile, loadedTile.samples);
+
+				std::lock_guard<std::mutex> lock(this->mutex);
+				this->loadedTiles.push_back(std::move(loadedTile));
+			}, &this->loadCounter);
+		}
+		this->requests.clear();
+	}
+
+	void TerrainTiles::takeLoadedTiles(uint32_t maxCount, std::vector<LoadedTile>& loadedTiles)
+	{
+		loadedTiles.clear();
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			const size_t count = std::min((size_t)maxCount, this->loadedTiles.size());
+			for (size_t i = 0; i < count; i++)
+				loadedTiles.push_back(std::move(this->loadedTiles[i]));
+			this->loadedTiles.erase(this->loadedTiles.begin(), this->loadedTiles.begin() + count);
+		}
+
+		for (LoadedTile& loadedTile : loadedTiles)
+		{
+			this->tiles[loadedTile.tile].state = State::RESIDENT;
+			this->slots[loadedTile.slot].lastUsedFrame = this->frame;
+			this->loadsInFlight--;
+		}
+	}
+
+	void TerrainTiles::waitForLoads()
+	{
+		JobSystem::wait(&this->loadCounter);
+	}
+
+	TerrainTiles::Stats TerrainTiles::getStats() const
+	{
+		Stats stats;
+		for (const Slot& slot : this->slots)
+			if (slot.tile != TERRAIN_TILE_NOT_RESIDENT && this->tiles[slot.tile].state == State::RESIDENT)
+				stats.residentCount++;
+		stats.pendingCount = (uint32_t)this->requests.size() + this->loadsInFlight;
+		stats.loadCount = this->loadCount;
+		stats.evictionCount = this->evictionCount;
+		return stats;
+	}
+
+	void TerrainTiles::createLayout(uint32_t width, uint32_t height)
+	{
+		YM_ASSERT(width > 0 && height > 0, "Terrain needs at least one sample!");
+		this->width = width;
+		this->height = height;
+
+		// Levels are added until one node covers the whole heightmap.
+		const uint32_t quads = std::max(std::max(width, height), 2u) - 1;
+		this->lodCount = 1;
+		while (this->lodCount < TERRAIN_MAX_LODS && ((uint64_t)TERRAIN_PATCH_SIZE << (this->lodCount - 1)) < quads)
+			this->lodCount++;
+
+		this->tiles.clear();
+		for (uint32_t lod = 0; lod < this->lodCount; lod++)
+		{
+			const uint64_t tileSize = (uint64_t)TERRAIN_TILE_SIZE << lod;
+			this->tileCountX[lod] = (uint32_t)std::max<uint64_t>(1, (width - 1 + tileSize - 1) / tileSize);
+			this->tileCountZ[lod] = (uint32_t)std::max<uint64_t>(1, (height - 1 + tileSize - 1) / tileSize);
+			this->firstTile[lod] = (uint32_t)this->tiles.size();
+			for (uint32_t z = 0; z < this->tileCountZ[lod]; z++)
+			{
+				for (uint32_t x = 0; x < this->tileCountX[lod]; x++)
+				{
+					Tile tile;
+					tile.x = (uint16_t)x;
+					tile.z = (uint16_t)z;
+					tile.lod = (uint8_t)lod;
+					this->tiles.push_back(tile);
+				}
+			}
+		}
+		this->pyramid.create(width, height, this->lodCount + TERRAIN_PYRAMID_NODE_LEVEL);
+	}
+
+	void TerrainTiles::createSlots(uint32_t slotCount)
+	{
+		YM_ASSERT(slotCount > 0, "Terrain needs at least one tile slot!");
+		this->slots.assign(slotCount, Slot());
+		this->freeSlots.clear();
+		for (uint32_t slot = slotCount; slot > 0; slot--)
+			this->freeSlots.push_back(slot - 1);
+		this->frame = 0;
+		this->loadCount = 0;
+		this->evictionCount = 0;
+
+		// The coarsest level is loaded right away, every node can be drawn with it.
+		touch(this->firstTile[this->lodCount - 1]);
+		update();
+	}
+
+	void TerrainTiles::computeMinMax()
+	{
+		YM_PROFILER_FUNCTION();
+
+		// The finest level reads its samples, the samples of a coarser tile are a subset of the samples of its four children.
+		for (uint32_t lod = 0; lod < this->lodCount; lod++)
+		{
+			for (uint32_t tile = this->firstTile[lod]; tile < this->firstTile[lod] + this->tileCountX[lod] * this->tileCountZ[lod]; tile++)
+			{
+				Tile& t = this->tiles[tile];
+				uint16_t minHeight = UINT16_MAX;
+				uint16_t maxHeight = 0;
+				if (lod == 0)
+				{
+					const glm::uvec2 origin = getTileOrigin(tile);
+					const uint32_t lastX = std::min(origin.x + TERRAIN_TILE_SIZE, this->width - 1);
+					const uint32_t lastZ = std::min(origin.y + TERRAIN_TILE_SIZE, this->height - 1);
+					for (uint32_t z = origin.y; z <= lastZ; z++)
+					{
+						const uint16_t* row = this->data.data() + (size_t)z * this->width;
+						auto range = std::minmax_element(row + origin.x, row + lastX + 1);
+						minHeight = std::min(minHeight, *range.first);
+						maxHeight = std::max(maxHeight, *range.second);
+					}
+				}
+				else
+				{
+					for (uint32_t i = 0; i < 4; i++)
+					{
+						const uint32_t childX = std::min(t.x * 2u + (i & 1), this->tileCountX[lod - 1] - 1);
+						const uint32_t childZ = std::min(t.z * 2u + (i >> 1), this->tileCountZ[lod - 1] - 1);
+						const Tile& child = this->tiles[this->firstTile[lod - 1] + childZ * this->tileCountX[lod - 1] + childX];
+						minHeight = std::min(minHeight, child.minHeight);
+						maxHeight = std::max(maxHeight, child.maxHeight);
+					}
+				}
+				t.minHeight = minHeight;
+				t.maxHeight = maxHeight;
+			}
+		}
+	}
+
+	void TerrainTiles::loadTile(uint32_t tile, std::vector<uint16_t>& samples) const
+	{
+		samples.resize(TERRAIN_TILE_SAMPLE_COUNT);
+		if (this->fileSamples != nullptr)
+		{
+			// Only the pages of this tile are read from the mapped file.
+			memcpy(samples.data(), this->fileSamples + (size_t)tile * TERRAIN_TILE_SAMPLE_COUNT, TERRAIN_TILE_SAMPLE_COUNT * sizeof(uint16_t));
+			return;
+		}
+
+		const Tile& t = this->tiles[tile];
+		const glm::uvec2 origin = getTileOrigin(tile);
+		for (uint32_t z = 0; z < TERRAIN_TILE_SAMPLES; z++)
+		{
+			const uint32_t sourceZ = (uint32_t)std::min<uint64_t>(origin.y + ((uint64_t)z << t.lod), this->height - 1);
+			const uint16_t* source = this->data.data() + (size_t)sourceZ * this->width;
+			uint16_t* destination = samples.data() + (size_t)z * TERRAIN_TILE_SAMPLES;
+			for (uint32_t x = 0; x < TERRAIN_TILE_SAMPLES; x++)
+			{
+				const uint32_t sourceX = (uint32_t)std::min<uint64_t>(origin.x + ((uint64_t)x << t.lod), this->width - 1);
+				destination[x] = source[sourceX];
+			}
+		}
+	}
+
+	uint32_t TerrainTiles::allocateSlot()
+	{
+		if (this->freeSlots.empty() == false)
+		{
+			uint32_t slot = this->freeSlots.back();
+			this->freeSlots.pop_back();
+			return slot;
+		}
+
+		// Take the slot of the least recently used tile. Tiles used by the last frames are kept, so the tiles of the view do not
+		// evict each other when the budget is too small.
+		uint32_t best = TERRAIN_TILE_NOT_RESIDENT;
+		uint64_t bestFrame = UINT64_MAX;
+		for (uint32_t slot = 0; slot < (uint32_t)this->slots.size(); slot++)
+		{
+			const Slot& s = this->slots[slot];
+			if (s.tile == TERRAIN_TILE_NOT_RESIDENT)
+				continue;
+			const Tile& t = this->tiles[s.tile];
+			if (t.state != State::RESIDENT || t.lod == this->lodCount - 1 || s.lastUsedFrame + TERRAIN_TILE_EVICT_FRAMES > this->frame)
+				continue;
+			if (s.lastUsedFrame < bestFrame)
+			{
+				best = slot;
+				bestFrame = s.lastUsedFrame;
+			}
+		}
+
+		if (best != TERRAIN_TILE_NOT_RESIDENT)
+		{
+			Tile& evicted = this->tiles[this->slots[best].tile];
+			evicted.state = State::NONE;
+			evicted.slot = TERRAIN_TILE_NOT_RESIDENT;
+			this->slots[best].tile = TERRAIN_TILE_NOT_RESIDENT;
+			this->evictionCount++;
+		}
+		return best;
+	}
+
+	void TerrainTiles::copyTileRow(const uint16_t* row, uint32_t width, uint32_t lod, uint32_t tileCountX, uint32_t rowInTile, std::vector<uint16_t>& tileRow)
+	{
+		for (uint32_t tileX = 0; tileX < tileCountX; tileX++)
+		{
+			uint16_t* destination = tileRow.data() + (size_t)tileX * TERRAIN_TILE_SAMPLE_COUNT + (size_t)rowInTile * TERRAIN_TILE_SAMPLES;
+			for (uint32_t x = 0; x < TERRAIN_TILE_SAMPLES; x++)
+				destination[x] = row[std::min<uint64_t>(((uint64_t)tileX * TERRAIN_TILE_SIZE + x) << lod, width - 1)];
+		}
+	}
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "Engine/Core/Threading/JobSystem.h"
+#include "Utils/MappedFile.h"
+#include "TerrainHeightPyramid.h"
+#include <functional>
+#include <array>
+
+#define TERRAIN_PATCH_SIZE 32					// Quads along each side of the grid patch, a node of level L covers TERRAIN_PATCH_SIZE << L quads.
+#define TERRAIN_TILE_SIZE 256					// Quads along each side of a tile, a multiple of TERRAIN_PATCH_SIZE.
+#define TERRAIN_TILE_SAMPLES (TERRAIN_TILE_SIZE + 1)	// Samples along each side of a tile, the last row and column are shared with the next tile.
+#define TERRAIN_TILE_SAMPLE_COUNT (TERRAIN_TILE_SAMPLES * TERRAIN_TILE_SAMPLES)
+#define TERRAIN_MAX_LODS 16						// Levels of the quadtree and of the tile pyramid.
+#define TERRAIN_TILE_NOT_RESIDENT UINT32_MAX	// Slot of a tile which is not resident.
+#define TERRAIN_TILE_EVICT_FRAMES 4				// A tile needs to be unused for this many frames before its slot is given to another tile.
+#define TERRAIN_MAX_LOADS_IN_FLIGHT 16			// Tiles which are loaded on the job system at the same time.
+#define TERRAIN_TILE_VERSION 2
+#define TERRAIN_TILE_EXTENSION ".ymt"
+
+namespace ym
+{
+	/*
+		Heights of a terrain split into a pyramid of square tiles, one level for each level of the quadtree. Level L is the heightmap
+		with every (1 << L)th sample in each direction, coarser levels hold a subset of the samples of the finer levels, so a node and
+		its parent agree on the heights they share. Heights are stored as 16 bit unorm.
+
+		The samples come either from a heightmap in memory or from a baked tile file which is mapped and read one tile at a time, so
+		the heightmap does not need to fit in memory. Only a fixed number of tiles are resident, each in its own slot, tiles are
+		requested when they are used, loaded on the job system and handed to the renderer which copies them into their slots. The
+		least recently used tile gives up its slot when the budget is full. The tile of the coarsest level is never evicted, it is
+		the fallback of every other tile.
+	*/
+	class TerrainTiles
+	{
+	public:
+		// A tile which has finished loading and needs to be copied into its slot before it is used.
+		struct LoadedTile
+		{
+			uint32_t tile{ 0 };
+			uint32_t slot{ 0 };
+			std::vector<uint16_t> samples; // TERRAIN_TILE_SAMPLES rows of TERRAIN_TILE_SAMPLES samples.
+		};
+
+		struct Stats
+		{
+			uint32_t residentCount{ 0 };
+			uint32_t pendingCount{ 0 };	// Tiles which are requested or loading.
+			uint64_t loadCount{ 0 };	// Tiles loaded since init.
+			uint64_t evictionCount{ 0 };
+		};
+
+		// Reads one row of the source heightmap, width samples.
+		using RowReader = std::function<void(uint32_t z, uint16_t* row)>;
+
+	public:
+		TerrainTiles();
+		~TerrainTiles();
+
+		/*
+			Use a heightmap in memory as the source, the data is copied as 16 bit unorm. Tiles are generated from it when they are
+			loaded.
+		*/
+		void init(uint32_t width, uint32_t height, const uint8_t* data, uint32_t slotCount);
+		void init(uint32_t width, uint32_t height, const uint16_t* data, uint32_t slotCount);
+
+		/*
+			Use a baked tile file as the source. Returns false if the file does not exist or was baked with another version.
+		*/
+		bool init(const std::string& filePath, uint32_t slotCount);
+		void destroy();
+
+		/*
+			Write the tile pyramid of a heightmap to a file, one row of tiles at a time. The heightmap is read one row at a time and
+			never needs to be in memory as a whole.
+		*/
+		static bool bake(const std::string& filePath, uint32_t width, uint32_t height, const RowReader& readRow);
+		static bool bake(const std::string& filePath, uint32_t width, uint32_t height, const uint8_t* data);
+
+		uint32_t getWidth() const { return this->width; }
+		uint32_t getHeight() const { return this->height; }
+		uint32_t getLodCount() const { return this->lodCount; }
+		uint32_t getSlotCount() const { return (uint32_t)this->slots.size(); }
+		uint32_t getTileCount() const { return (uint32_t)this->tiles.size(); }
+
+		/*
+			Index of the tile of the level which holds the sample at x, z. The position is in samples of the full heightmap.
+		*/
+		uint32_t getTileIndex(uint32_t lod, uint32_t x, uint32_t z) const;
+		uint32_t getTileLod(uint32_t tile) const { return this->tiles[tile].lod; }
+
+		/*
+			First sample of the tile, in samples of the full heightmap.
+		*/
+		glm::uvec2 getTileOrigin(uint32_t tile) const;
+
+		/*
+			Lowest and highest height of the samples of the tile, between 0 and 1.
+		*/
+		float getMinHeight(uint32_t tile) const { return this->tiles[tile].minHeight / 65535.f; }
+		float getMaxHeight(uint32_t tile) const { return this->tiles[tile].maxHeight / 65535.f; }
+
+		/*
+			Height of a sample of the full heightmap, between 0 and 1. This reads the source directly and does not need the tile to
+			be resident.
+		*/
+		float getSample(uint32_t x, uint32_t z) const;
+
+		/*
+			Samples of the full heightmap as 16 bit unorm, the rows of the heightmap in memory or the tiles of level 0 in the file.
+			The sample at x, z is at getSampleOffset, the samples after it in x and z are at +1 and +getSampleStride as long as it is
+			not on the last row or column of the heightmap.
+		*/
+		const uint16_t* getSamples() const { return this->fileSamples != nullptr ? this->fileSamples : this->data.data(); }
+		uint32_t getSampleStride() const { return this->fileSamples != nullptr ? TERRAIN_TILE_SAMPLES : this->width; }
+		size_t getSampleOffset(uint32_t x, uint32_t z) const
+		{
+			if (this->fileSamples == nullptr)
+				return (size_t)z * this->width + x;
+
+			const uint32_t tileX = std::min(x / TERRAIN_TILE_SIZE, this->tileCountX[0] - 1);
+			const uint32_t tileZ = std::min(z / TERRAIN_TILE_SIZE, this->tileCountZ[0] - 1);
+			const size_t tile = (size_t)tileZ * this->tileCountX[0] + tileX;
+			return tile * TERRAIN_TILE_SAMPLE_COUNT + (size_t)(z - tileZ * TERRAIN_TILE_SIZE) * TERRAIN_TILE_SAMPLES + (x - tileX * TERRAIN_TILE_SIZE);
+		}
+
+		/*
+			Lowest and highest height of the cells of the full resolution heightmap, TERRAIN_PYRAMID_NODE_LEVEL levels more than the
+			tiles.
+		*/
+		const TerrainHeightPyramid& getPyramid() const { return this->pyramid; }
+
+		/*
+			Slot of the tile or TERRAIN_TILE_NOT_RESIDENT. Only reads the state of the tile and can be called from several threads,
+			as long as no other function is called at the same time.
+		*/
+		uint32_t getSlot(uint32_t tile) const { return this->tiles[tile].state == State::RESIDENT ? this->tiles[tile].slot : TERRAIN_TILE_NOT_RESIDENT; }
+		bool isResident(uint32_t tile) const { return this->tiles[tile].state == State::RESIDENT; }
+
+		/*
+			Mark a resident tile as used this frame, or request it if it is not resident.
+		*/
+		void touch(uint32_t tile);
+
+		/*
+			Start loading the requested tiles, coarser levels first, and begin the next frame. Needs to be called once per frame.
+		*/
+		void update();
+
+		/*
+			Take up to maxCount tiles which have finished loading. They are resident from now on, the caller needs to copy their
+			samples into their slots before anything drawn with them.
+		*/
+		void takeLoadedTiles(uint32_t maxCount, std::vector<LoadedTile>& loadedTiles);
+
+		/*
+			Wait for all tiles which are loading on the job system.
+		*/
+		void waitForLoads();
+
+		Stats getStats() const;
+
+	private:
+		enum class State : uint8_t { NONE, REQUESTED, LOADING, RESIDENT };
+
+		struct Tile
+		{
+			uint16_t minHeight{ 0 };
+			uint16_t maxHeight{ 0 };
+			uint16_t x{ 0 };	// Position in tiles in its level.
+			uint16_t z{ 0 };
+			uint8_t lod{ 0 };
+			State state{ State::NONE };
+			uint32_t slot{ TERRAIN_TILE_NOT_RESIDENT };
+		};
+
+		struct Slot
+		{
+			uint32_t tile{ TERRAIN_TILE_NOT_RESIDENT };
+			uint64_t lastUsedFrame{ 0 };
+		};
+
+		struct Header
+		{
+			char magic[4];
+			uint32_t version;
+			uint32_t width;
+			uint32_t height;
+			uint32_t tileSize;
+			uint32_t lodCount;
+			uint32_t tileCount;
+			uint32_t pad;
+			uint64_t tileOffset;	// Samples of all tiles, in the order of their index.
+			uint64_t minMaxOffset;	// Lowest and highest height of each tile.
+			uint64_t pyramidOffset;	// Cells of the height pyramid.
+		};
+
+		void createLayout(uint32_t width, uint32_t height);
+		void createSlots(uint32_t slotCount);
+		void computeMinMax();
+		void loadTile(uint32_t tile, std::vector<uint16_t>& samples) const;
+		uint32_t allocateSlot();
+
+		static void copyTileRow(const uint16_t* row, uint32_t width, uint32_t lod, uint32_t tileCountX, uint32_t rowInTile, std::vector<uint16_t>& tileRow);
+
+	private:
+		uint32_t width;
+		uint32_t height;
+		uint32_t lodCount;
+		std::array<uint32_t, TERRAIN_MAX_LODS> firstTile;
+		std::array<uint32_t, TERRAIN_MAX_LODS> tileCountX;
+		std::array<uint32_t, TERRAIN_MAX_LODS> tileCountZ;
+		std::vector<Tile> tiles;
+
+		// Source, either the heightmap or the mapped tile file.
+		std::vector<uint16_t> data;
+		MappedFile file;
+		const uint16_t* fileSamples;
+		TerrainHeightPyramid pyramid;
+
+		// Residency
+		std::vector<Slot> slots;
+		std::vector<uint32_t> freeSlots;
+		std::vector<uint32_t> requests;
+		uint64_t frame;
+		uint32_t loadsInFlight;
+		uint64_t loadCount;
+		uint64_t evictionCount;
+
+		// Tiles which have been loaded by a job and are waiting to be taken, protected by the mutex.
+		std::mutex mutex;
+		std::vector<LoadedTile> loadedTiles;
+		JobCounter loadCounter;
+	};
+}
@@ -4,6 +4,9 @@
 
 namespace ym
 {
+	// Layout of the vertices of a model on the GPU.
+	enum class VertexFormat { FULL, PACKED };
+
 	struct Vertex
 	{
 		alignas(16) glm::vec3 pos;
@@ -38,4 +41,130 @@ namespace ym
 			return attributeDescriptions;
 		}
 	};
-}
\ No newline at end of file
+
+	// Range of the positions and texture coordinates of a model, the packed vertices are stored relative to it.
+	struct VertexQuantization
+	{
+		glm::vec3 positionMin{ 0.f };
+		glm::vec3 positionExtent{ 1.f };
+		glm::vec2 uvMin{ 0.f };
+		glm::vec2 uvExtent{ 1.f };
+
+		static VertexQuantization compute(const std::vector<Vertex>& vertices)
+		{
+			VertexQuantization quantization;
+			if (vertices.empty())
+				return quantization;
+
+			glm::vec3 positionMax = vertices[0].pos;
+			glm::vec2 uvMax = vertices[0].uv0;
+			quantization.positionMin = vertices[0].pos;
+			quantization.uvMin = vertices[0].uv0;
+			for (const Vertex& vertex : vertices)
+			{
+				quantization.positionMin = glm::min(quantization.positionMin, vertex.pos);
+				positionMax = glm::max(positionMax, vertex.pos);
+				quantization.uvMin = glm::min(quantization.uvMin, vertex.uv0);
+				uvMax = glm::max(uvMax, vertex.uv0);
+			}
+
+			// A flat axis gets a small extent to not divide by zero.
+			quantization.positionExtent = glm::max(positionMax - quantization.positionMin, glm::vec3(1e-6f));
+			quantization.uvExtent = glm::max(uvMax - quantization.uvMin, glm::vec2(1e-6f));
+			return quantization;
+		}
+	};
+
+	/*
+		16 bytes instead of 48. The position and texture coordinates are unorm16 relative to the VertexQuantization of the model,
+		the normal is an octahedral snorm16 vector. The node data of the model holds the quantization for the vertex shader.
+	*/
+	struct PackedVertex
+	{
+		uint16_t pos[4];
+		int16_t nor[2];
+		uint16_t uv0[2];
+
+		static VkVertexInputBindingDescription getBindingDescriptions() {
+			VkVertexInputBindingDescription bindingDescription = {};
+			bindingDescription.binding = 0;
+			bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+			bindingDescription.stride = sizeof(PackedVertex);
+			return bindingDescription;
+		}
+
+		static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
+			std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
+			// Position
+			attributeDescriptions[0].binding = 0;
+			attributeDescriptions[0].location = 0;
+			attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+			attributeDescriptions[0].offset = offsetof(PackedVertex, pos);
+			// Normal
+			attributeDescriptions[1].binding = 0;
+			attributeDescriptions[1].location = 1;
+			attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+			attributeDescriptions[1].offset = offsetof(PackedVertex, nor);
+			// Uv0
+			attributeDescriptions[2].binding = 0;
+			attributeDescriptions[2].location = 2;
+			attributeDescriptions[2].format = VK_FORMAT_R16G16_UNORM;
+			attributeDescriptions[2].offset = offsetof(PackedVertex, uv0);
+			return attributeDescriptions;
+		}
+
+		static PackedVertex pack(const Vertex& vertex, const VertexQuantization& quantization)
+		{
+			auto toUnorm = [](float value) { return (uint16_t)std::lround(glm::clamp(value, 0.f, 1.f) * 65535.f); };
+			auto toSnorm = [](float value) { return (int16_t)std::lround(glm::clamp(value, -1.f, 1.f) * 32767.f); };
+
+			PackedVertex packed;
+			const glm::vec3 pos = (vertex.pos - quantization.positionMin) / quantization.positionExtent;
+			packed.pos[0] = toUnorm(pos.x);
+			packed.pos[1] = toUnorm(pos.y);
+			packed.pos[2] = toUnorm(pos.z);
+			packed.pos[3] = 0;
+
+			// Project the normal onto the octahedron and fold the lower half over the diagonals. A zero normal stays zero.
+			glm::vec3 nor = vertex.nor;
+			const float sum = std::abs(nor.x) + std::abs(nor.y) + std::abs(nor.z);
+			glm::vec2 oct(0.f);
+			if (sum > 0.f)
+			{
+				nor /= sum;
+				oct = glm::vec2(nor.x, nor.y);
+				if (nor.z < 0.f)
+				{
+					oct.x = (1.f - std::abs(nor.y)) * (nor.x >= 0.f ? 1.f : -1.f);
+					oct.y = (1.f - std::abs(nor.x)) * (nor.y >= 0.f ? 1.f : -1.f);
+				}
+			}
+			packed.nor[0] = toSnorm(oct.x);
+			packed.nor[1] = toSnorm(oct.y);
+
+			const glm::vec2 uv = (vertex.uv0 - quantization.uvMin) / quantization.uvExtent;
+			packed.uv0[0] = toUnorm(uv.x);
+			packed.uv0[1] = toUnorm(uv.y);
+			return packed;
+		}
+
+		// Same decoding as the vertex shader, used to measure the error of the packing.
+		static Vertex unpack(const PackedVertex& packed, const VertexQuantization& quantization)
+		{
+			Vertex vertex;
+			const glm::vec3 pos(packed.pos[0] / 65535.f, packed.pos[1] / 65535.f, packed.pos[2] / 65535.f);
+			vertex.pos = quantization.positionMin + pos * quantization.positionExtent;
+
+			const glm::vec2 oct(std::max(packed.nor[0] / 32767.f, -1.f), std::max(packed.nor[1] / 32767.f, -1.f));
+			glm::vec3 nor(oct.x, oct.y, 1.f - std::abs(oct.x) - std::abs(oct.y));
+			const float t = std::max(-nor.z, 0.f);
+			nor.x += nor.x >= 0.f ? -t : t;
+			nor.y += nor.y >= 0.f ? -t : t;
+			vertex.nor = glm::normalize(nor);
+
+			const glm::vec2 uv(packed.uv0[0] / 65535.f, packed.uv0[1] / 65535.f);
+			vertex.uv0 = quantization.uvMin + uv * quantization.uvExtent;
+			return vertex;
+		}
+	};
+}
@@ -0,0 +1,242 @@
+#include "stdafx.h"
+#include "JobSystem.h"
+
+namespace ym
+{
+	std::vector<JobSystem::Worker*> JobSystem::workers;
+	JobCounter JobSystem::totalCounter;
+	std::atomic<uint32_t> JobSystem::pendingJobs{ 0 };
+	std::atomic<uint32_t> JobSystem::sleepingThreads{ 0 };
+	std::atomic<uint32_t> JobSystem::nextQueue{ 0 };
+	std::atomic<bool> JobSystem::destroying{ false };
+	std::atomic<uint64_t> JobSystem::executedJobs{ 0 };
+	std::atomic<uint64_t> JobSystem::stolenJobs{ 0 };
+	std::mutex JobSystem::sleepMutex;
+	std::condition_variable JobSystem::sleepCondition;
+
+	// Set when a worker starts, every other thread will use getWorkerCount() as its index.
+	static thread_local uint32_t g_workerIndex = UINT32_MAX;
+
+	void JobSystem::init(uint32_t numWorkers)
+	{
+		YM_ASSERT(workers.empty(), "JobSystem has already been initialized!");
+
+		destroying = false;
+		// All workers need to exist before any of them tries to steal.
+		for (uint32_t i = 0; i < numWorkers; i++)
+			workers.push_back(new Worker());
+		for (uint32_t i = 0; i < numWorkers; i++)
+			workers[i]->thread = std::thread(&JobSystem::workerLoop, i);
+
+		YM_LOG_INFO("Started job system with {} worker(s).", numWorkers);
+	}
+
+	void JobSystem::destroy()
+	{
+		if (workers.empty())
+			return;
+
+		// Finish all work before shutting down.
+		wait();
+
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			destroying = true;
+		}
+		sleepCondition.notify_all();
+
+		for (Worker* worker : workers)
+		{
+			if (worker->thread.joinable())
+				worker->thread.join();
+			delete worker;
+		}
+		workers.clear();
+	}
+
+	void JobSystem::execute(Job job, JobCounter* counter)
+	{
+		Entry entry;
+		entry.job = std::move(job);
+		entry.counter = counter;
+		if (counter)
+			counter->value++;
+		totalCounter.value++;
+
+		// Without workers the job is executed directly on the calling thread.
+		if (workers.empty())
+		{
+			run(entry);
+			return;
+		}
+
+		push(std::move(entry));
+	}
+
+	void JobSystem::dispatch(uint32_t count, uint32_t groupSize, const RangeJob& job, JobCounter* counter)
+	{
+		if (count == 0 || groupSize == 0)
+			return;
+
+		for (uint32_t first = 0; first < count; first += groupSize)
+		{
+			uint32_t last = std::min(first + groupSize, count);
+			execute([job, first, last]() { job(first, last); }, counter);
+		}
+	}
+
+	void JobSystem::wait(JobCounter* counter)
+	{
+		while (!counter->isDone())
+		{
+			Entry entry;
+			if (tryGetJob(entry))
+				run(entry);
+			else
+				sleep([counter]() { return counter->isDone() || pendingJobs.load() > 0; });
+		}
+	}
+
+	void JobSystem::wait()
+	{
+		wait(&totalCounter);
+	}
+
+	uint32_t JobSystem::getThreadIndex()
+	{
+		return g_workerIndex < workers.size() ? g_workerIndex : (uint32_t)workers.size();
+	}
+
+	bool JobSystem::isBusy()
+	{
+		return !totalCounter.isDone();
+	}
+
+	JobSystem::Stats JobSystem::getStats()
+	{
+		Stats stats;
+		stats.executed = executedJobs.load();
+		stats.stolen = stolenJobs.load();
+		return stats;
+	}
+
+	void JobSystem::push(Entry&& entry)
+	{
+		// Workers push to their own deque, other threads distribute the jobs over all workers.
+		uint32_t index = getThreadIndex();
+		if (index >= workers.size())
+			index = nextQueue++ % (uint32_t)workers.size();
+
+		{
+			Worker* worker = workers[index];
+			std::lock_guard<std::mutex> lock(worker->mutex);
+			worker->deque.push_back(std::move(entry));
+			pendingJobs++;
+		}
+
+		if (sleepingThreads.load() > 0)
+		{
+			// Lock to make sure a thread which is about to sleep sees the new job or receives the notification.
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			sleepCondition.notify_one();
+		}
+	}
+
+	bool JobSystem::tryGetJob(Entry& entry)
+	{
+		if (pendingJobs.load() == 0)
+			return false;
+
+		const uint32_t numWorkers = (uint32_t)workers.size();
+		const uint32_t index = getThreadIndex();
+
+		// Take the most recently added job from the own deque. (Most likely to still be in the cache)
+		if (index < numWorkers)
+		{
+			Worker* worker = workers[index];
+			std::lock_guard<std::mutex> lock(worker->mutex);
+			if (!worker->deque.empty())
+			{
+				entry = std::move(worker->deque.back());
+				worker->deque.pop_back();
+				pendingJobs--;
+				return true;
+			}
+		}
+
+		// Steal the oldest job from another worker.
+		for (uint32_t i = 1; i <= numWorkers; i++)
+		{
+			Worker* victim = workers[(index + i) % numWorkers];
+			std::lock_guard<std::mutex> lock(victim->mutex);
+			if (!victim->deque.empty())
+			{
+				entry = std::move(victim->deque.front());
+				victim->deque.pop_front();
+				pendingJobs--;
+				stolenJobs++;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void JobSystem::run(Entry& entry)
+	{
+		entry.job();
+		executedJobs++;
+
+		bool notify = false;
+		if (entry.counter && entry.counter->value.fetch_sub(1) == 1)
+			notify = true;
+		if (totalCounter.value.fetch_sub(1) == 1)
+			notify = true;
+
+		// Wake threads which might wait for this counter.
+		if (notify)
+			wakeAll();
+	}
+
+	void JobSystem::sleep(const std::function<bool(void)>& wakeCondition)
+	{
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingThreads++;
+		sleepCondition.wait(lock, [&wakeCondition]() { return wakeCondition() || destroying.load(); });
+		sleepingThreads--;
+	}
+
+	void JobSystem::wakeAll()
+	{
+		if (sleepingThreads.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			sleepCondition.notify_all();
+		}
+	}
+
+	void JobSystem::workerLoop(uint32_t index)
+	{
+		g_workerIndex = index;
+
+		while (true)
+		{
+			Entry entry;
+			if (tryGetJob(entry))
+			{
+				run(entry);
+				continue;
+			}
+
+			// Spin for a short while before sleeping, new jobs are often added in bursts.
+			for (uint32_t spin = 0; spin < 64 && pendingJobs.load() == 0 && !destroying.load(); spin++)
+				std::this_thread::yield();
+
+			if (pendingJobs.load() == 0)
+			{
+				if (destroying.load())
+					break;
+				sleep([]() { return pendingJobs.load() > 0; });
+			}
+		}
+	}
+}
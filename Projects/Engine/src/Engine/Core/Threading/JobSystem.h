@@ -0,0 +1,99 @@
+#pragma once
+
+#include "stdafx.h"
+#include <thread>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+
+namespace ym
+{
+	/*
+		A group of jobs can share one counter. It is incremented when a job is added and decremented when the job has finished.
+		Use JobSystem::wait(counter) to wait for all of the jobs in the group.
+	*/
+	struct JobCounter
+	{
+		std::atomic<uint32_t> value{ 0 };
+
+		bool isDone() const { return this->value.load() == 0; }
+	};
+
+	/*
+		Work-stealing job system. Each worker owns a deque, it takes jobs from the back of its own deque and steals from the front of
+		the others when it runs out of work. Threads which have nothing to do will sleep until new work is added.
+	*/
+	class JobSystem
+	{
+	public:
+		using Job = std::function<void(void)>;
+		// Called with the range [first, last) of the elements in one group.
+		using RangeJob = std::function<void(uint32_t first, uint32_t last)>;
+
+		struct Stats
+		{
+			uint64_t executed{ 0 };
+			uint64_t stolen{ 0 };
+		};
+
+	public:
+		// Start the worker threads. The calling thread will also execute jobs when it waits.
+		static void init(uint32_t numWorkers);
+		static void destroy();
+
+		// Add a job which can be executed on any worker. The counter is optional.
+		static void execute(Job job, JobCounter* counter = nullptr);
+
+		// Split [0, count) into groups of groupSize elements and execute each group as a separate job.
+		static void dispatch(uint32_t count, uint32_t groupSize, const RangeJob& job, JobCounter* counter);
+
+		// Wait for all jobs of the counter to finish. The calling thread will help with the work while waiting.
+		static void wait(JobCounter* counter);
+		// Wait for all jobs to finish.
+		static void wait();
+
+		static uint32_t getWorkerCount() { return (uint32_t)workers.size(); }
+		// Index of the calling thread, this is getWorkerCount() if the calling thread is not a worker (e.g. the main thread).
+		static uint32_t getThreadIndex();
+		static bool isBusy();
+
+		static Stats getStats();
+
+	private:
+		JobSystem() = delete;
+		~JobSystem() = default;
+
+		struct Entry
+		{
+			Job job;
+			JobCounter* counter{ nullptr };
+		};
+
+		struct Worker
+		{
+			std::thread thread;
+			std::mutex mutex;
+			std::deque<Entry> deque;
+		};
+
+		static void push(Entry&& entry);
+		static bool tryGetJob(Entry& entry);
+		static void run(Entry& entry);
+		static void sleep(const std::function<bool(void)>& wakeCondition);
+		static void wakeAll();
+		static void workerLoop(uint32_t index);
+
+		static std::vector<Worker*> workers;
+		static JobCounter totalCounter;
+		static std::atomic<uint32_t> pendingJobs;
+		static std::atomic<uint32_t> sleepingThreads;
+		static std::atomic<uint32_t> nextQueue;
+		static std::atomic<bool> destroying;
+		static std::atomic<uint64_t> executedJobs;
+		static std::atomic<uint64_t> stolenJobs;
+		static std::mutex sleepMutex;
+		static std::condition_variable sleepCondition;
+	};
+}
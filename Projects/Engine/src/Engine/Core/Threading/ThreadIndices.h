@@ -1,12 +0,0 @@
-#pragma once
-
-namespace ym
-{
-	enum class ThreadIndices : uint32_t
-	{
-		MODEL = 0,
-		TERRAIN = 1,
-		GLTF_LOADER = 1,
-		SIZE
-	};
-}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 // Code from: https://github.com/SaschaWillems/Vulkan/blob/master/base/threadpool.hpp
+// This has been replaced by the JobSystem and is only kept to be able to compare against it.
 
 #include "stdafx.h"
 #include <thread>
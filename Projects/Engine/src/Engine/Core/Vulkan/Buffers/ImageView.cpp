@@ -12,7 +12,7 @@ namespace ym
 	{
 	}
 
-	void ImageView::init(VkImage image, VkImageViewType type, VkFormat format, VkImageAspectFlags aspectMask, uint32_t layerCount, uint32_t mipLevels)
+	void ImageView::init(VkImage image, VkImageViewType type, VkFormat format, VkImageAspectFlags aspectMask, uint32_t layerCount, uint32_t mipLevels, uint32_t baseMipLevel)
 	{
 		VkImageViewCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -27,7 +27,7 @@ namespace ym
 		createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
 
 		createInfo.subresourceRange.aspectMask = aspectMask;
-		createInfo.subresourceRange.baseMipLevel = 0;
+		createInfo.subresourceRange.baseMipLevel = baseMipLevel;
 		createInfo.subresourceRange.levelCount = mipLevels;
 		createInfo.subresourceRange.baseArrayLayer = 0;
 		createInfo.subresourceRange.layerCount = layerCount;
@@ -8,7 +8,7 @@
 
 namespace ym
 {
-	Memory::Memory() : memory(VK_NULL_HANDLE), currentOffset(0)
+	Memory::Memory() : currentOffset(0), alignment(1)
 	{
 	}
 
@@ -16,66 +16,74 @@ namespace ym
 	{
 	}
 
-	void Memory::init(VkMemoryPropertyFlags memProp)
+	void Memory::init(VkMemoryPropertyFlags memProp, MemoryAllocator::Lifetime lifetime)
 	{
 		if (this->currentOffset != 0)
 		{
-			YM_ASSERT(this->currentOffset != 0, "No buffers/images bound before allocation of memory!");
-
-
-			uint32_t typeFilter = 0;
+			// The memory type needs to be supported by all of the resources.
+			uint32_t typeFilter = UINT32_MAX;
 			for (auto buffer : this->bufferOffsets)
-				typeFilter |= buffer.first->getMemReq().memoryTypeBits;
+				typeFilter &= buffer.first->getMemReq().memoryTypeBits;
 			for (auto texture : this->textureOffsets)
-				typeFilter |= texture.first->getMemoryRequirements().memoryTypeBits;
+				typeFilter &= texture.first->getMemoryRequirements().memoryTypeBits;
 
 			uint32_t memoryTypeIndex = findMemoryType(VulkanInstance::get()->getPhysicalDevice(), typeFilter, memProp);
-
-			VkMemoryAllocateInfo allocInfo = {};
-			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-			allocInfo.allocationSize = this->currentOffset;
-			allocInfo.memoryTypeIndex = memoryTypeIndex;
-
-			VULKAN_CHECK(vkAllocateMemory(VulkanInstance::get()->getLogicalDevice(), &allocInfo, nullptr, &this->memory), "Failed to allocate memory!");
+			bool hostVisible = (memProp & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+			MemoryAllocator::ResourceType type = this->textureOffsets.empty() ? MemoryAllocator::ResourceType::BUFFER : MemoryAllocator::ResourceType::IMAGE;
+			this->allocation = MemoryAllocator::get()->allocate(this->currentOffset, this->alignment, memoryTypeIndex, hostVisible, type, lifetime);
+			YM_ASSERT(this->allocation.memory != VK_NULL_HANDLE, "Failed to allocate memory!");
 
 			for (auto buffer : this->bufferOffsets)
-				VULKAN_CHECK(vkBindBufferMemory(VulkanInstance::get()->getLogicalDevice(), buffer.first->getBuffer(), this->memory, buffer.second), "Failed to bind buffer memory!");
+				VULKAN_CHECK(vkBindBufferMemory(VulkanInstance::get()->getLogicalDevice(), buffer.first->getBuffer(), this->allocation.memory, this->allocation.offset + buffer.second), "Failed to bind buffer memory!");
 
 			for (auto texture : this->textureOffsets)
-				VULKAN_CHECK(vkBindImageMemory(VulkanInstance::get()->getLogicalDevice(), texture.first->image.getImage(), this->memory, texture.second), "Failed to bind image memory!");
+				VULKAN_CHECK(vkBindImageMemory(VulkanInstance::get()->getLogicalDevice(), texture.first->image.getImage(), this->allocation.memory, this->allocation.offset + texture.second), "Failed to bind image memory!");
 		}
 	}
 
 	void Memory::destroy()
 	{
-		if (this->currentOffset != 0)
-			vkFreeMemory(VulkanInstance::get()->getLogicalDevice(), this->memory, nullptr);
+		MemoryAllocator::get()->free(this->allocation);
+		this->bufferOffsets.clear();
+		this->textureOffsets.clear();
+		this->currentOffset = 0;
+		this->alignment = 1;
 	}
 
 	void Memory::bindBuffer(Buffer* buffer)
 	{
+		VkMemoryRequirements memReq = buffer->getMemReq();
+		this->currentOffset = ((this->currentOffset + memReq.alignment - 1) / memReq.alignment) * memReq.alignment;
+		this->alignment = std::max(this->alignment, (uint64_t)memReq.alignment);
 		this->bufferOffsets[buffer] = this->currentOffset;
-		this->currentOffset += static_cast<Offset>(buffer->getMemReq().size);
+		this->currentOffset += static_cast<Offset>(memReq.size);
 	}
 
 	void Memory::bindTexture(Texture* texture)
 	{
+		VkMemoryRequirements memReq = texture->getMemoryRequirements();
+		this->currentOffset = ((this->currentOffset + memReq.alignment - 1) / memReq.alignment) * memReq.alignment;
+		this->alignment = std::max(this->alignment, (uint64_t)memReq.alignment);
 		this->textureOffsets[texture] = this->currentOffset;
-		this->currentOffset += static_cast<Offset>(texture->getMemoryRequirements().size);
+		this->currentOffset += static_cast<Offset>(memReq.size);
 	}
 
 	void Memory::directTransfer(Buffer* buffer, const void* data, uint64_t size, Offset bufferOffset)
 	{
-		Offset offset = this->bufferOffsets[buffer];
+		uint8_t* ptrGpu = static_cast<uint8_t*>(getMappedData(buffer));
+		YM_ASSERT(ptrGpu != nullptr, "Can not transfer directly to memory which is not host visible!");
+		memcpy(ptrGpu + bufferOffset, data, size);
+	}
 
-		void* ptrGpu;
-		VULKAN_CHECK(vkMapMemory(VulkanInstance::get()->getLogicalDevice(), this->memory, offset + bufferOffset, VK_WHOLE_SIZE, 0, &ptrGpu), "Failed to map memory for buffer!");
-		memcpy(ptrGpu, data, size);
-		vkUnmapMemory(VulkanInstance::get()->getLogicalDevice(), this->memory);
+	void* Memory::getMappedData(Buffer* buffer)
+	{
+		if (this->allocation.mappedData == nullptr)
+			return nullptr;
+		return static_cast<uint8_t*>(this->allocation.mappedData) + this->bufferOffsets[buffer];
 	}
 
 	VkDeviceMemory Memory::getMemory()
 	{
-		return this->memory;
+		return this->allocation.memory;
 	}
-}
+}
\ No newline at end of file
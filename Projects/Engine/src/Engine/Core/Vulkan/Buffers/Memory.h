@@ -1,6 +1,7 @@
 #pragma once
 
 #include "stdafx.h"
+#include "MemoryAllocator.h"
 
 typedef uint64_t Offset;
 
@@ -9,25 +10,38 @@ namespace ym
 	class Buffer;
 	struct Texture;
 
+	/*
+		A group of buffers and textures which share one allocation. The allocation is sub-allocated from the MemoryAllocator.
+	*/
 	class Memory
 	{
 	public:
 		Memory();
 		~Memory();
 
-		void init(VkMemoryPropertyFlags memProp);
+		/*
+			Allocate memory for all bound buffers and textures and bind them to it. Use TRANSIENT for staging data which is freed
+			soon after it was used.
+		*/
+		void init(VkMemoryPropertyFlags memProp, MemoryAllocator::Lifetime lifetime = MemoryAllocator::Lifetime::PERSISTENT);
 		void destroy();
 
 		void bindBuffer(Buffer* buffer);
 		void bindTexture(Texture* texture);
 		void directTransfer(Buffer* buffer, const void* data, uint64_t size, Offset bufferOffset);
 
+		/*
+			Pointer to the start of the buffer. Host visible memory is always mapped, this is null for other memory.
+		*/
+		void* getMappedData(Buffer* buffer);
+
 		VkDeviceMemory getMemory();
 
 	private:
-		VkDeviceMemory memory;
+		MemoryAllocation allocation;
 		std::unordered_map<Buffer*, Offset> bufferOffsets;
 		std::unordered_map<Texture*, Offset> textureOffsets;
 		Offset currentOffset;
+		uint64_t alignment;
 	};
-}
\ No newline at end of file
+}
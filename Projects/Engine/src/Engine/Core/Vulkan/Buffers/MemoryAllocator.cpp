@@ -0,0 +1,549 @@
+#include "stdafx.h"
+#include "MemoryAllocator.h"
+#include "../VulkanInstance.h"
+#include "Utils/Imgui/imgui.h"
+
+namespace
+{
+	uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return alignment > 1 ? ((value + alignment - 1) / alignment) * alignment : value;
+	}
+
+	uint64_t getSizeClassSize(uint32_t sizeClass)
+	{
+		return 256ull << sizeClass;
+	}
+
+	// Returns MEMORY_SMALL_SIZE_CLASSES if the size is too large for a slab.
+	uint32_t getSizeClass(uint64_t size)
+	{
+		uint32_t sizeClass = 0;
+		while (sizeClass < MEMORY_SMALL_SIZE_CLASSES && getSizeClassSize(sizeClass) < size)
+			sizeClass++;
+		return sizeClass;
+	}
+}
+
+VkDeviceMemory ym::VulkanMemoryDevice::allocate(uint32_t memoryTypeIndex, uint64_t size)
+{
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	if (vkAllocateMemory(VulkanInstance::get()->getLogicalDevice(), &allocInfo, nullptr, &memory) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+	return memory;
+}
+
+void ym::VulkanMemoryDevice::free(VkDeviceMemory memory)
+{
+	vkFreeMemory(VulkanInstance::get()->getLogicalDevice(), memory, nullptr);
+}
+
+void* ym::VulkanMemoryDevice::map(VkDeviceMemory memory)
+{
+	void* data = nullptr;
+	VULKAN_CHECK(vkMapMemory(VulkanInstance::get()->getLogicalDevice(), memory, 0, VK_WHOLE_SIZE, 0, &data), "Failed to map memory!");
+	return data;
+}
+
+void ym::VulkanMemoryDevice::unmap(VkDeviceMemory memory)
+{
+	vkUnmapMemory(VulkanInstance::get()->getLogicalDevice(), memory);
+}
+
+ym::TrackingMemoryDevice::TrackingMemoryDevice() : liveBytes(0), mappedCount(0), errorCount(0)
+{
+}
+
+ym::TrackingMemoryDevice::~TrackingMemoryDevice()
+{
+	if (this->memories.empty() == false)
+		YM_LOG_ERROR("TrackingMemoryDevice destroyed with {} live allocation(s)!", this->memories.size());
+	for (auto& memory : this->memories)
+		delete[] memory.second.data;
+	this->memories.clear();
+}
+
+VkDeviceMemory ym::TrackingMemoryDevice::allocate(uint32_t memoryTypeIndex, uint64_t size)
+{
+	// The host memory doubles as the handle, it is unique while the memory is live.
+	Memory memory;
+	memory.data = new uint8_t[size];
+	memory.size = size;
+	VkDeviceMemory handle = (VkDeviceMemory)memory.data;
+	this->memories[handle] = memory;
+	this->liveBytes += size;
+	return handle;
+}
+
+void ym::TrackingMemoryDevice::free(VkDeviceMemory memory)
+{
+	auto it = this->memories.find(memory);
+	if (it == this->memories.end())
+	{
+		this->errorCount++;
+		return;
+	}
+
+	// Like vkFreeMemory, freeing mapped memory unmaps it.
+	if (it->second.mapped)
+		this->mappedCount--;
+	this->liveBytes -= it->second.size;
+	delete[] it->second.data;
+	this->memories.erase(it);
+}
+
+void* ym::TrackingMemoryDevice::map(VkDeviceMemory memory)
+{
+	auto it = this->memories.find(memory);
+	if (it == this->memories.end() || it->second.mapped)
+	{
+		this->errorCount++;
+		return nullptr;
+	}
+
+	it->second.mapped = true;
+	this->mappedCount++;
+	return it->second.data;
+}
+
+void ym::TrackingMemoryDevice::unmap(VkDeviceMemory memory)
+{
+	auto it = this->memories.find(memory);
+	if (it == this->memories.end() || it->second.mapped == false)
+	{
+		this->errorCount++;
+		return;
+	}
+
+	it->second.mapped = false;
+	this->mappedCount--;
+}
+
+uint64_t ym::TrackingMemoryDevice::getSize(VkDeviceMemory memory) const
+{
+	auto it = this->memories.find(memory);
+	return it != this->memories.end() ? it->second.size : 0;
+}
+
+ym::MemoryAllocator::MemoryAllocator() : device(nullptr), blockSize(MEMORY_BLOCK_SIZE), transientBlockSize(MEMORY_TRANSIENT_BLOCK_SIZE),
+	allocationCount(0), usedBytes(0), deviceAllocateCalls(0), deviceFreeCalls(0)
+{
+}
+
+ym::MemoryAllocator::~MemoryAllocator()
+{
+	destroy();
+}
+
+ym::MemoryAllocator* ym::MemoryAllocator::get()
+{
+	static MemoryAllocator allocator;
+	return &allocator;
+}
+
+void ym::MemoryAllocator::init(MemoryDevice* device, uint64_t blockSize, uint64_t transientBlockSize)
+{
+	YM_ASSERT(this->device == nullptr, "MemoryAllocator has already been initialized!");
+	this->device = device;
+	this->blockSize = blockSize;
+	this->transientBlockSize = transientBlockSize;
+}
+
+void ym::MemoryAllocator::destroy()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->device == nullptr)
+		return;
+
+	if (this->allocationCount > 0)
+		YM_LOG_WARN("MemoryAllocator destroyed with {} live allocation(s)!", this->allocationCount);
+
+	for (Pool* pool : this->pools)
+	{
+		for (MemoryBlock* block : pool->blocks)
+			destroyBlock(block);
+		delete pool;
+	}
+	this->pools.clear();
+	SAFE_DELETE(this->device);
+
+	this->allocationCount = 0;
+	this->usedBytes = 0;
+}
+
+ym::MemoryAllocation ym::MemoryAllocator::allocate(uint64_t size, uint64_t alignment, uint32_t memoryTypeIndex, bool hostVisible, ResourceType type, Lifetime lifetime)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	YM_ASSERT(this->device != nullptr, "MemoryAllocator has not been initialized!");
+
+	Pool* pool = getPool(memoryTypeIndex, hostVisible, type, lifetime);
+	MemoryAllocation allocation;
+	if (lifetime == Lifetime::TRANSIENT)
+		allocation = size > this->transientBlockSize / 2 ? allocateDedicated(pool, size) : allocateTransient(pool, size, alignment);
+	else if (size > this->blockSize / 2)
+		allocation = allocateDedicated(pool, size);
+	else
+	{
+		uint32_t sizeClass = getSizeClass(size);
+		if (sizeClass < MEMORY_SMALL_SIZE_CLASSES && alignment <= getSizeClassSize(sizeClass))
+			allocation = allocateSlot(pool, sizeClass);
+		else
+			allocation = allocateGeneral(pool, size, alignment);
+	}
+
+	if (allocation.memory != VK_NULL_HANDLE)
+	{
+		this->allocationCount++;
+		this->usedBytes += allocation.size;
+	}
+	else
+		YM_LOG_ERROR("Failed to allocate {} bytes of device memory!", size);
+	return allocation;
+}
+
+void ym::MemoryAllocator::free(MemoryAllocation& allocation)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	MemoryBlock* block = allocation.block;
+	// All blocks are released when the allocator is destroyed.
+	if (block == nullptr || this->device == nullptr)
+	{
+		allocation = MemoryAllocation();
+		return;
+	}
+
+	this->allocationCount--;
+	this->usedBytes -= allocation.size;
+	Pool* pool = this->pools[block->poolIndex];
+
+	if (allocation.sizeClass < MEMORY_SMALL_SIZE_CLASSES)
+	{
+		freeSlot(pool, allocation);
+	}
+	else if (block->dedicated)
+	{
+		pool->blocks.erase(std::remove(pool->blocks.begin(), pool->blocks.end(), block), pool->blocks.end());
+		destroyBlock(block);
+	}
+	else
+	{
+		freeGeneral(pool, block, allocation.offset, allocation.size);
+	}
+
+	allocation = MemoryAllocation();
+}
+
+ym::MemoryAllocator::Stats ym::MemoryAllocator::getStats()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	Stats stats;
+	stats.allocationCount = this->allocationCount;
+	stats.usedBytes = this->usedBytes;
+	stats.deviceAllocateCalls = this->deviceAllocateCalls;
+	stats.deviceFreeCalls = this->deviceFreeCalls;
+	for (Pool* pool : this->pools)
+	{
+		for (MemoryBlock* block : pool->blocks)
+		{
+			stats.deviceBytes += block->size;
+			if (block->dedicated)
+			{
+				stats.dedicatedCount++;
+				continue;
+			}
+
+			stats.blockCount++;
+			if (block->lifetime == Lifetime::PERSISTENT)
+			{
+				for (auto& range : block->freeByOffset)
+				{
+					stats.freeBytes += range.second;
+					stats.largestFreeRange = std::max(stats.largestFreeRange, range.second);
+				}
+			}
+		}
+	}
+
+	if (stats.freeBytes > 0)
+		stats.fragmentation = 1.f - (float)((double)stats.largestFreeRange / (double)stats.freeBytes);
+	return stats;
+}
+
+void ym::MemoryAllocator::drawStats()
+{
+	Stats stats = getStats();
+	const float mb = 1.f / (1024.f * 1024.f);
+
+	static bool active = true;
+	ImGui::Begin("Device memory", &active);
+	ImGui::Text("Blocks: %u, dedicated: %u", stats.blockCount, stats.dedicatedCount);
+	ImGui::Text("Allocations: %u", stats.allocationCount);
+	ImGui::Text("Allocated: %.2f MB, used: %.2f MB", (float)stats.deviceBytes * mb, (float)stats.usedBytes * mb);
+	ImGui::Text("Free: %.2f MB, largest free range: %.2f MB", (float)stats.freeBytes * mb, (float)stats.largestFreeRange * mb);
+	ImGui::Text("Fragmentation: %.1f%%", stats.fragmentation * 100.f);
+	ImGui::Text("vkAllocateMemory: %llu, vkFreeMemory: %llu", (unsigned long long)stats.deviceAllocateCalls, (unsigned long long)stats.deviceFreeCalls);
+	ImGui::End();
+}
+
+ym::MemoryAllocator::Pool* ym::MemoryAllocator::getPool(uint32_t memoryTypeIndex, bool hostVisible, ResourceType type, Lifetime lifetime)
+{
+	for (Pool* pool : this->pools)
+	{
+		if (pool->memoryTypeIndex == memoryTypeIndex && pool->type == type && pool->lifetime == lifetime)
+			return pool;
+	}
+
+	Pool* pool = new Pool();
+	pool->memoryTypeIndex = memoryTypeIndex;
+	pool->hostVisible = hostVisible;
+	pool->type = type;
+	pool->lifetime = lifetime;
+	this->pools.push_back(pool);
+	return pool;
+}
+
+ym::MemoryBlock* ym::MemoryAllocator::createBlock(Pool* pool, uint64_t size, bool dedicated)
+{
+	VkDeviceMemory memory = this->device->allocate(pool->memoryTypeIndex, size);
+	if (memory == VK_NULL_HANDLE)
+		return nullptr;
+	this->deviceAllocateCalls++;
+
+	MemoryBlock* block = new MemoryBlock();
+	block->memory = memory;
+	block->size = size;
+	block->dedicated = dedicated;
+	block->lifetime = pool->lifetime;
+	block->poolIndex = (uint32_t)(std::find(this->pools.begin(), this->pools.end(), pool) - this->pools.begin());
+	if (pool->hostVisible)
+		block->mappedData = static_cast<uint8_t*>(this->device->map(memory));
+
+	if (dedicated == false && pool->lifetime == Lifetime::PERSISTENT)
+	{
+		block->freeByOffset[0] = size;
+		block->freeBySize.insert({ size, 0 });
+	}
+
+	pool->blocks.push_back(block);
+	return block;
+}
+
+void ym::MemoryAllocator::destroyBlock(MemoryBlock* block)
+{
+	if (block->mappedData)
+		this->device->unmap(block->memory);
+	this->device->free(block->memory);
+	this->deviceFreeCalls++;
+	delete block;
+}
+
+bool ym::MemoryAllocator::allocateFromBlock(MemoryBlock* block, uint64_t size, uint64_t alignment, MemoryAllocation& allocation)
+{
+	// Best fit, the alignment might make the smallest range too small so continue with larger ranges.
+	for (auto it = block->freeBySize.lower_bound({ size, 0 }); it != block->freeBySize.end(); ++it)
+	{
+		uint64_t rangeSize = it->first;
+		uint64_t rangeOffset = it->second;
+		uint64_t offset = alignUp(rangeOffset, alignment);
+		if (offset + size > rangeOffset + rangeSize)
+			continue;
+
+		block->freeBySize.erase(it);
+		block->freeByOffset.erase(rangeOffset);
+
+		// Return the padding before and the rest after the allocation.
+		if (offset > rangeOffset)
+		{
+			block->freeByOffset[rangeOffset] = offset - rangeOffset;
+			block->freeBySize.insert({ offset - rangeOffset, rangeOffset });
+		}
+		uint64_t end = offset + size;
+		if (end < rangeOffset + rangeSize)
+		{
+			block->freeByOffset[end] = rangeOffset + rangeSize - end;
+			block->freeBySize.insert({ rangeOffset + rangeSize - end, end });
+		}
+
+		block->liveAllocations++;
+		allocation.memory = block->memory;
+		allocation.offset = offset;
+		allocation.size = size;
+		allocation.mappedData = block->mappedData ? block->mappedData + offset : nullptr;
+		allocation.block = block;
+		return true;
+	}
+	return false;
+}
+
+void ym::MemoryAllocator::freeGeneral(Pool* pool, MemoryBlock* block, uint64_t offset, uint64_t size)
+{
+	block->liveAllocations--;
+	if (block->lifetime == Lifetime::TRANSIENT)
+	{
+		if (block->liveAllocations == 0)
+			block->head = 0;
+	}
+	else
+		freeRange(block, offset, size);
+
+	// Keep one empty block of each pool to avoid allocating a new block every time a model is loaded.
+	if (block->liveAllocations == 0)
+	{
+		for (MemoryBlock* other : pool->blocks)
+		{
+			if (other != block && other->dedicated == false && other->liveAllocations == 0)
+			{
+				pool->blocks.erase(std::remove(pool->blocks.begin(), pool->blocks.end(), block), pool->blocks.end());
+				destroyBlock(block);
+				break;
+			}
+		}
+	}
+}
+
+void ym::MemoryAllocator::freeRange(MemoryBlock* block, uint64_t offset, uint64_t size)
+{
+	// Merge with the next range.
+	auto next = block->freeByOffset.find(offset + size);
+	if (next != block->freeByOffset.end())
+	{
+		size += next->second;
+		block->freeBySize.erase({ next->second, next->first });
+		block->freeByOffset.erase(next);
+	}
+
+	// Merge with the previous range.
+	auto prev = block->freeByOffset.lower_bound(offset);
+	if (prev != block->freeByOffset.begin())
+	{
+		--prev;
+		if (prev->first + prev->second == offset)
+		{
+			offset = prev->first;
+			size += prev->second;
+			block->freeBySize.erase({ prev->second, prev->first });
+			block->freeByOffset.erase(prev);
+		}
+	}
+
+	block->freeByOffset[offset] = size;
+	block->freeBySize.insert({ size, offset });
+}
+
+ym::MemoryAllocation ym::MemoryAllocator::allocateGeneral(Pool* pool, uint64_t size, uint64_t alignment)
+{
+	MemoryAllocation allocation;
+	for (MemoryBlock* block : pool->blocks)
+	{
+		if (block->dedicated == false && allocateFromBlock(block, size, alignment, allocation))
+			return allocation;
+	}
+
+	MemoryBlock* block = createBlock(pool, this->blockSize, false);
+	if (block)
+		allocateFromBlock(block, size, alignment, allocation);
+	return allocation;
+}
+
+ym::MemoryAllocation ym::MemoryAllocator::allocateSlot(Pool* pool, uint32_t sizeClass)
+{
+	std::vector<MemoryAllocation>& freeSlots = pool->freeSlots[sizeClass];
+	if (freeSlots.empty())
+	{
+		// Split a new slab into slots. The slab is aligned to its size so every slot is aligned to the slot size, and the slab of a slot can be found from its offset.
+		uint64_t slotSize = getSizeClassSize(sizeClass);
+		MemoryAllocation slab = allocateGeneral(pool, MEMORY_SLAB_SIZE, MEMORY_SLAB_SIZE);
+		if (slab.memory == VK_NULL_HANDLE)
+			return slab;
+		pool->slabs[{ slab.block, slab.offset }] = 0;
+
+		for (uint64_t offset = MEMORY_SLAB_SIZE; offset >= slotSize; offset -= slotSize)
+		{
+			MemoryAllocation slot = slab;
+			slot.offset = slab.offset + offset - slotSize;
+			slot.size = slotSize;
+			slot.mappedData = slab.mappedData ? static_cast<uint8_t*>(slab.mappedData) + (offset - slotSize) : nullptr;
+			slot.sizeClass = sizeClass;
+			freeSlots.push_back(slot);
+		}
+	}
+
+	MemoryAllocation allocation = freeSlots.back();
+	freeSlots.pop_back();
+	pool->slabs[{ allocation.block, allocation.offset - allocation.offset % MEMORY_SLAB_SIZE }]++;
+	return allocation;
+}
+
+void ym::MemoryAllocator::freeSlot(Pool* pool, MemoryAllocation& allocation)
+{
+	// Slots go back to the free list of their size class. When all slots of a slab are free the slab is returned to its block.
+	uint64_t slabOffset = allocation.offset - allocation.offset % MEMORY_SLAB_SIZE;
+	auto slab = pool->slabs.find({ allocation.block, slabOffset });
+	std::vector<MemoryAllocation>& freeSlots = pool->freeSlots[allocation.sizeClass];
+	freeSlots.push_back(allocation);
+	if (--slab->second > 0)
+		return;
+
+	// Keep the last slab of the size class to avoid creating a new one for the next allocation.
+	uint64_t slotCount = MEMORY_SLAB_SIZE / getSizeClassSize(allocation.sizeClass);
+	if (freeSlots.size() <= slotCount)
+		return;
+
+	MemoryBlock* block = allocation.block;
+	freeSlots.erase(std::remove_if(freeSlots.begin(), freeSlots.end(), [block, slabOffset](const MemoryAllocation& slot) {
+		return slot.block == block && slot.offset - slot.offset % MEMORY_SLAB_SIZE == slabOffset;
+	}), freeSlots.end());
+	pool->slabs.erase(slab);
+	freeGeneral(pool, block, slabOffset, MEMORY_SLAB_SIZE);
+}
+
+ym::MemoryAllocation ym::MemoryAllocator::allocateTransient(Pool* pool, uint64_t size, uint64_t alignment)
+{
+	MemoryAllocation allocation;
+	MemoryBlock* target = nullptr;
+	for (MemoryBlock* block : pool->blocks)
+	{
+		if (block->dedicated == false && alignUp(block->head, alignment) + size <= block->size)
+		{
+			target = block;
+			break;
+		}
+	}
+
+	if (target == nullptr)
+		target = createBlock(pool, this->transientBlockSize, false);
+	if (target == nullptr)
+		return allocation;
+
+	uint64_t offset = alignUp(target->head, alignment);
+	target->head = offset + size;
+	target->liveAllocations++;
+	allocation.memory = target->memory;
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.mappedData = target->mappedData ? target->mappedData + offset : nullptr;
+	allocation.block = target;
+	return allocation;
+}
+
+ym::MemoryAllocation ym::MemoryAllocator::allocateDedicated(Pool* pool, uint64_t size)
+{
+	MemoryAllocation allocation;
+	MemoryBlock* block = createBlock(pool, size, true);
+	if (block)
+	{
+		block->liveAllocations = 1;
+		allocation.memory = block->memory;
+		allocation.offset = 0;
+		allocation.size = size;
+		allocation.mappedData = block->mappedData;
+		allocation.block = block;
+	}
+	return allocation;
+}
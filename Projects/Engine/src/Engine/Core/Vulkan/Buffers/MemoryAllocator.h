@@ -0,0 +1,198 @@
+#pragma once
+
+#include "stdafx.h"
+#include <mutex>
+#include <set>
+
+#define MEMORY_BLOCK_SIZE (64ull * 1024ull * 1024ull)			// Size of the blocks which persistent resources are sub-allocated from.
+#define MEMORY_TRANSIENT_BLOCK_SIZE (32ull * 1024ull * 1024ull)	// Size of the linear blocks used for staging data.
+#define MEMORY_SMALL_SIZE_CLASSES 9								// Size classes 256 B to 64 KB, smaller allocations are taken from slabs.
+#define MEMORY_SLAB_SIZE (256ull * 1024ull)						// Size of a slab which is split into slots of one size class, slabs are aligned to their size.
+
+namespace ym
+{
+	/*
+		The device calls used by the allocator. The allocator only talks to the device through this interface, which makes it
+		possible to run it with a device which only keeps track of the calls.
+	*/
+	class MemoryDevice
+	{
+	public:
+		virtual ~MemoryDevice() = default;
+
+		// Returns VK_NULL_HANDLE if the memory could not be allocated.
+		virtual VkDeviceMemory allocate(uint32_t memoryTypeIndex, uint64_t size) = 0;
+		virtual void free(VkDeviceMemory memory) = 0;
+		// Map the whole memory, it stays mapped until it is freed.
+		virtual void* map(VkDeviceMemory memory) = 0;
+		virtual void unmap(VkDeviceMemory memory) = 0;
+	};
+
+	// Allocates device memory from the logical device of the VulkanInstance.
+	class VulkanMemoryDevice : public MemoryDevice
+	{
+	public:
+		VkDeviceMemory allocate(uint32_t memoryTypeIndex, uint64_t size) override;
+		void free(VkDeviceMemory memory) override;
+		void* map(VkDeviceMemory memory) override;
+		void unmap(VkDeviceMemory memory) override;
+	};
+
+	/*
+		Allocates host memory in place of device memory and keeps track of every call, to check the allocator without the GPU.
+		Mapping returns the host memory, so what is written through one allocation can be checked for overwrites by another.
+		Calls which would be invalid on a real device (freeing or unmapping unknown memory, mapping twice) are counted as errors.
+	*/
+	class TrackingMemoryDevice : public MemoryDevice
+	{
+	public:
+		TrackingMemoryDevice();
+		~TrackingMemoryDevice();
+
+		VkDeviceMemory allocate(uint32_t memoryTypeIndex, uint64_t size) override;
+		void free(VkDeviceMemory memory) override;
+		void* map(VkDeviceMemory memory) override;
+		void unmap(VkDeviceMemory memory) override;
+
+		// Returns 0 if the memory is not live.
+		uint64_t getSize(VkDeviceMemory memory) const;
+		uint32_t getLiveCount() const { return (uint32_t)this->memories.size(); }
+		uint64_t getLiveBytes() const { return this->liveBytes; }
+		uint32_t getMappedCount() const { return this->mappedCount; }
+		uint32_t getErrorCount() const { return this->errorCount; }
+
+	private:
+		struct Memory
+		{
+			uint8_t* data{ nullptr };
+			uint64_t size{ 0 };
+			bool mapped{ false };
+		};
+
+		std::unordered_map<VkDeviceMemory, Memory> memories;
+		uint64_t liveBytes;
+		uint32_t mappedCount;
+		uint32_t errorCount;
+	};
+
+	struct MemoryBlock;
+	struct MemoryAllocation
+	{
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+		uint64_t offset{ 0 };
+		uint64_t size{ 0 };
+		void* mappedData{ nullptr }; // Points to the start of the allocation, null if the memory is not host visible.
+		MemoryBlock* block{ nullptr };
+		uint32_t sizeClass{ UINT32_MAX }; // Set if the allocation is a slot in a slab.
+	};
+
+	/*
+		Sub-allocates device memory for buffers and textures to keep the number of vkAllocateMemory calls low.
+		- Small allocations are taken from slabs, one free list for each size class.
+		- Other persistent allocations are taken from large blocks with best fit, free ranges are merged when freed.
+		- Transient allocations (staging data) use linear blocks which are reset when all of their allocations have been freed.
+		- Allocations larger than half a block get their own device memory.
+		Host visible blocks are mapped once and stay mapped. Buffers and images use separate blocks so bufferImageGranularity never
+		needs to be considered. All functions are thread safe.
+	*/
+	class MemoryAllocator
+	{
+	public:
+		enum class ResourceType { BUFFER, IMAGE };
+		enum class Lifetime { PERSISTENT, TRANSIENT };
+
+		struct Stats
+		{
+			uint32_t blockCount{ 0 };			// Blocks which allocations are sub-allocated from.
+			uint32_t dedicatedCount{ 0 };		// Allocations with their own device memory.
+			uint32_t allocationCount{ 0 };		// Live allocations.
+			uint64_t deviceBytes{ 0 };			// Memory allocated from the device.
+			uint64_t usedBytes{ 0 };			// Memory used by live allocations.
+			uint64_t freeBytes{ 0 };			// Free memory in the persistent blocks.
+			uint64_t largestFreeRange{ 0 };
+			float fragmentation{ 0.f };			// 1 - largestFreeRange / freeBytes. Zero when all free memory is in one range.
+			uint64_t deviceAllocateCalls{ 0 };
+			uint64_t deviceFreeCalls{ 0 };
+		};
+
+	public:
+		MemoryAllocator();
+		~MemoryAllocator();
+
+		static MemoryAllocator* get();
+
+		/*
+			The allocator takes ownership of the device.
+		*/
+		void init(MemoryDevice* device, uint64_t blockSize = MEMORY_BLOCK_SIZE, uint64_t transientBlockSize = MEMORY_TRANSIENT_BLOCK_SIZE);
+		void destroy();
+
+		/*
+			Allocate memory of the memory type. Returns an allocation with a null memory if the device is out of memory.
+		*/
+		MemoryAllocation allocate(uint64_t size, uint64_t alignment, uint32_t memoryTypeIndex, bool hostVisible, ResourceType type, Lifetime lifetime);
+		void free(MemoryAllocation& allocation);
+
+		Stats getStats();
+
+		/*
+			Draw the stats in an ImGui window.
+		*/
+		void drawStats();
+
+	private:
+		struct Pool
+		{
+			uint32_t memoryTypeIndex{ 0 };
+			bool hostVisible{ false };
+			ResourceType type{ ResourceType::BUFFER };
+			Lifetime lifetime{ Lifetime::PERSISTENT };
+			std::vector<MemoryBlock*> blocks;
+			std::vector<MemoryAllocation> freeSlots[MEMORY_SMALL_SIZE_CLASSES];
+			std::map<std::pair<MemoryBlock*, uint64_t>, uint32_t> slabs; // Number of used slots of each slab, keyed by block and offset.
+		};
+
+		Pool* getPool(uint32_t memoryTypeIndex, bool hostVisible, ResourceType type, Lifetime lifetime);
+		MemoryBlock* createBlock(Pool* pool, uint64_t size, bool dedicated);
+		void destroyBlock(MemoryBlock* block);
+
+		bool allocateFromBlock(MemoryBlock* block, uint64_t size, uint64_t alignment, MemoryAllocation& allocation);
+		void freeGeneral(Pool* pool, MemoryBlock* block, uint64_t offset, uint64_t size);
+		void freeRange(MemoryBlock* block, uint64_t offset, uint64_t size);
+		MemoryAllocation allocateGeneral(Pool* pool, uint64_t size, uint64_t alignment);
+		MemoryAllocation allocateSlot(Pool* pool, uint32_t sizeClass);
+		void freeSlot(Pool* pool, MemoryAllocation& allocation);
+		MemoryAllocation allocateTransient(Pool* pool, uint64_t size, uint64_t alignment);
+		MemoryAllocation allocateDedicated(Pool* pool, uint64_t size);
+
+	private:
+		MemoryDevice* device;
+		uint64_t blockSize;
+		uint64_t transientBlockSize;
+		std::vector<Pool*> pools;
+		std::mutex mutex;
+
+		uint32_t allocationCount;
+		uint64_t usedBytes;
+		uint64_t deviceAllocateCalls;
+		uint64_t deviceFreeCalls;
+	};
+
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+		uint64_t size{ 0 };
+		uint8_t* mappedData{ nullptr };
+		bool dedicated{ false };
+		uint32_t poolIndex{ 0 };
+		MemoryAllocator::Lifetime lifetime{ MemoryAllocator::Lifetime::PERSISTENT };
+		uint32_t liveAllocations{ 0 };
+
+		// Persistent blocks: free ranges sorted by offset (for merging) and by size (for best fit).
+		std::map<uint64_t, uint64_t> freeByOffset;
+		std::set<std::pair<uint64_t, uint64_t>> freeBySize;
+
+		// Transient blocks: linear allocation.
+		uint64_t head{ 0 };
+	};
+}
@@ -0,0 +1,177 @@
+#include "stdafx.h"
+#include "RangeAllocator.h"
+
+namespace
+{
+	uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return alignment > 1 ? ((value + alignment - 1) / alignment) * alignment : value;
+	}
+}
+
+ym::RangeAllocator::RangeAllocator() : capacity(0), usedSize(0)
+{
+}
+
+ym::RangeAllocator::~RangeAllocator()
+{
+}
+
+void ym::RangeAllocator::init(uint64_t capacity)
+{
+	destroy();
+	this->capacity = capacity;
+	if (capacity > 0)
+	{
+		this->freeByOffset[0] = capacity;
+		this->freeBySize.insert({ capacity, 0 });
+	}
+}
+
+void ym::RangeAllocator::destroy()
+{
+	this->allocations.clear();
+	this->freeByOffset.clear();
+	this->freeBySize.clear();
+	this->capacity = 0;
+	this->usedSize = 0;
+}
+
+uint64_t ym::RangeAllocator::allocate(uint64_t size, uint64_t alignment)
+{
+	if (size == 0)
+		return RANGE_ALLOCATOR_INVALID;
+
+	// Best fit, the alignment might make the smallest range too small so continue with larger ranges.
+	for (auto it = this->freeBySize.lower_bound({ size, 0 }); it != this->freeBySize.end(); ++it)
+	{
+		const uint64_t rangeSize = it->first;
+		const uint64_t rangeOffset = it->second;
+		const uint64_t offset = alignUp(rangeOffset, alignment);
+		if (offset + size > rangeOffset + rangeSize)
+			continue;
+
+		this->freeBySize.erase(it);
+		this->freeByOffset.erase(rangeOffset);
+
+		// Return the padding before and the rest after the allocation.
+		if (offset > rangeOffset)
+		{
+			this->freeByOffset[rangeOffset] = offset - rangeOffset;
+			this->freeBySize.insert({ offset - rangeOffset, rangeOffset });
+		}
+		const uint64_t end = offset + size;
+		if (end < rangeOffset + rangeSize)
+		{
+			this->freeByOffset[end] = rangeOffset + rangeSize - end;
+			this->freeBySize.insert({ rangeOffset + rangeSize - end, end });
+		}
+
+		Allocation& allocation = this->allocations[offset];
+		allocation.size = size;
+		allocation.alignment = alignment;
+		this->usedSize += size;
+		return offset;
+	}
+	return RANGE_ALLOCATOR_INVALID;
+}
+
+void ym::RangeAllocator::free(uint64_t offset)
+{
+	auto it = this->allocations.find(offset);
+	YM_ASSERT(it != this->allocations.end(), "No allocation at offset {}!", offset);
+
+	const uint64_t size = it->second.size;
+	this->allocations.erase(it);
+	this->usedSize -= size;
+	freeRange(offset, size);
+}
+
+std::vector<ym::RangeAllocator::Move> ym::RangeAllocator::defragment()
+{
+	std::vector<Move> moves;
+	moves.reserve(this->allocations.size());
+	uint64_t end = 0;
+	std::map<uint64_t, Allocation> packed;
+	this->freeByOffset.clear();
+	this->freeBySize.clear();
+	for (auto& allocation : this->allocations)
+	{
+		// The old offset is aligned and not before the end of the previous allocation, an allocation never moves to a higher offset.
+		const uint64_t dstOffset = alignUp(end, allocation.second.alignment);
+		if (dstOffset > end)
+		{
+			this->freeByOffset[end] = dstOffset - end;
+			this->freeBySize.insert({ dstOffset - end, end });
+		}
+
+		Move move;
+		move.srcOffset = allocation.first;
+		move.dstOffset = dstOffset;
+		move.size = allocation.second.size;
+		moves.push_back(move);
+		packed[dstOffset] = allocation.second;
+		end = dstOffset + allocation.second.size;
+	}
+
+	this->allocations.swap(packed);
+	if (end < this->capacity)
+	{
+		this->freeByOffset[end] = this->capacity - end;
+		this->freeBySize.insert({ this->capacity - end, end });
+	}
+	return moves;
+}
+
+uint64_t ym::RangeAllocator::getSize(uint64_t offset) const
+{
+	auto it = this->allocations.find(offset);
+	return it != this->allocations.end() ? it->second.size : 0;
+}
+
+ym::RangeAllocator::Stats ym::RangeAllocator::getStats() const
+{
+	Stats stats;
+	stats.capacity = this->capacity;
+	stats.usedSize = this->usedSize;
+	stats.allocationCount = (uint32_t)this->allocations.size();
+	stats.freeRangeCount = (uint32_t)this->freeByOffset.size();
+	for (auto& range : this->freeByOffset)
+	{
+		stats.freeSize += range.second;
+		stats.largestFreeRange = std::max(stats.largestFreeRange, range.second);
+	}
+
+	if (stats.freeSize > 0)
+		stats.fragmentation = 1.f - (float)((double)stats.largestFreeRange / (double)stats.freeSize);
+	return stats;
+}
+
+void ym::RangeAllocator::freeRange(uint64_t offset, uint64_t size)
+{
+	// Merge with the next range.
+	auto next = this->freeByOffset.find(offset + size);
+	if (next != this->freeByOffset.end())
+	{
+		size += next->second;
+		this->freeBySize.erase({ next->second, next->first });
+		this->freeByOffset.erase(next);
+	}
+
+	// Merge with the previous range.
+	auto prev = this->freeByOffset.lower_bound(offset);
+	if (prev != this->freeByOffset.begin())
+	{
+		--prev;
+		if (prev->first + prev->second == offset)
+		{
+			offset = prev->first;
+			size += prev->second;
+			this->freeBySize.erase({ prev->second, prev->first });
+			this->freeByOffset.erase(prev);
+		}
+	}
+
+	this->freeByOffset[offset] = size;
+	this->freeBySize.insert({ size, offset });
+}
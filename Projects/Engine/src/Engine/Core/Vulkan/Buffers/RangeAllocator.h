@@ -0,0 +1,80 @@
+#pragma once
+
+#include "stdafx.h"
+#include <set>
+
+#define RANGE_ALLOCATOR_INVALID UINT64_MAX // Returned by allocate when no free range is large enough.
+
+namespace ym
+{
+	/*
+		Allocates ranges of elements from a fixed capacity, with best fit. Free ranges are merged when freed. The allocator only
+		keeps track of offsets and does not own any memory, the caller decides what an element is (a byte, a vertex or an index).
+		Not thread safe.
+	*/
+	class RangeAllocator
+	{
+	public:
+		// A live allocation which defragment moves from srcOffset to dstOffset.
+		struct Move
+		{
+			uint64_t srcOffset{ 0 };
+			uint64_t dstOffset{ 0 };
+			uint64_t size{ 0 };
+		};
+
+		struct Stats
+		{
+			uint64_t capacity{ 0 };
+			uint64_t usedSize{ 0 };
+			uint64_t freeSize{ 0 };
+			uint64_t largestFreeRange{ 0 };
+			uint32_t allocationCount{ 0 };
+			uint32_t freeRangeCount{ 0 };
+			float fragmentation{ 0.f }; // 1 - largestFreeRange / freeSize. Zero when all free elements are in one range.
+		};
+
+	public:
+		RangeAllocator();
+		~RangeAllocator();
+
+		void init(uint64_t capacity);
+		void destroy();
+
+		/*
+			Returns the offset of the range, which is a multiple of the alignment, or RANGE_ALLOCATOR_INVALID if no free range is large
+			enough.
+		*/
+		uint64_t allocate(uint64_t size, uint64_t alignment = 1);
+		void free(uint64_t offset);
+
+		/*
+			Pack all allocations at the start of the capacity, in the order of their offsets. Allocations keep their alignment, which
+			can leave small free ranges between them. Returns one move for every allocation, sorted by offset. Allocations which did not
+			move have the same source and destination offset.
+		*/
+		std::vector<Move> defragment();
+
+		uint64_t getSize(uint64_t offset) const;
+		uint64_t getCapacity() const { return this->capacity; }
+		Stats getStats() const;
+
+	private:
+		struct Allocation
+		{
+			uint64_t size{ 0 };
+			uint64_t alignment{ 1 };
+		};
+
+		void freeRange(uint64_t offset, uint64_t size);
+
+	private:
+		uint64_t capacity;
+		uint64_t usedSize;
+		std::map<uint64_t, Allocation> allocations; // Keyed by offset.
+
+		// Free ranges sorted by offset (for merging) and by size (for best fit).
+		std::map<uint64_t, uint64_t> freeByOffset;
+		std::set<std::pair<uint64_t, uint64_t>> freeBySize;
+	};
+}
@@ -0,0 +1,85 @@
+#include "stdafx.h"
+#include "RingBuffer.h"
+#include "../Factory.h"
+
+ym::RingBuffer::RingBuffer() : mappedData(nullptr), usage(0), queues(0), frameSize(0), frameCount(0), frameStart(0), head(0)
+{
+}
+
+ym::RingBuffer::~RingBuffer()
+{
+}
+
+void ym::RingBuffer::init(uint64_t frameSize, uint32_t frameCount, VkBufferUsageFlags usage, VkQueueFlags queues)
+{
+	this->frameSize = frameSize;
+	this->frameCount = frameCount;
+	this->usage = usage;
+	this->queues = queues;
+	this->frameStart = 0;
+	this->head = 0;
+
+	std::vector<uint32_t> queueIndices = Factory::getQueueIndices(queues);
+	this->buffer.init(frameSize * (uint64_t)frameCount, usage, queueIndices);
+	this->memory.bindBuffer(&this->buffer);
+	this->memory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	// Host visible memory stays mapped for the lifetime of the buffer.
+	this->mappedData = this->memory.getMappedData(&this->buffer);
+}
+
+void ym::RingBuffer::destroy()
+{
+	if (this->mappedData != nullptr)
+	{
+		this->buffer.destroy();
+		this->memory.destroy();
+		this->mappedData = nullptr;
+	}
+}
+
+void ym::RingBuffer::resize(uint64_t frameSize)
+{
+	destroy();
+	init(frameSize, this->frameCount, this->usage, this->queues);
+}
+
+void ym::RingBuffer::begin(uint32_t frameIndex)
+{
+	this->frameStart = this->frameSize * (uint64_t)(frameIndex % this->frameCount);
+	this->head = this->frameStart;
+}
+
+uint64_t ym::RingBuffer::allocate(uint64_t size, uint64_t alignment)
+{
+	uint64_t offset = alignment > 1 ? ((this->head + alignment - 1) / alignment) * alignment : this->head;
+	if (offset + size > this->frameStart + this->frameSize)
+		return UINT64_MAX;
+
+	this->head = offset + size;
+	return offset;
+}
+
+void* ym::RingBuffer::getData(uint64_t offset) const
+{
+	return static_cast<uint8_t*>(this->mappedData) + offset;
+}
+
+VkDescriptorBufferInfo ym::RingBuffer::getDescriptor() const
+{
+	VkDescriptorBufferInfo descriptor;
+	descriptor.buffer = this->buffer.getBuffer();
+	descriptor.offset = (VkDeviceSize)0;
+	descriptor.range = (VkDeviceSize)(this->frameSize * (uint64_t)this->frameCount);
+	return descriptor;
+}
+
+uint64_t ym::RingBuffer::getFrameSize() const
+{
+	return this->frameSize;
+}
+
+uint64_t ym::RingBuffer::getUsedSize() const
+{
+	return this->head - this->frameStart;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Engine/Core/Vulkan/Buffers/Buffer.h"
+#include "Engine/Core/Vulkan/Buffers/Memory.h"
+
+namespace ym
+{
+	/*
+		Persistently mapped host visible buffer split into one region per frame. Data is sub-allocated linearly from the region of
+		the current frame, the region is reused when the same frame index begins again. The caller needs to make sure the GPU is done
+		with a region before it begins writing to it again.
+	*/
+	class RingBuffer
+	{
+	public:
+		RingBuffer();
+		~RingBuffer();
+
+		/*
+			The buffer is shared between the queue families of the queues, it is used by the graphics queue by default.
+		*/
+		void init(uint64_t frameSize, uint32_t frameCount, VkBufferUsageFlags usage, VkQueueFlags queues = VK_QUEUE_GRAPHICS_BIT);
+		void destroy();
+
+		/*
+			Recreate the buffer with a new frame size. The buffer can not be in use by the GPU, all previous allocations are lost.
+		*/
+		void resize(uint64_t frameSize);
+
+		/*
+			Start allocating from the region of the frame.
+		*/
+		void begin(uint32_t frameIndex);
+
+		/*
+			Allocate size bytes in the region of the current frame. Returns the offset from the start of the buffer or UINT64_MAX if the region is full.
+		*/
+		uint64_t allocate(uint64_t size, uint64_t alignment);
+
+		/*
+			Pointer to the mapped memory at the offset.
+		*/
+		void* getData(uint64_t offset) const;
+
+		VkDescriptorBufferInfo getDescriptor() const;
+		uint64_t getFrameSize() const;
+		uint64_t getUsedSize() const;
+
+	private:
+		Buffer buffer;
+		Memory memory;
+		void* mappedData;
+		VkBufferUsageFlags usage;
+		VkQueueFlags queues;
+		uint64_t frameSize;
+		uint32_t frameCount;
+		uint64_t frameStart;
+		uint64_t head;
+	};
+}
@@ -99,7 +99,7 @@ namespace ym
 	void CommandBuffer::cmdBindDescriptorSets(Pipeline * pipeline, uint32_t firstSet, const std::vector<VkDescriptorSet> & sets, const std::vector<uint32_t> & offsets)
 	{
 		vkCmdBindDescriptorSets(this->buffer, (VkPipelineBindPoint)pipeline->getType(),
-			pipeline->getPipelineLayout(), 0, static_cast<uint32_t>(sets.size()), sets.data(), static_cast<uint32_t>(offsets.size()), offsets.data());
+			pipeline->getPipelineLayout(), firstSet, static_cast<uint32_t>(sets.size()), sets.data(), static_cast<uint32_t>(offsets.size()), offsets.data());
 	}
 
 	void CommandBuffer::cmdDraw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
@@ -112,11 +112,26 @@ namespace ym
 		vkCmdDrawIndexed(this->buffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
 	}
 
+	void CommandBuffer::cmdDrawIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+	{
+		vkCmdDrawIndirect(this->buffer, buffer, offset, drawCount, stride);
+	}
+
 	void CommandBuffer::cmdDrawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
 	{
 		vkCmdDrawIndexedIndirect(this->buffer, buffer, offset, drawCount, stride);
 	}
 
+	void CommandBuffer::cmdDrawIndirectCount(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride)
+	{
+		vkCmdDrawIndirectCount(this->buffer, buffer, offset, countBuffer, countOffset, maxDrawCount, stride);
+	}
+
+	void CommandBuffer::cmdDrawIndexedIndirectCount(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride)
+	{
+		vkCmdDrawIndexedIndirectCount(this->buffer, buffer, offset, countBuffer, countOffset, maxDrawCount, stride);
+	}
+
 	void CommandBuffer::cmdMemoryBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlag, std::vector<VkMemoryBarrier> barriers)
 	{
 		vkCmdPipelineBarrier(
@@ -181,6 +196,11 @@ namespace ym
 		vkCmdCopyBufferToImage(this->buffer, srcBuffer, dstImage, dstImageLayout, regionCount, pRegions);
 	}
 
+	void CommandBuffer::cmdCopyImageToBuffer(VkImage srcImage, VkImageLayout srcImageLayout, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferImageCopy* pRegions)
+	{
+		vkCmdCopyImageToBuffer(this->buffer, srcImage, srcImageLayout, dstBuffer, regionCount, pRegions);
+	}
+
 	void CommandBuffer::cmdWriteTimestamp(VkPipelineStageFlagBits pipelineStage, VkQueryPool queryPool, uint32_t query)
 	{
 		vkCmdWriteTimestamp(this->buffer, pipelineStage, queryPool, query);
@@ -75,8 +75,7 @@ namespace ym
 		vkQueueSubmit(getQueue().queue, 1, &submitInfo, VK_NULL_HANDLE);
 		vkQueueWaitIdle(getQueue().queue);
 
-		vkFreeCommandBuffers(VulkanInstance::get()->getLogicalDevice(), this->pool, 1, &commandBuffer);
-		removeCommandBuffer(buffer);
+		freeCommandBuffer(buffer);
 	}
 
 	// Creates one (1) command buffer only
@@ -119,6 +118,13 @@ namespace ym
 		delete buffer;
 	}
 
+	void CommandPool::freeCommandBuffer(CommandBuffer* buffer)
+	{
+		VkCommandBuffer commandBuffer = buffer->getCommandBuffer();
+		vkFreeCommandBuffers(VulkanInstance::get()->getLogicalDevice(), this->pool, 1, &commandBuffer);
+		removeCommandBuffer(buffer);
+	}
+
 	void CommandPool::createCommandPool(VkCommandPoolCreateFlags flags)
 	{
 		// Get queues
@@ -32,6 +32,8 @@ namespace ym
 		CommandBuffer* createCommandBuffer(VkCommandBufferLevel level);
 		std::vector<CommandBuffer*> createCommandBuffers(uint32_t count, VkCommandBufferLevel level);
 		void removeCommandBuffer(CommandBuffer* buffer);
+		// Free the Vulkan command buffer and remove it from the pool.
+		void freeCommandBuffer(CommandBuffer* buffer);
 
 	private:
 		void createCommandPool(VkCommandPoolCreateFlags flags);
@@ -11,16 +11,22 @@
 #include "Engine/Core/Application/LayerManager.h"
 #include "CommandBuffer.h"
 
+#include <algorithm>
+
 namespace ym
 {
 	struct Factory
 	{
-		static std::vector<uint32_t> getQueueIndices(VkQueueFlagBits queues)
+		static std::vector<uint32_t> getQueueIndices(VkQueueFlags queues)
 		{
 			std::vector<uint32_t> queueIndices;
 			if (queues & VK_QUEUE_GRAPHICS_BIT) queueIndices.push_back(VulkanInstance::get()->getGraphicsQueue().queueIndex);
 			if (queues & VK_QUEUE_COMPUTE_BIT) queueIndices.push_back(VulkanInstance::get()->getComputeQueue().queueIndex);
 			if (queues & VK_QUEUE_TRANSFER_BIT) queueIndices.push_back(VulkanInstance::get()->getTransferQueue().queueIndex);
+
+			// Concurrent sharing needs unique families, the queues can share one.
+			std::sort(queueIndices.begin(), queueIndices.end());
+			queueIndices.erase(std::unique(queueIndices.begin(), queueIndices.end()), queueIndices.end());
 			return queueIndices;
 		}
 
@@ -32,7 +38,7 @@ namespace ym
 		}
 
 		/*
-			Creates one texture with its own device memory. (This does not set its data, use transferData to do that)
+			Creates one texture with its own memory, sub-allocated from the MemoryAllocator. (This does not set its data, use transferData to do that)
 			The resulting image will be in VK_IMAGE_LAYOUT_UNDEFINED. 
 			!!!! If mipmaps is used, set usage to VK_IMAGE_USAGE_TRANSFER_SRC_BIT and VK_IMAGE_USAGE_TRANSFER_DST_BIT !!!
 		*/
@@ -59,7 +65,7 @@ namespace ym
 			VkDeviceSize dataSize = getSizeFromFormat(texture->textureDesc.format)*texture->textureDesc.width*texture->textureDesc.height;
 			stagingBuffer.init(dataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { VulkanInstance::get()->getGraphicsQueue().queueIndex });
 			stagingMemory.bindBuffer(&stagingBuffer);
-			stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryAllocator::Lifetime::TRANSIENT);
 			stagingMemory.directTransfer(&stagingBuffer, (void*)texture->textureDesc.data, dataSize, 0);
 
 			// Setup a buffer copy region for the transfer.
@@ -105,7 +111,7 @@ namespace ym
 		}
 
 		/*
-			Creates one texture with its own device memory. (This does not set its data, use transferData to do that)
+			Creates one texture with its own memory, sub-allocated from the MemoryAllocator. (This does not set its data, use transferData to do that)
 		*/
 		static Texture* createCubeMapTexture(TextureDesc textureDesc, VkImageUsageFlags usage, VkQueueFlagBits queues, VkImageAspectFlags aspectFlags, uint32_t mipLevels)
 		{
@@ -134,7 +140,7 @@ namespace ym
 			Memory stagingMemory;
 			stagingBuffer.init(size * numFaces, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, { VulkanInstance::get()->getGraphicsQueue().queueIndex });
 			stagingMemory.bindBuffer(&stagingBuffer);
-			stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			stagingMemory.init(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryAllocator::Lifetime::TRANSIENT);
 
 			// Transfer the data to the buffer.
 			stagingMemory.directTransfer(&stagingBuffer, texture->textureDesc.data, size * numFaces, 0);
@@ -188,7 +194,15 @@ namespace ym
 		{
 			CommandPool* pool = &LayerManager::get()->getCommandPools()->graphicsPool;
 			CommandBuffer* commandBuffer = pool->beginSingleTimeCommand();
+			generateMipmaps(texture, commandBuffer);
+			pool->endSingleTimeCommand(commandBuffer);
+		}
 
+		/*
+			Records the mipmap generation into the command buffer, which needs to be on a queue with graphics support. Same requirements as above.
+		*/
+		static void generateMipmaps(Texture* texture, CommandBuffer* commandBuffer)
+		{
 			VkImageMemoryBarrier barrier{};
 			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 			barrier.image = texture->image.getImage();
@@ -258,8 +272,6 @@ namespace ym
 			}
 
 			texture->image.setLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-			pool->endSingleTimeCommand(commandBuffer);
 		}
 	};
 }
\ No newline at end of file
@@ -13,9 +13,15 @@ namespace ym
 	}
 
 	void DescriptorLayout::add(VkDescriptorSetLayoutBinding* descriptor)
+	{
+		add(descriptor, 0);
+	}
+
+	void DescriptorLayout::add(VkDescriptorSetLayoutBinding* descriptor, VkDescriptorBindingFlags bindingFlags)
 	{
 		descriptor->binding = this->currentBinding++;
 		this->descriptors.push_back(*descriptor);
+		this->bindingFlags.push_back(bindingFlags);
 
 		// Create new write group if there are non.
 		if (this->writeGroups.empty())
@@ -49,6 +55,19 @@ namespace ym
 		layoutInfo.bindingCount = static_cast<uint32_t>(this->descriptors.size());
 		layoutInfo.pBindings = this->descriptors.data();
 
+		// The flags are only chained when a binding uses them.
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsInfo.bindingCount = static_cast<uint32_t>(this->bindingFlags.size());
+		bindingFlagsInfo.pBindingFlags = this->bindingFlags.data();
+		for (VkDescriptorBindingFlags flags : this->bindingFlags)
+		{
+			if (flags != 0)
+				layoutInfo.pNext = &bindingFlagsInfo;
+		}
+		if (isUpdateAfterBind())
+			layoutInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+
 		VkResult result = vkCreateDescriptorSetLayout(VulkanInstance::get()->getLogicalDevice(), &layoutInfo, nullptr, &this->layout);
 		YM_ASSERT(result == VK_SUCCESS, "Failed to create descriptor set layout!");
 	}
@@ -72,8 +91,13 @@ namespace ym
 		std::vector<VkDescriptorPoolSize> result;
 		for (auto& group : this->writeGroups)
 		{
+			// Array bindings need one descriptor for each element.
+			uint32_t count = 0;
+			for (const VkDescriptorSetLayoutBinding& binding : group)
+				count += binding.descriptorCount;
+
 			VkDescriptorPoolSize size;
-			size.descriptorCount = factor * static_cast<uint32_t>(group.size());
+			size.descriptorCount = factor * count;
 			size.type = group.front().descriptorType;
 			result.push_back(size);
 		}
@@ -93,4 +117,14 @@ namespace ym
 		YM_ASSERT(false, "Binding out of range!");
 		return std::pair<VkDescriptorType, GroupIndex>();
 	}
+
+	bool DescriptorLayout::isUpdateAfterBind() const
+	{
+		for (VkDescriptorBindingFlags flags : this->bindingFlags)
+		{
+			if (flags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT)
+				return true;
+		}
+		return false;
+	}
 }
@@ -15,15 +15,23 @@ namespace ym
 
 		void add(VkDescriptorSetLayoutBinding* descriptor);
 
+		/*
+			Add a descriptor with binding flags, like VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT for arrays which are not fully written.
+			Sets from a layout with VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT can only be allocated from a pool which was created after it.
+		*/
+		void add(VkDescriptorSetLayoutBinding* descriptor, VkDescriptorBindingFlags bindingFlags);
+
 		void init();
 		void destroy();
 
 		VkDescriptorSetLayout getLayout() const;
 		std::vector<VkDescriptorPoolSize> getPoolSizes(uint32_t factor) const;
 		std::pair<VkDescriptorType, GroupIndex> getWriteElem(uint32_t binding) const;
+		bool isUpdateAfterBind() const;
 
 	private:
 		std::vector<VkDescriptorSetLayoutBinding> descriptors;
+		std::vector<VkDescriptorBindingFlags> bindingFlags;
 		std::vector<std::vector<VkDescriptorSetLayoutBinding>> writeGroups;
 		uint32_t currentBinding;
 		VkDescriptorSetLayout layout;
@@ -34,10 +34,12 @@ void ym::DescriptorPool::init(uint32_t numCopies)
 	};
 
 	uint32_t numSets = 0;
+	bool updateAfterBind = false;
 	for (LayoutData& layoutData : this->descriptorSetLayouts)
 	{
 		numSets += layoutData.count;
 		addToMap(layoutData.layout.getPoolSizes(layoutData.count));
+		updateAfterBind = updateAfterBind || layoutData.layout.isUpdateAfterBind();
 	}
 
 	std::vector<VkDescriptorPoolSize> poolSizes;
@@ -47,6 +49,7 @@ void ym::DescriptorPool::init(uint32_t numCopies)
 	// Create descriptor pool.
 	VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
 	descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolInfo.flags = updateAfterBind ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0;
 	descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	descriptorPoolInfo.pPoolSizes = poolSizes.data();
 	descriptorPoolInfo.maxSets = numSets * numCopies;
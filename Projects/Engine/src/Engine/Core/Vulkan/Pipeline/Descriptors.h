@@ -30,4 +30,5 @@ namespace ym
 	DESCRIPTOR(SSBO, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
 	DESCRIPTOR(DynamicSSBO, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
 	DESCRIPTOR(IMG, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+	DESCRIPTOR(StorageIMG, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)
 }
\ No newline at end of file
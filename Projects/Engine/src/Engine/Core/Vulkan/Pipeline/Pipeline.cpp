@@ -6,6 +6,7 @@
 #include "RenderPass.h"
 #include "DescriptorLayout.h"
 #include "PushConstants.h"
+#include "Utils/Timer.h"
 
 // TODO: Add support for addition of descriptors and push constants for both graphics and compute pipeline.
 
@@ -23,13 +24,17 @@ namespace ym
 
 	void Pipeline::init(Type type, Shader* shader)
 	{
+		YM_PROFILER_FUNCTION();
+
 		this->type = type;
 		this->shader = shader;
 
+		Timer timer;
 		if (type == Type::GRAPHICS)
 			createGraphicsPipeline();
 		else if (type == Type::COMPUTE)
 			createComputePipeline();
+		VulkanInstance::get()->getPipelineCache()->addCreationTime((double)timer.stop() * 1000.0);
 	}
 
 	void Pipeline::destroy()
@@ -269,7 +274,7 @@ namespace ym
 		pipelineInfo.flags = 0;
 		pipelineInfo.basePipelineIndex = -1; // Optional
 
-		VULKAN_CHECK(vkCreateGraphicsPipelines(VulkanInstance::get()->getLogicalDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->pipeline), "Failed to create graphics pipeline!");
+		VULKAN_CHECK(vkCreateGraphicsPipelines(VulkanInstance::get()->getLogicalDevice(), VulkanInstance::get()->getPipelineCache()->getCache(), 1, &pipelineInfo, nullptr, &this->pipeline), "Failed to create graphics pipeline!");
 	}
 
 	void Pipeline::createComputePipeline()
@@ -292,6 +297,6 @@ namespace ym
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 		pipelineInfo.basePipelineIndex = -1;
 
-		VULKAN_CHECK(vkCreateComputePipelines(VulkanInstance::get()->getLogicalDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->pipeline), "Failed to create graphics pipeline!");
+		VULKAN_CHECK(vkCreateComputePipelines(VulkanInstance::get()->getLogicalDevice(), VulkanInstance::get()->getPipelineCache()->getCache(), 1, &pipelineInfo, nullptr, &this->pipeline), "Failed to create graphics pipeline!");
 	}
 }
\ No newline at end of file
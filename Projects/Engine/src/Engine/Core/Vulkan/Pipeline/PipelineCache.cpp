@@ -0,0 +1,158 @@
+#include "stdafx.h"
+#include "PipelineCache.h"
+
+#include "Utils/MappedFile.h"
+#include "Utils/FileUtils.h"
+
+namespace ym
+{
+	PipelineCache::PipelineCache() : device(VK_NULL_HANDLE), cache(VK_NULL_HANDLE), properties({})
+	{
+	}
+
+	PipelineCache::~PipelineCache()
+	{
+	}
+
+	void PipelineCache::init(VkDevice device, VkPhysicalDevice physicalDevice, const std::string& filePath)
+	{
+		this->device = device;
+		this->filePath = filePath;
+		vkGetPhysicalDeviceProperties(physicalDevice, &this->properties);
+
+		std::vector<uint8_t> data = load();
+
+		VkPipelineCacheCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		createInfo.initialDataSize = data.size();
+		createInfo.pInitialData = data.empty() ? nullptr : data.data();
+		VkResult result = vkCreatePipelineCache(this->device, &createInfo, nullptr, &this->cache);
+		if (result != VK_SUCCESS && data.empty() == false)
+		{
+			// The driver did not accept the data, start with an empty cache instead.
+			YM_LOG_WARN("Pipeline cache was rejected by the driver, starting with an empty cache. [{}]", this->filePath.c_str());
+			data.clear();
+			createInfo.initialDataSize = 0;
+			createInfo.pInitialData = nullptr;
+			result = vkCreatePipelineCache(this->device, &createInfo, nullptr, &this->cache);
+		}
+		VULKAN_CHECK(result, "Failed to create pipeline cache!");
+
+		this->stats = Stats();
+		this->stats.warm = data.empty() == false;
+		this->stats.loadedSize = (uint64_t)data.size();
+		if (this->stats.warm)
+			YM_LOG_INFO("Loaded pipeline cache, {} bytes. [{}]", data.size(), this->filePath.c_str());
+		else
+			YM_LOG_INFO("No usable pipeline cache, pipelines will be compiled. [{}]", this->filePath.c_str());
+	}
+
+	void PipelineCache::destroy()
+	{
+		if (this->cache == VK_NULL_HANDLE)
+			return;
+
+		save();
+		vkDestroyPipelineCache(this->device, this->cache, nullptr);
+		this->cache = VK_NULL_HANDLE;
+	}
+
+	void PipelineCache::addCreationTime(double ms)
+	{
+		std::lock_guard<std::mutex> lck(this->mutex);
+		this->stats.pipelineCount++;
+		this->stats.creationMs += ms;
+	}
+
+	PipelineCache::Stats PipelineCache::getStats()
+	{
+		std::lock_guard<std::mutex> lck(this->mutex);
+		return this->stats;
+	}
+
+	std::vector<uint8_t> PipelineCache::load()
+	{
+		std::vector<uint8_t> data;
+		MappedFile file;
+		if (file.open(this->filePath) == false)
+			return data;
+
+		if (file.getSize() < sizeof(Header))
+			return data;
+
+		const Header* header = reinterpret_cast<const Header*>(file.getData());
+		if (isCompatible(*header) == false)
+		{
+			YM_LOG_INFO("Pipeline cache was written by another device or driver, it will be rebuilt. [{}]", this->filePath.c_str());
+			return data;
+		}
+
+		const uint8_t* cacheData = file.getData() + sizeof(Header);
+		if (header->dataSize != file.getSize() - sizeof(Header) || header->dataHash != FileUtils::hash(cacheData, header->dataSize))
+		{
+			YM_LOG_WARN("Pipeline cache is corrupt, it will be rebuilt. [{}]", this->filePath.c_str());
+			return data;
+		}
+
+		// The data starts with the header which is defined by Vulkan, check it as well before giving it to the driver.
+		struct VulkanHeader
+		{
+			uint32_t headerSize;
+			uint32_t headerVersion;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		};
+		if (header->dataSize < sizeof(VulkanHeader))
+			return data;
+		VulkanHeader vulkanHeader;
+		memcpy(&vulkanHeader, cacheData, sizeof(VulkanHeader));
+		if (vulkanHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || vulkanHeader.vendorID != this->properties.vendorID ||
+			vulkanHeader.deviceID != this->properties.deviceID || memcmp(vulkanHeader.pipelineCacheUUID, this->properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+			return data;
+
+		data.assign(cacheData, cacheData + header->dataSize);
+		return data;
+	}
+
+	void PipelineCache::save()
+	{
+		size_t size = 0;
+		if (vkGetPipelineCacheData(this->device, this->cache, &size, nullptr) != VK_SUCCESS || size == 0)
+			return;
+		std::vector<uint8_t> data(size);
+		if (vkGetPipelineCacheData(this->device, this->cache, &size, data.data()) != VK_SUCCESS)
+			return;
+		data.resize(size);
+
+		Header header;
+		memset(&header, 0, sizeof(Header));
+		memcpy(header.magic, "YMP", 4);
+		header.version = PIPELINE_CACHE_VERSION;
+		header.vendorID = this->properties.vendorID;
+		header.deviceID = this->properties.deviceID;
+		header.driverVersion = this->properties.driverVersion;
+		memcpy(header.pipelineCacheUUID, this->properties.pipelineCacheUUID, VK_UUID_SIZE);
+		header.dataSize = (uint64_t)data.size();
+		header.dataHash = FileUtils::hash(data.data(), header.dataSize);
+
+		// Written through a temporary file, a crash while writing should not leave a half written cache.
+		bool written = FileUtils::writeAtomic(this->filePath, [&](std::ofstream& file) {
+			file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+			file.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+		});
+		if (written == false)
+		{
+			YM_LOG_WARN("Could not write pipeline cache. [{}]", this->filePath.c_str());
+			return;
+		}
+		YM_LOG_INFO("Saved pipeline cache, {} bytes. [{}]", data.size(), this->filePath.c_str());
+	}
+
+	bool PipelineCache::isCompatible(const Header& header) const
+	{
+		return memcmp(header.magic, "YMP", 4) == 0 && header.version == PIPELINE_CACHE_VERSION && header.vendorID == this->properties.vendorID &&
+			header.deviceID == this->properties.deviceID && header.driverVersion == this->properties.driverVersion &&
+			memcmp(header.pipelineCacheUUID, this->properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+}
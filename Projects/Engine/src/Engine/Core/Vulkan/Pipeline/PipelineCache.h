@@ -0,0 +1,69 @@
+#pragma once
+
+#include "stdafx.h"
+#include <mutex>
+
+#define PIPELINE_CACHE_VERSION 1
+#define PIPELINE_CACHE_FILE_PATH std::string("./PipelineCache.bin")
+
+namespace ym
+{
+	/*
+		Engine-wide VkPipelineCache which is used by all pipelines. The cache data is written to disk when the device is destroyed and
+		loaded on the next start, the driver can then skip compiling shaders it has already seen. The file is only used if it was
+		written by the same device and driver.
+	*/
+	class PipelineCache
+	{
+	public:
+		struct Stats
+		{
+			bool warm{ false };			// True if the cache was loaded from disk.
+			uint64_t loadedSize{ 0 };	// Bytes of cache data loaded from disk.
+			uint32_t pipelineCount{ 0 };
+			double creationMs{ 0.0 };	// Time spent creating pipelines.
+		};
+
+	public:
+		PipelineCache();
+		~PipelineCache();
+
+		void init(VkDevice device, VkPhysicalDevice physicalDevice, const std::string& filePath);
+		// Save the cache to disk and destroy it.
+		void destroy();
+
+		VkPipelineCache getCache() const { return this->cache; }
+
+		// Called by the pipelines with the time it took to create them.
+		void addCreationTime(double ms);
+		Stats getStats();
+
+	private:
+		struct Header
+		{
+			char magic[4];
+			uint32_t version;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+			uint32_t _padding;
+			uint64_t dataSize;
+			uint64_t dataHash;
+		};
+
+		// Returns the cache data of the file, or an empty vector if it can not be used on this device.
+		std::vector<uint8_t> load();
+		void save();
+		bool isCompatible(const Header& header) const;
+
+	private:
+		VkDevice device;
+		VkPipelineCache cache;
+		VkPhysicalDeviceProperties properties;
+		std::string filePath;
+
+		std::mutex mutex;
+		Stats stats;
+	};
+}
@@ -146,6 +146,12 @@ namespace ym
 		}
 	}
 
+	bool Shader::exists(const std::string& filename)
+	{
+		std::ifstream file(filename, std::ios::binary);
+		return file.is_open();
+	}
+
 	std::vector<char> Shader::readFile(const std::string & filename)
 	{
 		std::ifstream file(filename, std::ios::ate | std::ios::binary);
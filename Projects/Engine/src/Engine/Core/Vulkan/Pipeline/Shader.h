@@ -23,6 +23,9 @@ namespace ym
 		std::string getName() const;
 		uint32_t getId() const;
 
+		// True if the compiled shader file exists, used to fall back when a shader variant has not been built.
+		static bool exists(const std::string& filename);
+
 	private:
 		struct Stage
 		{
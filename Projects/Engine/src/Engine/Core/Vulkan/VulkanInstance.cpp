@@ -44,14 +44,18 @@ void ym::VulkanInstance::init(uint32_t version)
 	deviceFeatures.fillModeNonSolid = VK_TRUE;
 	//deviceFeatures.logicOp = VK_TRUE;
 	//deviceFeatures.pipelineStatisticsQuery = VK_TRUE;
-	deviceFeatures.multiDrawIndirect = VK_TRUE;
 	createLogicalDevice(deviceFeatures);
 
+	this->pipelineCache.init(this->logicalDevice, this->physicalDevice, PIPELINE_CACHE_FILE_PATH);
+
 	YM_LOG_INFO("Created Vulkan instance with API version: {}.{}.{}", VK_VERSION_MAJOR(this->version), VK_VERSION_MINOR(this->version), VK_VERSION_PATCH(this->version));
 }
 
 void ym::VulkanInstance::destroy()
 {
+	// Save the pipeline cache while the device still exists.
+	this->pipelineCache.destroy();
+
 	// Destroy the logical device.
 	vkDestroyDevice(this->logicalDevice, nullptr);
 	this->logicalDevice = VK_NULL_HANDLE;
@@ -103,6 +107,8 @@ ym::QueueFamilyIndices ym::VulkanInstance::getQueueFamilies()
 ym::VulkanInstance::VulkanInstance()
 {
 	this->enableValidationLayers = false;
+	this->descriptorIndexing = false;
+	this->indirectDraws = false;
 	this->instance = VK_NULL_HANDLE;
 	this->debugMessenger = VK_NULL_HANDLE;
 	this->surface = VK_NULL_HANDLE;
@@ -220,8 +226,8 @@ int ym::VulkanInstance::calculateDeviceSuitability(VkPhysicalDevice device)
 	vkGetPhysicalDeviceProperties(device, &deviceProperties);
 	vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 
-	// Exit if device is not suitable.
-	if (!isDeviceSuitable(device, deviceFeatures))
+	// Exit if device is not suitable or does not support the version of the instance.
+	if (!isDeviceSuitable(device, deviceFeatures) || deviceProperties.apiVersion < this->version)
 		return 0;
 
 	// Discrete GPUs have a significant performance advantage
@@ -283,6 +289,39 @@ void ym::VulkanInstance::createLogicalDevice(VkPhysicalDeviceFeatures deviceFeat
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.pEnabledFeatures = &deviceFeatures;
 
+	/*
+		Features of Vulkan 1.2. Timeline semaphores are required by the version and used by the model uploads. Descriptor indexing is
+		optional, only the features which bindless materials use are enabled. The indirect draws of the GPU culling are optional as well,
+		they need multiple draws per call, a firstInstance in the commands and a draw count read from a buffer.
+	*/
+	VkPhysicalDeviceVulkan12Features supported12 = {};
+	supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 supportedFeatures = {};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures.pNext = &supported12;
+	vkGetPhysicalDeviceFeatures2(this->physicalDevice, &supportedFeatures);
+
+	VkPhysicalDeviceVulkan12Features features12 = {};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	features12.timelineSemaphore = VK_TRUE;
+	this->descriptorIndexing = supported12.runtimeDescriptorArray && supported12.shaderSampledImageArrayNonUniformIndexing &&
+		supported12.descriptorBindingPartiallyBound && supported12.descriptorBindingSampledImageUpdateAfterBind;
+	if (this->descriptorIndexing)
+	{
+		features12.runtimeDescriptorArray = VK_TRUE;
+		features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		features12.descriptorBindingPartiallyBound = VK_TRUE;
+		features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	}
+	this->indirectDraws = supportedFeatures.features.multiDrawIndirect && supportedFeatures.features.drawIndirectFirstInstance && supported12.drawIndirectCount;
+	if (this->indirectDraws)
+	{
+		deviceFeatures.multiDrawIndirect = VK_TRUE;
+		deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+		features12.drawIndirectCount = VK_TRUE;
+	}
+	createInfo.pNext = &features12;
+
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(this->deviceExtensions.size());
 	createInfo.ppEnabledExtensionNames = this->deviceExtensions.data();
 
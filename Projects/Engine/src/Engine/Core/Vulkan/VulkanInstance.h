@@ -3,6 +3,7 @@
 #include "stdafx.h"
 
 #include "Engine/Core/Vulkan/VulkanHelperfunctions.h"
+#include "Engine/Core/Vulkan/Pipeline/PipelineCache.h"
 
 namespace ym
 {
@@ -39,6 +40,15 @@ namespace ym
 
 		uint32_t getVersion() const { return this->version; }
 
+		// True if the device was created with the descriptor indexing features which bindless materials need.
+		bool supportsDescriptorIndexing() const { return this->descriptorIndexing; }
+
+		// True if the device was created with the multi draw, first instance and draw count features which the GPU culling draws need.
+		bool supportsIndirectDraws() const { return this->indirectDraws; }
+
+		// The pipeline cache which should be used when creating pipelines.
+		PipelineCache* getPipelineCache() { return &this->pipelineCache; }
+
 	private:
 		VulkanInstance();
 
@@ -75,6 +85,8 @@ namespace ym
 		static std::vector<const char*> validationLayers;
 
 		uint32_t version;
+		bool descriptorIndexing;
+		bool indirectDraws;
 
 		VkInstance instance;
 		VkDebugUtilsMessengerEXT debugMessenger;
@@ -87,5 +99,7 @@ namespace ym
 		VulkanQueue presentQueue;
 		VulkanQueue transferQueue;
 		VulkanQueue computeQueue;
+
+		PipelineCache pipelineCache;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "stdafx.h"
+#include "FileUtils.h"
+#include "MappedFile.h"
+
+#include <filesystem>
+
+namespace ym
+{
+	uint64_t FileUtils::hash(const uint8_t* data, uint64_t size)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (uint64_t i = 0; i < size; i++)
+		{
+			hash ^= (uint64_t)data[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	uint64_t FileUtils::hashFile(const std::string& filePath)
+	{
+		MappedFile file;
+		if (file.open(filePath) == false)
+			return hash(nullptr, 0);
+		return hash(file.getData(), file.getSize());
+	}
+
+	bool FileUtils::writeAtomic(const std::string& filePath, const std::function<void(std::ofstream& file)>& write)
+	{
+		std::string tempPath = filePath + ".tmp";
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (file.is_open() == false)
+			return false;
+		write(file);
+		file.close();
+
+		std::error_code error;
+		if (file.fail() == false)
+			std::filesystem::rename(tempPath, filePath, error);
+		if (file.fail() || error)
+		{
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		return true;
+	}
+}
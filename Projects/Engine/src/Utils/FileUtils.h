@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+
+namespace ym
+{
+	/*
+		File helpers shared by the caches which are baked to disk.
+	*/
+	class FileUtils
+	{
+	public:
+		// FNV-1a hash of the data.
+		static uint64_t hash(const uint8_t* data, uint64_t size);
+		// FNV-1a hash of the content of the file, the file is mapped instead of read. Missing and empty files get the hash of no data.
+		static uint64_t hashFile(const std::string& filePath);
+
+		/*
+			Write the file to a temporary file first and rename it when it is complete, a file which is loaded at the same time or
+			a crash while writing never sees a half written file. Returns false if the file could not be written, the temporary
+			file is removed in that case.
+		*/
+		static bool writeAtomic(const std::string& filePath, const std::function<void(std::ofstream& file)>& write);
+	};
+}
@@ -0,0 +1,99 @@
+#include "stdafx.h"
+#include "MappedFile.h"
+
+#ifndef YM_PLATFORM_WINDOWS
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace ym
+{
+#ifdef YM_PLATFORM_WINDOWS
+	MappedFile::MappedFile() : data(nullptr), size(0), file(INVALID_HANDLE_VALUE), mapping(nullptr)
+	{
+	}
+#else
+	MappedFile::MappedFile() : data(nullptr), size(0), file(-1)
+	{
+	}
+#endif
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	bool MappedFile::open(const std::string& filePath)
+	{
+		close();
+
+#ifdef YM_PLATFORM_WINDOWS
+		this->file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (this->file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (GetFileSizeEx(this->file, &fileSize) == FALSE || fileSize.QuadPart == 0)
+		{
+			close();
+			return false;
+		}
+		this->size = (uint64_t)fileSize.QuadPart;
+
+		this->mapping = CreateFileMappingA(this->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (this->mapping == nullptr)
+		{
+			close();
+			return false;
+		}
+
+		this->data = static_cast<const uint8_t*>(MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+		this->file = ::open(filePath.c_str(), O_RDONLY);
+		if (this->file == -1)
+			return false;
+
+		struct stat fileStat;
+		if (fstat(this->file, &fileStat) != 0 || fileStat.st_size == 0)
+		{
+			close();
+			return false;
+		}
+		this->size = (uint64_t)fileStat.st_size;
+
+		void* mapped = mmap(nullptr, (size_t)this->size, PROT_READ, MAP_PRIVATE, this->file, 0);
+		this->data = mapped != MAP_FAILED ? static_cast<const uint8_t*>(mapped) : nullptr;
+#endif
+
+		if (this->data == nullptr)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+#ifdef YM_PLATFORM_WINDOWS
+		if (this->data != nullptr)
+			UnmapViewOfFile(this->data);
+		if (this->mapping != nullptr)
+			CloseHandle(this->mapping);
+		if (this->file != INVALID_HANDLE_VALUE)
+			CloseHandle(this->file);
+		this->mapping = nullptr;
+		this->file = INVALID_HANDLE_VALUE;
+#else
+		if (this->data != nullptr)
+			munmap((void*)this->data, (size_t)this->size);
+		if (this->file != -1)
+			::close(this->file);
+		this->file = -1;
+#endif
+		this->data = nullptr;
+		this->size = 0;
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace ym
+{
+	/*
+		Maps a whole file read only into memory. The file stays mapped until close is called or the object is destroyed.
+	*/
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		MappedFile(const MappedFile& other) = delete;
+		MappedFile& operator=(const MappedFile& other) = delete;
+
+		// Returns false if the file does not exist or could not be mapped.
+		bool open(const std::string& filePath);
+		void close();
+
+		bool isOpen() const { return this->data != nullptr; }
+		const uint8_t* getData() const { return this->data; }
+		uint64_t getSize() const { return this->size; }
+
+	private:
+		const uint8_t* data;
+		uint64_t size;
+#ifdef YM_PLATFORM_WINDOWS
+		void* file;
+		void* mapping;
+#else
+		int file;
+#endif
+	};
+}
@@ -1,20 +1,36 @@
-C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=vertex pbrTestVert.glsl -o pbrTestVert.spv
-C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=frag pbrTestFrag.glsl -o pbrTestFrag.spv
-C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=frag pbrFrag.glsl -o pbrFrag.spv
+rem The build calls this with GLSLC set to the glslc of the Vulkan SDK in premake5.lua and nopause, a shader which does not
+rem compile fails the build.
+if not defined GLSLC set "GLSLC=C:/VulkanSDK/1.2.148.1/Bin/glslc.exe"
+set FAILED=0
 
-C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=vertex terrainVert.glsl -o terrainVert.spv
-C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=frag terrainFragTest.glsl -o terrainFragTest.spv
-C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=compute terrainComp.glsl -o terrainComp.spv
+%GLSLC% -fshader-stage=vertex pbrTestVert.glsl -o pbrTestVert.spv || set FAILED=1
+%GLSLC% -fshader-stage=vertex -DPACKED_VERTICES pbrTestVert.glsl -o pbrTestPackedVert.spv || set FAILED=1
+%GLSLC% -fshader-stage=frag pbrTestFrag.glsl -o pbrTestFrag.spv || set FAILED=1
+%GLSLC% -fshader-stage=frag pbrFrag.glsl -o pbrFrag.spv || set FAILED=1
+%GLSLC% -fshader-stage=frag -DSH_IRRADIANCE pbrFrag.glsl -o pbrShFrag.spv || set FAILED=1
+%GLSLC% -fshader-stage=frag -DBINDLESS pbrFrag.glsl -o pbrBindlessFrag.spv || set FAILED=1
+%GLSLC% -fshader-stage=frag -DSH_IRRADIANCE -DBINDLESS pbrFrag.glsl -o pbrShBindlessFrag.spv || set FAILED=1
 
-C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=vertex skyboxVert.glsl -o skyboxVert.spv
-C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=frag skyboxFrag.glsl -o skyboxFrag.spv
+%GLSLC% -fshader-stage=vertex terrainVert.glsl -o terrainVert.spv || set FAILED=1
+%GLSLC% -fshader-stage=frag terrainFrag.glsl -o terrainFrag.spv || set FAILED=1
+%GLSLC% -fshader-stage=compute terrainCullComp.glsl -o terrainCullComp.spv || set FAILED=1
 
-C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=vertex cubeVert.glsl -o cubeVert.spv
-C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=frag cubeConvertFrag.glsl -o cubeConvertFrag.spv
+%GLSLC% -fshader-stage=compute modelCullComp.glsl -o modelCullComp.spv || set FAILED=1
+%GLSLC% -fshader-stage=compute -DOCCLUSION modelCullComp.glsl -o modelCullOcclusionComp.spv || set FAILED=1
+%GLSLC% -fshader-stage=compute depthPyramidComp.glsl -o depthPyramidComp.spv || set FAILED=1
+%GLSLC% -fshader-stage=compute modelDrawCommandsComp.glsl -o modelDrawCommandsComp.spv || set FAILED=1
 
-C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=frag irradianceCubeFrag.glsl -o irradianceCubeFrag.spv
-C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=frag prefilteredEnvMapFrag.glsl -o prefilteredEnvMapFrag.spv
+%GLSLC% -fshader-stage=vertex skyboxVert.glsl -o skyboxVert.spv || set FAILED=1
+%GLSLC% -fshader-stage=frag skyboxFrag.glsl -o skyboxFrag.spv || set FAILED=1
 
-C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=vertex genbrdflutVert.glsl -o genbrdflutVert.spv
-C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe -fshader-stage=frag genbrdflutFrag.glsl -o genbrdflutFrag.spv
-pause
\ No newline at end of file
+%GLSLC% -fshader-stage=vertex cubeVert.glsl -o cubeVert.spv || set FAILED=1
+%GLSLC% -fshader-stage=frag cubeConvertFrag.glsl -o cubeConvertFrag.spv || set FAILED=1
+
+%GLSLC% -fshader-stage=frag irradianceCubeFrag.glsl -o irradianceCubeFrag.spv || set FAILED=1
+%GLSLC% -fshader-stage=frag prefilteredEnvMapFrag.glsl -o prefilteredEnvMapFrag.spv || set FAILED=1
+
+%GLSLC% -fshader-stage=vertex genbrdflutVert.glsl -o genbrdflutVert.spv || set FAILED=1
+%GLSLC% -fshader-stage=frag genbrdflutFrag.glsl -o genbrdflutFrag.spv || set FAILED=1
+if "%1"=="nopause" exit /b %FAILED%
+pause
+exit /b %FAILED%
\ No newline at end of file
@@ -0,0 +1,29 @@
+#version 450
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout(set = 0, binding = 0) uniform sampler2D source;
+layout(set = 0, binding = 1, r32f) uniform writeonly image2D destination;
+
+layout(push_constant) uniform PushData
+{
+    ivec2 sourceSize;
+    ivec2 destinationSize;
+};
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(texel, destinationSize)))
+        return;
+
+    // Farthest of the 2x2 source texels. The destination is half the source rounded up, the last row and column of an odd
+    // source are clamped so they only cover the texels which exist.
+    ivec2 first = texel * 2;
+    ivec2 last = min(first + 1, sourceSize - 1);
+    float d00 = texelFetch(source, first, 0).r;
+    float d10 = texelFetch(source, ivec2(last.x, first.y), 0).r;
+    float d01 = texelFetch(source, ivec2(first.x, last.y), 0).r;
+    float d11 = texelFetch(source, last, 0).r;
+    imageStore(destination, texel, vec4(max(max(d00, d10), max(d01, d11))));
+}
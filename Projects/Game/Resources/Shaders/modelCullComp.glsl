@@ -0,0 +1,150 @@
+#version 450
+
+layout (local_size_x = 64, local_size_y = 1) in;
+
+struct Group
+{
+    vec4 sphere;            // Bounding sphere of the model in model space, the radius is in w.
+    vec4 boxMin;            // Bounding box of the model in model space.
+    vec4 boxMax;
+    uint firstInstance;
+    uint instanceCount;
+    uint pad0;
+    uint pad1;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer Transforms
+{
+    mat4 transforms[];
+};
+
+layout(set = 0, binding = 1, std430) readonly buffer InstanceGroups
+{
+    uint instanceGroups[];
+};
+
+layout(set = 0, binding = 2, std430) readonly buffer Groups
+{
+    Group groups[];
+};
+
+layout(set = 0, binding = 4, std430) buffer VisibleCounts
+{
+    uint visibleCounts[];
+};
+
+layout(set = 0, binding = 6, std430) writeonly buffer CulledTransforms
+{
+    mat4 culledTransforms[];
+};
+
+layout(push_constant) uniform PushData
+{
+    vec4 planes[6];         // Normal (Pointing inwards) in xyz and distance in w.
+    uint instanceBase;
+    uint instanceCount;
+    uint commandBase;
+    uint commandCount;
+    uint occlusionIndex;
+};
+
+#ifdef OCCLUSION
+struct Occlusion
+{
+    mat4 viewProjection;    // View projection of the frame the depth pyramid was built from.
+    vec4 pyramid;           // Width and height of the depth buffer in xy, number of levels in z.
+    uint testedCount;
+    uint occludedCount;
+    uint pad0;
+    uint pad1;
+};
+
+// Every texel of level L holds the farthest depth of the 2 << L pixels below it.
+layout(set = 1, binding = 0) uniform sampler2D depthPyramid;
+
+layout(set = 1, binding = 1, std430) buffer Occlusions
+{
+    Occlusion occlusions[];
+};
+
+// True if the box is behind the depth of the pyramid. Boxes which cross the near plane or the edge of the screen are kept, the
+// pyramid knows nothing about what is outside of it.
+bool isOccluded(mat4 m, vec3 boxMin, vec3 boxMax, Occlusion occlusion)
+{
+    mat4 mvp = occlusion.viewProjection * m;
+    vec3 ndcMin = vec3(1.0);
+    vec3 ndcMax = vec3(-1.0);
+    for (uint i = 0; i < 8; i++)
+    {
+        vec3 corner = vec3((i & 1) == 0 ? boxMin.x : boxMax.x, (i & 2) == 0 ? boxMin.y : boxMax.y, (i & 4) == 0 ? boxMin.z : boxMax.z);
+        vec4 clip = mvp * vec4(corner, 1.0);
+        if (clip.w <= 0.0)
+            return false;
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc);
+        ndcMax = max(ndcMax, ndc);
+    }
+    if (ndcMin.z <= 0.0 || any(lessThan(ndcMin.xy, vec2(-1.0))) || any(greaterThan(ndcMax.xy, vec2(1.0))))
+        return false;
+
+    // Pick the level where the rectangle covers at most 2x2 texels.
+    ivec2 size = ivec2(occlusion.pyramid.xy);
+    ivec2 pixelMin = clamp(ivec2((ndcMin.xy * 0.5 + 0.5) * vec2(size)), ivec2(0), size - 1);
+    ivec2 pixelMax = clamp(ivec2((ndcMax.xy * 0.5 + 0.5) * vec2(size)), ivec2(0), size - 1);
+    int extent = max(max(pixelMax.x - pixelMin.x, pixelMax.y - pixelMin.y), 1);
+    int level = clamp(int(ceil(log2(float(extent)))) - 1, 0, int(occlusion.pyramid.z) - 1);
+
+    ivec2 last = textureSize(depthPyramid, level) - 1;
+    ivec2 texelMin = min(pixelMin >> (level + 1), last);
+    ivec2 texelMax = min(pixelMax >> (level + 1), last);
+    float d00 = texelFetch(depthPyramid, texelMin, level).r;
+    float d10 = texelFetch(depthPyramid, ivec2(texelMax.x, texelMin.y), level).r;
+    float d01 = texelFetch(depthPyramid, ivec2(texelMin.x, texelMax.y), level).r;
+    float d11 = texelFetch(depthPyramid, texelMax, level).r;
+    return ndcMin.z > max(max(d00, d10), max(d01, d11));
+}
+#endif
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= instanceCount)
+        return;
+
+    uint instance = instanceBase + id;
+    uint groupIndex = instanceGroups[instance];
+    if (groupIndex == 0xFFFFFFFF)
+        return;
+
+    Group group = groups[groupIndex];
+    mat4 m = transforms[instance];
+
+    // Same test as the FrustumCuller, the radius is scaled by the largest axis.
+    vec3 center = (m * vec4(group.sphere.xyz, 1.0)).xyz;
+    float scaleSq = max(dot(m[0].xyz, m[0].xyz), max(dot(m[1].xyz, m[1].xyz), dot(m[2].xyz, m[2].xyz)));
+    float radius = group.sphere.w * sqrt(scaleSq);
+
+    bool inside = true;
+    for (uint i = 0; i < 6; i++)
+        inside = inside && (dot(planes[i].xyz, center) + planes[i].w > -radius);
+
+#ifdef OCCLUSION
+    if (inside)
+    {
+        Occlusion occlusion = occlusions[occlusionIndex];
+        atomicAdd(occlusions[occlusionIndex].testedCount, 1);
+        if (isOccluded(m, group.boxMin.xyz, group.boxMax.xyz, occlusion))
+        {
+            atomicAdd(occlusions[occlusionIndex].occludedCount, 1);
+            inside = false;
+        }
+    }
+#endif
+
+    // Visible instances are packed at the start of the range of their group.
+    if (inside)
+    {
+        uint slot = atomicAdd(visibleCounts[groupIndex], 1);
+        culledTransforms[group.firstInstance + slot] = m;
+    }
+}
@@ -0,0 +1,94 @@
+#version 450
+
+layout (local_size_x = 64, local_size_y = 1) in;
+
+struct Group
+{
+    vec4 sphere;
+    vec4 boxMin;
+    vec4 boxMax;
+    uint firstInstance;
+    uint instanceCount;
+    uint pad0;
+    uint pad1;
+};
+
+struct Command
+{
+    uint count;             // Index count or vertex count.
+    uint first;             // First index or first vertex.
+    uint vertexOffset;      // Only used by indexed draws.
+    uint group;
+    uint indexed;
+    uint batch;             // Index of the draw count of the batch.
+    uint batchFirst;        // First command of the batch.
+    uint pad;
+};
+
+layout(set = 0, binding = 2, std430) readonly buffer Groups
+{
+    Group groups[];
+};
+
+layout(set = 0, binding = 3, std430) readonly buffer Commands
+{
+    Command commands[];
+};
+
+layout(set = 0, binding = 4, std430) readonly buffer VisibleCounts
+{
+    uint visibleCounts[];
+};
+
+// Five uints for each command, a VkDrawIndexedIndirectCommand or a VkDrawIndirectCommand followed by padding.
+layout(set = 0, binding = 5, std430) writeonly buffer IndirectDraws
+{
+    uint indirectDraws[];
+};
+
+// Number of visible commands of each batch, used as the draw count of the indirect count draws.
+layout(set = 0, binding = 7, std430) buffer DrawCounts
+{
+    uint drawCounts[];
+};
+
+layout(push_constant) uniform PushData
+{
+    vec4 planes[6];
+    uint instanceBase;
+    uint instanceCount;
+    uint commandBase;
+    uint commandCount;
+    uint occlusionIndex;
+};
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= commandCount)
+        return;
+
+    uint index = commandBase + id;
+    Command command = commands[index];
+    uint visibleCount = visibleCounts[command.group];
+    if (visibleCount == 0)
+        return;
+    uint firstInstance = groups[command.group].firstInstance;
+
+    // Commands without visible instances are skipped, the visible ones are packed at the start of their batch.
+    uint slot = atomicAdd(drawCounts[command.batch], 1);
+    uint offset = (command.batchFirst + slot) * 5;
+    indirectDraws[offset + 0] = command.count;
+    indirectDraws[offset + 1] = visibleCount;
+    indirectDraws[offset + 2] = command.first;
+    if (command.indexed != 0)
+    {
+        indirectDraws[offset + 3] = command.vertexOffset;
+        indirectDraws[offset + 4] = firstInstance;
+    }
+    else
+    {
+        indirectDraws[offset + 3] = firstInstance;
+        indirectDraws[offset + 4] = 0;
+    }
+}
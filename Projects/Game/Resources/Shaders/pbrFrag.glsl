@@ -1,5 +1,8 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
 
 layout(location = 0) in vec3 fragNormal;
 layout(location = 1) in vec2 fragUv;
@@ -10,17 +13,82 @@ layout(location = 5) in float fragScreenGamma;
 
 layout(location = 0) out vec4 outColor;
 
+#ifdef BINDLESS
+// All materials are in one buffer and all textures in one array, see MaterialTable.h. The material is selected by the push constant.
+struct MaterialData
+{
+    vec4 baseColorFactor;
+    vec4 emissiveFactor;
+    float metallicFactor;
+    float roughnessFactor;
+    int baseColorTextureCoord;
+    int metallicRoughnessTextureCoord;
+    int normalTextureCoord;
+    int occlusionTextureCoord;
+    int emissiveTextureCoord;
+    int padding;
+    uint textures[5];
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+layout(set=2, binding=0, std430) readonly buffer Materials
+{
+    MaterialData materials[];
+};
+layout(set=2, binding=1) uniform sampler2D textures[];
+
+layout(push_constant) uniform PushConstantsFrag
+{
+    uint materialIndex;
+};
+
+// The rest of the shader uses the same names as with material descriptor sets.
+#define baseColorFactor materials[materialIndex].baseColorFactor
+#define emissiveFactor materials[materialIndex].emissiveFactor
+#define metallicFactor materials[materialIndex].metallicFactor
+#define roughnessFactor materials[materialIndex].roughnessFactor
+#define baseColorTextureCoord materials[materialIndex].baseColorTextureCoord
+#define metallicRoughnessTextureCoord materials[materialIndex].metallicRoughnessTextureCoord
+#define normalTextureCoord materials[materialIndex].normalTextureCoord
+#define occlusionTextureCoord materials[materialIndex].occlusionTextureCoord
+#define emissiveTextureCoord materials[materialIndex].emissiveTextureCoord
+#define baseColorTexture textures[nonuniformEXT(materials[materialIndex].textures[0])]
+#define metallicRoughnessTexture textures[nonuniformEXT(materials[materialIndex].textures[1])]
+#define normalTexture textures[nonuniformEXT(materials[materialIndex].textures[2])]
+#define occlusionTexture textures[nonuniformEXT(materials[materialIndex].textures[3])]
+#define emissiveTexture textures[nonuniformEXT(materials[materialIndex].textures[4])]
+#else
 layout(set=2, binding=0) uniform sampler2D baseColorTexture;
 layout(set=2, binding=1) uniform sampler2D metallicRoughnessTexture;
 layout(set=2, binding=2) uniform sampler2D normalTexture;
 layout(set=2, binding=3) uniform sampler2D occlusionTexture;
 layout(set=2, binding=4) uniform sampler2D emissiveTexture;
+#endif
 
+#ifdef SH_IRRADIANCE
+// The irradiance is evaluated from the spherical harmonics in the scene data, there is no irradiance map.
+layout(set=0, binding = 0) uniform SceneData
+{
+    mat4 proj;
+    mat4 view;
+    vec4 cPos;
+    vec4 screenData;
+    vec4 irradianceSH[9];
+} scene;
+
+layout(set=4, binding=0) uniform samplerCube environmentMap;
+layout(set=4, binding=1) uniform samplerCube prefilteredEnvMap;
+layout(set=4, binding=2) uniform sampler2D brdfLutTexture;
+#else
 layout(set=4, binding=0) uniform samplerCube environmentMap;
 layout(set=4, binding=1) uniform samplerCube irradianceMap;
 layout(set=4, binding=2) uniform samplerCube prefilteredEnvMap;
 layout(set=4, binding=3) uniform sampler2D brdfLutTexture;
+#endif
 
+#ifndef BINDLESS
 layout(push_constant) uniform PushConstantsFrag
 {
     vec4 baseColorFactor;
@@ -34,6 +102,7 @@ layout(push_constant) uniform PushConstantsFrag
 	int emissiveTextureCoord;
     int padding;
 };
+#endif
 
 const float PI = 3.14159265359;
 const float MIN_ROUGHNESS = 0.04;
@@ -45,6 +114,7 @@ vec4 SRGBtoLINEAR(vec4 color);
 vec3 getNormal();
 vec4 getSurfaceColor(vec2 uv);
 vec2 getMetallicAndRoughness(vec2 uv);
+vec3 getIrradiance(vec3 N);
 
 vec3 Uncharted2Tonemap(vec3 color)
 {
@@ -201,7 +271,7 @@ void main() {
     vec3 Kd = 1.0 - Ks;
     Kd *= 1.0 - metallic;
 
-    vec3 irradiance = texture(irradianceMap, N).rgb;
+    vec3 irradiance = getIrradiance(N);
     vec3 diffuse = irradiance * diffuseAlbedo;
 
     float envMapDim = float(textureSize(prefilteredEnvMap, 0).x);
@@ -286,4 +356,23 @@ vec2 getMetallicAndRoughness(vec2 uv)
 	}
 
     return vec2(metallic, roughness);
-}
\ No newline at end of file
+}
+
+vec3 getIrradiance(vec3 N)
+{
+#ifdef SH_IRRADIANCE
+    // The coefficients are already convolved with the cosine lobe, see SphericalHarmonics.h.
+    vec3 irradiance = scene.irradianceSH[0].rgb * 0.282095
+        + scene.irradianceSH[1].rgb * (0.488603 * N.y)
+        + scene.irradianceSH[2].rgb * (0.488603 * N.z)
+        + scene.irradianceSH[3].rgb * (0.488603 * N.x)
+        + scene.irradianceSH[4].rgb * (1.092548 * N.x * N.y)
+        + scene.irradianceSH[5].rgb * (1.092548 * N.y * N.z)
+        + scene.irradianceSH[6].rgb * (0.315392 * (3.0 * N.z * N.z - 1.0))
+        + scene.irradianceSH[7].rgb * (1.092548 * N.x * N.z)
+        + scene.irradianceSH[8].rgb * (0.546274 * (N.x * N.x - N.y * N.y));
+    return max(irradiance, vec3(0.0));
+#else
+    return texture(irradianceMap, N).rgb;
+#endif
+}
@@ -1,9 +1,16 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+#ifdef PACKED_VERTICES
+// Unorm position and texture coordinates relative to the bounds of the model, octahedral normal.
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec2 normal;
+layout(location = 2) in vec2 texCoords;
+#else
 layout(location = 0) in vec4 position;
 layout(location = 1) in vec4 normal;
 layout(location = 2) in vec4 texCoords;
+#endif
 
 layout(set=0, binding = 0) uniform SceneData
 {
@@ -16,6 +23,9 @@ layout(set=0, binding = 0) uniform SceneData
 layout(set=1, binding=0) uniform NodeData
 {
     mat4 transform;
+    vec4 positionOffset;
+    vec4 positionScale;
+    vec4 uvTransform; // xy: offset, zw: scale
 } node;
 
 layout(set=3, binding = 0) readonly buffer TransformData
@@ -30,12 +40,32 @@ layout(location = 3) out vec3 camPos;
 layout(location = 4) out float fragScreenExposure;
 layout(location = 5) out float fragScreenGamma;
 
+#ifdef PACKED_VERTICES
+vec3 octDecode(vec2 oct)
+{
+    vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+#endif
+
 void main() {
-    vec4 worldPosition = modelTransform[gl_InstanceIndex] * node.transform * vec4(position.xyz, 1.0);
+#ifdef PACKED_VERTICES
+    vec3 localPosition = node.positionOffset.xyz + position.xyz * node.positionScale.xyz;
+    vec3 localNormal = octDecode(normal);
+    vec2 uv = node.uvTransform.xy + texCoords * node.uvTransform.zw;
+#else
+    vec3 localPosition = position.xyz;
+    vec3 localNormal = normal.xyz;
+    vec2 uv = texCoords.xy;
+#endif
+    vec4 worldPosition = modelTransform[gl_InstanceIndex] * node.transform * vec4(localPosition, 1.0);
     fragPos = worldPosition.xyz;
     gl_Position = scene.proj * scene.view * worldPosition;
-    fragNormal = normalize((modelTransform[gl_InstanceIndex] * node.transform * vec4(normal.xyz, 0.0)).xyz);
-    fragUv = texCoords.xy;
+    fragNormal = normalize((modelTransform[gl_InstanceIndex] * node.transform * vec4(localNormal, 0.0)).xyz);
+    fragUv = uv;
     camPos = scene.cPos.xyz;
 
     fragScreenExposure = scene.screenData.x;
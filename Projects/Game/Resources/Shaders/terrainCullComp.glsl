@@ -0,0 +1,90 @@
+#version 450
+
+layout (local_size_x = 64, local_size_y = 1) in;
+
+// Same layout as Node in terrainVert.glsl.
+struct Node
+{
+    vec4 node;
+    vec4 morph;
+    vec4 tile;
+};
+
+// A whole node or one of its quarters which is drawn if its bounds are in the frustum.
+struct Candidate
+{
+    Node node;
+    vec4 boundsMin;         // In the space of the terrain.
+    vec4 boundsMax;
+    uint view;
+    uint command;
+    uint pad0;
+    uint pad1;
+};
+
+// Frustum of a drawn terrain, in the space of the terrain.
+struct View
+{
+    vec4 planes[6];         // Normal (Pointing inwards) in xyz and distance in w.
+};
+
+// Matches VkDrawIndexedIndirectCommand.
+struct DrawCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer Candidates
+{
+    Candidate candidates[];
+};
+
+layout(set = 0, binding = 1, std430) readonly buffer Views
+{
+    View views[];
+};
+
+layout(set = 0, binding = 2, std430) buffer DrawCommands
+{
+    DrawCommand commands[];
+};
+
+layout(set = 0, binding = 3, std430) writeonly buffer Nodes
+{
+    Node nodes[];
+};
+
+layout(push_constant) uniform PushData
+{
+    uint candidateBase;
+    uint candidateCount;
+};
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= candidateCount)
+        return;
+
+    Candidate candidate = candidates[candidateBase + id];
+    View view = views[candidate.view];
+
+    // Same test as Terrain::isInFrustum, the box is outside if its corner furthest along the normal is behind any plane.
+    bool inside = true;
+    for (uint i = 0; i < 6; i++)
+    {
+        vec3 p = mix(candidate.boundsMin.xyz, candidate.boundsMax.xyz, greaterThanEqual(view.planes[i].xyz, vec3(0.0)));
+        inside = inside && (dot(view.planes[i].xyz, p) + view.planes[i].w >= 0.0);
+    }
+
+    // Visible nodes are packed at the start of the instances of their draw.
+    if (inside)
+    {
+        uint slot = atomicAdd(commands[candidate.command].instanceCount, 1);
+        nodes[commands[candidate.command].firstInstance + slot] = candidate.node;
+    }
+}
@@ -0,0 +1,20 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec3 fragPos;
+layout(location = 2) in float fragHeight;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec3 lightDir = normalize(vec3(0.5, 2.0, 0.5));
+    vec3 n = normalize(fragNormal);
+    float diffuse = max(dot(lightDir, n), 0.0) * 0.8 + 0.2;
+
+    // Lowlands are green, steep slopes are rock and the highest parts are snow.
+    vec3 baseColor = mix(vec3(0.25, 0.4, 0.15), vec3(0.45, 0.38, 0.3), smoothstep(0.2, 0.6, fragHeight));
+    baseColor = mix(baseColor, vec3(0.4, 0.37, 0.35), smoothstep(0.6, 0.9, 1.0 - n.y));
+    baseColor = mix(baseColor, vec3(0.95), smoothstep(0.8, 0.95, fragHeight));
+    outColor = vec4(baseColor * diffuse, 1.0);
+}
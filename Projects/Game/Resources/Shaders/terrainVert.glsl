@@ -1,37 +1,87 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(location = 0) in vec4 position;
-layout(location = 1) in vec4 normal;
-layout(location = 2) in vec4 texCoords;
+#define PATCH_SIZE 32 // Needs to match TERRAIN_PATCH_SIZE.
+#define TILE_SIZE 256 // Needs to match TERRAIN_TILE_SIZE.
+
+// The patch has no vertex buffer, the grid position is taken from the vertex index.
+struct Node
+{
+    vec4 node;  // xy: first sample, z: samples between vertices.
+    vec4 morph; // x: distance where the morph starts, y: distance where the vertices are on the grid of the next level.
+    vec4 tile;  // xy: first sample of the tile, z: samples between texels, w: layer.
+};
 
 layout(set=0, binding = 0) uniform SceneData
 {
     mat4 proj;
     mat4 view;
     vec4 cPos;
+    vec4 screenData;
 } scene;
 
-layout(set=1, binding = 0) readonly buffer TransformData
+layout(set=1, binding = 0, std430) readonly buffer Nodes
 {
-    mat4 modelTransform[];
+    Node nodes[];
 };
 
-layout(set = 1, binding = 0) uniform TerrainData
+// Heights are 16 bit unsigned integers, one layer for each tile.
+layout(set=2, binding = 0) uniform usampler2DArray heights;
+
+layout(push_constant) uniform PushData
 {
     mat4 transform;
-};
+    vec4 terrain;       // x: distance between samples, y: lowest height, z: height range.
+    vec4 originExtent;  // xy: origin, zw: last sample.
+    vec4 camera;        // Camera position in the space of the terrain.
+} push;
 
 layout(location = 0) out vec3 fragNormal;
-layout(location = 1) out vec2 fragUv;
-layout(location = 2) out vec3 fragPos;
-layout(location = 3) out vec3 camPos;
+layout(location = 1) out vec3 fragPos;
+layout(location = 2) out float fragHeight;
+
+// Height at a position in samples, filtered manually since the tile is sampled with texelFetch.
+float getHeight(vec4 tile, vec2 samplePos)
+{
+    vec2 texel = clamp((samplePos - tile.xy) / tile.z, vec2(0.0), vec2(TILE_SIZE));
+    ivec2 i = min(ivec2(texel), ivec2(TILE_SIZE - 1));
+    vec2 f = texel - vec2(i);
+    int layer = int(tile.w);
+    float h00 = float(texelFetch(heights, ivec3(i.x, i.y, layer), 0).r);
+    float h10 = float(texelFetch(heights, ivec3(i.x + 1, i.y, layer), 0).r);
+    float h01 = float(texelFetch(heights, ivec3(i.x, i.y + 1, layer), 0).r);
+    float h11 = float(texelFetch(heights, ivec3(i.x + 1, i.y + 1, layer), 0).r);
+    return mix(mix(h00, h10, f.x), mix(h01, h11, f.x), f.y) / 65535.0;
+}
+
+vec3 getPosition(vec4 tile, vec2 samplePos)
+{
+    samplePos = clamp(samplePos, vec2(0.0), push.originExtent.zw);
+    float h = push.terrain.y + getHeight(tile, samplePos) * push.terrain.z;
+    return vec3(push.originExtent.x + samplePos.x * push.terrain.x, h, push.originExtent.y + samplePos.y * push.terrain.x);
+}
 
 void main() {
-    vec4 worldPosition = transform * vec4(position.xyz, 1.0);
+    Node node = nodes[gl_InstanceIndex];
+    vec2 grid = vec2(gl_VertexIndex % (PATCH_SIZE + 1), gl_VertexIndex / (PATCH_SIZE + 1));
+    float spacing = node.node.z;
+
+    // Move the odd vertices onto the grid of the next level as the distance to the camera reaches the end of the range.
+    vec3 position = getPosition(node.tile, node.node.xy + grid * spacing);
+    float k = clamp((distance(position, push.camera.xyz) - node.morph.x) / (node.morph.y - node.morph.x), 0.0, 1.0);
+    vec2 samplePos = node.node.xy + (grid - fract(grid * 0.5) * 2.0 * k) * spacing;
+    position = getPosition(node.tile, samplePos);
+
+    // Normal from the neighbours at the spacing of the level.
+    float hl = getPosition(node.tile, samplePos - vec2(spacing, 0.0)).y;
+    float hr = getPosition(node.tile, samplePos + vec2(spacing, 0.0)).y;
+    float hd = getPosition(node.tile, samplePos - vec2(0.0, spacing)).y;
+    float hu = getPosition(node.tile, samplePos + vec2(0.0, spacing)).y;
+    vec3 normal = vec3(hl - hr, 2.0 * spacing * push.terrain.x, hd - hu);
+
+    vec4 worldPosition = push.transform * vec4(position, 1.0);
     fragPos = worldPosition.xyz;
+    fragNormal = normalize(mat3(push.transform) * normal);
+    fragHeight = (position.y - push.terrain.y) / max(push.terrain.z, 0.0001);
     gl_Position = scene.proj * scene.view * worldPosition;
-    fragNormal = normalize((transform * vec4(normal.xyz, 0.0)).xyz);
-    fragUv = texCoords.xy;
-    camPos = scene.cPos.xyz;
-}
\ No newline at end of file
+}
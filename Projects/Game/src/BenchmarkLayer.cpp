@@ -0,0 +1,181 @@
+#include "BenchmarkLayer.h"
+
+#include "Engine/Core/Graphics/Renderer.h"
+#include "Engine/Core/Display/Display.h"
+#include "Engine/Core/Scene/ObjectManager.h"
+#include "Engine/Core/Scene/GLTFLoader.h"
+
+#include "Benchmarks/JobSystemBenchmark.h"
+#include "Benchmarks/ModelLoadingBenchmark.h"
+#include "Benchmarks/ModelCacheBenchmark.h"
+#include "Benchmarks/AudioMixerBenchmark.h"
+#include "Benchmarks/AudioFilterBenchmark.h"
+#include "Benchmarks/EcsBenchmark.h"
+#include "Benchmarks/IBLBenchmark.h"
+#include "Benchmarks/SHIrradianceBenchmark.h"
+#include "Benchmarks/FrustumCullingBenchmark.h"
+#include "Benchmarks/GpuCullingBenchmark.h"
+#include "Benchmarks/OcclusionCullingBenchmark.h"
+#include "Benchmarks/GeometryArenaBenchmark.h"
+#include "Benchmarks/MemoryAllocatorBenchmark.h"
+#include "Benchmarks/VertexFormatBenchmark.h"
+#include "Benchmarks/MeshOptimizerBenchmark.h"
+#include "Benchmarks/LodBenchmark.h"
+#include "Benchmarks/TerrainBenchmark.h"
+#include "Benchmarks/TerrainQueryBenchmark.h"
+
+void BenchmarkLayer::onStart(ym::Renderer* renderer)
+{
+	float aspect = ym::Display::get()->getAspectRatio();
+	this->camera.init(aspect, 45.f, { 0.f, 2, 0.f }, { 0.f, 2, 1.f }, 1.0f, 10.0f);
+	renderer->setActiveCamera(&this->camera);
+
+	this->environmentMap = renderer->getDefaultEnvironmentMap();
+	this->bindlessMaterials = renderer->isBindlessMaterials();
+	ym::GLTFLoader::loadOnThread(YM_ASSETS_FILE_PATH + "Models/Cube/Cube.gltf", &this->cubeModel);
+
+	runBenchmarks();
+}
+
+void BenchmarkLayer::onUpdate(float dt)
+{
+	this->frameStart = std::chrono::high_resolution_clock::now();
+
+	ym::Input* input = ym::Input::get();
+	if (input->getKeyState(ym::Key::B) == ym::KeyState::FIRST_RELEASED)
+		runBenchmarks();
+
+	// Start the frame based benchmarks when their assets have loaded.
+	if (this->spawnBenchmarkPending && this->cubeModel.hasLoaded)
+	{
+		this->spawnBenchmark.start(&this->cubeModel, 2000, 600);
+		this->spawnBenchmarkPending = false;
+	}
+	if (this->spawnBenchmark.isRunning())
+	{
+		this->spawnBenchmark.update(this->frameMs);
+		if (this->spawnBenchmark.isRunning() == false)
+			logResult(this->spawnBenchmark.getResult());
+	}
+
+	// The streaming benchmark runs after the spawn benchmark to not measure both at once.
+	if (this->streamingBenchmarkPending && this->spawnBenchmarkPending == false && this->spawnBenchmark.isRunning() == false)
+	{
+		this->streamingBenchmark.start({ YM_ASSETS_FILE_PATH + "Models/FlightHelmet/FlightHelmet.gltf", YM_ASSETS_FILE_PATH + "Models/Sponza/glTF/Sponza.gltf" }, 120, this->bindlessMaterials);
+		this->streamingBenchmarkPending = false;
+	}
+	if (this->streamingBenchmark.isRunning())
+	{
+		this->streamingBenchmark.update(this->frameMs, this->descriptorWrites);
+		if (this->streamingBenchmark.isRunning() == false)
+			logResult(this->streamingBenchmark.getResult());
+	}
+
+	// Quit if ESCAPE is pressed.
+	if (input->isKeyPressed(ym::Key::ESCAPE))
+		this->terminate();
+}
+
+void BenchmarkLayer::onRender(ym::Renderer* renderer)
+{
+	renderer->begin();
+
+	{
+		static bool active = true;
+		ImGui::Begin("Benchmarks", &active);
+		for (BenchmarkResult& result : this->results)
+		{
+			if (ImGui::CollapsingHeader(result.name.c_str(), ImGuiTreeNodeFlags_DefaultOpen))
+			{
+				for (std::string& line : result.lines)
+					ImGui::TextUnformatted(line.c_str());
+				for (std::string& failure : result.failures)
+					ImGui::TextColored(ImVec4(1.f, 0.3f, 0.3f, 1.f), "FAILED: %s", failure.c_str());
+			}
+		}
+
+		BenchmarkResult spawnResult = this->spawnBenchmark.getResult();
+		if (ImGui::CollapsingHeader(spawnResult.name.c_str(), ImGuiTreeNodeFlags_DefaultOpen))
+		{
+			for (std::string& line : spawnResult.lines)
+				ImGui::TextUnformatted(line.c_str());
+		}
+
+		BenchmarkResult streamingResult = this->streamingBenchmark.getResult();
+		if (ImGui::CollapsingHeader(streamingResult.name.c_str(), ImGuiTreeNodeFlags_DefaultOpen))
+		{
+			for (std::string& line : streamingResult.lines)
+				ImGui::TextUnformatted(line.c_str());
+			const std::vector<float>& frameTimes = this->streamingBenchmark.getFrameTimes();
+			if (frameTimes.empty() == false)
+				ImGui::PlotHistogram("CPU frame time (ms)", frameTimes.data(), (int)frameTimes.size(), 0, nullptr, 0.f, 33.f, ImVec2(0.f, 80.f));
+		}
+		ImGui::End();
+	}
+
+	renderer->drawSkybox(this->environmentMap);
+	renderer->drawAllModels(ym::ObjectManager::get());
+	for (ym::Model* model : this->streamingBenchmark.getLoadedModels())
+		renderer->drawModel(model, glm::mat4(1.f));
+
+	renderer->end();
+	this->descriptorWrites = renderer->getDescriptorWriteCount();
+
+	// CPU time of the frame, from the start of the update until all work has been submitted.
+	auto frameEnd = std::chrono::high_resolution_clock::now();
+	this->frameMs = std::chrono::duration<double, std::milli>(frameEnd - this->frameStart).count();
+}
+
+void BenchmarkLayer::onRenderImGui()
+{
+}
+
+void BenchmarkLayer::onQuit()
+{
+	this->spawnBenchmark.stop();
+	this->streamingBenchmark.stop();
+	this->cubeModel.destroy();
+	this->camera.destroy();
+}
+
+void BenchmarkLayer::runBenchmarks()
+{
+	this->results.clear();
+	this->results.push_back(runJobSystemBenchmark());
+	this->results.push_back(runModelLoadingBenchmark());
+	this->results.push_back(runModelCacheBenchmark());
+	this->results.push_back(runAudioMixerBenchmark());
+	this->results.push_back(runAudioFilterBenchmark());
+	this->results.push_back(runEcsBenchmark());
+	this->results.push_back(runIBLBenchmark());
+	this->results.push_back(runSHIrradianceBenchmark());
+	this->results.push_back(runFrustumCullingBenchmark());
+	this->results.push_back(runGpuCullingBenchmark());
+	this->results.push_back(runOcclusionCullingBenchmark());
+	this->results.push_back(runGeometryArenaBenchmark());
+	this->results.push_back(runMemoryAllocatorBenchmark());
+	this->results.push_back(runVertexFormatBenchmark());
+	this->results.push_back(runMeshOptimizerBenchmark());
+	this->results.push_back(runLodBenchmark());
+	this->results.push_back(runTerrainBenchmark());
+	this->results.push_back(runTerrainQueryBenchmark());
+
+	for (BenchmarkResult& result : this->results)
+		logResult(result);
+
+	this->spawnBenchmark.stop();
+	this->spawnBenchmarkPending = true;
+
+	// Models which are still streaming cannot be reloaded.
+	if (this->streamingBenchmark.isRunning() == false)
+		this->streamingBenchmarkPending = true;
+}
+
+void BenchmarkLayer::logResult(const BenchmarkResult& result)
+{
+	YM_LOG_INFO("[Benchmark] {}", result.name.c_str());
+	for (const std::string& line : result.lines)
+		YM_LOG_INFO("  {}", line.c_str());
+	for (const std::string& failure : result.failures)
+		YM_LOG_ERROR("  FAILED: {}", failure.c_str());
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Engine/Core/Application/Layer.h"
+#include "Engine/Core/Camera.h"
+#include "Engine/Core/Vulkan/Texture.h"
+#include "Engine/Core/Scene/Model/Model.h"
+
+#include "Benchmarks/Benchmark.h"
+#include "Benchmarks/SpawnBenchmark.h"
+#include "Benchmarks/StreamingBenchmark.h"
+
+/*
+	Runs the engine benchmarks when started and shows the results in a window. Press B to run them again.
+*/
+class BenchmarkLayer : public ym::Layer
+{
+public:
+
+	void onStart(ym::Renderer* renderer) override;
+	void onUpdate(float dt) override;
+	void onRender(ym::Renderer* renderer) override;
+	void onRenderImGui() override;
+	void onQuit() override;
+
+private:
+	void runBenchmarks();
+	void logResult(const BenchmarkResult& result);
+
+	ym::Camera camera;
+	ym::Texture* environmentMap;
+	ym::Model cubeModel;
+
+	std::vector<BenchmarkResult> results;
+
+	// Benchmarks which run over several frames.
+	SpawnBenchmark spawnBenchmark;
+	bool spawnBenchmarkPending{ false };
+	StreamingBenchmark streamingBenchmark;
+	bool streamingBenchmarkPending{ false };
+	std::chrono::high_resolution_clock::time_point frameStart;
+	double frameMs{ 0.0 };
+	uint32_t descriptorWrites{ 0 };
+	bool bindlessMaterials{ false };
+};
@@ -0,0 +1,207 @@
+#include "AudioFilterBenchmark.h"
+
+#include "Engine/Core/Audio/SoundData.h"
+#include "Engine/Core/Audio/Filters/DistanceFilter.h"
+#include "Engine/Core/Audio/Filters/EchoFilter.h"
+#include "Engine/Core/Audio/Filters/HighpassFilter.h"
+#include "Engine/Core/Audio/Filters/LowpassFilter.h"
+
+#include <glm/gtc/constants.hpp>
+#include <cmath>
+#include <memory>
+
+namespace
+{
+	const uint32_t SAMPLE_RATE = 44100;
+	const uint32_t SECONDS = 4;
+	const uint32_t BLOCK_FRAMES = 512;
+	const float ECHO_DELAY = 0.25f;
+	const float ECHO_GAIN = 0.5f;
+	const float TOLERANCE = 1e-5f;
+
+	/*
+		The filters as they were before they processed blocks, one virtual call per frame and the coefficients recomputed for
+		each frame.
+	*/
+	class ReferenceFilter
+	{
+	public:
+		virtual ~ReferenceFilter() {}
+		virtual std::pair<float, float> process(ym::SoundData* data, float left, float right) = 0;
+	};
+
+	class ReferenceOnePole : public ReferenceFilter
+	{
+	public:
+		ReferenceOnePole(bool lowpass) : lowpass(lowpass), cutoffFrequency(SAMPLE_RATE * 0.25f) {}
+
+		std::pair<float, float> process(ym::SoundData* data, float left, float right) override
+		{
+			constexpr float PI = glm::pi<float>();
+			const float fs = (float)SAMPLE_RATE;
+			float product = 2.f * PI * this->cutoffFrequency / fs;
+			float tmp = (2.f - glm::cos(product));
+			float b = this->lowpass ? glm::sqrt(tmp * tmp - 1.f) - 2.f + glm::cos(product) : 2.f - glm::cos(product) - glm::sqrt(tmp * tmp - 1.f);
+			float a = this->lowpass ? 1.f + b : 1.f - b;
+
+			float newLeft = a * left - b * this->previous[0];
+			float newRight = a * right - b * this->previous[1];
+			this->previous[0] = newLeft;
+			this->previous[1] = newRight;
+			return std::pair<float, float>(newLeft, newRight);
+		}
+
+	private:
+		bool lowpass;
+		float cutoffFrequency;
+		float previous[2]{ 0.f, 0.f };
+	};
+
+	class ReferenceEcho : public ReferenceFilter
+	{
+	public:
+		ReferenceEcho() : buffer((size_t)((uint64_t)((double)SAMPLE_RATE * (double)ECHO_DELAY) * 2), 0.f) {}
+
+		std::pair<float, float> process(ym::SoundData* data, float left, float right) override
+		{
+			float oldLeft = next(left);
+			float oldRight = next(right);
+			return std::pair<float, float>(oldLeft, oldRight);
+		}
+
+	private:
+		float next(float input)
+		{
+			float old = this->buffer[this->position];
+			this->buffer[this->position] = input + ECHO_GAIN * old;
+			this->position = (this->position + 1) % this->buffer.size();
+			return old;
+		}
+
+		std::vector<float> buffer;
+		size_t position{ 0 };
+	};
+
+	class ReferenceDistance : public ReferenceFilter
+	{
+	public:
+		std::pair<float, float> process(ym::SoundData* data, float left, float right) override
+		{
+			auto map = [](float x, float min, float max, float nMin, float nMax) {
+				return nMin + (x - min) * (nMax - nMin) / (max - min);
+			};
+
+			glm::vec3 receiverToSource = data->sourcePos - data->receiverPos;
+			float distance = glm::length(receiverToSource);
+			float attenuation = distance * distance;
+			attenuation = glm::min(attenuation <= 0.000001f ? 0.f : 1.f / attenuation, 1.f);
+
+			receiverToSource = glm::normalize(receiverToSource);
+			float cosAngle = glm::clamp(glm::dot(receiverToSource, data->receiverLeft), -1.f, 1.f);
+			float angle = glm::acos(cosAngle);
+
+			constexpr float pi = glm::pi<float>();
+			if (distance <= 0.000001f) angle = pi * .5f;
+			angle = map(angle, 0.f, pi, 0.f, pi * 0.5f);
+
+			float c = glm::cos(angle);
+			float s = glm::sin(angle);
+			return std::pair<float, float>(left * attenuation * c * c, right * attenuation * s * s);
+		}
+	};
+
+	std::vector<float> createInput()
+	{
+		// A tone with noise, different in each ear.
+		const uint32_t frames = SAMPLE_RATE * SECONDS;
+		std::vector<float> input(frames * 2);
+		uint32_t seed = 12345;
+		for (uint32_t i = 0; i < frames; i++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			float noise = ((float)(seed >> 8) / (float)(1 << 24) - 0.5f) * 0.2f;
+			float t = (float)i / (float)SAMPLE_RATE;
+			input[i * 2] = 0.5f * std::sin(2.f * 3.14159265f * 440.f * t) + noise;
+			input[i * 2 + 1] = 0.5f * std::sin(2.f * 3.14159265f * 660.f * t) - noise;
+		}
+		return input;
+	}
+
+	void run(BenchmarkResult& result, const std::string& name, ReferenceFilter* reference, ym::Filter* filter, const std::vector<float>& input, ym::SoundData& data)
+	{
+		const uint64_t frames = input.size() / 2;
+		std::vector<float> golden = input;
+		double referenceMs = measureMs([&]() {
+			for (uint64_t frame = 0; frame < frames; frame++)
+			{
+				auto res = reference->process(&data, golden[frame * 2], golden[frame * 2 + 1]);
+				golden[frame * 2] = res.first;
+				golden[frame * 2 + 1] = res.second;
+			}
+		});
+
+		std::vector<float> output = input;
+		filter->init(SAMPLE_RATE);
+		if (ym::EchoFilter* echo = dynamic_cast<ym::EchoFilter*>(filter))
+		{
+			echo->setDelay(ECHO_DELAY);
+			echo->setGain(ECHO_GAIN);
+			echo->init(SAMPLE_RATE);
+		}
+		double blockMs = measureMs([&]() {
+			for (uint64_t frame = 0; frame < frames; frame += BLOCK_FRAMES)
+				filter->process(&data, output.data() + frame * 2, std::min<uint64_t>(BLOCK_FRAMES, frames - frame));
+		});
+		filter->destroy();
+
+		float maxError = 0.f;
+		for (size_t i = 0; i < output.size(); i++)
+			maxError = std::max(maxError, std::abs(output[i] - golden[i]));
+
+		const double samples = (double)input.size();
+		char buf[256];
+		snprintf(buf, sizeof(buf), "%-10s per sample %7.2f ns/sample, block %7.2f ns/sample (%5.1fx), max error %.2e %s", name.c_str(),
+			referenceMs * 1e6 / samples, blockMs * 1e6 / samples, referenceMs / blockMs, maxError, maxError <= TOLERANCE ? "OK" : "MISMATCH");
+		result.lines.push_back(std::string(buf));
+		check(result, maxError <= TOLERANCE, name + " block output differs from the per sample reference");
+	}
+}
+
+BenchmarkResult runAudioFilterBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "Audio filters";
+
+	std::vector<float> input = createInput();
+	ym::SoundData data;
+	data.sourcePos = glm::vec3(1.f, 0.f, 1.f);
+	data.receiverPos = glm::vec3(0.f);
+	data.receiverLeft = glm::vec3(-1.f, 0.f, 0.f);
+	data.receiverUp = glm::vec3(0.f, 1.f, 0.f);
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%u s at %u Hz in blocks of %u frame(s), tolerance %.0e", SECONDS, SAMPLE_RATE, BLOCK_FRAMES, TOLERANCE);
+	result.lines.push_back(std::string(buf));
+
+	{
+		ReferenceOnePole reference(true);
+		ym::LowpassFilter filter;
+		run(result, "Lowpass", &reference, &filter, input, data);
+	}
+	{
+		ReferenceOnePole reference(false);
+		ym::HighpassFilter filter;
+		run(result, "Highpass", &reference, &filter, input, data);
+	}
+	{
+		ReferenceEcho reference;
+		ym::EchoFilter filter;
+		run(result, "Echo", &reference, &filter, input, data);
+	}
+	{
+		ReferenceDistance reference;
+		ym::DistanceFilter filter;
+		run(result, "Distance", &reference, &filter, input, data);
+	}
+	return result;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Runs each audio filter over a few seconds of generated audio and compares it with the per-sample implementation it replaced.
+	Reports ns/sample of both and the largest difference from the per-sample output, which is used as the golden output.
+*/
+BenchmarkResult runAudioFilterBenchmark();
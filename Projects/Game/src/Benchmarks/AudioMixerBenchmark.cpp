@@ -0,0 +1,105 @@
+#include "AudioMixerBenchmark.h"
+
+#include "Engine/Core/Audio/Mixer.h"
+#include "Engine/Core/Audio/Filters/DistanceFilter.h"
+#include "Engine/Core/Audio/Filters/LowpassFilter.h"
+
+#include <cmath>
+
+namespace
+{
+	const uint32_t TONE_SAMPLE_RATE = 48000;
+	const uint32_t RENDER_SECONDS = 2;
+
+	std::vector<float> createTone(uint32_t sampleRate)
+	{
+		// One second of a 440 Hz tone, in stereo.
+		std::vector<float> tone(sampleRate * 2);
+		for (uint32_t i = 0; i < sampleRate; i++)
+		{
+			float value = 0.25f * std::sin(2.f * 3.14159265f * 440.f * (float)i / (float)sampleRate);
+			tone[i * 2] = value;
+			tone[i * 2 + 1] = value;
+		}
+		return tone;
+	}
+
+	std::string run(uint32_t voiceCount, bool useFilters, std::vector<float>& mixerTone, std::vector<float>& otherTone)
+	{
+		ym::Mixer mixer;
+		mixer.init(nullptr);
+		mixer.setMaxVoices(voiceCount);
+
+		std::vector<ym::PCM::UserData*> voices(voiceCount);
+		for (uint32_t i = 0; i < voiceCount; i++)
+		{
+			std::vector<float>& tone = (i % 2 == 0) ? mixerTone : otherTone;
+			ym::PCM::UserData* data = new ym::PCM::UserData();
+			data->handle.asEffect = true;
+			data->handle.directDataF32 = tone.data();
+			data->handle.totalFrameCount = tone.size() / 2;
+			data->handle.nChannels = 2;
+			data->handle.sampleRate = (i % 2 == 0) ? mixer.getSampleRate() : TONE_SAMPLE_RATE;
+			data->soundData.loop = true;
+			data->soundData.volume = 1.f / (float)voiceCount;
+			data->soundData.sourcePos = glm::vec3((float)i, 0.f, 1.f);
+			data->soundData.receiverPos = glm::vec3(0.f);
+			data->soundData.receiverLeft = glm::vec3(-1.f, 0.f, 0.f);
+			data->soundData.receiverUp = glm::vec3(0.f, 1.f, 0.f);
+			if (useFilters)
+			{
+				data->filters.push_back(new ym::DistanceFilter());
+				data->filters.push_back(new ym::LowpassFilter());
+				for (ym::Filter* filter : data->filters)
+					filter->init(data->handle.sampleRate);
+			}
+			voices[i] = data;
+			mixer.play(data, (i % 4 == 0) ? ym::Mixer::Bus::STREAMS : ym::Mixer::Bus::EFFECTS, 0);
+		}
+
+		// Render in the same block size as the mixer uses internally, like a device callback would.
+		std::vector<float> out(MIXER_FRAMES_PER_BLOCK * 2);
+		const uint64_t blocks = (uint64_t)mixer.getSampleRate() * RENDER_SECONDS / MIXER_FRAMES_PER_BLOCK;
+		for (uint64_t block = 0; block < blocks; block++)
+			mixer.render(out.data(), MIXER_FRAMES_PER_BLOCK);
+		ym::Mixer::RenderStats stats = mixer.getRenderStats();
+
+		mixer.destroy();
+		for (ym::PCM::UserData* data : voices)
+		{
+			for (ym::Filter* filter : data->filters)
+			{
+				filter->destroy();
+				delete filter;
+			}
+			delete data;
+		}
+
+		// Time which the callback has before the device runs out of samples.
+		const double budgetMs = 1000.0 * (double)MIXER_FRAMES_PER_BLOCK / (double)mixer.getSampleRate();
+		const double averageMs = stats.totalMs / (double)stats.calls;
+		char buf[256];
+		snprintf(buf, sizeof(buf), "%3u voice(s)%-10s %8.4f ms avg, %8.4f ms max per callback (%5.2f%% of %.1f ms)", voiceCount,
+			useFilters ? " filtered" : "", averageMs, stats.maxMs, 100.0 * averageMs / budgetMs, budgetMs);
+		return std::string(buf);
+	}
+}
+
+BenchmarkResult runAudioMixerBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "Audio mixer";
+
+	std::vector<float> mixerTone = createTone(MIXER_SAMPLE_RATE);
+	std::vector<float> otherTone = createTone(TONE_SAMPLE_RATE);
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%u frame(s) per callback at %u Hz, %u s rendered", MIXER_FRAMES_PER_BLOCK, MIXER_SAMPLE_RATE, RENDER_SECONDS);
+	result.lines.push_back(std::string(buf));
+
+	for (uint32_t voiceCount : { 8u, 64u, 256u })
+		result.lines.push_back(run(voiceCount, false, mixerTone, otherTone));
+	for (uint32_t voiceCount : { 8u, 64u, 256u })
+		result.lines.push_back(run(voiceCount, true, mixerTone, otherTone));
+	return result;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Renders the software mixer with the null backend for a number of voices and reports the time spent in each callback. The voices
+	play a generated tone, every other voice has a different sample rate than the mixer and is resampled.
+*/
+BenchmarkResult runAudioMixerBenchmark();
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+struct BenchmarkResult
+{
+	std::string name;
+	std::vector<std::string> lines;
+	std::vector<std::string> failures; // Checks against a reference which did not pass, the benchmark failed if there are any.
+};
+
+// Record a failure if the check did not pass.
+inline void check(BenchmarkResult& result, bool passed, const std::string& failure)
+{
+	if (passed == false)
+		result.failures.push_back(failure);
+}
+
+// Measure the wall time of a function in milliseconds.
+template<typename F>
+inline double measureMs(F&& func)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	func();
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
@@ -0,0 +1,178 @@
+#include "EcsBenchmark.h"
+
+#include "Engine/Core/Scene/ObjectManager.h"
+#include "Engine/Core/Scene/GameObject.h"
+#include "Engine/Core/ECS/Ecs.h"
+#include "Engine/Core/ECS/Components.h"
+#include "Engine/Core/Threading/JobSystem.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	const uint32_t MODEL_COUNT = 8;
+	const uint32_t FRAME_COUNT = 20;
+	const uint32_t ENTITY_COUNTS[] = { 10000, 100000 };
+
+	// Instance transforms per model, the same as the draw data of the model renderer. The vectors keep their memory between frames.
+	using DrawBatch = std::unordered_map<ym::Model*, std::vector<glm::mat4>>;
+
+	glm::mat4 createTransform(uint32_t i)
+	{
+		float x = (float)(i % 100) - 50.f;
+		float z = (float)(i / 100 % 100) - 50.f;
+		return glm::translate(glm::mat4(1.f), { x, 0.f, z });
+	}
+
+	void clearBatch(DrawBatch& batch)
+	{
+		for (auto& transforms : batch)
+			transforms.second.clear();
+	}
+
+	uint32_t countInstances(DrawBatch& batch)
+	{
+		uint32_t count = 0;
+		for (auto& transforms : batch)
+			count += (uint32_t)transforms.second.size();
+		return count;
+	}
+
+	void updateChunk(ym::Chunk& chunk, const glm::mat4& rotation)
+	{
+		ym::Transform* transforms = chunk.get<ym::Transform>();
+		for (uint32_t i = 0; i < chunk.getCount(); i++)
+			transforms[i].matrix = rotation * transforms[i].matrix;
+	}
+
+	class RotateSystem : public ym::System
+	{
+	public:
+		RotateSystem(const glm::mat4& rotation) : rotation(rotation)
+		{
+			this->query.withAll<ym::Transform>();
+			this->parallel = true;
+		}
+
+		void updateChunk(ym::Chunk& chunk, float dt) override
+		{
+			::updateChunk(chunk, this->rotation);
+		}
+
+	private:
+		glm::mat4 rotation;
+	};
+
+	std::string line(const std::string& name, double createMs, double updateMs, double gatherMs, uint32_t instances)
+	{
+		char buf[256];
+		snprintf(buf, sizeof(buf), "%-28s create %8.3f ms, update %7.3f ms, gather %7.3f ms per frame (%u instances)", name.c_str(),
+			createMs, updateMs / (double)FRAME_COUNT, gatherMs / (double)FRAME_COUNT, instances);
+		return std::string(buf);
+	}
+}
+
+BenchmarkResult runEcsBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "ECS";
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%u model(s), %u frame(s), %u worker(s)", MODEL_COUNT, FRAME_COUNT, ym::JobSystem::getWorkerCount());
+	result.lines.push_back(std::string(buf));
+
+	// The models are only used as keys.
+	ym::Model models[MODEL_COUNT];
+	const glm::mat4 rotation = glm::rotate(glm::mat4(1.f), 0.01f, { 0.f, 1.f, 0.f });
+
+	for (uint32_t entityCount : ENTITY_COUNTS)
+	{
+		// The entities are created one model at a time, as when a scene is loaded.
+		auto getModel = [&](uint32_t i) { return &models[i * MODEL_COUNT / entityCount]; };
+		DrawBatch batch;
+
+		// ObjectManager, the transforms are gathered the same way as Renderer::drawAllModels(ObjectManager*).
+		{
+			ym::ObjectManager objectManager;
+			double createMs = measureMs([&]() {
+				for (uint32_t i = 0; i < entityCount; i++)
+					objectManager.createGameObject(createTransform(i), getModel(i));
+			});
+
+			double updateMs = 0.0, gatherMs = 0.0;
+			for (uint32_t frame = 0; frame < FRAME_COUNT; frame++)
+			{
+				updateMs += measureMs([&]() {
+					for (auto& objects : objectManager.getGameObjects())
+					{
+						for (ym::GameObject* object : objects.second)
+							object->setTransform(rotation * object->getTransform());
+					}
+				});
+
+				clearBatch(batch);
+				gatherMs += measureMs([&]() {
+					for (auto& objects : objectManager.getGameObjects())
+					{
+						auto& objs = objects.second;
+						std::vector<glm::mat4> transforms(objs.size());
+						for (size_t i = 0; i < objs.size(); i++)
+							transforms[i] = objs[i]->getTransform();
+						std::vector<glm::mat4>& instances = batch[objects.first];
+						instances.insert(instances.end(), transforms.begin(), transforms.end());
+					}
+				});
+			}
+			objectManager.destroy();
+			result.lines.push_back(line(std::to_string(entityCount) + " ObjectManager", createMs, updateMs, gatherMs, countInstances(batch)));
+		}
+
+		// ECS, the transforms are gathered the same way as Renderer::drawAllModels(ECS*).
+		{
+			ym::ECS ecs;
+			double createMs = measureMs([&]() {
+				for (uint32_t i = 0; i < entityCount; i++)
+					ecs.createEntity(ym::Transform{ createTransform(i) }, ym::ModelRef{ getModel(i) });
+			});
+			ym::EntityQuery query;
+			query.withAll<ym::Transform, ym::ModelRef>();
+
+			auto gather = [&]() {
+				ecs.forEachChunk(query, [&](ym::Chunk& chunk) {
+					const ym::Transform* transforms = chunk.get<ym::Transform>();
+					const ym::ModelRef* refs = chunk.get<ym::ModelRef>();
+					const uint32_t count = chunk.getCount();
+					uint32_t first = 0;
+					for (uint32_t i = 1; i <= count; i++)
+					{
+						if (i == count || refs[i].model != refs[first].model)
+						{
+							std::vector<glm::mat4>& instances = batch[refs[first].model];
+							instances.insert(instances.end(), &transforms[first].matrix, &transforms[first].matrix + (i - first));
+							first = i;
+						}
+					}
+				});
+			};
+
+			double serialMs = 0.0, parallelMs = 0.0, gatherMs = 0.0;
+			ecs.addSystem(new RotateSystem(rotation));
+			for (uint32_t frame = 0; frame < FRAME_COUNT; frame++)
+			{
+				serialMs += measureMs([&]() {
+					ecs.forEachChunk(query, [&](ym::Chunk& chunk) { updateChunk(chunk, rotation); });
+				});
+				parallelMs += measureMs([&]() { ecs.update(0.f); });
+
+				clearBatch(batch);
+				gatherMs += measureMs(gather);
+			}
+			uint32_t instances = countInstances(batch);
+			result.lines.push_back(line(std::to_string(entityCount) + " ECS", createMs, serialMs, gatherMs, instances));
+			result.lines.push_back(line(std::to_string(entityCount) + " ECS (parallel system)", createMs, parallelMs, gatherMs, instances));
+			ecs.destroy();
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Compares the cost of updating the transforms of all entities and gathering them for instanced drawing, between the ObjectManager
+	(one allocation per game object, grouped by model) and the ECS (transforms packed in chunks).
+*/
+BenchmarkResult runEcsBenchmark();
@@ -0,0 +1,90 @@
+#include "FrustumCullingBenchmark.h"
+
+#include "Engine/Core/Graphics/FrustumCuller.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+namespace
+{
+	const uint32_t INSTANCE_COUNT = 100000;
+	const uint32_t ITERATIONS = 20;
+
+	uint32_t countMismatches(const ym::FrustumCuller& culler, const std::vector<uint8_t>& reference)
+	{
+		uint32_t mismatches = 0;
+		for (uint32_t i = 0; i < culler.getCount(); i++)
+			mismatches += (culler.isVisible(i) ? 1 : 0) != reference[i] ? 1 : 0;
+		return mismatches;
+	}
+}
+
+BenchmarkResult runFrustumCullingBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "Frustum culling";
+
+	ym::Camera camera;
+	camera.init(16.f / 9.f, glm::radians(60.f), { 0.f, 0.f, 0.f }, { 0.f, 0.f, -1.f }, 1.f, 1.f);
+
+	// Spheres of different sizes and scales in a box around the camera, about a fifth of them are in the frustum.
+	ym::Bounds bounds;
+	bounds.center = glm::vec3(0.f, 0.5f, 0.f);
+	bounds.radius = 1.f;
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-500.f, 500.f);
+	std::uniform_real_distribution<float> scale(0.5f, 4.f);
+	std::vector<glm::mat4> transforms(INSTANCE_COUNT);
+	for (glm::mat4& transform : transforms)
+	{
+		transform = glm::translate(glm::mat4(1.f), { position(rng), position(rng) * 0.1f, position(rng) });
+		transform = glm::scale(transform, glm::vec3(scale(rng)));
+	}
+
+	ym::FrustumCuller culler;
+	double addMs = measureMs([&]() {
+		for (uint32_t i = 0; i < ITERATIONS; i++)
+		{
+			culler.begin(camera.getPlanes());
+			for (const glm::mat4& transform : transforms)
+				culler.add(transform, bounds);
+		}
+	}) / ITERATIONS;
+
+	double scalarMs = measureMs([&]() {
+		for (uint32_t i = 0; i < ITERATIONS; i++)
+			culler.cullScalar();
+	}) / ITERATIONS;
+	std::vector<uint8_t> reference(INSTANCE_COUNT);
+	for (uint32_t i = 0; i < INSTANCE_COUNT; i++)
+		reference[i] = culler.isVisible(i) ? 1 : 0;
+	const uint32_t referenceVisible = culler.getVisibleCount();
+
+	double sseMs = measureMs([&]() {
+		for (uint32_t i = 0; i < ITERATIONS; i++)
+			culler.cull(false);
+	}) / ITERATIONS;
+	const uint32_t sseMismatches = countMismatches(culler, reference);
+
+	double jobsMs = measureMs([&]() {
+		for (uint32_t i = 0; i < ITERATIONS; i++)
+			culler.cull(true);
+	}) / ITERATIONS;
+	const uint32_t jobsMismatches = countMismatches(culler, reference);
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%u instances, %u visible (%.1f%%), adding the bounds %.3f ms", INSTANCE_COUNT, referenceVisible,
+		(double)referenceVisible / (double)INSTANCE_COUNT * 100.0, addMs);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "Scalar          %8.3f ms", scalarMs);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "SSE             %8.3f ms (%.2fx), %u mismatches", sseMs, scalarMs / sseMs, sseMismatches);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "SSE + jobs      %8.3f ms (%.2fx), %u mismatches", jobsMs, scalarMs / jobsMs, jobsMismatches);
+	result.lines.push_back(std::string(buf));
+
+	// The SIMD paths need to cull exactly like the scalar reference.
+	check(result, sseMismatches == 0, "SSE culling differs from the scalar reference");
+	check(result, jobsMismatches == 0, "SSE + jobs culling differs from the scalar reference");
+	return result;
+}
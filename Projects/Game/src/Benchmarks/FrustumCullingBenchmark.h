@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Culls randomly placed instances against a camera frustum with the scalar reference, with SSE on one thread and with SSE on the
+	job system. The SSE results are compared against the reference.
+*/
+BenchmarkResult runFrustumCullingBenchmark();
@@ -0,0 +1,122 @@
+#include "GeometryArenaBenchmark.h"
+
+#include "Engine/Core/Vulkan/Buffers/RangeAllocator.h"
+#include "Engine/Core/Scene/Model/GeometryArena.h"
+#include "Engine/Core/Scene/Vertex.h"
+
+#include <random>
+
+namespace
+{
+	const uint32_t ITERATIONS = 2000;
+	const uint32_t MIN_VERTICES = 500;
+	const uint32_t MAX_VERTICES = 60000;
+	const uint32_t FULL_STRIDE = (uint32_t)sizeof(ym::Vertex);
+	const uint32_t PACKED_STRIDE = (uint32_t)sizeof(ym::PackedVertex);
+
+	// Returns the number of allocations which overlap another allocation or end outside of the capacity.
+	uint32_t countOverlaps(const std::map<uint64_t, uint64_t>& allocations, uint64_t capacity)
+	{
+		uint32_t overlaps = 0;
+		uint64_t end = 0;
+		for (auto& allocation : allocations)
+		{
+			overlaps += allocation.first < end ? 1 : 0;
+			end = allocation.first + allocation.second;
+		}
+		overlaps += end > capacity ? 1 : 0;
+		return overlaps;
+	}
+}
+
+BenchmarkResult runGeometryArenaBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "Geometry arena";
+
+	// The live allocations are tracked next to the allocator to check its results. Models with full and packed vertices are mixed,
+	// the allocations are in bytes and aligned to the vertex stride like in the arena.
+	ym::RangeAllocator allocator;
+	allocator.init(GEOMETRY_ARENA_VERTEX_CAPACITY);
+	std::map<uint64_t, uint64_t> allocations;
+	std::map<uint64_t, uint32_t> strides;
+
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<uint32_t> vertexCount(MIN_VERTICES, MAX_VERTICES);
+	std::uniform_real_distribution<float> chance(0.f, 1.f);
+	uint32_t failedCount = 0;
+	uint32_t overlaps = 0;
+	uint32_t sizeMismatches = 0;
+	uint32_t misaligned = 0;
+	double streamMs = measureMs([&]() {
+		for (uint32_t i = 0; i < ITERATIONS; i++)
+		{
+			// Load a model, or unload a random one. Unloading is more likely when the arena is almost full.
+			const float usage = (float)((double)allocator.getStats().usedSize / (double)allocator.getCapacity());
+			if (allocations.empty() == false && chance(rng) < usage)
+			{
+				auto it = allocations.begin();
+				std::advance(it, rng() % allocations.size());
+				allocator.free(it->first);
+				strides.erase(it->first);
+				allocations.erase(it);
+			}
+			else
+			{
+				const uint32_t stride = chance(rng) < 0.5f ? FULL_STRIDE : PACKED_STRIDE;
+				const uint64_t size = (uint64_t)vertexCount(rng) * stride;
+				const uint64_t offset = allocator.allocate(size, stride);
+				if (offset == RANGE_ALLOCATOR_INVALID)
+					failedCount++;
+				else
+				{
+					allocations[offset] = size;
+					strides[offset] = stride;
+				}
+			}
+		}
+	});
+	overlaps += countOverlaps(allocations, allocator.getCapacity());
+	for (auto& allocation : allocations)
+	{
+		sizeMismatches += allocator.getSize(allocation.first) != allocation.second ? 1 : 0;
+		misaligned += allocation.first % strides[allocation.first] != 0 ? 1 : 0;
+	}
+	ym::RangeAllocator::Stats before = allocator.getStats();
+
+	// Defragment and move the tracked allocations the same way the arena moves its models.
+	std::vector<ym::RangeAllocator::Move> moves;
+	double defragmentMs = measureMs([&]() { moves = allocator.defragment(); });
+	std::map<uint64_t, uint64_t> packed;
+	uint32_t movedCount = 0;
+	for (ym::RangeAllocator::Move& move : moves)
+	{
+		auto it = allocations.find(move.srcOffset);
+		sizeMismatches += (it == allocations.end() || it->second != move.size) ? 1 : 0;
+		packed[move.dstOffset] = move.size;
+		misaligned += move.dstOffset % strides[move.srcOffset] != 0 ? 1 : 0;
+		movedCount += move.srcOffset != move.dstOffset ? 1 : 0;
+	}
+	sizeMismatches += moves.size() != allocations.size() ? 1 : 0;
+	overlaps += countOverlaps(packed, allocator.getCapacity());
+	for (auto& allocation : packed)
+		sizeMismatches += allocator.getSize(allocation.first) != allocation.second ? 1 : 0;
+	ym::RangeAllocator::Stats after = allocator.getStats();
+
+	// Only the alignment padding between the models is left outside of the last free range, a model of that size fits.
+	const bool fitsAfter = after.freeSize == 0 || allocator.allocate(after.largestFreeRange, PACKED_STRIDE) != RANGE_ALLOCATOR_INVALID;
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%u loads and unloads in %.3f ms, %u model(s) did not fit", ITERATIONS, streamMs, failedCount);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "Before defragmenting: %u models, %.2f MB free in %u ranges, fragmentation %.1f%%", before.allocationCount,
+		(float)before.freeSize / (1024.f * 1024.f), before.freeRangeCount, before.fragmentation * 100.f);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "After defragmenting:  %u models moved in %.3f ms, %u free range(s), fragmentation %.1f%%", movedCount, defragmentMs,
+		after.freeRangeCount, after.fragmentation * 100.f);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "Checks: %u overlaps, %u size mismatches, %u misaligned, free range %s", overlaps, sizeMismatches, misaligned,
+		fitsAfter ? "usable" : "NOT usable");
+	result.lines.push_back(std::string(buf));
+	return result;
+}
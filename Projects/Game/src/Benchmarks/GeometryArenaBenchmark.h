@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Streams models of random sizes in and out of the range allocator of the geometry arena, without the GPU. The allocations are
+	checked for overlaps after every step and after defragmenting, and the fragmentation before and after is reported.
+*/
+BenchmarkResult runGeometryArenaBenchmark();
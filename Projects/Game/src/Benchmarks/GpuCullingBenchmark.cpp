@@ -0,0 +1,141 @@
+#include "GpuCullingBenchmark.h"
+
+#include "Engine/Core/Graphics/GpuCuller.h"
+#include "Engine/Core/Graphics/FrustumCuller.h"
+#include "Engine/Core/Vulkan/Pipeline/Descriptors.h"
+#include "Engine/Core/Vulkan/CommandPool.h"
+#include "Engine/Core/Application/LayerManager.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+namespace
+{
+	const uint32_t INSTANCE_COUNT = 100000;
+	const uint32_t GROUP_SIZE = 1000;
+	const uint32_t BATCH_SIZE = 4; // Groups in each batch, like the levels of detail of a primitive.
+	const uint32_t ITERATIONS = 20;
+	const uint32_t MAX_DIFFERENCE = INSTANCE_COUNT / 10000; // Rounding on the GPU can flip instances which touch a plane.
+}
+
+BenchmarkResult runGpuCullingBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "GPU culling";
+
+	std::string reason;
+	if (ym::GpuCuller::isSupported(false, &reason) == false)
+	{
+		result.lines.push_back("Skipped: " + reason);
+		return result;
+	}
+
+	ym::Camera camera;
+	camera.init(16.f / 9.f, glm::radians(60.f), { 0.f, 0.f, 0.f }, { 0.f, 0.f, -1.f }, 1.f, 1.f);
+
+	// Same placement as the frustum culling benchmark, each group of instances has its own bounds.
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-500.f, 500.f);
+	std::uniform_real_distribution<float> scale(0.5f, 4.f);
+	std::uniform_real_distribution<float> radius(0.5f, 2.f);
+	std::vector<glm::mat4> transforms(INSTANCE_COUNT);
+	for (glm::mat4& transform : transforms)
+	{
+		transform = glm::translate(glm::mat4(1.f), { position(rng), position(rng) * 0.1f, position(rng) });
+		transform = glm::scale(transform, glm::vec3(scale(rng)));
+	}
+	std::vector<ym::Bounds> bounds(INSTANCE_COUNT / GROUP_SIZE);
+	for (ym::Bounds& b : bounds)
+	{
+		b.center = glm::vec3(0.f, 0.5f, 0.f);
+		b.radius = radius(rng);
+	}
+
+	// CPU reference.
+	ym::FrustumCuller reference;
+	reference.begin(camera.getPlanes());
+	for (uint32_t i = 0; i < INSTANCE_COUNT; i++)
+		reference.add(transforms[i], bounds[i / GROUP_SIZE]);
+	double cpuMs = measureMs([&]() {
+		for (uint32_t i = 0; i < ITERATIONS; i++)
+			reference.cull(true);
+	}) / ITERATIONS;
+
+	// The transforms are read from a buffer like the instance buffer of the ModelRenderer.
+	ym::RingBuffer transformBuffer;
+	transformBuffer.init(sizeof(glm::mat4) * INSTANCE_COUNT, 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	memcpy(transformBuffer.getData(0), transforms.data(), sizeof(glm::mat4) * INSTANCE_COUNT);
+
+	ym::DescriptorLayout instanceLayout;
+	instanceLayout.add(new ym::SSBO(VK_SHADER_STAGE_VERTEX_BIT));
+	instanceLayout.init();
+
+	ym::GpuCuller culler;
+	culler.init(1, instanceLayout);
+	culler.setTransforms(transformBuffer.getDescriptor());
+
+	ym::CommandPool* commandPool = &ym::LayerManager::get()->getCommandPools()->graphicsPool;
+	double uploadMs = 0.0;
+	double gpuMs = 0.0;
+	for (uint32_t i = 0; i < ITERATIONS; i++)
+	{
+		uploadMs += measureMs([&]() {
+			culler.begin(0, camera.getPlanes(), INSTANCE_COUNT);
+			for (uint32_t g = 0; g < (uint32_t)bounds.size(); g++)
+			{
+				if (g % BATCH_SIZE == 0)
+					culler.addBatch();
+				uint32_t group = culler.addGroup(bounds[g], g * GROUP_SIZE, GROUP_SIZE);
+				culler.addCommand(group, 36, 0, 0, true);
+			}
+			culler.end();
+		});
+
+		// Includes the submit and the wait for the queue.
+		gpuMs += measureMs([&]() {
+			ym::CommandBuffer* commandBuffer = commandPool->beginSingleTimeCommand();
+			culler.record(commandBuffer);
+			commandPool->endSingleTimeCommand(commandBuffer);
+		});
+	}
+	uploadMs /= ITERATIONS;
+	gpuMs /= ITERATIONS;
+
+	// The visible counts of the last run are read back when the frame begins again.
+	culler.begin(0, camera.getPlanes(), INSTANCE_COUNT);
+	const uint32_t gpuVisible = culler.getLastVisibleCount();
+	const uint32_t cpuVisible = reference.getVisibleCount();
+	const uint32_t gpuDraws = culler.getLastDrawCount();
+
+	// Only the commands of groups with visible instances are drawn.
+	uint32_t cpuDraws = 0;
+	for (uint32_t g = 0; g < (uint32_t)bounds.size(); g++)
+	{
+		for (uint32_t i = g * GROUP_SIZE; i < (g + 1) * GROUP_SIZE; i++)
+		{
+			if (reference.isVisible(i))
+			{
+				cpuDraws++;
+				break;
+			}
+		}
+	}
+
+	culler.destroy();
+	instanceLayout.destroy();
+	transformBuffer.destroy();
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%u instances in %u groups, %u visible on the CPU, %u visible on the GPU (difference %d)", INSTANCE_COUNT,
+		(uint32_t)bounds.size(), cpuVisible, gpuVisible, (int)gpuVisible - (int)cpuVisible);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "%u commands in batches of %u, %u draws on the CPU, %u draws on the GPU", (uint32_t)bounds.size(), BATCH_SIZE, cpuDraws, gpuDraws);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "CPU SSE + jobs  %8.3f ms", cpuMs);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "GPU upload      %8.3f ms, dispatch and wait %8.3f ms", uploadMs, gpuMs);
+	result.lines.push_back(std::string(buf));
+	check(result, (uint32_t)std::abs((int)gpuVisible - (int)cpuVisible) <= MAX_DIFFERENCE, "GPU visible count differs from the FrustumCuller");
+	check(result, (uint32_t)std::abs((int)gpuDraws - (int)cpuDraws) <= MAX_DIFFERENCE, "GPU draw count differs from the groups with visible instances");
+	return result;
+}
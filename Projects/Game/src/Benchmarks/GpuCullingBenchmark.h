@@ -0,0 +1,10 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Culls randomly placed instances against a camera frustum with the GPU culler and compares the number of visible instances
+	against the FrustumCuller on the CPU. The commands are drawn in batches, the draw count of the batches is compared against the
+	number of groups with visible instances. Skipped when the device or the compiled shaders do not support the GPU culling.
+*/
+BenchmarkResult runGpuCullingBenchmark();
@@ -0,0 +1,67 @@
+#include "IBLBenchmark.h"
+
+#include "Engine/Core/Graphics/IBLFunctions.h"
+
+namespace
+{
+	struct StageTimes
+	{
+		double environmentMs{ 0.0 };
+		double irradianceAndPrefilteredMs{ 0.0 };
+		double brdfLutMs{ 0.0 };
+	};
+
+	StageTimes generate(ym::Texture* hdrTexture)
+	{
+		StageTimes times;
+		ym::Texture* environment = nullptr;
+		std::pair<ym::Texture*, ym::Texture*> irrAndPref;
+		ym::Texture* brdfLut = nullptr;
+		times.environmentMs = measureMs([&]() { environment = ym::IBLFunctions::convertEquirectangularToCubemap(IBL_ENVIRONMENT_SIZE, hdrTexture, 0); });
+		times.irradianceAndPrefilteredMs = measureMs([&]() { irrAndPref = ym::IBLFunctions::createIrradianceAndPrefilteredMap(environment); });
+		times.brdfLutMs = measureMs([&]() { brdfLut = ym::IBLFunctions::createBRDFLutTexture(IBL_BRDF_LUT_SIZE); });
+
+		ym::Texture* textures[] = { environment, irrAndPref.first, irrAndPref.second, brdfLut };
+		for (ym::Texture* texture : textures)
+		{
+			texture->destroy();
+			delete texture;
+		}
+		return times;
+	}
+}
+
+BenchmarkResult runIBLBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "IBL generation";
+
+	ym::Texture* hdrTexture = ym::IBLFunctions::loadEquirectangularTexture(YM_ASSETS_FILE_PATH + "Textures/HDRs/arches.hdr");
+	if (hdrTexture == nullptr)
+	{
+		result.lines.push_back("arches.hdr: not found");
+		return result;
+	}
+
+	const bool wasBatched = ym::IBLFunctions::isBatched();
+	ym::IBLFunctions::setBatched(false);
+	StageTimes perPass = generate(hdrTexture);
+	ym::IBLFunctions::setBatched(true);
+	StageTimes batched = generate(hdrTexture);
+	ym::IBLFunctions::setBatched(wasBatched);
+
+	hdrTexture->destroy();
+	delete hdrTexture;
+
+	char buf[256];
+	auto addLine = [&](const char* stage, double perPassMs, double batchedMs) {
+		snprintf(buf, sizeof(buf), "%-26s per pass %9.2f ms, batched %9.2f ms (%.2fx)", stage, perPassMs, batchedMs, perPassMs / batchedMs);
+		result.lines.push_back(std::string(buf));
+	};
+	addLine("Environment cube", perPass.environmentMs, batched.environmentMs);
+	addLine("Irradiance + prefiltered", perPass.irradianceAndPrefilteredMs, batched.irradianceAndPrefilteredMs);
+	addLine("BRDF LUT", perPass.brdfLutMs, batched.brdfLutMs);
+	addLine("Total", perPass.environmentMs + perPass.irradianceAndPrefilteredMs + perPass.brdfLutMs,
+		batched.environmentMs + batched.irradianceAndPrefilteredMs + batched.brdfLutMs);
+	return result;
+}
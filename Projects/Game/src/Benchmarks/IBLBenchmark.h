@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Compares generating the IBL textures with each face and mip level submitted on its own against recording each stage into one
+	command buffer. The time of a stage includes waiting for the GPU to finish it.
+*/
+BenchmarkResult runIBLBenchmark();
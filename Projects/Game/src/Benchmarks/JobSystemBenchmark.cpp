@@ -0,0 +1,103 @@
+#include "JobSystemBenchmark.h"
+
+#include "Engine/Core/Threading/JobSystem.h"
+#include "Engine/Core/Threading/ThreadManager.h"
+
+#include <atomic>
+#include <cmath>
+
+namespace
+{
+	const uint32_t JOB_COUNT = 100000;
+	const uint32_t WAIT_COUNT = 10000;
+
+	// Small amount of work, roughly the size of recording a few draw calls.
+	void work(std::atomic<uint64_t>* sink, uint32_t seed)
+	{
+		float sum = 0.f;
+		for (uint32_t i = 0; i < 64; i++)
+			sum += std::sqrt((float)(seed + i));
+		sink->fetch_add((uint64_t)sum, std::memory_order_relaxed);
+	}
+
+	std::string line(const std::string& name, double ms, uint32_t count)
+	{
+		char buf[256];
+		snprintf(buf, sizeof(buf), "%-32s %9.2f ms (%8.3f us/job)", name.c_str(), ms, ms * 1000.0 / (double)count);
+		return std::string(buf);
+	}
+}
+
+BenchmarkResult runJobSystemBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "Job system";
+
+	const uint32_t numWorkers = ym::JobSystem::getWorkerCount();
+	std::atomic<uint64_t> sink{ 0 };
+	ThreadManager::init(numWorkers);
+
+	// Throughput, all jobs pinned to one thread. (This is how the renderers and the loader used the ThreadManager)
+	double pinnedMs = measureMs([&]() {
+		for (uint32_t i = 0; i < JOB_COUNT; i++)
+			ThreadManager::addWork(0, [&sink, i]() { work(&sink, i); });
+		ThreadManager::wait();
+	});
+	result.lines.push_back(line("ThreadManager (one thread)", pinnedMs, JOB_COUNT));
+
+	// Throughput, jobs distributed over all threads by the caller.
+	double roundRobinMs = measureMs([&]() {
+		for (uint32_t i = 0; i < JOB_COUNT; i++)
+			ThreadManager::addWork(i % numWorkers, [&sink, i]() { work(&sink, i); });
+		ThreadManager::wait();
+	});
+	result.lines.push_back(line("ThreadManager (round robin)", roundRobinMs, JOB_COUNT));
+
+	// Wait latency, one job at a time.
+	double waitOldMs = measureMs([&]() {
+		for (uint32_t i = 0; i < WAIT_COUNT; i++)
+		{
+			ThreadManager::addWork(0, [&sink, i]() { work(&sink, i); });
+			ThreadManager::wait(0);
+		}
+	});
+	result.lines.push_back(line("ThreadManager wait latency", waitOldMs, WAIT_COUNT));
+	ThreadManager::destroy();
+
+	ym::JobSystem::Stats statsBefore = ym::JobSystem::getStats();
+	double jobSystemMs = measureMs([&]() {
+		ym::JobCounter counter;
+		for (uint32_t i = 0; i < JOB_COUNT; i++)
+			ym::JobSystem::execute([&sink, i]() { work(&sink, i); }, &counter);
+		ym::JobSystem::wait(&counter);
+	});
+	result.lines.push_back(line("JobSystem", jobSystemMs, JOB_COUNT));
+
+	double dispatchMs = measureMs([&]() {
+		ym::JobCounter counter;
+		ym::JobSystem::dispatch(JOB_COUNT, 256, [&sink](uint32_t first, uint32_t last) {
+			for (uint32_t i = first; i < last; i++)
+				work(&sink, i);
+		}, &counter);
+		ym::JobSystem::wait(&counter);
+	});
+	result.lines.push_back(line("JobSystem (dispatch, 256/group)", dispatchMs, JOB_COUNT));
+
+	double waitNewMs = measureMs([&]() {
+		for (uint32_t i = 0; i < WAIT_COUNT; i++)
+		{
+			ym::JobCounter counter;
+			ym::JobSystem::execute([&sink, i]() { work(&sink, i); }, &counter);
+			ym::JobSystem::wait(&counter);
+		}
+	});
+	result.lines.push_back(line("JobSystem wait latency", waitNewMs, WAIT_COUNT));
+
+	ym::JobSystem::Stats statsAfter = ym::JobSystem::getStats();
+	char buf[128];
+	snprintf(buf, sizeof(buf), "Workers: %u, jobs stolen: %llu of %llu", numWorkers,
+		(unsigned long long)(statsAfter.stolen - statsBefore.stolen), (unsigned long long)(statsAfter.executed - statsBefore.executed));
+	result.lines.push_back(std::string(buf));
+
+	return result;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Compares job throughput and the latency of waiting for a single job between the
+	old ThreadManager (pinned queues, spinning wait) and the work-stealing JobSystem.
+*/
+BenchmarkResult runJobSystemBenchmark();
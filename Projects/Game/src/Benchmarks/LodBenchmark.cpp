@@ -0,0 +1,186 @@
+#include "LodBenchmark.h"
+
+#include "Engine/Core/Graphics/ModelRenderer.h"
+#include "Engine/Core/Scene/MeshSimplifier.h"
+#include "Engine/Core/Scene/GLTFLoader.h"
+#include "Engine/Core/Scene/Model/Model.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+namespace
+{
+	const uint32_t GRID_SIZE = 64;			// Instances along each side of the grid.
+	const float GRID_SPACING = 4.f;			// Distance between the instances, in multiples of the model radius.
+	const uint32_t CAMERA_STEPS = 120;		// Frames of the camera path.
+	const float PROJECTION_SCALE = 1303.f;	// proj[1][1] * height / 2 for a 45 degree field of view at 1080p.
+
+	uint64_t getTriangleCount(const std::vector<ym::Model::Node>& nodes, uint32_t lod)
+	{
+		uint64_t count = 0;
+		for (const ym::Model::Node& node : nodes)
+		{
+			if (node.hasMesh)
+			{
+				for (const ym::Primitive& primitive : node.mesh.primitives)
+					count += (primitive.hasIndices ? primitive.getIndexCount(lod) : primitive.vertexCount) / 3;
+			}
+			count += getTriangleCount(node.children, lod);
+		}
+		return count;
+	}
+
+	void addLodLines(const std::string& name, ym::Model& model, BenchmarkResult& result)
+	{
+		char buf[256];
+		const float radius = std::max(model.bounds.radius, 0.0001f);
+		for (uint32_t lod = 0; lod < model.lodCount; lod++)
+		{
+			snprintf(buf, sizeof(buf), "%-12s LOD %u: %8llu triangles, error %.5f (%.3f%% of the radius)", name.c_str(), lod,
+				(unsigned long long)getTriangleCount(model.nodes, lod), model.lodErrors[lod], model.lodErrors[lod] / radius * 100.f);
+			result.lines.push_back(std::string(buf));
+		}
+	}
+
+	// UV sphere with a seam where the texture coordinates wrap around, the seam vertices are kept by the simplifier.
+	void createSphere(ym::Model& model, uint32_t rings, uint32_t segments)
+	{
+		for (uint32_t ring = 0; ring <= rings; ring++)
+		{
+			for (uint32_t segment = 0; segment <= segments; segment++)
+			{
+				const float theta = glm::pi<float>() * (float)ring / (float)rings;
+				const float phi = glm::two_pi<float>() * (float)segment / (float)segments;
+				ym::Vertex vertex;
+				vertex.nor = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+				vertex.pos = vertex.nor;
+				vertex.uv0 = glm::vec2((float)segment / (float)segments, (float)ring / (float)rings);
+				model.vertices.push_back(vertex);
+			}
+		}
+		for (uint32_t ring = 0; ring < rings; ring++)
+		{
+			for (uint32_t segment = 0; segment < segments; segment++)
+			{
+				const uint32_t a = ring * (segments + 1) + segment;
+				const uint32_t b = a + segments + 1;
+				for (uint32_t index : { a, b, a + 1, a + 1, b, b + 1 })
+					model.indices.push_back(index);
+			}
+		}
+
+		model.nodes.resize(1);
+		model.nodes[0].hasMesh = true;
+		model.nodes[0].mesh.primitives.resize(1);
+		ym::Primitive& primitive = model.nodes[0].mesh.primitives[0];
+		primitive.hasIndices = true;
+		primitive.indexCount = (uint32_t)model.indices.size();
+		primitive.vertexCount = (uint32_t)model.vertices.size();
+		model.bounds.center = glm::vec3(0.f);
+		model.bounds.radius = std::sqrt(3.f);
+	}
+
+	// The camera flies low over the grid, from one corner to the other.
+	void runGrid(const std::string& name, const ym::Model& model, BenchmarkResult& result)
+	{
+		const float spacing = std::max(model.bounds.radius, 0.0001f) * GRID_SPACING;
+		std::vector<glm::mat4> transforms;
+		for (uint32_t z = 0; z < GRID_SIZE; z++)
+			for (uint32_t x = 0; x < GRID_SIZE; x++)
+				transforms.push_back(glm::translate(glm::mat4(1.f), glm::vec3((float)x, 0.f, (float)z) * spacing));
+
+		const uint32_t instanceCount = (uint32_t)transforms.size();
+		std::array<uint64_t, MODEL_MAX_LODS> triangles;
+		for (uint32_t lod = 0; lod < MODEL_MAX_LODS; lod++)
+			triangles[lod] = getTriangleCount(model.nodes, lod);
+
+		uint64_t fullTriangles = 0;
+		uint64_t lodTriangles = 0;
+		uint32_t switches = 0;
+		uint32_t switchesWithoutHysteresis = 0;
+		std::vector<uint8_t> lods(instanceCount, 0);
+		std::vector<uint8_t> lodsWithoutHysteresis(instanceCount, 0);
+		std::array<uint64_t, MODEL_MAX_LODS> instancesPerLod{};
+		const float size = spacing * (float)GRID_SIZE;
+		double ms = 0.0;
+		for (uint32_t step = 0; step < CAMERA_STEPS; step++)
+		{
+			const float t = (float)step / (float)(CAMERA_STEPS - 1);
+			const glm::vec3 camera = glm::vec3(t * size, model.bounds.radius * 2.f, t * size * 0.5f);
+			ms += measureMs([&]() {
+				for (uint32_t i = 0; i < instanceCount; i++)
+				{
+					const uint32_t lod = ym::ModelRenderer::selectLod(model, transforms[i], camera, PROJECTION_SCALE, lods[i]);
+					switches += lod != lods[i] ? 1 : 0;
+					lods[i] = (uint8_t)lod;
+				}
+			});
+
+			// A previous level past the last one never counts as going coarser, which turns the hysteresis off.
+			for (uint32_t i = 0; i < instanceCount; i++)
+			{
+				const uint32_t lod = ym::ModelRenderer::selectLod(model, transforms[i], camera, PROJECTION_SCALE, MODEL_MAX_LODS);
+				switchesWithoutHysteresis += lod != lodsWithoutHysteresis[i] ? 1 : 0;
+				lodsWithoutHysteresis[i] = (uint8_t)lod;
+			}
+
+			for (uint32_t i = 0; i < instanceCount; i++)
+			{
+				lodTriangles += triangles[lods[i]];
+				instancesPerLod[lods[i]]++;
+			}
+			fullTriangles += triangles[0] * instanceCount;
+		}
+
+		char buf[256];
+		snprintf(buf, sizeof(buf), "%-12s %u instances: %.2fM triangles per frame without LODs, %.2fM with LODs (%.1fx fewer), selection %.3f ms",
+			name.c_str(), instanceCount, (double)fullTriangles / CAMERA_STEPS / 1e6, (double)lodTriangles / CAMERA_STEPS / 1e6,
+			lodTriangles > 0 ? (double)fullTriangles / (double)lodTriangles : 0.0, ms / CAMERA_STEPS);
+		result.lines.push_back(std::string(buf));
+		snprintf(buf, sizeof(buf), "%-12s instances per LOD: %.1f%% / %.1f%% / %.1f%% / %.1f%%, switches %u with hysteresis, %u without",
+			name.c_str(), instancesPerLod[0] * 100.0 / ((double)instanceCount * CAMERA_STEPS), instancesPerLod[1] * 100.0 / ((double)instanceCount * CAMERA_STEPS),
+			instancesPerLod[2] * 100.0 / ((double)instanceCount * CAMERA_STEPS), instancesPerLod[3] * 100.0 / ((double)instanceCount * CAMERA_STEPS),
+			switches, switchesWithoutHysteresis);
+		result.lines.push_back(std::string(buf));
+	}
+}
+
+BenchmarkResult runLodBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "Levels of detail";
+
+	ym::Model sphere;
+	createSphere(sphere, 128, 256);
+	double ms = measureMs([&]() { ym::MeshSimplifier::generateLods(sphere); });
+	addLodLines("Sphere", sphere, result);
+	char buf[128];
+	snprintf(buf, sizeof(buf), "%-12s generated in %.2f ms", "Sphere", ms);
+	result.lines.push_back(std::string(buf));
+	runGrid("Sphere", sphere, result);
+
+	// The loader generates the levels when the simplifier is enabled.
+	if (ym::MeshSimplifier::isEnabled() == false)
+	{
+		result.lines.push_back("The mesh simplifier is disabled, bundled models have no levels of detail.");
+		return result;
+	}
+	const std::vector<std::pair<std::string, std::string>> models = {
+		{ "Tree", "Models/Tree/tree.glb" },
+		{ "FlightHelmet", "Models/FlightHelmet/FlightHelmet.gltf" },
+		{ "Sponza", "Models/Sponza/glTF/Sponza.gltf" }
+	};
+	for (const std::pair<std::string, std::string>& entry : models)
+	{
+		const std::string& name = entry.first;
+		ym::Model model;
+		ym::GLTFLoader::StagingBuffers stagingBuffers;
+		ym::GLTFLoader::loadToRAM(YM_ASSETS_FILE_PATH + entry.second, &model, &stagingBuffers);
+		addLodLines(name, model, result);
+		if (name == "Tree")
+			runGrid(name, model, result);
+		stagingBuffers.destroy();
+		model.destroy();
+	}
+	return result;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Generates levels of detail for a synthetic sphere and for bundled models, and reports the triangles and error of each level.
+	A dense grid of instances is then viewed from a moving camera, reporting the triangles submitted per frame with and without
+	level of detail selection and the number of level switches with and without hysteresis.
+*/
+BenchmarkResult runLodBenchmark();
@@ -0,0 +1,329 @@
+#include "MemoryAllocatorBenchmark.h"
+
+#include "Engine/Core/Vulkan/Buffers/MemoryAllocator.h"
+
+#include <random>
+
+namespace
+{
+	const uint64_t KB = 1024;
+	const uint64_t BLOCK_SIZE = 4 * 1024 * KB;
+	const uint64_t TRANSIENT_BLOCK_SIZE = 2 * 1024 * KB;
+	const uint32_t MEMORY_TYPE = 0;
+	const uint32_t ITERATIONS = 4000;
+	const uint32_t TARGET_LIVE_COUNT = 500;
+
+	using Lifetime = ym::MemoryAllocator::Lifetime;
+
+	ym::MemoryAllocation allocate(ym::MemoryAllocator& allocator, uint64_t size, uint64_t alignment, Lifetime lifetime = Lifetime::PERSISTENT)
+	{
+		return allocator.allocate(size, alignment, MEMORY_TYPE, true, ym::MemoryAllocator::ResourceType::BUFFER, lifetime);
+	}
+
+	// Write a pattern through the mapped data, an allocation which overlaps it will change the pattern.
+	void fillPattern(const ym::MemoryAllocation& allocation, uint32_t seed)
+	{
+		uint8_t* data = static_cast<uint8_t*>(allocation.mappedData);
+		for (uint64_t i = 0; i < allocation.size; i++)
+			data[i] = (uint8_t)(seed * 31 + i);
+	}
+
+	bool hasPattern(const ym::MemoryAllocation& allocation, uint32_t seed)
+	{
+		const uint8_t* data = static_cast<const uint8_t*>(allocation.mappedData);
+		for (uint64_t i = 0; i < allocation.size; i++)
+		{
+			if (data[i] != (uint8_t)(seed * 31 + i))
+				return false;
+		}
+		return true;
+	}
+
+	void checkSlabs(BenchmarkResult& result)
+	{
+		ym::MemoryAllocator allocator;
+		ym::TrackingMemoryDevice* device = new ym::TrackingMemoryDevice();
+		allocator.init(device, BLOCK_SIZE, TRANSIENT_BLOCK_SIZE);
+
+		// One more allocation than a slab has slots of 1 KB, the last one needs a second slab from the same block.
+		const uint32_t slotCount = (uint32_t)(MEMORY_SLAB_SIZE / KB);
+		std::vector<ym::MemoryAllocation> allocations(slotCount + 1);
+		uint32_t wrongSlots = 0;
+		for (uint32_t i = 0; i < (uint32_t)allocations.size(); i++)
+		{
+			allocations[i] = allocate(allocator, 1000, 16);
+			const uint64_t expectedSlab = i < slotCount ? 0 : MEMORY_SLAB_SIZE;
+			wrongSlots += (allocations[i].size != KB || allocations[i].offset % KB != 0 || allocations[i].offset - allocations[i].offset % MEMORY_SLAB_SIZE != expectedSlab) ? 1 : 0;
+			fillPattern(allocations[i], i);
+		}
+		uint32_t overwritten = 0;
+		for (uint32_t i = 0; i < (uint32_t)allocations.size(); i++)
+			overwritten += hasPattern(allocations[i], i) ? 0 : 1;
+		const uint64_t deviceCalls = allocator.getStats().deviceAllocateCalls;
+
+		for (ym::MemoryAllocation& allocation : allocations)
+			allocator.free(allocation);
+		ym::MemoryAllocator::Stats stats = allocator.getStats();
+
+		char buf[256];
+		snprintf(buf, sizeof(buf), "Slabs:      %u slots of 1 KB, %u wrong slot(s), %u overwritten, %llu device allocation(s)", (uint32_t)allocations.size(),
+			wrongSlots, overwritten, (unsigned long long)deviceCalls);
+		result.lines.push_back(std::string(buf));
+		check(result, wrongSlots == 0, "Slots have the wrong size or are not in the expected slab");
+		check(result, overwritten == 0, "Slots overlap");
+		check(result, deviceCalls == 1, "Slabs were not sub-allocated from one block");
+		check(result, stats.allocationCount == 0 && stats.usedBytes == 0, "Freed slots are still counted as used");
+		check(result, stats.freeBytes == BLOCK_SIZE - MEMORY_SLAB_SIZE, "The last empty slab was not kept, or the other slab was not returned to its block");
+		allocator.destroy();
+	}
+
+	void checkBestFit(BenchmarkResult& result)
+	{
+		ym::MemoryAllocator allocator;
+		ym::TrackingMemoryDevice* device = new ym::TrackingMemoryDevice();
+		allocator.init(device, BLOCK_SIZE, TRANSIENT_BLOCK_SIZE);
+
+		// Leave free ranges of 512 KB and 256 KB in front of the rest of the block, each allocation takes the smallest range it fits in.
+		ym::MemoryAllocation a = allocate(allocator, 128 * KB, 256);
+		ym::MemoryAllocation b = allocate(allocator, 512 * KB, 256);
+		ym::MemoryAllocation c = allocate(allocator, 128 * KB, 256);
+		ym::MemoryAllocation d = allocate(allocator, 256 * KB, 256);
+		ym::MemoryAllocation e = allocate(allocator, 128 * KB, 256);
+		const uint64_t bOffset = b.offset;
+		const uint64_t dOffset = d.offset;
+		const uint64_t end = e.offset + e.size;
+		allocator.free(b);
+		allocator.free(d);
+
+		ym::MemoryAllocation f = allocate(allocator, 192 * KB, 256);
+		ym::MemoryAllocation g = allocate(allocator, 384 * KB, 256);
+		ym::MemoryAllocation h = allocate(allocator, 1024 * KB, 256);
+		const bool bestFit = f.offset == dOffset && g.offset == bOffset && h.offset == end;
+		const uint64_t deviceCalls = allocator.getStats().deviceAllocateCalls;
+
+		char buf[256];
+		snprintf(buf, sizeof(buf), "Best fit:   192 KB at %llu KB, 384 KB at %llu KB, 1 MB at %llu KB, %llu device allocation(s)", (unsigned long long)(f.offset / KB),
+			(unsigned long long)(g.offset / KB), (unsigned long long)(h.offset / KB), (unsigned long long)deviceCalls);
+		result.lines.push_back(std::string(buf));
+		check(result, bestFit, "Allocations did not take the smallest free range they fit in");
+		check(result, deviceCalls == 1, "Best fit allocations were not sub-allocated from one block");
+
+		for (ym::MemoryAllocation* allocation : { &a, &c, &e, &f, &g, &h })
+			allocator.free(*allocation);
+		allocator.destroy();
+	}
+
+	void checkMerging(BenchmarkResult& result)
+	{
+		ym::MemoryAllocator allocator;
+		ym::TrackingMemoryDevice* device = new ym::TrackingMemoryDevice();
+		allocator.init(device, BLOCK_SIZE, TRANSIENT_BLOCK_SIZE);
+
+		// Free the outer allocations first, the range of the middle one has to be merged with the ranges on both sides.
+		ym::MemoryAllocation a = allocate(allocator, 256 * KB, 256);
+		ym::MemoryAllocation b = allocate(allocator, 256 * KB, 256);
+		ym::MemoryAllocation c = allocate(allocator, 256 * KB, 256);
+		allocator.free(a);
+		allocator.free(c);
+		ym::MemoryAllocator::Stats split = allocator.getStats();
+		allocator.free(b);
+		ym::MemoryAllocator::Stats merged = allocator.getStats();
+
+		char buf[256];
+		snprintf(buf, sizeof(buf), "Merging:    fragmentation %.1f%% with a hole, %.1f%% after freeing it, largest free range %llu KB", split.fragmentation * 100.f,
+			merged.fragmentation * 100.f, (unsigned long long)(merged.largestFreeRange / KB));
+		result.lines.push_back(std::string(buf));
+		check(result, split.freeBytes == BLOCK_SIZE - 256 * KB && split.largestFreeRange == BLOCK_SIZE - 512 * KB, "Freed range was not merged with the rest of the block");
+		check(result, merged.freeBytes == BLOCK_SIZE && merged.largestFreeRange == BLOCK_SIZE, "Freed range was not merged with both neighbours");
+		check(result, merged.blockCount == 1 && device->getLiveCount() == 1, "The empty block was not kept");
+		allocator.destroy();
+	}
+
+	void checkTransient(BenchmarkResult& result)
+	{
+		ym::MemoryAllocator allocator;
+		ym::TrackingMemoryDevice* device = new ym::TrackingMemoryDevice();
+		allocator.init(device, BLOCK_SIZE, TRANSIENT_BLOCK_SIZE);
+
+		// Fill one linear block and start a second one. When everything is freed the second block is released and the first one starts over.
+		const uint64_t size = 100 * KB;
+		const uint32_t perBlock = (uint32_t)(TRANSIENT_BLOCK_SIZE / size);
+		std::vector<ym::MemoryAllocation> allocations(perBlock + 1);
+		uint32_t notLinear = 0;
+		for (uint32_t i = 0; i < (uint32_t)allocations.size(); i++)
+		{
+			allocations[i] = allocate(allocator, size, 256, Lifetime::TRANSIENT);
+			notLinear += allocations[i].offset != (i % perBlock) * size ? 1 : 0;
+		}
+		const VkDeviceMemory firstMemory = allocations[0].memory;
+		const uint64_t deviceCalls = allocator.getStats().deviceAllocateCalls;
+
+		for (ym::MemoryAllocation& allocation : allocations)
+			allocator.free(allocation);
+		ym::MemoryAllocation reset = allocate(allocator, size, 256, Lifetime::TRANSIENT);
+		const bool wasReset = reset.memory == firstMemory && reset.offset == 0;
+		ym::MemoryAllocator::Stats stats = allocator.getStats();
+
+		char buf[256];
+		snprintf(buf, sizeof(buf), "Transient:  %u allocations of 100 KB, %u not linear, %llu device allocation(s), block %s", (uint32_t)allocations.size(), notLinear,
+			(unsigned long long)deviceCalls, wasReset ? "reset" : "NOT reset");
+		result.lines.push_back(std::string(buf));
+		check(result, notLinear == 0, "Transient allocations were not placed one after another");
+		check(result, deviceCalls == 2, "A full transient block did not start a new block");
+		check(result, wasReset, "The transient block did not start over when all of its allocations were freed");
+		check(result, stats.deviceFreeCalls == 1 && device->getLiveCount() == 1, "The second empty transient block was not released");
+		allocator.free(reset);
+		allocator.destroy();
+	}
+
+	void checkDedicated(BenchmarkResult& result)
+	{
+		ym::MemoryAllocator allocator;
+		ym::TrackingMemoryDevice* device = new ym::TrackingMemoryDevice();
+		allocator.init(device, BLOCK_SIZE, TRANSIENT_BLOCK_SIZE);
+
+		// Larger than half a block, for both lifetimes.
+		ym::MemoryAllocation persistent = allocate(allocator, BLOCK_SIZE / 2 + 1, 256);
+		ym::MemoryAllocation transient = allocate(allocator, TRANSIENT_BLOCK_SIZE / 2 + 1, 256, Lifetime::TRANSIENT);
+		ym::MemoryAllocator::Stats stats = allocator.getStats();
+		const bool ownMemory = persistent.offset == 0 && device->getSize(persistent.memory) == persistent.size &&
+			transient.offset == 0 && device->getSize(transient.memory) == transient.size;
+		const uint32_t liveCount = device->getLiveCount();
+
+		allocator.free(persistent);
+		allocator.free(transient);
+		ym::MemoryAllocator::Stats freed = allocator.getStats();
+
+		char buf[256];
+		snprintf(buf, sizeof(buf), "Dedicated:  %u dedicated, %u in blocks, %u device memory live after freeing", stats.dedicatedCount, stats.blockCount, device->getLiveCount());
+		result.lines.push_back(std::string(buf));
+		check(result, ownMemory && stats.dedicatedCount == 2 && stats.blockCount == 0 && liveCount == 2, "Large allocations did not get their own device memory");
+		check(result, freed.dedicatedCount == 0 && freed.deviceBytes == 0 && device->getLiveCount() == 0, "Dedicated memory was not released when it was freed");
+		allocator.destroy();
+	}
+
+	void runStress(BenchmarkResult& result)
+	{
+		ym::MemoryAllocator allocator;
+		ym::TrackingMemoryDevice* device = new ym::TrackingMemoryDevice();
+		allocator.init(device, BLOCK_SIZE, TRANSIENT_BLOCK_SIZE);
+
+		struct Live
+		{
+			ym::MemoryAllocation allocation;
+			uint32_t seed{ 0 };
+		};
+		std::vector<Live> live;
+		std::map<std::pair<VkDeviceMemory, uint64_t>, uint64_t> ranges; // Size of each live allocation, keyed by memory and offset.
+
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> chance(0.f, 1.f);
+		std::uniform_int_distribution<uint32_t> alignmentShift(4, 12);
+		std::uniform_int_distribution<uint64_t> smallSize(16, 64 * KB);
+		std::uniform_int_distribution<uint64_t> largeSize(64 * KB + 1, 256 * KB);
+		std::uniform_int_distribution<uint64_t> dedicatedSize(BLOCK_SIZE / 2 + 1, BLOCK_SIZE);
+		uint32_t failedCount = 0;
+		uint32_t overlaps = 0;
+		uint32_t misaligned = 0;
+		uint32_t outOfBounds = 0;
+		uint32_t overwritten = 0;
+		uint32_t allocationCount = 0;
+		double allocatorMs = 0.0;
+
+		auto freeLive = [&](uint32_t index) {
+			Live& entry = live[index];
+			overwritten += hasPattern(entry.allocation, entry.seed) ? 0 : 1;
+			ranges.erase({ entry.allocation.memory, entry.allocation.offset });
+			allocatorMs += measureMs([&]() { allocator.free(entry.allocation); });
+			live[index] = live.back();
+			live.pop_back();
+		};
+
+		for (uint32_t i = 0; i < ITERATIONS; i++)
+		{
+			// Free a random allocation more often the more allocations are live.
+			if (live.empty() == false && chance(rng) < (float)live.size() / (float)(2 * TARGET_LIVE_COUNT))
+			{
+				freeLive(rng() % (uint32_t)live.size());
+				continue;
+			}
+
+			const float kind = chance(rng);
+			const uint64_t size = kind < 0.6f ? smallSize(rng) : (kind < 0.99f ? largeSize(rng) : dedicatedSize(rng));
+			const uint64_t alignment = 1ull << alignmentShift(rng);
+			const Lifetime lifetime = chance(rng) < 0.2f && size <= TRANSIENT_BLOCK_SIZE / 2 ? Lifetime::TRANSIENT : Lifetime::PERSISTENT;
+			ym::MemoryAllocation allocation;
+			allocatorMs += measureMs([&]() { allocation = allocate(allocator, size, alignment, lifetime); });
+			if (allocation.memory == VK_NULL_HANDLE)
+			{
+				failedCount++;
+				continue;
+			}
+			allocationCount++;
+
+			misaligned += allocation.offset % alignment != 0 ? 1 : 0;
+			outOfBounds += (allocation.size < size || allocation.offset + allocation.size > device->getSize(allocation.memory)) ? 1 : 0;
+
+			// Compare with the live neighbours in the same memory.
+			auto next = ranges.lower_bound({ allocation.memory, allocation.offset });
+			if (next != ranges.end() && next->first.first == allocation.memory && next->first.second < allocation.offset + allocation.size)
+				overlaps++;
+			if (next != ranges.begin())
+			{
+				auto prev = std::prev(next);
+				if (prev->first.first == allocation.memory && prev->first.second + prev->second > allocation.offset)
+					overlaps++;
+			}
+			ranges[{ allocation.memory, allocation.offset }] = allocation.size;
+
+			Live entry;
+			entry.allocation = allocation;
+			entry.seed = i;
+			fillPattern(entry.allocation, entry.seed);
+			live.push_back(entry);
+		}
+
+		uint64_t liveBytes = 0;
+		for (Live& entry : live)
+			liveBytes += entry.allocation.size;
+		ym::MemoryAllocator::Stats stats = allocator.getStats();
+		const bool statsMatch = stats.allocationCount == (uint32_t)live.size() && stats.usedBytes == liveBytes;
+
+		while (live.empty() == false)
+			freeLive((uint32_t)live.size() - 1);
+		ym::MemoryAllocator::Stats freed = allocator.getStats();
+		const bool devicesMatch = device->getLiveBytes() == freed.deviceBytes && device->getLiveCount() == freed.blockCount + freed.dedicatedCount &&
+			device->getMappedCount() == device->getLiveCount();
+
+		char buf[256];
+		snprintf(buf, sizeof(buf), "Stress:     %u allocations in %.3f ms, %u did not fit, %llu device allocation(s), fragmentation %.1f%%", allocationCount, allocatorMs,
+			failedCount, (unsigned long long)stats.deviceAllocateCalls, stats.fragmentation * 100.f);
+		result.lines.push_back(std::string(buf));
+		snprintf(buf, sizeof(buf), "Checks:     %u overlaps, %u overwritten, %u misaligned, %u out of bounds, %u invalid device call(s)", overlaps, overwritten,
+			misaligned, outOfBounds, device->getErrorCount());
+		result.lines.push_back(std::string(buf));
+		check(result, failedCount == 0, "Allocations failed although the device never runs out of memory");
+		check(result, overlaps == 0 && overwritten == 0, "Live allocations overlap");
+		check(result, misaligned == 0, "Allocations are not aligned");
+		check(result, outOfBounds == 0, "Allocations are smaller than requested or end outside of their device memory");
+		check(result, statsMatch, "The stats do not match the live allocations");
+		check(result, freed.allocationCount == 0 && freed.usedBytes == 0, "Freed allocations are still counted as used");
+		check(result, devicesMatch, "The device memory does not match the blocks of the allocator");
+		check(result, device->getErrorCount() == 0, "The allocator made invalid device calls");
+		allocator.destroy();
+	}
+}
+
+BenchmarkResult runMemoryAllocatorBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "Memory allocator";
+
+	checkSlabs(result);
+	checkBestFit(result);
+	checkMerging(result);
+	checkTransient(result);
+	checkDedicated(result);
+	runStress(result);
+	return result;
+}
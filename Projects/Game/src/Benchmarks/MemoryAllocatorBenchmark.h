@@ -0,0 +1,10 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Runs the memory allocator on a device which allocates host memory, without the GPU. Slab sub-allocation, best fit, merging of
+	free ranges, the reset of transient blocks and dedicated allocations are checked against the expected offsets and device calls,
+	then allocations of random sizes are streamed in and out and checked for overlaps and overwritten data.
+*/
+BenchmarkResult runMemoryAllocatorBenchmark();
@@ -0,0 +1,162 @@
+#include "MeshOptimizerBenchmark.h"
+
+#include "Engine/Core/Scene/MeshOptimizer.h"
+
+#include <glm/gtc/constants.hpp>
+#include <random>
+#include <algorithm>
+#include <tuple>
+
+namespace
+{
+	struct Mesh
+	{
+		std::vector<ym::Vertex> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	// Every triangle gets its own three vertices, the triangles are shuffled to start without any locality.
+	Mesh createUnwelded(std::vector<std::array<ym::Vertex, 3>> triangles, std::mt19937& rng)
+	{
+		std::shuffle(triangles.begin(), triangles.end(), rng);
+		Mesh mesh;
+		for (const std::array<ym::Vertex, 3>& triangle : triangles)
+		{
+			for (const ym::Vertex& vertex : triangle)
+			{
+				mesh.indices.push_back((uint32_t)mesh.vertices.size());
+				mesh.vertices.push_back(vertex);
+			}
+		}
+		return mesh;
+	}
+
+	ym::Vertex makeVertex(const glm::vec3& pos, const glm::vec3& nor, const glm::vec2& uv)
+	{
+		ym::Vertex vertex;
+		vertex.pos = pos;
+		vertex.nor = nor;
+		vertex.uv0 = uv;
+		return vertex;
+	}
+
+	Mesh createGrid(uint32_t size, std::mt19937& rng)
+	{
+		std::vector<std::array<ym::Vertex, 3>> triangles;
+		const glm::vec3 up(0.f, 1.f, 0.f);
+		auto vertex = [&](uint32_t x, uint32_t z) { return makeVertex(glm::vec3((float)x, 0.f, (float)z), up, glm::vec2((float)x, (float)z) / (float)size); };
+		for (uint32_t z = 0; z < size; z++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				triangles.push_back({ vertex(x, z), vertex(x, z + 1), vertex(x + 1, z) });
+				triangles.push_back({ vertex(x + 1, z), vertex(x, z + 1), vertex(x + 1, z + 1) });
+			}
+		}
+		return createUnwelded(triangles, rng);
+	}
+
+	Mesh createSphere(uint32_t rings, uint32_t segments, std::mt19937& rng)
+	{
+		std::vector<std::array<ym::Vertex, 3>> triangles;
+		auto vertex = [&](uint32_t ring, uint32_t segment) {
+			const float theta = glm::pi<float>() * (float)ring / (float)rings;
+			const float phi = glm::two_pi<float>() * (float)(segment % segments) / (float)segments;
+			const glm::vec3 nor(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+			return makeVertex(nor, nor, glm::vec2((float)(segment % segments) / (float)segments, (float)ring / (float)rings));
+		};
+		for (uint32_t ring = 0; ring < rings; ring++)
+		{
+			for (uint32_t segment = 0; segment < segments; segment++)
+			{
+				triangles.push_back({ vertex(ring, segment), vertex(ring, segment + 1), vertex(ring + 1, segment) });
+				triangles.push_back({ vertex(ring, segment + 1), vertex(ring + 1, segment + 1), vertex(ring + 1, segment) });
+			}
+		}
+		return createUnwelded(triangles, rng);
+	}
+
+	// The triangles as positions, rotated so the smallest corner is first, then sorted. Equal lists mean the same triangles with the same winding.
+	std::vector<std::array<float, 9>> getTriangleKeys(const Mesh& mesh)
+	{
+		std::vector<std::array<float, 9>> keys;
+		for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+		{
+			glm::vec3 corners[3] = { mesh.vertices[mesh.indices[t]].pos, mesh.vertices[mesh.indices[t + 1]].pos, mesh.vertices[mesh.indices[t + 2]].pos };
+			uint32_t first = 0;
+			for (uint32_t k = 1; k < 3; k++)
+			{
+				const glm::vec3& a = corners[k];
+				const glm::vec3& b = corners[first];
+				if (std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z))
+					first = k;
+			}
+			std::array<float, 9> key;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				const glm::vec3& corner = corners[(first + k) % 3];
+				key[k * 3 + 0] = corner.x;
+				key[k * 3 + 1] = corner.y;
+				key[k * 3 + 2] = corner.z;
+			}
+			keys.push_back(key);
+		}
+		std::sort(keys.begin(), keys.end());
+		return keys;
+	}
+
+	bool isInFetchOrder(const std::vector<uint32_t>& indices)
+	{
+		uint32_t next = 0;
+		for (uint32_t index : indices)
+		{
+			if (index > next)
+				return false;
+			if (index == next)
+				next++;
+		}
+		return true;
+	}
+
+	void runMesh(const std::string& name, Mesh mesh, BenchmarkResult& result)
+	{
+		char buf[256];
+		const std::vector<std::array<float, 9>> sourceKeys = getTriangleKeys(mesh);
+		auto addStats = [&](const char* step, double ms) {
+			ym::MeshOptimizer::Stats stats = ym::MeshOptimizer::analyze(mesh.indices, (uint32_t)mesh.vertices.size());
+			snprintf(buf, sizeof(buf), "%-8s %-12s %7u vertices, ACMR %.3f, ATVR %.3f (%.2f ms)", name.c_str(), step, stats.vertexCount,
+				stats.getAcmr(), stats.getAtvr(), ms);
+			result.lines.push_back(std::string(buf));
+		};
+
+		addStats("source", 0.0);
+		uint32_t vertexCount = 0;
+		double ms = measureMs([&]() { vertexCount = ym::MeshOptimizer::deduplicateVertices(mesh.vertices, mesh.indices); });
+		addStats("deduplicate", ms);
+		ms = measureMs([&]() { ym::MeshOptimizer::optimizeVertexCache(mesh.indices, vertexCount); });
+		addStats("cache", ms);
+		ms = measureMs([&]() { ym::MeshOptimizer::optimizeOverdraw(mesh.indices, mesh.vertices); });
+		addStats("overdraw", ms);
+		ms = measureMs([&]() { ym::MeshOptimizer::optimizeVertexFetch(mesh.vertices, mesh.indices); });
+		addStats("fetch", ms);
+
+		const bool trianglesKept = getTriangleKeys(mesh) == sourceKeys;
+		const bool fetchOrder = isInFetchOrder(mesh.indices);
+		snprintf(buf, sizeof(buf), "%-8s checks: triangles %s, fetch order %s", name.c_str(), trianglesKept ? "kept" : "NOT kept",
+			fetchOrder ? "ok" : "NOT ok");
+		result.lines.push_back(std::string(buf));
+		check(result, trianglesKept, name + " triangles were changed by the optimization");
+		check(result, fetchOrder, name + " vertices are not in fetch order");
+	}
+}
+
+BenchmarkResult runMeshOptimizerBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "Mesh optimizer";
+
+	std::mt19937 rng(1234);
+	runMesh("Grid", createGrid(128, rng), result);
+	runMesh("Sphere", createSphere(96, 128, rng), result);
+	return result;
+}
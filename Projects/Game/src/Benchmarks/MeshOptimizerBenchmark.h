@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Runs the mesh optimizer on synthetic meshes, a grid and a sphere with unwelded vertices in random triangle order. Reports the
+	ACMR and ATVR after each step and checks that every triangle is kept with its winding and that the vertices are in fetch order.
+*/
+BenchmarkResult runMeshOptimizerBenchmark();
@@ -0,0 +1,99 @@
+#include "ModelCacheBenchmark.h"
+
+#include "Engine/Core/Scene/GLTFLoader.h"
+#include "Engine/Core/Scene/ModelCache.h"
+#include "Engine/Core/Scene/Model/Model.h"
+
+#include <filesystem>
+#include <algorithm>
+
+namespace
+{
+	double load(const std::string& filePath)
+	{
+		ym::Model model;
+		ym::GLTFLoader::StagingBuffers stagingBuffers;
+		double ms = measureMs([&]() { ym::GLTFLoader::loadToRAM(filePath, &model, &stagingBuffers); });
+		stagingBuffers.destroy();
+		model.destroy();
+		return ms;
+	}
+
+	// The small props of the sandbox scene, each is its own .glb file.
+	std::vector<std::string> findScene1Models()
+	{
+		std::vector<std::string> filePaths;
+		std::string folder = YM_ASSETS_FILE_PATH + "Models/Scene1/";
+		if (std::filesystem::exists(folder) == false)
+			return filePaths;
+
+		for (const auto& entry : std::filesystem::directory_iterator(folder))
+		{
+			if (entry.is_regular_file() && entry.path().extension().string() == ".glb")
+				filePaths.push_back(entry.path().generic_string());
+		}
+		std::sort(filePaths.begin(), filePaths.end());
+		return filePaths;
+	}
+}
+
+BenchmarkResult runModelCacheBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "Model cache";
+
+	std::vector<std::string> filePaths = {
+		YM_ASSETS_FILE_PATH + "Models/Sponza/glTF/Sponza.gltf",
+		YM_ASSETS_FILE_PATH + "Models/FlightHelmet/FlightHelmet.gltf"
+	};
+	const std::vector<std::string> scene1 = findScene1Models();
+	filePaths.insert(filePaths.end(), scene1.begin(), scene1.end());
+
+	const bool wasEnabled = ym::ModelCache::isEnabled();
+	char buf[256];
+	double scene1GltfMs = 0.0;
+	double scene1ColdMs = 0.0;
+	double scene1WarmMs = 0.0;
+	for (const std::string& filePath : filePaths)
+	{
+		std::string name = std::filesystem::path(filePath).filename().string();
+		if (std::filesystem::exists(filePath) == false)
+		{
+			result.lines.push_back(name + ": not found");
+			continue;
+		}
+
+		ym::ModelCache::setEnabled(false);
+		double gltfMs = load(filePath);
+
+		ym::ModelCache::setEnabled(true);
+		std::error_code error;
+		std::filesystem::remove(ym::ModelCache::getCachePath(filePath), error);
+		double coldMs = load(filePath);
+		double warmMs = load(filePath);
+
+		uint64_t cacheSize = 0;
+		if (std::filesystem::exists(ym::ModelCache::getCachePath(filePath)))
+			cacheSize = (uint64_t)std::filesystem::file_size(ym::ModelCache::getCachePath(filePath));
+
+		snprintf(buf, sizeof(buf), "%-20s glTF %9.2f ms, cold %9.2f ms, warm %9.2f ms (%.2fx), cache %.1f MB", name.c_str(), gltfMs, coldMs,
+			warmMs, gltfMs / warmMs, (double)cacheSize / (1024.0 * 1024.0));
+		result.lines.push_back(std::string(buf));
+
+		if (std::find(scene1.begin(), scene1.end(), filePath) != scene1.end())
+		{
+			scene1GltfMs += gltfMs;
+			scene1ColdMs += coldMs;
+			scene1WarmMs += warmMs;
+		}
+	}
+	ym::ModelCache::setEnabled(wasEnabled);
+
+	if (scene1.empty() == false)
+	{
+		snprintf(buf, sizeof(buf), "%-20s glTF %9.2f ms, cold %9.2f ms, warm %9.2f ms (%.2fx), %u models", "Scene1 total", scene1GltfMs,
+			scene1ColdMs, scene1WarmMs, scene1GltfMs / scene1WarmMs, (uint32_t)scene1.size());
+		result.lines.push_back(std::string(buf));
+	}
+	return result;
+}
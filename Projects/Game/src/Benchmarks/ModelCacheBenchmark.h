@@ -0,0 +1,10 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Compares loading models to RAM from glTF with loading them from the model cache. The cold load has no cache file and includes
+	writing it, the warm load reads the cache file which was just written. Nothing is submitted to the GPU. Measures Sponza,
+	FlightHelmet and every model of Scene1, with a total for Scene1.
+*/
+BenchmarkResult runModelCacheBenchmark();
@@ -0,0 +1,119 @@
+#include "ModelLoadingBenchmark.h"
+
+#include "Engine/Core/Threading/JobSystem.h"
+#include "Engine/Core/Scene/GLTFLoader.h"
+#include "Engine/Core/Scene/ModelCache.h"
+#include "Engine/Core/Scene/Model/Model.h"
+
+#include <filesystem>
+#include <algorithm>
+
+namespace
+{
+	std::vector<std::string> findModels()
+	{
+		std::vector<std::string> filePaths;
+		std::string folder = YM_ASSETS_FILE_PATH + "Models/";
+		if (std::filesystem::exists(folder) == false)
+			return filePaths;
+
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(folder))
+		{
+			std::string extension = entry.path().extension().string();
+			if (entry.is_regular_file() && (extension == ".gltf" || extension == ".glb"))
+				filePaths.push_back(entry.path().generic_string());
+		}
+		std::sort(filePaths.begin(), filePaths.end());
+		return filePaths;
+	}
+
+	double loadAll(const std::vector<std::string>& filePaths)
+	{
+		std::vector<ym::Model*> models(filePaths.size());
+		std::vector<ym::GLTFLoader::StagingBuffers*> stagingBuffers(filePaths.size());
+		for (size_t i = 0; i < filePaths.size(); i++)
+		{
+			models[i] = new ym::Model();
+			stagingBuffers[i] = new ym::GLTFLoader::StagingBuffers();
+		}
+
+		// One job for each model, the loader adds one job for each image.
+		ym::JobCounter counter;
+		double ms = measureMs([&]() {
+			for (size_t i = 0; i < filePaths.size(); i++)
+			{
+				ym::Model* model = models[i];
+				ym::GLTFLoader::StagingBuffers* staging = stagingBuffers[i];
+				const std::string& filePath = filePaths[i];
+				ym::JobSystem::execute([model, staging, &filePath]() { ym::GLTFLoader::loadToRAM(filePath, model, staging); }, &counter);
+			}
+			ym::JobSystem::wait(&counter);
+		});
+
+		for (size_t i = 0; i < filePaths.size(); i++)
+		{
+			stagingBuffers[i]->destroy();
+			delete stagingBuffers[i];
+			models[i]->destroy();
+			delete models[i];
+		}
+		return ms;
+	}
+}
+
+BenchmarkResult runModelLoadingBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "Model loading";
+
+	std::vector<std::string> filePaths = findModels();
+	if (filePaths.empty())
+	{
+		result.lines.push_back("No models found in " + YM_ASSETS_FILE_PATH + "Models/");
+		return result;
+	}
+
+	// The calling thread helps while waiting, so the number of threads is one more than the number of workers.
+	const uint32_t numWorkers = ym::JobSystem::getWorkerCount();
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t threads = 1; threads < numWorkers + 1; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(numWorkers + 1);
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%u model(s), at most %d image decode(s) in flight", (uint32_t)filePaths.size(), GLTF_MAX_DECODES_IN_FLIGHT);
+	result.lines.push_back(std::string(buf));
+
+	// Every run decodes the glTF files, the cache would only be read after the first run.
+	const bool cacheEnabled = ym::ModelCache::isEnabled();
+	ym::ModelCache::setEnabled(false);
+
+	double singleThreadMs = 0.0;
+	for (uint32_t threads : threadCounts)
+	{
+		ym::JobSystem::destroy();
+		ym::JobSystem::init(threads - 1);
+		ym::GLTFLoader::clearAssetTimings();
+
+		double ms = loadAll(filePaths);
+		if (threads == 1)
+			singleThreadMs = ms;
+
+		snprintf(buf, sizeof(buf), "%2u thread(s): %9.2f ms (%.2fx)", threads, ms, singleThreadMs / ms);
+		result.lines.push_back(std::string(buf));
+	}
+
+	// Per asset timings of the run with all threads.
+	for (const ym::GLTFLoader::AssetTiming& timing : ym::GLTFLoader::getAssetTimings())
+	{
+		std::string name = std::filesystem::path(timing.filePath).filename().string();
+		snprintf(buf, sizeof(buf), "  %-20s %8.2f ms (parse %.2f ms, decode %u texture(s) %.2f ms)", name.c_str(), timing.totalMs,
+			timing.parseMs, timing.textureCount, timing.decodeMs);
+		result.lines.push_back(std::string(buf));
+	}
+
+	ym::ModelCache::setEnabled(cacheEnabled);
+	ym::JobSystem::destroy();
+	ym::JobSystem::init(numWorkers);
+	return result;
+}
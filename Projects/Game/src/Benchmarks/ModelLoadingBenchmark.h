@@ -0,0 +1,10 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Loads every model in Resources/Models to RAM with a different number of threads and compares the wall time. The job system is
+	restarted for each thread count and restored afterwards. Nothing is submitted to the GPU, the models are destroyed before they
+	are uploaded.
+*/
+BenchmarkResult runModelLoadingBenchmark();
@@ -0,0 +1,208 @@
+#include "OcclusionCullingBenchmark.h"
+
+#include "Engine/Core/Graphics/GpuCuller.h"
+#include "Engine/Core/Graphics/DepthPyramid.h"
+#include "Engine/Core/Vulkan/Factory.h"
+#include "Engine/Core/Vulkan/Pipeline/Descriptors.h"
+#include "Engine/Core/Vulkan/CommandPool.h"
+#include "Engine/Core/Application/LayerManager.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+namespace
+{
+	const uint32_t INSTANCE_COUNT = 100000;
+	const uint32_t GROUP_SIZE = 1000;
+	const uint32_t ITERATIONS = 20;
+	const uint32_t WIDTH = 1920;
+	const uint32_t HEIGHT = 1080;
+	const float WALL_DISTANCE = 20.f;
+	const glm::vec2 DOORWAY_EXTENT(0.25f, 0.35f); // Half size of the doorway in normalized device coordinates.
+
+	bool isInDoorway(const glm::vec2& ndc)
+	{
+		return std::abs(ndc.x) < DOORWAY_EXTENT.x && std::abs(ndc.y) < DOORWAY_EXTENT.y;
+	}
+
+	// Exact version of the test in modelCullComp.glsl, against the wall instead of the pyramid.
+	bool isOccluded(const glm::mat4& viewProjection, const glm::mat4& transform, const ym::Bounds& bounds, float wallDepth)
+	{
+		const glm::mat4 mvp = viewProjection * transform;
+		glm::vec3 ndcMin(1.f);
+		glm::vec3 ndcMax(-1.f);
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			glm::vec3 corner((i & 1) ? bounds.max.x : bounds.min.x, (i & 2) ? bounds.max.y : bounds.min.y, (i & 4) ? bounds.max.z : bounds.min.z);
+			glm::vec4 clip = mvp * glm::vec4(corner, 1.f);
+			if (clip.w <= 0.f)
+				return false;
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			ndcMin = glm::min(ndcMin, ndc);
+			ndcMax = glm::max(ndcMax, ndc);
+		}
+		if (ndcMin.z <= 0.f || ndcMin.x < -1.f || ndcMin.y < -1.f || ndcMax.x > 1.f || ndcMax.y > 1.f)
+			return false;
+
+		// The rectangle overlaps the doorway if it is not fully on one side of it.
+		const bool overlapsDoorway = ndcMax.x > -DOORWAY_EXTENT.x && ndcMin.x < DOORWAY_EXTENT.x && ndcMax.y > -DOORWAY_EXTENT.y && ndcMin.y < DOORWAY_EXTENT.y;
+		return overlapsDoorway == false && ndcMin.z > wallDepth;
+	}
+}
+
+BenchmarkResult runOcclusionCullingBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "Occlusion culling";
+
+	std::string reason;
+	if (ym::GpuCuller::isSupported(true, &reason) == false)
+	{
+		result.lines.push_back("Skipped: " + reason);
+		return result;
+	}
+
+	ym::Camera camera;
+	camera.init((float)WIDTH / (float)HEIGHT, glm::radians(60.f), { 0.f, 0.f, 0.f }, { 0.f, 0.f, -1.f }, 1.f, 1.f);
+	const glm::mat4 viewProjection = camera.getMatrix();
+
+	// Depth of a wall which covers the screen except for a doorway in the middle, what an interior looks like through a door.
+	const glm::vec4 wallClip = camera.getProjection() * glm::vec4(0.f, 0.f, -WALL_DISTANCE, 1.f);
+	const float wallDepth = wallClip.z / wallClip.w;
+	std::vector<float> depth(WIDTH * HEIGHT);
+	for (uint32_t y = 0; y < HEIGHT; y++)
+	{
+		for (uint32_t x = 0; x < WIDTH; x++)
+		{
+			glm::vec2 ndc(((float)x + 0.5f) / (float)WIDTH * 2.f - 1.f, ((float)y + 0.5f) / (float)HEIGHT * 2.f - 1.f);
+			depth[y * WIDTH + x] = isInDoorway(ndc) ? 1.f : wallDepth;
+		}
+	}
+
+	// Instances behind the wall, a few of them in front of it.
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> positionX(-150.f, 150.f);
+	std::uniform_real_distribution<float> positionY(-60.f, 60.f);
+	std::uniform_real_distribution<float> positionZ(-300.f, -5.f);
+	std::uniform_real_distribution<float> scale(0.5f, 4.f);
+	std::vector<glm::mat4> transforms(INSTANCE_COUNT);
+	for (glm::mat4& transform : transforms)
+	{
+		transform = glm::translate(glm::mat4(1.f), { positionX(rng), positionY(rng), positionZ(rng) });
+		transform = glm::scale(transform, glm::vec3(scale(rng)));
+	}
+	ym::Bounds bounds;
+	bounds.min = glm::vec3(-0.5f, 0.f, -0.5f);
+	bounds.max = glm::vec3(0.5f, 1.f, 0.5f);
+	bounds.center = (bounds.min + bounds.max) * 0.5f;
+	bounds.radius = glm::length(bounds.max - bounds.center);
+
+	// CPU reference.
+	uint32_t cpuOccluded = 0;
+	for (const glm::mat4& transform : transforms)
+		cpuOccluded += isOccluded(viewProjection, transform, bounds, wallDepth) ? 1 : 0;
+
+	ym::CommandPool* commandPool = &ym::LayerManager::get()->getCommandPools()->graphicsPool;
+	ym::TextureDesc textureDesc = {};
+	textureDesc.width = WIDTH;
+	textureDesc.height = HEIGHT;
+	textureDesc.format = VK_FORMAT_R32_SFLOAT;
+	textureDesc.data = depth.data();
+	ym::Texture* depthTexture = ym::Factory::createTexture(textureDesc, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_QUEUE_GRAPHICS_BIT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	ym::Factory::transferData(depthTexture, commandPool);
+
+	ym::DepthPyramid pyramid;
+	pyramid.init(WIDTH, HEIGHT);
+	pyramid.setDepth(depthTexture->imageView.getImageView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	// The transforms are read from a buffer like the instance buffer of the ModelRenderer.
+	ym::RingBuffer transformBuffer;
+	transformBuffer.init(sizeof(glm::mat4) * INSTANCE_COUNT, 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	memcpy(transformBuffer.getData(0), transforms.data(), sizeof(glm::mat4) * INSTANCE_COUNT);
+
+	ym::DescriptorLayout instanceLayout;
+	instanceLayout.add(new ym::SSBO(VK_SHADER_STAGE_VERTEX_BIT));
+	instanceLayout.init();
+
+	ym::GpuCuller culler;
+	culler.init(1, instanceLayout, true);
+	culler.setTransforms(transformBuffer.getDescriptor());
+
+	struct Run
+	{
+		double gpuMs{ 0.0 };
+		uint32_t visible{ 0 };
+		uint32_t tested{ 0 };
+		uint32_t occluded{ 0 };
+		uint32_t commands{ 0 };
+		uint32_t draws{ 0 };
+	} runs[2];
+	double pyramidMs = 0.0;
+	for (uint32_t r = 0; r < 2; r++)
+	{
+		const bool occlusion = r == 1;
+		culler.setOcclusion(occlusion ? &pyramid : nullptr, viewProjection);
+		for (uint32_t i = 0; i < ITERATIONS; i++)
+		{
+			culler.begin(0, camera.getPlanes(), INSTANCE_COUNT);
+			for (uint32_t g = 0; g < INSTANCE_COUNT / GROUP_SIZE; g++)
+			{
+				culler.addBatch();
+				uint32_t group = culler.addGroup(bounds, g * GROUP_SIZE, GROUP_SIZE);
+				culler.addCommand(group, 36, 0, 0, true);
+			}
+			culler.end();
+
+			// Includes the submit and the wait for the queue.
+			if (occlusion)
+			{
+				pyramidMs += measureMs([&]() {
+					ym::CommandBuffer* commandBuffer = commandPool->beginSingleTimeCommand();
+					pyramid.record(commandBuffer);
+					commandPool->endSingleTimeCommand(commandBuffer);
+				});
+			}
+			runs[r].gpuMs += measureMs([&]() {
+				ym::CommandBuffer* commandBuffer = commandPool->beginSingleTimeCommand();
+				culler.record(commandBuffer);
+				commandPool->endSingleTimeCommand(commandBuffer);
+			});
+		}
+		runs[r].gpuMs /= ITERATIONS;
+
+		// The counts of the last run are read back when the frame begins again.
+		culler.begin(0, camera.getPlanes(), INSTANCE_COUNT);
+		runs[r].visible = culler.getLastVisibleCount();
+		runs[r].tested = culler.getLastTestedCount();
+		runs[r].occluded = culler.getLastOccludedCount();
+		runs[r].commands = culler.getLastCommandCount();
+		runs[r].draws = culler.getLastDrawCount();
+	}
+	pyramidMs /= ITERATIONS;
+
+	culler.destroy();
+	instanceLayout.destroy();
+	transformBuffer.destroy();
+	pyramid.destroy();
+	depthTexture->destroy();
+	delete depthTexture;
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%u instances in %u groups, %u levels for %ux%u, %u occluded on the CPU", INSTANCE_COUNT,
+		INSTANCE_COUNT / GROUP_SIZE, pyramid.getLevelCount(), WIDTH, HEIGHT, cpuOccluded);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "Frustum only    %6u visible, %3u of %3u draws, cull %8.3f ms", runs[0].visible, runs[0].draws, runs[0].commands, runs[0].gpuMs);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "With occlusion  %6u visible, %3u of %3u draws, cull %8.3f ms, pyramid %8.3f ms", runs[1].visible, runs[1].draws,
+		runs[1].commands, runs[1].gpuMs, pyramidMs);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "Occlusion       %6u tested, %6u occluded (%.1f%% of the exact test)", runs[1].tested, runs[1].occluded,
+		cpuOccluded > 0 ? 100.f * (float)runs[1].occluded / (float)cpuOccluded : 0.f);
+	result.lines.push_back(std::string(buf));
+
+	// The pyramid is conservative, it can only hide instances which the exact test hides.
+	check(result, runs[0].occluded == 0, "Instances were occluded without a depth pyramid");
+	check(result, runs[1].occluded <= cpuOccluded, "The depth pyramid occluded more instances than the exact test");
+	check(result, runs[1].visible + runs[1].occluded == runs[0].visible, "Occluded and visible instances do not add up to the frustum culling");
+	return result;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Culls randomly placed instances behind a wall with a doorway, once against the frustum only and once with the depth pyramid of the
+	wall, and compares the occluded instances against an exact test of the depth on the CPU. Skipped when the device or the compiled
+	shaders do not support the occlusion culling.
+*/
+BenchmarkResult runOcclusionCullingBenchmark();
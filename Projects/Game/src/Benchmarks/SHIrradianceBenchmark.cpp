@@ -0,0 +1,124 @@
+#include "SHIrradianceBenchmark.h"
+
+#include "Engine/Core/Graphics/IBLFunctions.h"
+#include "Engine/Core/Graphics/SphericalHarmonics.h"
+
+#include <glm/gtc/constants.hpp>
+
+namespace
+{
+	// One texel at a time, the same weights as the SSE projection.
+	ym::SH9 projectScalar(const float* data, uint32_t size)
+	{
+		float basis[SH_COEFFICIENT_COUNT];
+		glm::vec3 sums[SH_COEFFICIENT_COUNT] = {};
+		float weightSum = 0.f;
+		for (uint32_t face = 0; face < 6; face++)
+		{
+			for (uint32_t y = 0; y < size; y++)
+			{
+				for (uint32_t x = 0; x < size; x++)
+				{
+					const float s = ((float)x + 0.5f) * 2.f / (float)size - 1.f;
+					const float t = ((float)y + 0.5f) * 2.f / (float)size - 1.f;
+					const float lengthSq = 1.f + s * s + t * t;
+					const float weight = 1.f / (lengthSq * std::sqrt(lengthSq));
+					weightSum += weight;
+
+					ym::SphericalHarmonics::getBasis(ym::SphericalHarmonics::getTexelDirection(face, x, y, size), basis);
+					const float* texel = data + (((size_t)face * size + y) * size + x) * 4;
+					const glm::vec3 radiance(texel[0], texel[1], texel[2]);
+					for (uint32_t k = 0; k < SH_COEFFICIENT_COUNT; k++)
+						sums[k] += radiance * (basis[k] * weight);
+				}
+			}
+		}
+
+		ym::SH9 sh;
+		const float scale = 4.f * glm::pi<float>() / weightSum;
+		for (uint32_t k = 0; k < SH_COEFFICIENT_COUNT; k++)
+			sh.coefficients[k] = glm::vec4(sums[k] * scale, 0.f);
+		ym::SphericalHarmonics::convolveCosineLobe(sh);
+		return sh;
+	}
+}
+
+BenchmarkResult runSHIrradianceBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "SH irradiance";
+
+	ym::Texture* hdrTexture = ym::IBLFunctions::loadEquirectangularTexture(YM_ASSETS_FILE_PATH + "Textures/HDRs/arches.hdr");
+	if (hdrTexture == nullptr)
+	{
+		result.lines.push_back("arches.hdr: not found");
+		return result;
+	}
+
+	const uint32_t environmentMipLevels = ym::IBLFunctions::getMipLevels(IBL_ENVIRONMENT_SIZE);
+	ym::Texture* environment = ym::IBLFunctions::convertEquirectangularToCubemap(IBL_ENVIRONMENT_SIZE, hdrTexture, environmentMipLevels);
+	std::pair<ym::Texture*, ym::Texture*> irrAndPref = ym::IBLFunctions::createIrradianceAndPrefilteredMap(environment);
+	const uint32_t mipLevel = environmentMipLevels - ym::IBLFunctions::getMipLevels(SH_PROJECTION_SIZE);
+	std::vector<float> environmentFaces = ym::IBLFunctions::readCubeMap(environment, mipLevel);
+	std::vector<float> irradianceFaces = ym::IBLFunctions::readCubeMap(irrAndPref.first, 0);
+	const uint64_t irradianceBytes = (uint64_t)irradianceFaces.size() * sizeof(float) * 4 / 3; // Including the mip chain.
+
+	ym::Texture* textures[] = { hdrTexture, environment, irrAndPref.first, irrAndPref.second };
+	for (ym::Texture* texture : textures)
+	{
+		texture->destroy();
+		delete texture;
+	}
+
+	const uint32_t iterations = 20;
+	ym::SH9 sh;
+	ym::SH9 scalarSh;
+	double sseMs = measureMs([&]() {
+		for (uint32_t i = 0; i < iterations; i++)
+			sh = ym::SphericalHarmonics::projectCubeMap(environmentFaces.data(), SH_PROJECTION_SIZE);
+	}) / iterations;
+	double scalarMs = measureMs([&]() {
+		for (uint32_t i = 0; i < iterations; i++)
+			scalarSh = projectScalar(environmentFaces.data(), SH_PROJECTION_SIZE);
+	}) / iterations;
+
+	float maxCoefficientDifference = 0.f;
+	for (uint32_t k = 0; k < SH_COEFFICIENT_COUNT; k++)
+	{
+		const glm::vec3 difference = glm::abs(glm::vec3(sh.coefficients[k] - scalarSh.coefficients[k]));
+		maxCoefficientDifference = std::max(maxCoefficientDifference, std::max(difference.x, std::max(difference.y, difference.z)));
+	}
+
+	// Relative error of the luminance against every texel of the irradiance cube map.
+	const glm::vec3 luminanceWeights(0.2126f, 0.7152f, 0.0722f);
+	double errorSum = 0.0;
+	double maxError = 0.0;
+	uint64_t texelCount = 0;
+	for (uint32_t face = 0; face < 6; face++)
+	{
+		for (uint32_t y = 0; y < IBL_IRRADIANCE_SIZE; y++)
+		{
+			for (uint32_t x = 0; x < IBL_IRRADIANCE_SIZE; x++)
+			{
+				const float* texel = irradianceFaces.data() + (((size_t)face * IBL_IRRADIANCE_SIZE + y) * IBL_IRRADIANCE_SIZE + x) * 4;
+				const float reference = glm::dot(glm::vec3(texel[0], texel[1], texel[2]), luminanceWeights);
+				const glm::vec3 n = ym::SphericalHarmonics::getTexelDirection(face, x, y, IBL_IRRADIANCE_SIZE);
+				const float evaluated = glm::dot(ym::SphericalHarmonics::evaluate(sh, n), luminanceWeights);
+				const double error = std::abs((double)evaluated - (double)reference) / std::max((double)reference, 1e-4);
+				errorSum += error;
+				maxError = std::max(maxError, error);
+				texelCount++;
+			}
+		}
+	}
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "Projection %ux%u: SSE %.3f ms, scalar %.3f ms (%.2fx), max coefficient difference %.2e",
+		SH_PROJECTION_SIZE, SH_PROJECTION_SIZE, sseMs, scalarMs, scalarMs / sseMs, maxCoefficientDifference);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "Error against irradiance cube: mean %.2f%%, max %.2f%%", errorSum / (double)texelCount * 100.0, maxError * 100.0);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "Memory: irradiance cube %llu KB, SH %llu bytes", (unsigned long long)(irradianceBytes / 1024), (unsigned long long)sizeof(ym::SH9));
+	result.lines.push_back(std::string(buf));
+	return result;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Compares the spherical harmonics irradiance against the rendered irradiance cube map, and the SSE projection against a scalar
+	projection of the same environment mip level.
+*/
+BenchmarkResult runSHIrradianceBenchmark();
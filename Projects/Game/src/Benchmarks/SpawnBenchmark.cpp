@@ -0,0 +1,126 @@
+#include "SpawnBenchmark.h"
+
+#include "Engine/Core/Scene/ObjectManager.h"
+#include "Engine/Core/Scene/GameObject.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Small deterministic generator, the runs should be comparable.
+	uint32_t nextRandom(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	glm::mat4 randomTransform(uint32_t& state)
+	{
+		float x = (float)(nextRandom(state) % 2000) / 100.f - 10.f;
+		float y = (float)(nextRandom(state) % 1000) / 100.f - 3.f;
+		float z = (float)(nextRandom(state) % 2000) / 100.f + 5.f;
+		glm::mat4 transform = glm::scale(glm::mat4(1.f), glm::vec3(0.1f));
+		return glm::translate(glm::mat4(1.f), { x, y, z }) * transform;
+	}
+
+	uint32_t g_randomState = 1;
+}
+
+void SpawnBenchmark::start(ym::Model* model, uint32_t objectCount, uint32_t frameCount)
+{
+	stop();
+
+	this->model = model;
+	this->objectCount = objectCount;
+	this->frameCount = frameCount;
+	this->frame = 0;
+	this->spawned = 0;
+	this->destroyed = 0;
+	this->frameTimes.clear();
+	this->frameTimes.reserve(frameCount);
+	this->running = true;
+	g_randomState = 1;
+}
+
+void SpawnBenchmark::update(double previousFrameMs)
+{
+	if (this->running == false)
+		return;
+
+	// The first frame was not affected by the benchmark.
+	if (this->frame > 0)
+		this->frameTimes.push_back(previousFrameMs);
+
+	if ((uint32_t)this->frameTimes.size() >= this->frameCount)
+	{
+		stop();
+		return;
+	}
+
+	ym::ObjectManager* objectManager = ym::ObjectManager::get();
+
+	// Destroy a random part of the objects.
+	uint32_t destroyCount = (uint32_t)this->objects.size() / 4 + nextRandom(g_randomState) % 16;
+	destroyCount = std::min(destroyCount, (uint32_t)this->objects.size());
+	for (uint32_t i = 0; i < destroyCount; i++)
+	{
+		uint32_t index = nextRandom(g_randomState) % (uint32_t)this->objects.size();
+		objectManager->removeGameObject(this->objects[index]);
+		this->objects[index] = this->objects.back();
+		this->objects.pop_back();
+	}
+	this->destroyed += destroyCount;
+
+	// Spawn new objects, the target count changes every frame so that the number of instances is never the same.
+	uint32_t target = this->objectCount / 2 + nextRandom(g_randomState) % (this->objectCount / 2 + 1);
+	while ((uint32_t)this->objects.size() < target)
+	{
+		this->objects.push_back(objectManager->createGameObject(randomTransform(g_randomState), this->model));
+		this->spawned++;
+	}
+
+	this->frame++;
+}
+
+void SpawnBenchmark::stop()
+{
+	for (ym::GameObject* object : this->objects)
+		ym::ObjectManager::get()->removeGameObject(object);
+	this->destroyed += this->objects.size();
+	this->objects.clear();
+	this->running = false;
+}
+
+bool SpawnBenchmark::isRunning() const
+{
+	return this->running;
+}
+
+BenchmarkResult SpawnBenchmark::getResult() const
+{
+	BenchmarkResult result;
+	result.name = "Spawn/destroy game objects";
+
+	if (this->frameTimes.empty())
+	{
+		result.lines.push_back(this->running ? "Running..." : "Waiting for the model to load...");
+		return result;
+	}
+
+	std::vector<double> sorted = this->frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	double sum = 0.0;
+	for (double ms : sorted)
+		sum += ms;
+
+	auto percentile = [&sorted](double p) { return sorted[std::min((size_t)(p * (double)sorted.size()), sorted.size() - 1)]; };
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "Frames: %u, objects: %u to %u, spawned: %llu, destroyed: %llu", (uint32_t)sorted.size(),
+		this->objectCount / 2, this->objectCount, (unsigned long long)this->spawned, (unsigned long long)this->destroyed);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "CPU frame time avg %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms",
+		sum / (double)sorted.size(), percentile(0.5), percentile(0.99), sorted.back());
+	result.lines.push_back(std::string(buf));
+	return result;
+}
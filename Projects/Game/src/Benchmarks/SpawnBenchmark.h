@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Benchmark.h"
+
+namespace ym
+{
+	class Model;
+	class GameObject;
+}
+
+/*
+	Spawns and destroys game objects every frame so that the number of instances of the model changes each frame, and records the
+	CPU time of the frames. Unlike the other benchmarks this one runs over several frames, call update() once per frame.
+*/
+class SpawnBenchmark
+{
+public:
+	void start(ym::Model* model, uint32_t objectCount, uint32_t frameCount);
+
+	// Spawn and destroy objects for this frame. The CPU time of the previous frame is added to the results.
+	void update(double previousFrameMs);
+	void stop();
+
+	bool isRunning() const;
+	BenchmarkResult getResult() const;
+
+private:
+	ym::Model* model{ nullptr };
+	std::vector<ym::GameObject*> objects;
+	std::vector<double> frameTimes;
+	uint32_t objectCount{ 0 };
+	uint32_t frameCount{ 0 };
+	uint32_t frame{ 0 };
+	bool running{ false };
+	uint64_t spawned{ 0 };
+	uint64_t destroyed{ 0 };
+};
@@ -0,0 +1,182 @@
+#include "StreamingBenchmark.h"
+
+#include "Engine/Core/Scene/GLTFLoader.h"
+#include "Engine/Core/Scene/Model/Model.h"
+#include "Engine/Core/Vulkan/VulkanInstance.h"
+
+#include <algorithm>
+
+void StreamingBenchmark::start(const std::vector<std::string>& filePaths, uint32_t framesAfterLoad, bool bindlessMaterials)
+{
+	stop();
+
+	this->filePaths = filePaths;
+	this->framesAfterLoad = framesAfterLoad;
+	this->bindlessMaterials = bindlessMaterials;
+	this->frame = 0;
+	this->loadedFrame = 0;
+	this->frameTimes.clear();
+	this->descriptorWrites.clear();
+	this->isStreaming.clear();
+	this->running = true;
+}
+
+void StreamingBenchmark::update(double previousFrameMs, uint32_t previousDescriptorWrites)
+{
+	if (this->running == false)
+		return;
+
+	// The first frame was not affected by the benchmark.
+	if (this->frame > 0)
+	{
+		this->frameTimes.push_back((float)previousFrameMs);
+		this->descriptorWrites.push_back(previousDescriptorWrites);
+		this->isStreaming.push_back(this->loadedFrame == 0);
+	}
+	else
+	{
+		for (const std::string& filePath : this->filePaths)
+		{
+			this->models.push_back(new ym::Model());
+			ym::GLTFLoader::loadOnThread(filePath, this->models.back());
+		}
+	}
+
+	if (this->loadedFrame == 0 && hasLoaded())
+		this->loadedFrame = this->frame;
+
+	if (this->loadedFrame > 0 && this->frame >= this->loadedFrame + this->framesAfterLoad)
+	{
+		stop();
+		return;
+	}
+
+	this->frame++;
+}
+
+void StreamingBenchmark::stop()
+{
+	// The loaded models have been drawn, the frames in flight can still use them.
+	if (this->models.empty() == false)
+		vkDeviceWaitIdle(ym::VulkanInstance::get()->getLogicalDevice());
+
+	std::vector<ym::Model*> loading;
+	for (ym::Model* model : this->models)
+	{
+		if (model->hasLoaded)
+		{
+			model->destroy();
+			delete model;
+		}
+		else
+			loading.push_back(model);
+	}
+	if (loading.empty() == false)
+		YM_LOG_WARN("Streaming benchmark stopped while {} model(s) were loading.", loading.size());
+	this->models.clear();
+	this->running = false;
+}
+
+bool StreamingBenchmark::isRunning() const
+{
+	return this->running;
+}
+
+BenchmarkResult StreamingBenchmark::getResult() const
+{
+	BenchmarkResult result;
+	result.name = "Model streaming";
+
+	if (this->frameTimes.empty())
+	{
+		result.lines.push_back(this->running ? "Running..." : "Not started.");
+		return result;
+	}
+
+	auto summarize = [&](const char* label, bool streaming) {
+		std::vector<float> sorted;
+		for (size_t i = 0; i < this->frameTimes.size(); i++)
+		{
+			if (this->isStreaming[i] == streaming)
+				sorted.push_back(this->frameTimes[i]);
+		}
+		if (sorted.empty())
+			return;
+
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0.0;
+		for (float ms : sorted)
+			sum += ms;
+		float p99 = sorted[std::min((size_t)(0.99 * (double)sorted.size()), sorted.size() - 1)];
+
+		char buf[256];
+		snprintf(buf, sizeof(buf), "%s: %u frames, avg %.3f ms, p99 %.3f ms, max %.3f ms", label, (uint32_t)sorted.size(),
+			sum / (double)sorted.size(), p99, sorted.back());
+		result.lines.push_back(std::string(buf));
+	};
+	summarize("While streaming", true);
+	summarize("After loading", false);
+
+	uint32_t totalWrites = 0;
+	uint32_t maxWrites = 0;
+	for (uint32_t writes : this->descriptorWrites)
+	{
+		totalWrites += writes;
+		maxWrites = std::max(maxWrites, writes);
+	}
+	char writesBuf[256];
+	snprintf(writesBuf, sizeof(writesBuf), "Descriptor writes (bindless materials %s): total %u, max %u per frame",
+		this->bindlessMaterials ? "on" : "off", totalWrites, maxWrites);
+	result.lines.push_back(std::string(writesBuf));
+
+	// Count of frames in each bucket, the buckets double in size.
+	const float bucketLimits[] = { 2.f, 4.f, 8.f, 16.f, 33.f, 66.f };
+	const uint32_t bucketCount = sizeof(bucketLimits) / sizeof(bucketLimits[0]);
+	uint32_t counts[bucketCount + 1] = {};
+	for (float ms : this->frameTimes)
+	{
+		uint32_t bucket = 0;
+		while (bucket < bucketCount && ms >= bucketLimits[bucket])
+			bucket++;
+		counts[bucket]++;
+	}
+
+	std::string histogram = "Histogram:";
+	char buf[64];
+	for (uint32_t i = 0; i <= bucketCount; i++)
+	{
+		if (i < bucketCount)
+			snprintf(buf, sizeof(buf), " <%.0f ms: %u", bucketLimits[i], counts[i]);
+		else
+			snprintf(buf, sizeof(buf), " >=%.0f ms: %u", bucketLimits[bucketCount - 1], counts[i]);
+		histogram += buf;
+	}
+	result.lines.push_back(histogram);
+	return result;
+}
+
+const std::vector<float>& StreamingBenchmark::getFrameTimes() const
+{
+	return this->frameTimes;
+}
+
+std::vector<ym::Model*> StreamingBenchmark::getLoadedModels() const
+{
+	std::vector<ym::Model*> loaded;
+	for (ym::Model* model : this->models)
+	{
+		if (model->hasLoaded)
+			loaded.push_back(model);
+	}
+	return loaded;
+}
+
+bool StreamingBenchmark::hasLoaded() const
+{
+	for (ym::Model* model : this->models)
+	{
+		if (model->hasLoaded == false)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Benchmark.h"
+
+namespace ym
+{
+	class Model;
+}
+
+/*
+	Loads models on a thread while the frames are rendered, and records the CPU time of every frame to show if the uploads cause
+	spikes. Like the spawn benchmark it runs over several frames, call update() once per frame. The loaded models are drawn, the
+	descriptor writes of each frame show the cost of adding new models to the renderer.
+*/
+class StreamingBenchmark
+{
+public:
+	// bindlessMaterials is only used to label the descriptor writes.
+	void start(const std::vector<std::string>& filePaths, uint32_t framesAfterLoad, bool bindlessMaterials);
+
+	// Load the models on the first frame. The CPU time and descriptor writes of the previous frame are added to the results.
+	void update(double previousFrameMs, uint32_t previousDescriptorWrites);
+
+	// Models which have not finished loading are left to the loader, they cannot be destroyed before they have been uploaded.
+	void stop();
+
+	bool isRunning() const;
+	BenchmarkResult getResult() const;
+
+	// CPU frame times in the order they were recorded, used to plot the frames.
+	const std::vector<float>& getFrameTimes() const;
+
+	// Models which have finished loading and can be drawn.
+	std::vector<ym::Model*> getLoadedModels() const;
+
+private:
+	bool hasLoaded() const;
+
+	std::vector<std::string> filePaths;
+	std::vector<ym::Model*> models;
+	std::vector<float> frameTimes;
+	std::vector<uint32_t> descriptorWrites;
+	std::vector<bool> isStreaming;
+	uint32_t framesAfterLoad{ 0 };
+	uint32_t frame{ 0 };
+	uint32_t loadedFrame{ 0 };
+	bool bindlessMaterials{ false };
+	bool running{ false };
+};
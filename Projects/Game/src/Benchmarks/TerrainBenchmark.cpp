@@ -0,0 +1,194 @@
+#include "TerrainBenchmark.h"
+
+#include "Engine/Core/Scene/Terrain/Terrain.h"
+#include "Engine/Core/Graphics/TerrainRenderer.h"
+#include "Engine/Core/Camera.h"
+#include <glTF/stb_image.h>
+
+#include <filesystem>
+#include <algorithm>
+
+namespace
+{
+	const uint32_t FLIGHT_STEPS = 240;		// Frames of the camera path.
+	const float VERTEX_DISTANCE = 2.f;		// Distance between the samples, the same as the sandbox.
+	const float HEIGHT_SCALE = 20.f;		// Height of the highest sample of the australia heightmap.
+	const float FLIGHT_HEIGHT = 30.f;		// Height of the camera above the terrain.
+	const uint32_t UPSAMPLE_FACTOR = 32;	// The 512 x 512 heightmap becomes 16353 x 16353 samples.
+
+	struct FlightStats
+	{
+		double selectMs{ 0.0 };
+		double maxSelectMs{ 0.0 };
+		uint64_t nodes{ 0 };
+		uint64_t triangles{ 0 };
+		uint64_t fallbacks{ 0 };
+		uint64_t parts{ 0 };	// Whole nodes and quarters, each is one candidate of the GPU culling.
+		ym::TerrainTiles::Stats tiles;
+	};
+
+	// The camera flies along the diagonal of the map, looking ahead and slightly down. The loaded tiles are taken each frame, the
+	// same as the renderer does, at most TERRAIN_MAX_UPLOADS_PER_FRAME of them. With gpuCulling the selection leaves the culling of
+	// the finer levels to the GPU, the same as Terrain/gpuCulling.
+	FlightStats fly(ym::Terrain& terrain, bool gpuCulling = false)
+	{
+		ym::TerrainTiles& tiles = terrain.getTiles();
+		const glm::vec3 origin = terrain.getOrigin();
+		const glm::vec2 size = glm::vec2((float)(tiles.getWidth() - 1), (float)(tiles.getHeight() - 1)) * terrain.getDescription().vertDist;
+		const glm::vec3 direction = glm::normalize(glm::vec3(size.x, 0.f, size.y));
+
+		FlightStats stats;
+		ym::Camera camera;
+		ym::Terrain::Selection selection;
+		std::vector<ym::TerrainTiles::LoadedTile> loadedTiles;
+		for (uint32_t step = 0; step < FLIGHT_STEPS; step++)
+		{
+			const float t = 0.05f + 0.9f * (float)step / (float)(FLIGHT_STEPS - 1);
+			glm::vec3 position = origin + glm::vec3(size.x * t, 0.f, size.y * t);
+			position.y = terrain.getHeightAt(position) + FLIGHT_HEIGHT;
+			camera.init(16.f / 9.f, glm::radians(60.f), position, position + direction - glm::vec3(0.f, 0.2f, 0.f), 1.f, 1.f);
+
+			double ms = measureMs([&]() { terrain.select(position, camera.getPlanes(), selection, gpuCulling); });
+			stats.selectMs += ms;
+			stats.maxSelectMs = std::max(stats.maxSelectMs, ms);
+			stats.nodes += selection.nodes.size();
+			stats.triangles += selection.triangleCount;
+			stats.fallbacks += selection.fallbackCount;
+			for (const ym::Terrain::Node& node : selection.nodes)
+			{
+				uint32_t quarters = node.quarters;
+				uint32_t quarterCount = 0;
+				for (; quarters != 0; quarters >>= 1)
+					quarterCount += quarters & 1;
+				stats.parts += node.quarters == 0xF ? 1 : quarterCount;
+			}
+
+			loadedTiles.clear();
+			tiles.takeLoadedTiles(TERRAIN_MAX_UPLOADS_PER_FRAME, loadedTiles);
+		}
+		tiles.waitForLoads();
+		stats.tiles = tiles.getStats();
+		return stats;
+	}
+
+	void addFlightLines(const std::string& name, ym::Terrain& terrain, const FlightStats& stats, BenchmarkResult& result)
+	{
+		const ym::TerrainTiles& tiles = terrain.getTiles();
+		const double fullTriangles = (double)(tiles.getWidth() - 1) * (double)(tiles.getHeight() - 1) * 2.0;
+		char buf[256];
+		snprintf(buf, sizeof(buf), "%-10s %5u x %-5u select %.3f ms avg, %.3f ms max, %.0f nodes, %.3fM triangles per frame (full grid %.1fM)",
+			name.c_str(), tiles.getWidth(), tiles.getHeight(), stats.selectMs / FLIGHT_STEPS, stats.maxSelectMs, (double)stats.nodes / FLIGHT_STEPS,
+			(double)stats.triangles / FLIGHT_STEPS / 1e6, fullTriangles / 1e6);
+		result.lines.push_back(std::string(buf));
+		snprintf(buf, sizeof(buf), "%-10s %u levels, %u tiles, %u resident, %llu loaded, %llu evicted, %.1f%% of the nodes drawn with a coarser tile",
+			name.c_str(), tiles.getLodCount(), tiles.getTileCount(), stats.tiles.residentCount, (unsigned long long)stats.tiles.loadCount,
+			(unsigned long long)stats.tiles.evictionCount, stats.nodes > 0 ? (double)stats.fallbacks * 100.0 / (double)stats.nodes : 0.0);
+		result.lines.push_back(std::string(buf));
+	}
+
+	uint64_t getFileSize(const std::string& path)
+	{
+		std::error_code error;
+		uint64_t size = (uint64_t)std::filesystem::file_size(path, error);
+		return error ? 0 : size;
+	}
+}
+
+BenchmarkResult runTerrainBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "Terrain";
+
+	int width, height, channels;
+	std::string path = YM_ASSETS_FILE_PATH + "/Textures/Heightmaps/australia.jpg";
+	unsigned char* data = static_cast<unsigned char*>(stbi_load(path.c_str(), &width, &height, &channels, 1));
+	if (data == nullptr)
+	{
+		result.lines.push_back("australia.jpg: not found");
+		return result;
+	}
+
+	ym::Terrain::Description description = {};
+	description.vertDist = VERTEX_DISTANCE;
+	description.minZ = 0.f;
+	description.maxZ = HEIGHT_SCALE;
+	description.origin = glm::vec3(0.f);
+
+	// Heightmap in memory, the tiles are generated from it when they are loaded.
+	{
+		ym::Terrain terrain;
+		terrain.init((uint32_t)width, (uint32_t)height, data, description);
+		FlightStats stats = fly(terrain);
+		addFlightLines("Memory", terrain, stats, result);
+
+		// The same flight when the finer levels are culled on the GPU, the CPU only selects and the GPU tests every part.
+		FlightStats gpuStats = fly(terrain, true);
+		char line[256];
+		snprintf(line, sizeof(line), "%-10s select %.3f ms avg (%.3f ms with CPU culling), %.0f parts tested on the GPU per frame (%.0f drawn with CPU culling)",
+			"GPU cull", gpuStats.selectMs / FLIGHT_STEPS, stats.selectMs / FLIGHT_STEPS, (double)gpuStats.parts / FLIGHT_STEPS, (double)stats.parts / FLIGHT_STEPS);
+		result.lines.push_back(std::string(line));
+		terrain.destroy();
+	}
+
+	// The same heightmap streamed from a baked tile file.
+	char buf[256];
+	const std::string tempDirectory = std::filesystem::temp_directory_path().string();
+	{
+		const std::string tilePath = tempDirectory + "/australia" + TERRAIN_TILE_EXTENSION;
+		double bakeMs = measureMs([&]() { ym::TerrainTiles::bake(tilePath, (uint32_t)width, (uint32_t)height, data); });
+		snprintf(buf, sizeof(buf), "%-10s baked in %.2f ms, %.1f MB", "File", bakeMs, (double)getFileSize(tilePath) / (1024.0 * 1024.0));
+		result.lines.push_back(std::string(buf));
+
+		ym::Terrain terrain;
+		if (terrain.init(tilePath, description))
+		{
+			FlightStats stats = fly(terrain);
+			addFlightLines("File", terrain, stats, result);
+			terrain.destroy();
+		}
+		else
+			result.lines.push_back("File: could not open the baked tiles");
+		std::error_code error;
+		std::filesystem::remove(tilePath, error);
+	}
+
+	// Upsampled to about 16k x 16k, the rows are interpolated while baking so the full map is never in memory.
+	{
+		const uint32_t largeWidth = (uint32_t)(width - 1) * UPSAMPLE_FACTOR + 1;
+		const uint32_t largeHeight = (uint32_t)(height - 1) * UPSAMPLE_FACTOR + 1;
+		const std::string tilePath = tempDirectory + "/australia16k" + TERRAIN_TILE_EXTENSION;
+		auto readRow = [&](uint32_t z, uint16_t* row) {
+			const uint32_t z0 = std::min(z / UPSAMPLE_FACTOR, (uint32_t)height - 2);
+			const float fz = (float)(z - z0 * UPSAMPLE_FACTOR) / (float)UPSAMPLE_FACTOR;
+			for (uint32_t x = 0; x < largeWidth; x++)
+			{
+				const uint32_t x0 = std::min(x / UPSAMPLE_FACTOR, (uint32_t)width - 2);
+				const float fx = (float)(x - x0 * UPSAMPLE_FACTOR) / (float)UPSAMPLE_FACTOR;
+				const unsigned char* p = data + (size_t)z0 * width + x0;
+				const float top = p[0] + (p[1] - p[0]) * fx;
+				const float bottom = p[width] + (p[width + 1] - p[width]) * fx;
+				row[x] = (uint16_t)((top + (bottom - top) * fz) * 257.f + 0.5f);
+			}
+		};
+		double bakeMs = measureMs([&]() { ym::TerrainTiles::bake(tilePath, largeWidth, largeHeight, readRow); });
+		snprintf(buf, sizeof(buf), "%-10s baked in %.0f ms, %.1f MB", "16k", bakeMs, (double)getFileSize(tilePath) / (1024.0 * 1024.0));
+		result.lines.push_back(std::string(buf));
+
+		ym::Terrain::Description largeDescription = description;
+		largeDescription.maxZ = HEIGHT_SCALE * (float)UPSAMPLE_FACTOR;
+		ym::Terrain terrain;
+		if (terrain.init(tilePath, largeDescription))
+		{
+			FlightStats stats = fly(terrain);
+			addFlightLines("16k", terrain, stats, result);
+			terrain.destroy();
+		}
+		else
+			result.lines.push_back("16k: could not open the baked tiles");
+		std::error_code error;
+		std::filesystem::remove(tilePath, error);
+	}
+
+	stbi_image_free(data);
+	return result;
+}
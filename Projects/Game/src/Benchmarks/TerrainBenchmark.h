@@ -0,0 +1,10 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Flies a camera across the australia heightmap and reports the node selection time, the nodes and triangles drawn per frame and
+	the tile streaming, once with the heightmap in memory and once streamed from a baked tile file. The heightmap is then upsampled
+	to about 16k x 16k samples and baked one row at a time, to show that the selection time stays flat as the map grows.
+*/
+BenchmarkResult runTerrainBenchmark();
@@ -0,0 +1,177 @@
+#include "TerrainQueryBenchmark.h"
+
+#include "Engine/Core/Scene/Terrain/Terrain.h"
+#include "Engine/Core/Scene/Vertex.h"
+#include <glTF/stb_image.h>
+
+#include <glm/gtc/constants.hpp>
+#include <random>
+#include <algorithm>
+
+namespace
+{
+	const uint32_t QUERY_COUNT = 1000000;
+	const uint32_t RAY_COUNT = 100000;
+	const uint32_t MARCH_RAY_COUNT = 10000;	// Marching is slow, only the first rays are marched.
+	const float VERTEX_DISTANCE = 2.f;		// The same as the terrain benchmark.
+	const float HEIGHT_SCALE = 20.f;
+	const uint32_t UPSAMPLE_FACTOR = 8;		// The 512 x 512 heightmap becomes 4089 x 4089 samples.
+	const float RAY_LENGTH = 1000.f;
+
+	// Step along the ray until it goes below the surface, then refine the last step. The usual way to cast a ray without any
+	// acceleration structure, it can step over thin peaks.
+	bool march(const ym::Terrain& terrain, const glm::vec3& origin, const glm::vec3& direction, float step, float& distance)
+	{
+		float previous = 0.f;
+		for (float t = 0.f; t <= RAY_LENGTH; t += step)
+		{
+			const glm::vec3 p = origin + direction * t;
+			if (p.y < terrain.getHeightAt(p))
+			{
+				float low = previous;
+				float high = t;
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					const float mid = (low + high) * 0.5f;
+					const glm::vec3 m = origin + direction * mid;
+					if (m.y < terrain.getHeightAt(m))
+						high = mid;
+					else
+						low = mid;
+				}
+				distance = high;
+				return true;
+			}
+			previous = t;
+		}
+		return false;
+	}
+
+	double toMB(uint64_t bytes)
+	{
+		return (double)bytes / (1024.0 * 1024.0);
+	}
+}
+
+BenchmarkResult runTerrainQueryBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "Terrain queries";
+
+	int width, height, channels;
+	std::string path = YM_ASSETS_FILE_PATH + "/Textures/Heightmaps/australia.jpg";
+	unsigned char* data = static_cast<unsigned char*>(stbi_load(path.c_str(), &width, &height, &channels, 1));
+	if (data == nullptr)
+	{
+		result.lines.push_back("australia.jpg: not found");
+		return result;
+	}
+
+	// Bilinear upsampling of the heightmap into 16 bit samples.
+	const uint32_t largeWidth = (uint32_t)(width - 1) * UPSAMPLE_FACTOR + 1;
+	const uint32_t largeHeight = (uint32_t)(height - 1) * UPSAMPLE_FACTOR + 1;
+	std::vector<uint16_t> samples((size_t)largeWidth * largeHeight);
+	for (uint32_t z = 0; z < largeHeight; z++)
+	{
+		const uint32_t z0 = std::min(z / UPSAMPLE_FACTOR, (uint32_t)height - 2);
+		const float fz = (float)(z - z0 * UPSAMPLE_FACTOR) / (float)UPSAMPLE_FACTOR;
+		for (uint32_t x = 0; x < largeWidth; x++)
+		{
+			const uint32_t x0 = std::min(x / UPSAMPLE_FACTOR, (uint32_t)width - 2);
+			const float fx = (float)(x - x0 * UPSAMPLE_FACTOR) / (float)UPSAMPLE_FACTOR;
+			const unsigned char* p = data + (size_t)z0 * width + x0;
+			const float top = p[0] + (p[1] - p[0]) * fx;
+			const float bottom = p[width] + (p[width + 1] - p[width]) * fx;
+			samples[(size_t)z * largeWidth + x] = (uint16_t)((top + (bottom - top) * fz) * 257.f + 0.5f);
+		}
+	}
+	stbi_image_free(data);
+
+	ym::Terrain::Description description = {};
+	description.vertDist = VERTEX_DISTANCE;
+	description.minZ = 0.f;
+	description.maxZ = HEIGHT_SCALE * (float)UPSAMPLE_FACTOR;
+	description.origin = glm::vec3(0.f);
+
+	ym::Terrain terrain;
+	terrain.init(largeWidth, largeHeight, samples.data(), description);
+	samples.clear();
+	samples.shrink_to_fit();
+
+	// Memory of the heights compared to the vertex grid of the old terrain, a ym::Vertex for every sample.
+	const ym::TerrainTiles& tiles = terrain.getTiles();
+	const uint64_t sampleCount = (uint64_t)largeWidth * largeHeight;
+	const uint64_t heightBytes = sampleCount * sizeof(uint16_t);
+	const uint64_t pyramidBytes = tiles.getPyramid().getMemorySize();
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%u x %u samples: vertex grid %.1f MB, heights %.1f MB + pyramid %.2f MB (%u levels), %.1fx smaller",
+		largeWidth, largeHeight, toMB(sampleCount * sizeof(ym::Vertex)), toMB(heightBytes), toMB(pyramidBytes), tiles.getPyramid().getLevelCount(),
+		(double)(sampleCount * sizeof(ym::Vertex)) / (double)(heightBytes + pyramidBytes));
+	result.lines.push_back(std::string(buf));
+
+	// Height queries at random positions over the whole map.
+	const glm::vec2 size = glm::vec2((float)(largeWidth - 1), (float)(largeHeight - 1)) * VERTEX_DISTANCE;
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	std::vector<glm::vec3> positions(QUERY_COUNT);
+	for (glm::vec3& position : positions)
+		position = glm::vec3(unit(rng) * size.x, 0.f, unit(rng) * size.y);
+
+	std::vector<float> scalarHeights(QUERY_COUNT);
+	std::vector<float> batchedHeights(QUERY_COUNT);
+	double scalarMs = measureMs([&]() {
+		for (uint32_t i = 0; i < QUERY_COUNT; i++)
+			scalarHeights[i] = terrain.getHeightAt(positions[i]);
+	});
+	double batchedMs = measureMs([&]() { terrain.getHeightsAt(positions.data(), QUERY_COUNT, batchedHeights.data()); });
+	float maxDifference = 0.f;
+	for (uint32_t i = 0; i < QUERY_COUNT; i++)
+		maxDifference = std::max(maxDifference, std::abs(scalarHeights[i] - batchedHeights[i]));
+	snprintf(buf, sizeof(buf), "%u height queries: getHeightAt %.2f ms, getHeightsAt %.2f ms (%.2fx), max difference %.6f",
+		QUERY_COUNT, scalarMs, batchedMs, scalarMs / std::max(batchedMs, 0.0001), maxDifference);
+	result.lines.push_back(std::string(buf));
+
+	// Rays from above the terrain looking down at grazing to steep angles, like picking from a camera.
+	struct Ray
+	{
+		glm::vec3 origin;
+		glm::vec3 direction;
+	};
+	std::vector<Ray> rays(RAY_COUNT);
+	for (Ray& ray : rays)
+	{
+		ray.origin = glm::vec3(unit(rng) * size.x, 0.f, unit(rng) * size.y);
+		ray.origin.y = terrain.getHeightAt(ray.origin) + 5.f + unit(rng) * 50.f;
+		const float angle = unit(rng) * glm::two_pi<float>();
+		ray.direction = glm::normalize(glm::vec3(glm::cos(angle), -0.05f - unit(rng) * 0.6f, glm::sin(angle)));
+	}
+
+	std::vector<float> castDistances(RAY_COUNT, -1.f);
+	uint32_t castHits = 0;
+	double castMs = measureMs([&]() {
+		for (uint32_t i = 0; i < RAY_COUNT; i++)
+			castHits += terrain.rayCast(rays[i].origin, rays[i].direction, RAY_LENGTH, castDistances[i]) ? 1 : 0;
+	});
+
+	uint32_t marchHits = 0;
+	uint32_t agreements = 0;
+	double marchMs = measureMs([&]() {
+		for (uint32_t i = 0; i < MARCH_RAY_COUNT; i++)
+		{
+			float distance = -1.f;
+			if (march(terrain, rays[i].origin, rays[i].direction, VERTEX_DISTANCE * 0.5f, distance))
+			{
+				marchHits++;
+				agreements += castDistances[i] >= 0.f && std::abs(castDistances[i] - distance) < 0.01f * VERTEX_DISTANCE ? 1 : 0;
+			}
+		}
+	});
+	snprintf(buf, sizeof(buf), "%u ray casts: height pyramid %.2f ms (%.2f us per ray, %u hits)", RAY_COUNT, castMs, castMs * 1000.0 / RAY_COUNT, castHits);
+	result.lines.push_back(std::string(buf));
+	snprintf(buf, sizeof(buf), "%u rays marched in half sample steps: %.2f ms (%.2f us per ray, %.1fx slower), %u of %u hits at the same distance",
+		MARCH_RAY_COUNT, marchMs, marchMs * 1000.0 / MARCH_RAY_COUNT, (marchMs / MARCH_RAY_COUNT) / std::max(castMs / RAY_COUNT, 0.000001), agreements, marchHits);
+	result.lines.push_back(std::string(buf));
+
+	terrain.destroy();
+	return result;
+}
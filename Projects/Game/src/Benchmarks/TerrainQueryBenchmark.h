@@ -0,0 +1,10 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Reports the memory of the terrain heights compared to a vertex per sample, then times 1M height queries one at a time and
+	batched with SSE, and 100k ray casts through the height pyramid compared to marching along the rays, on the australia
+	heightmap upsampled to about 4k x 4k samples.
+*/
+BenchmarkResult runTerrainQueryBenchmark();
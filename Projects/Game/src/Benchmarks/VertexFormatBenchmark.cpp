@@ -0,0 +1,154 @@
+#include "VertexFormatBenchmark.h"
+
+#include "Engine/Core/Scene/GLTFLoader.h"
+#include "Engine/Core/Scene/Model/Model.h"
+#include "Engine/Core/Scene/Vertex.h"
+
+#include <filesystem>
+#include <algorithm>
+
+namespace
+{
+	std::vector<std::string> findModels()
+	{
+		std::vector<std::string> filePaths;
+		std::string folder = YM_ASSETS_FILE_PATH + "Models/";
+		if (std::filesystem::exists(folder) == false)
+			return filePaths;
+
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(folder))
+		{
+			std::string extension = entry.path().extension().string();
+			if (entry.is_regular_file() && (extension == ".gltf" || extension == ".glb"))
+				filePaths.push_back(entry.path().generic_string());
+		}
+		std::sort(filePaths.begin(), filePaths.end());
+		return filePaths;
+	}
+
+	const float MAX_POSITION_ERROR = 2.f / 65535.f; // Relative to the largest side of the bounds.
+	const float MAX_NORMAL_DEGREES = 0.1f;
+	const float MAX_SHADER_DIFFERENCE = 1e-5f; // Between the decode of pbrTestVert.glsl and PackedVertex::unpack.
+
+	struct PackingError
+	{
+		float position{ 0.f };	// Largest distance, relative to the largest side of the bounds.
+		float normalDegrees{ 0.f };
+		float uv{ 0.f };
+		float shader{ 0.f };	// Largest difference between the shader decode and unpack, relative to the bounds.
+	};
+
+	/*
+		Decodes a packed vertex like pbrTestVert.glsl with PACKED_VERTICES. The attributes are converted like the vertex input
+		formats of PackedVertex and the node data is filled in like the ModelRenderer does for packed models.
+	*/
+	ym::Vertex decodeLikeShader(const ym::PackedVertex& packed, const ym::VertexQuantization& quantization)
+	{
+		ym::Model::Node::NodeData node;
+		node.positionOffset = glm::vec4(quantization.positionMin, 0.f);
+		node.positionScale = glm::vec4(quantization.positionExtent, 1.f);
+		node.uvTransform = glm::vec4(quantization.uvMin, quantization.uvExtent);
+
+		// VK_FORMAT_R16G16B16A16_UNORM, VK_FORMAT_R16G16_SNORM and VK_FORMAT_R16G16_UNORM.
+		const glm::vec4 position(packed.pos[0] / 65535.f, packed.pos[1] / 65535.f, packed.pos[2] / 65535.f, packed.pos[3] / 65535.f);
+		const glm::vec2 normal(std::max(packed.nor[0] / 32767.f, -1.f), std::max(packed.nor[1] / 32767.f, -1.f));
+		const glm::vec2 texCoords(packed.uv0[0] / 65535.f, packed.uv0[1] / 65535.f);
+
+		ym::Vertex vertex;
+		vertex.pos = glm::vec3(node.positionOffset) + glm::vec3(position) * glm::vec3(node.positionScale);
+		glm::vec3 n(normal, 1.f - std::abs(normal.x) - std::abs(normal.y));
+		const float t = std::max(-n.z, 0.f);
+		n.x += n.x >= 0.f ? -t : t;
+		n.y += n.y >= 0.f ? -t : t;
+		vertex.nor = glm::normalize(n);
+		vertex.uv0 = glm::vec2(node.uvTransform.x, node.uvTransform.y) + texCoords * glm::vec2(node.uvTransform.z, node.uvTransform.w);
+		return vertex;
+	}
+
+	PackingError measurePackingError(const ym::Model& model)
+	{
+		PackingError error;
+		const ym::VertexQuantization& quantization = model.quantization;
+		const float size = std::max(quantization.positionExtent.x, std::max(quantization.positionExtent.y, quantization.positionExtent.z));
+		for (const ym::Vertex& vertex : model.vertices)
+		{
+			const ym::PackedVertex packed = ym::PackedVertex::pack(vertex, quantization);
+			const ym::Vertex unpacked = ym::PackedVertex::unpack(packed, quantization);
+			error.position = std::max(error.position, glm::length(unpacked.pos - vertex.pos) / size);
+			error.uv = std::max(error.uv, glm::length(unpacked.uv0 - vertex.uv0));
+
+			const ym::Vertex decoded = decodeLikeShader(packed, quantization);
+			error.shader = std::max(error.shader, glm::length(decoded.pos - unpacked.pos) / size);
+			error.shader = std::max(error.shader, glm::length(decoded.uv0 - unpacked.uv0));
+			if (glm::length(vertex.nor) > 0.f)
+				error.shader = std::max(error.shader, glm::length(decoded.nor - unpacked.nor));
+
+			// Zero normals are kept as zero and have no direction to compare.
+			const float length = glm::length(vertex.nor);
+			if (length > 0.f)
+			{
+				const float cosAngle = glm::clamp(glm::dot(unpacked.nor, vertex.nor / length), -1.f, 1.f);
+				error.normalDegrees = std::max(error.normalDegrees, glm::degrees(std::acos(cosAngle)));
+			}
+		}
+		return error;
+	}
+}
+
+BenchmarkResult runVertexFormatBenchmark()
+{
+	BenchmarkResult result;
+	result.name = "Vertex format";
+
+	std::vector<std::string> filePaths = findModels();
+	if (filePaths.empty())
+	{
+		result.lines.push_back("No models found in " + YM_ASSETS_FILE_PATH + "Models/");
+		return result;
+	}
+
+	const float kb = 1.f / 1024.f;
+	uint64_t totalFull = 0;
+	uint64_t totalIndex16 = 0;
+	uint64_t totalPacked = 0;
+	char buf[256];
+	for (const std::string& filePath : filePaths)
+	{
+		ym::Model model;
+		ym::GLTFLoader::StagingBuffers stagingBuffers;
+		ym::GLTFLoader::loadToRAM(filePath, &model, &stagingBuffers);
+
+		// Baseline, what every model used before: 48 byte vertices and 32 bit indices.
+		const uint64_t fullSize = (uint64_t)model.vertices.size() * sizeof(ym::Vertex) + (uint64_t)model.indices.size() * sizeof(uint32_t);
+		ym::GLTFLoader::selectGeometryFormat(model, false);
+		const uint64_t index16Size = ym::GLTFLoader::getIndicesSize(model) + ym::GLTFLoader::getVerticesSize(model);
+		const bool uses16Bit = model.indexType == VK_INDEX_TYPE_UINT16;
+		ym::GLTFLoader::selectGeometryFormat(model, true);
+		const uint64_t packedSize = ym::GLTFLoader::getIndicesSize(model) + ym::GLTFLoader::getVerticesSize(model);
+		PackingError error = measurePackingError(model);
+
+		totalFull += fullSize;
+		totalIndex16 += index16Size;
+		totalPacked += packedSize;
+
+		std::string name = std::filesystem::path(filePath).filename().string();
+		snprintf(buf, sizeof(buf), "%-20s %8.1f KB -> %8.1f KB (%s indices) -> %8.1f KB packed, %.2fx smaller",
+			name.c_str(), (float)fullSize * kb, (float)index16Size * kb, uses16Bit ? "16 bit" : "32 bit", (float)packedSize * kb,
+			packedSize > 0 ? (double)fullSize / (double)packedSize : 0.0);
+		result.lines.push_back(std::string(buf));
+		snprintf(buf, sizeof(buf), "%-20s max error: position %.6f of the bounds, normal %.3f degrees, uv %.6f, shader decode %.7f", "",
+			error.position, error.normalDegrees, error.uv, error.shader);
+		result.lines.push_back(std::string(buf));
+		check(result, error.position <= MAX_POSITION_ERROR, name + ": packed positions are further off than the unorm16 precision");
+		check(result, error.normalDegrees <= MAX_NORMAL_DEGREES, name + ": packed normals are further off than the octahedral precision");
+		check(result, error.shader <= MAX_SHADER_DIFFERENCE, name + ": the shader decode differs from PackedVertex::unpack");
+
+		stagingBuffers.destroy();
+		model.destroy();
+	}
+
+	snprintf(buf, sizeof(buf), "Total: %.1f KB full, %.1f KB with 16 bit indices, %.1f KB packed, %.2fx smaller", (float)totalFull * kb,
+		(float)totalIndex16 * kb, (float)totalPacked * kb, totalPacked > 0 ? (double)totalFull / (double)totalPacked : 0.0);
+	result.lines.push_back(std::string(buf));
+	return result;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "Benchmark.h"
+
+/*
+	Loads every model in Resources/Models to RAM and compares the size of its geometry on the GPU with full vertices and 32 bit indices,
+	with 16 bit indices and with packed vertices. The packed vertices are unpacked again to report the largest position, normal and
+	texture coordinate error. They are also decoded like pbrTestVert.glsl does to check that it matches PackedVertex::unpack.
+	Nothing is submitted to the GPU.
+*/
+BenchmarkResult runVertexFormatBenchmark();
@@ -3,6 +3,7 @@
 
 #include "SandboxLayer.h"
 #include "TestLayer.h"
+#include "BenchmarkLayer.h"
 
 class Application : public ym::App
 {
@@ -21,6 +22,7 @@ public:
 	{
 		this->layerManager->push(new SandboxLayer());
 		//this->layerManager->push(new TestLayer());
+		//this->layerManager->push(new BenchmarkLayer());
 	}
 };
 
@@ -7,7 +7,8 @@
 #include "Engine/Core/Display/Display.h"
 #include "Engine/Core/Input/Input.h"
 #include "Engine/Core/Audio/AudioSystem.h"
-#include "Engine/Core/Scene/ObjectManager.h"
+#include "Engine/Core/ECS/Ecs.h"
+#include "Engine/Core/ECS/Components.h"
 
 #include "Engine/Core/Audio/Filters/DistanceFilter.h"
 #include "Engine/Core/Audio/Filters/EchoFilter.h"
@@ -15,6 +16,8 @@
 #include "Engine/Core/Audio/Filters/HighpassFilter.h"
 
 #include "Engine/Core/Vulkan/Factory.h"
+#include "Engine/Core/Vulkan/Buffers/MemoryAllocator.h"
+#include "Engine/Core/Scene/Model/GeometryArena.h"
 #include "Utils/Utils.h"
 
 void SandboxLayer::onStart(ym::Renderer* renderer)
@@ -45,7 +48,7 @@ void SandboxLayer::onStart(ym::Renderer* renderer)
 		terrainDescription.vertDist = scale;
 		terrainDescription.minZ = 0.0f;
 		terrainDescription.maxZ = 20.0f;
-		terrainDescription.origin = glm::vec3(-(width / 2.f) * scale, 0.f, -(height / 2.f) * scale);
+		terrainDescription.origin = glm::vec3(-(width / 2.f) * scale, -terrainDescription.maxZ, -(height / 2.f) * scale);
 		this->terrain.init(width, height, data, terrainDescription);
 		YM_LOG_INFO("Loaded terrain: {} successfully!", path);
 		delete[] data;
@@ -72,20 +75,21 @@ void SandboxLayer::onStart(ym::Renderer* renderer)
 	this->music->play();
 	//this->music = ym::AudioSystem::get()->createStream(YM_ASSETS_FILE_PATH + "/Audio/Music/DunnoJBPet.mp3", ym::PCM::Func::NORMAL);
 
+	ym::ECS* ecs = ym::ECS::get();
+
 	// Cube
 	glm::mat4 transformCube(0.5f);
 	transformCube[3][3] = 1.0f;
 	transformCube = glm::translate(glm::mat4(1.0f), { 3.0f, 1.f, 2.f }) * transformCube;
-	this->cubeObject = ym::ObjectManager::get()->createGameObject(transformCube, &this->cubeModel);
+	this->cubeEntity = ecs->createEntity(ym::Transform{ transformCube }, ym::ModelRef{ &this->cubeModel });
 
 	transformCube = glm::translate(glm::mat4(1.0f), { -3.0f, 7.f, 2.f });
-	ym::ObjectManager::get()->createGameObject(transformCube, &this->metalBallsModel);
+	ecs->createEntity(ym::Transform{ transformCube }, ym::ModelRef{ &this->metalBallsModel });
 
 	// Add chest
 	glm::mat4 transformChest(1.0f);
 	transformChest = glm::rotate(glm::mat4(1.f), glm::pi<float>() / 4.f, { 0.f, 1.f, 0.f });
 	transformChest = glm::translate(glm::mat4(1.0f), { -4.0f, 0.f, 3.f }) * transformChest;
-	this->chestObject = ym::ObjectManager::get()->createGameObject(transformChest, &this->chestModel);
 	this->chestSound = ym::AudioSystem::get()->createStream(YM_ASSETS_FILE_PATH + "Audio/SoundEffects/ButtonOff.mp3");
 	this->chestSound->setLoop(true);
 	this->chestSound->addFilter(new ym::EchoFilter());
@@ -93,18 +97,19 @@ void SandboxLayer::onStart(ym::Renderer* renderer)
 	this->chestSound->addFilter(new ym::LowpassFilter());
 	this->chestSound->setVolume(0.4f);
 	this->chestSound->play();
+	this->chestEntity = ecs->createEntity(ym::Transform{ transformChest }, ym::ModelRef{ &this->chestModel }, ym::SoundSource{ this->chestSound });
 
-	//ym::ObjectManager::get()->createGameObject(glm::mat4(1.f), &this->terrain2Model);
-	this->fortObject = ym::ObjectManager::get()->createGameObject(glm::mat4(1.f), &this->fortModel);
+	//ecs->createEntity(ym::Transform{ glm::mat4(1.f) }, ym::ModelRef{ &this->terrain2Model });
+	this->fortEntity = ecs->createEntity(ym::Transform{ glm::mat4(1.f) }, ym::ModelRef{ &this->fortModel });
 
 	glm::mat4 transformCrate(1.0f);
 	transformCrate = glm::translate(glm::mat4(1.0f), { 3.0f, 0.f, 2.f }) * transformCrate;
-	this->woodenCrateObject = ym::ObjectManager::get()->createGameObject(transformCrate, &this->woodenCrateModel);
 	this->crateSound = ym::AudioSystem::get()->createSound(YM_ASSETS_FILE_PATH + "Audio/SoundEffects/SlidingDoor.mp3");
 	this->crateSound->setLoop(false);
 	this->crateSound->addFilter(new ym::DistanceFilter());
 	this->crateSound->addFilter(new ym::LowpassFilter());
 	this->crateSound->setVolume(0.4f);
+	this->woodenCrateEntity = ecs->createEntity(ym::Transform{ transformCrate }, ym::ModelRef{ &this->woodenCrateModel }, ym::SoundSource{ this->crateSound });
 
 	this->crowdSound = ym::AudioSystem::get()->createSound(YM_ASSETS_FILE_PATH + "Audio/Ambient/crowd.mp3");
 	this->crowdSound->setSourcePosition({ -2.f, 1.f, -5.f });
@@ -117,16 +122,14 @@ void SandboxLayer::onStart(ym::Renderer* renderer)
 	{ // Dragon
 		glm::mat4 transform(1.f);
 		transform = glm::translate(glm::mat4(1.0f), { 2.0f, 0.f, 0.f }) * glm::rotate(glm::mat4(1.f), 0.f, { 0.f, 1.f, 0.f });
-		ym::GameObject* dragon = ym::ObjectManager::get()->createGameObject(transform, &this->dragonModel);
+		ecs->createEntity(ym::Transform{ transform }, ym::ModelRef{ &this->dragonModel });
 	}
 
 	{ // Knight Sword
 		glm::mat4 transform(1.f);
 		transform = glm::translate(glm::mat4(1.0f), { 0.0f, 0.f, -7.f }) * glm::rotate(glm::mat4(1.f), 0.f, { 0.f, 1.f, 0.f });
-		ym::GameObject* knightSword = ym::ObjectManager::get()->createGameObject(transform, &this->knightSwordModel);
 		this->helloSound1 = ym::AudioSystem::get()->createSound(YM_ASSETS_FILE_PATH + "Audio/SoundEffects/Hello.mp3");
-		glm::vec3 soundPos = knightSword->getPos() + glm::vec3(0.f, 1.6f, 0.f);
-		this->helloSound1->setSourcePosition(soundPos);
+		ecs->createEntity(ym::Transform{ transform }, ym::ModelRef{ &this->knightSwordModel }, ym::SoundSource{ this->helloSound1, glm::vec3(0.f, 1.6f, 0.f) });
 		this->helloSound1->setLoop(true);
 		this->helloSound1->addFilter(new ym::DistanceFilter());
 		this->helloSound1->addFilter(new ym::LowpassFilter());
@@ -138,10 +141,8 @@ void SandboxLayer::onStart(ym::Renderer* renderer)
 	{ // Knight Spear
 		glm::mat4 transform(1.f);
 		transform = glm::translate(glm::mat4(1.0f), { 0.0f, 0.f, 7.f }) * glm::rotate(glm::mat4(1.f), glm::pi<float>(), { 0.f, 1.f, 0.f });
-		ym::GameObject* knightSpear = ym::ObjectManager::get()->createGameObject(transform, &this->knightSpearModel);
 		this->helloSound2 = ym::AudioSystem::get()->createSound(YM_ASSETS_FILE_PATH + "Audio/SoundEffects/Hello.mp3");
-		glm::vec3 soundPos = knightSpear->getPos() + glm::vec3(0.f, 1.6f, 0.f);
-		this->helloSound2->setSourcePosition(soundPos);
+		ecs->createEntity(ym::Transform{ transform }, ym::ModelRef{ &this->knightSpearModel }, ym::SoundSource{ this->helloSound2, glm::vec3(0.f, 1.6f, 0.f) });
 		this->helloSound2->setLoop(true);
 		ym::EchoFilter* filter = new ym::EchoFilter();
 		this->helloSound2->addFilter(filter);
@@ -157,7 +158,7 @@ void SandboxLayer::onStart(ym::Renderer* renderer)
 	glm::mat4 transformSponza(1.0f);
 	transformSponza[3][3] = 1.0f;
 	transformSponza = glm::translate(glm::mat4(1.0f), { 0.0f, 1.f, 0.f }) * transformSponza;
-	this->sponzaObject = ym::ObjectManager::get()->createGameObject(transformSponza, &this->sponzaModel);
+	this->sponzaEntity = ecs->createEntity(ym::Transform{ transformSponza }, ym::ModelRef{ &this->sponzaModel });
 	*/
 
 	this->environmentMap = renderer->getDefaultEnvironmentMap();
@@ -237,7 +238,8 @@ void SandboxLayer::onUpdate(float dt)
 		YM_LOG_INFO("Changed volume to {}", this->music->getVolume());
 	}
 
-	// ---------- Update game objects ----------
+	// ---------- Update entities ----------
+	ym::ECS* ecs = ym::ECS::get();
 
 	// Add tree objects when pressing E
 	static int32_t maxTrees = 15;
@@ -253,10 +255,10 @@ void SandboxLayer::onUpdate(float dt)
 		auto transform = glm::mat4(1.0f);
 		transform = glm::translate(glm::mat4(1.0f), { x, 0.f, z });
 
-		if (i >= this->treesObjects.size())
-			this->treesObjects.push_back(ym::ObjectManager::get()->createGameObject(transform, &this->treeModel));
+		if (i >= this->treeEntities.size())
+			this->treeEntities.push_back(ecs->createEntity(ym::Transform{ transform }, ym::ModelRef{ &this->treeModel }));
 		else
-			this->treesObjects[i]->setTransform(transform);
+			ecs->getComponent<ym::Transform>(this->treeEntities[i])->matrix = transform;
 	}
 
 	// Toggle Water bottle object when pressing F
@@ -270,20 +272,16 @@ void SandboxLayer::onUpdate(float dt)
 			auto transform = glm::mat4(10.0f);
 			transform[3][3] = 1.0f;
 			transform = glm::translate(glm::mat4(1.0f), { 0.0f, 2.f, 0.f }) * transform;
-			this->watterBottleObject = ym::ObjectManager::get()->createGameObject(transform, &this->waterBottleModel);
+			this->waterBottleEntity = ecs->createEntity(ym::Transform{ transform }, ym::ModelRef{ &this->waterBottleModel });
 		}
 		else
 		{
-			ym::ObjectManager::get()->removeGameObject(this->watterBottleObject);
+			ecs->removeEntity(this->waterBottleEntity);
 		}
 	}
 
-	// Update sound user data.
-	
-	this->chestSound->setSourcePosition(this->chestObject->getPos());
+	// Update sound user data. The source positions are updated by the SoundSourceSystem.
 	this->chestSound->setReceiver(&this->camera);
-
-	this->crateSound->setSourcePosition(this->woodenCrateObject->getPos());
 	this->crateSound->setReceiver(&this->camera);
 
 	this->crowdSound->setReceiver(&this->camera);
@@ -307,6 +305,9 @@ void SandboxLayer::onRender(ym::Renderer* renderer)
 	ImGui::ShowAboutWindow();
 
 	ym::AudioSystem::get()->drawAudioSettings();
+	ym::MemoryAllocator::get()->drawStats();
+	ym::GeometryArena::get()->drawStats();
+	renderer->drawTerrainStats();
 
 	{
 		static bool my_tool_active = true;
@@ -321,9 +322,9 @@ void SandboxLayer::onRender(ym::Renderer* renderer)
 
 	glm::mat4 transform(1.f);
 	renderer->drawSkybox(this->environmentMap);
-	renderer->drawAllModels(ym::ObjectManager::get());
+	renderer->drawAllModels(ym::ECS::get());
 
-	//renderer->drawTerrain(&this->terrain, glm::mat4(1.0f));
+	renderer->drawTerrain(&this->terrain, glm::mat4(1.0f));
 
 	renderer->end();
 }
@@ -8,7 +8,7 @@
 
 #include "Engine/Core/Audio/Sound.h"
 
-#include "Engine/Core/Scene/GameObject.h"
+#include "Engine/Core/ECS/Entity.h"
 
 class SandboxLayer : public ym::Layer
 {
@@ -50,11 +50,11 @@ private:
 	ym::Sound* helloSound2;
 	
 
-	std::vector<ym::GameObject*> treesObjects;
-	ym::GameObject* watterBottleObject;
-	ym::GameObject* cubeObject;
-	ym::GameObject* sponzaObject;
-	ym::GameObject* chestObject;
-	ym::GameObject* woodenCrateObject;
-	ym::GameObject* fortObject;
+	std::vector<ym::Entity> treeEntities;
+	ym::Entity waterBottleEntity;
+	ym::Entity cubeEntity;
+	ym::Entity sponzaEntity;
+	ym::Entity chestEntity;
+	ym::Entity woodenCrateEntity;
+	ym::Entity fortEntity;
 };
\ No newline at end of file
@@ -3,7 +3,8 @@
 #include "Engine/Core/Scene/GLTFLoader.h"
 #include "Engine/Core/Graphics/Renderer.h"
 #include "Engine/Core/Display/Display.h"
-#include "Engine/Core/Scene/ObjectManager.h"
+#include "Engine/Core/ECS/Ecs.h"
+#include "Engine/Core/ECS/Components.h"
 
 void TestLayer::onStart(ym::Renderer* renderer)
 {
@@ -16,7 +17,7 @@ void TestLayer::onStart(ym::Renderer* renderer)
 	glm::mat4 transformCube(0.5f);
 	transformCube[3][3] = 1.0f;
 	transformCube = glm::translate(glm::mat4(1.0f), { 0.0f, 1.f, 3.f }) * transformCube;
-	this->cubeObject = ym::ObjectManager::get()->createGameObject(transformCube, &this->cubeModel);
+	this->cubeEntity = ym::ECS::get()->createEntity(ym::Transform{ transformCube }, ym::ModelRef{ &this->cubeModel });
 
 	this->environmentMap = renderer->getDefaultEnvironmentMap();
 }
@@ -69,7 +70,7 @@ void TestLayer::onRender(ym::Renderer* renderer)
 
 	glm::mat4 transform(1.f);
 	renderer->drawSkybox(this->environmentMap);
-	renderer->drawAllModels(ym::ObjectManager::get());
+	renderer->drawAllModels(ym::ECS::get());
 
 	renderer->end();
 }
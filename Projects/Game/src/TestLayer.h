@@ -4,7 +4,7 @@
 #include "Engine/Core/Scene/Model/Model.h"
 #include "Engine/Core/Camera.h"
 
-#include "Engine/Core/Scene/GameObject.h"
+#include "Engine/Core/ECS/Entity.h"
 
 class TestLayer : public ym::Layer
 {
@@ -22,5 +22,5 @@ private:
 
 	ym::Texture* environmentMap;
 
-	ym::GameObject* cubeObject;
+	ym::Entity cubeEntity;
 };
\ No newline at end of file
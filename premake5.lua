@@ -59,6 +59,13 @@ function linkVulkan()
 	filter {}
 end
 
+-- The shaders are compiled next to their .glsl before each build with the glslc of the same SDK, a shader which does not compile fails the build.
+function compileShaders()
+	filter "system:windows"
+		prebuildcommands { 'cd "%{prj.location}/Resources/Shaders" && set "GLSLC=' .. VULKAN_DIR .. '/Bin/glslc.exe" && call compile.bat nopause' }
+	filter {}
+end
+
 -- ==============================================================================================
 
 -- ============================================ MISC ============================================
@@ -189,6 +196,7 @@ project "Game"
 	addFiles();
 
 	useEngine()
+	compileShaders()
 	
 	filter {}
 